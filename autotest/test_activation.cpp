@@ -0,0 +1,186 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "layer/absval.h"
+#include "layer/bnll.h"
+#include "layer/elu.h"
+#include "layer/exp.h"
+#include "layer/log.h"
+#include "layer/power.h"
+#include "layer/prelu.h"
+#include "layer/relu.h"
+#include "layer/sigmoid.h"
+#include "layer/tanh.h"
+#include "layer/unaryop.h"
+
+// every blob dimension, sizes leaving a tail after the 8 and 4 lane loops
+// inputs are drawn from [a, b]
+template<typename T>
+static int test_activation(const char* layer_type, const ncnn::ParamDict& pd, float a = -1.2f, float b = 1.2f)
+{
+    ncnn::Mat inputs[4] = {
+        random_mat(67, a, b),
+        random_mat(13, 9, a, b),
+        random_mat(13, 11, 3, a, b),
+        random_mat(8, 4, 16, a, b),
+    };
+
+    std::vector<ncnn::Mat> weights(0);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    for (int i=0; i<4; i++)
+    {
+        int ret = test_layer<T>(layer_type, pd, weights, opt, inputs[i]);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int test_relu(float slope)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, slope);// slope
+
+    int ret = test_activation<ncnn::ReLU>("ReLU", pd);
+    if (ret != 0)
+        fprintf(stderr, "test_relu failed slope=%f\n", slope);
+
+    return ret;
+}
+
+// one shared slope or one per channel, rows of a 2 dim blob or elements of a 1 dim blob
+static int test_prelu(const ncnn::Mat& a, int num_slope)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, num_slope);// num_slope
+
+    std::vector<ncnn::Mat> weights(1);
+    weights[0] = random_mat(num_slope, 0.f, 0.5f);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::PReLU>("PReLU", pd, weights, opt, a);
+    if (ret != 0)
+        fprintf(stderr, "test_prelu failed num_slope=%d\n", num_slope);
+
+    return ret;
+}
+
+static int test_elu(float alpha)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, alpha);// alpha
+
+    int ret = test_activation<ncnn::ELU>("ELU", pd);
+    if (ret != 0)
+        fprintf(stderr, "test_elu failed alpha=%f\n", alpha);
+
+    return ret;
+}
+
+static int test_power(float power, float scale, float shift, float a, float b)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, power);// power
+    pd.set(1, scale);// scale
+    pd.set(2, shift);// shift
+
+    int ret = test_activation<ncnn::Power>("Power", pd, a, b);
+    if (ret != 0)
+        fprintf(stderr, "test_power failed power=%f scale=%f shift=%f\n", power, scale, shift);
+
+    return ret;
+}
+
+template<typename T>
+static int test_exp_log(const char* layer_type, float base, float scale, float shift, float a, float b)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, base);// base
+    pd.set(1, scale);// scale
+    pd.set(2, shift);// shift
+
+    int ret = test_activation<T>(layer_type, pd, a, b);
+    if (ret != 0)
+        fprintf(stderr, "test_%s failed base=%f scale=%f shift=%f\n", layer_type, base, scale, shift);
+
+    return ret;
+}
+
+static int test_unaryop(int op_type)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, op_type);// op_type
+
+    // sqrt rsqrt log reciprocal asin acos take positive inputs below one
+    const bool positive = op_type == 5 || op_type == 6 || op_type == 8 || op_type == 12 || op_type == 13 || op_type == 15;
+
+    int ret = positive ? test_activation<ncnn::UnaryOp>("UnaryOp", pd, 0.01f, 0.99f) : test_activation<ncnn::UnaryOp>("UnaryOp", pd);
+    if (ret != 0)
+        fprintf(stderr, "test_unaryop failed op_type=%d\n", op_type);
+
+    return ret;
+}
+
+static int test_unaryop_0()
+{
+    for (int op_type=0; op_type<16; op_type++)
+    {
+        int ret = test_unaryop(op_type);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+int main()
+{
+    srand(7767517);
+
+    ncnn::ParamDict pd;
+
+    return 0
+           || test_relu(0.f)
+           || test_relu(0.1f)
+           || test_prelu(random_mat(67), 1)
+           || test_prelu(random_mat(67), 67)
+           || test_prelu(random_mat(13, 9), 9)
+           || test_prelu(random_mat(13, 11, 3), 1)
+           || test_prelu(random_mat(13, 11, 3), 3)
+           || test_prelu(random_mat(8, 4, 16), 16)
+           || test_activation<ncnn::Sigmoid>("Sigmoid", pd)
+           || test_activation<ncnn::TanH>("TanH", pd)
+           || test_elu(0.1f)
+           || test_elu(1.f)
+           || test_activation<ncnn::AbsVal>("AbsVal", pd)
+           || test_activation<ncnn::BNLL>("BNLL", pd)
+           || test_power(1.f, 1.5f, 0.3f, -1.2f, 1.2f)
+           || test_power(2.f, 0.7f, -0.2f, -1.2f, 1.2f)
+           || test_power(0.5f, 1.2f, 0.1f, 0.f, 1.2f)
+           || test_power(3.f, 0.9f, 0.f, -1.2f, 1.2f)
+           || test_exp_log<ncnn::Exp>("Exp", -1.f, 1.f, 0.f, -1.2f, 1.2f)
+           || test_exp_log<ncnn::Exp>("Exp", 2.f, 1.5f, 0.3f, -1.2f, 1.2f)
+           || test_exp_log<ncnn::Exp>("Exp", 10.f, 0.5f, -0.2f, -1.2f, 1.2f)
+           || test_exp_log<ncnn::Log>("Log", -1.f, 1.f, 0.f, 0.01f, 1.2f)
+           || test_exp_log<ncnn::Log>("Log", 2.f, 1.5f, 0.3f, 0.01f, 1.2f)
+           || test_exp_log<ncnn::Log>("Log", 10.f, 0.5f, 0.1f, 0.01f, 1.2f)
+           || test_unaryop_0()
+           ;
+}
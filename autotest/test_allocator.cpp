@@ -0,0 +1,181 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "allocator.h"
+#include "net.h"
+
+static int test_allocator_pool()
+{
+    ncnn::PoolAllocator allocator;
+
+    void* p0 = allocator.fastMalloc(1000);
+    allocator.fastFree(p0);
+
+    // recycled within the size compare ratio
+    void* p1 = allocator.fastMalloc(900);
+    if (p1 != p0)
+    {
+        fprintf(stderr, "test_allocator_pool buffer not recycled\n");
+        return -1;
+    }
+
+    // too small for the cached buffer
+    void* p2 = allocator.fastMalloc(100);
+    if (p2 == p1)
+    {
+        fprintf(stderr, "test_allocator_pool buffer handed out twice\n");
+        return -1;
+    }
+
+    allocator.fastFree(p1);
+    allocator.fastFree(p2);
+    allocator.clear();
+
+    return 0;
+}
+
+// two branches joined again, the blobs die at different times
+static const char* test_allocator_param =
+    "7767517\n"
+    "9 10\n"
+    "Input            data   0 1 data 0=15 1=13 2=16\n"
+    "Convolution      conv1  1 1 data conv1 0=16 1=3 4=1 5=1 6=2304\n"
+    "Split            split1 1 2 conv1 split1a split1b\n"
+    "Convolution      conv2  1 1 split1a conv2 0=16 1=1 5=1 6=256\n"
+    "ConvolutionDepthWise dw3 1 1 split1b dw3 0=16 1=3 4=1 5=1 6=144 7=16\n"
+    "Eltwise          sum4   2 1 conv2 dw3 sum4 0=1\n"
+    "Pooling          pool5  1 1 sum4 pool5 0=0 1=3 2=2\n"
+    "InnerProduct     fc6    1 1 pool5 fc6 0=11 1=1 2=7392\n"
+    "Softmax          prob   1 1 fc6 prob\n";
+
+static int test_allocator_net()
+{
+    std::vector<float> bin;
+    append_weight(bin, 2304, 0, -0.3f, 0.3f);
+    append_weight(bin, 16, 1);
+    append_weight(bin, 256, 0);
+    append_weight(bin, 16, 1);
+    append_weight(bin, 144, 0);
+    append_weight(bin, 16, 1);
+    append_weight(bin, 7392, 0, -0.1f, 0.1f);
+    append_weight(bin, 11, 1);
+
+    if (write_file("test_allocator.param", test_allocator_param, strlen(test_allocator_param)) != 0)
+        return -1;
+    if (write_file("test_allocator.bin", &bin[0], bin.size() * sizeof(float)) != 0)
+        return -1;
+
+    ncnn::Net net;
+    int ret = net.load_param("test_allocator.param");
+    if (ret == 0)
+        ret = net.load_model("test_allocator.bin");
+
+    remove("test_allocator.param");
+    remove("test_allocator.bin");
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_allocator_net load failed %d\n", ret);
+        return -1;
+    }
+
+    ncnn::Mat in = random_mat(15, 13, 16);
+
+    ncnn::Mat out_ref;
+    {
+        ncnn::Extractor ex = net.create_extractor();
+        ex.input("data", in);
+        ret = ex.extract("prob", out_ref);
+        if (ret != 0)
+            return ret;
+    }
+
+    // pool allocators as benchncnn sets them, the later runs recycle the buffers of the first
+    {
+        ncnn::UnlockedPoolAllocator blob_allocator;
+        ncnn::PoolAllocator workspace_allocator;
+
+        for (int i=0; i<3; i++)
+        {
+            ncnn::Mat out;
+
+            ncnn::Extractor ex = net.create_extractor();
+            ex.set_blob_allocator(&blob_allocator);
+            ex.set_workspace_allocator(&workspace_allocator);
+            ex.input("data", in);
+            ret = ex.extract("prob", out);
+            if (ret == 0)
+                ret = compare_mat(out_ref, out, 0.f);
+            if (ret != 0)
+            {
+                fprintf(stderr, "test_allocator_net pool run %d failed\n", i);
+                return -1;
+            }
+        }
+    }
+
+    // planned allocator, the first run records and the later ones replay from the arena
+    {
+        ncnn::PlannedAllocator blob_allocator;
+        ncnn::PlannedAllocator workspace_allocator;
+
+        for (int i=0; i<4; i++)
+        {
+            if (i == 1)
+            {
+                if (blob_allocator.plan() != 0 || workspace_allocator.plan() != 0)
+                {
+                    fprintf(stderr, "test_allocator_net plan failed\n");
+                    return -1;
+                }
+
+                // the arena holds every buffer alive at the same time
+                if (blob_allocator.planned_size() < blob_allocator.naive_size() || blob_allocator.planned_size() == 0)
+                {
+                    fprintf(stderr, "test_allocator_net arena of %d bytes for %d live bytes\n", (int)blob_allocator.planned_size(), (int)blob_allocator.naive_size());
+                    return -1;
+                }
+            }
+
+            ncnn::Mat out;
+
+            ncnn::Extractor ex = net.create_extractor();
+            ex.set_blob_allocator(&blob_allocator);
+            ex.set_workspace_allocator(&workspace_allocator);
+            ex.input("data", in);
+            ret = ex.extract("prob", out);
+            if (ret == 0)
+                ret = compare_mat(out_ref, out, 0.f);
+            if (ret != 0)
+            {
+                fprintf(stderr, "test_allocator_net planned run %d failed\n", i);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_allocator_pool()
+           || test_allocator_net()
+           ;
+}
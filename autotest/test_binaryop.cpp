@@ -0,0 +1,170 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "layer/binaryop.h"
+#include "layer/eltwise.h"
+
+static int test_binaryop(const ncnn::Mat& _a, const ncnn::Mat& _b, int op_type)
+{
+    // pow takes positive bases
+    ncnn::Mat a = _a.clone();
+    ncnn::Mat b = _b.clone();
+    if (op_type == 6)
+    {
+        randomize(a, 0.01f, 2.f);
+        randomize(b, -2.f, 2.f);
+    }
+
+    ncnn::ParamDict pd;
+    pd.set(0, op_type);// op_type
+
+    std::vector<ncnn::Mat> weights(0);
+
+    std::vector<ncnn::Mat> ab(2);
+    ab[0] = a;
+    ab[1] = b;
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::BinaryOp>("BinaryOp", pd, weights, opt, ab);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_binaryop failed a.dims=%d a=(%d %d %d) b.dims=%d b=(%d %d %d) op_type=%d\n", a.dims, a.w, a.h, a.c, b.dims, b.w, b.h, b.c, op_type);
+    }
+
+    return ret;
+}
+
+static int test_binaryop_scalar(const ncnn::Mat& _a, int op_type, float b)
+{
+    ncnn::Mat a = _a.clone();
+    if (op_type == 6)
+        randomize(a, 0.01f, 2.f);
+
+    ncnn::ParamDict pd;
+    pd.set(0, op_type);// op_type
+    pd.set(1, 1);// with_scalar
+    pd.set(2, b);// b
+
+    std::vector<ncnn::Mat> weights(0);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::BinaryOp>("BinaryOp", pd, weights, opt, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_binaryop_scalar failed a.dims=%d a=(%d %d %d) op_type=%d b=%f\n", a.dims, a.w, a.h, a.c, op_type, b);
+    }
+
+    return ret;
+}
+
+// same shapes and every broadcast of the second blob, both ways round
+static int test_binaryop_0()
+{
+    for (int op_type=0; op_type<7; op_type++)
+    {
+        int ret = 0
+                  || test_binaryop(random_mat(13, 11, 3), random_mat(13, 11, 3), op_type)
+                  || test_binaryop(random_mat(8, 4, 16), random_mat(8, 4, 16), op_type)
+                  || test_binaryop(random_mat(13, 11, 3), random_mat(11, 3), op_type)
+                  || test_binaryop(random_mat(13, 11, 3), random_mat(3), op_type)
+                  || test_binaryop(random_mat(13, 11, 3), random_mat(1), op_type)
+                  || test_binaryop(random_mat(11, 3), random_mat(13, 11, 3), op_type)
+                  || test_binaryop(random_mat(3), random_mat(13, 11, 3), op_type)
+                  || test_binaryop(random_mat(1), random_mat(13, 11, 3), op_type)
+                  || test_binaryop(random_mat(13, 9), random_mat(13, 9), op_type)
+                  || test_binaryop(random_mat(13, 9), random_mat(9), op_type)
+                  || test_binaryop(random_mat(9), random_mat(13, 9), op_type)
+                  || test_binaryop(random_mat(67), random_mat(67), op_type)
+                  || test_binaryop(random_mat(67), random_mat(1), op_type)
+                  || test_binaryop(random_mat(1), random_mat(67), op_type)
+                  || test_binaryop_scalar(random_mat(13, 11, 3), op_type, 0.7f)
+                  || test_binaryop_scalar(random_mat(13, 9), op_type, -1.3f)
+                  || test_binaryop_scalar(random_mat(67), op_type, 2.f)
+                  ;
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int test_eltwise(const ncnn::Mat& a, int input_count, int op_type, int with_coeffs)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, op_type);// op_type
+
+    if (with_coeffs)
+    {
+        ncnn::Mat coeffs = random_mat(input_count);
+        pd.set(1, coeffs);// coeffs
+    }
+
+    std::vector<ncnn::Mat> weights(0);
+
+    std::vector<ncnn::Mat> inputs(input_count);
+    for (int i=0; i<input_count; i++)
+    {
+        inputs[i] = a.clone();
+        randomize(inputs[i]);
+    }
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::Eltwise>("Eltwise", pd, weights, opt, inputs);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_eltwise failed a.dims=%d a=(%d %d %d) input_count=%d op_type=%d with_coeffs=%d\n", a.dims, a.w, a.h, a.c, input_count, op_type, with_coeffs);
+    }
+
+    return ret;
+}
+
+static int test_eltwise_0()
+{
+    for (int op_type=0; op_type<3; op_type++)
+    {
+        for (int input_count=2; input_count<=3; input_count++)
+        {
+            int ret = 0
+                      || test_eltwise(random_mat(13, 11, 3), input_count, op_type, 0)
+                      || test_eltwise(random_mat(8, 4, 16), input_count, op_type, 0)
+                      || test_eltwise(random_mat(13, 9), input_count, op_type, 0)
+                      || test_eltwise(random_mat(67), input_count, op_type, 0)
+                      ;
+            if (ret != 0)
+                return ret;
+        }
+    }
+
+    // weighted sum
+    return 0
+           || test_eltwise(random_mat(13, 11, 3), 2, 1, 1)
+           || test_eltwise(random_mat(8, 4, 16), 3, 1, 1)
+           || test_eltwise(random_mat(67), 2, 1, 1)
+           ;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_binaryop_0()
+           || test_eltwise_0()
+           ;
+}
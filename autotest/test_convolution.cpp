@@ -0,0 +1,118 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "layer/convolution.h"
+
+static int test_convolution(int w, int h, int c, int outch, int kernel, int dilation, int stride, int pad, int bias, const char* expect_kernel, int activation_type = 0)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);// num_output
+    pd.set(1, kernel);// kernel_w
+    pd.set(2, dilation);// dilation_w
+    pd.set(3, stride);// stride_w
+    pd.set(4, pad);// pad_w
+    pd.set(5, bias);// bias_term
+    pd.set(6, outch * c * kernel * kernel);
+
+    if (activation_type)
+    {
+        ncnn::Mat activation_params(1);
+        activation_params[0] = 0.1f;// leaky slope
+        pd.set(9, activation_type);
+        pd.set(10, activation_params);
+    }
+
+    std::vector<ncnn::Mat> weights(bias ? 2 : 1);
+    weights[0] = random_mat(outch * c * kernel * kernel);
+    if (bias)
+        weights[1] = random_mat(outch);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::Convolution>("Convolution", pd, weights, opt, a, 0.001f, expect_kernel);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_convolution failed w=%d h=%d c=%d outch=%d kernel=%d dilation=%d stride=%d pad=%d bias=%d act=%d\n", w, h, c, outch, kernel, dilation, stride, pad, bias, activation_type);
+    }
+
+    return ret;
+}
+
+// 3x3 s1 with at least 16 channels in and out
+static int test_convolution_winograd()
+{
+    return 0
+           || test_convolution(13, 11, 16, 16, 3, 1, 1, 1, 1, "conv3x3s1_winograd64")
+           || test_convolution(9, 7, 17, 23, 3, 1, 1, 0, 1, "conv3x3s1_winograd64")
+           || test_convolution(15, 15, 19, 16, 3, 1, 1, 1, 0, "conv3x3s1_winograd64")
+           || test_convolution(6, 6, 16, 18, 3, 1, 1, -233, 1, "conv3x3s1_winograd64")
+           || test_convolution(4, 5, 16, 16, 3, 1, 1, 1, 1, "conv3x3s1_winograd64", 2)
+           || test_convolution(27, 19, 32, 21, 3, 1, 1, 1, 1, "conv3x3s1_winograd64", 1)
+           || test_convolution(14, 15, 17, 19, 3, 1, 1, 1, 1, "conv3x3s1_winograd64", 2)
+           // tiny maps fall back to the direct kernel
+           || test_convolution(4, 4, 16, 16, 3, 1, 1, 0, 1, "direct")
+           ;
+}
+
+static int test_convolution_direct()
+{
+    return 0
+           || test_convolution(11, 9, 3, 5, 3, 1, 1, 1, 1, "direct")
+           || test_convolution(10, 13, 7, 6, 3, 1, 1, 0, 0, "direct")
+           || test_convolution(12, 11, 5, 7, 5, 1, 1, 2, 1, "direct")
+           || test_convolution(9, 9, 6, 3, 5, 1, 1, 0, 1, "direct", 1)
+           ;
+}
+
+static int test_convolution_im2col()
+{
+    return 0
+           || test_convolution(13, 11, 3, 5, 3, 1, 2, 1, 1, "im2col_sgemm")
+           || test_convolution(12, 10, 7, 9, 3, 2, 1, 2, 1, "im2col_sgemm")
+           || test_convolution(15, 14, 5, 6, 7, 1, 2, 3, 0, "im2col_sgemm")
+           || test_convolution(11, 13, 6, 13, 2, 1, 2, 0, 1, "im2col_sgemm")
+           || test_convolution(17, 9, 9, 7, 4, 1, 3, 1, 1, "im2col_sgemm", 2)
+           || test_convolution(10, 10, 3, 8, 3, 1, 2, -233, 1, "im2col_sgemm")
+           // padded 1x1
+           || test_convolution(7, 9, 5, 11, 1, 1, 1, 1, 1, "im2col_sgemm")
+           ;
+}
+
+static int test_convolution_1x1()
+{
+    return 0
+           || test_convolution(13, 11, 3, 5, 1, 1, 1, 0, 1, "conv1x1s1_sgemm")
+           || test_convolution(9, 7, 17, 13, 1, 1, 1, 0, 0, "conv1x1s1_sgemm")
+           || test_convolution(7, 5, 16, 24, 1, 1, 1, 0, 1, "conv1x1s1_sgemm", 1)
+           || test_convolution(19, 13, 20, 28, 1, 1, 1, 0, 1, "conv1x1s1_sgemm", 2)
+           || test_convolution(13, 11, 7, 9, 1, 1, 2, 0, 1, "conv1x1s2_sgemm")
+           || test_convolution(12, 10, 16, 8, 1, 1, 2, 0, 1, "conv1x1s2_sgemm", 2)
+           ;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_convolution_winograd()
+           || test_convolution_direct()
+           || test_convolution_im2col()
+           || test_convolution_1x1()
+           ;
+}
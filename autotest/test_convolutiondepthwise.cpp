@@ -0,0 +1,100 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "layer/convolutiondepthwise.h"
+
+static int test_convolutiondepthwise(int w, int h, int c, int outch, int group, int kernel, int dilation, int stride, int pad, int bias, const char* expect_kernel, int activation_type = 0)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    const int weight_data_size = outch * (c / group) * kernel * kernel;
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);// num_output
+    pd.set(1, kernel);// kernel_w
+    pd.set(2, dilation);// dilation_w
+    pd.set(3, stride);// stride_w
+    pd.set(4, pad);// pad_w
+    pd.set(5, bias);// bias_term
+    pd.set(6, weight_data_size);
+    pd.set(7, group);
+
+    if (activation_type)
+    {
+        ncnn::Mat activation_params(1);
+        activation_params[0] = 0.1f;// leaky slope
+        pd.set(9, activation_type);
+        pd.set(10, activation_params);
+    }
+
+    std::vector<ncnn::Mat> weights(bias ? 2 : 1);
+    weights[0] = random_mat(weight_data_size);
+    if (bias)
+        weights[1] = random_mat(outch);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::ConvolutionDepthWise>("ConvolutionDepthWise", pd, weights, opt, a, 0.001f, expect_kernel);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_convolutiondepthwise failed w=%d h=%d c=%d outch=%d group=%d kernel=%d dilation=%d stride=%d pad=%d bias=%d act=%d\n", w, h, c, outch, group, kernel, dilation, stride, pad, bias, activation_type);
+    }
+
+    return ret;
+}
+
+// the depthwise kernels take the border inline
+static int test_convolutiondepthwise_depthwise()
+{
+    return 0
+           || test_convolutiondepthwise(13, 11, 3, 3, 3, 3, 1, 1, 1, 1, "convdw3x3s1")
+           || test_convolutiondepthwise(9, 12, 7, 7, 7, 3, 1, 1, 0, 0, "convdw3x3s1")
+           || test_convolutiondepthwise(15, 13, 5, 5, 5, 3, 1, 2, 1, 1, "convdw3x3s2")
+           || test_convolutiondepthwise(10, 9, 6, 6, 6, 3, 1, 2, 0, 1, "convdw3x3s2", 1)
+           || test_convolutiondepthwise(12, 11, 3, 3, 3, 5, 1, 1, 2, 1, "convdw5x5s1")
+           || test_convolutiondepthwise(9, 9, 5, 5, 5, 5, 1, 1, 1, 0, "convdw5x5s1")
+           || test_convolutiondepthwise(17, 14, 7, 7, 7, 5, 1, 2, 2, 1, "convdw5x5s2", 2)
+           || test_convolutiondepthwise(11, 11, 3, 3, 3, 3, 1, 2, -233, 1, "convdw3x3s2")
+           // packed, the channels are a multiple of 4
+           || test_convolutiondepthwise(13, 11, 8, 8, 8, 3, 1, 1, 1, 1, "convdw3x3s1")
+           || test_convolutiondepthwise(11, 9, 12, 12, 12, 3, 1, 2, 1, 1, "convdw3x3s2", 1)
+           || test_convolutiondepthwise(10, 12, 16, 16, 16, 5, 1, 1, 2, 0, "convdw5x5s1")
+           || test_convolutiondepthwise(9, 7, 4, 4, 4, 5, 1, 2, 2, 1, "convdw5x5s2")
+           || test_convolutiondepthwise(18, 13, 8, 8, 8, 3, 1, 1, 1, 1, "convdw3x3s1", 2)
+           ;
+}
+
+// other kernels and groups run through the generic loops or per group ops
+static int test_convolutiondepthwise_group()
+{
+    return 0
+           || test_convolutiondepthwise(11, 9, 5, 5, 5, 3, 2, 1, 2, 1, 0)
+           || test_convolutiondepthwise(12, 10, 3, 3, 3, 7, 1, 1, 3, 1, 0)
+           || test_convolutiondepthwise(13, 11, 6, 9, 3, 3, 1, 1, 1, 1, "group_ops")
+           || test_convolutiondepthwise(9, 10, 8, 6, 2, 3, 1, 2, 0, 0, "group_ops")
+           || test_convolutiondepthwise(10, 7, 15, 10, 5, 1, 1, 1, 0, 1, "group_ops", 1)
+           ;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_convolutiondepthwise_depthwise()
+           || test_convolutiondepthwise_group()
+           ;
+}
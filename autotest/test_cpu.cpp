@@ -0,0 +1,169 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include <typeinfo>
+
+#include "cpu.h"
+#include "platform.h"
+#include "layer/convolution.h"
+#include "layer/convolutiondepthwise.h"
+
+static int test_cpu_features()
+{
+    const int sse41 = ncnn::cpu_support_x86_sse41();
+    const int avx = ncnn::cpu_support_x86_avx();
+    const int avx2 = ncnn::cpu_support_x86_avx2();
+    const int fma = ncnn::cpu_support_x86_fma();
+    const int f16c = ncnn::cpu_support_x86_f16c();
+    const int avx512 = ncnn::cpu_support_x86_avx512();
+
+    fprintf(stderr, "sse41=%d avx=%d avx2=%d fma=%d f16c=%d avx512=%d\n", sse41, avx, avx2, fma, f16c, avx512);
+
+    // the wider sets need the os to save the ymm state of avx
+    if ((avx2 || fma || f16c || avx512) && !avx)
+    {
+        fprintf(stderr, "test_cpu_features reports an avx extension without avx\n");
+        return -1;
+    }
+
+    if (ncnn::get_cpu_count() <= 0)
+    {
+        fprintf(stderr, "test_cpu_features get_cpu_count %d\n", ncnn::get_cpu_count());
+        return -1;
+    }
+
+    return 0;
+}
+
+// the isa build create_layer should pick for this cpu, 0 for the baseline one
+static const char* expect_isa()
+{
+    const char* isa = 0;
+#if NCNN_AVX
+    if (ncnn::cpu_support_x86_avx())
+        isa = "avx";
+#endif
+#if NCNN_AVX2
+    if (ncnn::cpu_support_x86_avx2() && ncnn::cpu_support_x86_fma() && ncnn::cpu_support_x86_f16c())
+        isa = "avx2";
+#endif
+#if NCNN_AVX512
+    if (ncnn::cpu_support_x86_avx512() && ncnn::cpu_support_x86_avx2() && ncnn::cpu_support_x86_fma() && ncnn::cpu_support_x86_f16c())
+        isa = "avx512";
+#endif
+    return isa;
+}
+
+static int test_cpu_dispatch(const char* layer_type, const char* class_name)
+{
+    ncnn::Layer* op = ncnn::create_layer(layer_type);
+    if (!op)
+    {
+        fprintf(stderr, "test_cpu_dispatch create_layer %s failed\n", layer_type);
+        return -1;
+    }
+
+    // the isa builds rename the x86 class with the isa suffix
+    const char* isa = expect_isa();
+    char expect_name[256];
+    if (isa)
+        sprintf(expect_name, "%s_x86_%s", class_name, isa);
+    else
+        sprintf(expect_name, "%s_x86", class_name);
+
+    // mangled names end with the length prefixed class name
+    const char* name = typeid(*op).name();
+    const char* p = strstr(name, expect_name);
+    int ret = p && p[strlen(expect_name)] != '_' ? 0 : -1;
+    if (ret != 0)
+        fprintf(stderr, "test_cpu_dispatch %s created %s, expect %s\n", layer_type, name, expect_name);
+
+    delete op;
+
+    return ret;
+}
+
+static int test_cpu_convolution(int w, int h, int c, int outch, int kernel, int stride, int pad)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);// num_output
+    pd.set(1, kernel);// kernel_w
+    pd.set(3, stride);// stride_w
+    pd.set(4, pad);// pad_w
+    pd.set(5, 1);// bias_term
+    pd.set(6, outch * c * kernel * kernel);
+
+    std::vector<ncnn::Mat> weights(2);
+    weights[0] = random_mat(outch * c * kernel * kernel);
+    weights[1] = random_mat(outch);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::Convolution>("Convolution", pd, weights, opt, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_cpu_convolution failed w=%d h=%d c=%d outch=%d kernel=%d stride=%d pad=%d\n", w, h, c, outch, kernel, stride, pad);
+    }
+
+    return ret;
+}
+
+static int test_cpu_convolutiondepthwise(int w, int h, int c, int kernel, int stride, int pad)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, c);// num_output
+    pd.set(1, kernel);// kernel_w
+    pd.set(3, stride);// stride_w
+    pd.set(4, pad);// pad_w
+    pd.set(5, 1);// bias_term
+    pd.set(6, c * kernel * kernel);
+    pd.set(7, c);// group
+
+    std::vector<ncnn::Mat> weights(2);
+    weights[0] = random_mat(c * kernel * kernel);
+    weights[1] = random_mat(c);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::ConvolutionDepthWise>("ConvolutionDepthWise", pd, weights, opt, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_cpu_convolutiondepthwise failed w=%d h=%d c=%d kernel=%d stride=%d pad=%d\n", w, h, c, kernel, stride, pad);
+    }
+
+    return ret;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_cpu_features()
+           || test_cpu_dispatch("Convolution", "Convolution")
+           || test_cpu_dispatch("ConvolutionDepthWise", "ConvolutionDepthWise")
+           // the isa build runs the same kernels as the generic layer
+           || test_cpu_convolution(13, 11, 8, 12, 3, 1, 1)
+           || test_cpu_convolution(9, 7, 5, 7, 1, 1, 0)
+           || test_cpu_convolution(12, 10, 6, 4, 5, 1, 2)
+           || test_cpu_convolutiondepthwise(13, 11, 8, 3, 1, 1)
+           || test_cpu_convolutiondepthwise(14, 12, 5, 3, 2, 0)
+           ;
+}
@@ -0,0 +1,146 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "net.h"
+
+// counts the layers left after fusion
+class FuseNet : public ncnn::Net
+{
+public:
+    int layer_count() const
+    {
+        int count = 0;
+        for (size_t i=0; i<layers.size(); i++)
+        {
+            if (layers[i])
+                count++;
+        }
+        return count;
+    }
+};
+
+// every op followed by what fuse_network folds into it
+// conv2 runs winograd, the innerproduct takes a 3 dim blob
+// the per channel layers work on 3 dim blobs only, the innerproduct takes just the activation
+static const char* test_fuse_param =
+    "7767517\n"
+    "14 14\n"
+    "Input            data    0 1 data 0=13 1=11 2=5\n"
+    "Convolution      conv1   1 1 data conv1 0=16 1=3 4=1 5=1 6=720\n"
+    "BatchNorm        bn1     1 1 conv1 bn1 0=16\n"
+    "Scale            scale1  1 1 bn1 scale1 0=16 1=1\n"
+    "ReLU             relu1   1 1 scale1 relu1\n"
+    "Convolution      conv2   1 1 relu1 conv2 0=17 1=3 4=1 5=0 6=2448\n"
+    "BatchNorm        bn2     1 1 conv2 bn2 0=17\n"
+    "ReLU             relu2   1 1 bn2 relu2 0=0.1\n"
+    "ConvolutionDepthWise dw3 1 1 relu2 dw3 0=17 1=3 3=2 4=1 5=1 6=153 7=17\n"
+    "Bias             bias3   1 1 dw3 bias3 0=17\n"
+    "Scale            scale3  1 1 bias3 scale3 0=17 1=0\n"
+    "ReLU             relu3   1 1 scale3 relu3\n"
+    "InnerProduct     fc4     1 1 relu3 fc4 0=10 1=1 2=7140\n"
+    "ReLU             relu4   1 1 fc4 relu4 0=0.1\n";
+
+static void append_batchnorm(std::vector<float>& bin, int channels)
+{
+    append_weight(bin, channels, 1);// slope
+    append_weight(bin, channels, 1);// mean
+    append_weight(bin, channels, 1, 0.5f, 2.f);// var
+    append_weight(bin, channels, 1);// bias
+}
+
+static int test_fuse_0()
+{
+    std::vector<float> bin;
+    append_weight(bin, 720, 0);
+    append_weight(bin, 16, 1);
+    append_batchnorm(bin, 16);
+    append_weight(bin, 16, 1);
+    append_weight(bin, 16, 1);
+    append_weight(bin, 2448, 0, -0.3f, 0.3f);
+    append_batchnorm(bin, 17);
+    append_weight(bin, 153, 0);
+    append_weight(bin, 17, 1);
+    append_weight(bin, 17, 1);
+    append_weight(bin, 17, 1);
+    append_weight(bin, 7140, 0, -0.1f, 0.1f);
+    append_weight(bin, 10, 1);
+
+    if (write_file("test_fuse.param", test_fuse_param, strlen(test_fuse_param)) != 0)
+        return -1;
+    if (write_file("test_fuse.bin", &bin[0], bin.size() * sizeof(float)) != 0)
+        return -1;
+
+    ncnn::Net net;
+    FuseNet net_fused;
+
+    int ret = net.load_param("test_fuse.param");
+    if (ret == 0)
+        ret = net.load_model("test_fuse.bin");
+    if (ret == 0)
+        ret = net_fused.load_param("test_fuse.param");
+    if (ret == 0)
+        ret = net_fused.load_model("test_fuse.bin");
+    if (ret == 0)
+        ret = net_fused.fuse_network();
+
+    remove("test_fuse.param");
+    remove("test_fuse.bin");
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_fuse load failed %d\n", ret);
+        return -1;
+    }
+
+    // input and the four ops
+    if (net_fused.layer_count() != 5)
+    {
+        fprintf(stderr, "test_fuse %d layers left after fusion, expect 5\n", net_fused.layer_count());
+        return -1;
+    }
+
+    ncnn::Mat in = random_mat(13, 11, 5);
+
+    ncnn::Mat out;
+    ncnn::Mat out_fused;
+
+    ncnn::Extractor ex = net.create_extractor();
+    ex.input("data", in);
+    ret = ex.extract("relu4", out);
+
+    ncnn::Extractor ex_fused = net_fused.create_extractor();
+    ex_fused.input("data", in);
+    if (ret == 0)
+        ret = ex_fused.extract("relu4", out_fused);
+
+    if (ret == 0)
+        ret = compare_mat(out, out_fused, 0.001f);
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_fuse output differs\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return test_fuse_0();
+}
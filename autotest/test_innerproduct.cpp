@@ -0,0 +1,83 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "layer/innerproduct.h"
+
+static int test_innerproduct(const ncnn::Mat& a, int outch, int bias, int activation_type = 0, float epsilon = 0.001f, const char* expect_kernel = "pack")
+{
+    const int num_input = a.w * a.h * a.c;
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);// num_output
+    pd.set(1, bias);// bias_term
+    pd.set(2, outch * num_input);
+
+    if (activation_type)
+    {
+        ncnn::Mat activation_params(1);
+        activation_params[0] = 0.1f;// leaky slope
+        pd.set(9, activation_type);
+        pd.set(10, activation_params);
+    }
+
+    std::vector<ncnn::Mat> weights(bias ? 2 : 1);
+    weights[0] = random_mat(outch * num_input);
+    if (bias)
+        weights[1] = random_mat(outch);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::InnerProduct>("InnerProduct", pd, weights, opt, a, epsilon, expect_kernel);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_innerproduct failed a.dims=%d a=(%d %d %d) outch=%d bias=%d act=%d\n", a.dims, a.w, a.h, a.c, outch, bias, activation_type);
+    }
+
+    return ret;
+}
+
+// the f16c builds keep the packed weights in fp16, create_pipeline takes the flag from the default option
+// whether pack_fp16 runs depends on the cpu, so the kernel is not checked
+static int test_innerproduct_fp16(const ncnn::Mat& a, int outch, int bias)
+{
+    ncnn::Option opt = ncnn::get_default_option();
+    opt.use_fp16_storage = true;
+    ncnn::set_default_option(opt);
+
+    int ret = test_innerproduct(a, outch, bias, 0, 0.01f, 0);
+
+    opt.use_fp16_storage = false;
+    ncnn::set_default_option(opt);
+
+    return ret;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_innerproduct(random_mat(1), 1, 1)
+           || test_innerproduct(random_mat(13), 5, 1)
+           || test_innerproduct(random_mat(67), 19, 0)
+           || test_innerproduct(random_mat(256), 33, 1, 1)
+           || test_innerproduct(random_mat(5, 3, 7), 11, 1)
+           || test_innerproduct(random_mat(7, 9, 16), 24, 0, 2)
+           || test_innerproduct(random_mat(1, 1, 1023), 17, 1)
+           || test_innerproduct_fp16(random_mat(67), 19, 1)
+           || test_innerproduct_fp16(random_mat(7, 9, 16), 24, 0)
+           ;
+}
@@ -0,0 +1,149 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "layer/convolution.h"
+#include "layer/innerproduct.h"
+
+// calibrated scales as ncnn2table writes them, the largest magnitude maps to 127
+static ncnn::Mat int8_weight_scales(const ncnn::Mat& weight_data, int num_output)
+{
+    const int size = weight_data.w / num_output;
+
+    ncnn::Mat scales(num_output);
+    for (int p=0; p<num_output; p++)
+    {
+        const float* ptr = (const float*)weight_data + size * p;
+
+        float absmax = 0.f;
+        for (int i=0; i<size; i++)
+        {
+            absmax = std::max(absmax, (float)fabs(ptr[i]));
+        }
+
+        scales[p] = absmax == 0.f ? 1.f : 127.f / absmax;
+    }
+
+    return scales;
+}
+
+static ncnn::Mat int8_bottom_scale(const ncnn::Mat& a)
+{
+    float absmax = 0.f;
+    for (int i=0; i<(int)a.total(); i++)
+    {
+        absmax = std::max(absmax, (float)fabs(a[i]));
+    }
+
+    ncnn::Mat scale(1);
+    scale[0] = 127.f / absmax;
+    return scale;
+}
+
+static int test_convolution_int8(int w, int h, int c, int outch, int kernel, int dilation, int stride, int pad, int bias)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);// num_output
+    pd.set(1, kernel);// kernel_w
+    pd.set(2, dilation);// dilation_w
+    pd.set(3, stride);// stride_w
+    pd.set(4, pad);// pad_w
+    pd.set(5, bias);// bias_term
+    pd.set(6, outch * c * kernel * kernel);
+    pd.set(8, 1);// int8_scale_term
+
+    std::vector<ncnn::Mat> weights(bias ? 4 : 3);
+    weights[0] = random_mat(outch * c * kernel * kernel);
+    if (bias)
+        weights[1] = random_mat(outch);
+    weights[bias ? 2 : 1] = int8_weight_scales(weights[0], outch);
+    weights[bias ? 3 : 2] = int8_bottom_scale(a);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::Convolution>("Convolution", pd, weights, opt, a, 0.001f, "im2col_sgemm_int8");
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_convolution_int8 failed w=%d h=%d c=%d outch=%d kernel=%d dilation=%d stride=%d pad=%d bias=%d\n", w, h, c, outch, kernel, dilation, stride, pad, bias);
+    }
+
+    return ret;
+}
+
+static int test_innerproduct_int8(int w, int h, int c, int outch, int bias)
+{
+    ncnn::Mat a = h == 0 ? random_mat(w) : random_mat(w, h, c);
+
+    const int num_input = h == 0 ? w : w * h * c;
+
+    ncnn::ParamDict pd;
+    pd.set(0, outch);// num_output
+    pd.set(1, bias);// bias_term
+    pd.set(2, outch * num_input);
+    pd.set(8, 1);// int8_scale_term
+
+    std::vector<ncnn::Mat> weights(bias ? 4 : 3);
+    weights[0] = random_mat(outch * num_input);
+    if (bias)
+        weights[1] = random_mat(outch);
+    weights[bias ? 2 : 1] = int8_weight_scales(weights[0], outch);
+    weights[bias ? 3 : 2] = int8_bottom_scale(a);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::InnerProduct>("InnerProduct", pd, weights, opt, a, 0.001f, "int8_sse");
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_innerproduct_int8 failed w=%d h=%d c=%d outch=%d bias=%d\n", w, h, c, outch, bias);
+    }
+
+    return ret;
+}
+
+static int test_convolution_int8_0()
+{
+    return 0
+           || test_convolution_int8(13, 11, 3, 5, 3, 1, 1, 1, 1)
+           || test_convolution_int8(9, 7, 16, 16, 3, 1, 1, 0, 1)
+           || test_convolution_int8(12, 10, 7, 9, 3, 2, 2, 2, 0)
+           || test_convolution_int8(11, 13, 5, 13, 1, 1, 1, 0, 1)
+           || test_convolution_int8(15, 9, 17, 6, 1, 1, 2, 0, 1)
+           || test_convolution_int8(10, 12, 6, 7, 5, 1, 1, 2, 1)
+           || test_convolution_int8(14, 11, 9, 11, 7, 1, 2, 3, 0)
+           || test_convolution_int8(10, 10, 3, 8, 3, 1, 2, -233, 1)
+           ;
+}
+
+static int test_innerproduct_int8_0()
+{
+    return 0
+           || test_innerproduct_int8(13, 0, 0, 5, 1)
+           || test_innerproduct_int8(67, 0, 0, 19, 0)
+           || test_innerproduct_int8(5, 3, 7, 11, 1)
+           || test_innerproduct_int8(7, 9, 16, 33, 1)
+           ;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_convolution_int8_0()
+           || test_innerproduct_int8_0()
+           ;
+}
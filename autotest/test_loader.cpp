@@ -0,0 +1,194 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "net.h"
+
+// layers whose x86 paths transform the weights, winograd, sgemm and packed innerproduct
+static const char* test_loader_param =
+    "7767517\n"
+    "6 6\n"
+    "Input            data   0 1 data 0=13 1=11 2=16\n"
+    "Convolution      conv1  1 1 data conv1 0=17 1=3 4=1 5=1 6=2448 9=1\n"
+    "Convolution      conv2  1 1 conv1 conv2 0=9 1=3 3=2 4=1 5=1 6=1377\n"
+    "ConvolutionDepthWise dw3 1 1 conv2 dw3 0=9 1=3 4=1 5=1 6=81 7=9\n"
+    "Convolution      conv4  1 1 dw3 conv4 0=12 1=1 5=1 6=108\n"
+    "InnerProduct     fc5    1 1 conv4 fc5 0=7 1=1 2=3528\n";
+
+static int test_loader_extract(const ncnn::Net& net, const ncnn::Mat& in, ncnn::Mat& out)
+{
+    ncnn::Extractor ex = net.create_extractor();
+    ex.input("data", in);
+    return ex.extract("fc5", out);
+}
+
+static int test_loader_0()
+{
+    std::vector<float> bin;
+    append_weight(bin, 2448, 0, -0.3f, 0.3f);
+    append_weight(bin, 17, 1);
+    append_weight(bin, 1377, 0, -0.3f, 0.3f);
+    append_weight(bin, 9, 1);
+    append_weight(bin, 81, 0);
+    append_weight(bin, 9, 1);
+    append_weight(bin, 108, 0);
+    append_weight(bin, 12, 1);
+    append_weight(bin, 3528, 0, -0.1f, 0.1f);
+    append_weight(bin, 7, 1);
+
+    if (write_file("test_loader.param", test_loader_param, strlen(test_loader_param)) != 0)
+        return -1;
+    if (write_file("test_loader.bin", &bin[0], bin.size() * sizeof(float)) != 0)
+        return -1;
+
+    remove("test_loader.cache");
+
+    ncnn::Mat in = random_mat(13, 11, 16);
+
+    // stdio load_model is the reference
+    ncnn::Mat out_ref;
+    {
+        ncnn::Net net;
+        int ret = net.load_param("test_loader.param");
+        if (ret == 0)
+            ret = net.load_model("test_loader.bin");
+        if (ret == 0)
+            ret = test_loader_extract(net, in, out_ref);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_loader load_model failed %d\n", ret);
+            return -1;
+        }
+    }
+
+    // the weights in memory, referenced in place
+    {
+        ncnn::Net net;
+        ncnn::Mat out;
+        int ret = net.load_param("test_loader.param");
+        if (ret == 0)
+            ret = net.load_model((const unsigned char*)&bin[0]) == (int)(bin.size() * sizeof(float)) ? 0 : -1;
+        if (ret == 0)
+            ret = test_loader_extract(net, in, out);
+        if (ret == 0)
+            ret = compare_mat(out_ref, out, 0.f);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_loader load_model memory failed\n");
+            return -1;
+        }
+    }
+
+    // create_pipeline runs over the layers on the default option's threads
+    {
+        ncnn::Option opt = ncnn::get_default_option();
+        ncnn::Option opt_threads = opt;
+        opt_threads.num_threads = 4;
+        ncnn::set_default_option(opt_threads);
+
+        ncnn::Net net;
+        ncnn::Mat out;
+        int ret = net.load_param("test_loader.param");
+        if (ret == 0)
+            ret = net.load_model("test_loader.bin");
+
+        ncnn::set_default_option(opt);
+
+        if (ret == 0)
+            ret = test_loader_extract(net, in, out);
+        if (ret == 0)
+            ret = compare_mat(out_ref, out, 0.f);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_loader load_model 4 threads failed\n");
+            return -1;
+        }
+    }
+
+    // mapped, with and without prefault
+    for (int prefault=0; prefault<2; prefault++)
+    {
+        ncnn::Net net;
+        ncnn::Mat out;
+        int ret = net.load_param("test_loader.param");
+        if (ret == 0)
+            ret = net.load_model_mmap("test_loader.bin", prefault);
+        if (ret == 0)
+            ret = test_loader_extract(net, in, out);
+        if (ret == 0)
+            ret = compare_mat(out_ref, out, 0.f);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_loader load_model_mmap prefault=%d failed\n", prefault);
+            return -1;
+        }
+    }
+
+    // the first load writes the prepared cache, the second one reads it back
+    for (int i=0; i<2; i++)
+    {
+        ncnn::Net net;
+        ncnn::Mat out;
+        int ret = net.load_param("test_loader.param");
+        if (ret == 0)
+            ret = net.load_model_prepared("test_loader.bin", "test_loader.cache");
+        if (ret == 0)
+            ret = test_loader_extract(net, in, out);
+        if (ret == 0)
+            ret = compare_mat(out_ref, out, 0.f);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_loader load_model_prepared run %d failed\n", i);
+            return -1;
+        }
+
+        FILE* fp = fopen("test_loader.cache", "rb");
+        if (!fp)
+        {
+            fprintf(stderr, "test_loader prepared cache not written\n");
+            return -1;
+        }
+        fclose(fp);
+    }
+
+    // a truncated file fails the load instead of reading past the mapping
+    if (write_file("test_loader.bin", &bin[0], (bin.size() - 16) * sizeof(float)) != 0)
+        return -1;
+
+    {
+        ncnn::Net net;
+        int ret = net.load_param("test_loader.param");
+        if (ret == 0)
+            ret = net.load_model_mmap("test_loader.bin") == 0 ? -1 : 0;
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_loader load_model_mmap truncated file loaded\n");
+            return -1;
+        }
+    }
+
+    remove("test_loader.param");
+    remove("test_loader.bin");
+    remove("test_loader.cache");
+
+    return 0;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return test_loader_0();
+}
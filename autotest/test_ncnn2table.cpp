@@ -0,0 +1,268 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include <math.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+
+#include "net.h"
+
+// runs the ncnn2table and ncnnoptimize executables given on the command line
+// on a small float model and a directory of random ppm images
+
+static const char* ncnn2table_path = 0;
+static const char* ncnnoptimize_path = 0;
+
+static const char* test_param =
+    "7767517\n"
+    "4 4\n"
+    "Input            data   0 1 data 0=12 1=12 2=3\n"
+    "Convolution      conv1  1 1 data conv1 0=4 1=3 4=1 5=1 6=108\n"
+    "ReLU             relu1  1 1 conv1 relu1\n"
+    "InnerProduct     fc     1 1 relu1 fc 0=10 1=1 2=5760\n";
+
+static int write_ppm(const char* path, int w, int h)
+{
+    char header[64];
+    int headersize = sprintf(header, "P6\n%d %d\n255\n", w, h);
+
+    std::vector<unsigned char> data(header, header + headersize);
+    for (int i=0; i<w * h * 3; i++)
+    {
+        data.push_back((unsigned char)random_float(0.f, 255.f));
+    }
+
+    return write_file(path, &data[0], data.size());
+}
+
+// table entries by kind and name
+static int read_table(const char* path, std::map<std::string, std::vector<float> >& weights, std::map<std::string, float>& blobs)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", path);
+        return -1;
+    }
+
+    char line[4096];
+    while (fgets(line, sizeof(line), fp))
+    {
+        char kind[16];
+        char name[256];
+        int pos = 0;
+        if (line[0] == '#' || sscanf(line, "%15s %255s%n", kind, name, &pos) != 2)
+            continue;
+
+        std::vector<float> vals;
+        const char* s = line + pos;
+        float v;
+        int n;
+        while (sscanf(s, "%f%n", &v, &n) == 1)
+        {
+            vals.push_back(v);
+            s += n;
+        }
+
+        if (strcmp(kind, "weight") == 0)
+            weights[name] = vals;
+        else if (strcmp(kind, "blob") == 0 && vals.size() == 1)
+            blobs[name] = vals[0];
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+static int check_weight_scales(const std::vector<float>& scales, const float* weights, int num_output, int size)
+{
+    if ((int)scales.size() != num_output)
+    {
+        fprintf(stderr, "%d weight scales, expect %d\n", (int)scales.size(), num_output);
+        return -1;
+    }
+
+    for (int p=0; p<num_output; p++)
+    {
+        float absmax = 0.f;
+        for (int i=0; i<size; i++)
+        {
+            absmax = std::max(absmax, (float)fabs(weights[size * p + i]));
+        }
+
+        if (fabs(scales[p] * absmax - 127.f) > 0.01f)
+        {
+            fprintf(stderr, "weight scale %d is %f, absmax %f\n", p, scales[p], absmax);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int run_net(const char* param, const char* bin, const ncnn::Mat& in, ncnn::Mat& out)
+{
+    ncnn::Net net;
+    if (net.load_param(param) != 0 || net.load_model(bin) != 0)
+    {
+        fprintf(stderr, "load %s %s failed\n", param, bin);
+        return -1;
+    }
+
+    ncnn::Extractor ex = net.create_extractor();
+    ex.input("data", in);
+    return ex.extract("fc", out);
+}
+
+static int test_ncnn2table(const char* method)
+{
+    if (write_file("test_ncnn2table.param", test_param, strlen(test_param)) != 0)
+        return -1;
+
+    std::vector<float> bin;
+    append_weight(bin, 108, 0, -0.5f, 0.5f);
+    append_weight(bin, 4, 1);
+    append_weight(bin, 5760, 0, -0.1f, 0.1f);
+    append_weight(bin, 10, 1);
+
+    if (write_file("test_ncnn2table.bin", &bin[0], bin.size() * sizeof(float)) != 0)
+        return -1;
+
+    mkdir("test_ncnn2table_images", 0755);
+    for (int i=0; i<4; i++)
+    {
+        char path[256];
+        sprintf(path, "test_ncnn2table_images/%d.ppm", i);
+        if (write_ppm(path, 16, 16) != 0)
+            return -1;
+    }
+
+    char cmd[1024];
+    sprintf(cmd, "\"%s\" test_ncnn2table.param test_ncnn2table.bin test_ncnn2table_images test_ncnn2table.table size=12,12 norm=0.00392157,0.00392157,0.00392157 method=%s > test_ncnn2table.log", ncnn2table_path, method);
+    if (system(cmd) != 0)
+    {
+        fprintf(stderr, "ncnn2table method=%s failed\n", method);
+        return -1;
+    }
+
+    std::map<std::string, std::vector<float> > weights;
+    std::map<std::string, float> blobs;
+    if (read_table("test_ncnn2table.table", weights, blobs) != 0)
+        return -1;
+
+    // the weight scales come straight from the per output channel absmax
+    if (weights.count("conv1") == 0 || weights.count("fc") == 0)
+    {
+        fprintf(stderr, "weight entry missing\n");
+        return -1;
+    }
+
+    if (check_weight_scales(weights["conv1"], &bin[1], 4, 27) != 0)
+        return -1;
+
+    if (check_weight_scales(weights["fc"], &bin[1 + 108 + 4 + 1], 10, 576) != 0)
+        return -1;
+
+    // the inputs lie in [0, 1], a clipping threshold may only shrink the range
+    if (blobs.count("data") == 0 || blobs.count("relu1") == 0)
+    {
+        fprintf(stderr, "blob entry missing\n");
+        return -1;
+    }
+
+    if (!(blobs["data"] >= 127.f * 0.999f) || !(blobs["relu1"] > 0.f))
+    {
+        fprintf(stderr, "blob scale data %f relu1 %f\n", blobs["data"], blobs["relu1"]);
+        return -1;
+    }
+
+    // the quantized model stays close to the float one
+    sprintf(cmd, "\"%s\" test_ncnn2table.param test_ncnn2table.bin test_ncnn2table_int8.param test_ncnn2table_int8.bin test_ncnn2table.table", ncnnoptimize_path);
+    if (system(cmd) != 0)
+    {
+        fprintf(stderr, "ncnnoptimize failed\n");
+        return -1;
+    }
+
+    ncnn::Mat in = random_mat(12, 12, 3);
+    for (int i=0; i<(int)in.total(); i++)
+    {
+        in[i] = (in[i] + 1.2f) / 2.4f;
+    }
+
+    ncnn::Mat out;
+    ncnn::Mat out_int8;
+    if (run_net("test_ncnn2table.param", "test_ncnn2table.bin", in, out) != 0)
+        return -1;
+
+    if (run_net("test_ncnn2table_int8.param", "test_ncnn2table_int8.bin", in, out_int8) != 0)
+        return -1;
+
+    double dot = 0;
+    double sq = 0;
+    double sq_int8 = 0;
+    for (int i=0; i<(int)out.total(); i++)
+    {
+        dot += out[i] * out_int8[i];
+        sq += out[i] * out[i];
+        sq_int8 += out_int8[i] * out_int8[i];
+    }
+
+    double cosine = sq == 0 || sq_int8 == 0 ? 0 : dot / sqrt(sq * sq_int8);
+    if (out_int8.w != out.w || cosine < 0.99)
+    {
+        fprintf(stderr, "int8 output cosine %f method=%s\n", cosine, method);
+        return -1;
+    }
+
+    for (int i=0; i<4; i++)
+    {
+        char path[256];
+        sprintf(path, "test_ncnn2table_images/%d.ppm", i);
+        remove(path);
+    }
+    rmdir("test_ncnn2table_images");
+    remove("test_ncnn2table.param");
+    remove("test_ncnn2table.bin");
+    remove("test_ncnn2table.table");
+    remove("test_ncnn2table.log");
+    remove("test_ncnn2table_int8.param");
+    remove("test_ncnn2table_int8.bin");
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s [ncnn2table] [ncnnoptimize]\n", argv[0]);
+        return -1;
+    }
+
+    ncnn2table_path = argv[1];
+    ncnnoptimize_path = argv[2];
+
+    srand(7767517);
+
+    return 0
+           || test_ncnn2table("kl")
+           || test_ncnn2table("percentile")
+           ;
+}
@@ -0,0 +1,432 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include <string>
+
+#include "net.h"
+
+static int load_test_net(ncnn::Net& net, const char* param, const std::vector<float>& bin)
+{
+    if (write_file("test_net.param", param, strlen(param)) != 0)
+        return -1;
+
+    int ret = net.load_param("test_net.param");
+    remove("test_net.param");
+
+    if (ret == 0 && !bin.empty())
+    {
+        if (write_file("test_net.bin", &bin[0], bin.size() * sizeof(float)) != 0)
+            return -1;
+
+        ret = net.load_model("test_net.bin");
+        remove("test_net.bin");
+    }
+
+    if (ret != 0)
+        fprintf(stderr, "load_test_net failed %d\n", ret);
+
+    return ret;
+}
+
+// a chain far deeper than a recursive walk could take on the stack
+static int test_net_deep(int depth)
+{
+    std::string param;
+    char line[256];
+
+    sprintf(line, "7767517\n%d %d\n", depth + 1, depth + 1);
+    param += line;
+    param += "Input            b0     0 1 b0 0=7 1=5 2=3\n";
+    for (int i=0; i<depth; i++)
+    {
+        sprintf(line, "Power            p%d 1 1 b%d b%d 2=0.001\n", i + 1, i, i + 1);
+        param += line;
+    }
+
+    ncnn::Net net;
+    if (load_test_net(net, param.c_str(), std::vector<float>()) != 0)
+        return -1;
+
+    ncnn::Mat in = random_mat(7, 5, 3);
+
+    for (int light_mode=0; light_mode<2; light_mode++)
+    {
+        ncnn::Extractor ex = net.create_extractor();
+        ex.set_light_mode(light_mode);
+        ex.input("b0", in);
+
+        ncnn::Mat out;
+        sprintf(line, "b%d", depth);
+        int ret = ex.extract(line, out);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_net_deep extract failed %d\n", ret);
+            return -1;
+        }
+
+        ncnn::Mat out_ref = in.clone();
+        for (int i=0; i<depth; i++)
+        {
+            for (int j=0; j<(int)out_ref.total(); j++)
+            {
+                out_ref[j] += 0.001f;
+            }
+        }
+
+        if (compare_mat(out_ref, out, 0.001f) != 0)
+        {
+            fprintf(stderr, "test_net_deep depth=%d light_mode=%d failed\n", depth, light_mode);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// a blob consumed by both branches and by the output
+static const char* test_net_branch_param =
+    "7767517\n"
+    "8 10\n"
+    "Input            data   0 1 data 0=11 1=9 2=8\n"
+    "Split            split1 1 3 data split1a split1b split1c\n"
+    "Convolution      conv2  1 1 split1a conv2 0=8 1=3 4=1 5=1 6=576\n"
+    "ReLU             relu3  1 1 conv2 relu3\n"
+    "Convolution      conv4  1 1 split1b conv4 0=8 1=1 5=1 6=64\n"
+    "Eltwise          sum5   2 1 relu3 conv4 sum5 0=1\n"
+    "Eltwise          sum6   2 1 sum5 split1c sum6 0=1\n"
+    "Pooling          pool7  1 1 sum6 pool7 0=0 1=2 2=2\n";
+
+static int test_net_branch()
+{
+    std::vector<float> bin;
+    append_weight(bin, 576, 0, -0.3f, 0.3f);
+    append_weight(bin, 8, 1);
+    append_weight(bin, 64, 0);
+    append_weight(bin, 8, 1);
+
+    ncnn::Net net;
+    if (load_test_net(net, test_net_branch_param, bin) != 0)
+        return -1;
+
+    ncnn::Mat in = random_mat(11, 9, 8);
+
+    ncnn::Mat out_ref;
+    ncnn::Mat sum5_ref;
+    {
+        ncnn::Extractor ex = net.create_extractor();
+        ex.set_light_mode(false);
+        ex.input("data", in);
+        int ret = ex.extract("pool7", out_ref);
+        if (ret == 0)
+            ret = ex.extract("sum5", sum5_ref);
+        if (ret != 0)
+            return -1;
+    }
+
+    // the shared blob survives until its last consumer in light mode
+    {
+        ncnn::Extractor ex = net.create_extractor();
+        ex.set_light_mode(true);
+        ex.input("data", in);
+
+        ncnn::Mat out;
+        int ret = ex.extract("pool7", out);
+        if (ret == 0)
+            ret = compare_mat(out_ref, out, 0.f);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_net_branch light mode failed\n");
+            return -1;
+        }
+    }
+
+    // an intermediate blob first, the later extract picks it up
+    {
+        ncnn::Extractor ex = net.create_extractor();
+        ex.set_light_mode(false);
+        ex.input("data", in);
+
+        ncnn::Mat sum5;
+        ncnn::Mat out;
+        int ret = ex.extract("sum5", sum5);
+        if (ret == 0)
+            ret = ex.extract("pool7", out);
+        if (ret == 0)
+            ret = compare_mat(sum5_ref, sum5, 0.f);
+        if (ret == 0)
+            ret = compare_mat(out_ref, out, 0.f);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_net_branch partial extract failed\n");
+            return -1;
+        }
+    }
+
+    // a blob fed as input stops the walk, the branches before it never run
+    {
+        ncnn::Extractor ex = net.create_extractor();
+        ex.input("data", in);
+        ex.input("sum5", sum5_ref);
+
+        ncnn::Mat out;
+        int ret = ex.extract("pool7", out);
+        if (ret == 0)
+            ret = compare_mat(out_ref, out, 0.f);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_net_branch blob input failed\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// four branches of different cost joined by concat, then two more side by side
+static const char* test_net_branch_parallel_param =
+    "7767517\n"
+    "11 16\n"
+    "Input            data   0 1 data 0=17 1=13 2=8\n"
+    "Split            split1 1 4 data split1a split1b split1c split1d\n"
+    "Convolution      conv2  1 1 split1a conv2 0=8 1=3 4=1 5=1 6=576\n"
+    "Convolution      conv3  1 1 split1b conv3 0=4 1=1 5=1 6=32\n"
+    "ConvolutionDepthWise dw4 1 1 split1c dw4 0=8 1=3 4=1 5=1 6=72 7=8\n"
+    "Pooling          pool5  1 1 split1d pool5 0=1 1=3 3=1\n"
+    "Concat           cat6   4 1 conv2 conv3 dw4 pool5 cat6\n"
+    "Split            split7 1 2 cat6 split7a split7b\n"
+    "Convolution      conv8  1 1 split7a conv8 0=6 1=3 4=1 5=1 6=1512\n"
+    "ReLU             relu9  1 1 split7b relu9\n"
+    "Pooling          pool10 1 1 relu9 pool10 0=0 1=2 2=1\n";
+
+static int test_net_branch_parallel()
+{
+    std::vector<float> bin;
+    append_weight(bin, 576, 0, -0.3f, 0.3f);
+    append_weight(bin, 8, 1);
+    append_weight(bin, 32, 0);
+    append_weight(bin, 4, 1);
+    append_weight(bin, 72, 0);
+    append_weight(bin, 8, 1);
+    append_weight(bin, 1512, 0, -0.2f, 0.2f);
+    append_weight(bin, 6, 1);
+
+    ncnn::Net net;
+    if (load_test_net(net, test_net_branch_parallel_param, bin) != 0)
+        return -1;
+
+    ncnn::Mat in = random_mat(17, 13, 8);
+
+    const char* blob_names[] = { "conv8", "pool10", "cat6" };
+
+    for (int i=0; i<3; i++)
+    {
+        ncnn::Mat out_ref;
+        {
+            ncnn::Extractor ex = net.create_extractor();
+            ex.input("data", in);
+            int ret = ex.extract(blob_names[i], out_ref);
+            if (ret != 0)
+                return -1;
+        }
+
+        // thread counts that do and do not divide among the branches
+        for (int num_threads=1; num_threads<=4; num_threads++)
+        {
+            for (int light_mode=0; light_mode<2; light_mode++)
+            {
+                ncnn::Extractor ex = net.create_extractor();
+                ex.set_branch_parallel(true);
+                ex.set_num_threads(num_threads);
+                ex.set_light_mode(light_mode);
+                ex.input("data", in);
+
+                ncnn::Mat out;
+                int ret = ex.extract(blob_names[i], out);
+                if (ret == 0)
+                    ret = compare_mat(out_ref, out, 0.f);
+                if (ret != 0)
+                {
+                    fprintf(stderr, "test_net_branch_parallel %s num_threads=%d light_mode=%d failed\n", blob_names[i], num_threads, light_mode);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+// the 1x1 convolution and the innerproduct run as gemm over the batch
+static const char* test_net_batch_param =
+    "7767517\n"
+    "6 6\n"
+    "Input            data   0 1 data 0=9 1=7 2=12\n"
+    "Convolution      conv1  1 1 data conv1 0=16 1=1 5=1 6=192\n"
+    "ReLU             relu2  1 1 conv1 relu2\n"
+    "Convolution      conv3  1 1 relu2 conv3 0=8 1=3 4=1 5=0 6=1152\n"
+    "InnerProduct     fc4    1 1 conv3 fc4 0=13 1=1 2=6552\n"
+    "Softmax          prob   1 1 fc4 prob\n";
+
+static int test_net_batch(int batch)
+{
+    std::vector<float> bin;
+    append_weight(bin, 192, 0);
+    append_weight(bin, 16, 1);
+    append_weight(bin, 1152, 0, -0.3f, 0.3f);
+    append_weight(bin, 6552, 0, -0.1f, 0.1f);
+    append_weight(bin, 13, 1);
+
+    ncnn::Net net;
+    if (load_test_net(net, test_net_batch_param, bin) != 0)
+        return -1;
+
+    std::vector<ncnn::Mat> in(batch);
+    for (int i=0; i<batch; i++)
+    {
+        in[i] = random_mat(9, 7, 12);
+    }
+
+    const char* blob_names[] = { "conv1", "prob" };
+
+    for (int light_mode=0; light_mode<2; light_mode++)
+    {
+        ncnn::BatchExtractor ex = net.create_batch_extractor(batch);
+        ex.set_light_mode(light_mode);
+        ex.input("data", in);
+
+        for (int j=0; j<2; j++)
+        {
+            std::vector<ncnn::Mat> out;
+            int ret = ex.extract(blob_names[j], out);
+            if (ret == 0 && (int)out.size() != batch)
+                ret = -1;
+
+            for (int i=0; i<batch && ret == 0; i++)
+            {
+                ncnn::Mat out_ref;
+                ncnn::Extractor ex_ref = net.create_extractor();
+                ex_ref.input("data", in[i]);
+                ret = ex_ref.extract(blob_names[j], out_ref);
+                if (ret == 0)
+                    ret = compare_mat(out_ref, out[i], 0.001f);
+            }
+
+            if (ret != 0)
+            {
+                fprintf(stderr, "test_net_batch %s batch=%d light_mode=%d failed\n", blob_names[j], batch, light_mode);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// padding resolved from the input size, shape changing layers and a flatten
+static const char* test_net_shape_param =
+    "7767517\n"
+    "10 11\n"
+    "Input            data   0 1 data 0=15 1=11 2=4\n"
+    "Convolution      conv1  1 1 data conv1 0=8 1=3 3=2 4=-233 5=1 6=288\n"
+    "Split            split1 1 2 conv1 split1a split1b\n"
+    "ConvolutionDepthWise dw2 1 1 split1a dw2 0=8 1=3 4=1 5=1 6=72 7=8\n"
+    "Pooling          pool3  1 1 split1b pool3 0=1 1=3 2=1 3=1\n"
+    "Concat           cat4   2 1 dw2 pool3 cat4\n"
+    "Eltwise          sum5   2 1 cat4 cat4 sum5 0=1\n"
+    "Pooling          pool6  1 1 sum5 pool6 0=0 1=2 2=2 5=1\n"
+    "Flatten          flat7  1 1 pool6 flat7\n"
+    "InnerProduct     fc8    1 1 flat7 fc8 0=5 1=1 2=960\n";
+
+static int test_net_shape(int w, int h)
+{
+    std::vector<float> bin;
+    append_weight(bin, 288, 0, -0.3f, 0.3f);
+    append_weight(bin, 8, 1);
+    append_weight(bin, 72, 0);
+    append_weight(bin, 8, 1);
+    append_weight(bin, 960, 0, -0.1f, 0.1f);
+    append_weight(bin, 5, 1);
+
+    ncnn::Net net;
+    ncnn::Net net_inferred;
+    if (load_test_net(net, test_net_shape_param, bin) != 0 || load_test_net(net_inferred, test_net_shape_param, bin) != 0)
+        return -1;
+
+    // the kernel plans are made for 15x11, other sizes still work
+    if (net_inferred.infer_shape("data", ncnn::Mat(15, 11, 4, (void*)0)) != 0)
+    {
+        fprintf(stderr, "test_net_shape infer_shape failed\n");
+        return -1;
+    }
+
+    ncnn::Mat in = random_mat(w, h, 4);
+
+    const char* blob_names[] = { "conv1", "dw2", "pool3", "cat4", "sum5", "pool6", "flat7", "fc8" };
+
+    // fc8 only takes the flattened 15x11 input
+    const int blob_count = w == 15 && h == 11 ? 8 : 7;
+
+    for (int i=0; i<blob_count; i++)
+    {
+        ncnn::Mat out_ref;
+        ncnn::Mat out;
+
+        ncnn::Extractor ex_ref = net.create_extractor();
+        ex_ref.input("data", in);
+        int ret = ex_ref.extract(blob_names[i], out_ref);
+
+        ncnn::Extractor ex = net_inferred.create_extractor();
+        ex.input("data", in);
+        if (ret == 0)
+            ret = ex.extract(blob_names[i], out);
+        if (ret == 0)
+            ret = compare_mat(out_ref, out, 0.f);
+
+        if (ret == 0 && w == 15 && h == 11)
+        {
+            ncnn::Mat shape = net_inferred.get_blob_shape(blob_names[i]);
+            if (shape.dims != out.dims || shape.w != out.w || shape.h != out.h || shape.c != out.c)
+            {
+                fprintf(stderr, "inferred shape %d %d %d %d  vs  %d %d %d %d\n", shape.dims, shape.w, shape.h, shape.c, out.dims, out.w, out.h, out.c);
+                ret = -1;
+            }
+        }
+
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_net_shape %s w=%d h=%d failed\n", blob_names[i], w, h);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_net_deep(20000)
+           || test_net_branch()
+           || test_net_branch_parallel()
+           || test_net_batch(1)
+           || test_net_batch(3)
+           || test_net_batch(6)
+           || test_net_shape(15, 11)
+           || test_net_shape(12, 16)
+           ;
+}
@@ -0,0 +1,249 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "net.h"
+#include "layer/concat.h"
+#include "layer/eltwise.h"
+#include "layer/relu.h"
+
+static int test_packing_convert(int w, int h, int c)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::Mat a4;
+    ncnn::convert_packing(a, a4, 4);
+
+    // channels not filling the packs are left as is
+    if (c % 4 != 0)
+    {
+        if (a4.data != a.data || a4.elempack != 1)
+        {
+            fprintf(stderr, "test_packing_convert c=%d should not pack\n", c);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (a4.w != w || a4.h != h || a4.c != c / 4 || a4.elempack != 4 || a4.elemsize != 16u)
+    {
+        fprintf(stderr, "test_packing_convert w=%d h=%d c=%d bad packed shape %d %d %d %d\n", w, h, c, a4.w, a4.h, a4.c, a4.elempack);
+        return -1;
+    }
+
+    // element k of the pixel at i of pack q is channel q*4+k
+    for (int q=0; q<c; q++)
+    {
+        const float* ptr = a.channel(q);
+        const float* ptr4 = a4.channel(q / 4);
+
+        for (int i=0; i<w * h; i++)
+        {
+            if (ptr4[i * 4 + q % 4] != ptr[i])
+            {
+                fprintf(stderr, "test_packing_convert w=%d h=%d c=%d wrong layout at c:%d i:%d\n", w, h, c, q, i);
+                return -1;
+            }
+        }
+    }
+
+    ncnn::Mat b;
+    ncnn::convert_packing(a4, b, 1);
+
+    if (b.elempack != 1 || b.elemsize != 4u)
+    {
+        fprintf(stderr, "test_packing_convert w=%d h=%d c=%d not unpacked\n", w, h, c);
+        return -1;
+    }
+
+    return compare_mat(a, b, 0.f);
+}
+
+static int test_packing_relu(int w, int h, int c, float slope)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, slope);// slope
+
+    std::vector<ncnn::Mat> weights(0);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::ReLU>("ReLU", pd, weights, opt, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_packing_relu failed w=%d h=%d c=%d slope=%f\n", w, h, c, slope);
+    }
+
+    return ret;
+}
+
+// multi input layers, all bottoms packed
+static int test_packing_multi(const char* layer_type, ncnn::Layer* op_ref, const ncnn::ParamDict& pd, int w, int h, int c0, int c1)
+{
+    ncnn::Layer* op = ncnn::create_layer(layer_type);
+
+    op->load_param(pd);
+    op_ref->load_param(pd);
+
+    std::vector<ncnn::Mat> a(2);
+    a[0] = random_mat(w, h, c0);
+    a[1] = random_mat(w, h, c1);
+
+    std::vector<ncnn::Mat> a4(2);
+    ncnn::convert_packing(a[0], a4[0], 4);
+    ncnn::convert_packing(a[1], a4[1], 4);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    std::vector<ncnn::Mat> b_ref(1);
+    std::vector<ncnn::Mat> b4(1);
+    int ret = op_ref->forward(a, b_ref, opt);
+    if (ret == 0)
+        ret = op->forward(a4, b4, opt);
+    if (ret == 0 && b4[0].elempack != 4)
+        ret = -1;
+    if (ret == 0)
+        ret = compare_mat(b_ref[0], b4[0], 0.001f);
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_packing_multi %s failed w=%d h=%d c0=%d c1=%d\n", layer_type, w, h, c0, c1);
+    }
+
+    delete op;
+    delete op_ref;
+
+    return ret;
+}
+
+static int test_packing_eltwise(int w, int h, int c, int op_type)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, op_type);// op_type
+
+    return test_packing_multi("Eltwise", new ncnn::Eltwise, pd, w, h, c, c);
+}
+
+static int test_packing_concat(int w, int h, int c0, int c1)
+{
+    ncnn::ParamDict pd;
+    pd.set(0, 0);// axis
+
+    return test_packing_multi("Concat", new ncnn::Concat, pd, w, h, c0, c1);
+}
+
+// a net mixing layers with and without packed support
+// the net converts at the boundaries, the output must not change
+static const char* test_packing_param =
+    "7767517\n"
+    "9 10\n"
+    "Input            data   0 1 data 0=11 1=9 2=16\n"
+    "Convolution      conv1  1 1 data conv1 0=24 1=1 5=1 6=384\n"
+    "ReLU             relu1  1 1 conv1 relu1\n"
+    "Split            split1 1 2 relu1 split1a split1b\n"
+    "ConvolutionDepthWise dw2 1 1 split1a dw2 0=24 1=3 4=1 5=1 6=216 7=24\n"
+    "Convolution      conv3  1 1 split1b conv3 0=24 1=3 4=1 5=1 6=5184\n"
+    "Eltwise          sum4   2 1 dw2 conv3 sum4 0=1\n"
+    "Pooling          pool5  1 1 sum4 pool5 0=0 1=3 2=2 3=1\n"
+    "Convolution      conv6  1 1 pool5 conv6 0=7 1=1 5=1 6=168\n";
+
+static int test_packing_net()
+{
+    std::vector<float> bin;
+    append_weight(bin, 384, 0);
+    append_weight(bin, 24, 1);
+    append_weight(bin, 216, 0);
+    append_weight(bin, 24, 1);
+    append_weight(bin, 5184, 0, -0.3f, 0.3f);
+    append_weight(bin, 24, 1);
+    append_weight(bin, 168, 0);
+    append_weight(bin, 7, 1);
+
+    if (write_file("test_packing.param", test_packing_param, strlen(test_packing_param)) != 0)
+        return -1;
+    if (write_file("test_packing.bin", &bin[0], bin.size() * sizeof(float)) != 0)
+        return -1;
+
+    ncnn::Net net;
+    int ret = net.load_param("test_packing.param");
+    if (ret == 0)
+        ret = net.load_model("test_packing.bin");
+
+    remove("test_packing.param");
+    remove("test_packing.bin");
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_packing_net load failed %d\n", ret);
+        return -1;
+    }
+
+    ncnn::Mat in = random_mat(11, 9, 16);
+
+    const char* blob_names[] = { "conv6", "pool5", "split1b" };
+    for (int i=0; i<3; i++)
+    {
+        ncnn::Mat out;
+        ncnn::Mat out4;
+
+        ncnn::Extractor ex = net.create_extractor();
+        ex.input("data", in);
+        ret = ex.extract(blob_names[i], out);
+
+        ncnn::Extractor ex4 = net.create_extractor();
+        ex4.set_packing_layout(true);
+        ex4.input("data", in);
+        if (ret == 0)
+            ret = ex4.extract(blob_names[i], out4);
+
+        if (ret == 0 && out4.elempack != 1)
+        {
+            fprintf(stderr, "test_packing_net %s extracted packed\n", blob_names[i]);
+            ret = -1;
+        }
+        if (ret == 0)
+            ret = compare_mat(out, out4, 0.001f);
+        if (ret != 0)
+        {
+            fprintf(stderr, "test_packing_net %s failed\n", blob_names[i]);
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_packing_convert(13, 11, 4)
+           || test_packing_convert(7, 9, 12)
+           || test_packing_convert(1, 1, 16)
+           || test_packing_convert(5, 3, 3)
+           || test_packing_convert(9, 7, 13)
+           || test_packing_relu(13, 11, 8, 0.f)
+           || test_packing_relu(7, 5, 12, 0.1f)
+           || test_packing_eltwise(13, 11, 8, 0)
+           || test_packing_eltwise(9, 7, 12, 1)
+           || test_packing_eltwise(5, 3, 4, 2)
+           || test_packing_concat(13, 11, 8, 4)
+           || test_packing_concat(7, 9, 12, 16)
+           || test_packing_net()
+           ;
+}
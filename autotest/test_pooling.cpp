@@ -0,0 +1,103 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "layer/pooling.h"
+
+static int test_pooling(int w, int h, int c, int pooling_type, int kernel, int stride, int pad, int global_pooling, int pad_mode)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, pooling_type);// pooling_type
+    pd.set(1, kernel);// kernel_w
+    pd.set(2, stride);// stride_w
+    pd.set(3, pad);// pad_w
+    pd.set(4, global_pooling);// global_pooling
+    pd.set(5, pad_mode);// pad_mode
+
+    std::vector<ncnn::Mat> weights(0);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::Pooling>("Pooling", pd, weights, opt, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_pooling failed w=%d h=%d c=%d pooling_type=%d kernel=%d stride=%d pad=%d global_pooling=%d pad_mode=%d\n", w, h, c, pooling_type, kernel, stride, pad, global_pooling, pad_mode);
+    }
+
+    return ret;
+}
+
+// every pad mode on odd sizes, the optimized kernels pad inline
+static int test_pooling_0()
+{
+    static const int kernel_stride_pad[][3] =
+    {
+        {2, 2, 0},
+        {2, 1, 0},
+        {3, 2, 0},
+        {3, 2, 1},
+        {3, 1, 1},
+        {5, 2, 2},
+        {4, 3, 1},
+    };
+
+    const int count = sizeof(kernel_stride_pad) / sizeof(kernel_stride_pad[0]);
+
+    for (int pooling_type=0; pooling_type<2; pooling_type++)
+    {
+        for (int pad_mode=0; pad_mode<3; pad_mode++)
+        {
+            for (int i=0; i<count; i++)
+            {
+                const int kernel = kernel_stride_pad[i][0];
+                const int stride = kernel_stride_pad[i][1];
+                const int pad = kernel_stride_pad[i][2];
+
+                int ret = 0
+                          || test_pooling(13, 11, 3, pooling_type, kernel, stride, pad, 0, pad_mode)
+                          || test_pooling(9, 14, 7, pooling_type, kernel, stride, pad, 0, pad_mode)
+                          || test_pooling(12, 9, 8, pooling_type, kernel, stride, pad, 0, pad_mode)
+                          || test_pooling(7, 7, 12, pooling_type, kernel, stride, pad, 0, pad_mode)
+                          ;
+                if (ret != 0)
+                    return ret;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int test_pooling_global()
+{
+    return 0
+           || test_pooling(13, 11, 3, 0, 0, 1, 0, 1, 0)
+           || test_pooling(13, 11, 5, 1, 0, 1, 0, 1, 0)
+           || test_pooling(9, 7, 8, 0, 0, 1, 0, 1, 0)
+           || test_pooling(9, 7, 16, 1, 0, 1, 0, 1, 0)
+           ;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_pooling_0()
+           || test_pooling_global()
+           ;
+}
@@ -0,0 +1,296 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include <string>
+
+#include "net.h"
+#include "profiler.h"
+
+static const char* test_profiler_param =
+    "7767517\n"
+    "4 4\n"
+    "Input            data   0 1 data 0=13 1=11 2=16\n"
+    "Convolution      conv1  1 1 data conv1 0=16 1=3 4=1 5=1 6=2304\n"
+    "ReLU             relu1  1 1 conv1 relu1\n"
+    "InnerProduct     fc2    1 1 relu1 fc2 0=7 1=1 2=16016\n";
+
+static int read_file(const char* path, std::string& s)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", path);
+        return -1;
+    }
+
+    char buf[4096];
+    size_t nread;
+    while ((nread = fread(buf, 1, sizeof(buf), fp)) > 0)
+    {
+        s.append(buf, nread);
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+static int count_string(const std::string& s, const char* sub)
+{
+    int count = 0;
+    for (size_t pos = s.find(sub); pos != std::string::npos; pos = s.find(sub, pos + 1))
+    {
+        count++;
+    }
+
+    return count;
+}
+
+static int expect_string(const std::string& s, const char* sub, const char* path)
+{
+    if (s.find(sub) == std::string::npos)
+    {
+        fprintf(stderr, "%s lacks %s\n", path, sub);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int load_test_profiler_net(ncnn::Net& net)
+{
+    std::vector<float> bin;
+    append_weight(bin, 2304, 0, -0.3f, 0.3f);
+    append_weight(bin, 16, 1);
+    append_weight(bin, 16016, 0, -0.1f, 0.1f);
+    append_weight(bin, 7, 1);
+
+    if (write_file("test_profiler.param", test_profiler_param, strlen(test_profiler_param)) != 0)
+        return -1;
+    if (write_file("test_profiler.bin", &bin[0], bin.size() * sizeof(float)) != 0)
+        return -1;
+
+    int ret = net.load_param("test_profiler.param");
+    if (ret == 0)
+        ret = net.load_model("test_profiler.bin");
+
+    remove("test_profiler.param");
+    remove("test_profiler.bin");
+
+    if (ret != 0)
+        fprintf(stderr, "test_profiler load failed %d\n", ret);
+
+    return ret;
+}
+
+static int test_profiler_0()
+{
+    ncnn::Net net;
+    if (load_test_profiler_net(net) != 0)
+        return -1;
+
+    ncnn::Mat in = random_mat(13, 11, 16);
+
+    ncnn::Profiler profiler;
+
+    // an extractor without profiler records nothing
+    {
+        ncnn::Mat out;
+        ncnn::Extractor ex = net.create_extractor();
+        ex.input("data", in);
+        ex.extract("fc2", out);
+    }
+
+    // one profiler shared by three extractors, the last one sets it back to 0 half way
+    for (int i=0; i<3; i++)
+    {
+        ncnn::Mat out;
+        ncnn::Extractor ex = net.create_extractor();
+        ex.set_profiler(&profiler);
+        ex.input("data", in);
+
+        if (i == 2)
+        {
+            ex.extract("conv1", out);
+            ex.set_profiler(0);
+        }
+
+        if (ex.extract("fc2", out) != 0)
+        {
+            fprintf(stderr, "test_profiler extract failed\n");
+            return -1;
+        }
+    }
+
+    if (profiler.extract_count() != 3)
+    {
+        fprintf(stderr, "test_profiler %d extracts recorded, expect 3\n", profiler.extract_count());
+        return -1;
+    }
+
+    if (profiler.save_json("test_profiler.json") != 0 || profiler.save_chrome_trace("test_profiler.trace.json") != 0)
+        return -1;
+
+    std::string json;
+    std::string trace;
+    if (read_file("test_profiler.json", json) != 0 || read_file("test_profiler.trace.json", trace) != 0)
+        return -1;
+
+    remove("test_profiler.json");
+    remove("test_profiler.trace.json");
+
+    // conv1 ran three times, relu1 and fc2 twice
+    // the 3x3 s1 convolution goes through winograd, 2304 weights over 13x11 pixels
+    int ret = 0
+              || expect_string(json, "{\"name\": \"conv1\", \"type\": \"Convolution\", \"kernel\": \"conv3x3s1_winograd64\",\n     \"count\": 3,", "test_profiler.json")
+              || expect_string(json, "{\"name\": \"relu1\", \"type\": \"ReLU\", \"kernel\": \"\",\n     \"count\": 2,", "test_profiler.json")
+              || expect_string(json, "{\"name\": \"fc2\", \"type\": \"InnerProduct\", \"kernel\": \"pack\",\n     \"count\": 2,", "test_profiler.json")
+              || expect_string(json, "\"bottoms\": [{\"dims\": 3, \"w\": 13, \"h\": 11, \"c\": 16,", "test_profiler.json")
+              || expect_string(json, "\"macs\": 329472,", "test_profiler.json")
+              || expect_string(json, "\"macs\": 16016,", "test_profiler.json");
+    if (ret != 0)
+        return -1;
+
+    // one event per layer run and per extract
+    int events = count_string(trace, "\"ph\": \"X\"");
+    if (events != 3 + 2 + 2 + 3)
+    {
+        fprintf(stderr, "test_profiler %d trace events, expect 10\n", events);
+        return -1;
+    }
+
+    profiler.clear();
+    if (profiler.extract_count() != 0)
+    {
+        fprintf(stderr, "test_profiler clear kept the extracts\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+// counters may be refused, by the kernel or a container without a pmu, then only time is recorded
+static int test_profiler_counters()
+{
+    ncnn::Net net;
+    if (load_test_profiler_net(net) != 0)
+        return -1;
+
+    ncnn::Profiler profiler;
+    int available = profiler.enable_hardware_counters(1) == 0;
+
+    {
+        ncnn::Mat out;
+        ncnn::Extractor ex = net.create_extractor();
+        ex.set_num_threads(1);
+        ex.set_profiler(&profiler);
+        ex.input("data", random_mat(13, 11, 16));
+        if (ex.extract("fc2", out) != 0)
+        {
+            fprintf(stderr, "test_profiler_counters extract failed\n");
+            return -1;
+        }
+    }
+
+    if (profiler.save_json("test_profiler.json") != 0)
+        return -1;
+
+    std::string json;
+    if (read_file("test_profiler.json", json) != 0)
+        return -1;
+
+    remove("test_profiler.json");
+
+    if (!available)
+    {
+        fprintf(stderr, "hardware counters are not available, checking the time only output\n");
+        if (expect_string(json, "\"hardware_counters\": [],", "test_profiler.json") != 0)
+            return -1;
+
+        if (json.find("\"counters\":") != std::string::npos)
+        {
+            fprintf(stderr, "test_profiler_counters reports counters it could not open\n");
+            return -1;
+        }
+
+        return 0;
+    }
+
+    // every layer reports the counters that could be opened
+    if (count_string(json, "\"counters\": {") != 3)
+    {
+        fprintf(stderr, "test_profiler_counters layers lack counters\n");
+        return -1;
+    }
+
+    profiler.disable_hardware_counters();
+
+    return 0;
+}
+
+// a layer failing its forward is left out
+static int test_profiler_failed()
+{
+    ncnn::Net net;
+    if (load_test_profiler_net(net) != 0)
+        return -1;
+
+    ncnn::Profiler profiler;
+
+    {
+        // fc2 gets 12x11x16 values instead of the 13x11x16 its weights are made for
+        ncnn::Mat out;
+        ncnn::Extractor ex = net.create_extractor();
+        ex.set_profiler(&profiler);
+        ex.input("data", random_mat(12, 11, 16));
+        if (ex.extract("fc2", out) == 0)
+        {
+            fprintf(stderr, "test_profiler_failed extract did not fail\n");
+            return -1;
+        }
+    }
+
+    if (profiler.save_json("test_profiler.json") != 0)
+        return -1;
+
+    std::string json;
+    if (read_file("test_profiler.json", json) != 0)
+        return -1;
+
+    remove("test_profiler.json");
+
+    if (expect_string(json, "\"name\": \"relu1\"", "test_profiler.json") != 0)
+        return -1;
+
+    if (json.find("\"name\": \"fc2\"") != std::string::npos)
+    {
+        fprintf(stderr, "test_profiler_failed recorded the failed layer\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_profiler_0()
+           || test_profiler_counters()
+           || test_profiler_failed()
+           ;
+}
@@ -0,0 +1,134 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include "layer/batchnorm.h"
+#include "layer/bias.h"
+#include "layer/scale.h"
+
+static int test_scale(int w, int h, int c, int bias)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, c);// scale_data_size
+    pd.set(1, bias);// bias_term
+
+    std::vector<ncnn::Mat> weights(bias ? 2 : 1);
+    weights[0] = random_mat(c);
+    if (bias)
+        weights[1] = random_mat(c);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::Scale>("Scale", pd, weights, opt, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_scale failed w=%d h=%d c=%d bias=%d\n", w, h, c, bias);
+    }
+
+    return ret;
+}
+
+// the scale comes in as the second blob
+static int test_scale_blob(int w, int h, int c, int bias)
+{
+    std::vector<ncnn::Mat> a(2);
+    a[0] = random_mat(w, h, c);
+    a[1] = random_mat(c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, -233);// scale_data_size
+    pd.set(1, bias);// bias_term
+
+    std::vector<ncnn::Mat> weights(bias ? 1 : 0);
+    if (bias)
+        weights[0] = random_mat(c);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::Scale>("Scale", pd, weights, opt, a, 2);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_scale_blob failed w=%d h=%d c=%d bias=%d\n", w, h, c, bias);
+    }
+
+    return ret;
+}
+
+static int test_bias(int w, int h, int c)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, c);// bias_data_size
+
+    std::vector<ncnn::Mat> weights(1);
+    weights[0] = random_mat(c);
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::Bias>("Bias", pd, weights, opt, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_bias failed w=%d h=%d c=%d\n", w, h, c);
+    }
+
+    return ret;
+}
+
+static int test_batchnorm(int w, int h, int c)
+{
+    ncnn::Mat a = random_mat(w, h, c);
+
+    ncnn::ParamDict pd;
+    pd.set(0, c);// channels
+
+    std::vector<ncnn::Mat> weights(4);
+    weights[0] = random_mat(c);// slope
+    weights[1] = random_mat(c);// mean
+    weights[2] = random_mat(c, 0.5f, 2.f);// var
+    weights[3] = random_mat(c);// bias
+
+    ncnn::Option opt = ncnn::get_default_option();
+
+    int ret = test_layer<ncnn::BatchNorm>("BatchNorm", pd, weights, opt, a);
+    if (ret != 0)
+    {
+        fprintf(stderr, "test_batchnorm failed w=%d h=%d c=%d\n", w, h, c);
+    }
+
+    return ret;
+}
+
+int main()
+{
+    srand(7767517);
+
+    return 0
+           || test_scale(13, 11, 3, 0)
+           || test_scale(13, 11, 3, 1)
+           || test_scale(8, 4, 16, 1)
+           || test_scale(1, 1, 67, 1)
+           || test_scale_blob(13, 11, 3, 0)
+           || test_scale_blob(8, 4, 16, 1)
+           || test_bias(13, 11, 3)
+           || test_bias(8, 4, 16)
+           || test_bias(1, 1, 67)
+           || test_batchnorm(13, 11, 3)
+           || test_batchnorm(8, 4, 16)
+           || test_batchnorm(1, 1, 67)
+           ;
+}
@@ -0,0 +1,195 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "testutil.h"
+
+#include <pthread.h>
+
+#include "threadpool.h"
+
+// every index bumps its own slot, a slot left at 0 or hit twice is a bug
+class count_task : public ncnn::ParallelTask
+{
+public:
+    count_task(std::vector<int>& _hits) : hits(_hits) {}
+
+    virtual void execute(int i) const
+    {
+        hits[i]++;
+    }
+
+    std::vector<int>& hits;
+};
+
+// runs an inner loop on the same pool from every index of the outer one
+class nested_task : public ncnn::ParallelTask
+{
+public:
+    nested_task(ncnn::ThreadPool* _pool, std::vector<int>& _hits, int _inner, int _num_threads)
+        : pool(_pool), hits(_hits), inner(_inner), num_threads(_num_threads) {}
+
+    virtual void execute(int i) const
+    {
+        std::vector<int> inner_hits(inner, 0);
+        pool->parallel_for(count_task(inner_hits), inner, num_threads);
+
+        for (int j=0; j<inner; j++)
+        {
+            hits[i * inner + j] += inner_hits[j];
+        }
+    }
+
+    ncnn::ThreadPool* pool;
+    std::vector<int>& hits;
+    int inner;
+    int num_threads;
+};
+
+static int check_hits(const std::vector<int>& hits, const char* what, int num_threads)
+{
+    for (size_t i=0; i<hits.size(); i++)
+    {
+        if (hits[i] != 1)
+        {
+            fprintf(stderr, "%s n=%d num_threads=%d index %d ran %d times\n", what, (int)hits.size(), num_threads, (int)i, hits[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int test_threadpool_0(ncnn::ThreadPool& pool)
+{
+    static const int sizes[] = { 0, 1, 3, 7, 64, 1001 };
+
+    for (int num_threads=1; num_threads<=5; num_threads++)
+    {
+        for (int s=0; s<(int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+        {
+            std::vector<int> hits(sizes[s], 0);
+            pool.parallel_for(count_task(hits), sizes[s], num_threads);
+
+            if (check_hits(hits, "parallel_for", num_threads) != 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int test_threadpool_nested(ncnn::ThreadPool& pool)
+{
+    for (int num_threads=1; num_threads<=4; num_threads++)
+    {
+        std::vector<int> hits(13 * 9, 0);
+        pool.parallel_for(nested_task(&pool, hits, 9, num_threads), 13, num_threads);
+
+        if (check_hits(hits, "nested parallel_for", num_threads) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+// the option route, with a pool of its own and with the default pool
+static int test_threadpool_option(ncnn::ThreadPool& pool)
+{
+    ncnn::Option opt;
+    opt.num_threads = 3;
+
+    for (int i=0; i<2; i++)
+    {
+        opt.thread_pool = i == 0 ? &pool : 0;
+
+        std::vector<int> hits(257, 0);
+        ncnn::parallel_for(count_task(hits), 257, opt);
+
+        if (check_hits(hits, i == 0 ? "option pool" : "default pool", opt.num_threads) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+struct caller_args
+{
+    ncnn::ThreadPool* pool;
+    int ret;
+};
+
+static void* caller_main(void* p)
+{
+    caller_args* args = (caller_args*)p;
+
+    args->ret = 0;
+    for (int i=0; i<50 && args->ret == 0; i++)
+    {
+        std::vector<int> hits(97, 0);
+        args->pool->parallel_for(count_task(hits), 97, 4);
+        args->ret = check_hits(hits, "concurrent parallel_for", 4);
+    }
+
+    return 0;
+}
+
+// several threads calling into one pool at the same time
+static int test_threadpool_concurrent(ncnn::ThreadPool& pool)
+{
+    const int num_callers = 4;
+
+    pthread_t threads[num_callers];
+    caller_args args[num_callers];
+    for (int i=0; i<num_callers; i++)
+    {
+        args[i].pool = &pool;
+        args[i].ret = -1;
+        pthread_create(&threads[i], 0, caller_main, &args[i]);
+    }
+
+    int ret = 0;
+    for (int i=0; i<num_callers; i++)
+    {
+        pthread_join(threads[i], 0);
+        ret = ret || args[i].ret;
+    }
+
+    return ret;
+}
+
+static int test_threadpool(int spin_count)
+{
+    ncnn::ThreadPool pool(4);
+    pool.set_spin_count(spin_count);
+
+    int ret = 0
+              || test_threadpool_0(pool)
+              || test_threadpool_nested(pool)
+              || test_threadpool_option(pool)
+              || test_threadpool_concurrent(pool);
+
+    if (ret != 0)
+        fprintf(stderr, "test_threadpool failed spin_count=%d\n", spin_count);
+
+    return ret;
+}
+
+int main()
+{
+    // sleeping workers, polling workers
+    return 0
+           || test_threadpool(0)
+           || test_threadpool(10000)
+           ;
+}
@@ -0,0 +1,302 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef NCNN_TESTUTIL_H
+#define NCNN_TESTUTIL_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "layer.h"
+#include "mat.h"
+#include "modelbin.h"
+#include "paramdict.h"
+
+static float random_float(float a = -1.2f, float b = 1.2f)
+{
+    float r = (float)rand() / (float)RAND_MAX;
+    return a + r * (b - a);
+}
+
+static void randomize(ncnn::Mat& m, float a = -1.2f, float b = 1.2f)
+{
+    int size = m.total();
+    for (int i=0; i<size; i++)
+    {
+        m[i] = random_float(a, b);
+    }
+}
+
+static ncnn::Mat random_mat(int w, float a = -1.2f, float b = 1.2f)
+{
+    ncnn::Mat m(w);
+    randomize(m, a, b);
+    return m;
+}
+
+static ncnn::Mat random_mat(int w, int h, float a = -1.2f, float b = 1.2f)
+{
+    ncnn::Mat m(w, h);
+    randomize(m, a, b);
+    return m;
+}
+
+static ncnn::Mat random_mat(int w, int h, int c, float a = -1.2f, float b = 1.2f)
+{
+    ncnn::Mat m(w, h, c);
+    randomize(m, a, b);
+    return m;
+}
+
+// compare the shape and every element, unpacked
+// elements differ when both the absolute and the relative error exceed epsilon
+// return 0 if equal
+static int compare_mat(const ncnn::Mat& a, const ncnn::Mat& b, float epsilon = 0.001f)
+{
+    if (a.dims != b.dims || a.w != b.w || a.h != b.h || a.c * a.elempack != b.c * b.elempack)
+    {
+        fprintf(stderr, "shape not match %d %d %d %d (%d)  vs  %d %d %d %d (%d)\n", a.dims, a.w, a.h, a.c, a.elempack, b.dims, b.w, b.h, b.c, b.elempack);
+        return -1;
+    }
+
+    ncnn::Mat a1 = a;
+    ncnn::Mat b1 = b;
+    if (a.elempack != 1)
+        ncnn::convert_packing(a, a1, 1);
+    if (b.elempack != 1)
+        ncnn::convert_packing(b, b1, 1);
+
+    for (int q=0; q<a1.c; q++)
+    {
+        const float* pa = a1.channel(q);
+        const float* pb = b1.channel(q);
+
+        for (int i=0; i<a1.w * a1.h; i++)
+        {
+            float diff = fabs(pa[i] - pb[i]);
+            float amax = fabs(pa[i]) > fabs(pb[i]) ? fabs(pa[i]) : fabs(pb[i]);
+            if (diff > epsilon && diff > epsilon * amax)
+            {
+                fprintf(stderr, "value not match at c:%d h:%d w:%d  expect %f but got %f\n", q, i / a1.w, i % a1.w, pa[i], pb[i]);
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// run the layer the way the net does, in place when it supports it
+static int forward_layer(const ncnn::Layer* op, const ncnn::Mat& a, ncnn::Mat& b, const ncnn::Option& opt)
+{
+    if (op->support_inplace)
+    {
+        b = a.clone();
+        return op->forward_inplace(b, opt);
+    }
+
+    return op->forward(a, b, opt);
+}
+
+// multi blob layers
+static int forward_layer(const ncnn::Layer* op, const std::vector<ncnn::Mat>& a, std::vector<ncnn::Mat>& b, const ncnn::Option& opt)
+{
+    if (op->support_inplace)
+    {
+        b.resize(a.size());
+        for (size_t i=0; i<a.size(); i++)
+        {
+            b[i] = a[i].clone();
+        }
+        return op->forward_inplace(b, opt);
+    }
+
+    return op->forward(a, b, opt);
+}
+
+static int create_test_layer(ncnn::Layer* op, const ncnn::ParamDict& pd, const std::vector<ncnn::Mat>& weights)
+{
+    int ret = op->load_param(pd);
+    if (ret != 0)
+        return ret;
+
+    // every layer gets its own copy, create_pipeline may drop or repack them
+    std::vector<ncnn::Mat> weights_copy(weights.size() + 1);
+    for (size_t i=0; i<weights.size(); i++)
+    {
+        weights_copy[i] = weights[i].clone();
+    }
+
+    ret = op->load_model(ncnn::ModelBinFromMatArray(&weights_copy[0]));
+    if (ret != 0)
+        return ret;
+
+    return op->create_pipeline();
+}
+
+// run the layer picked by the factory for this cpu against the generic layer T
+// layers supporting the packed layout are run once more on pack4 input when the channels allow
+// return 0 if the outputs match
+// fails when the optimized layer runs another kernel than expect_kernel, 0 skips the check
+template<typename T>
+int test_layer(const char* layer_type, const ncnn::ParamDict& pd, const std::vector<ncnn::Mat>& weights, const ncnn::Option& opt, const ncnn::Mat& a, float epsilon = 0.001f, const char* expect_kernel = 0)
+{
+    ncnn::Layer* op = ncnn::create_layer(layer_type);
+    if (!op)
+    {
+        fprintf(stderr, "create_layer %s failed\n", layer_type);
+        return -1;
+    }
+
+    ncnn::Layer* op_ref = new T;
+
+    int ret = create_test_layer(op, pd, weights);
+    if (ret == 0)
+        ret = create_test_layer(op_ref, pd, weights);
+    if (ret != 0)
+    {
+        fprintf(stderr, "%s load failed %d\n", layer_type, ret);
+        delete op;
+        delete op_ref;
+        return -1;
+    }
+
+    ncnn::Mat b_ref;
+    ncnn::Mat b;
+    ret = forward_layer(op_ref, a, b_ref, opt);
+    if (ret == 0)
+        ret = forward_layer(op, a, b, opt);
+
+    if (ret == 0)
+        ret = compare_mat(b_ref, b, epsilon);
+
+    if (ret == 0 && expect_kernel)
+    {
+        const char* kernel = op->kernel_name(a);
+        if (!kernel || strcmp(kernel, expect_kernel) != 0)
+        {
+            fprintf(stderr, "%s runs kernel %s, expect %s\n", layer_type, kernel ? kernel : "(generic)", expect_kernel);
+            ret = -1;
+        }
+    }
+
+    // the same through the packed layout
+    if (ret == 0 && op->support_packing && a.dims == 3 && a.c % 4 == 0)
+    {
+        ncnn::Mat a4;
+        ncnn::convert_packing(a, a4, 4);
+
+        ncnn::Mat b4;
+        ret = forward_layer(op, a4, b4, opt);
+        if (ret == 0 && b4.elempack != 4)
+        {
+            fprintf(stderr, "%s top blob is not packed\n", layer_type);
+            ret = -1;
+        }
+        if (ret == 0)
+            ret = compare_mat(b_ref, b4, epsilon);
+        if (ret != 0)
+            fprintf(stderr, "pack4 ");
+    }
+
+    if (ret != 0)
+        fprintf(stderr, "test_layer %s failed a.dims=%d a=(%d %d %d)\n", layer_type, a.dims, a.w, a.h, a.c);
+
+    op->destroy_pipeline();
+    op_ref->destroy_pipeline();
+    delete op;
+    delete op_ref;
+
+    return ret;
+}
+
+// same as test_layer for layers taking several bottom blobs
+template<typename T>
+int test_layer(const char* layer_type, const ncnn::ParamDict& pd, const std::vector<ncnn::Mat>& weights, const ncnn::Option& opt, const std::vector<ncnn::Mat>& a, int top_blob_count = 1, float epsilon = 0.001f)
+{
+    ncnn::Layer* op = ncnn::create_layer(layer_type);
+    if (!op)
+    {
+        fprintf(stderr, "create_layer %s failed\n", layer_type);
+        return -1;
+    }
+
+    ncnn::Layer* op_ref = new T;
+
+    int ret = create_test_layer(op, pd, weights);
+    if (ret == 0)
+        ret = create_test_layer(op_ref, pd, weights);
+    if (ret != 0)
+    {
+        fprintf(stderr, "%s load failed %d\n", layer_type, ret);
+        delete op;
+        delete op_ref;
+        return -1;
+    }
+
+    std::vector<ncnn::Mat> b_ref(top_blob_count);
+    std::vector<ncnn::Mat> b(top_blob_count);
+    ret = forward_layer(op_ref, a, b_ref, opt);
+    if (ret == 0)
+        ret = forward_layer(op, a, b, opt);
+
+    for (int i=0; i<top_blob_count && ret == 0; i++)
+    {
+        ret = compare_mat(b_ref[i], b[i], epsilon);
+    }
+
+    if (ret != 0)
+        fprintf(stderr, "test_layer %s failed a[0].dims=%d a[0]=(%d %d %d)\n", layer_type, a[0].dims, a[0].w, a[0].h, a[0].c);
+
+    op->destroy_pipeline();
+    op_ref->destroy_pipeline();
+    delete op;
+    delete op_ref;
+
+    return ret;
+}
+
+// append a random weight to a model binary as load_model reads it
+// type 0 weights carry the 4 byte flag, zero for raw float32
+static void append_weight(std::vector<float>& bin, int size, int type, float a = -1.2f, float b = 1.2f)
+{
+    if (type == 0)
+        bin.push_back(0.f);
+
+    for (int i=0; i<size; i++)
+    {
+        bin.push_back(random_float(a, b));
+    }
+}
+
+// return 0 if success
+static int write_file(const char* path, const void* data, size_t size)
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", path);
+        return -1;
+    }
+
+    size_t nwrite = fwrite(data, 1, size, fp);
+    fclose(fp);
+
+    return nwrite == size ? 0 : -1;
+}
+
+#endif // NCNN_TESTUTIL_H
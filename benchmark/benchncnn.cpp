@@ -1,6 +1,7 @@
 #include <float.h>
 #include <stdio.h>
 
+#include "allocator.h"
 #include "benchmark.h"
 #include "cpu.h"
 #include "net.h"
@@ -36,6 +37,9 @@ public:
             }
         }
 
+        if (ret == 0)
+            ret = create_pipeline();
+
         return ret;
     }
 };
@@ -44,20 +48,24 @@ public:
 
 static int g_loop_count = 4;
 
-void benchmark(const char* comment, void (*init)(ncnn::Net&), void (*run)(const ncnn::Net&))
-{
-    ncnn::BenchNet net;
+static ncnn::UnlockedPoolAllocator g_blob_pool_allocator;
+static ncnn::PoolAllocator g_workspace_pool_allocator;
+static ncnn::PlannedAllocator g_planned_allocator;
 
-    init(net);
+static ncnn::Allocator* g_blob_allocator = &g_blob_pool_allocator;
+static ncnn::Allocator* g_workspace_allocator = &g_workspace_pool_allocator;
 
-    net.load_model();
+static bool g_branch_parallel = false;
+static bool g_benchmark_branch_parallel = false;
 
+static void benchmark_loop(const ncnn::Net& net, void (*run)(const ncnn::Net&), double& time_min, double& time_max, double& time_avg)
+{
     // warm up
     run(net);
 
-    double time_min = DBL_MAX;
-    double time_max = -DBL_MAX;
-    double time_avg = 0;
+    time_min = DBL_MAX;
+    time_max = -DBL_MAX;
+    time_avg = 0;
 
     for (int i=0; i<g_loop_count; i++)
     {
@@ -75,8 +83,62 @@ void benchmark(const char* comment, void (*init)(ncnn::Net&), void (*run)(const
     }
 
     time_avg /= g_loop_count;
+}
+
+void benchmark(const char* comment, void (*init)(ncnn::Net&), void (*run)(const ncnn::Net&))
+{
+    ncnn::BenchNet net;
+
+    init(net);
+
+    net.load_model();
+
+    double time_min;
+    double time_max;
+    double time_avg;
+    benchmark_loop(net, run, time_min, time_max, time_avg);
 
-    fprintf(stderr, "%16s  min = %7.2f  max = %7.2f  avg = %7.2f\n", comment, time_min, time_max, time_avg);
+    g_blob_pool_allocator.clear();
+    g_workspace_pool_allocator.clear();
+
+    // plan blobs and workspace of one run into a single arena
+    g_blob_allocator = &g_planned_allocator;
+    g_workspace_allocator = &g_planned_allocator;
+
+    run(net);
+
+    g_planned_allocator.plan();
+
+    double planned_mb = g_planned_allocator.planned_size() / 1024.0 / 1024.0;
+    double naive_mb = g_planned_allocator.naive_size() / 1024.0 / 1024.0;
+
+    g_planned_allocator.clear();
+
+    g_blob_allocator = &g_blob_pool_allocator;
+    g_workspace_allocator = &g_workspace_pool_allocator;
+
+    if (!g_benchmark_branch_parallel)
+    {
+        fprintf(stderr, "%16s  min = %7.2f  max = %7.2f  avg = %7.2f  planned = %7.2fMB  naive = %7.2fMB\n", comment, time_min, time_max, time_avg, planned_mb, naive_mb);
+        return;
+    }
+
+    // branches allocate blobs concurrently, use the thread-safe pool for both
+    double branch_time_min;
+    double branch_time_max;
+    double branch_time_avg;
+    g_branch_parallel = true;
+    g_blob_allocator = &g_workspace_pool_allocator;
+
+    benchmark_loop(net, run, branch_time_min, branch_time_max, branch_time_avg);
+
+    g_branch_parallel = false;
+    g_blob_allocator = &g_blob_pool_allocator;
+
+    g_workspace_pool_allocator.clear();
+
+    fprintf(stderr, "%16s  min = %7.2f  max = %7.2f  avg = %7.2f  planned = %7.2fMB  naive = %7.2fMB\n", comment, time_min, time_max, time_avg, planned_mb, naive_mb);
+    fprintf(stderr, "%16s  min = %7.2f  max = %7.2f  avg = %7.2f  branch parallel\n", "", branch_time_min, branch_time_max, branch_time_avg);
 }
 
 void squeezenet_init(ncnn::Net& net)
@@ -87,6 +149,9 @@ void squeezenet_init(ncnn::Net& net)
 void squeezenet_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(227, 227, 3);
     ex.input("data", in);
@@ -103,6 +168,9 @@ void mobilenet_init(ncnn::Net& net)
 void mobilenet_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(224, 224, 3);
     ex.input("data", in);
@@ -119,6 +187,9 @@ void mobilenet_v2_init(ncnn::Net& net)
 void mobilenet_v2_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(224, 224, 3);
     ex.input("data", in);
@@ -135,6 +206,9 @@ void shufflenet_init(ncnn::Net& net)
 void shufflenet_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(224, 224, 3);
     ex.input("data", in);
@@ -151,6 +225,9 @@ void googlenet_init(ncnn::Net& net)
 void googlenet_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(224, 224, 3);
     ex.input("data", in);
@@ -167,6 +244,9 @@ void resnet18_init(ncnn::Net& net)
 void resnet18_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(224, 224, 3);
     ex.input("data", in);
@@ -183,6 +263,9 @@ void alexnet_init(ncnn::Net& net)
 void alexnet_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(227, 227, 3);
     ex.input("data", in);
@@ -199,6 +282,9 @@ void vgg16_init(ncnn::Net& net)
 void vgg16_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(224, 224, 3);
     ex.input("data", in);
@@ -215,6 +301,9 @@ void squeezenet_ssd_init(ncnn::Net& net)
 void squeezenet_ssd_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(227, 227, 3);
     ex.input("data", in);
@@ -231,6 +320,9 @@ void mobilenet_ssd_init(ncnn::Net& net)
 void mobilenet_ssd_run(const ncnn::Net& net)
 {
     ncnn::Extractor ex = net.create_extractor();
+    ex.set_blob_allocator(g_blob_allocator);
+    ex.set_workspace_allocator(g_workspace_allocator);
+    ex.set_branch_parallel(g_branch_parallel);
 
     ncnn::Mat in(227, 227, 3);
     ex.input("data", in);
@@ -244,6 +336,7 @@ int main(int argc, char** argv)
     int loop_count = 4;
     int num_threads = ncnn::get_cpu_count();
     int powersave = 0;
+    int branch_parallel = 0;
 
     if (argc >= 2)
     {
@@ -257,17 +350,26 @@ int main(int argc, char** argv)
     {
         powersave = atoi(argv[3]);
     }
+    if (argc >= 5)
+    {
+        branch_parallel = atoi(argv[4]);
+    }
 
     g_loop_count = loop_count;
+    g_benchmark_branch_parallel = branch_parallel != 0;
 
     ncnn::set_cpu_powersave(powersave);
 
-    ncnn::set_omp_dynamic(0);
-    ncnn::set_omp_num_threads(num_threads);
+    // every extractor takes the thread count from the default option
+    ncnn::Option opt;
+    opt.lightmode = true;
+    opt.num_threads = num_threads;
+    ncnn::set_default_option(opt);
 
     fprintf(stderr, "loop_count = %d\n", g_loop_count);
     fprintf(stderr, "num_threads = %d\n", num_threads);
     fprintf(stderr, "powersave = %d\n", ncnn::get_cpu_powersave());
+    fprintf(stderr, "branch_parallel = %d\n", branch_parallel);
 
     // run
     benchmark("squeezenet", squeezenet_init, squeezenet_run);
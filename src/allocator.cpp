@@ -0,0 +1,480 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "allocator.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace ncnn {
+
+Allocator::~Allocator()
+{
+}
+
+PoolAllocator::PoolAllocator()
+{
+    size_compare_ratio = 192;// 0.75f * 256
+}
+
+PoolAllocator::~PoolAllocator()
+{
+    clear();
+
+    if (!payouts.empty())
+    {
+        fprintf(stderr, "FATAL ERROR! pool allocator destroyed too early\n");
+        std::list< std::pair<size_t, void*> >::iterator it = payouts.begin();
+        for (; it != payouts.end(); it++)
+        {
+            void* ptr = it->second;
+            fprintf(stderr, "%p still in use\n", ptr);
+        }
+    }
+}
+
+void PoolAllocator::clear()
+{
+    budgets_lock.lock();
+
+    std::list< std::pair<size_t, void*> >::iterator it = budgets.begin();
+    for (; it != budgets.end(); it++)
+    {
+        void* ptr = it->second;
+        ncnn::fastFree(ptr);
+    }
+    budgets.clear();
+
+    budgets_lock.unlock();
+}
+
+void PoolAllocator::set_size_compare_ratio(float scr)
+{
+    if (scr < 0.f || scr > 1.f)
+    {
+        fprintf(stderr, "invalid size compare ratio %f\n", scr);
+        return;
+    }
+
+    size_compare_ratio = (unsigned int)(scr * 256);
+}
+
+void* PoolAllocator::fastMalloc(size_t size)
+{
+    budgets_lock.lock();
+
+    // find free budget
+    std::list< std::pair<size_t, void*> >::iterator it = budgets.begin();
+    for (; it != budgets.end(); it++)
+    {
+        size_t bs = it->first;
+
+        // size_compare_ratio ~ 100%
+        if (bs >= size && ((bs * size_compare_ratio) >> 8) <= size)
+        {
+            void* ptr = it->second;
+
+            budgets.erase(it);
+
+            budgets_lock.unlock();
+
+            payouts_lock.lock();
+
+            payouts.push_back(std::make_pair(bs, ptr));
+
+            payouts_lock.unlock();
+
+            return ptr;
+        }
+    }
+
+    budgets_lock.unlock();
+
+    // new
+    void* ptr = ncnn::fastMalloc(size);
+
+    payouts_lock.lock();
+
+    payouts.push_back(std::make_pair(size, ptr));
+
+    payouts_lock.unlock();
+
+    return ptr;
+}
+
+void PoolAllocator::fastFree(void* ptr)
+{
+    payouts_lock.lock();
+
+    // return to budgets
+    std::list< std::pair<size_t, void*> >::iterator it = payouts.begin();
+    for (; it != payouts.end(); it++)
+    {
+        if (it->second == ptr)
+        {
+            size_t size = it->first;
+
+            payouts.erase(it);
+
+            payouts_lock.unlock();
+
+            budgets_lock.lock();
+
+            budgets.push_back(std::make_pair(size, ptr));
+
+            budgets_lock.unlock();
+
+            return;
+        }
+    }
+
+    payouts_lock.unlock();
+
+    fprintf(stderr, "FATAL ERROR! pool allocator get wild %p\n", ptr);
+    ncnn::fastFree(ptr);
+}
+
+UnlockedPoolAllocator::UnlockedPoolAllocator()
+{
+    size_compare_ratio = 192;// 0.75f * 256
+}
+
+UnlockedPoolAllocator::~UnlockedPoolAllocator()
+{
+    clear();
+
+    if (!payouts.empty())
+    {
+        fprintf(stderr, "FATAL ERROR! unlocked pool allocator destroyed too early\n");
+        std::list< std::pair<size_t, void*> >::iterator it = payouts.begin();
+        for (; it != payouts.end(); it++)
+        {
+            void* ptr = it->second;
+            fprintf(stderr, "%p still in use\n", ptr);
+        }
+    }
+}
+
+void UnlockedPoolAllocator::clear()
+{
+    std::list< std::pair<size_t, void*> >::iterator it = budgets.begin();
+    for (; it != budgets.end(); it++)
+    {
+        void* ptr = it->second;
+        ncnn::fastFree(ptr);
+    }
+    budgets.clear();
+}
+
+void UnlockedPoolAllocator::set_size_compare_ratio(float scr)
+{
+    if (scr < 0.f || scr > 1.f)
+    {
+        fprintf(stderr, "invalid size compare ratio %f\n", scr);
+        return;
+    }
+
+    size_compare_ratio = (unsigned int)(scr * 256);
+}
+
+void* UnlockedPoolAllocator::fastMalloc(size_t size)
+{
+    // find free budget
+    std::list< std::pair<size_t, void*> >::iterator it = budgets.begin();
+    for (; it != budgets.end(); it++)
+    {
+        size_t bs = it->first;
+
+        // size_compare_ratio ~ 100%
+        if (bs >= size && ((bs * size_compare_ratio) >> 8) <= size)
+        {
+            void* ptr = it->second;
+
+            budgets.erase(it);
+
+            payouts.push_back(std::make_pair(bs, ptr));
+
+            return ptr;
+        }
+    }
+
+    // new
+    void* ptr = ncnn::fastMalloc(size);
+
+    payouts.push_back(std::make_pair(size, ptr));
+
+    return ptr;
+}
+
+void UnlockedPoolAllocator::fastFree(void* ptr)
+{
+    // return to budgets
+    std::list< std::pair<size_t, void*> >::iterator it = payouts.begin();
+    for (; it != payouts.end(); it++)
+    {
+        if (it->second == ptr)
+        {
+            size_t size = it->first;
+
+            payouts.erase(it);
+
+            budgets.push_back(std::make_pair(size, ptr));
+
+            return;
+        }
+    }
+
+    fprintf(stderr, "FATAL ERROR! unlocked pool allocator get wild %p\n", ptr);
+    ncnn::fastFree(ptr);
+}
+
+PlannedAllocator::PlannedAllocator()
+{
+    time = 0;
+    live_size = 0;
+    peak_size = 0;
+    arena = 0;
+    arena_size = 0;
+    cursor = 0;
+}
+
+PlannedAllocator::~PlannedAllocator()
+{
+    if (!arena_payouts.empty() || !heap_payouts.empty())
+    {
+        fprintf(stderr, "FATAL ERROR! planned allocator destroyed too early\n");
+        std::list< std::pair<size_t, size_t> >::iterator it = arena_payouts.begin();
+        for (; it != arena_payouts.end(); it++)
+        {
+            fprintf(stderr, "%p still in use\n", arena + it->first);
+        }
+        std::list<void*>::iterator hit = heap_payouts.begin();
+        for (; hit != heap_payouts.end(); hit++)
+        {
+            fprintf(stderr, "%p still in use\n", *hit);
+        }
+    }
+
+    ncnn::fastFree(arena);
+}
+
+static bool record_size_greater(const std::pair<size_t, int>& a, const std::pair<size_t, int>& b)
+{
+    return a.first > b.first;
+}
+
+int PlannedAllocator::plan()
+{
+    if (arena)
+    {
+        fprintf(stderr, "memory plan already done\n");
+        return -1;
+    }
+
+    const int count = records.size();
+
+    // place the largest buffers first
+    std::vector< std::pair<size_t, int> > order(count);
+    for (int i=0; i<count; i++)
+    {
+        order[i] = std::make_pair(records[i].size, i);
+    }
+    std::stable_sort(order.begin(), order.end(), record_size_greater);
+
+    arena_size = 0;
+
+    std::vector<int> placed;
+    placed.reserve(count);
+    for (int i=0; i<count; i++)
+    {
+        Record& r = records[order[i].second];
+
+        // buffers already placed whose lifetime overlaps this one, sorted by offset
+        std::vector< std::pair<size_t, size_t> > conflicts;
+        for (size_t j=0; j<placed.size(); j++)
+        {
+            const Record& p = records[placed[j]];
+            if (p.alloc_time < r.free_time && r.alloc_time < p.free_time)
+                conflicts.push_back(std::make_pair(p.offset, p.size));
+        }
+        std::sort(conflicts.begin(), conflicts.end());
+
+        // first gap large enough
+        size_t offset = 0;
+        for (size_t j=0; j<conflicts.size(); j++)
+        {
+            if (conflicts[j].first >= offset + r.size)
+                break;
+
+            offset = std::max(offset, conflicts[j].first + conflicts[j].second);
+        }
+
+        r.offset = offset;
+        arena_size = std::max(arena_size, offset + r.size);
+
+        placed.push_back(order[i].second);
+    }
+
+    arena = (unsigned char*)ncnn::fastMalloc(arena_size);
+    if (!arena)
+    {
+        arena_size = 0;
+        return -100;
+    }
+
+    cursor = 0;
+
+    return 0;
+}
+
+void PlannedAllocator::clear()
+{
+    ncnn::fastFree(arena);
+    arena = 0;
+    arena_size = 0;
+    cursor = 0;
+
+    records.clear();
+    time = 0;
+    live_size = 0;
+    peak_size = 0;
+}
+
+size_t PlannedAllocator::planned_size() const
+{
+    return arena_size;
+}
+
+size_t PlannedAllocator::naive_size() const
+{
+    return peak_size;
+}
+
+void* PlannedAllocator::fastMalloc(size_t size)
+{
+    size = alignSize(size, MALLOC_ALIGN);
+
+    if (!arena)
+    {
+        // record
+        void* ptr = ncnn::fastMalloc(size);
+
+        Record r;
+        r.size = size;
+        r.alloc_time = time++;
+        r.free_time = INT_MAX;
+        r.offset = 0;
+        r.ptr = ptr;
+        records.push_back(r);
+
+        live_size += size;
+        peak_size = std::max(peak_size, live_size);
+
+        heap_payouts.push_back(ptr);
+
+        return ptr;
+    }
+
+    // replay, the run repeats the recorded sequence
+    // skip forward to the next record of the same size so that a diverged sequence can catch up
+    const size_t count = records.size();
+    for (size_t i=0; i<count; i++)
+    {
+        size_t k = (cursor + i) % count;
+        const Record& r = records[k];
+        if (r.size != size)
+            continue;
+
+        // the planned region may still be held from a previous run
+        bool busy = false;
+        std::list< std::pair<size_t, size_t> >::iterator it = arena_payouts.begin();
+        for (; it != arena_payouts.end(); it++)
+        {
+            if (it->first < r.offset + r.size && r.offset < it->first + it->second)
+            {
+                busy = true;
+                break;
+            }
+        }
+
+        if (busy)
+            break;
+
+        cursor = k + 1;
+
+        arena_payouts.push_back(std::make_pair(r.offset, r.size));
+
+        return arena + r.offset;
+    }
+
+    // miss
+    void* ptr = ncnn::fastMalloc(size);
+
+    heap_payouts.push_back(ptr);
+
+    return ptr;
+}
+
+void PlannedAllocator::fastFree(void* ptr)
+{
+    if (arena && (unsigned char*)ptr >= arena && (unsigned char*)ptr < arena + arena_size)
+    {
+        size_t offset = (unsigned char*)ptr - arena;
+
+        std::list< std::pair<size_t, size_t> >::iterator it = arena_payouts.begin();
+        for (; it != arena_payouts.end(); it++)
+        {
+            if (it->first == offset)
+            {
+                arena_payouts.erase(it);
+                return;
+            }
+        }
+
+        fprintf(stderr, "FATAL ERROR! planned allocator get wild %p\n", ptr);
+        return;
+    }
+
+    std::list<void*>::iterator it = heap_payouts.begin();
+    for (; it != heap_payouts.end(); it++)
+    {
+        if (*it == ptr)
+        {
+            heap_payouts.erase(it);
+
+            if (!arena)
+            {
+                // close the lifetime of the recorded buffer
+                for (int i=(int)records.size()-1; i>=0; i--)
+                {
+                    if (records[i].ptr == ptr && records[i].free_time == INT_MAX)
+                    {
+                        records[i].free_time = time++;
+                        live_size -= records[i].size;
+                        break;
+                    }
+                }
+            }
+
+            ncnn::fastFree(ptr);
+            return;
+        }
+    }
+
+    fprintf(stderr, "FATAL ERROR! planned allocator get wild %p\n", ptr);
+    ncnn::fastFree(ptr);
+}
+
+} // namespace ncnn
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "cpu.h"
+#include "threadpool.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -22,9 +23,25 @@
 #include <omp.h>
 #endif
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 #ifdef __ANDROID__
 #include <sys/syscall.h>
-#include <unistd.h>
+#endif
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define __X86__ 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
 #endif
 
 #if __APPLE__
@@ -170,6 +187,136 @@ int cpu_support_arm_asimdhp()
 #endif
 }
 
+#if __X86__
+static void x86_cpuid(int level, int count, unsigned int regs[4])
+{
+#ifdef _MSC_VER
+    __cpuidex((int*)regs, level, count);
+#else
+    __cpuid_count(level, count, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned int x86_get_xcr0()
+{
+#ifdef _MSC_VER
+    return (unsigned int)_xgetbv(0);
+#else
+    unsigned int eax;
+    unsigned int edx;
+    // xgetbv, spelled out for old assemblers
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(0));
+    return eax;
+#endif
+}
+
+#define X86_SSE41       (1 << 0)
+#define X86_AVX         (1 << 1)
+#define X86_AVX2        (1 << 2)
+#define X86_FMA         (1 << 3)
+#define X86_F16C        (1 << 4)
+#define X86_AVX512      (1 << 5)
+
+static unsigned int get_x86_cpu_features()
+{
+    unsigned int regs[4];
+
+    x86_cpuid(0, 0, regs);
+    unsigned int max_level = regs[0];
+    if (max_level < 1)
+        return 0;
+
+    unsigned int features = 0;
+
+    x86_cpuid(1, 0, regs);
+    unsigned int ecx = regs[2];
+
+    if (ecx & (1 << 19))
+        features |= X86_SSE41;
+
+    // the os must save xmm ymm state for avx and opmask zmm state for avx512
+    unsigned int xcr0 = (ecx & (1 << 27)) ? x86_get_xcr0() : 0;
+    bool os_ymm = (xcr0 & 0x06) == 0x06;
+    bool os_zmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (os_ymm && (ecx & (1 << 28)))
+        features |= X86_AVX;
+    if (os_ymm && (ecx & (1 << 12)))
+        features |= X86_FMA;
+    if (os_ymm && (ecx & (1 << 29)))
+        features |= X86_F16C;
+
+    if (max_level >= 7)
+    {
+        x86_cpuid(7, 0, regs);
+        unsigned int ebx = regs[1];
+
+        if (os_ymm && (ebx & (1 << 5)))
+            features |= X86_AVX2;
+        if (os_zmm && (ebx & (1 << 16)))
+            features |= X86_AVX512;
+    }
+
+    return features;
+}
+
+static unsigned int g_x86_cpu_features = get_x86_cpu_features();
+#endif // __X86__
+
+int cpu_support_x86_sse41()
+{
+#if __X86__
+    return g_x86_cpu_features & X86_SSE41;
+#else
+    return 0;
+#endif
+}
+
+int cpu_support_x86_avx()
+{
+#if __X86__
+    return g_x86_cpu_features & X86_AVX;
+#else
+    return 0;
+#endif
+}
+
+int cpu_support_x86_avx2()
+{
+#if __X86__
+    return g_x86_cpu_features & X86_AVX2;
+#else
+    return 0;
+#endif
+}
+
+int cpu_support_x86_fma()
+{
+#if __X86__
+    return g_x86_cpu_features & X86_FMA;
+#else
+    return 0;
+#endif
+}
+
+int cpu_support_x86_f16c()
+{
+#if __X86__
+    return g_x86_cpu_features & X86_F16C;
+#else
+    return 0;
+#endif
+}
+
+int cpu_support_x86_avx512()
+{
+#if __X86__
+    return g_x86_cpu_features & X86_AVX512;
+#else
+    return 0;
+#endif
+}
+
 static int get_cpucount()
 {
 #ifdef __ANDROID__
@@ -203,12 +350,27 @@ static int get_cpucount()
     size_t len = sizeof(count);
     sysctlbyname("hw.ncpu", &count, &len, NULL, 0);
 
+    if (count < 1)
+        count = 1;
+
+    return count;
+#elif defined _WIN32
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+
+    int count = system_info.dwNumberOfProcessors;
+
     if (count < 1)
         count = 1;
 
     return count;
 #else
-    return 1;
+    int count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (count < 1)
+        count = 1;
+
+    return count;
 #endif
 }
 
@@ -216,6 +378,10 @@ static int g_cpucount = get_cpucount();
 
 int get_cpu_count()
 {
+    // the default option is built by a static constructor that may run first
+    if (g_cpucount == 0)
+        return get_cpucount();
+
     return g_cpucount;
 }
 
@@ -418,7 +584,18 @@ int set_cpu_powersave(int powersave)
         return -1;
     }
 
-#ifdef _OPENMP
+#if NCNN_THREADPOOL
+    // the calling thread and the workers of the default pool
+    int ssaret = set_sched_affinity(cpuids);
+    if (ssaret != 0)
+    {
+        return -1;
+    }
+    if (get_default_thread_pool()->set_cpu_affinity(cpuids) != 0)
+    {
+        return -1;
+    }
+#elif defined _OPENMP
     // set affinity for each thread
     int num_threads = cpuids.size();
     omp_set_num_threads(num_threads);
@@ -25,6 +25,20 @@ int cpu_support_arm_vfpv4();
 // asimdhp = aarch64 asimd half precision
 int cpu_support_arm_asimdhp();
 
+// x86 features are reported only when the os saves the wider registers too
+// sse41 = sse4.1
+int cpu_support_x86_sse41();
+// avx = 256bit float
+int cpu_support_x86_avx();
+// avx2 = 256bit integer
+int cpu_support_x86_avx2();
+// fma = fused multiply-add
+int cpu_support_x86_fma();
+// f16c = half precision conversion
+int cpu_support_x86_f16c();
+// avx512 = avx512f
+int cpu_support_x86_avx512();
+
 // cpu info
 int get_cpu_count();
 
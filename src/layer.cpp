@@ -14,14 +14,52 @@
 
 #include "layer.h"
 
+#include <stdio.h>
 #include <string.h>
+#include "cpu.h"
 
 namespace ncnn {
 
+Option::Option()
+{
+    lightmode = true;
+    num_threads = get_cpu_count();
+    thread_pool = 0;
+    blob_allocator = 0;
+    workspace_allocator = 0;
+    use_branch_parallel = false;
+    use_fp16_storage = false;
+    use_packing_layout = false;
+    use_int8_inference = true;
+    profiler = 0;
+}
+
+static Option g_default_option;
+
+const Option& get_default_option()
+{
+    return g_default_option;
+}
+
+int set_default_option(const Option& opt)
+{
+    if (opt.num_threads <= 0)
+    {
+        fprintf(stderr, "invalid option num_threads %d\n", opt.num_threads);
+        return -1;
+    }
+
+    g_default_option = opt;
+
+    return 0;
+}
+
 Layer::Layer()
 {
     one_blob_only = false;
     support_inplace = false;
+    support_packing = false;
+    typeindex = -1;
 }
 
 Layer::~Layer()
@@ -38,7 +76,27 @@ int Layer::load_model(const ModelBin& /*mb*/)
     return 0;
 }
 
-int Layer::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+int Layer::create_pipeline()
+{
+    return 0;
+}
+
+int Layer::destroy_pipeline()
+{
+    return 0;
+}
+
+int Layer::save_prepared(std::vector<Mat>& /*weights*/) const
+{
+    return -1;
+}
+
+int Layer::load_prepared(const ModelBin& /*mb*/)
+{
+    return -1;
+}
+
+int Layer::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     if (!support_inplace)
         return -1;
@@ -46,36 +104,86 @@ int Layer::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_b
     top_blobs = bottom_blobs;
     for (int i = 0; i < (int)top_blobs.size(); i++)
     {
-        top_blobs[i] = bottom_blobs[i].clone();
+        top_blobs[i] = bottom_blobs[i].clone(opt.blob_allocator);
         if (top_blobs[i].empty())
             return -100;
     }
 
-    return forward_inplace(top_blobs);
+    return forward_inplace(top_blobs, opt);
 }
 
-int Layer::forward(const Mat& bottom_blob, Mat& top_blob) const
+int Layer::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     if (!support_inplace)
         return -1;
 
-    top_blob = bottom_blob.clone();
+    top_blob = bottom_blob.clone(opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
-    return forward_inplace(top_blob);
+    return forward_inplace(top_blob, opt);
 }
 
-int Layer::forward_inplace(std::vector<Mat>& /*bottom_top_blobs*/) const
+int Layer::forward_inplace(std::vector<Mat>& /*bottom_top_blobs*/, const Option& /*opt*/) const
 {
     return -1;
 }
 
-int Layer::forward_inplace(Mat& /*bottom_top_blob*/) const
+int Layer::forward_inplace(Mat& /*bottom_top_blob*/, const Option& /*opt*/) const
 {
     return -1;
 }
 
+int Layer::forward_batch(const std::vector< std::vector<Mat> >& bottom_blobs, std::vector< std::vector<Mat> >& top_blobs, const Option& opt) const
+{
+    const int batch = bottom_blobs.size();
+
+    top_blobs.resize(batch);
+    for (int i=0; i<batch; i++)
+    {
+        top_blobs[i].resize(tops.size());
+
+        int ret = forward(bottom_blobs[i], top_blobs[i], opt);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+int Layer::forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    const int batch = bottom_blobs.size();
+
+    top_blobs.resize(batch);
+    for (int i=0; i<batch; i++)
+    {
+        int ret = forward(bottom_blobs[i], top_blobs[i], opt);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+int Layer::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    if (!support_inplace)
+        return -1;
+
+    for (size_t i=0; i<_top_shapes.size() && i<_bottom_shapes.size(); i++)
+    {
+        _top_shapes[i] = _bottom_shapes[i];
+    }
+
+    return 0;
+}
+
+const char* Layer::kernel_name(const Mat& /*bottom_blob*/) const
+{
+    return 0;
+}
+
 #include "layer_declaration.h"
 
 static const layer_registry_entry layer_registry[] =
@@ -85,6 +193,27 @@ static const layer_registry_entry layer_registry[] =
 
 static const int layer_registry_entry_count = sizeof(layer_registry) / sizeof(layer_registry_entry);
 
+#if NCNN_AVX
+static const layer_creator_func layer_registry_avx[] =
+{
+#include "layer_registry_avx.h"
+};
+#endif // NCNN_AVX
+
+#if NCNN_AVX2
+static const layer_creator_func layer_registry_avx2[] =
+{
+#include "layer_registry_avx2.h"
+};
+#endif // NCNN_AVX2
+
+#if NCNN_AVX512
+static const layer_creator_func layer_registry_avx512[] =
+{
+#include "layer_registry_avx512.h"
+};
+#endif // NCNN_AVX512
+
 #if NCNN_STRING
 int layer_to_index(const char* type)
 {
@@ -113,10 +242,48 @@ Layer* create_layer(int index)
         return 0;
 
     layer_creator_func layer_creator = layer_registry[index].creator;
+
+#if NCNN_AVX || NCNN_AVX2 || NCNN_AVX512
+    const int isa_level = layer_isa_level();
+#endif
+#if NCNN_AVX
+    if (isa_level == 1)
+        layer_creator = layer_registry_avx[index];
+#endif
+#if NCNN_AVX2
+    if (isa_level == 2)
+        layer_creator = layer_registry_avx2[index];
+#endif
+#if NCNN_AVX512
+    if (isa_level == 3)
+        layer_creator = layer_registry_avx512[index];
+#endif
+
     if (!layer_creator)
         return 0;
 
     return layer_creator();
 }
 
+int layer_isa_level()
+{
+    int isa_level = 0;
+
+    // the widest isa build the cpu can run
+#if NCNN_AVX
+    if (cpu_support_x86_avx())
+        isa_level = 1;
+#endif
+#if NCNN_AVX2
+    if (cpu_support_x86_avx2() && cpu_support_x86_fma() && cpu_support_x86_f16c())
+        isa_level = 2;
+#endif
+#if NCNN_AVX512
+    if (cpu_support_x86_avx512() && cpu_support_x86_avx2() && cpu_support_x86_fma() && cpu_support_x86_f16c())
+        isa_level = 3;
+#endif
+
+    return isa_level;
+}
+
 } // namespace ncnn
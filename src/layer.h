@@ -25,6 +25,69 @@
 
 namespace ncnn {
 
+class Allocator;
+class Profiler;
+class ThreadPool;
+class Option
+{
+public:
+    // default option
+    Option();
+
+public:
+    // light mode
+    // intermediate blob will be recycled when enabled
+    // layers also drop the float weights they repacked for their kernels
+    // when it is on in the global default option at model loading
+    // enabled by default
+    bool lightmode;
+
+    // thread count
+    // default value is the one returned by get_cpu_count()
+    int num_threads;
+
+    // worker threads the layers run their parallel loops on
+    // 0 uses the default pool shared by the whole process
+    // ignored when built with NCNN_THREADPOOL off, openmp runs the loops then
+    ThreadPool* thread_pool;
+
+    // blob memory allocator
+    Allocator* blob_allocator;
+
+    // workspace memory allocator
+    Allocator* workspace_allocator;
+
+    // run independent branches of the graph at the same time
+    // blob and workspace allocator must be thread-safe when enabled
+    // disabled by default
+    bool use_branch_parallel;
+
+    // keep the weights of memory bound layers in half precision
+    // picked up from the global default option at model loading
+    // only honored where the cpu converts fp16 in hardware
+    // disabled by default
+    bool use_fp16_storage;
+
+    // pass blobs in the channel packed layout between the layers supporting it
+    // the net converts at the boundaries of the other layers
+    // disabled by default
+    bool use_packing_layout;
+
+    // run the layers carrying calibrated int8 scales with int8 weights and activations
+    // picked up from the global default option at model loading
+    // enabled by default
+    bool use_int8_inference;
+
+    // record every layer run into the profiler, set by Extractor::set_profiler
+    // 0 disables profiling
+    // disabled by default
+    Profiler* profiler;
+};
+
+// the global default option
+const Option& get_default_option();
+int set_default_option(const Option& opt);
+
 class Layer
 {
 public:
@@ -41,6 +104,27 @@ public:
     // return 0 if success
     virtual int load_model(const ModelBin& mb);
 
+    // prepare the weights for the kernels, once after load_model
+    // net runs it for several layers at a time after reading the whole model
+    // layers driven directly must call it before forward
+    // return 0 if success
+    virtual int create_pipeline();
+
+    // undo create_pipeline, the weights are back as load_model read them
+    // net runs it before changing the weights of a loaded layer, create_pipeline follows
+    // return 0 if success
+    virtual int destroy_pipeline();
+
+    // hand out the weights as create_pipeline prepared them for the kernels
+    // written to the prepared model cache and given back to load_prepared in order
+    // return 0 if success, -1 if the model weights are cached as loaded
+    virtual int save_prepared(std::vector<Mat>& weights) const;
+
+    // take the weights from save_prepared instead of load_model and create_pipeline
+    // mb hands them back in order with their shapes, the sizes passed to load are not used
+    // return 0 if success
+    virtual int load_prepared(const ModelBin& mb);
+
 public:
     // one input and one output blob
     bool one_blob_only;
@@ -48,18 +132,43 @@ public:
     // support inplace inference
     bool support_inplace;
 
+    // accept channel packed blobs, elempack 4
+    // the top blobs keep the packing of the bottom blobs
+    bool support_packing;
+
 public:
     // implement inference
     // return 0 if success
-    virtual int forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const;
-    virtual int forward(const Mat& bottom_blob, Mat& top_blob) const;
+    virtual int forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt = get_default_option()) const;
+    virtual int forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt = get_default_option()) const;
 
     // implement inplace inference
     // return 0 if success
-    virtual int forward_inplace(std::vector<Mat>& bottom_top_blobs) const;
-    virtual int forward_inplace(Mat& bottom_top_blob) const;
+    virtual int forward_inplace(std::vector<Mat>& bottom_top_blobs, const Option& opt = get_default_option()) const;
+    virtual int forward_inplace(Mat& bottom_top_blob, const Option& opt = get_default_option()) const;
+
+    // implement batched inference
+    // the blobs of the n-th sample are bottom_blobs[n] and top_blobs[n]
+    // the default implementation runs the samples one by one
+    // return 0 if success
+    virtual int forward_batch(const std::vector< std::vector<Mat> >& bottom_blobs, std::vector< std::vector<Mat> >& top_blobs, const Option& opt = get_default_option()) const;
+    virtual int forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt = get_default_option()) const;
+
+    // infer top shapes from bottom shapes before any forward
+    // shape mats carry dims w h c without data
+    // layers may prepare their kernel plan for these shapes here
+    // the default implementation keeps the shape for inplace layers
+    // return 0 if success, -1 if the top shape is only known in forward
+    virtual int infer_shape(const std::vector<Mat>& bottom_shapes, std::vector<Mat>& top_shapes);
+
+    // name of the kernel forward picks for this bottom blob, reported by the profiler
+    // return 0 if the layer has a single implementation
+    virtual const char* kernel_name(const Mat& bottom_blob) const;
 
 public:
+    // layer type index
+    // custom layers have LayerType::CustomBit set, -1 if unknown
+    int typeindex;
 #if NCNN_STRING
     // layer type name
     std::string type;
@@ -70,6 +179,10 @@ public:
     std::vector<int> bottoms;
     // blob index which this layer produces as output
     std::vector<int> tops;
+
+    // shapes from the last shape inference, empty if unknown
+    std::vector<Mat> bottom_shapes;
+    std::vector<Mat> top_shapes;
 };
 
 // layer factory function
@@ -94,8 +207,17 @@ Layer* create_layer(const char* type);
 // create layer from layer type
 Layer* create_layer(int index);
 
-#define DEFINE_LAYER_CREATOR(name) \
+// isa build create_layer picks on this cpu
+// 0 = baseline
+// 1 = avx
+// 2 = avx2
+// 3 = avx512
+int layer_isa_level();
+
+// expand name first, the per isa x86 builds rename the class with a macro
+#define DEFINE_LAYER_CREATOR_0(name) \
     ::ncnn::Layer* name##_layer_creator() { return new name; }
+#define DEFINE_LAYER_CREATOR(name) DEFINE_LAYER_CREATOR_0(name)
 
 } // namespace ncnn
 
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "absval.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -24,24 +25,45 @@ AbsVal::AbsVal()
     support_inplace = true;
 }
 
-int AbsVal::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct absval_task : public ParallelTask
+{
+    absval_task(Mat& _bottom_top_blob, int _size)
+        : bottom_top_blob(_bottom_top_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+};
+
+void absval_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        if (ptr[i] < 0)
+            ptr[i] = -ptr[i];
+    }
+}
+
+} // namespace
+
+int AbsVal::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
     int channels = bottom_top_blob.c;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
+    absval_task task(bottom_top_blob, size);
 
-        for (int i=0; i<size; i++)
-        {
-            if (ptr[i] < 0)
-                ptr[i] = -ptr[i];
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
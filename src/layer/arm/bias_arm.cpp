@@ -22,7 +22,7 @@ namespace ncnn {
 
 DEFINE_LAYER_CREATOR(Bias_arm)
 
-int Bias_arm::forward_inplace(Mat& bottom_top_blob) const
+int Bias_arm::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
@@ -30,7 +30,7 @@ int Bias_arm::forward_inplace(Mat& bottom_top_blob) const
     int size = w * h;
 
     const float* bias_ptr = bias_data;
-    #pragma omp parallel for
+    #pragma omp parallel for num_threads(opt.num_threads)
     for (int q=0; q<channels; q++)
     {
         float* ptr = bottom_top_blob.channel(q);
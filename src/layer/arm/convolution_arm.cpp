@@ -14,6 +14,10 @@
 
 #include "convolution_arm.h"
 
+#include <string.h>
+
+#include "fused_activation.h"
+
 namespace ncnn {
 
 #include "convolution_1x1.h"
@@ -44,9 +48,9 @@ int Convolution_arm::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Convolution_arm::load_model(const ModelBin& mb)
+int Convolution_arm::create_pipeline()
 {
-    int ret = Convolution::load_model(mb);
+    int ret = Convolution::create_pipeline();
     if (ret != 0)
         return ret;
 
@@ -59,14 +63,36 @@ int Convolution_arm::load_model(const ModelBin& mb)
     return 0;
 }
 
-int Convolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
+int Convolution_arm::save_prepared(std::vector<Mat>& weights) const
+{
+    int ret = Convolution::save_prepared(weights);
+    if (ret != 0)
+        return ret;
+
+    weights.push_back(weight_3x3_winograd64_data);
+
+    return 0;
+}
+
+int Convolution_arm::load_prepared(const ModelBin& mb)
+{
+    int ret = Convolution::load_prepared(mb);
+    if (ret != 0)
+        return ret;
+
+    weight_3x3_winograd64_data = mb.load(0, 0);
+
+    return 0;
+}
+
+int Convolution_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     // convolv with NxN kernel
     // value = value + bias
 
     if (kernel_w != kernel_h || stride_w != stride_h)
     {
-        return Convolution::forward(bottom_blob, top_blob);
+        return Convolution::forward(bottom_blob, top_blob, opt);
     }
 
     const int kernel_size = kernel_w;
@@ -74,10 +100,10 @@ int Convolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
 
     if (kernel_size > 7 || stride > 4 || dilation_w != 1 || dilation_h != 1)
     {
-        return Convolution::forward(bottom_blob, top_blob);
+        return Convolution::forward(bottom_blob, top_blob, opt);
     }
 
-    typedef void (*conv_func)(const Mat&, Mat&, const Mat&, const Mat&);
+    typedef void (*conv_func)(const Mat&, Mat&, const Mat&, const Mat&, const Option&);
 
     // kernel_size x stride
     conv_func conv_func_table[7][4] =
@@ -129,7 +155,7 @@ int Convolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
     conv_func conv = conv_func_table[kernel_size-1][stride-1];
     if (!conv)
     {
-        return Convolution::forward(bottom_blob, top_blob);
+        return Convolution::forward(bottom_blob, top_blob, opt);
     }
 
     int w = bottom_blob.w;
@@ -139,7 +165,7 @@ int Convolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
     Mat bottom_blob_bordered = bottom_blob;
     if (pad_w > 0 || pad_h > 0)
     {
-        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f);
+        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
         if (bottom_blob_bordered.empty())
             return -100;
 
@@ -152,7 +178,7 @@ int Convolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
         int hpad = kernel_size + (h - 1) / stride * stride - h;
         if (wpad > 0 || hpad > 0)
         {
-            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f);
+            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
             if (bottom_blob_bordered.empty())
                 return -100;
         }
@@ -164,16 +190,92 @@ int Convolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
     int outw = (w - kernel_size) / stride + 1;
     int outh = (h - kernel_size) / stride + 1;
 
-    top_blob.create(outw, outh, num_output);
+    top_blob.create(outw, outh, num_output, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
     if (use_winograd3x3 && w <= 120 && h <= 120)
     {
-        conv3x3s1_winograd64_neon4(bottom_blob_bordered, top_blob, weight_3x3_winograd64_data, bias_data);
+        conv3x3s1_winograd64_neon4(bottom_blob_bordered, top_blob, weight_3x3_winograd64_data, bias_data, opt);
     }
     else
-        conv(bottom_blob_bordered, top_blob, weight_data, bias_data);
+        conv(bottom_blob_bordered, top_blob, weight_data, bias_data, opt);
+
+    activation_inplace(top_blob, activation_type, activation_params, opt);
+
+    return 0;
+}
+
+int Convolution_arm::forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    // 1x1 s1 runs once over the columns of every sample side by side
+    if (use_int8_inference || kernel_w != 1 || kernel_h != 1 || stride_w != 1 || stride_h != 1 || dilation_w != 1 || dilation_h != 1 || pad_w > 0 || pad_h > 0)
+        return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+    const int batch = bottom_blobs.size();
+    if (batch < 2)
+        return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+    const int channels = bottom_blobs[0].c;
+
+    int size = 0;
+    for (int n=0; n<batch; n++)
+    {
+        if (bottom_blobs[n].dims != 3 || bottom_blobs[n].c != channels)
+            return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+        size += bottom_blobs[n].w * bottom_blobs[n].h;
+    }
+
+    Mat bottom_blob_batch(size, 1, channels, 4u, opt.workspace_allocator);
+    if (bottom_blob_batch.empty())
+        return -100;
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int q=0; q<channels; q++)
+    {
+        float* outptr = bottom_blob_batch.channel(q);
+
+        for (int n=0; n<batch; n++)
+        {
+            const int sample_size = bottom_blobs[n].w * bottom_blobs[n].h;
+
+            memcpy(outptr, bottom_blobs[n].channel(q), sample_size * sizeof(float));
+
+            outptr += sample_size;
+        }
+    }
+
+    Mat top_blob_batch(size, 1, num_output, 4u, opt.workspace_allocator);
+    if (top_blob_batch.empty())
+        return -100;
+
+    conv1x1s1_neon(bottom_blob_batch, top_blob_batch, weight_data, bias_data, opt);
+
+    activation_inplace(top_blob_batch, activation_type, activation_params, opt);
+
+    top_blobs.resize(batch);
+    for (int n=0; n<batch; n++)
+    {
+        top_blobs[n].create(bottom_blobs[n].w, bottom_blobs[n].h, num_output, 4u, opt.blob_allocator);
+        if (top_blobs[n].empty())
+            return -100;
+    }
+
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int p=0; p<num_output; p++)
+    {
+        const float* ptr = top_blob_batch.channel(p);
+
+        for (int n=0; n<batch; n++)
+        {
+            const int sample_size = top_blobs[n].w * top_blobs[n].h;
+
+            memcpy(top_blobs[n].channel(p), ptr, sample_size * sizeof(float));
+
+            ptr += sample_size;
+        }
+    }
 
     return 0;
 }
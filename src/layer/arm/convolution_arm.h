@@ -24,9 +24,15 @@ class Convolution_arm : public Convolution
 public:
     virtual int load_param(const ParamDict& pd);
 
-    virtual int load_model(const ModelBin& mb);
+    virtual int create_pipeline();
 
-    virtual int forward(const Mat& bottom_blob, Mat& top_blob) const;
+    virtual int save_prepared(std::vector<Mat>& weights) const;
+
+    virtual int load_prepared(const ModelBin& mb);
+
+    virtual int forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const;
+
+    virtual int forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const;
 
 public:
     bool use_winograd3x3;
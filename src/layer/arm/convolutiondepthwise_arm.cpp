@@ -18,6 +18,7 @@
 #include <omp.h>
 #endif
 
+#include "fused_activation.h"
 #include "layer_type.h"
 
 namespace ncnn {
@@ -26,7 +27,7 @@ namespace ncnn {
 
 DEFINE_LAYER_CREATOR(ConvolutionDepthWise_arm)
 
-int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
+int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     // convolv with NxN kernel
     // value = value + bias
@@ -47,7 +48,7 @@ int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) con
     Mat bottom_blob_bordered = bottom_blob;
     if (pad_w > 0 || pad_h > 0)
     {
-        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f);
+        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
         if (bottom_blob_bordered.empty())
             return -100;
 
@@ -60,7 +61,7 @@ int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) con
         int hpad = kernel_extent_h + (h - 1) / stride_h * stride_h - h;
         if (wpad > 0 || hpad > 0)
         {
-            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f);
+            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
             if (bottom_blob_bordered.empty())
                 return -100;
         }
@@ -72,7 +73,7 @@ int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) con
     int outw = (w - kernel_extent_w) / stride_w + 1;
     int outh = (h - kernel_extent_h) / stride_h + 1;
 
-    top_blob.create(outw, outh, num_output);
+    top_blob.create(outw, outh, num_output, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -85,12 +86,14 @@ int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) con
         {
             if (stride_w == 1 && stride_h == 1)
             {
-                convdw3x3s1_neon(bottom_blob_bordered, top_blob, weight_data, bias_data);
+                convdw3x3s1_neon(bottom_blob_bordered, top_blob, weight_data, bias_data, opt);
+                activation_inplace(top_blob, activation_type, activation_params, opt);
                 return 0;
             }
             else if (stride_w == 2 && stride_h == 2)
             {
-                convdw3x3s2_neon(bottom_blob_bordered, top_blob, weight_data, bias_data);
+                convdw3x3s2_neon(bottom_blob_bordered, top_blob, weight_data, bias_data, opt);
+                activation_inplace(top_blob, activation_type, activation_params, opt);
                 return 0;
             }
         }
@@ -100,7 +103,7 @@ int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) con
         omp_set_nested(0);
 #endif
 
-        #pragma omp parallel for
+        #pragma omp parallel for num_threads(opt.num_threads)
         for (int g=0; g<group; g++)
         {
             Mat bottom_blob_bordered_g = bottom_blob_bordered.channel(g);
@@ -126,6 +129,8 @@ int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) con
             pd.set(14, 0);// pad_h
             pd.set(5, bias_term);
             pd.set(6, maxk);// weight_data_size
+            pd.set(9, activation_type);
+            pd.set(10, activation_params);
 
             op->load_param(pd);
 
@@ -136,8 +141,12 @@ int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) con
 
             op->load_model(ModelBinFromMatArray(weights));
 
+            op->create_pipeline();
+
             // forward
-            op->forward(bottom_blob_bordered_g, top_blob_g);
+            Option opt_g = opt;
+            opt_g.blob_allocator = top_blob_g.allocator;
+            op->forward(bottom_blob_bordered_g, top_blob_g, opt_g);
 
             delete op;
         }
@@ -176,6 +185,8 @@ int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) con
         pd.set(14, 0);// pad_h
         pd.set(5, bias_term);
         pd.set(6, maxk * channels_g * num_output_g);// weight_data_size
+        pd.set(9, activation_type);
+        pd.set(10, activation_params);
 
         op->load_param(pd);
 
@@ -186,8 +197,12 @@ int ConvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) con
 
         op->load_model(ModelBinFromMatArray(weights));
 
+        op->create_pipeline();
+
         // forward
-        op->forward(bottom_blob_bordered_g, top_blob_g);
+        Option opt_g = opt;
+        opt_g.blob_allocator = top_blob_g.allocator;
+        op->forward(bottom_blob_bordered_g, top_blob_g, opt_g);
 
         delete op;
     }
@@ -21,14 +21,14 @@ namespace ncnn {
 
 DEFINE_LAYER_CREATOR(Deconvolution_arm)
 
-int Deconvolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
+int Deconvolution_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     // deconvolv with NxN kernel
     // value = value + bias
 
     if (kernel_w != kernel_h || stride_w != stride_h)
     {
-        return Deconvolution::forward(bottom_blob, top_blob);
+        return Deconvolution::forward(bottom_blob, top_blob, opt);
     }
 
     const int kernel_size = kernel_w;
@@ -36,10 +36,10 @@ int Deconvolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
 
     if ((kernel_size != 3 && kernel_size != 4) || stride > 2 || dilation_w != 1 || dilation_h != 1)
     {
-        return Deconvolution::forward(bottom_blob, top_blob);
+        return Deconvolution::forward(bottom_blob, top_blob, opt);
     }
 
-    typedef void (*deconv_func)(const Mat&, Mat&, const Mat&, const Mat&);
+    typedef void (*deconv_func)(const Mat&, Mat&, const Mat&, const Mat&, const Option&);
 
     // kernel_size x stride
     deconv_func deconv_func_table[2][2] =
@@ -57,7 +57,7 @@ int Deconvolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
     deconv_func deconv = deconv_func_table[kernel_size-3][stride-1];
     if (!deconv)
     {
-        return Deconvolution::forward(bottom_blob, top_blob);
+        return Deconvolution::forward(bottom_blob, top_blob, opt);
     }
 
     int w = bottom_blob.w;
@@ -67,17 +67,17 @@ int Deconvolution_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
     int outh = (h - 1) * stride + kernel_size;
 
     Mat top_blob_bordered = top_blob;
-    top_blob_bordered.create(outw, outh, num_output);
+    top_blob_bordered.create(outw, outh, num_output, 4u, (pad_w > 0 || pad_h > 0) ? opt.workspace_allocator : opt.blob_allocator);
     if (top_blob_bordered.empty())
         return -100;
 
-    deconv(bottom_blob, top_blob_bordered, weight_data, bias_data);
+    deconv(bottom_blob, top_blob_bordered, weight_data, bias_data, opt);
 
     top_blob = top_blob_bordered;
 
     if (pad_w > 0 || pad_h > 0)
     {
-        copy_cut_border(top_blob_bordered, top_blob, pad_h, pad_h, pad_w, pad_w);
+        copy_cut_border(top_blob_bordered, top_blob, pad_h, pad_h, pad_w, pad_w, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
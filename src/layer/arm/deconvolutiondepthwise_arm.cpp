@@ -24,7 +24,7 @@ namespace ncnn {
 
 DEFINE_LAYER_CREATOR(DeconvolutionDepthWise_arm)
 
-int DeconvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
+int DeconvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     // convolv with NxN kernel
     // value = value + bias
@@ -46,7 +46,7 @@ int DeconvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) c
     int outh = (h - 1) * stride_h + kernel_extent_h;
 
     Mat top_blob_bordered = top_blob;
-    top_blob_bordered.create(outw, outh, num_output);
+    top_blob_bordered.create(outw, outh, num_output, 4u, (pad_w > 0 || pad_h > 0) ? opt.workspace_allocator : opt.blob_allocator);
     if (top_blob_bordered.empty())
         return -100;
 
@@ -60,7 +60,7 @@ int DeconvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) c
         omp_set_nested(0);
 #endif
 
-        #pragma omp parallel for
+        #pragma omp parallel for num_threads(opt.num_threads)
         for (int g=0; g<group; g++)
         {
             Mat top_blob_bordered_g = top_blob_bordered.channel(g);
@@ -97,8 +97,12 @@ int DeconvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) c
 
             op->load_model(ModelBinFromMatArray(weights));
 
+            op->create_pipeline();
+
             // forward
-            op->forward(bottom_blob_g, top_blob_bordered_g);
+            Option opt_g = opt;
+            opt_g.blob_allocator = top_blob_bordered_g.allocator;
+            op->forward(bottom_blob_g, top_blob_bordered_g, opt_g);
 
             delete op;
         }
@@ -147,8 +151,12 @@ int DeconvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) c
 
             op->load_model(ModelBinFromMatArray(weights));
 
+            op->create_pipeline();
+
             // forward
-            op->forward(bottom_blob_g, top_blob_bordered_g);
+            Option opt_g = opt;
+            opt_g.blob_allocator = top_blob_bordered_g.allocator;
+            op->forward(bottom_blob_g, top_blob_bordered_g, opt_g);
 
             delete op;
         }
@@ -158,7 +166,7 @@ int DeconvolutionDepthWise_arm::forward(const Mat& bottom_blob, Mat& top_blob) c
 
     if (pad_w > 0 || pad_h > 0)
     {
-        copy_cut_border(top_blob_bordered, top_blob, pad_h, pad_h, pad_w, pad_w);
+        copy_cut_border(top_blob_bordered, top_blob, pad_h, pad_h, pad_w, pad_w, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
@@ -14,6 +14,8 @@
 
 #include "innerproduct_arm.h"
 
+#include "fused_activation.h"
+
 #if __ARM_NEON
 #include <arm_neon.h>
 #endif // __ARM_NEON
@@ -22,14 +24,14 @@ namespace ncnn {
 
 DEFINE_LAYER_CREATOR(InnerProduct_arm)
 
-int InnerProduct_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
+int InnerProduct_arm::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     int w = bottom_blob.w;
     int h = bottom_blob.h;
     int channels = bottom_blob.c;
     int size = w * h;
 
-    top_blob.create(num_output);
+    top_blob.create(num_output, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -38,7 +40,7 @@ int InnerProduct_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
     int nn_num_output = num_output >> 2;
     int remain_num_output_start = nn_num_output << 2;
 
-    #pragma omp parallel for
+    #pragma omp parallel for num_threads(opt.num_threads)
     for (int pp=0; pp<nn_num_output; pp++)
     {
         int p = pp * 4;
@@ -136,14 +138,14 @@ int InnerProduct_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
 
 #endif // __ARM_NEON
 
-        top_blob[p] = sum0;
-        top_blob[p+1] = sum1;
-        top_blob[p+2] = sum2;
-        top_blob[p+3] = sum3;
+        top_blob[p] = activation_ss(sum0, activation_type, activation_params);
+        top_blob[p+1] = activation_ss(sum1, activation_type, activation_params);
+        top_blob[p+2] = activation_ss(sum2, activation_type, activation_params);
+        top_blob[p+3] = activation_ss(sum3, activation_type, activation_params);
     }
 
     // num_output
-    #pragma omp parallel for
+    #pragma omp parallel for num_threads(opt.num_threads)
     for (int p=remain_num_output_start; p<num_output; p++)
     {
         float sum = 0.f;
@@ -233,7 +235,7 @@ int InnerProduct_arm::forward(const Mat& bottom_blob, Mat& top_blob) const
 #endif // __aarch64__
 #endif // __ARM_NEON
 
-        top_blob[p] = sum;
+        top_blob[p] = activation_ss(sum, activation_type, activation_params);
     }
 
     return 0;
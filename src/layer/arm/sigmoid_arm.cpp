@@ -25,14 +25,14 @@ namespace ncnn {
 
 DEFINE_LAYER_CREATOR(Sigmoid_arm)
 
-int Sigmoid_arm::forward_inplace(Mat& bottom_top_blob) const
+int Sigmoid_arm::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
     int channels = bottom_top_blob.c;
     int size = w * h;
 
-    #pragma omp parallel for
+    #pragma omp parallel for num_threads(opt.num_threads)
     for (int q=0; q<channels; q++)
     {
         float* ptr = bottom_top_blob.channel(q);
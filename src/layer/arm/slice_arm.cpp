@@ -21,7 +21,7 @@ namespace ncnn {
 
 DEFINE_LAYER_CREATOR(Slice_arm)
 
-int Slice_arm::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+int Slice_arm::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     const Mat& bottom_blob = bottom_blobs[0];
     int w = bottom_blob.w;
@@ -39,7 +39,7 @@ int Slice_arm::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& t
         }
 
         Mat& top_blob = top_blobs[i];
-        top_blob.create(w, h, slice);
+        top_blob.create(w, h, slice, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
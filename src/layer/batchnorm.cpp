@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "batchnorm.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -67,7 +68,40 @@ int BatchNorm::load_model(const ModelBin& mb)
     return 0;
 }
 
-int BatchNorm::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct batchnorm_task : public ParallelTask
+{
+    batchnorm_task(Mat& _bottom_top_blob, const Mat& _a_data, const Mat& _b_data, int _size)
+        : bottom_top_blob(_bottom_top_blob), a_data(_a_data), b_data(_b_data), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& a_data;
+    const Mat& b_data;
+    int size;
+};
+
+void batchnorm_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    float a = a_data[q];
+    float b = b_data[q];
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = b * ptr[i] + a;
+    }
+}
+
+} // namespace
+
+int BatchNorm::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     // a = bias - slope * mean / sqrt(var)
     // b = slope / sqrt(var)
@@ -77,19 +111,9 @@ int BatchNorm::forward_inplace(Mat& bottom_top_blob) const
     int h = bottom_top_blob.h;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
-
-        float a = a_data[q];
-        float b = b_data[q];
+    batchnorm_task task(bottom_top_blob, a_data, b_data, size);
 
-        for (int i=0; i<size; i++)
-        {
-            ptr[i] = b * ptr[i] + a;
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
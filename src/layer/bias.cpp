@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "bias.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -40,25 +41,47 @@ int Bias::load_model(const ModelBin& mb)
     return 0;
 }
 
-int Bias::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct bias_task : public ParallelTask
+{
+    bias_task(Mat& _bottom_top_blob, const Mat& _bias_data, int _size)
+        : bottom_top_blob(_bottom_top_blob), bias_data(_bias_data), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& bias_data;
+    int size;
+};
+
+void bias_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    float bias = bias_data[q];
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] += bias;
+    }
+}
+
+} // namespace
+
+int Bias::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
     int channels = bottom_top_blob.c;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
-
-        float bias = bias_data[q];
+    bias_task task(bottom_top_blob, bias_data, size);
 
-        for (int i=0; i<size; i++)
-        {
-            ptr[i] += bias;
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "binaryop.h"
+#include "threadpool.h"
 #include <math.h>
 #include <algorithm>
 #include <functional>
@@ -42,8 +43,250 @@ int BinaryOp::load_param(const ParamDict& pd)
     return 0;
 }
 
+namespace {
+
+// one channel
+template<typename Op>
+struct binary_op_vv_task : public ParallelTask
+{
+    binary_op_vv_task(const Mat& _a, const Mat& _b, Mat& _c, int _size)
+        : a(_a), b(_b), c(_c), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int size;
+};
+
+template<typename Op>
+void binary_op_vv_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr = a.channel(q);
+    const float* ptr1 = b.channel(q);
+    float* outptr = c.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = op(ptr[i], ptr1[i]);
+    }
+}
+
+// one channel, b holds one value per row
+template<typename Op>
+struct binary_op_vs_rows_task : public ParallelTask
+{
+    binary_op_vs_rows_task(const Mat& _a, const Mat& _b, Mat& _c, int _w, int _h)
+        : a(_a), b(_b), c(_c), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int w;
+    int h;
+};
+
+template<typename Op>
+void binary_op_vs_rows_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr = a.channel(q);
+    const float* ptr1 = (const float*)b + h * q;
+    float* outptr = c.channel(q);
+
+    for (int y=0; y<h; y++)
+    {
+        const float b0 = ptr1[y];
+        for (int x=0; x<w; x++)
+        {
+            outptr[x] = op(ptr[x], b0);
+        }
+
+        ptr += w;
+        outptr += w;
+    }
+}
+
+// one channel
+template<typename Op>
+struct binary_op_vs_scalar_task : public ParallelTask
+{
+    binary_op_vs_scalar_task(const Mat& _a, Mat& _c, int _size, float _b0)
+        : a(_a), c(_c), size(_size), b0(_b0)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    Mat& c;
+    int size;
+    float b0;
+};
+
+template<typename Op>
+void binary_op_vs_scalar_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr = a.channel(q);
+    float* outptr = c.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = op(ptr[i], b0);
+    }
+}
+
+// one channel
+template<typename Op>
+struct binary_op_vs_task : public ParallelTask
+{
+    binary_op_vs_task(const Mat& _a, const Mat& _b, Mat& _c, int _size)
+        : a(_a), b(_b), c(_c), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int size;
+};
+
+template<typename Op>
+void binary_op_vs_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr = a.channel(q);
+    const float b0 = b[q];
+    float* outptr = c.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = op(ptr[i], b0);
+    }
+}
+
+// one channel, a holds one value per row
+template<typename Op>
+struct binary_op_sv_rows_task : public ParallelTask
+{
+    binary_op_sv_rows_task(const Mat& _a, const Mat& _b, Mat& _c, int _w1, int _h1)
+        : a(_a), b(_b), c(_c), w1(_w1), h1(_h1)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int w1;
+    int h1;
+};
+
 template<typename Op>
-static int binary_op(const Mat& a, const Mat& b, Mat& c)
+void binary_op_sv_rows_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr = (const float*)a + h1 * q;
+    const float* ptr1 = b.channel(q);
+    float* outptr = c.channel(q);
+
+    for (int y=0; y<h1; y++)
+    {
+        const float a0 = ptr[y];
+        for (int x=0; x<w1; x++)
+        {
+            outptr[x] = op(a0, ptr1[x]);
+        }
+
+        ptr1 += w1;
+        outptr += w1;
+    }
+}
+
+// one channel
+template<typename Op>
+struct binary_op_sv_scalar_task : public ParallelTask
+{
+    binary_op_sv_scalar_task(const Mat& _b, Mat& _c, int _size1, float _a0)
+        : b(_b), c(_c), size1(_size1), a0(_a0)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& b;
+    Mat& c;
+    int size1;
+    float a0;
+};
+
+template<typename Op>
+void binary_op_sv_scalar_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr1 = b.channel(q);
+    float* outptr = c.channel(q);
+
+    for (int i=0; i<size1; i++)
+    {
+        outptr[i] = op(a0, ptr1[i]);
+    }
+}
+
+// one channel
+template<typename Op>
+struct binary_op_sv_task : public ParallelTask
+{
+    binary_op_sv_task(const Mat& _a, const Mat& _b, Mat& _c, int _size1)
+        : a(_a), b(_b), c(_c), size1(_size1)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int size1;
+};
+
+template<typename Op>
+void binary_op_sv_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float a0 = a[q];
+    const float* ptr1 = b.channel(q);
+    float* outptr = c.channel(q);
+
+    for (int i=0; i<size1; i++)
+    {
+        outptr[i] = op(a0, ptr1[i]);
+    }
+}
+
+} // namespace
+
+template<typename Op>
+static int binary_op(const Mat& a, const Mat& b, Mat& c, const Option& opt)
 {
     Op op;
 
@@ -59,49 +302,24 @@ static int binary_op(const Mat& a, const Mat& b, Mat& c)
 
     if (a.dims == 3)
     {
-        c.create(w, h, channels);
+        c.create(w, h, channels, 4u, opt.blob_allocator);
         if (c.empty())
             return -100;
 
         if (b.dims == 3)
         {
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = a.channel(q);
-                const float* ptr1 = b.channel(q);
-                float* outptr = c.channel(q);
+            binary_op_vv_task<Op> task(a, b, c, size);
 
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = op(ptr[i], ptr1[i]);
-                }
-            }
+            parallel_for(task, channels, opt);
 
             return 0;
         }
 
         if (b.dims == 2)
         {
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = a.channel(q);
-                const float* ptr1 = (const float*)b + h * q;
-                float* outptr = c.channel(q);
+            binary_op_vs_rows_task<Op> task(a, b, c, w, h);
 
-                for (int y=0; y<h; y++)
-                {
-                    const float b0 = ptr1[y];
-                    for (int x=0; x<w; x++)
-                    {
-                        outptr[x] = op(ptr[x], b0);
-                    }
-
-                    ptr += w;
-                    outptr += w;
-                }
-            }
+            parallel_for(task, channels, opt);
 
             return 0;
         }
@@ -111,33 +329,16 @@ static int binary_op(const Mat& a, const Mat& b, Mat& c)
             if (b.w == 1)
             {
                 const float b0 = b[0];
-                #pragma omp parallel for
-                for (int q=0; q<channels; q++)
-                {
-                    const float* ptr = a.channel(q);
-                    float* outptr = c.channel(q);
+                binary_op_vs_scalar_task<Op> task(a, c, size, b0);
 
-                    for (int i=0; i<size; i++)
-                    {
-                        outptr[i] = op(ptr[i], b0);
-                    }
-                }
+                parallel_for(task, channels, opt);
 
                 return 0;
             }
 
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = a.channel(q);
-                const float b0 = b[q];
-                float* outptr = c.channel(q);
+            binary_op_vs_task<Op> task(a, b, c, size);
 
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = op(ptr[i], b0);
-                }
-            }
+            parallel_for(task, channels, opt);
 
             return 0;
         }
@@ -146,34 +347,18 @@ static int binary_op(const Mat& a, const Mat& b, Mat& c)
     {
         if (b.dims == 3)
         {
-            c.create(w1, h1, channels1);
+            c.create(w1, h1, channels1, 4u, opt.blob_allocator);
             if (c.empty())
                 return -100;
 
-            #pragma omp parallel for
-            for (int q=0; q<channels1; q++)
-            {
-                const float* ptr = (const float*)a + h1 * q;
-                const float* ptr1 = b.channel(q);
-                float* outptr = c.channel(q);
+            binary_op_sv_rows_task<Op> task(a, b, c, w1, h1);
 
-                for (int y=0; y<h1; y++)
-                {
-                    const float a0 = ptr[y];
-                    for (int x=0; x<w1; x++)
-                    {
-                        outptr[x] = op(a0, ptr1[x]);
-                    }
-
-                    ptr1 += w1;
-                    outptr += w1;
-                }
-            }
+            parallel_for(task, channels1, opt);
 
             return 0;
         }
 
-        c.create(w, h);
+        c.create(w, h, 4u, opt.blob_allocator);
         if (c.empty())
             return -100;
 
@@ -189,7 +374,7 @@ static int binary_op(const Mat& a, const Mat& b, Mat& c)
 
         if (b.dims == 1)
         {
-            c.create(w, h);
+            c.create(w, h, 4u, opt.blob_allocator);
             if (c.empty())
                 return -100;
 
@@ -228,29 +413,21 @@ static int binary_op(const Mat& a, const Mat& b, Mat& c)
         {
             if (b.dims == 3)
             {
-                c.create(w1, h1, channels1);
+                c.create(w1, h1, channels1, 4u, opt.blob_allocator);
                 if (c.empty())
                     return -100;
 
                 const float a0 = a[0];
-                #pragma omp parallel for
-                for (int q=0; q<channels1; q++)
-                {
-                    const float* ptr1 = b.channel(q);
-                    float* outptr = c.channel(q);
+                binary_op_sv_scalar_task<Op> task(b, c, size1, a0);
 
-                    for (int i=0; i<size1; i++)
-                    {
-                        outptr[i] = op(a0, ptr1[i]);
-                    }
-                }
+                parallel_for(task, channels1, opt);
 
                 return 0;
             }
 
             if (b.dims == 2)
             {
-                c.create(w1, h1);
+                c.create(w1, h1, 4u, opt.blob_allocator);
                 if (c.empty())
                     return -100;
 
@@ -265,7 +442,7 @@ static int binary_op(const Mat& a, const Mat& b, Mat& c)
 
             if (b.dims == 1)
             {
-                c.create(w1);
+                c.create(w1, 4u, opt.blob_allocator);
                 if (c.empty())
                     return -100;
 
@@ -281,29 +458,20 @@ static int binary_op(const Mat& a, const Mat& b, Mat& c)
 
         if (b.dims == 3)
         {
-            c.create(w1, h1, channels1);
+            c.create(w1, h1, channels1, 4u, opt.blob_allocator);
             if (c.empty())
                 return -100;
 
-            #pragma omp parallel for
-            for (int q=0; q<channels1; q++)
-            {
-                const float a0 = a[q];
-                const float* ptr1 = b.channel(q);
-                float* outptr = c.channel(q);
+            binary_op_sv_task<Op> task(a, b, c, size1);
 
-                for (int i=0; i<size1; i++)
-                {
-                    outptr[i] = op(a0, ptr1[i]);
-                }
-            }
+            parallel_for(task, channels1, opt);
 
             return 0;
         }
 
         if (b.dims == 2)
         {
-            c.create(w1, h1);
+            c.create(w1, h1, 4u, opt.blob_allocator);
             if (c.empty())
                 return -100;
 
@@ -327,7 +495,7 @@ static int binary_op(const Mat& a, const Mat& b, Mat& c)
 
         if (b.dims == 1)
         {
-            c.create(w);
+            c.create(w, 4u, opt.blob_allocator);
             if (c.empty())
                 return -100;
 
@@ -352,26 +520,50 @@ static int binary_op(const Mat& a, const Mat& b, Mat& c)
     return 0;
 }
 
+namespace {
+
+// one channel
 template<typename Op>
-static int binary_op_scalar_inplace(Mat& a, float b)
+struct binary_op_scalar_inplace_task : public ParallelTask
+{
+    binary_op_scalar_inplace_task(Mat& _a, float _b, int _size)
+        : a(_a), b(_b), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& a;
+    float b;
+    int size;
+};
+
+template<typename Op>
+void binary_op_scalar_inplace_task<Op>::execute(int q) const
 {
     Op op;
 
+    float* ptr = a.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = op(ptr[i], b);
+    }
+}
+
+} // namespace
+
+template<typename Op>
+static int binary_op_scalar_inplace(Mat& a, float b, const Option& opt)
+{
     int w = a.w;
     int h = a.h;
     int channels = a.c;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = a.channel(q);
+    binary_op_scalar_inplace_task<Op> task(a, b, size);
 
-        for (int i=0; i<size; i++)
-        {
-            ptr[i] = op(ptr[i], b);
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
@@ -391,7 +583,7 @@ struct binary_op_pow : std::binary_function<T,T,T> {
     T operator() (const T& x, const T& y) const { return pow(x, y); }
 };
 
-int BinaryOp::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+int BinaryOp::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     const Mat& bottom_blob = bottom_blobs[0];
     const Mat& bottom_blob1 = bottom_blobs[1];
@@ -399,51 +591,51 @@ int BinaryOp::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
     Mat& top_blob = top_blobs[0];
 
     if (op_type == Operation_ADD)
-        return binary_op< std::plus<float> >(bottom_blob, bottom_blob1, top_blob);
+        return binary_op< std::plus<float> >(bottom_blob, bottom_blob1, top_blob, opt);
 
     if (op_type == Operation_SUB)
-        return binary_op< std::minus<float> >(bottom_blob, bottom_blob1, top_blob);
+        return binary_op< std::minus<float> >(bottom_blob, bottom_blob1, top_blob, opt);
 
     if (op_type == Operation_MUL)
-        return binary_op< std::multiplies<float> >(bottom_blob, bottom_blob1, top_blob);
+        return binary_op< std::multiplies<float> >(bottom_blob, bottom_blob1, top_blob, opt);
 
     if (op_type == Operation_DIV)
-        return binary_op< std::divides<float> >(bottom_blob, bottom_blob1, top_blob);
+        return binary_op< std::divides<float> >(bottom_blob, bottom_blob1, top_blob, opt);
 
     if (op_type == Operation_MAX)
-        return binary_op< binary_op_max<float> >(bottom_blob, bottom_blob1, top_blob);
+        return binary_op< binary_op_max<float> >(bottom_blob, bottom_blob1, top_blob, opt);
 
     if (op_type == Operation_MIN)
-        return binary_op< binary_op_min<float> >(bottom_blob, bottom_blob1, top_blob);
+        return binary_op< binary_op_min<float> >(bottom_blob, bottom_blob1, top_blob, opt);
 
     if (op_type == Operation_POW)
-        return binary_op< binary_op_pow<float> >(bottom_blob, bottom_blob1, top_blob);
+        return binary_op< binary_op_pow<float> >(bottom_blob, bottom_blob1, top_blob, opt);
 
     return 0;
 }
 
-int BinaryOp::forward_inplace(Mat& bottom_top_blob) const
+int BinaryOp::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     if (op_type == Operation_ADD)
-        return binary_op_scalar_inplace< std::plus<float> >(bottom_top_blob, b);
+        return binary_op_scalar_inplace< std::plus<float> >(bottom_top_blob, b, opt);
 
     if (op_type == Operation_SUB)
-        return binary_op_scalar_inplace< std::minus<float> >(bottom_top_blob, b);
+        return binary_op_scalar_inplace< std::minus<float> >(bottom_top_blob, b, opt);
 
     if (op_type == Operation_MUL)
-        return binary_op_scalar_inplace< std::multiplies<float> >(bottom_top_blob, b);
+        return binary_op_scalar_inplace< std::multiplies<float> >(bottom_top_blob, b, opt);
 
     if (op_type == Operation_DIV)
-        return binary_op_scalar_inplace< std::divides<float> >(bottom_top_blob, b);
+        return binary_op_scalar_inplace< std::divides<float> >(bottom_top_blob, b, opt);
 
     if (op_type == Operation_MAX)
-        return binary_op_scalar_inplace< binary_op_max<float> >(bottom_top_blob, b);
+        return binary_op_scalar_inplace< binary_op_max<float> >(bottom_top_blob, b, opt);
 
     if (op_type == Operation_MIN)
-        return binary_op_scalar_inplace< binary_op_min<float> >(bottom_top_blob, b);
+        return binary_op_scalar_inplace< binary_op_min<float> >(bottom_top_blob, b, opt);
 
     if (op_type == Operation_POW)
-        return binary_op_scalar_inplace< binary_op_pow<float> >(bottom_top_blob, b);
+        return binary_op_scalar_inplace< binary_op_pow<float> >(bottom_top_blob, b, opt);
 
     return 0;
 }
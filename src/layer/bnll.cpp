@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "bnll.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -25,26 +26,47 @@ BNLL::BNLL()
     support_inplace = true;
 }
 
-int BNLL::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct bnll_task : public ParallelTask
+{
+    bnll_task(Mat& _bottom_top_blob, int _size)
+        : bottom_top_blob(_bottom_top_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+};
+
+void bnll_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        if (ptr[i] > 0)
+            ptr[i] = ptr[i] + log(1.f + exp(-ptr[i]));
+        else
+            ptr[i] = log(1.f + exp(ptr[i]));
+    }
+}
+
+} // namespace
+
+int BNLL::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
     int channels = bottom_top_blob.c;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
-
-        for (int i=0; i<size; i++)
-        {
-            if (ptr[i] > 0)
-                ptr[i] = ptr[i] + log(1.f + exp(-ptr[i]));
-            else
-                ptr[i] = log(1.f + exp(ptr[i]));
-        }
-    }
+    bnll_task task(bottom_top_blob, size);
+
+    parallel_for(task, channels, opt);
 
     return 0;
 }
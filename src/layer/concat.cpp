@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "concat.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -28,13 +29,114 @@ int Concat::load_param(const ParamDict& pd)
 {
     axis = pd.get(0, 0);
 
+    // whole channel packs are stacked as they are
+    support_packing = axis == 0;
+
     return 0;
 }
 
-int Concat::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+namespace {
+
+// one row, the blobs side by side
+struct concat_rows_task : public ParallelTask
+{
+    concat_rows_task(const std::vector<Mat>& _bottom_blobs, Mat& _top_blob, size_t _elemsize)
+        : bottom_blobs(_bottom_blobs), top_blob(_top_blob), elemsize(_elemsize)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    const std::vector<Mat>& bottom_blobs;
+    Mat& top_blob;
+    size_t elemsize;
+};
+
+void concat_rows_task::execute(int i) const
+{
+    float* outptr = top_blob.row(i);
+    for (size_t b=0; b<bottom_blobs.size(); b++)
+    {
+        const Mat& bottom_blob = bottom_blobs[b];
+
+        const float* ptr = bottom_blob.row(i);
+        memcpy(outptr, ptr, bottom_blob.w * elemsize);
+
+        outptr += bottom_blob.w;
+    }
+}
+
+// one channel, the blobs one below another
+struct concat_h_task : public ParallelTask
+{
+    concat_h_task(const std::vector<Mat>& _bottom_blobs, Mat& _top_blob, size_t _elemsize)
+        : bottom_blobs(_bottom_blobs), top_blob(_top_blob), elemsize(_elemsize)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const std::vector<Mat>& bottom_blobs;
+    Mat& top_blob;
+    size_t elemsize;
+};
+
+void concat_h_task::execute(int q) const
+{
+    float* outptr = top_blob.channel(q);
+
+    for (size_t b=0; b<bottom_blobs.size(); b++)
+    {
+        const Mat& bottom_blob = bottom_blobs[b];
+
+        int size = bottom_blob.w * bottom_blob.h;
+
+        const float* ptr = bottom_blob.channel(q);
+        memcpy(outptr, ptr, size * elemsize);
+    }
+}
+
+// one channel, the blobs side by side
+struct concat_w_task : public ParallelTask
+{
+    concat_w_task(const std::vector<Mat>& _bottom_blobs, Mat& _top_blob, size_t _elemsize, int _h)
+        : bottom_blobs(_bottom_blobs), top_blob(_top_blob), elemsize(_elemsize), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const std::vector<Mat>& bottom_blobs;
+    Mat& top_blob;
+    size_t elemsize;
+    int h;
+};
+
+void concat_w_task::execute(int q) const
+{
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<h; i++)
+    {
+        for (size_t b=0; b<bottom_blobs.size(); b++)
+        {
+            const Mat& bottom_blob = bottom_blobs[b];
+
+            const float* ptr = bottom_blob.channel(q).row(i);
+            memcpy(outptr, ptr, bottom_blob.w * elemsize);
+
+            outptr += bottom_blob.w;
+        }
+    }
+}
+
+} // namespace
+
+int Concat::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     int dims = bottom_blobs[0].dims;
     size_t elemsize = bottom_blobs[0].elemsize;
+    int elempack = bottom_blobs[0].elempack;
 
     if (dims == 1) // axis == 0
     {
@@ -48,7 +150,7 @@ int Concat::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_
         }
 
         Mat& top_blob = top_blobs[0];
-        top_blob.create(top_w, elemsize);
+        top_blob.create(top_w, elemsize, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
@@ -82,7 +184,7 @@ int Concat::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_
         }
 
         Mat& top_blob = top_blobs[0];
-        top_blob.create(w, top_h, elemsize);
+        top_blob.create(w, top_h, elemsize, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
@@ -116,24 +218,13 @@ int Concat::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_
         }
 
         Mat& top_blob = top_blobs[0];
-        top_blob.create(top_w, h, elemsize);
+        top_blob.create(top_w, h, elemsize, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int i=0; i<h; i++)
-        {
-            float* outptr = top_blob.row(i);
-            for (size_t b=0; b<bottom_blobs.size(); b++)
-            {
-                const Mat& bottom_blob = bottom_blobs[b];
-
-                const float* ptr = bottom_blob.row(i);
-                memcpy(outptr, ptr, bottom_blob.w * elemsize);
+        concat_rows_task task(bottom_blobs, top_blob, elemsize);
 
-                outptr += bottom_blob.w;
-            }
-        }
+        parallel_for(task, h, opt);
 
         return 0;
     }
@@ -153,7 +244,7 @@ int Concat::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_
         }
 
         Mat& top_blob = top_blobs[0];
-        top_blob.create(w, h, top_channels, elemsize);
+        top_blob.create(w, h, top_channels, elemsize, elempack, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
@@ -190,25 +281,13 @@ int Concat::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_
         }
 
         Mat& top_blob = top_blobs[0];
-        top_blob.create(w, top_h, channels, elemsize);
+        top_blob.create(w, top_h, channels, elemsize, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* outptr = top_blob.channel(q);
-
-            for (size_t b=0; b<bottom_blobs.size(); b++)
-            {
-                const Mat& bottom_blob = bottom_blobs[b];
+        concat_h_task task(bottom_blobs, top_blob, elemsize);
 
-                int size = bottom_blob.w * bottom_blob.h;
-
-                const float* ptr = bottom_blob.channel(q);
-                memcpy(outptr, ptr, size * elemsize);
-            }
-        }
+        parallel_for(task, channels, opt);
 
         return 0;
     }
@@ -228,32 +307,48 @@ int Concat::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_
         }
 
         Mat& top_blob = top_blobs[0];
-        top_blob.create(top_w, h, channels, elemsize);
+        top_blob.create(top_w, h, channels, elemsize, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* outptr = top_blob.channel(q);
+        concat_w_task task(bottom_blobs, top_blob, elemsize, h);
 
-            for (int i=0; i<h; i++)
-            {
-                for (size_t b=0; b<bottom_blobs.size(); b++)
-                {
-                    const Mat& bottom_blob = bottom_blobs[b];
+        parallel_for(task, channels, opt);
 
-                    const float* ptr = bottom_blob.channel(q).row(i);
-                    memcpy(outptr, ptr, bottom_blob.w * elemsize);
+        return 0;
+    }
 
-                    outptr += bottom_blob.w;
-                }
-            }
-        }
+    return 0;
+}
 
-        return 0;
+int Concat::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    int dims = _bottom_shapes[0].dims;
+    int w = _bottom_shapes[0].w;
+    int h = _bottom_shapes[0].h;
+    int channels = _bottom_shapes[0].c;
+
+    for (size_t b=1; b<_bottom_shapes.size(); b++)
+    {
+        const Mat& bottom_shape = _bottom_shapes[b];
+        if (bottom_shape.dims != dims)
+            return -1;
+
+        if (dims == 1 || (dims == 2 && axis == 1) || (dims == 3 && axis == 2))
+            w += bottom_shape.w;
+        else if ((dims == 2 && axis == 0) || (dims == 3 && axis == 1))
+            h += bottom_shape.h;
+        else if (dims == 3 && axis == 0)
+            channels += bottom_shape.c;
     }
 
+    if (dims == 1)
+        _top_shapes[0] = Mat(w, (void*)0);
+    else if (dims == 2)
+        _top_shapes[0] = Mat(w, h, (void*)0);
+    else
+        _top_shapes[0] = Mat(w, h, channels, (void*)0);
+
     return 0;
 }
 
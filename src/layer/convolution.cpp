@@ -14,6 +14,10 @@
 
 #include "convolution.h"
 
+#include "fused_activation.h"
+#include "quantize_int8.h"
+#include "threadpool.h"
+
 namespace ncnn {
 
 DEFINE_LAYER_CREATOR(Convolution)
@@ -22,6 +26,14 @@ Convolution::Convolution()
 {
     one_blob_only = true;
     support_inplace = false;
+
+    plan_w = 0;
+    plan_h = 0;
+
+    bottom_blob_int8_scale = 0.f;
+    use_int8_inference = false;
+    use_int8_requantize = false;
+    top_blob_int8_scale = 0.f;
 }
 
 int Convolution::load_param(const ParamDict& pd)
@@ -37,6 +49,11 @@ int Convolution::load_param(const ParamDict& pd)
     pad_h = pd.get(14, pad_w);
     bias_term = pd.get(5, 0);
     weight_data_size = pd.get(6, 0);
+    activation_type = pd.get(9, 0);
+    activation_params = pd.get(10, Mat());
+    int8_scale_term = pd.get(8, 0);
+
+    use_int8_requantize = false;
 
     return 0;
 }
@@ -54,52 +71,277 @@ int Convolution::load_model(const ModelBin& mb)
             return -100;
     }
 
+    if (int8_scale_term)
+    {
+        weight_data_int8_scales = mb.load(num_output, 1);
+        if (weight_data_int8_scales.empty())
+            return -100;
+
+        Mat bottom_blob_int8_scales = mb.load(1, 1);
+        if (bottom_blob_int8_scales.empty())
+            return -100;
+
+        bottom_blob_int8_scale = bottom_blob_int8_scales[0];
+    }
+
+    use_int8_inference = int8_scale_term && get_default_option().use_int8_inference;
+
+    // int8 weights come with their scales
+    if (!int8_scale_term && weight_data.elemsize == 1u)
+        return -1;
+
     return 0;
 }
 
-int Convolution::forward(const Mat& bottom_blob, Mat& top_blob) const
+int Convolution::create_pipeline()
 {
-    // convolv with NxN kernel
-    // value = value + bias
+    if (int8_scale_term)
+    {
+        int ret = prepare_int8_weights(weight_data, weight_data_int8, weight_data_int8_scales, num_output, use_int8_inference);
+        if (ret != 0)
+            return ret;
+    }
 
-    int w = bottom_blob.w;
-    int h = bottom_blob.h;
-    int channels = bottom_blob.c;
+    return 0;
+}
 
-//     fprintf(stderr, "Convolution input %d x %d  pad = %d %d  ksize=%d %d  stride=%d %d\n", w, h, pad_w, pad_h, kernel_w, kernel_h, stride_w, stride_h);
+int Convolution::save_prepared(std::vector<Mat>& weights) const
+{
+    Mat bottom_blob_int8_scales(1);
+    if (bottom_blob_int8_scales.empty())
+        return -100;
+
+    bottom_blob_int8_scales[0] = bottom_blob_int8_scale;
+
+    // one of weight_data and weight_data_int8 is empty
+    weights.push_back(weight_data);
+    weights.push_back(bias_data);
+    weights.push_back(weight_data_int8_scales);
+    weights.push_back(bottom_blob_int8_scales);
+    weights.push_back(weight_data_int8);
+
+    return 0;
+}
+
+int Convolution::load_prepared(const ModelBin& mb)
+{
+    weight_data = mb.load(weight_data_size, 0);
+    bias_data = mb.load(num_output, 1);
+    weight_data_int8_scales = mb.load(num_output, 1);
+    Mat bottom_blob_int8_scales = mb.load(1, 1);
+    weight_data_int8 = mb.load(weight_data_size, 0);
+
+    if (bottom_blob_int8_scales.empty())
+        return -1;
+
+    bottom_blob_int8_scale = bottom_blob_int8_scales[0];
+
+    use_int8_inference = int8_scale_term && get_default_option().use_int8_inference;
+
+    if (use_int8_inference ? weight_data_int8.empty() : weight_data.empty())
+        return -1;
+
+    return 0;
+}
+
+int Convolution::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    const Mat& bottom_shape = _bottom_shapes[0];
+    if (bottom_shape.dims != 3)
+        return -1;
+
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    resolve_padding(bottom_shape.w, bottom_shape.h, pad_left, pad_right, pad_top, pad_bottom);
+
+    // keep the padding of this size for forward
+    plan_w = bottom_shape.w;
+    plan_h = bottom_shape.h;
+    plan_pad_left = pad_left;
+    plan_pad_right = pad_right;
+    plan_pad_top = pad_top;
+    plan_pad_bottom = pad_bottom;
 
     const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
     const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
 
-    Mat bottom_blob_bordered = bottom_blob;
+    int outw = (bottom_shape.w + pad_left + pad_right - kernel_extent_w) / stride_w + 1;
+    int outh = (bottom_shape.h + pad_top + pad_bottom - kernel_extent_h) / stride_h + 1;
+
+    _top_shapes[0] = Mat(outw, outh, num_output, (void*)0);
+
+    return 0;
+}
+
+const char* Convolution::kernel_name(const Mat& /*bottom_blob*/) const
+{
+    return use_int8_inference ? "int8" : 0;
+}
+
+void Convolution::resolve_padding(int w, int h, int& pad_left, int& pad_right, int& pad_top, int& pad_bottom) const
+{
+    pad_left = 0;
+    pad_right = 0;
+    pad_top = 0;
+    pad_bottom = 0;
+
     if (pad_w > 0 || pad_h > 0)
     {
-        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f);
-        if (bottom_blob_bordered.empty())
-            return -100;
-
-        w = bottom_blob_bordered.w;
-        h = bottom_blob_bordered.h;
+        pad_left = pad_w;
+        pad_right = pad_w;
+        pad_top = pad_h;
+        pad_bottom = pad_h;
     }
     else if (pad_w == -233 && pad_h == -233)
     {
+        const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+        const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
         int wpad = kernel_extent_w + (w - 1) / stride_w * stride_w - w;
         int hpad = kernel_extent_h + (h - 1) / stride_h * stride_h - h;
         if (wpad > 0 || hpad > 0)
         {
-            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f);
-            if (bottom_blob_bordered.empty())
-                return -100;
+            pad_left = wpad / 2;
+            pad_right = wpad - wpad / 2;
+            pad_top = hpad / 2;
+            pad_bottom = hpad - hpad / 2;
         }
+    }
+}
 
-        w = bottom_blob_bordered.w;
-        h = bottom_blob_bordered.h;
+void Convolution::get_padding(int w, int h, int& pad_left, int& pad_right, int& pad_top, int& pad_bottom) const
+{
+    if (w == plan_w && h == plan_h)
+    {
+        pad_left = plan_pad_left;
+        pad_right = plan_pad_right;
+        pad_top = plan_pad_top;
+        pad_bottom = plan_pad_bottom;
+    }
+    else
+    {
+        resolve_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
     }
+}
+
+int Convolution::make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, const Option& opt) const
+{
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    get_padding(bottom_blob.w, bottom_blob.h, pad_left, pad_right, pad_top, pad_bottom);
+
+    bottom_blob_bordered = bottom_blob;
+    if (pad_left > 0 || pad_right > 0 || pad_top > 0 || pad_bottom > 0)
+    {
+        copy_make_border(bottom_blob, bottom_blob_bordered, pad_top, pad_bottom, pad_left, pad_right, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
+        if (bottom_blob_bordered.empty())
+            return -100;
+    }
+
+    return 0;
+}
+
+namespace {
+
+// one output channel
+struct convolution_task : public ParallelTask
+{
+    convolution_task(Mat& _top_blob, Mat& _bottom_blob_bordered, const Mat& _activation_params, const Mat& _weight_data, const Mat& _bias_data, int _channels, int _outw, int _outh, int _maxk, int* _space_ofs, int _stride_w, int _stride_h, int _bias_term, int _activation_type)
+        : top_blob(_top_blob), bottom_blob_bordered(_bottom_blob_bordered), activation_params(_activation_params), weight_data(_weight_data), bias_data(_bias_data), channels(_channels), outw(_outw), outh(_outh), maxk(_maxk), space_ofs(_space_ofs), stride_w(_stride_w), stride_h(_stride_h), bias_term(_bias_term), activation_type(_activation_type)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    Mat& top_blob;
+    Mat& bottom_blob_bordered;
+    const Mat& activation_params;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int channels;
+    int outw;
+    int outh;
+    int maxk;
+    int* space_ofs;
+    int stride_w;
+    int stride_h;
+    int bias_term;
+    int activation_type;
+};
+
+void convolution_task::execute(int p) const
+{
+    float* outptr = top_blob.channel(p);
+
+    for (int i = 0; i < outh; i++)
+    {
+        for (int j = 0; j < outw; j++)
+        {
+            float sum = 0.f;
+
+            if (bias_term)
+                sum = bias_data[p];
+
+            const float* kptr = (const float*)weight_data + maxk * channels * p;
+
+            // channels
+            for (int q=0; q<channels; q++)
+            {
+                const Mat m = bottom_blob_bordered.channel(q);
+                const float* sptr = m.row(i*stride_h) + j*stride_w;
+
+                for (int k = 0; k < maxk; k++) // 29.23
+                {
+                    float val = sptr[ space_ofs[k] ]; // 20.72
+                    float w = kptr[k];
+                    sum += val * w; // 41.45
+                }
+
+                kptr += maxk;
+            }
+
+            outptr[j] = activation_ss(sum, activation_type, activation_params);
+        }
+
+        outptr += outw;
+    }
+}
+
+} // namespace
+
+int Convolution::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    if (use_int8_inference)
+        return forward_int8(bottom_blob, top_blob, opt);
+
+    // convolv with NxN kernel
+    // value = value + bias
+
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+
+//     fprintf(stderr, "Convolution input %d x %d  pad = %d %d  ksize=%d %d  stride=%d %d\n", w, h, pad_w, pad_h, kernel_w, kernel_h, stride_w, stride_h);
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    Mat bottom_blob_bordered;
+    int ret = make_padding(bottom_blob, bottom_blob_bordered, opt);
+    if (ret != 0)
+        return ret;
+
+    w = bottom_blob_bordered.w;
+    h = bottom_blob_bordered.h;
 
     int outw = (w - kernel_extent_w) / stride_w + 1;
     int outh = (h - kernel_extent_h) / stride_h + 1;
 
-    top_blob.create(outw, outh, num_output);
+    top_blob.create(outw, outh, num_output, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -125,45 +367,262 @@ int Convolution::forward(const Mat& bottom_blob, Mat& top_blob) const
     }
 
     // num_output
-    #pragma omp parallel for
-    for (int p=0; p<num_output; p++)
+    convolution_task task(top_blob, bottom_blob_bordered, activation_params, weight_data, bias_data, channels, outw, outh, maxk, space_ofs, stride_w, stride_h, bias_term, activation_type);
+
+    parallel_for(task, num_output, opt);
+
+    return 0;
+}
+
+namespace {
+
+// one output channel
+struct convolution_int8_task : public ParallelTask
+{
+    convolution_int8_task(Mat& _top_blob, Mat& _bottom_blob_int8, Mat& _top_blob_int32, const Mat& _activation_params, const Mat& _bias_data, const Mat& _weight_data_int8_scales, const Mat& _weight_data_int8, int _w, int _h, int _channels, int _pad_left, int _pad_top, int _outw, int _outh, int _maxk, int _kernel_w, int _kernel_h, int _dilation_w, int _dilation_h, int _stride_w, int _stride_h, int _bias_term, int _activation_type, float _bottom_blob_int8_scale, bool _use_int8_requantize, float _top_blob_int8_scale)
+        : top_blob(_top_blob), bottom_blob_int8(_bottom_blob_int8), top_blob_int32(_top_blob_int32), activation_params(_activation_params), bias_data(_bias_data), weight_data_int8_scales(_weight_data_int8_scales), weight_data_int8(_weight_data_int8), w(_w), h(_h), channels(_channels), pad_left(_pad_left), pad_top(_pad_top), outw(_outw), outh(_outh), maxk(_maxk), kernel_w(_kernel_w), kernel_h(_kernel_h), dilation_w(_dilation_w), dilation_h(_dilation_h), stride_w(_stride_w), stride_h(_stride_h), bias_term(_bias_term), activation_type(_activation_type), bottom_blob_int8_scale(_bottom_blob_int8_scale), use_int8_requantize(_use_int8_requantize), top_blob_int8_scale(_top_blob_int8_scale)
     {
-        float* outptr = top_blob.channel(p);
+    }
+
+    virtual void execute(int p) const;
+
+    Mat& top_blob;
+    Mat& bottom_blob_int8;
+    Mat& top_blob_int32;
+    const Mat& activation_params;
+    const Mat& bias_data;
+    const Mat& weight_data_int8_scales;
+    const Mat& weight_data_int8;
+    int w;
+    int h;
+    int channels;
+    int pad_left;
+    int pad_top;
+    int outw;
+    int outh;
+    int maxk;
+    int kernel_w;
+    int kernel_h;
+    int dilation_w;
+    int dilation_h;
+    int stride_w;
+    int stride_h;
+    int bias_term;
+    int activation_type;
+    float bottom_blob_int8_scale;
+    bool use_int8_requantize;
+    float top_blob_int8_scale;
+};
 
-        for (int i = 0; i < outh; i++)
+void convolution_int8_task::execute(int p) const
+{
+    int* sums = top_blob_int32.channel(p);
+
+    for (int i = 0; i < outh; i++)
+    {
+        for (int j = 0; j < outw; j++)
         {
-            for (int j = 0; j < outw; j++)
-            {
-                float sum = 0.f;
+            int sum = 0;
 
-                if (bias_term)
-                    sum = bias_data[p];
+            const signed char* kptr = (const signed char*)weight_data_int8 + maxk * channels * p;
 
-                const float* kptr = (const float*)weight_data + maxk * channels * p;
+            // channels
+            for (int q=0; q<channels; q++)
+            {
+                const Mat m = bottom_blob_int8.channel(q);
 
-                // channels
-                for (int q=0; q<channels; q++)
+                for (int y = 0; y < kernel_h; y++)
                 {
-                    const Mat m = bottom_blob_bordered.channel(q);
-                    const float* sptr = m.row(i*stride_h) + j*stride_w;
+                    int sy = i * stride_h + y * dilation_h - pad_top;
+                    if (sy < 0 || sy >= h)
+                        continue;
+
+                    const signed char* sptr = m.row<signed char>(sy);
 
-                    for (int k = 0; k < maxk; k++) // 29.23
+                    for (int x = 0; x < kernel_w; x++)
                     {
-                        float val = sptr[ space_ofs[k] ]; // 20.72
-                        float w = kptr[k];
-                        sum += val * w; // 41.45
-                    }
+                        int sx = j * stride_w + x * dilation_w - pad_left;
+                        if (sx < 0 || sx >= w)
+                            continue;
 
-                    kptr += maxk;
+                        sum += sptr[sx] * kptr[y * kernel_w + x];
+                    }
                 }
 
-                outptr[j] = sum;
+                kptr += maxk;
+            }
+
+            sums[j] = sum;
+        }
+
+        sums += outw;
+    }
+
+    const float dequant_scale = dequantize_scale(bottom_blob_int8_scale, weight_data_int8_scales[p]);
+    const float bias = bias_term ? bias_data[p] : 0.f;
+
+    if (use_int8_requantize)
+        requantize_int32(top_blob_int32.channel(p), top_blob.channel(p), outw * outh, dequant_scale, bias, activation_type, activation_params, top_blob_int8_scale);
+    else
+        dequantize_int32(top_blob_int32.channel(p), top_blob.channel(p), outw * outh, dequant_scale, bias, activation_type, activation_params);
+}
+
+} // namespace
+
+int Convolution::forward_int8(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+
+    Mat bottom_blob_int8;
+    int ret = quantize_int8(bottom_blob, bottom_blob_int8, bottom_blob_int8_scale, opt);
+    if (ret != 0)
+        return ret;
+
+    // taps in the border are skipped instead of reading a padded copy
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    get_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    int outw = (w + pad_left + pad_right - kernel_extent_w) / stride_w + 1;
+    int outh = (h + pad_top + pad_bottom - kernel_extent_h) / stride_h + 1;
+
+    top_blob.create(outw, outh, num_output, use_int8_requantize ? 1u : 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    Mat top_blob_int32(outw, outh, num_output, 4u, opt.workspace_allocator);
+    if (top_blob_int32.empty())
+        return -100;
+
+    const int maxk = kernel_w * kernel_h;
+
+    // num_output
+    convolution_int8_task task(top_blob, bottom_blob_int8, top_blob_int32, activation_params, bias_data, weight_data_int8_scales, weight_data_int8, w, h, channels, pad_left, pad_top, outw, outh, maxk, kernel_w, kernel_h, dilation_w, dilation_h, stride_w, stride_h, bias_term, activation_type, bottom_blob_int8_scale, use_int8_requantize, top_blob_int8_scale);
+
+    parallel_for(task, num_output, opt);
+
+    return 0;
+}
+
+namespace {
+
+// one output channel of every sample
+struct convolution_batch_task : public ParallelTask
+{
+    convolution_batch_task(const std::vector<Mat>& _bottom_blobs, std::vector<Mat>& _top_blobs, const Mat& _activation_params, const Mat& _weight_data, const Mat& _bias_data, int _batch, int _channels, int _size, int _bias_term, int _activation_type)
+        : bottom_blobs(_bottom_blobs), top_blobs(_top_blobs), activation_params(_activation_params), weight_data(_weight_data), bias_data(_bias_data), batch(_batch), channels(_channels), size(_size), bias_term(_bias_term), activation_type(_activation_type)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    const std::vector<Mat>& bottom_blobs;
+    std::vector<Mat>& top_blobs;
+    const Mat& activation_params;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int batch;
+    int channels;
+    int size;
+    int bias_term;
+    int activation_type;
+};
+
+void convolution_batch_task::execute(int p) const
+{
+    const float* kptr = (const float*)weight_data + channels * p;
+    const float bias = bias_term ? bias_data[p] : 0.f;
+
+    for (int n=0; n<batch; n++)
+    {
+        float* outptr = top_blobs[n].channel(p);
+
+        for (int i=0; i<size; i++)
+        {
+            outptr[i] = bias;
+        }
+
+        int q = 0;
+        for (; q+3<channels; q+=4)
+        {
+            const float* m0 = bottom_blobs[n].channel(q);
+            const float* m1 = bottom_blobs[n].channel(q+1);
+            const float* m2 = bottom_blobs[n].channel(q+2);
+            const float* m3 = bottom_blobs[n].channel(q+3);
+
+            const float k0 = kptr[q];
+            const float k1 = kptr[q+1];
+            const float k2 = kptr[q+2];
+            const float k3 = kptr[q+3];
+
+            for (int i=0; i<size; i++)
+            {
+                outptr[i] += m0[i] * k0 + m1[i] * k1 + m2[i] * k2 + m3[i] * k3;
             }
+        }
+        for (; q<channels; q++)
+        {
+            const float* m = bottom_blobs[n].channel(q);
+            const float k = kptr[q];
 
-            outptr += outw;
+            for (int i=0; i<size; i++)
+            {
+                outptr[i] += m[i] * k;
+            }
         }
+
+        if (activation_type != 0)
+        {
+            for (int i=0; i<size; i++)
+            {
+                outptr[i] = activation_ss(outptr[i], activation_type, activation_params);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int Convolution::forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    // only 1x1 s1 turns into a plain gemm over the batch
+    if (use_int8_inference || kernel_w != 1 || kernel_h != 1 || stride_w != 1 || stride_h != 1 || pad_w > 0 || pad_h > 0)
+        return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+    const int batch = bottom_blobs.size();
+
+    int w = bottom_blobs[0].w;
+    int h = bottom_blobs[0].h;
+    int channels = bottom_blobs[0].c;
+    int size = w * h;
+
+    for (int n=1; n<batch; n++)
+    {
+        if (bottom_blobs[n].w != w || bottom_blobs[n].h != h || bottom_blobs[n].c != channels)
+            return Layer::forward_batch(bottom_blobs, top_blobs, opt);
     }
 
+    top_blobs.resize(batch);
+    for (int n=0; n<batch; n++)
+    {
+        top_blobs[n].create(w, h, num_output, 4u, opt.blob_allocator);
+        if (top_blobs[n].empty())
+            return -100;
+    }
+
+    // each kernel row stays in cache while the whole batch passes by
+    // num_output
+    convolution_batch_task task(bottom_blobs, top_blobs, activation_params, weight_data, bias_data, batch, channels, size, bias_term, activation_type);
+
+    parallel_for(task, num_output, opt);
+
     return 0;
 }
 
@@ -28,7 +28,25 @@ public:
 
     virtual int load_model(const ModelBin& mb);
 
-    virtual int forward(const Mat& bottom_blob, Mat& top_blob) const;
+    virtual int create_pipeline();
+
+    virtual int save_prepared(std::vector<Mat>& weights) const;
+
+    virtual int load_prepared(const ModelBin& mb);
+
+    virtual int forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const;
+
+    virtual int infer_shape(const std::vector<Mat>& bottom_shapes, std::vector<Mat>& top_shapes);
+
+    virtual const char* kernel_name(const Mat& bottom_blob) const;
+
+    // pad the input with the border resolved for its size
+    int make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, const Option& opt) const;
+
+    // the border make_padding would add, for kernels that pad inline
+    void get_padding(int w, int h, int& pad_left, int& pad_right, int& pad_top, int& pad_bottom) const;
+
+    virtual int forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const;
 
 public:
     // param
@@ -45,9 +63,40 @@ public:
 
     int weight_data_size;
 
+    int activation_type;
+    Mat activation_params;
+
+    int int8_scale_term;
+
     // model
     Mat weight_data;
     Mat bias_data;
+
+    // calibrated int8 scales, per output channel for the weights
+    Mat weight_data_int8_scales;
+    float bottom_blob_int8_scale;
+
+    // int8 weights quantized at load time or stored so by the model
+    // only one of weight_data and weight_data_int8 is kept
+    bool use_int8_inference;
+    Mat weight_data_int8;
+
+    // emit int8 scaled for the next int8 layer instead of dequantizing
+    bool use_int8_requantize;
+    float top_blob_int8_scale;
+
+protected:
+    int forward_int8(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const;
+
+    void resolve_padding(int w, int h, int& pad_left, int& pad_right, int& pad_top, int& pad_bottom) const;
+
+    // padding planned by infer_shape for one input size
+    int plan_w;
+    int plan_h;
+    int plan_pad_left;
+    int plan_pad_right;
+    int plan_pad_top;
+    int plan_pad_bottom;
 };
 
 } // namespace ncnn
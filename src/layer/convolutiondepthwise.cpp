@@ -14,6 +14,10 @@
 
 #include "convolutiondepthwise.h"
 
+#include "fused_activation.h"
+#include "quantize_int8.h"
+#include "threadpool.h"
+
 namespace ncnn {
 
 DEFINE_LAYER_CREATOR(ConvolutionDepthWise)
@@ -22,6 +26,14 @@ ConvolutionDepthWise::ConvolutionDepthWise()
 {
     one_blob_only = true;
     support_inplace = false;
+
+    plan_w = 0;
+    plan_h = 0;
+
+    bottom_blob_int8_scale = 0.f;
+    use_int8_inference = false;
+    use_int8_requantize = false;
+    top_blob_int8_scale = 0.f;
 }
 
 int ConvolutionDepthWise::load_param(const ParamDict& pd)
@@ -38,6 +50,11 @@ int ConvolutionDepthWise::load_param(const ParamDict& pd)
     bias_term = pd.get(5, 0);
     weight_data_size = pd.get(6, 0);
     group = pd.get(7, 1);
+    activation_type = pd.get(9, 0);
+    activation_params = pd.get(10, Mat());
+    int8_scale_term = pd.get(8, 0);
+
+    use_int8_requantize = false;
 
     return 0;
 }
@@ -55,58 +72,347 @@ int ConvolutionDepthWise::load_model(const ModelBin& mb)
             return -100;
     }
 
+    if (int8_scale_term)
+    {
+        weight_data_int8_scales = mb.load(num_output, 1);
+        if (weight_data_int8_scales.empty())
+            return -100;
+
+        Mat bottom_blob_int8_scales = mb.load(1, 1);
+        if (bottom_blob_int8_scales.empty())
+            return -100;
+
+        bottom_blob_int8_scale = bottom_blob_int8_scales[0];
+    }
+
+    use_int8_inference = int8_scale_term && get_default_option().use_int8_inference;
+
+    // int8 weights come with their scales
+    if (!int8_scale_term && weight_data.elemsize == 1u)
+        return -1;
+
     return 0;
 }
 
-int ConvolutionDepthWise::forward(const Mat& bottom_blob, Mat& top_blob) const
+int ConvolutionDepthWise::create_pipeline()
 {
-    // convolv with NxN kernel
-    // value = value + bias
+    if (int8_scale_term)
+    {
+        int ret = prepare_int8_weights(weight_data, weight_data_int8, weight_data_int8_scales, num_output, use_int8_inference);
+        if (ret != 0)
+            return ret;
+    }
 
-    int w = bottom_blob.w;
-    int h = bottom_blob.h;
-    int channels = bottom_blob.c;
+    return 0;
+}
 
-    if (channels % group != 0 || num_output % group != 0)
-    {
-        // reject invalid group
+int ConvolutionDepthWise::save_prepared(std::vector<Mat>& weights) const
+{
+    Mat bottom_blob_int8_scales(1);
+    if (bottom_blob_int8_scales.empty())
         return -100;
-    }
 
-//     fprintf(stderr, "ConvolutionDepthWise input %d x %d  pad = %d %d  ksize=%d %d  stride=%d %d\n", w, h, pad_w, pad_h, kernel_w, kernel_h, stride_w, stride_h);
+    bottom_blob_int8_scales[0] = bottom_blob_int8_scale;
+
+    // one of weight_data and weight_data_int8 is empty
+    weights.push_back(weight_data);
+    weights.push_back(bias_data);
+    weights.push_back(weight_data_int8_scales);
+    weights.push_back(bottom_blob_int8_scales);
+    weights.push_back(weight_data_int8);
+
+    return 0;
+}
+
+int ConvolutionDepthWise::load_prepared(const ModelBin& mb)
+{
+    weight_data = mb.load(weight_data_size, 0);
+    bias_data = mb.load(num_output, 1);
+    weight_data_int8_scales = mb.load(num_output, 1);
+    Mat bottom_blob_int8_scales = mb.load(1, 1);
+    weight_data_int8 = mb.load(weight_data_size, 0);
+
+    if (bottom_blob_int8_scales.empty())
+        return -1;
+
+    bottom_blob_int8_scale = bottom_blob_int8_scales[0];
+
+    use_int8_inference = int8_scale_term && get_default_option().use_int8_inference;
+
+    if (use_int8_inference ? weight_data_int8.empty() : weight_data.empty())
+        return -1;
+
+    return 0;
+}
+
+int ConvolutionDepthWise::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    const Mat& bottom_shape = _bottom_shapes[0];
+    if (bottom_shape.dims != 3)
+        return -1;
+
+    if (bottom_shape.c % group != 0 || num_output % group != 0)
+        return -1;
+
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    resolve_padding(bottom_shape.w, bottom_shape.h, pad_left, pad_right, pad_top, pad_bottom);
+
+    // keep the padding of this size for forward
+    plan_w = bottom_shape.w;
+    plan_h = bottom_shape.h;
+    plan_pad_left = pad_left;
+    plan_pad_right = pad_right;
+    plan_pad_top = pad_top;
+    plan_pad_bottom = pad_bottom;
 
     const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
     const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
 
-    Mat bottom_blob_bordered = bottom_blob;
+    int outw = (bottom_shape.w + pad_left + pad_right - kernel_extent_w) / stride_w + 1;
+    int outh = (bottom_shape.h + pad_top + pad_bottom - kernel_extent_h) / stride_h + 1;
+
+    _top_shapes[0] = Mat(outw, outh, num_output, (void*)0);
+
+    return 0;
+}
+
+const char* ConvolutionDepthWise::kernel_name(const Mat& /*bottom_blob*/) const
+{
+    return use_int8_inference ? "int8" : 0;
+}
+
+void ConvolutionDepthWise::resolve_padding(int w, int h, int& pad_left, int& pad_right, int& pad_top, int& pad_bottom) const
+{
+    pad_left = 0;
+    pad_right = 0;
+    pad_top = 0;
+    pad_bottom = 0;
+
     if (pad_w > 0 || pad_h > 0)
     {
-        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f);
-        if (bottom_blob_bordered.empty())
-            return -100;
-
-        w = bottom_blob_bordered.w;
-        h = bottom_blob_bordered.h;
+        pad_left = pad_w;
+        pad_right = pad_w;
+        pad_top = pad_h;
+        pad_bottom = pad_h;
     }
     else if (pad_w == -233 && pad_h == -233)
     {
+        const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+        const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
         int wpad = kernel_extent_w + (w - 1) / stride_w * stride_w - w;
         int hpad = kernel_extent_h + (h - 1) / stride_h * stride_h - h;
         if (wpad > 0 || hpad > 0)
         {
-            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f);
-            if (bottom_blob_bordered.empty())
-                return -100;
+            pad_left = wpad / 2;
+            pad_right = wpad - wpad / 2;
+            pad_top = hpad / 2;
+            pad_bottom = hpad - hpad / 2;
+        }
+    }
+}
+
+void ConvolutionDepthWise::get_padding(int w, int h, int& pad_left, int& pad_right, int& pad_top, int& pad_bottom) const
+{
+    if (w == plan_w && h == plan_h)
+    {
+        pad_left = plan_pad_left;
+        pad_right = plan_pad_right;
+        pad_top = plan_pad_top;
+        pad_bottom = plan_pad_bottom;
+    }
+    else
+    {
+        resolve_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
+    }
+}
+
+int ConvolutionDepthWise::make_padding(const Mat& bottom_blob, Mat& bottom_blob_bordered, const Option& opt) const
+{
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    get_padding(bottom_blob.w, bottom_blob.h, pad_left, pad_right, pad_top, pad_bottom);
+
+    bottom_blob_bordered = bottom_blob;
+    if (pad_left > 0 || pad_right > 0 || pad_top > 0 || pad_bottom > 0)
+    {
+        copy_make_border(bottom_blob, bottom_blob_bordered, pad_top, pad_bottom, pad_left, pad_right, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
+        if (bottom_blob_bordered.empty())
+            return -100;
+    }
+
+    return 0;
+}
+
+namespace {
+
+// one channel
+struct convolutiondepthwise_task : public ParallelTask
+{
+    convolutiondepthwise_task(Mat& _top_blob, Mat& _bottom_blob_bordered, const Mat& _activation_params, const Mat& _weight_data, const Mat& _bias_data, int _outw, int _outh, int _maxk, int* _space_ofs, int _stride_w, int _stride_h, int _bias_term, int _activation_type)
+        : top_blob(_top_blob), bottom_blob_bordered(_bottom_blob_bordered), activation_params(_activation_params), weight_data(_weight_data), bias_data(_bias_data), outw(_outw), outh(_outh), maxk(_maxk), space_ofs(_space_ofs), stride_w(_stride_w), stride_h(_stride_h), bias_term(_bias_term), activation_type(_activation_type)
+    {
+    }
+
+    virtual void execute(int g) const;
+
+    Mat& top_blob;
+    Mat& bottom_blob_bordered;
+    const Mat& activation_params;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int outw;
+    int outh;
+    int maxk;
+    int* space_ofs;
+    int stride_w;
+    int stride_h;
+    int bias_term;
+    int activation_type;
+};
+
+void convolutiondepthwise_task::execute(int g) const
+{
+    float* outptr = top_blob.channel(g);
+    const float* kptr = (const float*)weight_data + maxk * g;
+    const Mat m = bottom_blob_bordered.channel(g);
+
+    for (int i = 0; i < outh; i++)
+    {
+        for (int j = 0; j < outw; j++)
+        {
+            float sum = 0.f;
+
+            if (bias_term)
+                sum = bias_data[g];
+
+            const float* sptr = m.row(i*stride_h) + j*stride_w;
+
+            for (int k = 0; k < maxk; k++)
+            {
+                float val = sptr[ space_ofs[k] ];
+                float w = kptr[k];
+                sum += val * w;
+            }
+
+            outptr[j] = activation_ss(sum, activation_type, activation_params);
+        }
+
+        outptr += outw;
+    }
+}
+
+// one group
+struct convolutiondepthwise_group_task : public ParallelTask
+{
+    convolutiondepthwise_group_task(Mat& _top_blob, Mat& _bottom_blob_bordered, const Mat& _activation_params, const Mat& _weight_data, const Mat& _bias_data, int _outw, int _outh, int _maxk, int* _space_ofs, int _channels_g, int _num_output_g, int _stride_w, int _stride_h, int _bias_term, int _activation_type)
+        : top_blob(_top_blob), bottom_blob_bordered(_bottom_blob_bordered), activation_params(_activation_params), weight_data(_weight_data), bias_data(_bias_data), outw(_outw), outh(_outh), maxk(_maxk), space_ofs(_space_ofs), channels_g(_channels_g), num_output_g(_num_output_g), stride_w(_stride_w), stride_h(_stride_h), bias_term(_bias_term), activation_type(_activation_type)
+    {
+    }
+
+    virtual void execute(int index) const;
+
+    Mat& top_blob;
+    Mat& bottom_blob_bordered;
+    const Mat& activation_params;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int outw;
+    int outh;
+    int maxk;
+    int* space_ofs;
+    int channels_g;
+    int num_output_g;
+    int stride_w;
+    int stride_h;
+    int bias_term;
+    int activation_type;
+};
+
+void convolutiondepthwise_group_task::execute(int index) const
+{
+    const int g = index / num_output_g;
+    const int p = index % num_output_g;
+
+    float* outptr = top_blob.channel(g * num_output_g + p);
+    const float* weight_data_ptr = (const float*)weight_data + maxk * channels_g * num_output_g * g;
+
+    for (int i = 0; i < outh; i++)
+    {
+        for (int j = 0; j < outw; j++)
+        {
+            float sum = 0.f;
+
+            if (bias_term)
+                sum = bias_data[num_output_g * g + p];
+
+            const float* kptr = weight_data_ptr + maxk * channels_g * p;
+
+            // channels_g
+            for (int q=0; q<channels_g; q++)
+            {
+                const Mat m = bottom_blob_bordered.channel(channels_g * g + q);
+                const float* sptr = m.row(i*stride_h) + j*stride_w;
+
+                for (int k = 0; k < maxk; k++)
+                {
+                    float val = sptr[ space_ofs[k] ];
+                    float w = kptr[k];
+                    sum += val * w;
+                }
+
+                kptr += maxk;
+            }
+
+            outptr[j] = activation_ss(sum, activation_type, activation_params);
         }
 
-        w = bottom_blob_bordered.w;
-        h = bottom_blob_bordered.h;
+        outptr += outw;
     }
+}
+
+} // namespace
+
+int ConvolutionDepthWise::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    if (use_int8_inference)
+        return forward_int8(bottom_blob, top_blob, opt);
+
+    // convolv with NxN kernel
+    // value = value + bias
+
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+
+    if (channels % group != 0 || num_output % group != 0)
+    {
+        // reject invalid group
+        return -100;
+    }
+
+//     fprintf(stderr, "ConvolutionDepthWise input %d x %d  pad = %d %d  ksize=%d %d  stride=%d %d\n", w, h, pad_w, pad_h, kernel_w, kernel_h, stride_w, stride_h);
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    Mat bottom_blob_bordered;
+    int ret = make_padding(bottom_blob, bottom_blob_bordered, opt);
+    if (ret != 0)
+        return ret;
+
+    w = bottom_blob_bordered.w;
+    h = bottom_blob_bordered.h;
 
     int outw = (w - kernel_extent_w) / stride_w + 1;
     int outh = (h - kernel_extent_h) / stride_h + 1;
 
-    top_blob.create(outw, outh, num_output);
+    top_blob.create(outw, outh, num_output, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -134,87 +440,172 @@ int ConvolutionDepthWise::forward(const Mat& bottom_blob, Mat& top_blob) const
     // depth-wise
     if (channels == group && group == num_output)
     {
-        #pragma omp parallel for
-        for (int g=0; g<group; g++)
-        {
-            float* outptr = top_blob.channel(g);
-            const float* kptr = (const float*)weight_data + maxk * g;
-            const Mat m = bottom_blob_bordered.channel(g);
+        convolutiondepthwise_task task(top_blob, bottom_blob_bordered, activation_params, weight_data, bias_data, outw, outh, maxk, space_ofs, stride_w, stride_h, bias_term, activation_type);
 
-            for (int i = 0; i < outh; i++)
-            {
-                for (int j = 0; j < outw; j++)
-                {
-                    float sum = 0.f;
+        parallel_for(task, group, opt);
 
-                    if (bias_term)
-                        sum = bias_data[g];
+        return 0;
+    }
 
-                    const float* sptr = m.row(i*stride_h) + j*stride_w;
+    const int channels_g = channels / group;
+    const int num_output_g = num_output / group;
 
-                    for (int k = 0; k < maxk; k++)
-                    {
-                        float val = sptr[ space_ofs[k] ];
-                        float w = kptr[k];
-                        sum += val * w;
-                    }
+    convolutiondepthwise_group_task task(top_blob, bottom_blob_bordered, activation_params, weight_data, bias_data, outw, outh, maxk, space_ofs, channels_g, num_output_g, stride_w, stride_h, bias_term, activation_type);
 
-                    outptr[j] = sum;
-                }
+    parallel_for(task, group * num_output_g, opt);
 
-                outptr += outw;
-            }
-        }
+    return 0;
+}
 
-        return 0;
+namespace {
+
+// one group
+struct convolutiondepthwise_int8_task : public ParallelTask
+{
+    convolutiondepthwise_int8_task(Mat& _top_blob, Mat& _bottom_blob_int8, Mat& _top_blob_int32, const Mat& _activation_params, const Mat& _bias_data, const Mat& _weight_data_int8_scales, const Mat& _weight_data_int8, int _w, int _h, int _pad_left, int _pad_top, int _outw, int _outh, int _maxk, int _channels_g, int _num_output_g, int _kernel_w, int _kernel_h, int _dilation_w, int _dilation_h, int _stride_w, int _stride_h, int _bias_term, int _activation_type, float _bottom_blob_int8_scale, bool _use_int8_requantize, float _top_blob_int8_scale)
+        : top_blob(_top_blob), bottom_blob_int8(_bottom_blob_int8), top_blob_int32(_top_blob_int32), activation_params(_activation_params), bias_data(_bias_data), weight_data_int8_scales(_weight_data_int8_scales), weight_data_int8(_weight_data_int8), w(_w), h(_h), pad_left(_pad_left), pad_top(_pad_top), outw(_outw), outh(_outh), maxk(_maxk), channels_g(_channels_g), num_output_g(_num_output_g), kernel_w(_kernel_w), kernel_h(_kernel_h), dilation_w(_dilation_w), dilation_h(_dilation_h), stride_w(_stride_w), stride_h(_stride_h), bias_term(_bias_term), activation_type(_activation_type), bottom_blob_int8_scale(_bottom_blob_int8_scale), use_int8_requantize(_use_int8_requantize), top_blob_int8_scale(_top_blob_int8_scale)
+    {
     }
 
-    const int channels_g = channels / group;
-    const int num_output_g = num_output / group;
+    virtual void execute(int index) const;
+
+    Mat& top_blob;
+    Mat& bottom_blob_int8;
+    Mat& top_blob_int32;
+    const Mat& activation_params;
+    const Mat& bias_data;
+    const Mat& weight_data_int8_scales;
+    const Mat& weight_data_int8;
+    int w;
+    int h;
+    int pad_left;
+    int pad_top;
+    int outw;
+    int outh;
+    int maxk;
+    int channels_g;
+    int num_output_g;
+    int kernel_w;
+    int kernel_h;
+    int dilation_w;
+    int dilation_h;
+    int stride_w;
+    int stride_h;
+    int bias_term;
+    int activation_type;
+    float bottom_blob_int8_scale;
+    bool use_int8_requantize;
+    float top_blob_int8_scale;
+};
+
+void convolutiondepthwise_int8_task::execute(int index) const
+{
+    const int g = index / num_output_g;
+    const int p = index % num_output_g;
+
+    const int oc = g * num_output_g + p;
 
-    #pragma omp parallel for collapse(2)
-    for (int g=0; g<group; g++)
+    int* sums = top_blob_int32.channel(oc);
+
+    for (int i = 0; i < outh; i++)
     {
-        for (int p=0; p<num_output_g; p++)
+        for (int j = 0; j < outw; j++)
         {
-            float* outptr = top_blob.channel(g * num_output_g + p);
-            const float* weight_data_ptr = (const float*)weight_data + maxk * channels_g * num_output_g * g;
+            int sum = 0;
+
+            const signed char* kptr = (const signed char*)weight_data_int8 + maxk * channels_g * oc;
 
-            for (int i = 0; i < outh; i++)
+            // channels_g
+            for (int q=0; q<channels_g; q++)
             {
-                for (int j = 0; j < outw; j++)
-                {
-                    float sum = 0.f;
+                const Mat m = bottom_blob_int8.channel(channels_g * g + q);
 
-                    if (bias_term)
-                        sum = bias_data[num_output_g * g + p];
+                for (int y = 0; y < kernel_h; y++)
+                {
+                    int sy = i * stride_h + y * dilation_h - pad_top;
+                    if (sy < 0 || sy >= h)
+                        continue;
 
-                    const float* kptr = weight_data_ptr + maxk * channels_g * p;
+                    const signed char* sptr = m.row<signed char>(sy);
 
-                    // channels_g
-                    for (int q=0; q<channels_g; q++)
+                    for (int x = 0; x < kernel_w; x++)
                     {
-                        const Mat m = bottom_blob_bordered.channel(channels_g * g + q);
-                        const float* sptr = m.row(i*stride_h) + j*stride_w;
-
-                        for (int k = 0; k < maxk; k++)
-                        {
-                            float val = sptr[ space_ofs[k] ];
-                            float w = kptr[k];
-                            sum += val * w;
-                        }
+                        int sx = j * stride_w + x * dilation_w - pad_left;
+                        if (sx < 0 || sx >= w)
+                            continue;
 
-                        kptr += maxk;
+                        sum += sptr[sx] * kptr[y * kernel_w + x];
                     }
-
-                    outptr[j] = sum;
                 }
 
-                outptr += outw;
+                kptr += maxk;
             }
+
+            sums[j] = sum;
         }
+
+        sums += outw;
     }
 
+    const float dequant_scale = dequantize_scale(bottom_blob_int8_scale, weight_data_int8_scales[oc]);
+    const float bias = bias_term ? bias_data[oc] : 0.f;
+
+    if (use_int8_requantize)
+        requantize_int32(top_blob_int32.channel(oc), top_blob.channel(oc), outw * outh, dequant_scale, bias, activation_type, activation_params, top_blob_int8_scale);
+    else
+        dequantize_int32(top_blob_int32.channel(oc), top_blob.channel(oc), outw * outh, dequant_scale, bias, activation_type, activation_params);
+}
+
+} // namespace
+
+int ConvolutionDepthWise::forward_int8(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+
+    if (channels % group != 0 || num_output % group != 0)
+    {
+        // reject invalid group
+        return -100;
+    }
+
+    Mat bottom_blob_int8;
+    int ret = quantize_int8(bottom_blob, bottom_blob_int8, bottom_blob_int8_scale, opt);
+    if (ret != 0)
+        return ret;
+
+    // taps in the border are skipped instead of reading a padded copy
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    get_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    int outw = (w + pad_left + pad_right - kernel_extent_w) / stride_w + 1;
+    int outh = (h + pad_top + pad_bottom - kernel_extent_h) / stride_h + 1;
+
+    top_blob.create(outw, outh, num_output, use_int8_requantize ? 1u : 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    Mat top_blob_int32(outw, outh, num_output, 4u, opt.workspace_allocator);
+    if (top_blob_int32.empty())
+        return -100;
+
+    const int maxk = kernel_w * kernel_h;
+
+    const int channels_g = channels / group;
+    const int num_output_g = num_output / group;
+
+    // depth-wise is the group of one channel
+    convolutiondepthwise_int8_task task(top_blob, bottom_blob_int8, top_blob_int32, activation_params, bias_data, weight_data_int8_scales, weight_data_int8, w, h, pad_left, pad_top, outw, outh, maxk, channels_g, num_output_g, kernel_w, kernel_h, dilation_w, dilation_h, stride_w, stride_h, bias_term, activation_type, bottom_blob_int8_scale, use_int8_requantize, top_blob_int8_scale);
+
+    parallel_for(task, group * num_output_g, opt);
+
     return 0;
 }
 
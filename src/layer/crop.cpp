@@ -30,7 +30,7 @@ int Crop::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Crop::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+int Crop::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     const Mat& bottom_blob = bottom_blobs[0];
     const Mat& reference_blob = bottom_blobs[1];
@@ -48,7 +48,7 @@ int Crop::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_bl
 
     Mat& top_blob = top_blobs[0];
 
-    copy_cut_border(bottom_blob, top_blob, top, bottom, left, right);
+    copy_cut_border(bottom_blob, top_blob, top, bottom, left, right, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
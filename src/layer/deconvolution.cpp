@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "deconvolution.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -57,7 +58,69 @@ int Deconvolution::load_model(const ModelBin& mb)
     return 0;
 }
 
-int Deconvolution::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one output channel
+struct deconvolution_task : public ParallelTask
+{
+    deconvolution_task(const Mat& _bottom_blob, Mat& _top_blob_bordered, const Mat& _weight_data, const Mat& _bias_data, int _w, int _h, int _channels, int _maxk, int* _space_ofs, int _stride_w, int _stride_h, int _bias_term)
+        : bottom_blob(_bottom_blob), top_blob_bordered(_top_blob_bordered), weight_data(_weight_data), bias_data(_bias_data), w(_w), h(_h), channels(_channels), maxk(_maxk), space_ofs(_space_ofs), stride_w(_stride_w), stride_h(_stride_h), bias_term(_bias_term)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob_bordered;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int w;
+    int h;
+    int channels;
+    int maxk;
+    int* space_ofs;
+    int stride_w;
+    int stride_h;
+    int bias_term;
+};
+
+void deconvolution_task::execute(int p) const
+{
+    Mat out = top_blob_bordered.channel(p);
+
+    const float bias = bias_term ? bias_data[p] : 0.f;
+
+    out.fill(bias);
+
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            float* outptr = out.row(i*stride_h) + j*stride_w;
+
+            const float* kptr = (const float*)weight_data + maxk * channels * p;
+
+            // channels
+            for (int q=0; q<channels; q++)
+            {
+                const Mat m = bottom_blob.channel(q);
+                float val = *(m.row(i) + j);
+
+                for (int k = 0; k < maxk; k++)
+                {
+                    float w = kptr[k];
+                    outptr[ space_ofs[k] ] += val * w;
+                }
+
+                kptr += maxk;
+            }
+        }
+    }
+}
+
+} // namespace
+
+int Deconvolution::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     // backward strided convolv with NxN kernel
     // value = value + bias
@@ -75,7 +138,7 @@ int Deconvolution::forward(const Mat& bottom_blob, Mat& top_blob) const
     int outh = (h - 1) * stride_h + kernel_extent_h;
 
     Mat top_blob_bordered = top_blob;
-    top_blob_bordered.create(outw, outh, num_output);
+    top_blob_bordered.create(outw, outh, num_output, 4u, (pad_w > 0 || pad_h > 0) ? opt.workspace_allocator : opt.blob_allocator);
     if (top_blob_bordered.empty())
         return -100;
 
@@ -101,46 +164,15 @@ int Deconvolution::forward(const Mat& bottom_blob, Mat& top_blob) const
     }
 
     // num_output
-    #pragma omp parallel for
-    for (int p=0; p<num_output; p++)
-    {
-        Mat out = top_blob_bordered.channel(p);
-
-        const float bias = bias_term ? bias_data[p] : 0.f;
-
-        out.fill(bias);
+    deconvolution_task task(bottom_blob, top_blob_bordered, weight_data, bias_data, w, h, channels, maxk, space_ofs, stride_w, stride_h, bias_term);
 
-        for (int i = 0; i < h; i++)
-        {
-            for (int j = 0; j < w; j++)
-            {
-                float* outptr = out.row(i*stride_h) + j*stride_w;
-
-                const float* kptr = (const float*)weight_data + maxk * channels * p;
-
-                // channels
-                for (int q=0; q<channels; q++)
-                {
-                    const Mat m = bottom_blob.channel(q);
-                    float val = *(m.row(i) + j);
-
-                    for (int k = 0; k < maxk; k++)
-                    {
-                        float w = kptr[k];
-                        outptr[ space_ofs[k] ] += val * w;
-                    }
-
-                    kptr += maxk;
-                }
-            }
-        }
-    }
+    parallel_for(task, num_output, opt);
 
     top_blob = top_blob_bordered;
 
     if (pad_w > 0 || pad_h > 0)
     {
-        copy_cut_border(top_blob_bordered, top_blob, pad_h, pad_h, pad_w, pad_w);
+        copy_cut_border(top_blob_bordered, top_blob, pad_h, pad_h, pad_w, pad_w, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
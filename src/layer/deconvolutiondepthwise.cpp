@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "deconvolutiondepthwise.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -58,7 +59,122 @@ int DeconvolutionDepthWise::load_model(const ModelBin& mb)
     return 0;
 }
 
-int DeconvolutionDepthWise::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one channel
+struct deconvolutiondepthwise_task : public ParallelTask
+{
+    deconvolutiondepthwise_task(const Mat& _bottom_blob, Mat& _top_blob_bordered, const Mat& _weight_data, const Mat& _bias_data, int _w, int _h, int _maxk, int* _space_ofs, int _stride_w, int _stride_h, int _bias_term)
+        : bottom_blob(_bottom_blob), top_blob_bordered(_top_blob_bordered), weight_data(_weight_data), bias_data(_bias_data), w(_w), h(_h), maxk(_maxk), space_ofs(_space_ofs), stride_w(_stride_w), stride_h(_stride_h), bias_term(_bias_term)
+    {
+    }
+
+    virtual void execute(int g) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob_bordered;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int w;
+    int h;
+    int maxk;
+    int* space_ofs;
+    int stride_w;
+    int stride_h;
+    int bias_term;
+};
+
+void deconvolutiondepthwise_task::execute(int g) const
+{
+    const float* inptr = bottom_blob.channel(g);
+    const float* kptr = (const float*)weight_data + maxk * g;
+    Mat m = top_blob_bordered.channel(g);
+
+    const float bias = bias_term ? bias_data[g] : 0.f;
+
+    m.fill(bias);
+
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < w; j++)
+        {
+            float* outptr = m.row(i*stride_h) + j*stride_w;
+
+            for (int k = 0; k < maxk; k++)
+            {
+                float val = inptr[i*w + j];
+                float w = kptr[k];
+                outptr[ space_ofs[k] ] += val * w;
+            }
+        }
+    }
+}
+
+// one group
+struct deconvolutiondepthwise_group_task : public ParallelTask
+{
+    deconvolutiondepthwise_group_task(const Mat& _bottom_blob, Mat& _top_blob_bordered, const Mat& _weight_data, const Mat& _bias_data, int _w, int _h, int _maxk, int* _space_ofs, int _channels_g, int _num_output_g, int _stride_w, int _stride_h, int _bias_term)
+        : bottom_blob(_bottom_blob), top_blob_bordered(_top_blob_bordered), weight_data(_weight_data), bias_data(_bias_data), w(_w), h(_h), maxk(_maxk), space_ofs(_space_ofs), channels_g(_channels_g), num_output_g(_num_output_g), stride_w(_stride_w), stride_h(_stride_h), bias_term(_bias_term)
+    {
+    }
+
+    virtual void execute(int g) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob_bordered;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int w;
+    int h;
+    int maxk;
+    int* space_ofs;
+    int channels_g;
+    int num_output_g;
+    int stride_w;
+    int stride_h;
+    int bias_term;
+};
+
+void deconvolutiondepthwise_group_task::execute(int g) const
+{
+    const float* weight_data_ptr = (const float*)weight_data + maxk * channels_g * num_output_g * g;
+    for (int p = 0; p < num_output_g; p++)
+    {
+        Mat out = top_blob_bordered.channel(g * num_output_g + p);
+
+        const float bias = bias_term ? bias_data[g * num_output_g + p] : 0.f;
+
+        out.fill(bias);
+
+        for (int i = 0; i < h; i++)
+        {
+            for (int j = 0; j < w; j++)
+            {
+                float* outptr = out.row(i*stride_h) + j*stride_w;
+
+                const float* kptr = weight_data_ptr + maxk * channels_g * p;
+
+                // channels_g
+                for (int q = 0; q < channels_g; q++)
+                {
+                    const Mat m = bottom_blob.channel(channels_g * g + q);
+                    float val = *(m.row(i) + j);
+
+                    for (int k = 0; k < maxk; k++)
+                    {
+                        outptr[ space_ofs[k] ] += val * kptr[k];
+                    }
+
+                    kptr += maxk;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+int DeconvolutionDepthWise::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     // deconvolv with NxN kernel
     // value = value + bias
@@ -80,7 +196,7 @@ int DeconvolutionDepthWise::forward(const Mat& bottom_blob, Mat& top_blob) const
     int outh = (h - 1) * stride_h + kernel_extent_h;
 
     Mat top_blob_bordered = top_blob;
-    top_blob_bordered.create(outw, outh, num_output);
+    top_blob_bordered.create(outw, outh, num_output, 4u, (pad_w > 0 || pad_h > 0) ? opt.workspace_allocator : opt.blob_allocator);
     if (top_blob_bordered.empty())
         return -100;
 
@@ -108,32 +224,9 @@ int DeconvolutionDepthWise::forward(const Mat& bottom_blob, Mat& top_blob) const
     // depth-wise
     if (channels == group && group == num_output)
     {
-        #pragma omp parallel for
-        for (int g=0; g<group; g++)
-        {
-            const float* inptr = bottom_blob.channel(g);
-            const float* kptr = (const float*)weight_data + maxk * g;
-            Mat m = top_blob_bordered.channel(g);
-
-            const float bias = bias_term ? bias_data[g] : 0.f;
-
-            m.fill(bias);
+        deconvolutiondepthwise_task task(bottom_blob, top_blob_bordered, weight_data, bias_data, w, h, maxk, space_ofs, stride_w, stride_h, bias_term);
 
-            for (int i = 0; i < h; i++)
-            {
-                for (int j = 0; j < w; j++)
-                {
-                    float* outptr = m.row(i*stride_h) + j*stride_w;
-
-                    for (int k = 0; k < maxk; k++)
-                    {
-                        float val = inptr[i*w + j];
-                        float w = kptr[k];
-                        outptr[ space_ofs[k] ] += val * w;
-                    }
-                }
-            }
-        }
+        parallel_for(task, group, opt);
     }
     else
     {
@@ -141,50 +234,16 @@ int DeconvolutionDepthWise::forward(const Mat& bottom_blob, Mat& top_blob) const
         const int channels_g = channels / group;
         const int num_output_g = num_output / group;
 
-        #pragma omp parallel for
-        for (int g = 0; g < group; g++)
-        {
-            const float* weight_data_ptr = (const float*)weight_data + maxk * channels_g * num_output_g * g;
-            for (int p = 0; p < num_output_g; p++)
-            {
-                Mat out = top_blob_bordered.channel(g * num_output_g + p);
+        deconvolutiondepthwise_group_task task(bottom_blob, top_blob_bordered, weight_data, bias_data, w, h, maxk, space_ofs, channels_g, num_output_g, stride_w, stride_h, bias_term);
 
-                const float bias = bias_term ? bias_data[g * num_output_g + p] : 0.f;
-
-                out.fill(bias);
-
-                for (int i = 0; i < h; i++)
-                {
-                    for (int j = 0; j < w; j++)
-                    {
-                        float* outptr = out.row(i*stride_h) + j*stride_w;
-
-                        const float* kptr = weight_data_ptr + maxk * channels_g * p;
-
-                        // channels_g
-                        for (int q = 0; q < channels_g; q++)
-                        {
-                            const Mat m = bottom_blob.channel(channels_g * g + q);
-                            float val = *(m.row(i) + j);
-
-                            for (int k = 0; k < maxk; k++)
-                            {
-                                outptr[ space_ofs[k] ] += val * kptr[k];
-                            }
-
-                            kptr += maxk;
-                        }
-                    }
-                }
-            }
-        }
+        parallel_for(task, group, opt);
     }
 
     top_blob = top_blob_bordered;
 
     if (pad_w > 0 || pad_h > 0)
     {
-        copy_cut_border(top_blob_bordered, top_blob, pad_h, pad_h, pad_w, pad_w);
+        copy_cut_border(top_blob_bordered, top_blob, pad_h, pad_h, pad_w, pad_w, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
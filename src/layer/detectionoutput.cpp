@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "detectionoutput.h"
+#include "threadpool.h"
 #include <algorithm>
 #include <math.h>
 
@@ -141,7 +142,117 @@ static void nms_sorted_bboxes(const std::vector<BBoxRect>& bboxes, std::vector<i
     }
 }
 
-int DetectionOutput::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+namespace {
+
+// one prior box
+struct detectionoutput_decode_task : public ParallelTask
+{
+    detectionoutput_decode_task(Mat& _bboxes, const float* _location_ptr, const float* _priorbox_ptr, const float* _variance_ptr)
+        : bboxes(_bboxes), location_ptr(_location_ptr), priorbox_ptr(_priorbox_ptr), variance_ptr(_variance_ptr)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    Mat& bboxes;
+    const float* location_ptr;
+    const float* priorbox_ptr;
+    const float* variance_ptr;
+};
+
+void detectionoutput_decode_task::execute(int i) const
+{
+    const float* loc = location_ptr + i * 4;
+    const float* pb = priorbox_ptr + i * 4;
+    const float* var = variance_ptr + i * 4;
+
+    float* bbox = bboxes.row(i);
+
+    // CENTER_SIZE
+    float pb_w = pb[2] - pb[0];
+    float pb_h = pb[3] - pb[1];
+    float pb_cx = (pb[0] + pb[2]) * 0.5f;
+    float pb_cy = (pb[1] + pb[3]) * 0.5f;
+
+    float bbox_cx = var[0] * loc[0] * pb_w + pb_cx;
+    float bbox_cy = var[1] * loc[1] * pb_h + pb_cy;
+    float bbox_w = exp(var[2] * loc[2]) * pb_w;
+    float bbox_h = exp(var[3] * loc[3]) * pb_h;
+
+    bbox[0] = bbox_cx - bbox_w * 0.5f;
+    bbox[1] = bbox_cy - bbox_h * 0.5f;
+    bbox[2] = bbox_cx + bbox_w * 0.5f;
+    bbox[3] = bbox_cy + bbox_h * 0.5f;
+}
+
+// one class, the background excluded
+struct detectionoutput_nms_task : public ParallelTask
+{
+    detectionoutput_nms_task(const Mat& _confidence, Mat& _bboxes, std::vector< std::vector<BBoxRect> >& _all_class_bbox_rects, std::vector< std::vector<float> >& _all_class_bbox_scores, int _num_prior, int _num_class, float _nms_threshold, int _nms_top_k, float _confidence_threshold)
+        : confidence(_confidence), bboxes(_bboxes), all_class_bbox_rects(_all_class_bbox_rects), all_class_bbox_scores(_all_class_bbox_scores), num_prior(_num_prior), num_class(_num_class), nms_threshold(_nms_threshold), nms_top_k(_nms_top_k), confidence_threshold(_confidence_threshold)
+    {
+    }
+
+    virtual void execute(int index) const;
+
+    const Mat& confidence;
+    Mat& bboxes;
+    std::vector< std::vector<BBoxRect> >& all_class_bbox_rects;
+    std::vector< std::vector<float> >& all_class_bbox_scores;
+    int num_prior;
+    int num_class;
+    float nms_threshold;
+    int nms_top_k;
+    float confidence_threshold;
+};
+
+void detectionoutput_nms_task::execute(int index) const
+{
+    const int i = 1 + index;
+
+    // filter by confidence_threshold
+    std::vector<BBoxRect> class_bbox_rects;
+    std::vector<float> class_bbox_scores;
+
+    for (int j = 0; j < num_prior; j++)
+    {
+        float score = confidence[j * num_class + i];
+
+        if (score > confidence_threshold)
+        {
+            const float* bbox = bboxes.row(j);
+            BBoxRect c = { bbox[0], bbox[1], bbox[2], bbox[3], i };
+            class_bbox_rects.push_back(c);
+            class_bbox_scores.push_back(score);
+        }
+    }
+
+    // sort inplace
+    qsort_descent_inplace(class_bbox_rects, class_bbox_scores);
+
+    // keep nms_top_k
+    if (nms_top_k < (int)class_bbox_rects.size())
+    {
+        class_bbox_rects.resize(nms_top_k);
+        class_bbox_scores.resize(nms_top_k);
+    }
+
+    // apply nms
+    std::vector<int> picked;
+    nms_sorted_bboxes(class_bbox_rects, picked, nms_threshold);
+
+    // select
+    for (int j = 0; j < (int)picked.size(); j++)
+    {
+        int z = picked[j];
+        all_class_bbox_rects[i].push_back(class_bbox_rects[z]);
+        all_class_bbox_scores[i].push_back(class_bbox_scores[z]);
+    }
+}
+
+} // namespace
+
+int DetectionOutput::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     const Mat& location = bottom_blobs[0];
     const Mat& confidence = bottom_blobs[1];
@@ -151,7 +262,7 @@ int DetectionOutput::forward(const std::vector<Mat>& bottom_blobs, std::vector<M
 
     // apply location with priorbox
     Mat bboxes;
-    bboxes.create(4, num_prior);
+    bboxes.create(4, num_prior, 4u, opt.workspace_allocator);
     if (bboxes.empty())
         return -100;
 
@@ -159,31 +270,9 @@ int DetectionOutput::forward(const std::vector<Mat>& bottom_blobs, std::vector<M
     const float* priorbox_ptr = priorbox.row(0);
     const float* variance_ptr = priorbox.row(1);
 
-    #pragma omp parallel for
-    for (int i = 0; i < num_prior; i++)
-    {
-        const float* loc = location_ptr + i * 4;
-        const float* pb = priorbox_ptr + i * 4;
-        const float* var = variance_ptr + i * 4;
-
-        float* bbox = bboxes.row(i);
-
-        // CENTER_SIZE
-        float pb_w = pb[2] - pb[0];
-        float pb_h = pb[3] - pb[1];
-        float pb_cx = (pb[0] + pb[2]) * 0.5f;
-        float pb_cy = (pb[1] + pb[3]) * 0.5f;
-
-        float bbox_cx = var[0] * loc[0] * pb_w + pb_cx;
-        float bbox_cy = var[1] * loc[1] * pb_h + pb_cy;
-        float bbox_w = exp(var[2] * loc[2]) * pb_w;
-        float bbox_h = exp(var[3] * loc[3]) * pb_h;
-
-        bbox[0] = bbox_cx - bbox_w * 0.5f;
-        bbox[1] = bbox_cy - bbox_h * 0.5f;
-        bbox[2] = bbox_cx + bbox_w * 0.5f;
-        bbox[3] = bbox_cy + bbox_h * 0.5f;
-    }
+    detectionoutput_decode_task task(bboxes, location_ptr, priorbox_ptr, variance_ptr);
+
+    parallel_for(task, num_prior, opt);
 
     // sort and nms for each class
     std::vector< std::vector<BBoxRect> > all_class_bbox_rects;
@@ -192,48 +281,9 @@ int DetectionOutput::forward(const std::vector<Mat>& bottom_blobs, std::vector<M
     all_class_bbox_scores.resize(num_class);
 
     // start from 1 to ignore background class
-    #pragma omp parallel for
-    for (int i = 1; i < num_class; i++)
-    {
-        // filter by confidence_threshold
-        std::vector<BBoxRect> class_bbox_rects;
-        std::vector<float> class_bbox_scores;
-
-        for (int j = 0; j < num_prior; j++)
-        {
-            float score = confidence[j * num_class + i];
-
-            if (score > confidence_threshold)
-            {
-                const float* bbox = bboxes.row(j);
-                BBoxRect c = { bbox[0], bbox[1], bbox[2], bbox[3], i };
-                class_bbox_rects.push_back(c);
-                class_bbox_scores.push_back(score);
-            }
-        }
+    detectionoutput_nms_task nms_task(confidence, bboxes, all_class_bbox_rects, all_class_bbox_scores, num_prior, num_class, nms_threshold, nms_top_k, confidence_threshold);
 
-        // sort inplace
-        qsort_descent_inplace(class_bbox_rects, class_bbox_scores);
-
-        // keep nms_top_k
-        if (nms_top_k < (int)class_bbox_rects.size())
-        {
-            class_bbox_rects.resize(nms_top_k);
-            class_bbox_scores.resize(nms_top_k);
-        }
-
-        // apply nms
-        std::vector<int> picked;
-        nms_sorted_bboxes(class_bbox_rects, picked, nms_threshold);
-
-        // select
-        for (int j = 0; j < (int)picked.size(); j++)
-        {
-            int z = picked[j];
-            all_class_bbox_rects[i].push_back(class_bbox_rects[z]);
-            all_class_bbox_scores[i].push_back(class_bbox_scores[z]);
-        }
-    }
+    parallel_for(nms_task, num_class - 1, opt);
 
     // gather all class
     std::vector<BBoxRect> bbox_rects;
@@ -262,7 +312,7 @@ int DetectionOutput::forward(const std::vector<Mat>& bottom_blobs, std::vector<M
     int num_detected = bbox_rects.size();
 
     Mat& top_blob = top_blobs[0];
-    top_blob.create(6, num_detected);
+    top_blob.create(6, num_detected, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
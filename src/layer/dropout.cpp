@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "dropout.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -31,7 +32,36 @@ int Dropout::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Dropout::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct dropout_task : public ParallelTask
+{
+    dropout_task(Mat& _bottom_top_blob, int _size, float _scale)
+        : bottom_top_blob(_bottom_top_blob), size(_size), scale(_scale)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float scale;
+};
+
+void dropout_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = ptr[i] * scale;
+    }
+}
+
+} // namespace
+
+int Dropout::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     if (scale == 1.f)
     {
@@ -43,16 +73,9 @@ int Dropout::forward_inplace(Mat& bottom_top_blob) const
     int channels = bottom_top_blob.c;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
+    dropout_task task(bottom_top_blob, size, scale);
 
-        for (int i=0; i<size; i++)
-        {
-            ptr[i] = ptr[i] * scale;
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "eltwise.h"
+#include "threadpool.h"
 #include <algorithm>
 
 namespace ncnn {
@@ -31,7 +32,230 @@ int Eltwise::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Eltwise::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+namespace {
+
+// one channel
+struct eltwise_prod_task : public ParallelTask
+{
+    eltwise_prod_task(const Mat& _bottom_blob, Mat& _top_blob, const Mat& _bottom_blob1, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), bottom_blob1(_bottom_blob1), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Mat& bottom_blob1;
+    int size;
+};
+
+void eltwise_prod_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    const float* ptr1 = bottom_blob1.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] * ptr1[i];
+    }
+}
+
+// one channel
+struct eltwise_prod_inplace_task : public ParallelTask
+{
+    eltwise_prod_inplace_task(Mat& _top_blob, const Mat& _bottom_blob1, int _size)
+        : top_blob(_top_blob), bottom_blob1(_bottom_blob1), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    const Mat& bottom_blob1;
+    int size;
+};
+
+void eltwise_prod_inplace_task::execute(int q) const
+{
+    const float* ptr = bottom_blob1.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] *= ptr[i];
+    }
+}
+
+// one channel
+struct eltwise_sum_task : public ParallelTask
+{
+    eltwise_sum_task(const Mat& _bottom_blob, Mat& _top_blob, const Mat& _bottom_blob1, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), bottom_blob1(_bottom_blob1), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Mat& bottom_blob1;
+    int size;
+};
+
+void eltwise_sum_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    const float* ptr1 = bottom_blob1.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] + ptr1[i];
+    }
+}
+
+// one channel
+struct eltwise_sum_inplace_task : public ParallelTask
+{
+    eltwise_sum_inplace_task(Mat& _top_blob, const Mat& _bottom_blob1, int _size)
+        : top_blob(_top_blob), bottom_blob1(_bottom_blob1), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    const Mat& bottom_blob1;
+    int size;
+};
+
+void eltwise_sum_inplace_task::execute(int q) const
+{
+    const float* ptr = bottom_blob1.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] += ptr[i];
+    }
+}
+
+// one channel
+struct eltwise_sum_coeff_task : public ParallelTask
+{
+    eltwise_sum_coeff_task(const Mat& _bottom_blob, Mat& _top_blob, const Mat& _bottom_blob1, int _size, float _coeff0, float _coeff1)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), bottom_blob1(_bottom_blob1), size(_size), coeff0(_coeff0), coeff1(_coeff1)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Mat& bottom_blob1;
+    int size;
+    float coeff0;
+    float coeff1;
+};
+
+void eltwise_sum_coeff_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    const float* ptr1 = bottom_blob1.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] * coeff0 + ptr1[i] * coeff1;
+    }
+}
+
+// one channel
+struct eltwise_sum_coeff_inplace_task : public ParallelTask
+{
+    eltwise_sum_coeff_inplace_task(Mat& _top_blob, const Mat& _bottom_blob1, int _size, float _coeff)
+        : top_blob(_top_blob), bottom_blob1(_bottom_blob1), size(_size), coeff(_coeff)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    const Mat& bottom_blob1;
+    int size;
+    float coeff;
+};
+
+void eltwise_sum_coeff_inplace_task::execute(int q) const
+{
+    const float* ptr = bottom_blob1.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] += ptr[i] * coeff;
+    }
+}
+
+// one channel
+struct eltwise_max_task : public ParallelTask
+{
+    eltwise_max_task(const Mat& _bottom_blob, Mat& _top_blob, const Mat& _bottom_blob1, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), bottom_blob1(_bottom_blob1), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Mat& bottom_blob1;
+    int size;
+};
+
+void eltwise_max_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    const float* ptr1 = bottom_blob1.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = std::max(ptr[i], ptr1[i]);
+    }
+}
+
+// one channel
+struct eltwise_max_inplace_task : public ParallelTask
+{
+    eltwise_max_inplace_task(Mat& _top_blob, const Mat& _bottom_blob1, int _size)
+        : top_blob(_top_blob), bottom_blob1(_bottom_blob1), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    const Mat& bottom_blob1;
+    int size;
+};
+
+void eltwise_max_inplace_task::execute(int q) const
+{
+    const float* ptr = bottom_blob1.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = std::max(outptr[i], ptr[i]);
+    }
+}
+
+} // namespace
+
+int Eltwise::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     const Mat& bottom_blob = bottom_blobs[0];
     int w = bottom_blob.w;
@@ -40,7 +264,7 @@ int Eltwise::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top
     int size = w * h;
 
     Mat& top_blob = top_blobs[0];
-    top_blob.create(w, h, channels);
+    top_blob.create(w, h, channels, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -48,33 +272,16 @@ int Eltwise::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top
     {
         // first blob
         const Mat& bottom_blob1 = bottom_blobs[1];
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_blob.channel(q);
-            const float* ptr1 = bottom_blob1.channel(q);
-            float* outptr = top_blob.channel(q);
+        eltwise_prod_task task(bottom_blob, top_blob, bottom_blob1, size);
 
-            for (int i=0; i<size; i++)
-            {
-                outptr[i] = ptr[i] * ptr1[i];
-            }
-        }
+        parallel_for(task, channels, opt);
 
         for (size_t b=2; b<bottom_blobs.size(); b++)
         {
             const Mat& bottom_blob1 = bottom_blobs[b];
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob1.channel(q);
-                float* outptr = top_blob.channel(q);
+            eltwise_prod_inplace_task task(top_blob, bottom_blob1, size);
 
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] *= ptr[i];
-                }
-            }
+            parallel_for(task, channels, opt);
         }
     }
     else if (op_type == Operation_SUM)
@@ -83,33 +290,16 @@ int Eltwise::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top
         {
             // first blob
             const Mat& bottom_blob1 = bottom_blobs[1];
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob.channel(q);
-                const float* ptr1 = bottom_blob1.channel(q);
-                float* outptr = top_blob.channel(q);
-
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = ptr[i] + ptr1[i];
-                }
-            }
+            eltwise_sum_task task(bottom_blob, top_blob, bottom_blob1, size);
+
+            parallel_for(task, channels, opt);
 
             for (size_t b=2; b<bottom_blobs.size(); b++)
             {
                 const Mat& bottom_blob1 = bottom_blobs[b];
-                #pragma omp parallel for
-                for (int q=0; q<channels; q++)
-                {
-                    const float* ptr = bottom_blob1.channel(q);
-                    float* outptr = top_blob.channel(q);
-
-                    for (int i=0; i<size; i++)
-                    {
-                        outptr[i] += ptr[i];
-                    }
-                }
+                eltwise_sum_inplace_task task(top_blob, bottom_blob1, size);
+
+                parallel_for(task, channels, opt);
             }
         }
         else
@@ -118,34 +308,17 @@ int Eltwise::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top
             const Mat& bottom_blob1 = bottom_blobs[1];
             float coeff0 = coeffs[0];
             float coeff1 = coeffs[1];
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob.channel(q);
-                const float* ptr1 = bottom_blob1.channel(q);
-                float* outptr = top_blob.channel(q);
-
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = ptr[i] * coeff0 + ptr1[i] * coeff1;
-                }
-            }
+            eltwise_sum_coeff_task task(bottom_blob, top_blob, bottom_blob1, size, coeff0, coeff1);
+
+            parallel_for(task, channels, opt);
 
             for (size_t b=2; b<bottom_blobs.size(); b++)
             {
                 const Mat& bottom_blob1 = bottom_blobs[b];
                 float coeff = coeffs[b];
-                #pragma omp parallel for
-                for (int q=0; q<channels; q++)
-                {
-                    const float* ptr = bottom_blob1.channel(q);
-                    float* outptr = top_blob.channel(q);
-
-                    for (int i=0; i<size; i++)
-                    {
-                        outptr[i] += ptr[i] * coeff;
-                    }
-                }
+                eltwise_sum_coeff_inplace_task task(top_blob, bottom_blob1, size, coeff);
+
+                parallel_for(task, channels, opt);
             }
         }
     }
@@ -153,37 +326,27 @@ int Eltwise::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top
     {
         // first blob
         const Mat& bottom_blob1 = bottom_blobs[1];
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_blob.channel(q);
-            const float* ptr1 = bottom_blob1.channel(q);
-            float* outptr = top_blob.channel(q);
+        eltwise_max_task task(bottom_blob, top_blob, bottom_blob1, size);
 
-            for (int i=0; i<size; i++)
-            {
-                outptr[i] = std::max(ptr[i], ptr1[i]);
-            }
-        }
+        parallel_for(task, channels, opt);
 
         for (size_t b=2; b<bottom_blobs.size(); b++)
         {
             const Mat& bottom_blob1 = bottom_blobs[b];
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob1.channel(q);
-                float* outptr = top_blob.channel(q);
+            eltwise_max_inplace_task task(top_blob, bottom_blob1, size);
 
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = std::max(outptr[i], ptr[i]);
-                }
-            }
+            parallel_for(task, channels, opt);
         }
     }
 
     return 0;
 }
 
+int Eltwise::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    _top_shapes[0] = _bottom_shapes[0];
+
+    return 0;
+}
+
 } // namespace ncnn
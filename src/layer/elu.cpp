@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "elu.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -32,24 +33,46 @@ int ELU::load_param(const ParamDict& pd)
     return 0;
 }
 
-int ELU::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct elu_task : public ParallelTask
+{
+    elu_task(Mat& _bottom_top_blob, int _size, float _alpha)
+        : bottom_top_blob(_bottom_top_blob), size(_size), alpha(_alpha)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float alpha;
+};
+
+void elu_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        if (ptr[i] < 0.f)
+            ptr[i] = alpha * (exp(ptr[i]) - 1.f);
+    }
+}
+
+} // namespace
+
+int ELU::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
     int channels = bottom_top_blob.c;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
+    elu_task task(bottom_top_blob, size, alpha);
 
-        for (int i=0; i<size; i++)
-        {
-            if (ptr[i] < 0.f)
-                ptr[i] = alpha * (exp(ptr[i]) - 1.f);
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "embed.h"
+#include "threadpool.h"
 #include <string.h>
 
 namespace ncnn {
@@ -51,39 +52,65 @@ int Embed::load_model(const ModelBin& mb)
     return 0;
 }
 
-int Embed::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one word
+struct embed_task : public ParallelTask
 {
-    int words = bottom_blob.total();
+    embed_task(Mat& _top_blob, const Mat& _bottom_blob, const Mat& _weight_data, const Mat& _bias_data, int _num_output, int _input_dim, int _bias_term)
+        : top_blob(_top_blob), bottom_blob(_bottom_blob), weight_data(_weight_data), bias_data(_bias_data), num_output(_num_output), input_dim(_input_dim), bias_term(_bias_term)
+    {
+    }
 
-    top_blob.create(num_output, words);
-    if (top_blob.empty())
-        return -100;
+    virtual void execute(int q) const;
 
-    // num_output
-    #pragma omp parallel for
-    for (int q=0; q<words; q++)
-    {
-        float* outptr = top_blob.row(q);
+    Mat& top_blob;
+    const Mat& bottom_blob;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int num_output;
+    int input_dim;
+    int bias_term;
+};
+
+void embed_task::execute(int q) const
+{
+    float* outptr = top_blob.row(q);
 
-        int word_index = ((const int*)bottom_blob)[q];
+    int word_index = ((const int*)bottom_blob)[q];
 
-        if (word_index < 0)
-            word_index = 0;
-        if (word_index >= input_dim)
-            word_index = input_dim - 1;
+    if (word_index < 0)
+        word_index = 0;
+    if (word_index >= input_dim)
+        word_index = input_dim - 1;
 
-        const float* em = (const float*)weight_data + num_output * word_index;
+    const float* em = (const float*)weight_data + num_output * word_index;
 
-        memcpy(outptr, em, num_output * sizeof(float));
+    memcpy(outptr, em, num_output * sizeof(float));
 
-        if (bias_term)
+    if (bias_term)
+    {
+        for (int p=0; p<num_output; p++)
         {
-            for (int p=0; p<num_output; p++)
-            {
-                outptr[p] += bias_data[p];
-            }
+            outptr[p] += bias_data[p];
         }
     }
+}
+
+} // namespace
+
+int Embed::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    int words = bottom_blob.total();
+
+    top_blob.create(num_output, words, 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    // num_output
+    embed_task task(top_blob, bottom_blob, weight_data, bias_data, num_output, input_dim, bias_term);
+
+    parallel_for(task, words, opt);
 
     return 0;
 }
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "exp.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -34,7 +35,64 @@ int Exp::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Exp::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct exp_task : public ParallelTask
+{
+    exp_task(Mat& _bottom_top_blob, int _size, float _scale, float _shift)
+        : bottom_top_blob(_bottom_top_blob), size(_size), scale(_scale), shift(_shift)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float scale;
+    float shift;
+};
+
+void exp_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = exp(shift + ptr[i] * scale);
+    }
+}
+
+// one channel
+struct exp_base_task : public ParallelTask
+{
+    exp_base_task(Mat& _bottom_top_blob, int _size, float _base, float _scale, float _shift)
+        : bottom_top_blob(_bottom_top_blob), size(_size), base(_base), scale(_scale), shift(_shift)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float base;
+    float scale;
+    float shift;
+};
+
+void exp_base_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = pow(base, (shift + ptr[i] * scale));
+    }
+}
+
+} // namespace
+
+int Exp::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
@@ -43,29 +101,15 @@ int Exp::forward_inplace(Mat& bottom_top_blob) const
 
     if (base == -1.f)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] = exp(shift + ptr[i] * scale);
-            }
-        }
+        exp_task task(bottom_top_blob, size, scale, shift);
+
+        parallel_for(task, channels, opt);
     }
     else
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] = pow(base, (shift + ptr[i] * scale));
-            }
-        }
+        exp_base_task task(bottom_top_blob, size, base, scale, shift);
+
+        parallel_for(task, channels, opt);
     }
 
     return 0;
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "flatten.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -24,28 +25,59 @@ Flatten::Flatten()
     support_inplace = false;
 }
 
-int Flatten::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one channel
+struct flatten_task : public ParallelTask
+{
+    flatten_task(const Mat& _bottom_blob, Mat& _top_blob, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int size;
+};
+
+void flatten_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = (float*)top_blob + size * q;
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i];
+    }
+}
+
+} // namespace
+
+int Flatten::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     int w = bottom_blob.w;
     int h = bottom_blob.h;
     int channels = bottom_blob.c;
     int size = w * h;
 
-    top_blob.create(size * channels);
+    top_blob.create(size * channels, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        const float* ptr = bottom_blob.channel(q);
-        float* outptr = (float*)top_blob + size * q;
+    flatten_task task(bottom_blob, top_blob, size);
 
-        for (int i=0; i<size; i++)
-        {
-            outptr[i] = ptr[i];
-        }
-    }
+    parallel_for(task, channels, opt);
+
+    return 0;
+}
+
+int Flatten::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    const Mat& bottom_shape = _bottom_shapes[0];
+
+    _top_shapes[0] = Mat(bottom_shape.w * bottom_shape.h * bottom_shape.c, (void*)0);
 
     return 0;
 }
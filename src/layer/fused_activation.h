@@ -0,0 +1,90 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef LAYER_FUSED_ACTIVATION_H
+#define LAYER_FUSED_ACTIVATION_H
+
+#include "mat.h"
+#include "threadpool.h"
+
+namespace ncnn {
+
+// activation fused into convolution and innerproduct
+// activation_type
+// 0 = none
+// 1 = relu
+// 2 = leakyrelu, slope = activation_params[0]
+static inline float activation_ss(float v, int activation_type, const Mat& activation_params)
+{
+    if (activation_type == 1)
+    {
+        if (v < 0.f)
+            v = 0.f;
+    }
+    else if (activation_type == 2)
+    {
+        if (v < 0.f)
+            v *= activation_params[0];
+    }
+
+    return v;
+}
+
+namespace {
+
+// one channel
+struct activation_inplace_task : public ParallelTask
+{
+    activation_inplace_task(Mat& _m, const Mat& _activation_params, int _activation_type, int _size)
+        : m(_m), activation_params(_activation_params), activation_type(_activation_type), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& m;
+    const Mat& activation_params;
+    int activation_type;
+    int size;
+};
+
+void activation_inplace_task::execute(int q) const
+{
+    float* ptr = m.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = activation_ss(ptr[i], activation_type, activation_params);
+    }
+}
+
+} // namespace
+
+// for kernels that finish their accumulation before the final write
+static inline void activation_inplace(Mat& m, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    if (activation_type == 0)
+        return;
+
+    int size = m.w * m.h * m.elempack;
+    int channels = m.c;
+
+    activation_inplace_task task(m, activation_params, activation_type, size);
+
+    parallel_for(task, channels, opt);
+}
+
+} // namespace ncnn
+
+#endif // LAYER_FUSED_ACTIVATION_H
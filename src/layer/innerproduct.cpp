@@ -14,6 +14,10 @@
 
 #include "innerproduct.h"
 
+#include "fused_activation.h"
+#include "quantize_int8.h"
+#include "threadpool.h"
+
 namespace ncnn {
 
 DEFINE_LAYER_CREATOR(InnerProduct)
@@ -22,6 +26,9 @@ InnerProduct::InnerProduct()
 {
     one_blob_only = true;
     support_inplace = false;
+
+    bottom_blob_int8_scale = 0.f;
+    use_int8_inference = false;
 }
 
 int InnerProduct::load_param(const ParamDict& pd)
@@ -29,6 +36,9 @@ int InnerProduct::load_param(const ParamDict& pd)
     num_output = pd.get(0, 0);
     bias_term = pd.get(1, 0);
     weight_data_size = pd.get(2, 0);
+    activation_type = pd.get(9, 0);
+    activation_params = pd.get(10, Mat());
+    int8_scale_term = pd.get(8, 0);
 
     return 0;
 }
@@ -46,23 +56,290 @@ int InnerProduct::load_model(const ModelBin& mb)
             return -100;
     }
 
+    if (int8_scale_term)
+    {
+        weight_data_int8_scales = mb.load(num_output, 1);
+        if (weight_data_int8_scales.empty())
+            return -100;
+
+        Mat bottom_blob_int8_scales = mb.load(1, 1);
+        if (bottom_blob_int8_scales.empty())
+            return -100;
+
+        bottom_blob_int8_scale = bottom_blob_int8_scales[0];
+    }
+
+    use_int8_inference = int8_scale_term && get_default_option().use_int8_inference;
+
+    // int8 weights come with their scales
+    if (!int8_scale_term && weight_data.elemsize == 1u)
+        return -1;
+
     return 0;
 }
 
-int InnerProduct::forward(const Mat& bottom_blob, Mat& top_blob) const
+int InnerProduct::create_pipeline()
+{
+    if (int8_scale_term)
+    {
+        int ret = prepare_int8_weights(weight_data, weight_data_int8, weight_data_int8_scales, num_output, use_int8_inference);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+int InnerProduct::save_prepared(std::vector<Mat>& weights) const
+{
+    Mat bottom_blob_int8_scales(1);
+    if (bottom_blob_int8_scales.empty())
+        return -100;
+
+    bottom_blob_int8_scales[0] = bottom_blob_int8_scale;
+
+    // one of weight_data and weight_data_int8 is empty
+    weights.push_back(weight_data);
+    weights.push_back(bias_data);
+    weights.push_back(weight_data_int8_scales);
+    weights.push_back(bottom_blob_int8_scales);
+    weights.push_back(weight_data_int8);
+
+    return 0;
+}
+
+int InnerProduct::load_prepared(const ModelBin& mb)
+{
+    weight_data = mb.load(weight_data_size, 0);
+    bias_data = mb.load(num_output, 1);
+    weight_data_int8_scales = mb.load(num_output, 1);
+    Mat bottom_blob_int8_scales = mb.load(1, 1);
+    weight_data_int8 = mb.load(weight_data_size, 0);
+
+    if (bottom_blob_int8_scales.empty())
+        return -1;
+
+    bottom_blob_int8_scale = bottom_blob_int8_scales[0];
+
+    use_int8_inference = int8_scale_term && get_default_option().use_int8_inference;
+
+    // subclasses may cache their own copy of the float weights instead
+    if (use_int8_inference && weight_data_int8.empty())
+        return -1;
+
+    return 0;
+}
+
+namespace {
+
+// one output
+struct innerproduct_task : public ParallelTask
+{
+    innerproduct_task(const Mat& _bottom_blob, Mat& _top_blob, const Mat& _activation_params, const Mat& _weight_data, const Mat& _bias_data, int _channels, int _size, int _bias_term, int _activation_type)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), activation_params(_activation_params), weight_data(_weight_data), bias_data(_bias_data), channels(_channels), size(_size), bias_term(_bias_term), activation_type(_activation_type)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Mat& activation_params;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int channels;
+    int size;
+    int bias_term;
+    int activation_type;
+};
+
+void innerproduct_task::execute(int p) const
+{
+    float sum = 0.f;
+
+    if (bias_term)
+        sum = bias_data[p];
+
+    // channels
+    for (int q=0; q<channels; q++)
+    {
+        const float* w = (const float*)weight_data + size * channels * p + size * q;
+        const float* m = bottom_blob.channel(q);
+
+        for (int i = 0; i < size; i++)
+        {
+            sum += m[i] * w[i];
+        }
+    }
+
+    top_blob[p] = activation_ss(sum, activation_type, activation_params);
+}
+
+} // namespace
+
+int InnerProduct::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
+    if (use_int8_inference)
+        return forward_int8(bottom_blob, top_blob, opt);
+
     int w = bottom_blob.w;
     int h = bottom_blob.h;
     int channels = bottom_blob.c;
     int size = w * h;
 
-    top_blob.create(num_output);
+    top_blob.create(num_output, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
     // num_output
-    #pragma omp parallel for
-    for (int p=0; p<num_output; p++)
+    innerproduct_task task(bottom_blob, top_blob, activation_params, weight_data, bias_data, channels, size, bias_term, activation_type);
+
+    parallel_for(task, num_output, opt);
+
+    return 0;
+}
+
+namespace {
+
+// one output
+struct innerproduct_int8_task : public ParallelTask
+{
+    innerproduct_int8_task(Mat& _top_blob, Mat& _bottom_blob_int8, const Mat& _activation_params, const Mat& _bias_data, const Mat& _weight_data_int8_scales, const Mat& _weight_data_int8, int _channels, int _size, int _bias_term, int _activation_type, float _bottom_blob_int8_scale)
+        : top_blob(_top_blob), bottom_blob_int8(_bottom_blob_int8), activation_params(_activation_params), bias_data(_bias_data), weight_data_int8_scales(_weight_data_int8_scales), weight_data_int8(_weight_data_int8), channels(_channels), size(_size), bias_term(_bias_term), activation_type(_activation_type), bottom_blob_int8_scale(_bottom_blob_int8_scale)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    Mat& top_blob;
+    Mat& bottom_blob_int8;
+    const Mat& activation_params;
+    const Mat& bias_data;
+    const Mat& weight_data_int8_scales;
+    const Mat& weight_data_int8;
+    int channels;
+    int size;
+    int bias_term;
+    int activation_type;
+    float bottom_blob_int8_scale;
+};
+
+void innerproduct_int8_task::execute(int p) const
+{
+    int sum = 0;
+
+    // channels
+    for (int q=0; q<channels; q++)
+    {
+        const signed char* w = (const signed char*)weight_data_int8 + size * channels * p + size * q;
+        const signed char* m = bottom_blob_int8.channel(q);
+
+        for (int i = 0; i < size; i++)
+        {
+            sum += m[i] * w[i];
+        }
+    }
+
+    const float dequant_scale = dequantize_scale(bottom_blob_int8_scale, weight_data_int8_scales[p]);
+    const float bias = bias_term ? bias_data[p] : 0.f;
+
+    dequantize_int32(&sum, (float*)top_blob + p, 1, dequant_scale, bias, activation_type, activation_params);
+}
+
+} // namespace
+
+int InnerProduct::forward_int8(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+    int size = w * h;
+
+    Mat bottom_blob_int8;
+    int ret = quantize_int8(bottom_blob, bottom_blob_int8, bottom_blob_int8_scale, opt);
+    if (ret != 0)
+        return ret;
+
+    top_blob.create(num_output, 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    // num_output
+    innerproduct_int8_task task(top_blob, bottom_blob_int8, activation_params, bias_data, weight_data_int8_scales, weight_data_int8, channels, size, bias_term, activation_type, bottom_blob_int8_scale);
+
+    parallel_for(task, num_output, opt);
+
+    return 0;
+}
+
+namespace {
+
+// one output of every sample
+struct innerproduct_batch_task : public ParallelTask
+{
+    innerproduct_batch_task(const std::vector<Mat>& _bottom_blobs, std::vector<Mat>& _top_blobs, const Mat& _activation_params, const Mat& _weight_data, const Mat& _bias_data, int _batch, int _channels, int _size, int _bias_term, int _activation_type)
+        : bottom_blobs(_bottom_blobs), top_blobs(_top_blobs), activation_params(_activation_params), weight_data(_weight_data), bias_data(_bias_data), batch(_batch), channels(_channels), size(_size), bias_term(_bias_term), activation_type(_activation_type)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    const std::vector<Mat>& bottom_blobs;
+    std::vector<Mat>& top_blobs;
+    const Mat& activation_params;
+    const Mat& weight_data;
+    const Mat& bias_data;
+    int batch;
+    int channels;
+    int size;
+    int bias_term;
+    int activation_type;
+};
+
+void innerproduct_batch_task::execute(int p) const
+{
+    const float* kptr = (const float*)weight_data + size * channels * p;
+
+    int n = 0;
+    for (; n+3<batch; n+=4)
+    {
+        float sum0 = 0.f;
+        float sum1 = 0.f;
+        float sum2 = 0.f;
+        float sum3 = 0.f;
+
+        if (bias_term)
+        {
+            sum0 = bias_data[p];
+            sum1 = bias_data[p];
+            sum2 = bias_data[p];
+            sum3 = bias_data[p];
+        }
+
+        // channels
+        for (int q=0; q<channels; q++)
+        {
+            const float* w = kptr + size * q;
+            const float* m0 = bottom_blobs[n].channel(q);
+            const float* m1 = bottom_blobs[n+1].channel(q);
+            const float* m2 = bottom_blobs[n+2].channel(q);
+            const float* m3 = bottom_blobs[n+3].channel(q);
+
+            for (int i = 0; i < size; i++)
+            {
+                sum0 += m0[i] * w[i];
+                sum1 += m1[i] * w[i];
+                sum2 += m2[i] * w[i];
+                sum3 += m3[i] * w[i];
+            }
+        }
+
+        top_blobs[n][p] = activation_ss(sum0, activation_type, activation_params);
+        top_blobs[n+1][p] = activation_ss(sum1, activation_type, activation_params);
+        top_blobs[n+2][p] = activation_ss(sum2, activation_type, activation_params);
+        top_blobs[n+3][p] = activation_ss(sum3, activation_type, activation_params);
+    }
+    for (; n<batch; n++)
     {
         float sum = 0.f;
 
@@ -72,8 +349,8 @@ int InnerProduct::forward(const Mat& bottom_blob, Mat& top_blob) const
         // channels
         for (int q=0; q<channels; q++)
         {
-            const float* w = (const float*)weight_data + size * channels * p + size * q;
-            const float* m = bottom_blob.channel(q);
+            const float* w = kptr + size * q;
+            const float* m = bottom_blobs[n].channel(q);
 
             for (int i = 0; i < size; i++)
             {
@@ -81,10 +358,57 @@ int InnerProduct::forward(const Mat& bottom_blob, Mat& top_blob) const
             }
         }
 
-        top_blob[p] = sum;
+        top_blobs[n][p] = activation_ss(sum, activation_type, activation_params);
+    }
+}
+
+} // namespace
+
+int InnerProduct::forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    if (use_int8_inference)
+        return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+    const int batch = bottom_blobs.size();
+
+    int w = bottom_blobs[0].w;
+    int h = bottom_blobs[0].h;
+    int channels = bottom_blobs[0].c;
+    int size = w * h;
+
+    for (int n=1; n<batch; n++)
+    {
+        if (bottom_blobs[n].w != w || bottom_blobs[n].h != h || bottom_blobs[n].c != channels)
+            return Layer::forward_batch(bottom_blobs, top_blobs, opt);
     }
 
+    top_blobs.resize(batch);
+    for (int n=0; n<batch; n++)
+    {
+        top_blobs[n].create(num_output, 4u, opt.blob_allocator);
+        if (top_blobs[n].empty())
+            return -100;
+    }
+
+    // gemm, each weight row is read once and reused by the whole batch
+    // num_output
+    innerproduct_batch_task task(bottom_blobs, top_blobs, activation_params, weight_data, bias_data, batch, channels, size, bias_term, activation_type);
+
+    parallel_for(task, num_output, opt);
+
     return 0;
 }
 
+int InnerProduct::infer_shape(const std::vector<Mat>& /*_bottom_shapes*/, std::vector<Mat>& _top_shapes)
+{
+    _top_shapes[0] = Mat(num_output, (void*)0);
+
+    return 0;
+}
+
+const char* InnerProduct::kernel_name(const Mat& /*bottom_blob*/) const
+{
+    return use_int8_inference ? "int8" : 0;
+}
+
 } // namespace ncnn
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "instancenorm.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -46,7 +47,55 @@ int InstanceNorm::load_model(const ModelBin& mb)
     return 0;
 }
 
-int InstanceNorm::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct instancenorm_task : public ParallelTask
+{
+    instancenorm_task(Mat& _bottom_top_blob, const Mat& _gamma_data, const Mat& _beta_data, int _size, float _eps)
+        : bottom_top_blob(_bottom_top_blob), gamma_data(_gamma_data), beta_data(_beta_data), size(_size), eps(_eps)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& gamma_data;
+    const Mat& beta_data;
+    int size;
+    float eps;
+};
+
+void instancenorm_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    // mean and var
+    float sum = 0.f;
+    float sqsum = 0.f;
+    for (int i=0; i<size; i++)
+    {
+        sum += ptr[i];
+        sqsum += ptr[i] * ptr[i];
+    }
+    float mean = sum / size;
+    float var = sqsum / size - mean * mean;
+
+    float gamma = gamma_data[q];
+    float beta = beta_data[q];
+
+    float a = gamma / (sqrt(var) + eps);
+    float b = - mean * a + beta;
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = ptr[i] * a + b;
+    }
+}
+
+} // namespace
+
+int InstanceNorm::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     // x = (x - mean) / (sqrt(var) + eps) * gamma + beta
 
@@ -54,33 +103,9 @@ int InstanceNorm::forward_inplace(Mat& bottom_top_blob) const
     int h = bottom_top_blob.h;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
-
-        // mean and var
-        float sum = 0.f;
-        float sqsum = 0.f;
-        for (int i=0; i<size; i++)
-        {
-            sum += ptr[i];
-            sqsum += ptr[i] * ptr[i];
-        }
-        float mean = sum / size;
-        float var = sqsum / size - mean * mean;
-
-        float gamma = gamma_data[q];
-        float beta = beta_data[q];
-
-        float a = gamma / (sqrt(var) + eps);
-        float b = - mean * a + beta;
-
-        for (int i=0; i<size; i++)
-        {
-            ptr[i] = ptr[i] * a + b;
-        }
-    }
+    instancenorm_task task(bottom_top_blob, gamma_data, beta_data, size, eps);
+
+    parallel_for(task, channels, opt);
 
     return 0;
 }
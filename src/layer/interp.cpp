@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "interp.h"
+#include "threadpool.h"
 #include <algorithm>
 
 namespace ncnn {
@@ -35,7 +36,46 @@ int Interp::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Interp::forward(const Mat &bottom_blob, Mat &top_blob) const
+namespace {
+
+// one channel
+struct interp_nearest_task : public ParallelTask
+{
+    interp_nearest_task(const Mat& _bottom_blob, Mat& _top_blob, int _h, int _w, int _oh, int _ow, float _width_scale, float _height_scale)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), h(_h), w(_w), oh(_oh), ow(_ow), width_scale(_width_scale), height_scale(_height_scale)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int h;
+    int w;
+    int oh;
+    int ow;
+    float width_scale;
+    float height_scale;
+};
+
+void interp_nearest_task::execute(int q) const
+{
+    const float *ptr = bottom_blob.channel(q);
+    float *output_ptr = top_blob.channel(q);
+    for (int y = 0; y < oh; ++y)
+    {
+        const int in_y = std::min((int) (y / height_scale), (h - 1));
+        for (int x = 0; x < ow; ++x)
+        {
+            const int in_x = std::min((int) (x / width_scale), (w - 1));
+            output_ptr[ow * y + x] = ptr[in_y * w + in_x];
+        }
+    }
+}
+
+} // namespace
+
+int Interp::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     int h = bottom_blob.h;
     int w = bottom_blob.w;
@@ -52,33 +92,21 @@ int Interp::forward(const Mat &bottom_blob, Mat &top_blob) const
         top_blob = bottom_blob;
         return 0;
     }
-    top_blob.create(ow, oh, c);
+    top_blob.create(ow, oh, c, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
     if (resize_type == 1)//nearest
     {
-        #pragma omp parallel for
-        for (int q = 0; q < c; ++q)
-        {
-            const float *ptr = bottom_blob.channel(q);
-            float *output_ptr = top_blob.channel(q);
-            for (int y = 0; y < oh; ++y)
-            {
-                const int in_y = std::min((int) (y / height_scale), (h - 1));
-                for (int x = 0; x < ow; ++x)
-                {
-                    const int in_x = std::min((int) (x / width_scale), (w - 1));
-                    output_ptr[ow * y + x] = ptr[in_y * w + in_x];
-                }
-            }
-        }
+        interp_nearest_task task(bottom_blob, top_blob, h, w, oh, ow, width_scale, height_scale);
+
+        parallel_for(task, c, opt);
         return 0;
 
         }
     else if (resize_type == 2)// bilinear
     {
-        resize_bilinear(bottom_blob, top_blob, ow, oh);
+        resize_bilinear(bottom_blob, top_blob, ow, oh, opt.blob_allocator);
         return 0;
 
     }
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "log.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -34,7 +35,64 @@ int Log::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Log::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct log_task : public ParallelTask
+{
+    log_task(Mat& _bottom_top_blob, int _size, float _scale, float _shift)
+        : bottom_top_blob(_bottom_top_blob), size(_size), scale(_scale), shift(_shift)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float scale;
+    float shift;
+};
+
+void log_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = log(shift + ptr[i] * scale);
+    }
+}
+
+// one channel
+struct log_base_task : public ParallelTask
+{
+    log_base_task(Mat& _bottom_top_blob, int _size, float _log_base_inv, float _scale, float _shift)
+        : bottom_top_blob(_bottom_top_blob), size(_size), log_base_inv(_log_base_inv), scale(_scale), shift(_shift)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float log_base_inv;
+    float scale;
+    float shift;
+};
+
+void log_base_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = log(shift + ptr[i] * scale) * log_base_inv;
+    }
+}
+
+} // namespace
+
+int Log::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
@@ -43,31 +101,17 @@ int Log::forward_inplace(Mat& bottom_top_blob) const
 
     if (base == -1.f)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] = log(shift + ptr[i] * scale);
-            }
-        }
+        log_task task(bottom_top_blob, size, scale, shift);
+
+        parallel_for(task, channels, opt);
     }
     else
     {
         float log_base_inv = 1.f / log(base);
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
+        log_base_task task(bottom_top_blob, size, log_base_inv, scale, shift);
 
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] = log(shift + ptr[i] * scale) * log_base_inv;
-            }
-        }
+        parallel_for(task, channels, opt);
     }
 
     return 0;
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "lrn.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -35,7 +36,126 @@ int LRN::load_param(const ParamDict& pd)
     return 0;
 }
 
-int LRN::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct lrn_square_task : public ParallelTask
+{
+    lrn_square_task(Mat& _bottom_top_blob, Mat& _square_blob, int _size)
+        : bottom_top_blob(_bottom_top_blob), square_blob(_square_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& square_blob;
+    int size;
+};
+
+void lrn_square_task::execute(int q) const
+{
+    const float* ptr = bottom_top_blob.channel(q);
+    float* outptr = square_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] * ptr[i];
+    }
+}
+
+// one channel
+struct lrn_across_channels_task : public ParallelTask
+{
+    lrn_across_channels_task(Mat& _bottom_top_blob, Mat& _square_blob, Mat& _square_sum, int _channels, int _size, float _alpha_div_size, int _local_size, float _beta)
+        : bottom_top_blob(_bottom_top_blob), square_blob(_square_blob), square_sum(_square_sum), channels(_channels), size(_size), alpha_div_size(_alpha_div_size), local_size(_local_size), beta(_beta)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& square_blob;
+    Mat& square_sum;
+    int channels;
+    int size;
+    float alpha_div_size;
+    int local_size;
+    float beta;
+};
+
+void lrn_across_channels_task::execute(int q) const
+{
+    // square sum
+    float* ssptr = square_sum.channel(q);
+    for (int p=q - local_size / 2; p<=q + local_size / 2; p++)
+    {
+        if (p < 0 || p >= channels)
+            continue;
+
+        const float* sptr = square_blob.channel(p);
+        for (int i=0; i<size; i++)
+        {
+            ssptr[i] += sptr[i];
+        }
+    }
+
+    float* ptr = bottom_top_blob.channel(q);
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = ptr[i] * pow(1.f + alpha_div_size * ssptr[i], -beta);
+    }
+}
+
+// one channel
+struct lrn_within_channel_task : public ParallelTask
+{
+    lrn_within_channel_task(Mat& _bottom_top_blob, Mat& _square_blob_bordered, int _outw, int _outh, int _maxk, float _alpha_div_size, int* _space_ofs, float _beta)
+        : bottom_top_blob(_bottom_top_blob), square_blob_bordered(_square_blob_bordered), outw(_outw), outh(_outh), maxk(_maxk), alpha_div_size(_alpha_div_size), space_ofs(_space_ofs), beta(_beta)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& square_blob_bordered;
+    int outw;
+    int outh;
+    int maxk;
+    float alpha_div_size;
+    int* space_ofs;
+    float beta;
+};
+
+void lrn_within_channel_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+    const Mat m = square_blob_bordered.channel(q);
+
+    for (int i = 0; i < outh; i++)
+    {
+        for (int j = 0; j < outw; j++)
+        {
+            const float* sptr = m.row(i) + j;
+
+            float ss = 0.f;
+
+            for (int k = 0; k < maxk; k++)
+            {
+                float val = sptr[ space_ofs[k] ];
+                ss += val;
+            }
+
+            ptr[j] = ptr[j] * pow(1.f + alpha_div_size * ss, -beta);
+        }
+
+        ptr += outw;
+    }
+}
+
+} // namespace
+
+int LRN::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
@@ -44,55 +164,27 @@ int LRN::forward_inplace(Mat& bottom_top_blob) const
 
     // squared values with local_size padding
     Mat square_blob;
-    square_blob.create(w, h, channels);
+    square_blob.create(w, h, channels, 4u, opt.workspace_allocator);
     if (square_blob.empty())
         return -100;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        const float* ptr = bottom_top_blob.channel(q);
-        float* outptr = square_blob.channel(q);
+    lrn_square_task task(bottom_top_blob, square_blob, size);
 
-        for (int i=0; i<size; i++)
-        {
-            outptr[i] = ptr[i] * ptr[i];
-        }
-    }
+    parallel_for(task, channels, opt);
 
     if (region_type == NormRegion_ACROSS_CHANNELS)
     {
         Mat square_sum;
-        square_sum.create(w, h, channels);
+        square_sum.create(w, h, channels, 4u, opt.workspace_allocator);
         if (square_sum.empty())
             return -100;
         square_sum.fill(0.f);
 
         const float alpha_div_size = alpha / local_size;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            // square sum
-            float* ssptr = square_sum.channel(q);
-            for (int p=q - local_size / 2; p<=q + local_size / 2; p++)
-            {
-                if (p < 0 || p >= channels)
-                    continue;
-
-                const float* sptr = square_blob.channel(p);
-                for (int i=0; i<size; i++)
-                {
-                    ssptr[i] += sptr[i];
-                }
-            }
+        lrn_across_channels_task task(bottom_top_blob, square_blob, square_sum, channels, size, alpha_div_size, local_size, beta);
 
-            float* ptr = bottom_top_blob.channel(q);
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] = ptr[i] * pow(1.f + alpha_div_size * ssptr[i], -beta);
-            }
-        }
+        parallel_for(task, channels, opt);
     }
     else if (region_type == NormRegion_WITHIN_CHANNEL)
     {
@@ -103,7 +195,7 @@ int LRN::forward_inplace(Mat& bottom_top_blob) const
         int pad = local_size / 2;
         if (pad > 0)
         {
-            copy_make_border(square_blob, square_blob_bordered, pad, local_size - pad - 1, pad, local_size - pad - 1, BORDER_CONSTANT, 0.f);
+            copy_make_border(square_blob, square_blob_bordered, pad, local_size - pad - 1, pad, local_size - pad - 1, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
             if (square_blob_bordered.empty())
                 return -100;
 
@@ -134,32 +226,9 @@ int LRN::forward_inplace(Mat& bottom_top_blob) const
             }
         }
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-            const Mat m = square_blob_bordered.channel(q);
+        lrn_within_channel_task task(bottom_top_blob, square_blob_bordered, outw, outh, maxk, alpha_div_size, space_ofs, beta);
 
-            for (int i = 0; i < outh; i++)
-            {
-                for (int j = 0; j < outw; j++)
-                {
-                    const float* sptr = m.row(i) + j;
-
-                    float ss = 0.f;
-
-                    for (int k = 0; k < maxk; k++)
-                    {
-                        float val = sptr[ space_ofs[k] ];
-                        ss += val;
-                    }
-
-                    ptr[j] = ptr[j] * pow(1.f + alpha_div_size * ss, -beta);
-                }
-
-                ptr += outw;
-            }
-        }
+        parallel_for(task, channels, opt);
     }
 
     return 0;
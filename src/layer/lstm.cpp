@@ -57,7 +57,7 @@ int LSTM::load_model(const ModelBin& mb)
     return 0;
 }
 
-int LSTM::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+int LSTM::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     // size x 1 x T
     const Mat& input_blob = bottom_blobs[0];
@@ -84,7 +84,7 @@ int LSTM::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_bl
         return -100;
 
     Mat& top_blob = top_blobs[0];
-    top_blob.create(num_output, 1, T);
+    top_blob.create(num_output, 1, T, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -174,4 +174,126 @@ int LSTM::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_bl
     return 0;
 }
 
+int LSTM::forward_batch(const std::vector< std::vector<Mat> >& bottom_blobs, std::vector< std::vector<Mat> >& top_blobs, const Option& opt) const
+{
+    const int batch = bottom_blobs.size();
+
+    int T = bottom_blobs[0][0].c;
+    int size = bottom_blobs[0][0].w;
+
+    for (int n=1; n<batch; n++)
+    {
+        if (bottom_blobs[n][0].c != T || bottom_blobs[n][0].w != size)
+            return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+    }
+
+    // initial hidden state of each sample
+    Mat hidden(num_output, batch);
+    if (hidden.empty())
+        return -100;
+    hidden.fill(0.f);
+
+    // internal cell state of each sample
+    Mat cell(num_output, batch);
+    if (cell.empty())
+        return -100;
+    cell.fill(0.f);
+    // 4 x num_output of each sample
+    Mat gates(4, num_output, batch);
+    if (gates.empty())
+        return -100;
+
+    top_blobs.resize(batch);
+    for (int n=0; n<batch; n++)
+    {
+        top_blobs[n].resize(1);
+        top_blobs[n][0].create(num_output, 1, T, 4u, opt.blob_allocator);
+        if (top_blobs[n][0].empty())
+            return -100;
+    }
+
+    // unroll
+    for (int t=0; t<T; t++)
+    {
+        // gate_input_t := W_hc * h_conted_{t-1} + W_xc * x_t + b_c
+        // the weight rows of one output are shared by the whole batch
+        for (int q=0; q<num_output; q++)
+        {
+            const float* bias_c_data_ptr = (const float*)bias_c_data + 4 * q;
+
+            // gate I F O G
+            const float* weight_hc_data_I = (const float*)weight_hc_data + weight_hc_data.w * q;
+            const float* weight_xc_data_I = (const float*)weight_xc_data + weight_xc_data.w * q;
+            const float* weight_hc_data_F = (const float*)weight_hc_data + weight_hc_data.w * q + size;
+            const float* weight_xc_data_F = (const float*)weight_xc_data + weight_xc_data.w * q + size;
+            const float* weight_hc_data_O = (const float*)weight_hc_data + weight_hc_data.w * q + size*2;
+            const float* weight_xc_data_O = (const float*)weight_xc_data + weight_xc_data.w * q + size*2;
+            const float* weight_hc_data_G = (const float*)weight_hc_data + weight_hc_data.w * q + size*3;
+            const float* weight_xc_data_G = (const float*)weight_xc_data + weight_xc_data.w * q + size*3;
+
+            for (int n=0; n<batch; n++)
+            {
+                const float cont = bottom_blobs[n][1][t];
+                const Mat x = bottom_blobs[n][0].channel(t);
+                const float* x_data = x;
+
+                float h_cont = cont ? hidden.row(n)[q] : 0.f;
+
+                float I = bias_c_data_ptr[0];
+                float F = bias_c_data_ptr[1];
+                float O = bias_c_data_ptr[2];
+                float G = bias_c_data_ptr[3];
+                for (int i=0; i<size; i++)
+                {
+                    I += weight_hc_data_I[i] * h_cont + weight_xc_data_I[i] * x_data[i];
+                    F += weight_hc_data_F[i] * h_cont + weight_xc_data_F[i] * x_data[i];
+                    O += weight_hc_data_O[i] * h_cont + weight_xc_data_O[i] * x_data[i];
+                    G += weight_hc_data_G[i] * h_cont + weight_xc_data_G[i] * x_data[i];
+                }
+
+                float* gates_data = (float*)gates.channel(n) + 4 * q;
+                gates_data[0] = I;
+                gates_data[1] = F;
+                gates_data[2] = O;
+                gates_data[3] = G;
+            }
+        }
+
+        // lstm unit
+        // c_t := f_t .* c_{t-1} + i_t .* g_t
+        // h_t := o_t .* tanh[c_t]
+        for (int n=0; n<batch; n++)
+        {
+            const float cont = bottom_blobs[n][1][t];
+            float* hidden_data = hidden.row(n);
+            float* cell_data = cell.row(n);
+            Mat output = top_blobs[n][0].channel(t);
+            float* output_data = output;
+            for (int q=0; q<num_output; q++)
+            {
+                const float* gates_data = (const float*)gates.channel(n) + 4 * q;
+
+                float I = gates_data[0];
+                float F = gates_data[1];
+                float O = gates_data[2];
+                float G = gates_data[3];
+
+                I = 1.f / (1.f + exp(-I));
+                F = cont ? 0.f : 1.f / (1.f + exp(-F));
+                O = 1.f / (1.f + exp(-O));
+                G = tanh(G);
+
+                float cell = F * cell_data[q] + I * G;
+                float H = O * tanh(cell);
+
+                cell_data[q] = cell;
+                hidden_data[q] = H;
+                output_data[q] = H;
+            }
+        }
+    }
+
+    return 0;
+}
+
 } // namespace ncnn
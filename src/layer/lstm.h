@@ -28,7 +28,9 @@ public:
 
     virtual int load_model(const ModelBin& mb);
 
-    virtual int forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const;
+    virtual int forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const;
+
+    virtual int forward_batch(const std::vector< std::vector<Mat> >& bottom_blobs, std::vector< std::vector<Mat> >& top_blobs, const Option& opt) const;
 
 public:
     // param
@@ -57,15 +57,22 @@ int MemoryData::load_model(const ModelBin& mb)
     return 0;
 }
 
-int MemoryData::forward(const std::vector<Mat>& /*bottom_blobs*/, std::vector<Mat>& top_blobs) const
+int MemoryData::forward(const std::vector<Mat>& /*bottom_blobs*/, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     Mat& top_blob = top_blobs[0];
 
-    top_blob = data.clone();
+    top_blob = data.clone(opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
     return 0;
 }
 
+int MemoryData::infer_shape(const std::vector<Mat>& /*_bottom_shapes*/, std::vector<Mat>& _top_shapes)
+{
+    _top_shapes[0] = data.shape();
+
+    return 0;
+}
+
 } // namespace ncnn
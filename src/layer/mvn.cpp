@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "mvn.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -34,14 +35,183 @@ int MVN::load_param(const ParamDict& pd)
     return 0;
 }
 
-int MVN::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one channel
+struct mvn_sum_task : public ParallelTask
+{
+    mvn_sum_task(const Mat& _bottom_blob, Mat& _sum, int _size)
+        : bottom_blob(_bottom_blob), sum(_sum), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& sum;
+    int size;
+};
+
+void mvn_sum_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+
+    float s = 0.f;
+    for (int i=0; i<size; i++)
+    {
+        s += ptr[i];
+    }
+
+    sum[q] = s;
+}
+
+// one channel
+struct mvn_sub_mean_task : public ParallelTask
+{
+    mvn_sub_mean_task(const Mat& _bottom_blob, Mat& _top_blob, int _size, float _mean)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), size(_size), mean(_mean)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int size;
+    float mean;
+};
+
+void mvn_sub_mean_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] - mean;
+    }
+}
+
+// one channel
+struct mvn_sub_channel_mean_task : public ParallelTask
+{
+    mvn_sub_channel_mean_task(const Mat& _bottom_blob, Mat& _top_blob, Mat& _sum, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), sum(_sum), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    Mat& sum;
+    int size;
+};
+
+void mvn_sub_channel_mean_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+    float mean = sum[q] / size;
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] - mean;
+    }
+}
+
+// one channel
+struct mvn_sqsum_task : public ParallelTask
+{
+    mvn_sqsum_task(Mat& _top_blob, Mat& _sqsum, int _size)
+        : top_blob(_top_blob), sqsum(_sqsum), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    Mat& sqsum;
+    int size;
+};
+
+void mvn_sqsum_task::execute(int q) const
+{
+    const float* ptr = top_blob.channel(q);
+
+    float s = 0.f;
+    for (int i=0; i<size; i++)
+    {
+        s += ptr[i] * ptr[i];
+    }
+
+    sqsum[q] = s;
+}
+
+// one channel
+struct mvn_norm_task : public ParallelTask
+{
+    mvn_norm_task(Mat& _top_blob, int _size, float _norm_var_inv)
+        : top_blob(_top_blob), size(_size), norm_var_inv(_norm_var_inv)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    int size;
+    float norm_var_inv;
+};
+
+void mvn_norm_task::execute(int q) const
+{
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = outptr[i] * norm_var_inv;
+    }
+}
+
+// one channel
+struct mvn_channel_norm_task : public ParallelTask
+{
+    mvn_channel_norm_task(Mat& _top_blob, Mat& _sqsum, int _size, float _eps)
+        : top_blob(_top_blob), sqsum(_sqsum), size(_size), eps(_eps)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    Mat& sqsum;
+    int size;
+    float eps;
+};
+
+void mvn_channel_norm_task::execute(int q) const
+{
+    float* outptr = top_blob.channel(q);
+    float sqmean = sqsum[q] / size;
+    float norm_var = sqrt(sqmean) + eps;
+    float norm_var_inv = 1.f / norm_var;
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = outptr[i] * norm_var_inv;
+    }
+}
+
+} // namespace
+
+int MVN::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     int w = bottom_blob.w;
     int h = bottom_blob.h;
     int channels = bottom_blob.c;
     int size = w * h;
 
-    top_blob.create(w, h, channels);
+    top_blob.create(w, h, channels, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -50,19 +220,9 @@ int MVN::forward(const Mat& bottom_blob, Mat& top_blob) const
     if (sum.empty())
         return -100;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        const float* ptr = bottom_blob.channel(q);
-
-        float s = 0.f;
-        for (int i=0; i<size; i++)
-        {
-            s += ptr[i];
-        }
+    mvn_sum_task task(bottom_blob, sum, size);
 
-        sum[q] = s;
-    }
+    parallel_for(task, channels, opt);
 
     if (across_channels)
     {
@@ -75,33 +235,16 @@ int MVN::forward(const Mat& bottom_blob, Mat& top_blob) const
         mean = mean / (channels * size);
 
         // subtract mean
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_blob.channel(q);
-            float* outptr = top_blob.channel(q);
+        mvn_sub_mean_task task(bottom_blob, top_blob, size, mean);
 
-            for (int i=0; i<size; i++)
-            {
-                outptr[i] = ptr[i] - mean;
-            }
-        }
+        parallel_for(task, channels, opt);
     }
     else
     {
         // subtract mean
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_blob.channel(q);
-            float* outptr = top_blob.channel(q);
-            float mean = sum[q] / size;
+        mvn_sub_channel_mean_task task(bottom_blob, top_blob, sum, size);
 
-            for (int i=0; i<size; i++)
-            {
-                outptr[i] = ptr[i] - mean;
-            }
-        }
+        parallel_for(task, channels, opt);
     }
 
     if (normalize_variance)
@@ -111,19 +254,9 @@ int MVN::forward(const Mat& bottom_blob, Mat& top_blob) const
         if (sqsum.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = top_blob.channel(q);
+        mvn_sqsum_task task(top_blob, sqsum, size);
 
-            float s = 0.f;
-            for (int i=0; i<size; i++)
-            {
-                s += ptr[i] * ptr[i];
-            }
-
-            sqsum[q] = s;
-        }
+        parallel_for(task, channels, opt);
 
         if (across_channels)
         {
@@ -140,33 +273,16 @@ int MVN::forward(const Mat& bottom_blob, Mat& top_blob) const
             float norm_var_inv = 1.f / norm_var;
 
             // apply normalize_variance
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                float* outptr = top_blob.channel(q);
+            mvn_norm_task task(top_blob, size, norm_var_inv);
 
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = outptr[i] * norm_var_inv;
-                }
-            }
+            parallel_for(task, channels, opt);
         }
         else
         {
             // apply normalize_variance
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                float* outptr = top_blob.channel(q);
-                float sqmean = sqsum[q] / size;
-                float norm_var = sqrt(sqmean) + eps;
-                float norm_var_inv = 1.f / norm_var;
-
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = outptr[i] * norm_var_inv;
-                }
-            }
+            mvn_channel_norm_task task(top_blob, sqsum, size, eps);
+
+            parallel_for(task, channels, opt);
         }
 
     }
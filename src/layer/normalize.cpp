@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "normalize.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -45,14 +46,253 @@ int Normalize::load_model(const ModelBin& mb)
     return 0;
 }
 
-int Normalize::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one channel
+struct normalize_square_sum_task : public ParallelTask
+{
+    normalize_square_sum_task(const Mat& _bottom_blob, Mat& _square_sum_blob, int _size)
+        : bottom_blob(_bottom_blob), square_sum_blob(_square_sum_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& square_sum_blob;
+    int size;
+};
+
+void normalize_square_sum_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+
+    float ssum = 0.f;
+    for (int i=0; i<size; i++)
+    {
+        ssum += ptr[i] * ptr[i];
+    }
+
+    square_sum_blob[q] = ssum;
+}
+
+// one channel
+struct normalize_scale_task : public ParallelTask
+{
+    normalize_scale_task(const Mat& _bottom_blob, Mat& _top_blob, int _size, float _scale)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), size(_size), scale(_scale)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int size;
+    float scale;
+};
+
+void normalize_scale_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] * scale;
+    }
+}
+
+// one channel
+struct normalize_channel_scale_task : public ParallelTask
+{
+    normalize_channel_scale_task(const Mat& _bottom_blob, Mat& _top_blob, const Mat& _scale_data, int _size, float _a)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), scale_data(_scale_data), size(_size), a(_a)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Mat& scale_data;
+    int size;
+    float a;
+};
+
+void normalize_channel_scale_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+    float scale = a * scale_data[q];
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] * scale;
+    }
+}
+
+// one channel
+struct normalize_spatial_task : public ParallelTask
+{
+    normalize_spatial_task(const Mat& _bottom_blob, Mat& _top_blob, const Mat& _scale_data, int _size, int _channel_shared, float _eps)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), scale_data(_scale_data), size(_size), channel_shared(_channel_shared), eps(_eps)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Mat& scale_data;
+    int size;
+    int channel_shared;
+    float eps;
+};
+
+void normalize_spatial_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    float ssum = eps;
+    for (int i=0; i<size; i++)
+    {
+        ssum += ptr[i] * ptr[i];
+    }
+
+    float a = 1.f / sqrt(ssum);
+    float scale = a * (channel_shared ? scale_data[0] : scale_data[q]);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] * scale;
+    }
+}
+
+// one position
+struct normalize_shared_square_sum_task : public ParallelTask
+{
+    normalize_shared_square_sum_task(const Mat& _bottom_blob, Mat& _square_sum_blob, int _channels, float _scale, float _eps)
+        : bottom_blob(_bottom_blob), square_sum_blob(_square_sum_blob), channels(_channels), scale(_scale), eps(_eps)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    const Mat& bottom_blob;
+    Mat& square_sum_blob;
+    int channels;
+    float scale;
+    float eps;
+};
+
+void normalize_shared_square_sum_task::execute(int i) const
+{
+    float ssum = eps;
+    for (int q=0; q<channels; q++)
+    {
+        const float* ptr = bottom_blob.channel(q);
+        ssum += ptr[i] * ptr[i];
+    }
+
+    square_sum_blob[i] = 1.f / sqrt(ssum) * scale;
+}
+
+// one channel
+struct normalize_shared_task : public ParallelTask
+{
+    normalize_shared_task(const Mat& _bottom_blob, Mat& _top_blob, Mat& _square_sum_blob, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), square_sum_blob(_square_sum_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    Mat& square_sum_blob;
+    int size;
+};
+
+void normalize_shared_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] * square_sum_blob[i];
+    }
+}
+
+// one position
+struct normalize_square_sum_spatial_task : public ParallelTask
+{
+    normalize_square_sum_spatial_task(const Mat& _bottom_blob, Mat& _square_sum_blob, int _channels, float _eps)
+        : bottom_blob(_bottom_blob), square_sum_blob(_square_sum_blob), channels(_channels), eps(_eps)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    const Mat& bottom_blob;
+    Mat& square_sum_blob;
+    int channels;
+    float eps;
+};
+
+void normalize_square_sum_spatial_task::execute(int i) const
+{
+    float ssum = eps;
+    for (int q=0; q<channels; q++)
+    {
+        const float* ptr = bottom_blob.channel(q);
+        ssum += ptr[i] * ptr[i];
+    }
+
+    square_sum_blob[i] = 1.f / sqrt(ssum);
+}
+
+// one channel
+struct normalize_channel_task : public ParallelTask
+{
+    normalize_channel_task(const Mat& _bottom_blob, Mat& _top_blob, Mat& _square_sum_blob, const Mat& _scale_data, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), square_sum_blob(_square_sum_blob), scale_data(_scale_data), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    Mat& square_sum_blob;
+    const Mat& scale_data;
+    int size;
+};
+
+void normalize_channel_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+    float scale = scale_data[q];
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i] * square_sum_blob[i] * scale;
+    }
+}
+
+} // namespace
+
+int Normalize::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     int w = bottom_blob.w;
     int h = bottom_blob.h;
     int channels = bottom_blob.c;
     int size = w * h;
 
-    top_blob.create(w, h, channels);
+    top_blob.create(w, h, channels, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -60,23 +300,13 @@ int Normalize::forward(const Mat& bottom_blob, Mat& top_blob) const
     {
         // square
         Mat square_sum_blob;
-        square_sum_blob.create(channels);
+        square_sum_blob.create(channels, 4u, opt.workspace_allocator);
         if (square_sum_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_blob.channel(q);
+        normalize_square_sum_task task(bottom_blob, square_sum_blob, size);
 
-            float ssum = 0.f;
-            for (int i=0; i<size; i++)
-            {
-                ssum += ptr[i] * ptr[i];
-            }
-
-            square_sum_blob[q] = ssum;
-        }
+        parallel_for(task, channels, opt);
 
         // sum + eps
         float ssum = eps;
@@ -92,32 +322,15 @@ int Normalize::forward(const Mat& bottom_blob, Mat& top_blob) const
         {
             float scale = a * scale_data[0];
 
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob.channel(q);
-                float* outptr = top_blob.channel(q);
-
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = ptr[i] * scale;
-                }
-            }
+            normalize_scale_task task(bottom_blob, top_blob, size, scale);
+
+            parallel_for(task, channels, opt);
         }
         else
         {
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob.channel(q);
-                float* outptr = top_blob.channel(q);
-                float scale = a * scale_data[q];
-
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = ptr[i] * scale;
-                }
-            }
+            normalize_channel_scale_task task(bottom_blob, top_blob, scale_data, size, a);
+
+            parallel_for(task, channels, opt);
         }
 
         return 0;
@@ -125,26 +338,9 @@ int Normalize::forward(const Mat& bottom_blob, Mat& top_blob) const
 
     if (across_spatial && !across_channel)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_blob.channel(q);
-            float* outptr = top_blob.channel(q);
-
-            float ssum = eps;
-            for (int i=0; i<size; i++)
-            {
-                ssum += ptr[i] * ptr[i];
-            }
-
-            float a = 1.f / sqrt(ssum);
-            float scale = a * (channel_shared ? scale_data[0] : scale_data[q]);
-
-            for (int i=0; i<size; i++)
-            {
-                outptr[i] = ptr[i] * scale;
-            }
-        }
+        normalize_spatial_task task(bottom_blob, top_blob, scale_data, size, channel_shared, eps);
+
+        parallel_for(task, channels, opt);
 
         return 0;
     }
@@ -153,7 +349,7 @@ int Normalize::forward(const Mat& bottom_blob, Mat& top_blob) const
     {
         // square sum, 1 / sqrt(ssum)
         Mat square_sum_blob;
-        square_sum_blob.create(size);
+        square_sum_blob.create(size, 4u, opt.workspace_allocator);
         if (square_sum_blob.empty())
             return -100;
 
@@ -161,58 +357,23 @@ int Normalize::forward(const Mat& bottom_blob, Mat& top_blob) const
         {
             float scale = scale_data[0];
 
-            #pragma omp parallel for
-            for (int i=0; i<size; i++)
-            {
-                float ssum = eps;
-                for (int q=0; q<channels; q++)
-                {
-                    const float* ptr = bottom_blob.channel(q);
-                    ssum += ptr[i] * ptr[i];
-                }
-
-                square_sum_blob[i] = 1.f / sqrt(ssum) * scale;
-            }
-
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob.channel(q);
-                float* outptr = top_blob.channel(q);
-
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = ptr[i] * square_sum_blob[i];
-                }
-            }
+            normalize_shared_square_sum_task task(bottom_blob, square_sum_blob, channels, scale, eps);
+
+            parallel_for(task, size, opt);
+
+            normalize_shared_task scale_task(bottom_blob, top_blob, square_sum_blob, size);
+
+            parallel_for(scale_task, channels, opt);
         }
         else
         {
-            #pragma omp parallel for
-            for (int i=0; i<size; i++)
-            {
-                float ssum = eps;
-                for (int q=0; q<channels; q++)
-                {
-                    const float* ptr = bottom_blob.channel(q);
-                    ssum += ptr[i] * ptr[i];
-                }
-
-                square_sum_blob[i] = 1.f / sqrt(ssum);
-            }
-
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob.channel(q);
-                float* outptr = top_blob.channel(q);
-                float scale = scale_data[q];
-
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = ptr[i] * square_sum_blob[i] * scale;
-                }
-            }
+            normalize_square_sum_spatial_task task(bottom_blob, square_sum_blob, channels, eps);
+
+            parallel_for(task, size, opt);
+
+            normalize_channel_task scale_task(bottom_blob, top_blob, square_sum_blob, scale_data, size);
+
+            parallel_for(scale_task, channels, opt);
         }
 
         return 0;
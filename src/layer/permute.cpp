@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "permute.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -31,7 +32,167 @@ int Permute::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Permute::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one channel
+struct permute_wh_task : public ParallelTask
+{
+    permute_wh_task(const Mat& _bottom_blob, Mat& _top_blob, int _w, int _h)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int w;
+    int h;
+};
+
+void permute_wh_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i = 0; i < w; i++)
+    {
+        for (int j = 0; j < h; j++)
+        {
+            outptr[i*h + j] = ptr[j*w + i];
+        }
+    }
+}
+
+// one row of the input
+struct permute_cw_task : public ParallelTask
+{
+    permute_cw_task(Mat& _top_blob, const Mat& _bottom_blob, int _w, int _channels)
+        : top_blob(_top_blob), bottom_blob(_bottom_blob), w(_w), channels(_channels)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    const Mat& bottom_blob;
+    int w;
+    int channels;
+};
+
+void permute_cw_task::execute(int q) const
+{
+    float* outptr = top_blob.channel(q);
+
+    for (int i = 0; i < channels; i++)
+    {
+        const float* ptr = bottom_blob.channel(i).row(q);
+
+        for (int j = 0; j < w; j++)
+        {
+            outptr[i*w + j] = ptr[j];
+        }
+    }
+}
+
+// one row of the input
+struct permute_wc_task : public ParallelTask
+{
+    permute_wc_task(Mat& _top_blob, const Mat& _bottom_blob, int _w, int _channels)
+        : top_blob(_top_blob), bottom_blob(_bottom_blob), w(_w), channels(_channels)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    const Mat& bottom_blob;
+    int w;
+    int channels;
+};
+
+void permute_wc_task::execute(int q) const
+{
+    float* outptr = top_blob.channel(q);
+
+    for (int i = 0; i < w; i++)
+    {
+        for (int j = 0; j < channels; j++)
+        {
+            const float* ptr = bottom_blob.channel(j).row(q);
+
+            outptr[i*channels + j] = ptr[i];
+        }
+    }
+}
+
+// one column of the input
+struct permute_ch_task : public ParallelTask
+{
+    permute_ch_task(Mat& _top_blob, const Mat& _bottom_blob, int _w, int _h, int _channels)
+        : top_blob(_top_blob), bottom_blob(_bottom_blob), w(_w), h(_h), channels(_channels)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    const Mat& bottom_blob;
+    int w;
+    int h;
+    int channels;
+};
+
+void permute_ch_task::execute(int q) const
+{
+    float* outptr = top_blob.channel(q);
+
+    for (int i = 0; i < channels; i++)
+    {
+        const float* ptr = bottom_blob.channel(i);
+
+        for (int j = 0; j < h; j++)
+        {
+            outptr[i*channels + j] = ptr[j*w + q];
+        }
+    }
+}
+
+// one column of the input
+struct permute_hc_task : public ParallelTask
+{
+    permute_hc_task(Mat& _top_blob, const Mat& _bottom_blob, int _w, int _h, int _channels)
+        : top_blob(_top_blob), bottom_blob(_bottom_blob), w(_w), h(_h), channels(_channels)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    const Mat& bottom_blob;
+    int w;
+    int h;
+    int channels;
+};
+
+void permute_hc_task::execute(int q) const
+{
+    float* outptr = top_blob.channel(q);
+
+    for (int i = 0; i < h; i++)
+    {
+        for (int j = 0; j < channels; j++)
+        {
+            const float* ptr = bottom_blob.channel(j);
+
+            outptr[i*channels + j] = ptr[i*w + q];
+        }
+    }
+}
+
+} // namespace
+
+int Permute::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     int w = bottom_blob.w;
     int h = bottom_blob.h;
@@ -51,115 +212,84 @@ int Permute::forward(const Mat& bottom_blob, Mat& top_blob) const
     }
     else if (order_type == 1)
     {
-        top_blob.create(h, w, channels);
+        top_blob.create(h, w, channels, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_blob.channel(q);
-            float* outptr = top_blob.channel(q);
-
-            for (int i = 0; i < w; i++)
-            {
-                for (int j = 0; j < h; j++)
-                {
-                    outptr[i*h + j] = ptr[j*w + i];
-                }
-            }
-        }
+        permute_wh_task task(bottom_blob, top_blob, w, h);
+
+        parallel_for(task, channels, opt);
     }
     else if (order_type == 2)
     {
-        top_blob.create(w, channels, h);
+        top_blob.create(w, channels, h, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<h; q++)
-        {
-            float* outptr = top_blob.channel(q);
-
-            for (int i = 0; i < channels; i++)
-            {
-                const float* ptr = bottom_blob.channel(i).row(q);
+        permute_cw_task task(top_blob, bottom_blob, w, channels);
 
-                for (int j = 0; j < w; j++)
-                {
-                    outptr[i*w + j] = ptr[j];
-                }
-            }
-        }
+        parallel_for(task, h, opt);
     }
     else if (order_type == 3)
     {
-        top_blob.create(channels, w, h);
+        top_blob.create(channels, w, h, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<h; q++)
-        {
-            float* outptr = top_blob.channel(q);
-
-            for (int i = 0; i < w; i++)
-            {
-                for (int j = 0; j < channels; j++)
-                {
-                    const float* ptr = bottom_blob.channel(j).row(q);
+        permute_wc_task task(top_blob, bottom_blob, w, channels);
 
-                    outptr[i*channels + j] = ptr[i];
-                }
-            }
-        }
+        parallel_for(task, h, opt);
     }
     else if (order_type == 4)
     {
-        top_blob.create(h, channels, w);
+        top_blob.create(h, channels, w, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<w; q++)
-        {
-            float* outptr = top_blob.channel(q);
-
-            for (int i = 0; i < channels; i++)
-            {
-                const float* ptr = bottom_blob.channel(i);
+        permute_ch_task task(top_blob, bottom_blob, w, h, channels);
 
-                for (int j = 0; j < h; j++)
-                {
-                    outptr[i*channels + j] = ptr[j*w + q];
-                }
-            }
-        }
+        parallel_for(task, w, opt);
     }
     else if (order_type == 5)
     {
-        top_blob.create(channels, h, w);
+        top_blob.create(channels, h, w, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<w; q++)
-        {
-            float* outptr = top_blob.channel(q);
-
-            for (int i = 0; i < h; i++)
-            {
-                for (int j = 0; j < channels; j++)
-                {
-                    const float* ptr = bottom_blob.channel(j);
+        permute_hc_task task(top_blob, bottom_blob, w, h, channels);
 
-                    outptr[i*channels + j] = ptr[i*w + q];
-                }
-            }
-        }
+        parallel_for(task, w, opt);
     }
 
     return 0;
 }
 
+int Permute::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    const Mat& bottom_shape = _bottom_shapes[0];
+    if (bottom_shape.dims != 3)
+        return -1;
+
+    int w = bottom_shape.w;
+    int h = bottom_shape.h;
+    int channels = bottom_shape.c;
+
+    if (order_type == 0)
+        _top_shapes[0] = Mat(w, h, channels, (void*)0);
+    else if (order_type == 1)
+        _top_shapes[0] = Mat(h, w, channels, (void*)0);
+    else if (order_type == 2)
+        _top_shapes[0] = Mat(w, channels, h, (void*)0);
+    else if (order_type == 3)
+        _top_shapes[0] = Mat(channels, w, h, (void*)0);
+    else if (order_type == 4)
+        _top_shapes[0] = Mat(h, channels, w, (void*)0);
+    else if (order_type == 5)
+        _top_shapes[0] = Mat(channels, h, w, (void*)0);
+    else
+        return -1;
+
+    return 0;
+}
+
 } // namespace ncnn
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "pooling.h"
+#include "threadpool.h"
 #include <algorithm>
 
 namespace ncnn {
@@ -40,7 +41,189 @@ int Pooling::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Pooling::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one channel
+struct pooling_global_max_task : public ParallelTask
+{
+    pooling_global_max_task(const Mat& _bottom_blob, Mat& _top_blob, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int size;
+};
+
+void pooling_global_max_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    float max = ptr[0];
+    for (int i=0; i<size; i++)
+    {
+        max = std::max(max, ptr[i]);
+    }
+
+    outptr[0] = max;
+}
+
+// one channel
+struct pooling_global_ave_task : public ParallelTask
+{
+    pooling_global_ave_task(const Mat& _bottom_blob, Mat& _top_blob, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int size;
+};
+
+void pooling_global_ave_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    float sum = 0.f;
+    for (int i=0; i<size; i++)
+    {
+        sum += ptr[i];
+    }
+
+    outptr[0] = sum / size;
+}
+
+// one channel
+struct pooling_max_task : public ParallelTask
+{
+    pooling_max_task(Mat& _top_blob, Mat& _bottom_blob_bordered, int _outw, int _outh, int _maxk, int* _space_ofs, int _stride_w, int _stride_h)
+        : top_blob(_top_blob), bottom_blob_bordered(_bottom_blob_bordered), outw(_outw), outh(_outh), maxk(_maxk), space_ofs(_space_ofs), stride_w(_stride_w), stride_h(_stride_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    Mat& bottom_blob_bordered;
+    int outw;
+    int outh;
+    int maxk;
+    int* space_ofs;
+    int stride_w;
+    int stride_h;
+};
+
+void pooling_max_task::execute(int q) const
+{
+    const Mat m = bottom_blob_bordered.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i = 0; i < outh; i++)
+    {
+        for (int j = 0; j < outw; j++)
+        {
+            const float* sptr = m.row(i*stride_h) + j*stride_w;
+
+            float max = sptr[0];
+
+            for (int k = 0; k < maxk; k++)
+            {
+                float val = sptr[ space_ofs[k] ];
+                max = std::max(max, val);
+            }
+
+            outptr[j] = max;
+        }
+
+        outptr += outw;
+    }
+}
+
+// one channel
+struct pooling_ave_task : public ParallelTask
+{
+    pooling_ave_task(Mat& _top_blob, Mat& _bottom_blob_bordered, int _outw, int _outh, int _wtail, int _htail, int _maxk, int* _space_ofs, int _kernel_w, int _kernel_h, int _stride_w, int _stride_h)
+        : top_blob(_top_blob), bottom_blob_bordered(_bottom_blob_bordered), outw(_outw), outh(_outh), wtail(_wtail), htail(_htail), maxk(_maxk), space_ofs(_space_ofs), kernel_w(_kernel_w), kernel_h(_kernel_h), stride_w(_stride_w), stride_h(_stride_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& top_blob;
+    Mat& bottom_blob_bordered;
+    int outw;
+    int outh;
+    int wtail;
+    int htail;
+    int maxk;
+    int* space_ofs;
+    int kernel_w;
+    int kernel_h;
+    int stride_w;
+    int stride_h;
+};
+
+void pooling_ave_task::execute(int q) const
+{
+    const Mat m = bottom_blob_bordered.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i = 0; i < outh; i++)
+    {
+        for (int j = 0; j < outw; j++)
+        {
+            const float* sptr = m.row(i*stride_h) + j*stride_w;
+
+            float sum = 0;
+
+            for (int k = 0; k < maxk; k++)
+            {
+                float val = sptr[ space_ofs[k] ];
+                sum += val;
+            }
+
+            outptr[j] = sum / maxk;
+        }
+
+        outptr += outw;
+    }
+
+    // fix tail pad
+    if (wtail != 0)
+    {
+        const float scale = (float)kernel_w / (kernel_w - wtail);
+
+        outptr = top_blob.channel(q);
+        outptr += outw - 1;
+        for (int i = 0; i < outh; i++)
+        {
+            *outptr *= scale;
+            outptr += outw;
+        }
+    }
+    if (htail != 0)
+    {
+        const float scale = (float)kernel_h / (kernel_h - htail);
+
+        outptr = top_blob.channel(q).row(outh - 1);
+        for (int i = 0; i < outw; i++)
+        {
+            outptr[i] *= scale;
+        }
+    }
+}
+
+} // namespace
+
+int Pooling::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     // max value in NxN window
     // avg value in NxN window
@@ -52,7 +235,7 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob) const
 //     fprintf(stderr, "Pooling     input %d x %d  pad = %d %d  ksize=%d %d  stride=%d %d\n", w, h, pad_w, pad_h, kernel_w, kernel_h, stride_w, stride_h);
     if (global_pooling)
     {
-        top_blob.create(1, 1, channels);
+        top_blob.create(1, 1, channels, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
@@ -60,37 +243,15 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob) const
 
         if (pooling_type == PoolMethod_MAX)
         {
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob.channel(q);
-                float* outptr = top_blob.channel(q);
-
-                float max = ptr[0];
-                for (int i=0; i<size; i++)
-                {
-                    max = std::max(max, ptr[i]);
-                }
+            pooling_global_max_task task(bottom_blob, top_blob, size);
 
-                outptr[0] = max;
-            }
+            parallel_for(task, channels, opt);
         }
         else if (pooling_type == PoolMethod_AVE)
         {
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const float* ptr = bottom_blob.channel(q);
-                float* outptr = top_blob.channel(q);
+            pooling_global_ave_task task(bottom_blob, top_blob, size);
 
-                float sum = 0.f;
-                for (int i=0; i<size; i++)
-                {
-                    sum += ptr[i];
-                }
-
-                outptr[0] = sum / size;
-            }
+            parallel_for(task, channels, opt);
         }
 
         return 0;
@@ -99,7 +260,7 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob) const
     Mat bottom_blob_bordered = bottom_blob;
     if (pad_w > 0 || pad_h > 0)
     {
-        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f);
+        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
         if (bottom_blob_bordered.empty())
             return -100;
 
@@ -112,7 +273,7 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob) const
         int hpad = kernel_h + (h - 1) / stride_h * stride_h - h;
         if (wpad > 0 || hpad > 0)
         {
-            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f);
+            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
             if (bottom_blob_bordered.empty())
                 return -100;
         }
@@ -143,11 +304,11 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob) const
         Mat bottom_blob_bordered2;
         if (pooling_type == PoolMethod_MAX)
         {
-            copy_make_border(bottom_blob_bordered, bottom_blob_bordered2, 0, htailpad, 0, wtailpad, BORDER_REPLICATE, 0.f);
+            copy_make_border(bottom_blob_bordered, bottom_blob_bordered2, 0, htailpad, 0, wtailpad, BORDER_REPLICATE, 0.f, opt.workspace_allocator);
         }
         else if (pooling_type == PoolMethod_AVE)
         {
-            copy_make_border(bottom_blob_bordered, bottom_blob_bordered2, 0, htailpad, 0, wtailpad, BORDER_CONSTANT, 0.f);
+            copy_make_border(bottom_blob_bordered, bottom_blob_bordered2, 0, htailpad, 0, wtailpad, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
         }
         if (bottom_blob_bordered2.empty())
             return -100;
@@ -163,7 +324,7 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob) const
             outh += 1;
     }
 
-    top_blob.create(outw, outh, channels);
+    top_blob.create(outw, outh, channels, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -190,87 +351,65 @@ int Pooling::forward(const Mat& bottom_blob, Mat& top_blob) const
 
     if (pooling_type == PoolMethod_MAX)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const Mat m = bottom_blob_bordered.channel(q);
-            float* outptr = top_blob.channel(q);
-
-            for (int i = 0; i < outh; i++)
-            {
-                for (int j = 0; j < outw; j++)
-                {
-                    const float* sptr = m.row(i*stride_h) + j*stride_w;
-
-                    float max = sptr[0];
+        pooling_max_task task(top_blob, bottom_blob_bordered, outw, outh, maxk, space_ofs, stride_w, stride_h);
 
-                    for (int k = 0; k < maxk; k++)
-                    {
-                        float val = sptr[ space_ofs[k] ];
-                        max = std::max(max, val);
-                    }
-
-                    outptr[j] = max;
-                }
-
-                outptr += outw;
-            }
-        }
+        parallel_for(task, channels, opt);
     }
     else if (pooling_type == PoolMethod_AVE)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const Mat m = bottom_blob_bordered.channel(q);
-            float* outptr = top_blob.channel(q);
-
-            for (int i = 0; i < outh; i++)
-            {
-                for (int j = 0; j < outw; j++)
-                {
-                    const float* sptr = m.row(i*stride_h) + j*stride_w;
+        pooling_ave_task task(top_blob, bottom_blob_bordered, outw, outh, wtail, htail, maxk, space_ofs, kernel_w, kernel_h, stride_w, stride_h);
 
-                    float sum = 0;
+        parallel_for(task, channels, opt);
+    }
 
-                    for (int k = 0; k < maxk; k++)
-                    {
-                        float val = sptr[ space_ofs[k] ];
-                        sum += val;
-                    }
+    return 0;
+}
 
-                    outptr[j] = sum / maxk;
-                }
+int Pooling::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    const Mat& bottom_shape = _bottom_shapes[0];
+    if (bottom_shape.dims != 3)
+        return -1;
 
-                outptr += outw;
-            }
+    int w = bottom_shape.w;
+    int h = bottom_shape.h;
+    int channels = bottom_shape.c;
 
-            // fix tail pad
-            if (wtail != 0)
-            {
-                const float scale = (float)kernel_w / (kernel_w - wtail);
-
-                outptr = top_blob.channel(q);
-                outptr += outw - 1;
-                for (int i = 0; i < outh; i++)
-                {
-                    *outptr *= scale;
-                    outptr += outw;
-                }
-            }
-            if (htail != 0)
-            {
-                const float scale = (float)kernel_h / (kernel_h - htail);
+    if (global_pooling)
+    {
+        _top_shapes[0] = Mat(1, 1, channels, (void*)0);
+        return 0;
+    }
 
-                outptr = top_blob.channel(q).row(outh - 1);
-                for (int i = 0; i < outw; i++)
-                {
-                    outptr[i] *= scale;
-                }
-            }
+    if (pad_w > 0 || pad_h > 0)
+    {
+        w += pad_w * 2;
+        h += pad_h * 2;
+    }
+    else if (pad_mode == 2) // tensorflow padding=SAME
+    {
+        int wpad = kernel_w + (w - 1) / stride_w * stride_w - w;
+        int hpad = kernel_h + (h - 1) / stride_h * stride_h - h;
+        if (wpad > 0 || hpad > 0)
+        {
+            w += wpad;
+            h += hpad;
         }
     }
 
+    int outw = (w - kernel_w) / stride_w + 1;
+    int outh = (h - kernel_h) / stride_h + 1;
+
+    if (pad_mode == 0) // full padding
+    {
+        if ((w - kernel_w) % stride_w != 0)
+            outw += 1;
+        if ((h - kernel_h) % stride_h != 0)
+            outh += 1;
+    }
+
+    _top_shapes[0] = Mat(outw, outh, channels, (void*)0);
+
     return 0;
 }
 
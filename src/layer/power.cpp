@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "power.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -34,23 +35,47 @@ int Power::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Power::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct power_task : public ParallelTask
+{
+    power_task(Mat& _bottom_top_blob, int _size, float _power, float _scale, float _shift)
+        : bottom_top_blob(_bottom_top_blob), size(_size), power(_power), scale(_scale), shift(_shift)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float power;
+    float scale;
+    float shift;
+};
+
+void power_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = pow((shift + ptr[i] * scale), power);
+    }
+}
+
+} // namespace
+
+int Power::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
     int channels = bottom_top_blob.c;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
+    power_task task(bottom_top_blob, size, power, scale, shift);
 
-        for (int i=0; i<size; i++)
-        {
-            ptr[i] = pow((shift + ptr[i] * scale), power);
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
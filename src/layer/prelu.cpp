@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "prelu.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -40,7 +41,107 @@ int PReLU::load_model(const ModelBin& mb)
     return 0;
 }
 
-int PReLU::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one element
+struct prelu_1d_task : public ParallelTask
+{
+    prelu_1d_task(const Mat& _slope_data, float* _ptr)
+        : slope_data(_slope_data), ptr(_ptr)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    const Mat& slope_data;
+    float* ptr;
+};
+
+void prelu_1d_task::execute(int i) const
+{
+    if (ptr[i] < 0)
+        ptr[i] *= slope_data[i];
+}
+
+// one element
+struct prelu_1d_shared_task : public ParallelTask
+{
+    prelu_1d_shared_task(float* _ptr, float _slope)
+        : ptr(_ptr), slope(_slope)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    float* ptr;
+    float slope;
+};
+
+void prelu_1d_shared_task::execute(int i) const
+{
+    if (ptr[i] < 0)
+        ptr[i] *= slope;
+}
+
+// one row
+struct prelu_rows_task : public ParallelTask
+{
+    prelu_rows_task(Mat& _bottom_top_blob, const Mat& _slope_data, int _w, int _num_slope)
+        : bottom_top_blob(_bottom_top_blob), slope_data(_slope_data), w(_w), num_slope(_num_slope)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    Mat& bottom_top_blob;
+    const Mat& slope_data;
+    int w;
+    int num_slope;
+};
+
+void prelu_rows_task::execute(int i) const
+{
+    float* ptr = bottom_top_blob.row(i);
+    float slope = num_slope > 1 ? slope_data[i] : slope_data[0];
+
+    for (int j=0; j<w; j++)
+    {
+        if (ptr[j] < 0)
+            ptr[j] *= slope;
+    }
+}
+
+// one channel
+struct prelu_task : public ParallelTask
+{
+    prelu_task(Mat& _bottom_top_blob, const Mat& _slope_data, int _size, int _num_slope)
+        : bottom_top_blob(_bottom_top_blob), slope_data(_slope_data), size(_size), num_slope(_num_slope)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& slope_data;
+    int size;
+    int num_slope;
+};
+
+void prelu_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+    float slope = num_slope > 1 ? slope_data[q] : slope_data[0];
+
+    for (int i=0; i<size; i++)
+    {
+        if (ptr[i] < 0)
+            ptr[i] *= slope;
+    }
+}
+
+} // namespace
+
+int PReLU::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int dims = bottom_top_blob.dims;
 
@@ -52,23 +153,17 @@ int PReLU::forward_inplace(Mat& bottom_top_blob) const
 
         if (num_slope > 1)
         {
-            #pragma omp parallel for
-            for (int i=0; i<w; i++)
-            {
-                if (ptr[i] < 0)
-                    ptr[i] *= slope_data[i];
-            }
+            prelu_1d_task task(slope_data, ptr);
+
+            parallel_for(task, w, opt);
         }
         else
         {
             float slope = slope_data[0];
 
-            #pragma omp parallel for
-            for (int i=0; i<w; i++)
-            {
-                if (ptr[i] < 0)
-                    ptr[i] *= slope;
-            }
+            prelu_1d_shared_task task(ptr, slope);
+
+            parallel_for(task, w, opt);
         }
     }
 
@@ -77,18 +172,9 @@ int PReLU::forward_inplace(Mat& bottom_top_blob) const
         int w = bottom_top_blob.w;
         int h = bottom_top_blob.h;
 
-        #pragma omp parallel for
-        for (int i=0; i<h; i++)
-        {
-            float* ptr = bottom_top_blob.row(i);
-            float slope = num_slope > 1 ? slope_data[i] : slope_data[0];
-
-            for (int j=0; j<w; j++)
-            {
-                if (ptr[j] < 0)
-                    ptr[j] *= slope;
-            }
-        }
+        prelu_rows_task task(bottom_top_blob, slope_data, w, num_slope);
+
+        parallel_for(task, h, opt);
     }
 
     if (dims == 3)
@@ -98,18 +184,9 @@ int PReLU::forward_inplace(Mat& bottom_top_blob) const
         int channels = bottom_top_blob.c;
         int size = w * h;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-            float slope = num_slope > 1 ? slope_data[q] : slope_data[0];
-
-            for (int i=0; i<size; i++)
-            {
-                if (ptr[i] < 0)
-                    ptr[i] *= slope;
-            }
-        }
+        prelu_task task(bottom_top_blob, slope_data, size, num_slope);
+
+        parallel_for(task, channels, opt);
     }
 
     return 0;
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "priorbox.h"
+#include "threadpool.h"
 #include <algorithm>
 #include <math.h>
 
@@ -46,55 +47,67 @@ int PriorBox::load_param(const ParamDict& pd)
     return 0;
 }
 
-int PriorBox::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
-{
-    int w = bottom_blobs[0].w;
-    int h = bottom_blobs[0].h;
+namespace {
 
-    int image_w = image_width;
-    int image_h = image_height;
-    if (image_w == -233)
-        image_w = bottom_blobs[1].w;
-    if (image_h == -233)
-        image_h = bottom_blobs[1].h;
+// one row of the feature map
+struct priorbox_task : public ParallelTask
+{
+    priorbox_task(Mat& _top_blob, const Mat& _min_sizes, const Mat& _max_sizes, const Mat& _aspect_ratios, int _w, int _image_w, int _image_h, float _step_w, float _step_h, int _num_min_size, int _num_max_size, int _num_aspect_ratio, int _num_prior, int _flip, float _offset)
+        : top_blob(_top_blob), min_sizes(_min_sizes), max_sizes(_max_sizes), aspect_ratios(_aspect_ratios), w(_w), image_w(_image_w), image_h(_image_h), step_w(_step_w), step_h(_step_h), num_min_size(_num_min_size), num_max_size(_num_max_size), num_aspect_ratio(_num_aspect_ratio), num_prior(_num_prior), flip(_flip), offset(_offset)
+    {
+    }
 
-    float step_w = step_width;
-    float step_h = step_height;
-    if (step_w == -233)
-        step_w = (float)image_w / w;
-    if (step_h == -233)
-        step_h = (float)image_h / h;
+    virtual void execute(int i) const;
+
+    Mat& top_blob;
+    const Mat& min_sizes;
+    const Mat& max_sizes;
+    const Mat& aspect_ratios;
+    int w;
+    int image_w;
+    int image_h;
+    float step_w;
+    float step_h;
+    int num_min_size;
+    int num_max_size;
+    int num_aspect_ratio;
+    int num_prior;
+    int flip;
+    float offset;
+};
+
+void priorbox_task::execute(int i) const
+{
+    float* box = (float*)top_blob + i * w * num_prior * 4;
 
-    int num_min_size = min_sizes.w;
-    int num_max_size = max_sizes.w;
-    int num_aspect_ratio = aspect_ratios.w;
+    float center_x = offset * step_w;
+    float center_y = offset * step_h + i * step_h;
 
-    int num_prior = num_min_size * num_aspect_ratio + num_min_size + num_max_size;
-    if (flip)
-        num_prior += num_min_size * num_aspect_ratio;
+    for (int j = 0; j < w; j++)
+    {
+        float box_w;
+        float box_h;
 
-    Mat& top_blob = top_blobs[0];
-    top_blob.create(4 * w * h * num_prior, 2);
+        for (int k = 0; k < num_min_size; k++)
+        {
+            float min_size = min_sizes[k];
 
-    #pragma omp parallel for
-    for (int i = 0; i < h; i++)
-    {
-        float* box = (float*)top_blob + i * w * num_prior * 4;
+            // min size box
+            box_w = box_h = min_size;
 
-        float center_x = offset * step_w;
-        float center_y = offset * step_h + i * step_h;
+            box[0] = (center_x - box_w * 0.5f) / image_w;
+            box[1] = (center_y - box_h * 0.5f) / image_h;
+            box[2] = (center_x + box_w * 0.5f) / image_w;
+            box[3] = (center_y + box_h * 0.5f) / image_h;
 
-        for (int j = 0; j < w; j++)
-        {
-            float box_w;
-            float box_h;
+            box += 4;
 
-            for (int k = 0; k < num_min_size; k++)
+            if (num_max_size > 0)
             {
-                float min_size = min_sizes[k];
+                float max_size = max_sizes[k];
 
-                // min size box
-                box_w = box_h = min_size;
+                // max size box
+                box_w = box_h = sqrt(min_size * max_size);
 
                 box[0] = (center_x - box_w * 0.5f) / image_w;
                 box[1] = (center_y - box_h * 0.5f) / image_h;
@@ -102,54 +115,76 @@ int PriorBox::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
                 box[3] = (center_y + box_h * 0.5f) / image_h;
 
                 box += 4;
+            }
 
-                if (num_max_size > 0)
-                {
-                    float max_size = max_sizes[k];
+            // all aspect_ratios
+            for (int p = 0; p < num_aspect_ratio; p++)
+            {
+                float ar = aspect_ratios[p];
+
+                box_w = min_size * sqrt(ar);
+                box_h = min_size / sqrt(ar);
 
-                    // max size box
-                    box_w = box_h = sqrt(min_size * max_size);
+                box[0] = (center_x - box_w * 0.5f) / image_w;
+                box[1] = (center_y - box_h * 0.5f) / image_h;
+                box[2] = (center_x + box_w * 0.5f) / image_w;
+                box[3] = (center_y + box_h * 0.5f) / image_h;
 
-                    box[0] = (center_x - box_w * 0.5f) / image_w;
-                    box[1] = (center_y - box_h * 0.5f) / image_h;
-                    box[2] = (center_x + box_w * 0.5f) / image_w;
-                    box[3] = (center_y + box_h * 0.5f) / image_h;
+                box += 4;
+
+                if (flip)
+                {
+                    box[0] = (center_x - box_h * 0.5f) / image_h;
+                    box[1] = (center_y - box_w * 0.5f) / image_w;
+                    box[2] = (center_x + box_h * 0.5f) / image_h;
+                    box[3] = (center_y + box_w * 0.5f) / image_w;
 
                     box += 4;
                 }
+            }
+        }
 
-                // all aspect_ratios
-                for (int p = 0; p < num_aspect_ratio; p++)
-                {
-                    float ar = aspect_ratios[p];
+        center_x += step_w;
+    }
 
-                    box_w = min_size * sqrt(ar);
-                    box_h = min_size / sqrt(ar);
+    center_y += step_h;
+}
 
-                    box[0] = (center_x - box_w * 0.5f) / image_w;
-                    box[1] = (center_y - box_h * 0.5f) / image_h;
-                    box[2] = (center_x + box_w * 0.5f) / image_w;
-                    box[3] = (center_y + box_h * 0.5f) / image_h;
+} // namespace
 
-                    box += 4;
+int PriorBox::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    int w = bottom_blobs[0].w;
+    int h = bottom_blobs[0].h;
 
-                    if (flip)
-                    {
-                        box[0] = (center_x - box_h * 0.5f) / image_h;
-                        box[1] = (center_y - box_w * 0.5f) / image_w;
-                        box[2] = (center_x + box_h * 0.5f) / image_h;
-                        box[3] = (center_y + box_w * 0.5f) / image_w;
+    int image_w = image_width;
+    int image_h = image_height;
+    if (image_w == -233)
+        image_w = bottom_blobs[1].w;
+    if (image_h == -233)
+        image_h = bottom_blobs[1].h;
 
-                        box += 4;
-                    }
-                }
-            }
+    float step_w = step_width;
+    float step_h = step_height;
+    if (step_w == -233)
+        step_w = (float)image_w / w;
+    if (step_h == -233)
+        step_h = (float)image_h / h;
 
-            center_x += step_w;
-        }
+    int num_min_size = min_sizes.w;
+    int num_max_size = max_sizes.w;
+    int num_aspect_ratio = aspect_ratios.w;
 
-        center_y += step_h;
-    }
+    int num_prior = num_min_size * num_aspect_ratio + num_min_size + num_max_size;
+    if (flip)
+        num_prior += num_min_size * num_aspect_ratio;
+
+    Mat& top_blob = top_blobs[0];
+    top_blob.create(4 * w * h * num_prior, 2, 4u, opt.blob_allocator);
+
+    priorbox_task task(top_blob, min_sizes, max_sizes, aspect_ratios, w, image_w, image_h, step_w, step_h, num_min_size, num_max_size, num_aspect_ratio, num_prior, flip, offset);
+
+    parallel_for(task, h, opt);
 
     if (clip)
     {
@@ -175,4 +210,22 @@ int PriorBox::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
     return 0;
 }
 
+int PriorBox::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    int w = _bottom_shapes[0].w;
+    int h = _bottom_shapes[0].h;
+
+    int num_min_size = min_sizes.w;
+    int num_max_size = max_sizes.w;
+    int num_aspect_ratio = aspect_ratios.w;
+
+    int num_prior = num_min_size * num_aspect_ratio + num_min_size + num_max_size;
+    if (flip)
+        num_prior += num_min_size * num_aspect_ratio;
+
+    _top_shapes[0] = Mat(4 * w * h * num_prior, 2, (void*)0);
+
+    return 0;
+}
+
 } // namespace ncnn
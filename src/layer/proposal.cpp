@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "proposal.h"
+#include "threadpool.h"
 #include <math.h>
 #include <algorithm>
 #include <vector>
@@ -195,99 +196,144 @@ static void nms_sorted_bboxes(const std::vector<Rect>& bboxes, std::vector<int>&
     }
 }
 
-int Proposal::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+namespace {
+
+// one anchor
+struct proposal_decode_task : public ParallelTask
 {
-    const Mat& score_blob = bottom_blobs[0];
-    const Mat& bbox_blob = bottom_blobs[1];
-    const Mat& im_info_blob = bottom_blobs[2];
+    proposal_decode_task(const Mat& _bbox_blob, Mat& _proposals, const Mat& _anchors, int _w, int _h, int _feat_stride)
+        : bbox_blob(_bbox_blob), proposals(_proposals), anchors(_anchors), w(_w), h(_h), feat_stride(_feat_stride)
+    {
+    }
 
-    int w = score_blob.w;
-    int h = score_blob.h;
+    virtual void execute(int q) const;
 
-    // generate proposals from bbox deltas and shifted anchors
-    const int num_anchors = anchors.h;
+    const Mat& bbox_blob;
+    Mat& proposals;
+    const Mat& anchors;
+    int w;
+    int h;
+    int feat_stride;
+};
 
-    Mat proposals;
-    proposals.create(4, w * h, num_anchors);
+void proposal_decode_task::execute(int q) const
+{
+    const float* bbox_xptr = bbox_blob.channel(q * 4);
+    const float* bbox_yptr = bbox_blob.channel(q * 4 + 1);
+    const float* bbox_wptr = bbox_blob.channel(q * 4 + 2);
+    const float* bbox_hptr = bbox_blob.channel(q * 4 + 3);
 
-    #pragma omp parallel for
-    for (int q=0; q<num_anchors; q++)
-    {
-        const float* bbox_xptr = bbox_blob.channel(q * 4);
-        const float* bbox_yptr = bbox_blob.channel(q * 4 + 1);
-        const float* bbox_wptr = bbox_blob.channel(q * 4 + 2);
-        const float* bbox_hptr = bbox_blob.channel(q * 4 + 3);
+    Mat pbs = proposals.channel(q);
 
-        Mat pbs = proposals.channel(q);
+    const float* anchor = anchors.row(q);
 
-        const float* anchor = anchors.row(q);
+    // shifted anchor
+    float anchor_y = anchor[1];
 
-        // shifted anchor
-        float anchor_y = anchor[1];
+    float anchor_w = anchor[2] - anchor[0];
+    float anchor_h = anchor[3] - anchor[1];
 
-        float anchor_w = anchor[2] - anchor[0];
-        float anchor_h = anchor[3] - anchor[1];
+    for (int i = 0; i < h; i++)
+    {
+        float anchor_x = anchor[0];
 
-        for (int i = 0; i < h; i++)
+        for (int j = 0; j < w; j++)
         {
-            float anchor_x = anchor[0];
+            float* pb = pbs.row(i*w + j);
 
-            for (int j = 0; j < w; j++)
-            {
-                float* pb = pbs.row(i*w + j);
+            // apply center size
+            float dx = bbox_xptr[j];
+            float dy = bbox_yptr[j];
+            float dw = bbox_wptr[j];
+            float dh = bbox_hptr[j];
 
-                // apply center size
-                float dx = bbox_xptr[j];
-                float dy = bbox_yptr[j];
-                float dw = bbox_wptr[j];
-                float dh = bbox_hptr[j];
+            float cx = anchor_x + anchor_w * 0.5f;
+            float cy = anchor_y + anchor_h * 0.5f;
 
-                float cx = anchor_x + anchor_w * 0.5f;
-                float cy = anchor_y + anchor_h * 0.5f;
+            float pb_cx = cx + anchor_w * dx;
+            float pb_cy = cy + anchor_h * dy;
 
-                float pb_cx = cx + anchor_w * dx;
-                float pb_cy = cy + anchor_h * dy;
+            float pb_w = anchor_w * exp(dw);
+            float pb_h = anchor_h * exp(dh);
 
-                float pb_w = anchor_w * exp(dw);
-                float pb_h = anchor_h * exp(dh);
+            pb[0] = pb_cx - pb_w * 0.5f;
+            pb[1] = pb_cy - pb_h * 0.5f;
+            pb[2] = pb_cx + pb_w * 0.5f;
+            pb[3] = pb_cy + pb_h * 0.5f;
 
-                pb[0] = pb_cx - pb_w * 0.5f;
-                pb[1] = pb_cy - pb_h * 0.5f;
-                pb[2] = pb_cx + pb_w * 0.5f;
-                pb[3] = pb_cy + pb_h * 0.5f;
+            anchor_x += feat_stride;
+        }
 
-                anchor_x += feat_stride;
-            }
+        bbox_xptr += w;
+        bbox_yptr += w;
+        bbox_wptr += w;
+        bbox_hptr += w;
 
-            bbox_xptr += w;
-            bbox_yptr += w;
-            bbox_wptr += w;
-            bbox_hptr += w;
+        anchor_y += feat_stride;
+    }
+}
 
-            anchor_y += feat_stride;
-        }
+// one anchor
+struct proposal_clip_task : public ParallelTask
+{
+    proposal_clip_task(Mat& _proposals, int _w, int _h, float _im_w, float _im_h)
+        : proposals(_proposals), w(_w), h(_h), im_w(_im_w), im_h(_im_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& proposals;
+    int w;
+    int h;
+    float im_w;
+    float im_h;
+};
+
+void proposal_clip_task::execute(int q) const
+{
+    Mat pbs = proposals.channel(q);
+
+    for (int i = 0; i < w * h; i++)
+    {
+        float* pb = pbs.row(i);
+
+        // clip box
+        pb[0] = std::max(std::min(pb[0], im_w - 1), 0.f);
+        pb[1] = std::max(std::min(pb[1], im_h - 1), 0.f);
+        pb[2] = std::max(std::min(pb[2], im_w - 1), 0.f);
+        pb[3] = std::max(std::min(pb[3], im_h - 1), 0.f);
     }
+}
+
+} // namespace
+
+int Proposal::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    const Mat& score_blob = bottom_blobs[0];
+    const Mat& bbox_blob = bottom_blobs[1];
+    const Mat& im_info_blob = bottom_blobs[2];
+
+    int w = score_blob.w;
+    int h = score_blob.h;
+
+    // generate proposals from bbox deltas and shifted anchors
+    const int num_anchors = anchors.h;
+
+    Mat proposals;
+    proposals.create(4, w * h, num_anchors, 4u, opt.workspace_allocator);
+
+    proposal_decode_task task(bbox_blob, proposals, anchors, w, h, feat_stride);
+
+    parallel_for(task, num_anchors, opt);
 
     // clip predicted boxes to image
     float im_w = im_info_blob[1];
     float im_h = im_info_blob[0];
 
-    #pragma omp parallel for
-    for (int q=0; q<num_anchors; q++)
-    {
-        Mat pbs = proposals.channel(q);
+    proposal_clip_task clip_task(proposals, w, h, im_w, im_h);
 
-        for (int i = 0; i < w * h; i++)
-        {
-            float* pb = pbs.row(i);
-
-            // clip box
-            pb[0] = std::max(std::min(pb[0], im_w - 1), 0.f);
-            pb[1] = std::max(std::min(pb[1], im_h - 1), 0.f);
-            pb[2] = std::max(std::min(pb[2], im_w - 1), 0.f);
-            pb[3] = std::max(std::min(pb[3], im_h - 1), 0.f);
-        }
-    }
+    parallel_for(clip_task, num_anchors, opt);
 
     // remove predicted boxes with either height or width < threshold
     std::vector<Rect> proposal_boxes;
@@ -336,7 +382,7 @@ int Proposal::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
 
     // return the top proposals
     Mat& roi_blob = top_blobs[0];
-    roi_blob.create(4, 1, picked_count);
+    roi_blob.create(4, 1, picked_count, 4u, opt.blob_allocator);
     if (roi_blob.empty())
         return -100;
 
@@ -353,7 +399,7 @@ int Proposal::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& to
     if (top_blobs.size() > 1)
     {
         Mat& roi_score_blob = top_blobs[1];
-        roi_score_blob.create(1, 1, picked_count);
+        roi_score_blob.create(1, 1, picked_count, 4u, opt.blob_allocator);
         if (roi_score_blob.empty())
             return -100;
 
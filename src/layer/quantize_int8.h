@@ -0,0 +1,175 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef LAYER_QUANTIZE_INT8_H
+#define LAYER_QUANTIZE_INT8_H
+
+#include <math.h>
+#include "mat.h"
+#include "fused_activation.h"
+#include "threadpool.h"
+
+namespace ncnn {
+
+// symmetric int8, round to nearest and saturate to [-127, 127]
+static inline signed char float2int8(float v)
+{
+    int int32 = (int)roundf(v);
+    if (int32 > 127) return 127;
+    if (int32 < -127) return -127;
+    return (signed char)int32;
+}
+
+namespace {
+
+// one channel
+struct quantize_int8_task : public ParallelTask
+{
+    quantize_int8_task(const Mat& _bottom_blob, Mat& _bottom_blob_int8, float _scale, int _size)
+        : bottom_blob(_bottom_blob), bottom_blob_int8(_bottom_blob_int8), scale(_scale), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& bottom_blob_int8;
+    float scale;
+    int size;
+};
+
+void quantize_int8_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    signed char* outptr = bottom_blob_int8.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = float2int8(ptr[i] * scale);
+    }
+}
+
+} // namespace
+
+// quantize the input of an int8 layer, blobs coming from a requantizing layer are int8 already
+static inline int quantize_int8(const Mat& bottom_blob, Mat& bottom_blob_int8, float scale, const Option& opt)
+{
+    if (bottom_blob.elemsize == 1u)
+    {
+        bottom_blob_int8 = bottom_blob;
+        return 0;
+    }
+
+    bottom_blob_int8.create(bottom_blob.w, bottom_blob.h, bottom_blob.c, 1u, opt.workspace_allocator);
+    if (bottom_blob_int8.empty())
+        return -100;
+
+    int size = bottom_blob.w * bottom_blob.h;
+
+    quantize_int8_task task(bottom_blob, bottom_blob_int8, scale, size);
+
+    parallel_for(task, bottom_blob.c, opt);
+
+    return 0;
+}
+
+// per output channel weight quantization, weight_data holds num_output rows of equal length
+// the model may store the weights as int8 already, the other side is dropped
+static inline int prepare_int8_weights(Mat& weight_data, Mat& weight_data_int8, const Mat& scales, int num_output, bool use_int8_inference)
+{
+    const int size = weight_data.w / num_output;
+
+    if (weight_data.elemsize == 1u)
+        weight_data_int8 = weight_data;
+    else
+        weight_data_int8.release();
+
+    if (use_int8_inference && weight_data_int8.empty())
+    {
+        weight_data_int8.create(weight_data.w, (size_t)1u);
+        if (weight_data_int8.empty())
+            return -100;
+
+        for (int p=0; p<num_output; p++)
+        {
+            const float* kptr = (const float*)weight_data + size * p;
+            signed char* outptr = (signed char*)weight_data_int8 + size * p;
+
+            const float scale = scales[p];
+
+            for (int i=0; i<size; i++)
+            {
+                outptr[i] = float2int8(kptr[i] * scale);
+            }
+        }
+    }
+
+    if (!use_int8_inference && weight_data.elemsize == 1u)
+    {
+        weight_data.create(weight_data_int8.w);
+        if (weight_data.empty())
+            return -100;
+
+        for (int p=0; p<num_output; p++)
+        {
+            const signed char* kptr = (const signed char*)weight_data_int8 + size * p;
+            float* outptr = (float*)weight_data + size * p;
+
+            const float scale = scales[p] == 0.f ? 0.f : 1.f / scales[p];
+
+            for (int i=0; i<size; i++)
+            {
+                outptr[i] = kptr[i] * scale;
+            }
+        }
+
+        weight_data_int8.release();
+    }
+
+    if (use_int8_inference)
+        weight_data.release();
+
+    return 0;
+}
+
+// the int32 sums carry both the input and the weight scale
+// an all zero weight channel comes with a zero scale
+static inline float dequantize_scale(float bottom_scale, float weight_scale)
+{
+    if (bottom_scale == 0.f || weight_scale == 0.f)
+        return 0.f;
+
+    return 1.f / (bottom_scale * weight_scale);
+}
+
+// turn the int32 sums of one output channel back into floats, or into the int8 input of the next layer
+static inline void dequantize_int32(const int* sums, float* outptr, int size, float dequant_scale, float bias, int activation_type, const Mat& activation_params)
+{
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = activation_ss(sums[i] * dequant_scale + bias, activation_type, activation_params);
+    }
+}
+
+static inline void requantize_int32(const int* sums, signed char* outptr, int size, float dequant_scale, float bias, int activation_type, const Mat& activation_params, float top_scale)
+{
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = float2int8(activation_ss(sums[i] * dequant_scale + bias, activation_type, activation_params) * top_scale);
+    }
+}
+
+} // namespace ncnn
+
+#endif // LAYER_QUANTIZE_INT8_H
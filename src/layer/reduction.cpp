@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "reduction.h"
+#include "threadpool.h"
 #include <float.h>
 #include <limits.h>
 #include <math.h>
@@ -38,8 +39,156 @@ int Reduction::load_param(const ParamDict& pd)
     return 0;
 }
 
+namespace {
+
+// one channel
+template<typename Op>
+struct reduction_all_task : public ParallelTask
+{
+    reduction_all_task(const Mat& _a, Mat& _sums, float _v0, int _size)
+        : a(_a), sums(_sums), v0(_v0), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    Mat& sums;
+    float v0;
+    int size;
+};
+
+template<typename Op>
+void reduction_all_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr = a.channel(q);
+
+    float sum = v0;
+    for (int i=0; i<size; i++)
+    {
+        sum = op(sum, ptr[i]);
+    }
+
+    sums[q] = sum;
+}
+
+// one channel
+template<typename Op>
+struct reduction_channels_task : public ParallelTask
+{
+    reduction_channels_task(const Mat& _a, Mat& _b, float _v0, float _coeff, int _size)
+        : a(_a), b(_b), v0(_v0), coeff(_coeff), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    Mat& b;
+    float v0;
+    float coeff;
+    int size;
+};
+
+template<typename Op>
+void reduction_channels_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr = a.channel(q);
+
+    float sum = v0;
+    for (int i=0; i<size; i++)
+    {
+        sum = op(sum, ptr[i]);
+    }
+
+    b[q] = sum * coeff;
+}
+
+// one channel
+template<typename Op>
+struct reduction_rows_task : public ParallelTask
+{
+    reduction_rows_task(const Mat& _a, Mat& _b, float _v0, float _coeff, int _w, int _h)
+        : a(_a), b(_b), v0(_v0), coeff(_coeff), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    Mat& b;
+    float v0;
+    float coeff;
+    int w;
+    int h;
+};
+
+template<typename Op>
+void reduction_rows_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr = a.channel(q);
+    float* outptr = b.channel(q);
+
+    for (int i=0; i<h; i++)
+    {
+        float sum = v0;
+        for (int j=0; j<w; j++)
+        {
+            sum = op(sum, ptr[i]);
+        }
+
+        outptr[i] = sum * coeff;
+
+        ptr += w;
+    }
+}
+
+// one channel
+template<typename Op>
+struct reduction_cols_task : public ParallelTask
+{
+    reduction_cols_task(const Mat& _a, Mat& _mins, int _w, int _h)
+        : a(_a), mins(_mins), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    Mat& mins;
+    int w;
+    int h;
+};
+
+template<typename Op>
+void reduction_cols_task<Op>::execute(int q) const
+{
+    Op op;
+
+    const float* ptr = a.channel(q);
+    float* mins_ptr = mins.channel(q);
+
+    for (int i=0; i<h; i++)
+    {
+        for (int j=0; j<w; j++)
+        {
+            mins_ptr[j] = op(mins_ptr[j], ptr[i]);
+        }
+
+        ptr += w;
+    }
+}
+
+} // namespace
+
 template<typename Op, typename Op2>
-static int reduction_op(const Mat& a, Mat& b, float v0, int dim, float coeff)
+static int reduction_op(const Mat& a, Mat& b, float v0, int dim, float coeff, const Option& opt)
 {
     Op op;
     Op2 op2;
@@ -52,27 +201,27 @@ static int reduction_op(const Mat& a, Mat& b, float v0, int dim, float coeff)
     if (dim == 0)
     {
         // w h c -> X X X
-        b.create(1);
+        b.create(1, 4u, opt.blob_allocator);
     }
     else if (dim == 1)
     {
         // w h c -> X X c
-        b.create(channels);
+        b.create(channels, 4u, opt.blob_allocator);
     }
     else if (dim == 2)
     {
         // w h c -> X h c
-        b.create(h, channels);
+        b.create(h, channels, 4u, opt.blob_allocator);
     }
     else if (dim == -1)
     {
         // w h c -> w X X
-        b.create(w);
+        b.create(w, 4u, opt.blob_allocator);
     }
     else if (dim == -2)
     {
         // w h c -> w h X
-        b.create(w, h);
+        b.create(w, h, 4u, opt.blob_allocator);
     }
     if (b.empty())
         return -100;
@@ -83,19 +232,9 @@ static int reduction_op(const Mat& a, Mat& b, float v0, int dim, float coeff)
         if (sums.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = a.channel(q);
-
-            float sum = v0;
-            for (int i=0; i<size; i++)
-            {
-                sum = op(sum, ptr[i]);
-            }
+        reduction_all_task<Op> task(a, sums, v0, size);
 
-            sums[q] = sum;
-        }
+        parallel_for(task, channels, opt);
 
         float sum = v0;
         for (int i=0; i<channels; i++)
@@ -107,41 +246,15 @@ static int reduction_op(const Mat& a, Mat& b, float v0, int dim, float coeff)
     }
     else if (dim == 1)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = a.channel(q);
-
-            float sum = v0;
-            for (int i=0; i<size; i++)
-            {
-                sum = op(sum, ptr[i]);
-            }
+        reduction_channels_task<Op> task(a, b, v0, coeff, size);
 
-            b[q] = sum * coeff;
-        }
+        parallel_for(task, channels, opt);
     }
     else if (dim == 2)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = a.channel(q);
-            float* outptr = b.channel(q);
+        reduction_rows_task<Op> task(a, b, v0, coeff, w, h);
 
-            for (int i=0; i<h; i++)
-            {
-                float sum = v0;
-                for (int j=0; j<w; j++)
-                {
-                    sum = op(sum, ptr[i]);
-                }
-
-                outptr[i] = sum * coeff;
-
-                ptr += w;
-            }
-        }
+        parallel_for(task, channels, opt);
     }
     else if (dim == -1)
     {
@@ -151,22 +264,9 @@ static int reduction_op(const Mat& a, Mat& b, float v0, int dim, float coeff)
 
         mins.fill(v0);
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = a.channel(q);
-            float* mins_ptr = mins.channel(q);
+        reduction_cols_task<Op> task(a, mins, w, h);
 
-            for (int i=0; i<h; i++)
-            {
-                for (int j=0; j<w; j++)
-                {
-                    mins_ptr[j] = op(mins_ptr[j], ptr[i]);
-                }
-
-                ptr += w;
-            }
-        }
+        parallel_for(task, channels, opt);
 
         b.fill(v0);
 
@@ -227,20 +327,20 @@ struct reduction_op_min : std::binary_function<T,T,T> {
     T operator() (const T& x, const T& y) const { return std::min(x, y); }
 };
 
-int Reduction::forward(const Mat& bottom_blob, Mat& top_blob) const
+int Reduction::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     if (operation == ReductionOp_SUM)
-        return reduction_op< std::plus<float>, std::plus<float> >(bottom_blob, top_blob, 0.f, dim, coeff);
+        return reduction_op< std::plus<float>, std::plus<float> >(bottom_blob, top_blob, 0.f, dim, coeff, opt);
 
     if (operation == ReductionOp_ASUM)
-        return reduction_op< reduction_op_asum<float>, std::plus<float> >(bottom_blob, top_blob, 0.f, dim, coeff);
+        return reduction_op< reduction_op_asum<float>, std::plus<float> >(bottom_blob, top_blob, 0.f, dim, coeff, opt);
 
     if (operation == ReductionOp_SUMSQ)
-        return reduction_op< reduction_op_sumsq<float>, std::plus<float> >(bottom_blob, top_blob, 0.f, dim, coeff);
+        return reduction_op< reduction_op_sumsq<float>, std::plus<float> >(bottom_blob, top_blob, 0.f, dim, coeff, opt);
 
     if (operation == ReductionOp_MEAN)
     {
-        int ret = reduction_op< std::plus<float>, std::plus<float> >(bottom_blob, top_blob, 0.f, dim, coeff);
+        int ret = reduction_op< std::plus<float>, std::plus<float> >(bottom_blob, top_blob, 0.f, dim, coeff, opt);
         if (ret != 0)
             return -100;
 
@@ -289,13 +389,13 @@ int Reduction::forward(const Mat& bottom_blob, Mat& top_blob) const
     }
 
     if (operation == ReductionOp_MAX)
-        return reduction_op< reduction_op_max<float>, reduction_op_max<float> >(bottom_blob, top_blob, -FLT_MAX, dim, coeff);
+        return reduction_op< reduction_op_max<float>, reduction_op_max<float> >(bottom_blob, top_blob, -FLT_MAX, dim, coeff, opt);
 
     if (operation == ReductionOp_MIN)
-        return reduction_op< reduction_op_min<float>, reduction_op_min<float> >(bottom_blob, top_blob, FLT_MAX, dim, coeff);
+        return reduction_op< reduction_op_min<float>, reduction_op_min<float> >(bottom_blob, top_blob, FLT_MAX, dim, coeff, opt);
 
     if (operation == ReductionOp_PROD)
-        return reduction_op< std::multiplies<float>, std::multiplies<float> >(bottom_blob, top_blob, 1.f, dim, coeff);
+        return reduction_op< std::multiplies<float>, std::multiplies<float> >(bottom_blob, top_blob, 1.f, dim, coeff, opt);
 
     return 0;
 }
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "relu.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -31,7 +32,62 @@ int ReLU::load_param(const ParamDict& pd)
     return 0;
 }
 
-int ReLU::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct relu_task : public ParallelTask
+{
+    relu_task(Mat& _bottom_top_blob, int _size)
+        : bottom_top_blob(_bottom_top_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+};
+
+void relu_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        if (ptr[i] < 0)
+            ptr[i] = 0;
+    }
+}
+
+// one channel
+struct leaky_relu_task : public ParallelTask
+{
+    leaky_relu_task(Mat& _bottom_top_blob, int _size, float _slope)
+        : bottom_top_blob(_bottom_top_blob), size(_size), slope(_slope)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float slope;
+};
+
+void leaky_relu_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        if (ptr[i] < 0)
+            ptr[i] *= slope;
+    }
+}
+
+} // namespace
+
+int ReLU::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
@@ -40,31 +96,15 @@ int ReLU::forward_inplace(Mat& bottom_top_blob) const
 
     if (slope == 0.f)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-
-            for (int i=0; i<size; i++)
-            {
-                if (ptr[i] < 0)
-                    ptr[i] = 0;
-            }
-        }
+        relu_task task(bottom_top_blob, size);
+
+        parallel_for(task, channels, opt);
     }
     else
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-
-            for (int i=0; i<size; i++)
-            {
-                if (ptr[i] < 0)
-                    ptr[i] *= slope;
-            }
-        }
+        leaky_relu_task task(bottom_top_blob, size, slope);
+
+        parallel_for(task, channels, opt);
     }
 
     return 0;
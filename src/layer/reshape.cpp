@@ -42,7 +42,7 @@ int Reshape::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Reshape::forward(const Mat& bottom_blob, Mat& top_blob) const
+int Reshape::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     int total = bottom_blob.w * bottom_blob.h * bottom_blob.c;
 
@@ -58,7 +58,7 @@ int Reshape::forward(const Mat& bottom_blob, Mat& top_blob) const
 
         if (permute == 1)
         {
-            top_blob.create(_w);
+            top_blob.create(_w, 4u, opt.blob_allocator);
             if (top_blob.empty())
                 return -100;
 
@@ -78,7 +78,7 @@ int Reshape::forward(const Mat& bottom_blob, Mat& top_blob) const
         }
         else
         {
-            top_blob = bottom_blob.reshape(_w);
+            top_blob = bottom_blob.reshape(_w, opt.blob_allocator);
         }
     }
     else if (ndim == 2)
@@ -96,7 +96,7 @@ int Reshape::forward(const Mat& bottom_blob, Mat& top_blob) const
         if (_h == -1)
             _h = total / _w;
 
-        top_blob = bottom_blob.reshape(_w, _h);
+        top_blob = bottom_blob.reshape(_w, _h, opt.blob_allocator);
     }
     else if (ndim == 3)
     {
@@ -118,7 +118,7 @@ int Reshape::forward(const Mat& bottom_blob, Mat& top_blob) const
         if (_c == -1)
             _c = total / _h / _w;
 
-        top_blob = bottom_blob.reshape(_w, _h, _c);
+        top_blob = bottom_blob.reshape(_w, _h, _c, opt.blob_allocator);
     }
 
     if (top_blob.empty())
@@ -127,4 +127,49 @@ int Reshape::forward(const Mat& bottom_blob, Mat& top_blob) const
     return 0;
 }
 
+int Reshape::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    const Mat& bottom_shape = _bottom_shapes[0];
+
+    int total = bottom_shape.w * bottom_shape.h * bottom_shape.c;
+
+    int _w = w == 0 ? bottom_shape.w : w;
+    int _h = h == 0 ? bottom_shape.h : h;
+    int _c = c == 0 ? bottom_shape.c : c;
+
+    if (ndim == 1)
+    {
+        if (_w == -1)
+            _w = total;
+
+        _top_shapes[0] = Mat(_w, (void*)0);
+    }
+    else if (ndim == 2)
+    {
+        if (_w == -1)
+            _w = total / _h;
+        if (_h == -1)
+            _h = total / _w;
+
+        _top_shapes[0] = Mat(_w, _h, (void*)0);
+    }
+    else if (ndim == 3)
+    {
+        if (_w == -1)
+            _w = total / _c / _h;
+        if (_h == -1)
+            _h = total / _c / _w;
+        if (_c == -1)
+            _c = total / _h / _w;
+
+        _top_shapes[0] = Mat(_w, _h, _c, (void*)0);
+    }
+    else
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
 } // namespace ncnn
@@ -61,7 +61,7 @@ int RNN::load_model(const ModelBin& mb)
     return 0;
 }
 
-int RNN::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+int RNN::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     // size x 1 x T
     const Mat& input_blob = bottom_blobs[0];
@@ -79,7 +79,7 @@ int RNN::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blo
     hidden.fill(0.f);
 
     Mat& top_blob = top_blobs[0];
-    top_blob.create(num_output, 1, T);
+    top_blob.create(num_output, 1, T, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
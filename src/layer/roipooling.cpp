@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "roipooling.h"
+#include "threadpool.h"
 #include <math.h>
 #include <algorithm>
 
@@ -33,7 +34,75 @@ int ROIPooling::load_param(const ParamDict& pd)
     return 0;
 }
 
-int ROIPooling::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+namespace {
+
+// one channel
+struct roipooling_task : public ParallelTask
+{
+    roipooling_task(const Mat& _bottom_blob, Mat& _top_blob, int _w, int _h, int _roi_x1, int _roi_y1, float _bin_size_w, float _bin_size_h, int _pooled_width, int _pooled_height)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), w(_w), h(_h), roi_x1(_roi_x1), roi_y1(_roi_y1), bin_size_w(_bin_size_w), bin_size_h(_bin_size_h), pooled_width(_pooled_width), pooled_height(_pooled_height)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int w;
+    int h;
+    int roi_x1;
+    int roi_y1;
+    float bin_size_w;
+    float bin_size_h;
+    int pooled_width;
+    int pooled_height;
+};
+
+void roipooling_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int ph = 0; ph < pooled_height; ph++)
+    {
+        for (int pw = 0; pw < pooled_width; pw++)
+        {
+            // Compute pooling region for this output unit:
+            //  start (included) = floor(ph * roi_height / pooled_height)
+            //  end (excluded) = ceil((ph + 1) * roi_height / pooled_height)
+            int hstart = roi_y1 + floor((float)(ph) * bin_size_h);
+            int wstart = roi_x1 + floor((float)(pw) * bin_size_w);
+            int hend = roi_y1 + ceil((float)(ph + 1) * bin_size_h);
+            int wend = roi_x1 + ceil((float)(pw + 1) * bin_size_w);
+
+            hstart = std::min(std::max(hstart, 0), h);
+            wstart = std::min(std::max(wstart, 0), w);
+            hend = std::min(std::max(hend, 0), h);
+            wend = std::min(std::max(wend, 0), w);
+
+            bool is_empty = (hend <= hstart) || (wend <= wstart);
+
+            float max = is_empty ? 0.f : ptr[hstart * w + wstart];
+
+            for (int y = hstart; y < hend; y++)
+            {
+                for (int x = wstart; x < wend; x++)
+                {
+                    int index = y * w + x;
+                    max = std::max(max, ptr[index]);
+                }
+            }
+
+            outptr[pw] = max;
+        }
+
+        outptr += pooled_width;
+    }
+}
+
+} // namespace
+
+int ROIPooling::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     const Mat& bottom_blob = bottom_blobs[0];
     int w = bottom_blob.w;
@@ -43,7 +112,7 @@ int ROIPooling::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>&
     const Mat& roi_blob = bottom_blobs[1];
 
     Mat& top_blob = top_blobs[0];
-    top_blob.create(pooled_width, pooled_height, channels);
+    top_blob.create(pooled_width, pooled_height, channels, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -61,48 +130,9 @@ int ROIPooling::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>&
     float bin_size_w = (float)roi_w / (float)pooled_width;
     float bin_size_h = (float)roi_h / (float)pooled_height;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        const float* ptr = bottom_blob.channel(q);
-        float* outptr = top_blob.channel(q);
-
-        for (int ph = 0; ph < pooled_height; ph++)
-        {
-            for (int pw = 0; pw < pooled_width; pw++)
-            {
-                // Compute pooling region for this output unit:
-                //  start (included) = floor(ph * roi_height / pooled_height)
-                //  end (excluded) = ceil((ph + 1) * roi_height / pooled_height)
-                int hstart = roi_y1 + floor((float)(ph) * bin_size_h);
-                int wstart = roi_x1 + floor((float)(pw) * bin_size_w);
-                int hend = roi_y1 + ceil((float)(ph + 1) * bin_size_h);
-                int wend = roi_x1 + ceil((float)(pw + 1) * bin_size_w);
-
-                hstart = std::min(std::max(hstart, 0), h);
-                wstart = std::min(std::max(wstart, 0), w);
-                hend = std::min(std::max(hend, 0), h);
-                wend = std::min(std::max(wend, 0), w);
+    roipooling_task task(bottom_blob, top_blob, w, h, roi_x1, roi_y1, bin_size_w, bin_size_h, pooled_width, pooled_height);
 
-                bool is_empty = (hend <= hstart) || (wend <= wstart);
-
-                float max = is_empty ? 0.f : ptr[hstart * w + wstart];
-
-                for (int y = hstart; y < hend; y++)
-                {
-                    for (int x = wstart; x < wend; x++)
-                    {
-                        int index = y * w + x;
-                        max = std::max(max, ptr[index]);
-                    }
-                }
-
-                outptr[pw] = max;
-            }
-
-            outptr += pooled_width;
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
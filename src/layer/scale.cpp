@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "scale.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -54,7 +55,67 @@ int Scale::load_model(const ModelBin& mb)
     return 0;
 }
 
-int Scale::forward_inplace(std::vector<Mat>& bottom_top_blobs) const
+namespace {
+
+// one channel
+struct scale_blob_bias_task : public ParallelTask
+{
+    scale_blob_bias_task(Mat& _bottom_top_blob, const Mat& _scale_blob, const Mat& _bias_data, int _size)
+        : bottom_top_blob(_bottom_top_blob), scale_blob(_scale_blob), bias_data(_bias_data), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& scale_blob;
+    const Mat& bias_data;
+    int size;
+};
+
+void scale_blob_bias_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    float s = scale_blob[q];
+    float bias = bias_data[q];
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = ptr[i] * s + bias;
+    }
+}
+
+// one channel
+struct scale_blob_task : public ParallelTask
+{
+    scale_blob_task(Mat& _bottom_top_blob, const Mat& _scale_blob, int _size)
+        : bottom_top_blob(_bottom_top_blob), scale_blob(_scale_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& scale_blob;
+    int size;
+};
+
+void scale_blob_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    float s = scale_blob[q];
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] *= s;
+    }
+}
+
+} // namespace
+
+int Scale::forward_inplace(std::vector<Mat>& bottom_top_blobs, const Option& opt) const
 {
     Mat& bottom_top_blob = bottom_top_blobs[0];
     const Mat& scale_blob = bottom_top_blobs[1];
@@ -66,40 +127,81 @@ int Scale::forward_inplace(std::vector<Mat>& bottom_top_blobs) const
 
     if (bias_term)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-
-            float s = scale_blob[q];
-            float bias = bias_data[q];
-
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] = ptr[i] * s + bias;
-            }
-        }
+        scale_blob_bias_task task(bottom_top_blob, scale_blob, bias_data, size);
+
+        parallel_for(task, channels, opt);
     }
     else
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-
-            float s = scale_blob[q];
-
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] *= s;
-            }
-        }
+        scale_blob_task task(bottom_top_blob, scale_blob, size);
+
+        parallel_for(task, channels, opt);
     }
 
     return 0;
 }
 
-int Scale::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct scale_bias_task : public ParallelTask
+{
+    scale_bias_task(Mat& _bottom_top_blob, const Mat& _scale_data, const Mat& _bias_data, int _size)
+        : bottom_top_blob(_bottom_top_blob), scale_data(_scale_data), bias_data(_bias_data), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& scale_data;
+    const Mat& bias_data;
+    int size;
+};
+
+void scale_bias_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    float s = scale_data[q];
+    float bias = bias_data[q];
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = ptr[i] * s + bias;
+    }
+}
+
+// one channel
+struct scale_plain_task : public ParallelTask
+{
+    scale_plain_task(Mat& _bottom_top_blob, const Mat& _scale_data, int _size)
+        : bottom_top_blob(_bottom_top_blob), scale_data(_scale_data), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& scale_data;
+    int size;
+};
+
+void scale_plain_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    float s = scale_data[q];
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] *= s;
+    }
+}
+
+} // namespace
+
+int Scale::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
@@ -108,34 +210,15 @@ int Scale::forward_inplace(Mat& bottom_top_blob) const
 
     if (bias_term)
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-
-            float s = scale_data[q];
-            float bias = bias_data[q];
-
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] = ptr[i] * s + bias;
-            }
-        }
+        scale_bias_task task(bottom_top_blob, scale_data, bias_data, size);
+
+        parallel_for(task, channels, opt);
     }
     else
     {
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-
-            float s = scale_data[q];
-
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] *= s;
-            }
-        }
+        scale_plain_task task(bottom_top_blob, scale_data, size);
+
+        parallel_for(task, channels, opt);
     }
 
     return 0;
@@ -24,7 +24,7 @@ class Sigmoid : public Layer
 public:
     Sigmoid();
 
-    virtual int forward_inplace(Mat& bottom_top_blob) const;
+    virtual int forward_inplace(Mat& bottom_top_blob, const Option& opt) const;
 
 public:
 };
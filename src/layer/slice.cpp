@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "slice.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -30,7 +31,94 @@ int Slice::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Slice::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+namespace {
+
+// one row
+struct slice_rows_task : public ParallelTask
+{
+    slice_rows_task(const Mat& _bottom_blob, Mat& _top_blob, size_t _elemsize, int _q, int _slice)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), elemsize(_elemsize), q(_q), slice(_slice)
+    {
+    }
+
+    virtual void execute(int j) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    size_t elemsize;
+    int q;
+    int slice;
+};
+
+void slice_rows_task::execute(int j) const
+{
+    float* outptr = top_blob.row(j);
+    const float* ptr = bottom_blob.row(j) + q;
+    memcpy(outptr, ptr, slice * elemsize);
+}
+
+// one channel
+struct slice_h_task : public ParallelTask
+{
+    slice_h_task(const Mat& _bottom_blob, Mat& _top_blob, size_t _elemsize, int _w, int _q, int _slice)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), elemsize(_elemsize), w(_w), q(_q), slice(_slice)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    size_t elemsize;
+    int w;
+    int q;
+    int slice;
+};
+
+void slice_h_task::execute(int p) const
+{
+    int size = w * slice;
+
+    float* outptr = top_blob.channel(p);
+    const float* ptr = bottom_blob.channel(p).row(q);
+    memcpy(outptr, ptr, size * elemsize);
+}
+
+// one channel
+struct slice_w_task : public ParallelTask
+{
+    slice_w_task(const Mat& _bottom_blob, Mat& _top_blob, size_t _elemsize, int _h, int _q, int _slice)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), elemsize(_elemsize), h(_h), q(_q), slice(_slice)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    size_t elemsize;
+    int h;
+    int q;
+    int slice;
+};
+
+void slice_w_task::execute(int p) const
+{
+    float* outptr = top_blob.channel(p);
+    const Mat m = bottom_blob.channel(p);
+
+    for (int j=0; j<h; j++)
+    {
+        const float* ptr = m.row(j) + q;
+        memcpy(outptr, ptr, slice * elemsize);
+
+        outptr += slice;
+    }
+}
+
+} // namespace
+
+int Slice::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
     const Mat& bottom_blob = bottom_blobs[0];
     int dims = bottom_blob.dims;
@@ -51,7 +139,7 @@ int Slice::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_b
             }
 
             Mat& top_blob = top_blobs[i];
-            top_blob.create(slice, elemsize);
+            top_blob.create(slice, elemsize, opt.blob_allocator);
             if (top_blob.empty())
                 return -100;
 
@@ -80,7 +168,7 @@ int Slice::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_b
             }
 
             Mat& top_blob = top_blobs[i];
-            top_blob.create(w, slice, elemsize);
+            top_blob.create(w, slice, elemsize, opt.blob_allocator);
             if (top_blob.empty())
                 return -100;
 
@@ -111,17 +199,13 @@ int Slice::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_b
             }
 
             Mat& top_blob = top_blobs[i];
-            top_blob.create(slice, h, elemsize);
+            top_blob.create(slice, h, elemsize, opt.blob_allocator);
             if (top_blob.empty())
                 return -100;
 
-            #pragma omp parallel for
-            for (int j=0; j<h; j++)
-            {
-                float* outptr = top_blob.row(j);
-                const float* ptr = bottom_blob.row(j) + q;
-                memcpy(outptr, ptr, slice * elemsize);
-            }
+            slice_rows_task task(bottom_blob, top_blob, elemsize, q, slice);
+
+            parallel_for(task, h, opt);
 
             q += slice;
         }
@@ -145,7 +229,7 @@ int Slice::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_b
             }
 
             Mat& top_blob = top_blobs[i];
-            top_blob.create(w, h, slice, elemsize);
+            top_blob.create(w, h, slice, elemsize, opt.blob_allocator);
             if (top_blob.empty())
                 return -100;
 
@@ -177,19 +261,13 @@ int Slice::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_b
             }
 
             Mat& top_blob = top_blobs[i];
-            top_blob.create(w, slice, channels, elemsize);
+            top_blob.create(w, slice, channels, elemsize, opt.blob_allocator);
             if (top_blob.empty())
                 return -100;
 
-            #pragma omp parallel for
-            for (int p=0; p<channels; p++)
-            {
-                int size = w * slice;
+            slice_h_task task(bottom_blob, top_blob, elemsize, w, q, slice);
 
-                float* outptr = top_blob.channel(p);
-                const float* ptr = bottom_blob.channel(p).row(q);
-                memcpy(outptr, ptr, size * elemsize);
-            }
+            parallel_for(task, channels, opt);
 
             q += slice;
         }
@@ -213,24 +291,13 @@ int Slice::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_b
             }
 
             Mat& top_blob = top_blobs[i];
-            top_blob.create(slice, h, channels, elemsize);
+            top_blob.create(slice, h, channels, elemsize, opt.blob_allocator);
             if (top_blob.empty())
                 return -100;
 
-            #pragma omp parallel for
-            for (int p=0; p<channels; p++)
-            {
-                float* outptr = top_blob.channel(p);
-                const Mat m = bottom_blob.channel(p);
+            slice_w_task task(bottom_blob, top_blob, elemsize, h, q, slice);
 
-                for (int j=0; j<h; j++)
-                {
-                    const float* ptr = m.row(j) + q;
-                    memcpy(outptr, ptr, slice * elemsize);
-
-                    outptr += slice;
-                }
-            }
+            parallel_for(task, channels, opt);
 
             q += slice;
         }
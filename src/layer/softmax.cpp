@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "softmax.h"
+#include "threadpool.h"
 #include <float.h>
 #include <math.h>
 #include <algorithm>
@@ -34,7 +35,323 @@ int Softmax::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Softmax::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct softmax_exp_task : public ParallelTask
+{
+    softmax_exp_task(Mat& _bottom_top_blob, Mat& _max, int _size)
+        : bottom_top_blob(_bottom_top_blob), max(_max), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& max;
+    int size;
+};
+
+void softmax_exp_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = exp(ptr[i] - max[i]);
+    }
+}
+
+// one channel
+struct softmax_div_task : public ParallelTask
+{
+    softmax_div_task(Mat& _bottom_top_blob, Mat& _sum, int _size)
+        : bottom_top_blob(_bottom_top_blob), sum(_sum), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& sum;
+    int size;
+};
+
+void softmax_div_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] /= sum[i];
+    }
+}
+
+// one channel
+struct softmax_h_max_task : public ParallelTask
+{
+    softmax_h_max_task(Mat& _bottom_top_blob, Mat& _max, int _w, int _h)
+        : bottom_top_blob(_bottom_top_blob), max(_max), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& max;
+    int w;
+    int h;
+};
+
+void softmax_h_max_task::execute(int q) const
+{
+    const float* ptr = bottom_top_blob.channel(q);
+    float* maxptr = max.row(q);
+
+    for (int i=0; i<h; i++)
+    {
+        float max = -FLT_MAX;
+        for (int j=0; j<w; j++)
+        {
+            max = std::max(max, ptr[j]);
+        }
+
+        maxptr[i] = max;
+        ptr += w;
+    }
+}
+
+// one channel
+struct softmax_h_exp_task : public ParallelTask
+{
+    softmax_h_exp_task(Mat& _bottom_top_blob, Mat& _max, int _w, int _h)
+        : bottom_top_blob(_bottom_top_blob), max(_max), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& max;
+    int w;
+    int h;
+};
+
+void softmax_h_exp_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+    float* maxptr = max.row(q);
+
+    for (int i=0; i<h; i++)
+    {
+        float max = maxptr[i];
+        for (int j=0; j<w; j++)
+        {
+            ptr[j] = exp(ptr[j] - max);
+        }
+
+        ptr += w;
+    }
+}
+
+// one channel
+struct softmax_h_sum_task : public ParallelTask
+{
+    softmax_h_sum_task(Mat& _bottom_top_blob, Mat& _sum, int _w, int _h)
+        : bottom_top_blob(_bottom_top_blob), sum(_sum), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& sum;
+    int w;
+    int h;
+};
+
+void softmax_h_sum_task::execute(int q) const
+{
+    const float* ptr = bottom_top_blob.channel(q);
+    float* sumptr = sum.row(q);
+
+    for (int i=0; i<h; i++)
+    {
+        float sum = 0.f;
+        for (int j=0; j<w; j++)
+        {
+            sum += ptr[j];
+        }
+
+        sumptr[i] = sum;
+        ptr += w;
+    }
+}
+
+// one channel
+struct softmax_h_div_task : public ParallelTask
+{
+    softmax_h_div_task(Mat& _bottom_top_blob, Mat& _sum, int _w, int _h)
+        : bottom_top_blob(_bottom_top_blob), sum(_sum), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& sum;
+    int w;
+    int h;
+};
+
+void softmax_h_div_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+    float* sumptr = sum.row(q);
+
+    for (int i=0; i<h; i++)
+    {
+        float sum = sumptr[i];
+        for (int j=0; j<w; j++)
+        {
+            ptr[j] /= sum;
+        }
+
+        ptr += w;
+    }
+}
+
+// one channel
+struct softmax_w_max_task : public ParallelTask
+{
+    softmax_w_max_task(Mat& _bottom_top_blob, Mat& _max, int _w, int _h)
+        : bottom_top_blob(_bottom_top_blob), max(_max), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& max;
+    int w;
+    int h;
+};
+
+void softmax_w_max_task::execute(int q) const
+{
+    const float* ptr = bottom_top_blob.channel(q);
+    float* maxptr = max.row(q);
+
+    for (int i=0; i<h; i++)
+    {
+        for (int j=0; j<w; j++)
+        {
+            maxptr[j] = std::max(maxptr[j], ptr[j]);
+        }
+
+        ptr += w;
+    }
+}
+
+// one channel
+struct softmax_w_exp_task : public ParallelTask
+{
+    softmax_w_exp_task(Mat& _bottom_top_blob, Mat& _max, int _w, int _h)
+        : bottom_top_blob(_bottom_top_blob), max(_max), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& max;
+    int w;
+    int h;
+};
+
+void softmax_w_exp_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+    float* maxptr = max.row(q);
+
+    for (int i=0; i<h; i++)
+    {
+        for (int j=0; j<w; j++)
+        {
+            ptr[j] = exp(ptr[j] - maxptr[j]);
+        }
+
+        ptr += w;
+    }
+}
+
+// one channel
+struct softmax_w_sum_task : public ParallelTask
+{
+    softmax_w_sum_task(Mat& _bottom_top_blob, Mat& _sum, int _w, int _h)
+        : bottom_top_blob(_bottom_top_blob), sum(_sum), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& sum;
+    int w;
+    int h;
+};
+
+void softmax_w_sum_task::execute(int q) const
+{
+    const float* ptr = bottom_top_blob.channel(q);
+    float* sumptr = sum.row(q);
+
+    for (int i=0; i<h; i++)
+    {
+        for (int j=0; j<w; j++)
+        {
+            sumptr[j] += ptr[j];
+        }
+
+        ptr += w;
+    }
+}
+
+// one channel
+struct softmax_w_div_task : public ParallelTask
+{
+    softmax_w_div_task(Mat& _bottom_top_blob, Mat& _sum, int _w, int _h)
+        : bottom_top_blob(_bottom_top_blob), sum(_sum), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    Mat& sum;
+    int w;
+    int h;
+};
+
+void softmax_w_div_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+    float* sumptr = sum.row(q);
+
+    for (int i=0; i<h; i++)
+    {
+        for (int j=0; j<w; j++)
+        {
+            ptr[j] /= sumptr[j];
+        }
+
+        ptr += w;
+    }
+}
+
+} // namespace
+
+int Softmax::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     // value = exp( value - global max value )
     // sum all value
@@ -79,7 +396,7 @@ int Softmax::forward_inplace(Mat& bottom_top_blob) const
         int h = bottom_top_blob.h;
 
         Mat max;
-        max.create(w);
+        max.create(w, 4u, opt.workspace_allocator);
         if (max.empty())
             return -100;
         max.fill(-FLT_MAX);
@@ -103,7 +420,7 @@ int Softmax::forward_inplace(Mat& bottom_top_blob) const
         }
 
         Mat sum;
-        sum.create(w);
+        sum.create(w, 4u, opt.workspace_allocator);
         if (sum.empty())
             return -100;
         sum.fill(0.f);
@@ -135,7 +452,7 @@ int Softmax::forward_inplace(Mat& bottom_top_blob) const
         int h = bottom_top_blob.h;
 
         Mat max;
-        max.create(h);
+        max.create(h, 4u, opt.workspace_allocator);
         if (max.empty())
             return -100;
 
@@ -164,7 +481,7 @@ int Softmax::forward_inplace(Mat& bottom_top_blob) const
         }
 
         Mat sum;
-        sum.create(h);
+        sum.create(h, 4u, opt.workspace_allocator);
         if (sum.empty())
             return -100;
 
@@ -203,7 +520,7 @@ int Softmax::forward_inplace(Mat& bottom_top_blob) const
         int size = w * h;
 
         Mat max;
-        max.create(w, h);
+        max.create(w, h, 4u, opt.workspace_allocator);
         if (max.empty())
             return -100;
         max.fill(-FLT_MAX);
@@ -217,19 +534,12 @@ int Softmax::forward_inplace(Mat& bottom_top_blob) const
             }
         }
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
+        softmax_exp_task exp_task(bottom_top_blob, max, size);
 
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] = exp(ptr[i] - max[i]);
-            }
-        }
+        parallel_for(exp_task, channels, opt);
 
         Mat sum;
-        sum.create(w, h);
+        sum.create(w, h, 4u, opt.workspace_allocator);
         if (sum.empty())
             return -100;
         sum.fill(0.f);
@@ -243,16 +553,9 @@ int Softmax::forward_inplace(Mat& bottom_top_blob) const
             }
         }
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
+        softmax_div_task div_task(bottom_top_blob, sum, size);
 
-            for (int i=0; i<size; i++)
-            {
-                ptr[i] /= sum[i];
-            }
-        }
+        parallel_for(div_task, channels, opt);
 
         return 0;
     }
@@ -264,88 +567,30 @@ int Softmax::forward_inplace(Mat& bottom_top_blob) const
         int channels = bottom_top_blob.c;
 
         Mat max;
-        max.create(h, channels);
+        max.create(h, channels, 4u, opt.workspace_allocator);
         if (max.empty())
             return -100;
         max.fill(-FLT_MAX);
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_top_blob.channel(q);
-            float* maxptr = max.row(q);
+        softmax_h_max_task max_task(bottom_top_blob, max, w, h);
 
-            for (int i=0; i<h; i++)
-            {
-                float max = -FLT_MAX;
-                for (int j=0; j<w; j++)
-                {
-                    max = std::max(max, ptr[j]);
-                }
-
-                maxptr[i] = max;
-                ptr += w;
-            }
-        }
-
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-            float* maxptr = max.row(q);
+        parallel_for(max_task, channels, opt);
 
-            for (int i=0; i<h; i++)
-            {
-                float max = maxptr[i];
-                for (int j=0; j<w; j++)
-                {
-                    ptr[j] = exp(ptr[j] - max);
-                }
+        softmax_h_exp_task exp_task(bottom_top_blob, max, w, h);
 
-                ptr += w;
-            }
-        }
+        parallel_for(exp_task, channels, opt);
 
         Mat sum;
-        sum.create(h, channels);
+        sum.create(h, channels, 4u, opt.workspace_allocator);
         if (sum.empty())
             return -100;
         sum.fill(0.f);
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_top_blob.channel(q);
-            float* sumptr = sum.row(q);
+        softmax_h_sum_task sum_task(bottom_top_blob, sum, w, h);
 
-            for (int i=0; i<h; i++)
-            {
-                float sum = 0.f;
-                for (int j=0; j<w; j++)
-                {
-                    sum += ptr[j];
-                }
-
-                sumptr[i] = sum;
-                ptr += w;
-            }
-        }
+        parallel_for(sum_task, channels, opt);
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-            float* sumptr = sum.row(q);
-
-            for (int i=0; i<h; i++)
-            {
-                float sum = sumptr[i];
-                for (int j=0; j<w; j++)
-                {
-                    ptr[j] /= sum;
-                }
+        softmax_h_div_task div_task(bottom_top_blob, sum, w, h);
 
-                ptr += w;
-            }
-        }
+        parallel_for(div_task, channels, opt);
 
         return 0;
     }
@@ -357,82 +602,30 @@ int Softmax::forward_inplace(Mat& bottom_top_blob) const
         int channels = bottom_top_blob.c;
 
         Mat max;
-        max.create(w, channels);
+        max.create(w, channels, 4u, opt.workspace_allocator);
         if (max.empty())
             return -100;
         max.fill(-FLT_MAX);
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_top_blob.channel(q);
-            float* maxptr = max.row(q);
+        softmax_w_max_task max_task(bottom_top_blob, max, w, h);
 
-            for (int i=0; i<h; i++)
-            {
-                for (int j=0; j<w; j++)
-                {
-                    maxptr[j] = std::max(maxptr[j], ptr[j]);
-                }
+        parallel_for(max_task, channels, opt);
 
-                ptr += w;
-            }
-        }
+        softmax_w_exp_task exp_task(bottom_top_blob, max, w, h);
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-            float* maxptr = max.row(q);
-
-            for (int i=0; i<h; i++)
-            {
-                for (int j=0; j<w; j++)
-                {
-                    ptr[j] = exp(ptr[j] - maxptr[j]);
-                }
-
-                ptr += w;
-            }
-        }
+        parallel_for(exp_task, channels, opt);
 
         Mat sum;
-        sum.create(w, channels);
+        sum.create(w, channels, 4u, opt.workspace_allocator);
         if (sum.empty())
             return -100;
         sum.fill(0.f);
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_top_blob.channel(q);
-            float* sumptr = sum.row(q);
+        softmax_w_sum_task sum_task(bottom_top_blob, sum, w, h);
 
-            for (int i=0; i<h; i++)
-            {
-                for (int j=0; j<w; j++)
-                {
-                    sumptr[j] += ptr[j];
-                }
+        parallel_for(sum_task, channels, opt);
 
-                ptr += w;
-            }
-        }
+        softmax_w_div_task div_task(bottom_top_blob, sum, w, h);
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            float* ptr = bottom_top_blob.channel(q);
-            float* sumptr = sum.row(q);
-
-            for (int i=0; i<h; i++)
-            {
-                for (int j=0; j<w; j++)
-                {
-                    ptr[j] /= sumptr[j];
-                }
-
-                ptr += w;
-            }
-        }
+        parallel_for(div_task, channels, opt);
 
         return 0;
     }
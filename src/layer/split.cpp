@@ -20,9 +20,10 @@ DEFINE_LAYER_CREATOR(Split)
 
 Split::Split()
 {
+    support_packing = true;
 }
 
-int Split::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs) const
+int Split::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& /*opt*/) const
 {
     const Mat& bottom_blob = bottom_blobs[0];
     for (size_t i=0; i<top_blobs.size(); i++)
@@ -33,4 +34,14 @@ int Split::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_b
     return 0;
 }
 
+int Split::infer_shape(const std::vector<Mat>& _bottom_shapes, std::vector<Mat>& _top_shapes)
+{
+    for (size_t i=0; i<_top_shapes.size(); i++)
+    {
+        _top_shapes[i] = _bottom_shapes[0];
+    }
+
+    return 0;
+}
+
 } // namespace ncnn
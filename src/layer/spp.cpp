@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "spp.h"
+#include "threadpool.h"
 #include <math.h>
 #include <algorithm>
 
@@ -34,11 +35,111 @@ int SPP::load_param(const ParamDict& pd)
     return 0;
 }
 
-int SPP::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one channel
+struct spp_max_task : public ParallelTask
+{
+    spp_max_task(Mat& _bottom_blob_bordered, float* _pyramid_ptr, int _w, int _h, int _stride_h, int _stride_w, int _outw, int _outh, int _maxk, int* _space_ofs)
+        : bottom_blob_bordered(_bottom_blob_bordered), pyramid_ptr(_pyramid_ptr), w(_w), h(_h), stride_h(_stride_h), stride_w(_stride_w), outw(_outw), outh(_outh), maxk(_maxk), space_ofs(_space_ofs)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_blob_bordered;
+    float* pyramid_ptr;
+    int w;
+    int h;
+    int stride_h;
+    int stride_w;
+    int outw;
+    int outh;
+    int maxk;
+    int* space_ofs;
+};
+
+void spp_max_task::execute(int q) const
+{
+    const Mat m(w, h, bottom_blob_bordered.channel(q));
+    float* outptr = pyramid_ptr + outh * outw * q;
+
+    for (int i = 0; i < outh; i++)
+    {
+        for (int j = 0; j < outw; j++)
+        {
+            const float* sptr = m.row(i*stride_h) + j*stride_w;
+
+            float max = sptr[0];
+
+            for (int k = 0; k < maxk; k++)
+            {
+                float val = sptr[ space_ofs[k] ];
+                max = std::max(max, val);
+            }
+
+            outptr[j] = max;
+        }
+
+        outptr += outw;
+    }
+}
+
+// one channel
+struct spp_ave_task : public ParallelTask
+{
+    spp_ave_task(Mat& _bottom_blob_bordered, float* _pyramid_ptr, int _w, int _h, int _stride_h, int _stride_w, int _outw, int _outh, int _maxk, int* _space_ofs)
+        : bottom_blob_bordered(_bottom_blob_bordered), pyramid_ptr(_pyramid_ptr), w(_w), h(_h), stride_h(_stride_h), stride_w(_stride_w), outw(_outw), outh(_outh), maxk(_maxk), space_ofs(_space_ofs)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_blob_bordered;
+    float* pyramid_ptr;
+    int w;
+    int h;
+    int stride_h;
+    int stride_w;
+    int outw;
+    int outh;
+    int maxk;
+    int* space_ofs;
+};
+
+void spp_ave_task::execute(int q) const
+{
+    const Mat m(w, h, bottom_blob_bordered.channel(q));
+    float* outptr = pyramid_ptr + outh * outw * q;
+
+    for (int i = 0; i < outh; i++)
+    {
+        for (int j = 0; j < outw; j++)
+        {
+            const float* sptr = m.row(i*stride_h) + j*stride_w;
+
+            float sum = 0;
+
+            for (int k = 0; k < maxk; k++)
+            {
+                float val = sptr[ space_ofs[k] ];
+                sum += val;
+            }
+
+            outptr[j] = sum / maxk;
+        }
+
+        outptr += outw;
+    }
+}
+
+} // namespace
+
+int SPP::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     // 1 + 4 + 16 + 64 + ... + (2*pyramid_height)^2
     int pyramid_num_bins = ((1 << (pyramid_height * 2)) - 1) / 3;
-    top_blob.create(pyramid_num_bins, 1, 2);
+    top_blob.create(pyramid_num_bins, 1, 2, 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
@@ -72,7 +173,7 @@ int SPP::forward(const Mat& bottom_blob, Mat& top_blob) const
         Mat bottom_blob_bordered = bottom_blob;
         if (pad_h > 0 || pad_w > 0)
         {
-            copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f);
+            copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f, opt.workspace_allocator);
             if (bottom_blob_bordered.empty())
                 return -100;
 
@@ -103,61 +204,15 @@ int SPP::forward(const Mat& bottom_blob, Mat& top_blob) const
 
         if (pooling_type == PoolMethod_MAX)
         {
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const Mat m(w, h, bottom_blob_bordered.channel(q));
-                float* outptr = pyramid_ptr + outh * outw * q;
-
-                for (int i = 0; i < outh; i++)
-                {
-                    for (int j = 0; j < outw; j++)
-                    {
-                        const float* sptr = m.row(i*stride_h) + j*stride_w;
+            spp_max_task task(bottom_blob_bordered, pyramid_ptr, w, h, stride_h, stride_w, outw, outh, maxk, space_ofs);
 
-                        float max = sptr[0];
-
-                        for (int k = 0; k < maxk; k++)
-                        {
-                            float val = sptr[ space_ofs[k] ];
-                            max = std::max(max, val);
-                        }
-
-                        outptr[j] = max;
-                    }
-
-                    outptr += outw;
-                }
-            }
+            parallel_for(task, channels, opt);
         }
         else if (pooling_type == PoolMethod_AVE)
         {
-            #pragma omp parallel for
-            for (int q=0; q<channels; q++)
-            {
-                const Mat m(w, h, bottom_blob_bordered.channel(q));
-                float* outptr = pyramid_ptr + outh * outw * q;
+            spp_ave_task task(bottom_blob_bordered, pyramid_ptr, w, h, stride_h, stride_w, outw, outh, maxk, space_ofs);
 
-                for (int i = 0; i < outh; i++)
-                {
-                    for (int j = 0; j < outw; j++)
-                    {
-                        const float* sptr = m.row(i*stride_h) + j*stride_w;
-
-                        float sum = 0;
-
-                        for (int k = 0; k < maxk; k++)
-                        {
-                            float val = sptr[ space_ofs[k] ];
-                            sum += val;
-                        }
-
-                        outptr[j] = sum / maxk;
-                    }
-
-                    outptr += outw;
-                }
-            }
+            parallel_for(task, channels, opt);
         }
 
         pyramid_ptr += channels * outh * outw;
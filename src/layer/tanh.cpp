@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "tanh.h"
+#include "threadpool.h"
 #include <math.h>
 
 namespace ncnn {
@@ -25,23 +26,44 @@ TanH::TanH()
     support_inplace = true;
 }
 
-int TanH::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct tanh_task : public ParallelTask
+{
+    tanh_task(Mat& _bottom_top_blob, int _size)
+        : bottom_top_blob(_bottom_top_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+};
+
+void tanh_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = tanh(ptr[i]);
+    }
+}
+
+} // namespace
+
+int TanH::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
     int channels = bottom_top_blob.c;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
+    tanh_task task(bottom_top_blob, size);
 
-        for (int i=0; i<size; i++)
-        {
-            ptr[i] = tanh(ptr[i]);
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "threshold.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -31,23 +32,45 @@ int Threshold::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Threshold::forward_inplace(Mat& bottom_top_blob) const
+namespace {
+
+// one channel
+struct threshold_task : public ParallelTask
+{
+    threshold_task(Mat& _bottom_top_blob, int _size, float _threshold)
+        : bottom_top_blob(_bottom_top_blob), size(_size), threshold(_threshold)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float threshold;
+};
+
+void threshold_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    for (int i=0; i<size; i++)
+    {
+        ptr[i] = ptr[i] > threshold ? 1.f : 0.f;
+    }
+}
+
+} // namespace
+
+int Threshold::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     int w = bottom_top_blob.w;
     int h = bottom_top_blob.h;
     int channels = bottom_top_blob.c;
     int size = w * h;
 
-    #pragma omp parallel for
-    for (int q=0; q<channels; q++)
-    {
-        float* ptr = bottom_top_blob.channel(q);
+    threshold_task task(bottom_top_blob, size, threshold);
 
-        for (int i=0; i<size; i++)
-        {
-            ptr[i] = ptr[i] > threshold ? 1.f : 0.f;
-        }
-    }
+    parallel_for(task, channels, opt);
 
     return 0;
 }
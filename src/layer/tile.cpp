@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "tile.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
@@ -32,7 +33,107 @@ int Tile::load_param(const ParamDict& pd)
     return 0;
 }
 
-int Tile::forward(const Mat& bottom_blob, Mat& top_blob) const
+namespace {
+
+// one copy of the input
+struct tile_channels_task : public ParallelTask
+{
+    tile_channels_task(Mat& _top_blob, int _channels, const float* _ptr, int _size)
+        : top_blob(_top_blob), channels(_channels), ptr(_ptr), size(_size)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    Mat& top_blob;
+    int channels;
+    const float* ptr;
+    int size;
+};
+
+void tile_channels_task::execute(int p) const
+{
+    float* outptr = top_blob.channel(p * channels);
+
+    for (int i=0; i<size; i++)
+    {
+        outptr[i] = ptr[i];
+    }
+}
+
+// one channel
+struct tile_h_task : public ParallelTask
+{
+    tile_h_task(const Mat& _bottom_blob, Mat& _top_blob, int _size, int _tiles)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), size(_size), tiles(_tiles)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int size;
+    int tiles;
+};
+
+void tile_h_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int p=0; p<tiles; p++)
+    {
+        for (int i=0; i<size; i++)
+        {
+            outptr[i] = ptr[i];
+        }
+
+        outptr += size;
+    }
+}
+
+// one channel
+struct tile_w_task : public ParallelTask
+{
+    tile_w_task(const Mat& _bottom_blob, Mat& _top_blob, int _w, int _h, int _tiles)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), w(_w), h(_h), tiles(_tiles)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int w;
+    int h;
+    int tiles;
+};
+
+void tile_w_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i = 0; i < h; i++)
+    {
+        for (int p=0; p<tiles; p++)
+        {
+            for (int j = 0; j < w; j++)
+            {
+                outptr[j] = ptr[j];
+            }
+
+            outptr += w;
+        }
+
+        ptr += w;
+    }
+}
+
+} // namespace
+
+int Tile::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
 {
     int w = bottom_blob.w;
     int h = bottom_blob.h;
@@ -40,76 +141,38 @@ int Tile::forward(const Mat& bottom_blob, Mat& top_blob) const
 
     if (dim == 0)
     {
-        top_blob.create(w, h, channels * tiles);
+        top_blob.create(w, h, channels * tiles, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
         const float* ptr = bottom_blob;
         int size = bottom_blob.cstep * channels;
 
-        #pragma omp parallel for
-        for (int p=0; p<tiles; p++)
-        {
-            float* outptr = top_blob.channel(p * channels);
+        tile_channels_task task(top_blob, channels, ptr, size);
 
-            for (int i=0; i<size; i++)
-            {
-                outptr[i] = ptr[i];
-            }
-        }
+        parallel_for(task, tiles, opt);
     }
     else if (dim == 1)
     {
-        top_blob.create(w, h * tiles, channels);
+        top_blob.create(w, h * tiles, channels, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
         int size = w * h;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_blob.channel(q);
-            float* outptr = top_blob.channel(q);
-
-            for (int p=0; p<tiles; p++)
-            {
-                for (int i=0; i<size; i++)
-                {
-                    outptr[i] = ptr[i];
-                }
+        tile_h_task task(bottom_blob, top_blob, size, tiles);
 
-                outptr += size;
-            }
-        }
+        parallel_for(task, channels, opt);
     }
     else if (dim == 2)
     {
-        top_blob.create(w * tiles, h, channels);
+        top_blob.create(w * tiles, h, channels, 4u, opt.blob_allocator);
         if (top_blob.empty())
             return -100;
 
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const float* ptr = bottom_blob.channel(q);
-            float* outptr = top_blob.channel(q);
-
-            for (int i = 0; i < h; i++)
-            {
-                for (int p=0; p<tiles; p++)
-                {
-                    for (int j = 0; j < w; j++)
-                    {
-                        outptr[j] = ptr[j];
-                    }
-
-                    outptr += w;
-                }
+        tile_w_task task(bottom_blob, top_blob, w, h, tiles);
 
-                ptr += w;
-            }
-        }
+        parallel_for(task, channels, opt);
     }
 
     return 0;
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "unaryop.h"
+#include "threadpool.h"
 #include <math.h>
 #include <functional>
 
@@ -33,18 +34,40 @@ int UnaryOp::load_param(const ParamDict& pd)
     return 0;
 }
 
+namespace {
+
+// one element
+template<typename Op>
+struct unary_op_inplace_task : public ParallelTask
+{
+    unary_op_inplace_task(Mat& _a)
+        : a(_a)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    Mat& a;
+};
+
 template<typename Op>
-static int unary_op_inplace(Mat& a)
+void unary_op_inplace_task<Op>::execute(int i) const
 {
     Op op;
 
+    a[i] = op(a[i]);
+}
+
+} // namespace
+
+template<typename Op>
+static int unary_op_inplace(Mat& a, const Option& opt)
+{
     int size = a.total();
 
-    #pragma omp parallel for
-    for (int i=0; i<size; i++)
-    {
-        a[i] = op(a[i]);
-    }
+    unary_op_inplace_task<Op> task(a);
+
+    parallel_for(task, size, opt);
 
     return 0;
 }
@@ -129,55 +152,55 @@ struct unary_op_reciprocal : std::unary_function<T,T> {
     T operator() (const T& x) const { return 1.f / x; }
 };
 
-int UnaryOp::forward_inplace(Mat& bottom_top_blob) const
+int UnaryOp::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
 {
     if (op_type == Operation_ABS)
-        return unary_op_inplace< unary_op_abs<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_abs<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_NEG)
-        return unary_op_inplace< unary_op_neg<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_neg<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_FLOOR)
-        return unary_op_inplace< unary_op_floor<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_floor<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_CEIL)
-        return unary_op_inplace< unary_op_ceil<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_ceil<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_SQUARE)
-        return unary_op_inplace< unary_op_square<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_square<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_SQRT)
-        return unary_op_inplace< unary_op_sqrt<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_sqrt<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_RSQRT)
-        return unary_op_inplace< unary_op_rsqrt<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_rsqrt<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_EXP)
-        return unary_op_inplace< unary_op_exp<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_exp<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_LOG)
-        return unary_op_inplace< unary_op_log<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_log<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_SIN)
-        return unary_op_inplace< unary_op_sin<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_sin<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_COS)
-        return unary_op_inplace< unary_op_cos<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_cos<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_TAN)
-        return unary_op_inplace< unary_op_tan<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_tan<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_ASIN)
-        return unary_op_inplace< unary_op_asin<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_asin<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_ACOS)
-        return unary_op_inplace< unary_op_acos<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_acos<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_ATAN)
-        return unary_op_inplace< unary_op_atan<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_atan<float> >(bottom_top_blob, opt);
 
     if (op_type == Operation_RECIPROCAL)
-        return unary_op_inplace< unary_op_reciprocal<float> >(bottom_top_blob);
+        return unary_op_inplace< unary_op_reciprocal<float> >(bottom_top_blob, opt);
 
     return 0;
 }
@@ -0,0 +1,100 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "batchnorm_x86.h"
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(BatchNorm_x86)
+
+namespace {
+
+// one channel
+struct batchnorm_sse_task : public ParallelTask
+{
+    batchnorm_sse_task(Mat& _bottom_top_blob, const Mat& _a_data, const Mat& _b_data, int _size)
+        : bottom_top_blob(_bottom_top_blob), a_data(_a_data), b_data(_b_data), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& a_data;
+    const Mat& b_data;
+    int size;
+};
+
+void batchnorm_sse_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    float a = a_data[q];
+    float b = b_data[q];
+
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _a = _mm256_set1_ps(a);
+        __m256 _b = _mm256_set1_ps(b);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            _p = _mm256_comp_fmadd_ps(_p, _b, _a);
+            _mm256_storeu_ps(ptr, _p);
+            ptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _a = _mm_set1_ps(a);
+        __m128 _b = _mm_set1_ps(b);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            _p = _mm_comp_fmadd_ps(_p, _b, _a);
+            _mm_storeu_ps(ptr, _p);
+            ptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *ptr = b * *ptr + a;
+        ptr++;
+    }
+}
+
+} // namespace
+
+int BatchNorm_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    // value = b * value + a
+
+    int w = bottom_top_blob.w;
+    int h = bottom_top_blob.h;
+    int size = w * h;
+
+    batchnorm_sse_task task(bottom_top_blob, a_data, b_data, size);
+
+    parallel_for(task, channels, opt);
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,95 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "bias_x86.h"
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(Bias_x86)
+
+namespace {
+
+// one channel
+struct bias_sse_task : public ParallelTask
+{
+    bias_sse_task(Mat& _bottom_top_blob, const Mat& _bias_data, int _size)
+        : bottom_top_blob(_bottom_top_blob), bias_data(_bias_data), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& bias_data;
+    int size;
+};
+
+void bias_sse_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    float bias = bias_data[q];
+
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _bias = _mm256_set1_ps(bias);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            _p = _mm256_add_ps(_p, _bias);
+            _mm256_storeu_ps(ptr, _p);
+            ptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _bias = _mm_set1_ps(bias);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            _p = _mm_add_ps(_p, _bias);
+            _mm_storeu_ps(ptr, _p);
+            ptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *ptr += bias;
+        ptr++;
+    }
+}
+
+} // namespace
+
+int Bias_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    int w = bottom_top_blob.w;
+    int h = bottom_top_blob.h;
+    int channels = bottom_top_blob.c;
+    int size = w * h;
+
+    bias_sse_task task(bottom_top_blob, bias_data, size);
+
+    parallel_for(task, channels, opt);
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,650 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "binaryop_x86.h"
+
+#include <algorithm>
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(BinaryOp_x86)
+
+// internal linkage, every isa build has its own ops
+namespace {
+
+struct binary_op_add
+{
+    float func(float x, float y) const { return x + y; }
+#if __SSE2__
+    __m128 func_pack4(__m128 x, __m128 y) const { return _mm_add_ps(x, y); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x, __m256 y) const { return _mm256_add_ps(x, y); }
+#endif // __AVX__
+};
+
+struct binary_op_sub
+{
+    float func(float x, float y) const { return x - y; }
+#if __SSE2__
+    __m128 func_pack4(__m128 x, __m128 y) const { return _mm_sub_ps(x, y); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x, __m256 y) const { return _mm256_sub_ps(x, y); }
+#endif // __AVX__
+};
+
+struct binary_op_mul
+{
+    float func(float x, float y) const { return x * y; }
+#if __SSE2__
+    __m128 func_pack4(__m128 x, __m128 y) const { return _mm_mul_ps(x, y); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x, __m256 y) const { return _mm256_mul_ps(x, y); }
+#endif // __AVX__
+};
+
+struct binary_op_div
+{
+    float func(float x, float y) const { return x / y; }
+#if __SSE2__
+    __m128 func_pack4(__m128 x, __m128 y) const { return _mm_div_ps(x, y); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x, __m256 y) const { return _mm256_div_ps(x, y); }
+#endif // __AVX__
+};
+
+struct binary_op_max
+{
+    float func(float x, float y) const { return std::max(x, y); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x, __m128 y) const { return _mm_max_ps(x, y); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x, __m256 y) const { return _mm256_max_ps(x, y); }
+#endif // __AVX__
+};
+
+struct binary_op_min
+{
+    float func(float x, float y) const { return std::min(x, y); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x, __m128 y) const { return _mm_min_ps(x, y); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x, __m256 y) const { return _mm256_min_ps(x, y); }
+#endif // __AVX__
+};
+
+} // namespace
+
+// vector op vector, outptr may alias ptr
+template<typename Op>
+static void binary_op_vv_sse(const float* ptr, const float* ptr1, float* outptr, int size)
+{
+    Op op;
+
+    int i = 0;
+#if __AVX__
+    for (; i+7<size; i+=8)
+    {
+        __m256 _p = _mm256_loadu_ps(ptr);
+        __m256 _p1 = _mm256_loadu_ps(ptr1);
+        _mm256_storeu_ps(outptr, op.func_pack8(_p, _p1));
+        ptr += 8;
+        ptr1 += 8;
+        outptr += 8;
+    }
+#endif // __AVX__
+#if __SSE2__
+    for (; i+3<size; i+=4)
+    {
+        __m128 _p = _mm_loadu_ps(ptr);
+        __m128 _p1 = _mm_loadu_ps(ptr1);
+        _mm_storeu_ps(outptr, op.func_pack4(_p, _p1));
+        ptr += 4;
+        ptr1 += 4;
+        outptr += 4;
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *outptr = op.func(*ptr, *ptr1);
+        ptr++;
+        ptr1++;
+        outptr++;
+    }
+}
+
+// vector op scalar
+template<typename Op>
+static void binary_op_vs_sse(const float* ptr, float b, float* outptr, int size)
+{
+    Op op;
+
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _b = _mm256_set1_ps(b);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            _mm256_storeu_ps(outptr, op.func_pack8(_p, _b));
+            ptr += 8;
+            outptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _b = _mm_set1_ps(b);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            _mm_storeu_ps(outptr, op.func_pack4(_p, _b));
+            ptr += 4;
+            outptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *outptr = op.func(*ptr, b);
+        ptr++;
+        outptr++;
+    }
+}
+
+// scalar op vector
+template<typename Op>
+static void binary_op_sv_sse(float a, const float* ptr1, float* outptr, int size)
+{
+    Op op;
+
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _a = _mm256_set1_ps(a);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p1 = _mm256_loadu_ps(ptr1);
+            _mm256_storeu_ps(outptr, op.func_pack8(_a, _p1));
+            ptr1 += 8;
+            outptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _a = _mm_set1_ps(a);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p1 = _mm_loadu_ps(ptr1);
+            _mm_storeu_ps(outptr, op.func_pack4(_a, _p1));
+            ptr1 += 4;
+            outptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *outptr = op.func(a, *ptr1);
+        ptr1++;
+        outptr++;
+    }
+}
+
+namespace {
+
+// one channel
+template<typename Op>
+struct binary_op_vv_sse_task : public ParallelTask
+{
+    binary_op_vv_sse_task(const Mat& _a, const Mat& _b, Mat& _c, int _size)
+        : a(_a), b(_b), c(_c), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int size;
+};
+
+template<typename Op>
+void binary_op_vv_sse_task<Op>::execute(int q) const
+{
+    binary_op_vv_sse<Op>(a.channel(q), b.channel(q), c.channel(q), size);
+}
+
+// one channel, b holds one value per row
+template<typename Op>
+struct binary_op_vs_rows_sse_task : public ParallelTask
+{
+    binary_op_vs_rows_sse_task(const Mat& _a, const Mat& _b, Mat& _c, int _w, int _h)
+        : a(_a), b(_b), c(_c), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int w;
+    int h;
+};
+
+template<typename Op>
+void binary_op_vs_rows_sse_task<Op>::execute(int q) const
+{
+    const float* ptr = a.channel(q);
+    const float* ptr1 = (const float*)b + h * q;
+    float* outptr = c.channel(q);
+
+    for (int y=0; y<h; y++)
+    {
+        binary_op_vs_sse<Op>(ptr, ptr1[y], outptr, w);
+
+        ptr += w;
+        outptr += w;
+    }
+}
+
+// one channel
+template<typename Op>
+struct binary_op_vs_sse_task : public ParallelTask
+{
+    binary_op_vs_sse_task(const Mat& _a, const Mat& _b, Mat& _c, int _size, bool _scalar)
+        : a(_a), b(_b), c(_c), size(_size), scalar(_scalar)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int size;
+    bool scalar;
+};
+
+template<typename Op>
+void binary_op_vs_sse_task<Op>::execute(int q) const
+{
+    binary_op_vs_sse<Op>(a.channel(q), scalar ? b[0] : b[q], c.channel(q), size);
+}
+
+// one channel, a holds one value per row
+template<typename Op>
+struct binary_op_sv_rows_sse_task : public ParallelTask
+{
+    binary_op_sv_rows_sse_task(const Mat& _a, const Mat& _b, Mat& _c, int _w1, int _h1)
+        : a(_a), b(_b), c(_c), w1(_w1), h1(_h1)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int w1;
+    int h1;
+};
+
+template<typename Op>
+void binary_op_sv_rows_sse_task<Op>::execute(int q) const
+{
+    const float* ptr = (const float*)a + h1 * q;
+    const float* ptr1 = b.channel(q);
+    float* outptr = c.channel(q);
+
+    for (int y=0; y<h1; y++)
+    {
+        binary_op_sv_sse<Op>(ptr[y], ptr1, outptr, w1);
+
+        ptr1 += w1;
+        outptr += w1;
+    }
+}
+
+// one channel
+template<typename Op>
+struct binary_op_sv_scalar_sse_task : public ParallelTask
+{
+    binary_op_sv_scalar_sse_task(const Mat& _b, Mat& _c, int _size1, float _a0)
+        : b(_b), c(_c), size1(_size1), a0(_a0)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& b;
+    Mat& c;
+    int size1;
+    float a0;
+};
+
+template<typename Op>
+void binary_op_sv_scalar_sse_task<Op>::execute(int q) const
+{
+    binary_op_sv_sse<Op>(a0, b.channel(q), c.channel(q), size1);
+}
+
+// one channel
+template<typename Op>
+struct binary_op_sv_sse_task : public ParallelTask
+{
+    binary_op_sv_sse_task(const Mat& _a, const Mat& _b, Mat& _c, int _size1)
+        : a(_a), b(_b), c(_c), size1(_size1)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int size1;
+};
+
+template<typename Op>
+void binary_op_sv_sse_task<Op>::execute(int q) const
+{
+    binary_op_sv_sse<Op>(a[q], b.channel(q), c.channel(q), size1);
+}
+
+} // namespace
+
+// same broadcast rules as BinaryOp
+template<typename Op>
+static int binary_op(const Mat& a, const Mat& b, Mat& c, const Option& opt)
+{
+    int w = a.w;
+    int h = a.h;
+    int channels = a.c;
+    int size = w * h;
+
+    int w1 = b.w;
+    int h1 = b.h;
+    int channels1 = b.c;
+    int size1 = w1 * h1;
+
+    if (a.dims == 3)
+    {
+        c.create(w, h, channels, 4u, opt.blob_allocator);
+        if (c.empty())
+            return -100;
+
+        if (b.dims == 3)
+        {
+            binary_op_vv_sse_task<Op> task(a, b, c, size);
+
+            parallel_for(task, channels, opt);
+
+            return 0;
+        }
+
+        if (b.dims == 2)
+        {
+            binary_op_vs_rows_sse_task<Op> task(a, b, c, w, h);
+
+            parallel_for(task, channels, opt);
+
+            return 0;
+        }
+
+        if (b.dims == 1)
+        {
+            const bool scalar = b.w == 1;
+
+            binary_op_vs_sse_task<Op> task(a, b, c, size, scalar);
+
+            parallel_for(task, channels, opt);
+
+            return 0;
+        }
+    }
+    else if (a.dims == 2)
+    {
+        if (b.dims == 3)
+        {
+            c.create(w1, h1, channels1, 4u, opt.blob_allocator);
+            if (c.empty())
+                return -100;
+
+            binary_op_sv_rows_sse_task<Op> task(a, b, c, w1, h1);
+
+            parallel_for(task, channels1, opt);
+
+            return 0;
+        }
+
+        c.create(w, h, 4u, opt.blob_allocator);
+        if (c.empty())
+            return -100;
+
+        if (b.dims == 2)
+        {
+            binary_op_vv_sse<Op>(a, b, c, size);
+
+            return 0;
+        }
+
+        if (b.dims == 1)
+        {
+            if (b.w == 1)
+            {
+                binary_op_vs_sse<Op>(a, b[0], c, size);
+
+                return 0;
+            }
+
+            const float* ptr = a;
+            float* outptr = c;
+
+            for (int y=0; y<h; y++)
+            {
+                binary_op_vs_sse<Op>(ptr, b[y], outptr, w);
+
+                ptr += w;
+                outptr += w;
+            }
+
+            return 0;
+        }
+    }
+    else if (a.dims == 1)
+    {
+        if (a.w == 1)
+        {
+            if (b.dims == 3)
+            {
+                c.create(w1, h1, channels1, 4u, opt.blob_allocator);
+                if (c.empty())
+                    return -100;
+
+                const float a0 = a[0];
+                binary_op_sv_scalar_sse_task<Op> task(b, c, size1, a0);
+
+                parallel_for(task, channels1, opt);
+
+                return 0;
+            }
+
+            if (b.dims == 2)
+                c.create(w1, h1, 4u, opt.blob_allocator);
+            else
+                c.create(w1, 4u, opt.blob_allocator);
+            if (c.empty())
+                return -100;
+
+            binary_op_sv_sse<Op>(a[0], b, c, size1);
+
+            return 0;
+        }
+
+        if (b.dims == 3)
+        {
+            c.create(w1, h1, channels1, 4u, opt.blob_allocator);
+            if (c.empty())
+                return -100;
+
+            binary_op_sv_sse_task<Op> task(a, b, c, size1);
+
+            parallel_for(task, channels1, opt);
+
+            return 0;
+        }
+
+        if (b.dims == 2)
+        {
+            c.create(w1, h1, 4u, opt.blob_allocator);
+            if (c.empty())
+                return -100;
+
+            const float* ptr1 = b;
+            float* outptr = c;
+
+            for (int y=0; y<h1; y++)
+            {
+                binary_op_sv_sse<Op>(a[y], ptr1, outptr, w1);
+
+                ptr1 += w1;
+                outptr += w1;
+            }
+
+            return 0;
+        }
+
+        if (b.dims == 1)
+        {
+            c.create(w, 4u, opt.blob_allocator);
+            if (c.empty())
+                return -100;
+
+            if (b.w == 1)
+                binary_op_vs_sse<Op>(a, b[0], c, size);
+            else
+                binary_op_vv_sse<Op>(a, b, c, size);
+        }
+    }
+
+    return 0;
+}
+
+namespace {
+
+// one channel
+template<typename Op>
+struct binary_op_scalar_inplace_sse_task : public ParallelTask
+{
+    binary_op_scalar_inplace_sse_task(Mat& _a, float _b, int _size)
+        : a(_a), b(_b), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& a;
+    float b;
+    int size;
+};
+
+template<typename Op>
+void binary_op_scalar_inplace_sse_task<Op>::execute(int q) const
+{
+    float* ptr = a.channel(q);
+
+    binary_op_vs_sse<Op>(ptr, b, ptr, size);
+}
+
+} // namespace
+
+template<typename Op>
+static int binary_op_scalar_inplace(Mat& a, float b, const Option& opt)
+{
+    int w = a.w;
+    int h = a.h;
+    int channels = a.c;
+    int size = w * h;
+
+    binary_op_scalar_inplace_sse_task<Op> task(a, b, size);
+
+    parallel_for(task, channels, opt);
+
+    return 0;
+}
+
+int BinaryOp_x86::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    const Mat& bottom_blob = bottom_blobs[0];
+    const Mat& bottom_blob1 = bottom_blobs[1];
+
+    Mat& top_blob = top_blobs[0];
+
+    if (op_type == Operation_ADD)
+        return binary_op<binary_op_add>(bottom_blob, bottom_blob1, top_blob, opt);
+
+    if (op_type == Operation_SUB)
+        return binary_op<binary_op_sub>(bottom_blob, bottom_blob1, top_blob, opt);
+
+    if (op_type == Operation_MUL)
+        return binary_op<binary_op_mul>(bottom_blob, bottom_blob1, top_blob, opt);
+
+    if (op_type == Operation_DIV)
+        return binary_op<binary_op_div>(bottom_blob, bottom_blob1, top_blob, opt);
+
+    if (op_type == Operation_MAX)
+        return binary_op<binary_op_max>(bottom_blob, bottom_blob1, top_blob, opt);
+
+    if (op_type == Operation_MIN)
+        return binary_op<binary_op_min>(bottom_blob, bottom_blob1, top_blob, opt);
+
+    // pow is left to the generic code
+    return BinaryOp::forward(bottom_blobs, top_blobs, opt);
+}
+
+int BinaryOp_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    if (op_type == Operation_ADD)
+        return binary_op_scalar_inplace<binary_op_add>(bottom_top_blob, b, opt);
+
+    if (op_type == Operation_SUB)
+        return binary_op_scalar_inplace<binary_op_sub>(bottom_top_blob, b, opt);
+
+    if (op_type == Operation_MUL)
+        return binary_op_scalar_inplace<binary_op_mul>(bottom_top_blob, b, opt);
+
+    if (op_type == Operation_DIV)
+        return binary_op_scalar_inplace<binary_op_div>(bottom_top_blob, b, opt);
+
+    if (op_type == Operation_MAX)
+        return binary_op_scalar_inplace<binary_op_max>(bottom_top_blob, b, opt);
+
+    if (op_type == Operation_MIN)
+        return binary_op_scalar_inplace<binary_op_min>(bottom_top_blob, b, opt);
+
+    return BinaryOp::forward_inplace(bottom_top_blob, opt);
+}
+
+} // namespace ncnn
@@ -12,204 +12,678 @@
 // CONDITIONS OF ANY KIND, either express or implied. See the License for the
 // specific language governing permissions and limitations under the License.
 
-static void conv1x1s1_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& _kernel, const Mat& _bias)
+// 1x1 convolution is a plain gemm, weights are packed by conv_sgemm_transform_kernel_sse
+
+namespace {
+
+// one row of B, SGEMM_COLS columns or one remaining column
+struct conv1x1s1_pack_sse_task : public ParallelTask
+{
+    conv1x1s1_pack_sse_task(const Mat& _bottom_blob, Mat& _bottom_tm, int _nn_col, int _remain_col_start)
+        : bottom_blob(_bottom_blob), bottom_tm(_bottom_tm), nn_col(_nn_col), remain_col_start(_remain_col_start)
+    {
+    }
+
+    virtual void execute(int b) const;
+
+    const Mat& bottom_blob;
+    Mat& bottom_tm;
+    int nn_col;
+    int remain_col_start;
+};
+
+void conv1x1s1_pack_sse_task::execute(int b) const
+{
+    const int inch = bottom_blob.c;
+
+    float* btmp = bottom_tm.row(b);
+
+    if (b >= nn_col)
+    {
+        const int j = remain_col_start + b - nn_col;
+
+        for (int q=0; q<inch; q++)
+        {
+            btmp[q] = bottom_blob.channel(q)[j];
+        }
+
+        return;
+    }
+
+    const int j = b * SGEMM_COLS;
+
+    for (int q=0; q<inch; q++)
+    {
+        const float* img0 = (const float*)bottom_blob.channel(q) + j;
+
+#if __AVX512F__
+        _mm512_storeu_ps(btmp, _mm512_loadu_ps(img0));
+#elif __AVX__
+        _mm256_storeu_ps(btmp, _mm256_loadu_ps(img0));
+#elif __SSE2__
+        _mm_storeu_ps(btmp, _mm_loadu_ps(img0));
+        _mm_storeu_ps(btmp + 4, _mm_loadu_ps(img0 + 4));
+#else
+        for (int n=0; n<8; n++)
+        {
+            btmp[n] = img0[n];
+        }
+#endif // __AVX512F__
+
+        btmp += SGEMM_COLS;
+    }
+}
+
+// every other pixel of every other row
+struct conv1x1s2_pack_sse_task : public ParallelTask
+{
+    conv1x1s2_pack_sse_task(const Mat& _bottom_blob, Mat& _bottom_tm, int _outw, int _nn_col, int _remain_col_start)
+        : bottom_blob(_bottom_blob), bottom_tm(_bottom_tm), outw(_outw), nn_col(_nn_col), remain_col_start(_remain_col_start)
+    {
+    }
+
+    virtual void execute(int b) const;
+
+    const Mat& bottom_blob;
+    Mat& bottom_tm;
+    int outw;
+    int nn_col;
+    int remain_col_start;
+};
+
+void conv1x1s2_pack_sse_task::execute(int b) const
+{
+    const int w = bottom_blob.w;
+    const int inch = bottom_blob.c;
+
+    float* btmp = bottom_tm.row(b);
+
+    if (b >= nn_col)
+    {
+        const int j = remain_col_start + b - nn_col;
+
+        const int ofs = j / outw * 2 * w + j % outw * 2;
+
+        for (int q=0; q<inch; q++)
+        {
+            btmp[q] = bottom_blob.channel(q)[ofs];
+        }
+
+        return;
+    }
+
+    const int j = b * SGEMM_COLS;
+
+    int ofs[SGEMM_COLS];
+    for (int n=0; n<SGEMM_COLS; n++)
+    {
+        ofs[n] = (j + n) / outw * 2 * w + (j + n) % outw * 2;
+    }
+
+    for (int q=0; q<inch; q++)
+    {
+        const float* img0 = bottom_blob.channel(q);
+
+        for (int n=0; n<SGEMM_COLS; n++)
+        {
+            btmp[n] = img0[ofs[n]];
+        }
+
+        btmp += SGEMM_COLS;
+    }
+}
+
+} // namespace
+
+// bottom_tm is shaped by conv_sgemm_scratch_shape
+static void conv1x1s1_sgemm_sse(const Mat& bottom_blob, Mat& top_blob, Mat& bottom_tm, const Mat& kernel_tm, const Mat& _bias, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    int inch = bottom_blob.c;
+
+    const int N = top_blob.w * top_blob.h;
+
+    int nn_col = N / SGEMM_COLS;
+    int remain_col_start = nn_col * SGEMM_COLS;
+
+    // the input channels are the gemm rows already, only interleave the columns
+    conv1x1s1_pack_sse_task task(bottom_blob, bottom_tm, nn_col, remain_col_start);
+
+    parallel_for(task, nn_col + N - remain_col_start, opt);
+
+    conv_sgemm_sse(bottom_tm, top_blob, kernel_tm, _bias, inch, activation_type, activation_params, opt);
+}
+
+static void conv1x1s2_sgemm_sse(const Mat& bottom_blob, Mat& top_blob, Mat& bottom_tm, const Mat& kernel_tm, const Mat& _bias, int activation_type, const Mat& activation_params, const Option& opt)
 {
-    int w = bottom_blob.w;
-    int h = bottom_blob.h;
     int inch = bottom_blob.c;
 
     int outw = top_blob.w;
-    int outh = top_blob.h;
-    int outch = top_blob.c;
 
-    const float* kernel = _kernel;
-    const float* bias = _bias;
+    const int N = top_blob.w * top_blob.h;
 
-    #pragma omp parallel for
-    for (int p=0; p<outch; p++)
-    {
-        Mat out = top_blob.channel(p);
+    int nn_col = N / SGEMM_COLS;
+    int remain_col_start = nn_col * SGEMM_COLS;
 
-        const float bias0 = bias ? bias[p] : 0.f;
+    // pick every other pixel while interleaving the columns
+    conv1x1s2_pack_sse_task task(bottom_blob, bottom_tm, outw, nn_col, remain_col_start);
 
-        out.fill(bias0);
+    parallel_for(task, nn_col + N - remain_col_start, opt);
 
-        int q = 0;
+    conv_sgemm_sse(bottom_tm, top_blob, kernel_tm, _bias, inch, activation_type, activation_params, opt);
+}
+
+// c/4-h-w-4 weights, for each input channel 16 output channels with avx, then 4 for the remaining packs
+static void conv1x1s1_transform_kernel_pack4_sse(const Mat& kernel, Mat& kernel_pack4, int inch, int outch)
+{
+    kernel_pack4.create(inch * outch);
 
-        for (; q+3<inch; q+=4)
+    const float* k = kernel;
+    float* kptr = kernel_pack4;
+
+    int p = 0;
+#if __AVX__
+    for (; p+15<outch; p+=16)
+    {
+        for (int q=0; q<inch; q++)
         {
-            float* outptr = out;
+            for (int o=0; o<16; o++)
+            {
+                kptr[o] = k[(p + o) * inch + q];
+            }
+
+            kptr += 16;
+        }
+    }
+#endif // __AVX__
+    for (; p+3<outch; p+=4)
+    {
+        for (int q=0; q<inch; q++)
+        {
+            for (int o=0; o<4; o++)
+            {
+                kptr[o] = k[(p + o) * inch + q];
+            }
+
+            kptr += 4;
+        }
+    }
+}
 
-            const float* img0 = bottom_blob.channel(q);
-            const float* img1 = bottom_blob.channel(q+1);
-            const float* img2 = bottom_blob.channel(q+2);
-            const float* img3 = bottom_blob.channel(q+3);
+// c/4-h-w-4 in and out, each input value is broadcast against the weights of 4 output packs
+namespace {
 
-            const float* kernel0 = kernel + p*inch  + q;
-            const float k0 = kernel0[0];
-            const float k1 = kernel0[1];
-            const float k2 = kernel0[2];
-            const float k3 = kernel0[3];
+// one row of bottom_tm, 4 pixels of every input pack or one remaining pixel
+struct conv1x1s1_pack4_gather_sse_task : public ParallelTask
+{
+    conv1x1s1_pack4_gather_sse_task(const Mat& _bottom_blob, Mat& _bottom_tm, int _nn_size, int _remain_size_start)
+        : bottom_blob(_bottom_blob), bottom_tm(_bottom_tm), nn_size(_nn_size), remain_size_start(_remain_size_start)
+    {
+    }
+
+    virtual void execute(int b) const;
+
+    const Mat& bottom_blob;
+    Mat& bottom_tm;
+    int nn_size;
+    int remain_size_start;
+};
+
+void conv1x1s1_pack4_gather_sse_task::execute(int b) const
+{
+    const int inch = bottom_blob.c;
 
-            const float* r0 = img0;
-            const float* r1 = img1;
-            const float* r2 = img2;
-            const float* r3 = img3;
+    if (b >= nn_size)
+    {
+        const int i = remain_size_start + b - nn_size;
 
-            int size = outw * outh;
+        float* tmptr = bottom_tm.row(nn_size + i - remain_size_start);
 
-            int remain = size;
+        for (int q=0; q<inch; q++)
+        {
+            const float* r0 = (const float*)bottom_blob.channel(q) + i * 4;
 
-            for (; remain>0; remain--)
+            for (int l=0; l<4; l++)
             {
-                float sum = *r0 * k0;
-                float sum1 = *r1 * k1;
-                float sum2 = *r2 * k2;
-                float sum3 = *r3 * k3;
-
-                *outptr += sum + sum1 + sum2 + sum3;
-
-                r0++;
-                r1++;
-                r2++;
-                r3++;
-                outptr++;
+                tmptr[l] = r0[l];
             }
 
+            tmptr += 4;
         }
 
-        for (; q<inch; q++)
+        return;
+    }
+
+    float* tmptr = bottom_tm.row(b);
+
+    for (int q=0; q<inch; q++)
+    {
+        const float* r0 = (const float*)bottom_blob.channel(q) + b * 16;
+
+#if __AVX__
+        _mm256_storeu_ps(tmptr, _mm256_loadu_ps(r0));
+        _mm256_storeu_ps(tmptr + 8, _mm256_loadu_ps(r0 + 8));
+#elif __SSE2__
+        _mm_storeu_ps(tmptr, _mm_loadu_ps(r0));
+        _mm_storeu_ps(tmptr + 4, _mm_loadu_ps(r0 + 4));
+        _mm_storeu_ps(tmptr + 8, _mm_loadu_ps(r0 + 8));
+        _mm_storeu_ps(tmptr + 12, _mm_loadu_ps(r0 + 12));
+#else
+        for (int n=0; n<16; n++)
         {
-            float* outptr = out;
+            tmptr[n] = r0[n];
+        }
+#endif // __AVX__
 
-            const float* img0 = bottom_blob.channel(q);
+        tmptr += 16;
+    }
+}
 
-            const float* kernel0 = kernel + p*inch  + q;
-            const float k0 = kernel0[0];
+#if __AVX__
+// four output packs against one block of pixels, the blocks outermost
+struct conv1x1s1_pack4_avx_task : public ParallelTask
+{
+    conv1x1s1_pack4_avx_task(Mat& _top_blob, const Mat& _kernel_pack4, const Mat& _bottom_tm, const float* _bias, const Mat& _activation_params, int _activation_type, int _inch, int _size, int _size_block, int _nn_outch, int _nn_size, int _remain_size_start)
+        : top_blob(_top_blob), kernel_pack4(_kernel_pack4), bottom_tm(_bottom_tm), bias(_bias), activation_params(_activation_params), activation_type(_activation_type), inch(_inch), size(_size), size_block(_size_block), nn_outch(_nn_outch), nn_size(_nn_size), remain_size_start(_remain_size_start)
+    {
+    }
 
-            const float* r0 = img0;
+    virtual void execute(int index) const;
+
+    Mat& top_blob;
+    const Mat& kernel_pack4;
+    const Mat& bottom_tm;
+    const float* bias;
+    const Mat& activation_params;
+    int activation_type;
+    int inch;
+    int size;
+    int size_block;
+    int nn_outch;
+    int nn_size;
+    int remain_size_start;
+};
+
+void conv1x1s1_pack4_avx_task::execute(int index) const
+{
+    const int bb = index / nn_outch;
+    const int pp = index % nn_outch;
+
+    const int p = pp * 4;
+
+    const int i_end = std::min(size, (bb + 1) * size_block);
 
-            int size = outw * outh;
+    const float slope = activation_type == 2 ? activation_params[0] : 0.f;
 
-            int remain = size;
+    int i = bb * size_block;
 
-            for (; remain>0; remain--)
+    float* outptr0 = (float*)top_blob.channel(p) + i * 4;
+    float* outptr1 = (float*)top_blob.channel(p + 1) + i * 4;
+    float* outptr2 = (float*)top_blob.channel(p + 2) + i * 4;
+    float* outptr3 = (float*)top_blob.channel(p + 3) + i * 4;
+
+    const float* kptr0 = (const float*)kernel_pack4 + p * inch * 16;
+
+    float bias0[16];
+    for (int o=0; o<16; o++)
+    {
+        bias0[o] = bias ? bias[p * 4 + o] : 0.f;
+    }
+
+#if __AVX512F__
+    // the 16 output channels in one register
+    __m512 _bias = _mm512_loadu_ps(bias0);
+
+    for (; i+7<i_end; i+=8)
+    {
+        __m512 _sum0 = _bias;
+        __m512 _sum1 = _bias;
+        __m512 _sum2 = _bias;
+        __m512 _sum3 = _bias;
+        __m512 _sum4 = _bias;
+        __m512 _sum5 = _bias;
+        __m512 _sum6 = _bias;
+        __m512 _sum7 = _bias;
+
+        const float* kptr = kptr0;
+        const float* r0 = bottom_tm.row(i / 4);
+        const float* r1 = bottom_tm.row(i / 4 + 1);
+
+        for (int q=0; q<inch; q++)
+        {
+            for (int l=0; l<4; l++)
             {
-                float sum = *r0 * k0;
+                __m512 _w = _mm512_loadu_ps(kptr);
+
+                _sum0 = _mm512_fmadd_ps(_mm512_set1_ps(r0[l]), _w, _sum0);
+                _sum1 = _mm512_fmadd_ps(_mm512_set1_ps(r0[4 + l]), _w, _sum1);
+                _sum2 = _mm512_fmadd_ps(_mm512_set1_ps(r0[8 + l]), _w, _sum2);
+                _sum3 = _mm512_fmadd_ps(_mm512_set1_ps(r0[12 + l]), _w, _sum3);
+                _sum4 = _mm512_fmadd_ps(_mm512_set1_ps(r1[l]), _w, _sum4);
+                _sum5 = _mm512_fmadd_ps(_mm512_set1_ps(r1[4 + l]), _w, _sum5);
+                _sum6 = _mm512_fmadd_ps(_mm512_set1_ps(r1[8 + l]), _w, _sum6);
+                _sum7 = _mm512_fmadd_ps(_mm512_set1_ps(r1[12 + l]), _w, _sum7);
+
+                kptr += 16;
+            }
 
-                *outptr += sum;
+            r0 += 16;
+            r1 += 16;
+        }
+
+        // each quarter belongs to one pack, the masked store puts it in place
+        __m512 _sums[8] = {_sum0, _sum1, _sum2, _sum3, _sum4, _sum5, _sum6, _sum7};
+        for (int n=0; n<8; n++)
+        {
+            _sums[n] = _mm512_activation_ps(_sums[n], activation_type, slope);
 
-                r0++;
-                outptr++;
+            _mm512_mask_storeu_ps(outptr0 + n * 4, 0x000f, _sums[n]);
+            _mm512_mask_storeu_ps(outptr1 + n * 4 - 4, 0x00f0, _sums[n]);
+            _mm512_mask_storeu_ps(outptr2 + n * 4 - 8, 0x0f00, _sums[n]);
+            _mm512_mask_storeu_ps(outptr3 + n * 4 - 12, 0xf000, _sums[n]);
+        }
+
+        outptr0 += 32;
+        outptr1 += 32;
+        outptr2 += 32;
+        outptr3 += 32;
+    }
+#endif // __AVX512F__
+
+    __m256 _bias0 = _mm256_loadu_ps(bias0);
+    __m256 _bias1 = _mm256_loadu_ps(bias0 + 8);
+
+    for (; i+3<i_end; i+=4)
+    {
+        __m256 _sum00 = _bias0;
+        __m256 _sum01 = _bias1;
+        __m256 _sum10 = _bias0;
+        __m256 _sum11 = _bias1;
+        __m256 _sum20 = _bias0;
+        __m256 _sum21 = _bias1;
+        __m256 _sum30 = _bias0;
+        __m256 _sum31 = _bias1;
+
+        const float* kptr = kptr0;
+        const float* r0 = bottom_tm.row(i / 4);
+
+        for (int q=0; q<inch; q++)
+        {
+            for (int l=0; l<4; l++)
+            {
+                __m256 _w0 = _mm256_loadu_ps(kptr);
+                __m256 _w1 = _mm256_loadu_ps(kptr + 8);
+
+                __m256 _v0 = _mm256_broadcast_ss(r0 + l);
+                __m256 _v1 = _mm256_broadcast_ss(r0 + 4 + l);
+                __m256 _v2 = _mm256_broadcast_ss(r0 + 8 + l);
+                __m256 _v3 = _mm256_broadcast_ss(r0 + 12 + l);
+
+                _sum00 = _mm256_comp_fmadd_ps(_v0, _w0, _sum00);
+                _sum01 = _mm256_comp_fmadd_ps(_v0, _w1, _sum01);
+                _sum10 = _mm256_comp_fmadd_ps(_v1, _w0, _sum10);
+                _sum11 = _mm256_comp_fmadd_ps(_v1, _w1, _sum11);
+                _sum20 = _mm256_comp_fmadd_ps(_v2, _w0, _sum20);
+                _sum21 = _mm256_comp_fmadd_ps(_v2, _w1, _sum21);
+                _sum30 = _mm256_comp_fmadd_ps(_v3, _w0, _sum30);
+                _sum31 = _mm256_comp_fmadd_ps(_v3, _w1, _sum31);
+
+                kptr += 16;
             }
 
+            r0 += 16;
         }
+
+        _sum00 = _mm256_activation_ps(_sum00, activation_type, slope);
+        _sum01 = _mm256_activation_ps(_sum01, activation_type, slope);
+        _sum10 = _mm256_activation_ps(_sum10, activation_type, slope);
+        _sum11 = _mm256_activation_ps(_sum11, activation_type, slope);
+        _sum20 = _mm256_activation_ps(_sum20, activation_type, slope);
+        _sum21 = _mm256_activation_ps(_sum21, activation_type, slope);
+        _sum30 = _mm256_activation_ps(_sum30, activation_type, slope);
+        _sum31 = _mm256_activation_ps(_sum31, activation_type, slope);
+
+        // low and high halves belong to neighbouring packs
+        _mm_storeu_ps(outptr0, _mm256_castps256_ps128(_sum00));
+        _mm_storeu_ps(outptr0 + 4, _mm256_castps256_ps128(_sum10));
+        _mm_storeu_ps(outptr0 + 8, _mm256_castps256_ps128(_sum20));
+        _mm_storeu_ps(outptr0 + 12, _mm256_castps256_ps128(_sum30));
+        _mm_storeu_ps(outptr1, _mm256_extractf128_ps(_sum00, 1));
+        _mm_storeu_ps(outptr1 + 4, _mm256_extractf128_ps(_sum10, 1));
+        _mm_storeu_ps(outptr1 + 8, _mm256_extractf128_ps(_sum20, 1));
+        _mm_storeu_ps(outptr1 + 12, _mm256_extractf128_ps(_sum30, 1));
+        _mm_storeu_ps(outptr2, _mm256_castps256_ps128(_sum01));
+        _mm_storeu_ps(outptr2 + 4, _mm256_castps256_ps128(_sum11));
+        _mm_storeu_ps(outptr2 + 8, _mm256_castps256_ps128(_sum21));
+        _mm_storeu_ps(outptr2 + 12, _mm256_castps256_ps128(_sum31));
+        _mm_storeu_ps(outptr3, _mm256_extractf128_ps(_sum01, 1));
+        _mm_storeu_ps(outptr3 + 4, _mm256_extractf128_ps(_sum11, 1));
+        _mm_storeu_ps(outptr3 + 8, _mm256_extractf128_ps(_sum21, 1));
+        _mm_storeu_ps(outptr3 + 12, _mm256_extractf128_ps(_sum31, 1));
+
+        outptr0 += 16;
+        outptr1 += 16;
+        outptr2 += 16;
+        outptr3 += 16;
     }
+    for (; i<i_end; i++)
+    {
+        __m256 _sum0 = _bias0;
+        __m256 _sum1 = _bias1;
+
+        const float* kptr = kptr0;
+        const float* r0 = bottom_tm.row(nn_size + i - remain_size_start);
+
+        for (int q=0; q<inch; q++)
+        {
+            for (int l=0; l<4; l++)
+            {
+                __m256 _v = _mm256_broadcast_ss(r0 + l);
+                _sum0 = _mm256_comp_fmadd_ps(_v, _mm256_loadu_ps(kptr), _sum0);
+                _sum1 = _mm256_comp_fmadd_ps(_v, _mm256_loadu_ps(kptr + 8), _sum1);
+
+                kptr += 16;
+            }
+
+            r0 += 4;
+        }
 
+        _sum0 = _mm256_activation_ps(_sum0, activation_type, slope);
+        _sum1 = _mm256_activation_ps(_sum1, activation_type, slope);
+
+        _mm_storeu_ps(outptr0, _mm256_castps256_ps128(_sum0));
+        _mm_storeu_ps(outptr1, _mm256_extractf128_ps(_sum0, 1));
+        _mm_storeu_ps(outptr2, _mm256_castps256_ps128(_sum1));
+        _mm_storeu_ps(outptr3, _mm256_extractf128_ps(_sum1, 1));
+
+        outptr0 += 4;
+        outptr1 += 4;
+        outptr2 += 4;
+        outptr3 += 4;
+    }
 }
+#endif // __AVX__
 
-static void conv1x1s2_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& _kernel, const Mat& _bias)
+// one output pack against all pixels
+struct conv1x1s1_pack4_sse_task : public ParallelTask
 {
-    int w = bottom_blob.w;
-    int inch = bottom_blob.c;
+    conv1x1s1_pack4_sse_task(const Mat& _bottom_blob, Mat& _top_blob, const Mat& _kernel_pack4, const Mat& _bottom_tm, const float* _bias, const Mat& _activation_params, int _activation_type, int _remain_outch_start, int _nn_size, int _remain_size_start)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), kernel_pack4(_kernel_pack4), bottom_tm(_bottom_tm), bias(_bias), activation_params(_activation_params), activation_type(_activation_type), remain_outch_start(_remain_outch_start), nn_size(_nn_size), remain_size_start(_remain_size_start)
+    {
+    }
 
-    int outw = top_blob.w;
-    int outh = top_blob.h;
-    int outch = top_blob.c;
+    virtual void execute(int index) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Mat& kernel_pack4;
+    const Mat& bottom_tm;
+    const float* bias;
+    const Mat& activation_params;
+    int activation_type;
+    int remain_outch_start;
+    int nn_size;
+    int remain_size_start;
+};
+
+void conv1x1s1_pack4_sse_task::execute(int index) const
+{
+    const int inch = bottom_blob.c;
+    const int size = top_blob.w * top_blob.h;
 
-    const int tailstep = w - 2*outw + w;
+    const int p = remain_outch_start + index;
 
-    const float* kernel = _kernel;
-    const float* bias = _bias;
+    float* outptr = top_blob.channel(p);
+
+    const float* kptr0 = (const float*)kernel_pack4 + p * inch * 16;
 
-    #pragma omp parallel for
-    for (int p=0; p<outch; p++)
+    float bias0[4];
+    for (int o=0; o<4; o++)
     {
-        Mat out = top_blob.channel(p);
+        bias0[o] = bias ? bias[p * 4 + o] : 0.f;
+    }
 
-        const float bias0 = bias ? bias[p] : 0.f;
+    int i = 0;
 
-        out.fill(bias0);
+#if __SSE2__
+    {
+        const float slope = activation_type == 2 ? activation_params[0] : 0.f;
 
-        int q = 0;
+        __m128 _bias0 = _mm_loadu_ps(bias0);
 
-        for (; q+3<inch; q+=4)
+        for (; i+3<size; i+=4)
         {
-            float* outptr = out;
-
-            const float* img0 = bottom_blob.channel(q);
-            const float* img1 = bottom_blob.channel(q+1);
-            const float* img2 = bottom_blob.channel(q+2);
-            const float* img3 = bottom_blob.channel(q+3);
+            __m128 _sum0 = _bias0;
+            __m128 _sum1 = _bias0;
+            __m128 _sum2 = _bias0;
+            __m128 _sum3 = _bias0;
 
-            const float* kernel0 = kernel + p*inch + q;
-            const float k0 = kernel0[0];
-            const float k1 = kernel0[1];
-            const float k2 = kernel0[2];
-            const float k3 = kernel0[3];
+            const float* kptr = kptr0;
 
-            const float* r0 = img0;
-            const float* r1 = img1;
-            const float* r2 = img2;
-            const float* r3 = img3;
+            const float* r0 = bottom_tm.row(i / 4);
 
-            for (int i = 0; i < outh; i++)
+            for (int q=0; q<inch; q++)
             {
-                int remain = outw;
-
-                for (; remain>0; remain--)
+                for (int l=0; l<4; l++)
                 {
-                    float sum = *r0 * k0;
-                    float sum1 = *r1 * k1;
-                    float sum2 = *r2 * k2;
-                    float sum3 = *r3 * k3;
-
-                    *outptr += sum + sum1 + sum2 + sum3;
-
-                    r0 += 2;
-                    r1 += 2;
-                    r2 += 2;
-                    r3 += 2;
-                    outptr++;
+                    __m128 _w = _mm_loadu_ps(kptr);
+
+                    _sum0 = _mm_comp_fmadd_ps(_mm_load1_ps(r0 + l), _w, _sum0);
+                    _sum1 = _mm_comp_fmadd_ps(_mm_load1_ps(r0 + 4 + l), _w, _sum1);
+                    _sum2 = _mm_comp_fmadd_ps(_mm_load1_ps(r0 + 8 + l), _w, _sum2);
+                    _sum3 = _mm_comp_fmadd_ps(_mm_load1_ps(r0 + 12 + l), _w, _sum3);
+
+                    kptr += 4;
                 }
 
-                r0 += tailstep;
-                r1 += tailstep;
-                r2 += tailstep;
-                r3 += tailstep;
+                r0 += 16;
             }
 
+            _mm_storeu_ps(outptr, _mm_activation_ps(_sum0, activation_type, slope));
+            _mm_storeu_ps(outptr + 4, _mm_activation_ps(_sum1, activation_type, slope));
+            _mm_storeu_ps(outptr + 8, _mm_activation_ps(_sum2, activation_type, slope));
+            _mm_storeu_ps(outptr + 12, _mm_activation_ps(_sum3, activation_type, slope));
+            outptr += 16;
         }
-
-        for (; q<inch; q++)
+        for (; i<size; i++)
         {
-            float* outptr = out;
+            __m128 _sum = _bias0;
 
-            const float* img0 = bottom_blob.channel(q);
+            const float* kptr = kptr0;
 
-            const float* kernel0 = kernel + p*inch + q;
-            const float k0 = kernel0[0];
+            const float* r0 = bottom_tm.row(nn_size + i - remain_size_start);
 
-            const float* r0 = img0;
-
-            for (int i = 0; i < outh; i++)
+            for (int q=0; q<inch; q++)
             {
-                int remain = outw;
-
-                for (; remain>0; remain--)
+                for (int l=0; l<4; l++)
                 {
-                    float sum = *r0 * k0;
+                    _sum = _mm_comp_fmadd_ps(_mm_load1_ps(r0 + l), _mm_loadu_ps(kptr), _sum);
+
+                    kptr += 4;
+                }
+
+                r0 += 4;
+            }
+
+            _mm_storeu_ps(outptr, _mm_activation_ps(_sum, activation_type, slope));
+            outptr += 4;
+        }
+    }
+#endif // __SSE2__
 
-                    *outptr += sum;
+    for (; i<size; i++)
+    {
+        float sum[4];
+        for (int o=0; o<4; o++)
+        {
+            sum[o] = bias0[o];
+        }
+
+        const float* kptr = kptr0;
+
+        for (int q=0; q<inch; q++)
+        {
+            const float* r0 = (const float*)bottom_blob.channel(q) + i * 4;
 
-                    r0 += 2;
-                    outptr++;
+            for (int l=0; l<4; l++)
+            {
+                for (int o=0; o<4; o++)
+                {
+                    sum[o] += r0[l] * kptr[o];
                 }
 
-                r0 += tailstep;
+                kptr += 4;
             }
+        }
 
+        for (int o=0; o<4; o++)
+        {
+            outptr[o] = activation_ss(sum[o], activation_type, activation_params);
         }
+
+        outptr += 4;
     }
+}
+
+} // namespace
+
+static void conv1x1s1_pack4_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& kernel_pack4, const Mat& _bias, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    int inch = bottom_blob.c;
+    int outch = top_blob.c;
+
+    const int size = top_blob.w * top_blob.h;
+
+    const float* bias = _bias;
+
+    // gather 4 pixels of every input pack into one row, the same way as the sgemm columns
+    const int nn_size = size / 4;
+    const int remain_size_start = nn_size * 4;
+
+    Mat bottom_tm(16 * inch, nn_size + size - remain_size_start, 4u, opt.workspace_allocator);
+    if (bottom_tm.empty())
+        return;
+
+    conv1x1s1_pack4_gather_sse_task gather_task(bottom_blob, bottom_tm, nn_size, remain_size_start);
+
+    parallel_for(gather_task, nn_size + size - remain_size_start, opt);
+
+    // four output packs at once with avx, one at a time for the rest
+    int remain_outch_start = 0;
+
+#if __AVX__
+    const int nn_outch = outch / 4;
+    remain_outch_start = nn_outch * 4;
+
+    // pixel blocks whose bottom_tm rows stay in l2 while every output pack passes over them
+    const int size_block = std::max(8, 256 * 1024 / (inch * 16 * (int)sizeof(float)) * 4 / 8 * 8);
+    const int nn_size_block = (size + size_block - 1) / size_block;
+
+    conv1x1s1_pack4_avx_task avx_task(top_blob, kernel_pack4, bottom_tm, bias, activation_params, activation_type, inch, size, size_block, nn_outch, nn_size, remain_size_start);
+
+    parallel_for(avx_task, nn_size_block * nn_outch, opt);
+#endif // __AVX__
+
+    conv1x1s1_pack4_sse_task task(bottom_blob, top_blob, kernel_pack4, bottom_tm, bias, activation_params, activation_type, remain_outch_start, nn_size, remain_size_start);
 
+    parallel_for(task, outch - remain_outch_start, opt);
 }
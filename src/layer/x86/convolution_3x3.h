@@ -12,7 +12,143 @@
 // CONDITIONS OF ANY KIND, either express or implied. See the License for the
 // specific language governing permissions and limitations under the License.
 
-static void conv3x3s1_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& _kernel, const Mat& _bias)
+namespace {
+
+// one output channel
+struct conv3x3s1_sse_task : public ParallelTask
+{
+    conv3x3s1_sse_task(Mat& _top_blob, const Mat& _bottom_blob, const float* _bias, int _inch, int _outw, const float* _kernel, int _w, int _outh)
+        : top_blob(_top_blob), bottom_blob(_bottom_blob), bias(_bias), inch(_inch), outw(_outw), kernel(_kernel), w(_w), outh(_outh)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    Mat& top_blob;
+    const Mat& bottom_blob;
+    const float* bias;
+    int inch;
+    int outw;
+    const float* kernel;
+    int w;
+    int outh;
+};
+
+void conv3x3s1_sse_task::execute(int p) const
+{
+    Mat out = top_blob.channel(p);
+
+    const float bias0 = bias ? bias[p] : 0.f;
+
+    out.fill(bias0);
+
+    for (int q=0; q<inch; q++)
+    {
+        float* outptr = out;
+        float* outptr2 = outptr + outw;
+
+        const float* img0 = bottom_blob.channel(q);
+
+        const float* kernel0 = kernel + p*inch*9  + q*9;
+
+        const float* r0 = img0;
+        const float* r1 = img0 + w;
+        const float* r2 = img0 + w*2;
+        const float* r3 = img0 + w*3;
+
+        const float* k0 = kernel0;
+        const float* k1 = kernel0 + 3;
+        const float* k2 = kernel0 + 6;
+
+        int i = 0;
+
+        for (; i+1 < outh; i+=2)
+        {
+
+            int remain = outw;
+
+            for (; remain>0; remain--)
+            {
+                float sum = 0;
+                float sum2 = 0;
+
+                sum += r0[0] * k0[0];
+                sum += r0[1] * k0[1];
+                sum += r0[2] * k0[2];
+                sum += r1[0] * k1[0];
+                sum += r1[1] * k1[1];
+                sum += r1[2] * k1[2];
+                sum += r2[0] * k2[0];
+                sum += r2[1] * k2[1];
+                sum += r2[2] * k2[2];
+
+                sum2 += r1[0] * k0[0];
+                sum2 += r1[1] * k0[1];
+                sum2 += r1[2] * k0[2];
+                sum2 += r2[0] * k1[0];
+                sum2 += r2[1] * k1[1];
+                sum2 += r2[2] * k1[2];
+                sum2 += r3[0] * k2[0];
+                sum2 += r3[1] * k2[1];
+                sum2 += r3[2] * k2[2];
+
+                *outptr += sum;
+                *outptr2 += sum2;
+
+                r0++;
+                r1++;
+                r2++;
+                r3++;
+                outptr++;
+                outptr2++;
+            }
+
+            r0 += 2 + w;
+            r1 += 2 + w;
+            r2 += 2 + w;
+            r3 += 2 + w;
+
+            outptr += outw;
+            outptr2 += outw;
+        }
+
+        for (; i < outh; i++)
+        {
+            int remain = outw;
+
+            for (; remain>0; remain--)
+            {
+                float sum = 0;
+
+                sum += r0[0] * k0[0];
+                sum += r0[1] * k0[1];
+                sum += r0[2] * k0[2];
+                sum += r1[0] * k1[0];
+                sum += r1[1] * k1[1];
+                sum += r1[2] * k1[2];
+                sum += r2[0] * k2[0];
+                sum += r2[1] * k2[1];
+                sum += r2[2] * k2[2];
+
+                *outptr += sum;
+
+                r0++;
+                r1++;
+                r2++;
+                outptr++;
+            }
+
+            r0 += 2;
+            r1 += 2;
+            r2 += 2;
+        }
+
+    }
+}
+
+} // namespace
+
+static void conv3x3s1_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& _kernel, const Mat& _bias, const Option& opt)
 {
     int w = bottom_blob.w;
     int inch = bottom_blob.c;
@@ -24,117 +160,699 @@ static void conv3x3s1_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& _ker
     const float* kernel = _kernel;
     const float* bias = _bias;
 
-    #pragma omp parallel for
-    for (int p=0; p<outch; p++)
+    conv3x3s1_sse_task task(top_blob, bottom_blob, bias, inch, outw, kernel, w, outh);
+
+    parallel_for(task, outch, opt);
+
+}
+
+#if __AVX__
+// one dimension of the input transform, see the scalar path for the formulas
+static inline void winograd64_transform_input_avx(const __m256* r, __m256* t)
+{
+    const __m256 _v5_25 = _mm256_set1_ps(5.25f);
+    const __m256 _vm4_25 = _mm256_set1_ps(-4.25f);
+    const __m256 _vm1_25 = _mm256_set1_ps(-1.25f);
+    const __m256 _v0_25 = _mm256_set1_ps(0.25f);
+    const __m256 _vm2_5 = _mm256_set1_ps(-2.5f);
+    const __m256 _v0_5 = _mm256_set1_ps(0.5f);
+    const __m256 _v2 = _mm256_set1_ps(2.f);
+    const __m256 _v4 = _mm256_set1_ps(4.f);
+
+    t[0] = _mm256_comp_fmadd_ps(_mm256_sub_ps(r[4], r[2]), _v5_25, _mm256_sub_ps(r[0], r[6]));
+    t[7] = _mm256_comp_fmadd_ps(_mm256_sub_ps(r[3], r[5]), _v5_25, _mm256_sub_ps(r[7], r[1]));
+
+    __m256 _tmp12a = _mm256_comp_fmadd_ps(r[4], _vm4_25, _mm256_add_ps(r[2], r[6]));
+    __m256 _tmp12b = _mm256_comp_fmadd_ps(r[3], _vm4_25, _mm256_add_ps(r[1], r[5]));
+    t[1] = _mm256_add_ps(_tmp12a, _tmp12b);
+    t[2] = _mm256_sub_ps(_tmp12a, _tmp12b);
+
+    __m256 _tmp34a = _mm256_comp_fmadd_ps(r[4], _vm1_25, _mm256_comp_fmadd_ps(r[2], _v0_25, r[6]));
+    __m256 _tmp34b = _mm256_comp_fmadd_ps(r[5], _v2, _mm256_comp_fmadd_ps(r[3], _vm2_5, _mm256_mul_ps(r[1], _v0_5)));
+    t[3] = _mm256_add_ps(_tmp34a, _tmp34b);
+    t[4] = _mm256_sub_ps(_tmp34a, _tmp34b);
+
+    __m256 _tmp56a = _mm256_comp_fmadd_ps(_mm256_comp_fmadd_ps(r[4], _vm1_25, r[2]), _v4, r[6]);
+    __m256 _tmp56b = _mm256_comp_fmadd_ps(r[5], _v0_5, _mm256_comp_fmadd_ps(r[3], _vm2_5, _mm256_mul_ps(r[1], _v2)));
+    t[5] = _mm256_add_ps(_tmp56a, _tmp56b);
+    t[6] = _mm256_sub_ps(_tmp56a, _tmp56b);
+}
+
+// one dimension of the output transform, 8 in 6 out
+static inline void winograd64_transform_output_avx(const __m256* m, __m256* t)
+{
+    const __m256 _v2 = _mm256_set1_ps(2.f);
+    const __m256 _v4 = _mm256_set1_ps(4.f);
+    const __m256 _v8 = _mm256_set1_ps(8.f);
+    const __m256 _v16 = _mm256_set1_ps(16.f);
+    const __m256 _v32 = _mm256_set1_ps(32.f);
+
+    __m256 _tmp024a = _mm256_add_ps(m[1], m[2]);
+    __m256 _tmp135a = _mm256_sub_ps(m[1], m[2]);
+    __m256 _tmp024b = _mm256_add_ps(m[3], m[4]);
+    __m256 _tmp135b = _mm256_sub_ps(m[3], m[4]);
+    __m256 _tmp024c = _mm256_add_ps(m[5], m[6]);
+    __m256 _tmp135c = _mm256_sub_ps(m[5], m[6]);
+
+    t[0] = _mm256_comp_fmadd_ps(_tmp024c, _v32, _mm256_add_ps(_mm256_add_ps(m[0], _tmp024a), _tmp024b));
+    t[2] = _mm256_comp_fmadd_ps(_tmp024c, _v8, _mm256_comp_fmadd_ps(_tmp024b, _v4, _tmp024a));
+    t[4] = _mm256_comp_fmadd_ps(_tmp024c, _v2, _mm256_comp_fmadd_ps(_tmp024b, _v16, _tmp024a));
+
+    t[1] = _mm256_comp_fmadd_ps(_tmp135c, _v16, _mm256_comp_fmadd_ps(_tmp135b, _v2, _tmp135a));
+    t[3] = _mm256_comp_fmadd_ps(_tmp135c, _v4, _mm256_comp_fmadd_ps(_tmp135b, _v8, _tmp135a));
+    t[5] = _mm256_add_ps(_mm256_comp_fmadd_ps(_tmp135b, _v32, _mm256_add_ps(m[7], _tmp135a)), _tmp135c);
+}
+#endif // __AVX__
+
+namespace {
+
+// the kernels of one output channel
+struct conv3x3s1_winograd64_transform_kernel_sse_task : public ParallelTask
+{
+    conv3x3s1_winograd64_transform_kernel_sse_task(const Mat& _kernel, Mat& _kernel_tm, int _inch, int _remain_outch_start, int _nn_outch)
+        : kernel(_kernel), kernel_tm(_kernel_tm), inch(_inch), remain_outch_start(_remain_outch_start), nn_outch(_nn_outch)
     {
-        Mat out = top_blob.channel(p);
+    }
+
+    virtual void execute(int p) const;
+
+    const Mat& kernel;
+    Mat& kernel_tm;
+    int inch;
+    int remain_outch_start;
+    int nn_outch;
+};
 
-        const float bias0 = bias ? bias[p] : 0.f;
+void conv3x3s1_winograd64_transform_kernel_sse_task::execute(int p) const
+{
+    static const float ktm[8][3] = {
+        {   1.0f,     0.0f,     0.0f},
+        {-2.0f/9,  -2.0f/9,  -2.0f/9},
+        {-2.0f/9,   2.0f/9,  -2.0f/9},
+        {1.0f/90,  1.0f/45,  2.0f/45},
+        {1.0f/90, -1.0f/45,  2.0f/45},
+        {1.0f/45,  1.0f/90, 1.0f/180},
+        {1.0f/45, -1.0f/90, 1.0f/180},
+        {   0.0f,     0.0f,     1.0f}
+    };
+
+    for (int q = 0; q<inch; q++)
+    {
+        const float* kernel0 = (const float*)kernel + p*inch * 9 + q * 9;
 
-        out.fill(bias0);
+        // transform kernel
+        const float* k0 = kernel0;
+        const float* k1 = kernel0 + 3;
+        const float* k2 = kernel0 + 6;
 
-        for (int q=0; q<inch; q++)
+        // h
+        float tmp[8][3];
+        for (int i=0; i<8; i++)
         {
-            float* outptr = out;
-            float* outptr2 = outptr + outw;
+            tmp[i][0] = k0[0] * ktm[i][0] + k0[1] * ktm[i][1] + k0[2] * ktm[i][2];
+            tmp[i][1] = k1[0] * ktm[i][0] + k1[1] * ktm[i][1] + k1[2] * ktm[i][2];
+            tmp[i][2] = k2[0] * ktm[i][0] + k2[1] * ktm[i][1] + k2[2] * ktm[i][2];
+        }
 
-            const float* img0 = bottom_blob.channel(q);
+        // v
+        for (int j=0; j<8; j++)
+        {
+            float* tmpp = &tmp[j][0];
+
+            for (int i=0; i<8; i++)
+            {
+                float v = tmpp[0] * ktm[i][0] + tmpp[1] * ktm[i][1] + tmpp[2] * ktm[i][2];
+
+                Mat kernel_tm0 = kernel_tm.channel(j*8 + i);
+                if (p < remain_outch_start)
+                    kernel_tm0.row(p / 8)[q * 8 + p % 8] = v;
+                else
+                    kernel_tm0.row(nn_outch + p - remain_outch_start)[q] = v;
+            }
+        }
+    }
+}
+
+} // namespace
+
+static void conv3x3s1_winograd64_transform_kernel_sse(const Mat& kernel, Mat& kernel_tm, int inch, int outch)
+{
+    // 64 gemm panels, 8 output channels interleaved per row, remaining output channels one per row
+    int nn_outch = outch >> 3;
+    int remain_outch_start = nn_outch << 3;
+
+    kernel_tm.create(8*inch, nn_outch + outch - remain_outch_start, 64);
+
+    conv3x3s1_winograd64_transform_kernel_sse_task task(kernel, kernel_tm, inch, remain_outch_start, nn_outch);
+
+    parallel_for(task, outch, get_default_option());
+}
+
+// the pad_left pad_top border goes into the same copy as the tile padding
+namespace {
+
+// the input tiles of one channel
+struct conv3x3s1_winograd64_transform_input_sse_task : public ParallelTask
+{
+    conv3x3s1_winograd64_transform_input_sse_task(const Mat& _bottom_blob_bordered, Mat& _bottom_blob_tm, int _tiles_w, int _tiles, int _nn_tiles)
+        : bottom_blob_bordered(_bottom_blob_bordered), bottom_blob_tm(_bottom_blob_tm), tiles_w(_tiles_w), tiles(_tiles), nn_tiles(_nn_tiles)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob_bordered;
+    Mat& bottom_blob_tm;
+    int tiles_w;
+    int tiles;
+    int nn_tiles;
+};
+
+void conv3x3s1_winograd64_transform_input_sse_task::execute(int q) const
+{
+    const int w = bottom_blob_bordered.w;
+
+    const Mat img0 = bottom_blob_bordered.channel(q);
+
+    for (int tb=0; tb<nn_tiles; tb++)
+    {
+        const float* r0[8];
+        for (int n=0; n<8; n++)
+        {
+            int t = std::min(tb * 8 + n, tiles - 1);
+            r0[n] = img0.row(t / tiles_w * 6) + t % tiles_w * 6;
+        }
+
+#if __AVX__
+        // lanes are the 8 tiles
+        __m256 _tmp[8][8];
+        for (int m=0; m<8; m++)
+        {
+            __m256 _r[8];
+            for (int n=0; n<8; n++)
+            {
+                _r[n] = _mm256_loadu_ps(r0[n] + m * w);
+            }
+            transpose8_ps(_r);
+
+            winograd64_transform_input_avx(_r, _tmp[m]);
+        }
 
-            const float* kernel0 = kernel + p*inch*9  + q*9;
+        for (int i=0; i<8; i++)
+        {
+            __m256 _r[8];
+            for (int m=0; m<8; m++)
+            {
+                _r[m] = _tmp[m][i];
+            }
+
+            __m256 _t[8];
+            winograd64_transform_input_avx(_r, _t);
+
+            for (int m=0; m<8; m++)
+            {
+                _mm256_storeu_ps(bottom_blob_tm.channel(i * 8 + m).row(tb) + q * 8, _t[m]);
+            }
+        }
+#else
+        for (int n=0; n<8; n++)
+        {
+            const float* r00 = r0[n];
 
-            const float* r0 = img0;
-            const float* r1 = img0 + w;
-            const float* r2 = img0 + w*2;
-            const float* r3 = img0 + w*3;
+            float tmp[8][8];
 
-            const float* k0 = kernel0;
-            const float* k1 = kernel0 + 3;
-            const float* k2 = kernel0 + 6;
+            for (int m=0; m<8; m++)
+            {
+                tmp[0][m] = r00[0] - r00[6] + (r00[4] - r00[2]) * 5.25f;
+                tmp[7][m] = r00[7] - r00[1] + (r00[3] - r00[5]) * 5.25f;
+
+                float tmp12a = (r00[2] + r00[6] - r00[4] * 4.25f);
+                float tmp12b = (r00[1] + r00[5] - r00[3] * 4.25f);
+
+                tmp[1][m] = tmp12a + tmp12b;
+                tmp[2][m] = tmp12a - tmp12b;
+
+                float tmp34a = (r00[6] + r00[2] * 0.25f - r00[4] * 1.25f);
+                float tmp34b = (r00[1] * 0.5f - r00[3] * 2.5f + r00[5] * 2.f);
+
+                tmp[3][m] = tmp34a + tmp34b;
+                tmp[4][m] = tmp34a - tmp34b;
 
-            int i = 0;
+                float tmp56a = (r00[6] + (r00[2] - r00[4] * 1.25f) * 4.f);
+                float tmp56b = (r00[1] * 2.f - r00[3] * 2.5f + r00[5] * 0.5f);
 
-            for (; i+1 < outh; i+=2)
+                tmp[5][m] = tmp56a + tmp56b;
+                tmp[6][m] = tmp56a - tmp56b;
+
+                r00 += w;
+            }
+
+            for (int m=0; m<8; m++)
             {
+                const float* tmp0 = tmp[m];
+
+                float t[8];
 
-                int remain = outw;
+                t[0] = tmp0[0] - tmp0[6] + (tmp0[4] - tmp0[2]) * 5.25f;
+                t[7] = tmp0[7] - tmp0[1] + (tmp0[3] - tmp0[5]) * 5.25f;
 
-                for (; remain>0; remain--)
+                float tmp12a = (tmp0[2] + tmp0[6] - tmp0[4] * 4.25f);
+                float tmp12b = (tmp0[1] - tmp0[3] * 4.25f + tmp0[5]);
+
+                t[1] = tmp12a + tmp12b;
+                t[2] = tmp12a - tmp12b;
+
+                float tmp34a = (tmp0[6] + tmp0[2] * 0.25f - tmp0[4] * 1.25f);
+                float tmp34b = (tmp0[1] * 0.5f - tmp0[3] * 2.5f + tmp0[5] * 2.f);
+
+                t[3] = tmp34a + tmp34b;
+                t[4] = tmp34a - tmp34b;
+
+                float tmp56a = (tmp0[6] + (tmp0[2] - tmp0[4] * 1.25f) * 4.f);
+                float tmp56b = (tmp0[1] * 2.f - tmp0[3] * 2.5f + tmp0[5] * 0.5f);
+
+                t[5] = tmp56a + tmp56b;
+                t[6] = tmp56a - tmp56b;
+
+                for (int i=0; i<8; i++)
                 {
-                    float sum = 0;
-                    float sum2 = 0;
-
-                    sum += r0[0] * k0[0];
-                    sum += r0[1] * k0[1];
-                    sum += r0[2] * k0[2];
-                    sum += r1[0] * k1[0];
-                    sum += r1[1] * k1[1];
-                    sum += r1[2] * k1[2];
-                    sum += r2[0] * k2[0];
-                    sum += r2[1] * k2[1];
-                    sum += r2[2] * k2[2];
-
-                    sum2 += r1[0] * k0[0];
-                    sum2 += r1[1] * k0[1];
-                    sum2 += r1[2] * k0[2];
-                    sum2 += r2[0] * k1[0];
-                    sum2 += r2[1] * k1[1];
-                    sum2 += r2[2] * k1[2];
-                    sum2 += r3[0] * k2[0];
-                    sum2 += r3[1] * k2[1];
-                    sum2 += r3[2] * k2[2];
-
-                    *outptr += sum;
-                    *outptr2 += sum2;
-
-                    r0++;
-                    r1++;
-                    r2++;
-                    r3++;
-                    outptr++;
-                    outptr2++;
+                    bottom_blob_tm.channel(m * 8 + i).row(tb)[q * 8 + n] = t[i];
                 }
+            }
+        }
+#endif // __AVX__
+    }
+}
+
+// one of the 64 gemm
+struct conv3x3s1_winograd64_dot_sse_task : public ParallelTask
+{
+    conv3x3s1_winograd64_dot_sse_task(const Mat& _bottom_blob_tm, const Mat& _kernel_tm, Mat& _top_blob_tm, int _inch, int _outch, int _nn_outch, int _remain_outch_start, int _nn_tiles)
+        : bottom_blob_tm(_bottom_blob_tm), kernel_tm(_kernel_tm), top_blob_tm(_top_blob_tm), inch(_inch), outch(_outch), nn_outch(_nn_outch), remain_outch_start(_remain_outch_start), nn_tiles(_nn_tiles)
+    {
+    }
 
-                r0 += 2 + w;
-                r1 += 2 + w;
-                r2 += 2 + w;
-                r3 += 2 + w;
+    virtual void execute(int r) const;
 
-                outptr += outw;
-                outptr2 += outw;
+    const Mat& bottom_blob_tm;
+    const Mat& kernel_tm;
+    Mat& top_blob_tm;
+    int inch;
+    int outch;
+    int nn_outch;
+    int remain_outch_start;
+    int nn_tiles;
+};
+
+void conv3x3s1_winograd64_dot_sse_task::execute(int r) const
+{
+    const Mat bb = bottom_blob_tm.channel(r);
+    const Mat kk = kernel_tm.channel(r);
+    Mat tt = top_blob_tm.channel(r);
+
+    for (int pp=0; pp<nn_outch; pp++)
+    {
+        int p = pp * 8;
+
+        const float* ktm = kk.row(pp);
+
+        for (int tb=0; tb<nn_tiles; tb++)
+        {
+            const float* btm = bb.row(tb);
+
+#if __AVX__
+            // 8 output channels x 8 tiles in registers
+            __m256 _sum0 = _mm256_setzero_ps();
+            __m256 _sum1 = _mm256_setzero_ps();
+            __m256 _sum2 = _mm256_setzero_ps();
+            __m256 _sum3 = _mm256_setzero_ps();
+            __m256 _sum4 = _mm256_setzero_ps();
+            __m256 _sum5 = _mm256_setzero_ps();
+            __m256 _sum6 = _mm256_setzero_ps();
+            __m256 _sum7 = _mm256_setzero_ps();
+
+            const float* k0 = ktm;
+            for (int q=0; q<inch; q++)
+            {
+                __m256 _b = _mm256_loadu_ps(btm + q * 8);
+
+                _sum0 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0), _b, _sum0);
+                _sum1 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 1), _b, _sum1);
+                _sum2 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 2), _b, _sum2);
+                _sum3 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 3), _b, _sum3);
+                _sum4 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 4), _b, _sum4);
+                _sum5 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 5), _b, _sum5);
+                _sum6 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 6), _b, _sum6);
+                _sum7 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 7), _b, _sum7);
+
+                k0 += 8;
+            }
+
+            _mm256_storeu_ps(tt.row(p) + tb * 8, _sum0);
+            _mm256_storeu_ps(tt.row(p + 1) + tb * 8, _sum1);
+            _mm256_storeu_ps(tt.row(p + 2) + tb * 8, _sum2);
+            _mm256_storeu_ps(tt.row(p + 3) + tb * 8, _sum3);
+            _mm256_storeu_ps(tt.row(p + 4) + tb * 8, _sum4);
+            _mm256_storeu_ps(tt.row(p + 5) + tb * 8, _sum5);
+            _mm256_storeu_ps(tt.row(p + 6) + tb * 8, _sum6);
+            _mm256_storeu_ps(tt.row(p + 7) + tb * 8, _sum7);
+#else
+            float sum[8][8] = {{0.f}};
+
+            const float* k0 = ktm;
+            for (int q=0; q<inch; q++)
+            {
+                for (int i=0; i<8; i++)
+                {
+                    for (int n=0; n<8; n++)
+                    {
+                        sum[i][n] += k0[i] * btm[q * 8 + n];
+                    }
+                }
+
+                k0 += 8;
+            }
+
+            for (int i=0; i<8; i++)
+            {
+                float* outptr = tt.row(p + i) + tb * 8;
+                for (int n=0; n<8; n++)
+                {
+                    outptr[n] = sum[i][n];
+                }
+            }
+#endif // __AVX__
+        }
+    }
+
+    for (int p=remain_outch_start; p<outch; p++)
+    {
+        const float* ktm = kk.row(nn_outch + p - remain_outch_start);
+
+        for (int tb=0; tb<nn_tiles; tb++)
+        {
+            const float* btm = bb.row(tb);
+
+#if __AVX__
+            __m256 _sum = _mm256_setzero_ps();
+
+            for (int q=0; q<inch; q++)
+            {
+                _sum = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(ktm + q), _mm256_loadu_ps(btm + q * 8), _sum);
+            }
+
+            _mm256_storeu_ps(tt.row(p) + tb * 8, _sum);
+#else
+            float sum[8] = {0.f};
+
+            for (int q=0; q<inch; q++)
+            {
+                for (int n=0; n<8; n++)
+                {
+                    sum[n] += ktm[q] * btm[q * 8 + n];
+                }
+            }
+
+            float* outptr = tt.row(p) + tb * 8;
+            for (int n=0; n<8; n++)
+            {
+                outptr[n] = sum[n];
+            }
+#endif // __AVX__
+        }
+    }
+}
+
+// the output tiles of one channel
+struct conv3x3s1_winograd64_transform_output_sse_task : public ParallelTask
+{
+    conv3x3s1_winograd64_transform_output_sse_task(const Mat& _top_blob_tm, Mat& _top_blob_bordered, const float* _bias, const Mat& _activation_params, int _activation_type, int _outw, int _tiles_w, int _tiles, int _nn_tiles)
+        : top_blob_tm(_top_blob_tm), top_blob_bordered(_top_blob_bordered), bias(_bias), activation_params(_activation_params), activation_type(_activation_type), outw(_outw), tiles_w(_tiles_w), tiles(_tiles), nn_tiles(_nn_tiles)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    const Mat& top_blob_tm;
+    Mat& top_blob_bordered;
+    const float* bias;
+    const Mat& activation_params;
+    int activation_type;
+    int outw;
+    int tiles_w;
+    int tiles;
+    int nn_tiles;
+};
+
+void conv3x3s1_winograd64_transform_output_sse_task::execute(int p) const
+{
+    Mat out0 = top_blob_bordered.channel(p);
+
+    const float bias0 = bias ? bias[p] : 0.f;
+
+    for (int tb=0; tb<nn_tiles; tb++)
+    {
+        const int nn = std::min(8, tiles - tb * 8);
+
+        float* output0[8];
+        for (int n=0; n<nn; n++)
+        {
+            int t = tb * 8 + n;
+            output0[n] = out0.row(t / tiles_w * 6) + t % tiles_w * 6;
+        }
+
+#if __AVX__
+        // lanes are the 8 tiles
+        __m256 _tmp[6][8];
+        for (int i=0; i<8; i++)
+        {
+            __m256 _m[8];
+            for (int m=0; m<8; m++)
+            {
+                _m[m] = _mm256_loadu_ps(top_blob_tm.channel(i * 8 + m).row(p) + tb * 8);
+            }
+
+            __m256 _t[6];
+            winograd64_transform_output_avx(_m, _t);
+
+            for (int m=0; m<6; m++)
+            {
+                _tmp[m][i] = _t[m];
+            }
+        }
+
+        const __m256 _bias0 = _mm256_set1_ps(bias0);
+        const float slope = activation_type == 2 ? activation_params[0] : 0.f;
+        const __m256i _mask6 = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+
+        for (int m=0; m<6; m++)
+        {
+            __m256 _o[8];
+            winograd64_transform_output_avx(_tmp[m], _o);
+
+            for (int i=0; i<6; i++)
+            {
+                _o[i] = _mm256_activation_ps(_mm256_add_ps(_o[i], _bias0), activation_type, slope);
             }
+            _o[6] = _mm256_setzero_ps();
+            _o[7] = _mm256_setzero_ps();
+            transpose8_ps(_o);
 
-            for (; i < outh; i++)
+            for (int n=0; n<nn; n++)
             {
-                int remain = outw;
+                _mm256_maskstore_ps(output0[n] + m * outw, _mask6, _o[n]);
+            }
+        }
+#else
+        for (int n=0; n<nn; n++)
+        {
+            float tmp[6][8];
 
-                for (; remain>0; remain--)
+            for (int i=0; i<8; i++)
+            {
+                float r[8];
+                for (int m=0; m<8; m++)
                 {
-                    float sum = 0;
-
-                    sum += r0[0] * k0[0];
-                    sum += r0[1] * k0[1];
-                    sum += r0[2] * k0[2];
-                    sum += r1[0] * k1[0];
-                    sum += r1[1] * k1[1];
-                    sum += r1[2] * k1[2];
-                    sum += r2[0] * k2[0];
-                    sum += r2[1] * k2[1];
-                    sum += r2[2] * k2[2];
-
-                    *outptr += sum;
-
-                    r0++;
-                    r1++;
-                    r2++;
-                    outptr++;
+                    r[m] = top_blob_tm.channel(i * 8 + m).row(p)[tb * 8 + n];
                 }
 
-                r0 += 2;
-                r1 += 2;
-                r2 += 2;
+                float tmp024a = r[1] + r[2];
+                float tmp135a = r[1] - r[2];
+
+                float tmp024b = r[3] + r[4];
+                float tmp135b = r[3] - r[4];
+
+                float tmp024c = r[5] + r[6];
+                float tmp135c = r[5] - r[6];
+
+                tmp[0][i] = r[0] + tmp024a + tmp024b + tmp024c * 32;
+                tmp[2][i] = tmp024a + tmp024b * 4 + tmp024c * 8;
+                tmp[4][i] = tmp024a + tmp024b * 16 + tmp024c + tmp024c;
+
+                tmp[1][i] = tmp135a + tmp135b + tmp135b + tmp135c * 16;
+                tmp[3][i] = tmp135a + tmp135b * 8 + tmp135c * 4;
+                tmp[5][i] = r[7] + tmp135a + tmp135b * 32 + tmp135c;
             }
 
+            float* outptr = output0[n];
+
+            for (int m=0; m<6; m++)
+            {
+                const float* tmp0 = tmp[m];
+
+                float tmp024a = tmp0[1] + tmp0[2];
+                float tmp135a = tmp0[1] - tmp0[2];
+
+                float tmp024b = tmp0[3] + tmp0[4];
+                float tmp135b = tmp0[3] - tmp0[4];
+
+                float tmp024c = tmp0[5] + tmp0[6];
+                float tmp135c = tmp0[5] - tmp0[6];
+
+                outptr[0] = activation_ss(bias0 + tmp0[0] + tmp024a + tmp024b + tmp024c * 32, activation_type, activation_params);
+                outptr[2] = activation_ss(bias0 + tmp024a + tmp024b * 4 + tmp024c * 8, activation_type, activation_params);
+                outptr[4] = activation_ss(bias0 + tmp024a + tmp024b * 16 + tmp024c + tmp024c, activation_type, activation_params);
+
+                outptr[1] = activation_ss(bias0 + tmp135a + tmp135b + tmp135b + tmp135c * 16, activation_type, activation_params);
+                outptr[3] = activation_ss(bias0 + tmp135a + tmp135b * 8 + tmp135c * 4, activation_type, activation_params);
+                outptr[5] = activation_ss(bias0 + tmp0[7] + tmp135a + tmp135b * 32 + tmp135c, activation_type, activation_params);
+
+                outptr += outw;
+            }
         }
+#endif // __AVX__
+    }
+}
+
+} // namespace
+
+// the transformed input and output tiles for an outw x outh output
+static void conv3x3s1_winograd64_scratch_shape(int inch, int outch, int outw, int outh, Mat& bottom_tm_shape, Mat& top_tm_shape)
+{
+    const int nn_tiles = ((outw + 5) / 6 * ((outh + 5) / 6) + 7) / 8;
+
+    bottom_tm_shape = Mat(8*inch, nn_tiles, 64, (void*)0);
+    top_tm_shape = Mat(8*nn_tiles, outch, 64, (void*)0);
+}
+
+// bottom_blob_tm and top_blob_tm are shaped by conv3x3s1_winograd64_scratch_shape
+static void conv3x3s1_winograd64_sse(const Mat& bottom_blob, Mat& top_blob, Mat& bottom_blob_tm, Mat& top_blob_tm, const Mat& kernel_tm, const Mat& _bias, int pad_left, int pad_top, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int inch = bottom_blob.c;
+
+    int outw = top_blob.w;
+    int outh = top_blob.h;
+    int outch = top_blob.c;
+
+    // pad to 6n+2
+    Mat bottom_blob_bordered = bottom_blob;
+
+    outw = (outw + 5) / 6 * 6;
+    outh = (outh + 5) / 6 * 6;
+
+    w = outw + 2;
+    h = outh + 2;
+    if (pad_left > 0 || pad_top > 0 || w != bottom_blob.w || h != bottom_blob.h)
+    {
+        copy_make_border(bottom_blob, bottom_blob_bordered, pad_top, h - bottom_blob.h - pad_top, pad_left, w - bottom_blob.w - pad_left, 0, 0.f, opt.workspace_allocator);
+        if (bottom_blob_bordered.empty())
+            return;
+    }
+
+    const float* bias = _bias;
+
+    // 8 tiles are transformed and multiplied together, the last block repeats the last tile
+    const int tiles_w = outw / 6;
+    const int tiles = tiles_w * (outh / 6);
+    const int nn_tiles = (tiles + 7) / 8;
+
+    // BEGIN transform input
+    {
+//         const float itm[8][8] = {
+//             {1.0f,  0.0f, -5.25f,  0.00f,  5.25f,  0.00f, -1.0f, 0.0f},
+//
+//             {0.0f,  1.0f,  1.00f, -4.25f, -4.25f,  1.00f,  1.0f, 0.0f},
+//             {0.0f, -1.0f,  1.00f,  4.25f, -4.25f, -1.00f,  1.0f, 0.0f},
+//
+//             {0.0f,  0.5f,  0.25f, -2.50f, -1.25f,  2.00f,  1.0f, 0.0f},
+//             {0.0f, -0.5f,  0.25f,  2.50f, -1.25f, -2.00f,  1.0f, 0.0f},
+//
+//             {0.0f,  2.0f,  4.00f, -2.50f, -5.00f,  0.50f,  1.0f, 0.0f},
+//             {0.0f, -2.0f,  4.00f,  2.50f, -5.00f, -0.50f,  1.0f, 0.0f},
+//
+//             {0.0f, -1.0f,  0.00f,  5.25f,  0.00f, -5.25f,  0.0f, 1.0f}
+//         };
+
+        // 0 = r00 - r06 + (r04 - r02) * 5.25
+        // 7 = r07 - r01 + (r03 - r05) * 5.25
+
+        // 1 = (r02 + r06 - r04 * 4.25) + (r01 - r03 * 4.25 + r05)
+        // 2 = (r02 + r06 - r04 * 4.25) - (r01 - r03 * 4.25 + r05)
+
+        // 3 = (r06 + r02 * 0.25 - r04 * 1.25) + (r01 * 0.5 - r03 * 2.5 + r05 * 2)
+        // 4 = (r06 + r02 * 0.25 - r04 * 1.25) - (r01 * 0.5 - r03 * 2.5 + r05 * 2)
+
+        // reuse r04 * 1.25
+        // reuse r03 * 2.5
+        // 5 = (r06 + (r02 - r04 * 1.25) * 4) + (r01 * 2 - r03 * 2.5 + r05 * 0.5)
+        // 6 = (r06 + (r02 - r04 * 1.25) * 4) - (r01 * 2 - r03 * 2.5 + r05 * 0.5)
+
+        // panel r = horizontal * 8 + vertical, row = tile block, element = q * 8 + tile
+
+        conv3x3s1_winograd64_transform_input_sse_task task(bottom_blob_bordered, bottom_blob_tm, tiles_w, tiles, nn_tiles);
+
+        parallel_for(task, inch, opt);
+    }
+    bottom_blob_bordered = Mat();
+    // END transform input
+
+    // BEGIN dot
+    {
+        int nn_outch = outch >> 3;
+        int remain_outch_start = nn_outch << 3;
+
+        // 64 independent gemm, [outch x inch] x [inch x tiles]
+        conv3x3s1_winograd64_dot_sse_task task(bottom_blob_tm, kernel_tm, top_blob_tm, inch, outch, nn_outch, remain_outch_start, nn_tiles);
+
+        parallel_for(task, 64, opt);
+    }
+    bottom_blob_tm = Mat();
+    // END dot
+
+    // BEGIN transform output
+    Mat top_blob_bordered = top_blob;
+    if (outw != top_blob.w || outh != top_blob.h)
+    {
+        top_blob_bordered.create(outw, outh, outch, 4u, opt.workspace_allocator);
+        if (top_blob_bordered.empty())
+            return;
+    }
+    {
+//         const float otm[6][8] = {
+//             {1.0f,  1.0f,   1.0f,   1.0f,   1.0f,  32.0f, 32.0f, 0.0f},
+//             {0.0f,  1.0f,  -1.0f,   2.0f,  -2.0f,  16.0f,-16.0f, 0.0f},
+//             {0.0f,  1.0f,   1.0f,   4.0f,   4.0f,   8.0f,  8.0f, 0.0f},
+//             {0.0f,  1.0f,  -1.0f,   8.0f,  -8.0f,   4.0f, -4.0f, 0.0f},
+//             {0.0f,  1.0f,   1.0f,  16.0f,  16.0f,   2.0f,  2.0f, 0.0f},
+//             {0.0f,  1.0f,  -1.0f,  32.0f, -32.0f,   1.0f, -1.0f, 1.0f}
+//         };
+
+        // 0 = r0 + (r1 + r2) + (r3 + r4)     + (r5 + r6) * 32
+        // 1 =      (r1 - r2) + (r3 - r4) * 2 + (r5 - r6) * 16
+        // 2 =      (r1 + r2) + (r3 + r4) * 4 + (r5 + r6) * 8
+        // 3 =      (r1 - r2) + (r3 - r4) * 8 + (r5 - r6) * 4
+        // 4 =      (r1 + r2) + (r3 + r4) * 16+ (r5 + r6) * 2
+        // 5 = r7 + (r1 - r2) + (r3 - r4) * 32+ (r5 - r6)
+
+        conv3x3s1_winograd64_transform_output_sse_task task(top_blob_tm, top_blob_bordered, bias, activation_params, activation_type, outw, tiles_w, tiles, nn_tiles);
+
+        parallel_for(task, outch, opt);
     }
+    // END transform output
 
+    // cut result pad
+    if (top_blob_bordered.data != top_blob.data)
+        copy_cut_border(top_blob_bordered, top_blob, 0, top_blob_bordered.h - top_blob.h, 0, top_blob_bordered.w - top_blob.w, opt.blob_allocator);
 }
@@ -0,0 +1,679 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// A = kernel_tm, 8 output channels interleaved per row, remaining output channels one per row
+// B = bottom_tm, SGEMM_COLS columns interleaved per row, remaining columns one per row
+// C = top_blob, column j of output channel p is top_blob.channel(p)[j]
+
+namespace {
+
+// 8 output channels interleaved in one row
+struct conv_sgemm_transform_kernel_sse_task : public ParallelTask
+{
+    conv_sgemm_transform_kernel_sse_task(Mat& _kernel_tm, const Mat& _kernel, int _K)
+        : kernel_tm(_kernel_tm), kernel(_kernel), K(_K)
+    {
+    }
+
+    virtual void execute(int pp) const;
+
+    Mat& kernel_tm;
+    const Mat& kernel;
+    int K;
+};
+
+void conv_sgemm_transform_kernel_sse_task::execute(int pp) const
+{
+    int p = pp * 8;
+
+    float* ktmp = kernel_tm.row(pp);
+
+    for (int k=0; k<K; k++)
+    {
+        for (int i=0; i<8; i++)
+        {
+            ktmp[i] = ((const float*)kernel)[(p + i) * K + k];
+        }
+
+        ktmp += 8;
+    }
+}
+
+// one remaining output channel
+struct conv_sgemm_transform_kernel_remain_sse_task : public ParallelTask
+{
+    conv_sgemm_transform_kernel_remain_sse_task(Mat& _kernel_tm, const Mat& _kernel, int _nn_outch, int _remain_outch_start, int _K)
+        : kernel_tm(_kernel_tm), kernel(_kernel), nn_outch(_nn_outch), remain_outch_start(_remain_outch_start), K(_K)
+    {
+    }
+
+    virtual void execute(int index) const;
+
+    Mat& kernel_tm;
+    const Mat& kernel;
+    int nn_outch;
+    int remain_outch_start;
+    int K;
+};
+
+void conv_sgemm_transform_kernel_remain_sse_task::execute(int index) const
+{
+    const int p = remain_outch_start + index;
+
+    float* ktmp = kernel_tm.row(nn_outch + p - remain_outch_start);
+
+    const float* k0 = (const float*)kernel + p * K;
+
+    for (int k=0; k<K; k++)
+    {
+        ktmp[k] = k0[k];
+    }
+}
+
+} // namespace
+
+static void conv_sgemm_transform_kernel_sse(const Mat& kernel, Mat& kernel_tm, int inch, int outch, int maxk)
+{
+    const int K = inch * maxk;
+
+    int nn_outch = outch >> 3;
+    int remain_outch_start = nn_outch << 3;
+
+    kernel_tm.create(8*K, nn_outch + outch - remain_outch_start);
+
+    conv_sgemm_transform_kernel_sse_task task(kernel_tm, kernel, K);
+
+    parallel_for(task, nn_outch, get_default_option());
+
+    conv_sgemm_transform_kernel_remain_sse_task remain_task(kernel_tm, kernel, nn_outch, remain_outch_start, K);
+
+    parallel_for(remain_task, outch - remain_outch_start, get_default_option());
+}
+
+// columns interleaved per B row, one zmm wide on avx512
+#if __AVX512F__
+#define SGEMM_COLS 16
+#else
+#define SGEMM_COLS 8
+#endif
+
+namespace {
+
+// one A row against one block of B rows, the blocks of B outermost
+// in an anonymous namespace as every isa build of the layer has its own copy
+struct conv_sgemm_sse_task : public ParallelTask
+{
+    conv_sgemm_sse_task(const Mat& _bottom_tm, Mat& _top_blob, const Mat& _kernel_tm, const float* _bias, const Mat& _activation_params, int _activation_type, int _K, int _nn_outch, int _remain_outch_start, int _nn_col, int _remain_col_start, int _nn_A, int _nn_B, int _B_block)
+        : bottom_tm(_bottom_tm), top_blob(_top_blob), kernel_tm(_kernel_tm), bias(_bias), activation_params(_activation_params), activation_type(_activation_type), K(_K), nn_outch(_nn_outch), remain_outch_start(_remain_outch_start), nn_col(_nn_col), remain_col_start(_remain_col_start), nn_A(_nn_A), nn_B(_nn_B), B_block(_B_block)
+    {
+    }
+
+    virtual void execute(int index) const;
+
+    const Mat& bottom_tm;
+    Mat& top_blob;
+    const Mat& kernel_tm;
+    const float* bias;
+    const Mat& activation_params;
+    int activation_type;
+    int K;
+    int nn_outch;
+    int remain_outch_start;
+    int nn_col;
+    int remain_col_start;
+    int nn_A;
+    int nn_B;
+    int B_block;
+};
+
+void conv_sgemm_sse_task::execute(int index) const
+{
+    const int bb = index / nn_A;
+    const int a = index % nn_A;
+
+    const float* ktmp = kernel_tm.row(a);
+
+    const int b_end = std::min(nn_B, (bb + 1) * B_block);
+
+    // the fused activation is applied to the sums before they are stored
+    const float slope = activation_type == 2 ? activation_params[0] : 0.f;
+
+    if (a < nn_outch)
+    {
+        const int p = a * 8;
+
+        float bias8[8];
+        for (int i=0; i<8; i++)
+        {
+            bias8[i] = bias ? bias[p + i] : 0.f;
+        }
+
+        float* outptr[8];
+        for (int i=0; i<8; i++)
+        {
+            outptr[i] = top_blob.channel(p + i);
+        }
+
+        for (int b=bb * B_block; b<b_end; b++)
+        {
+            const float* btmp = bottom_tm.row(b);
+            const float* k0 = ktmp;
+
+            if (b < nn_col)
+            {
+                const int j = b * SGEMM_COLS;
+
+                // 8 output channels x SGEMM_COLS columns
+#if __AVX512F__
+                __m512 _sum0 = _mm512_set1_ps(bias8[0]);
+                __m512 _sum1 = _mm512_set1_ps(bias8[1]);
+                __m512 _sum2 = _mm512_set1_ps(bias8[2]);
+                __m512 _sum3 = _mm512_set1_ps(bias8[3]);
+                __m512 _sum4 = _mm512_set1_ps(bias8[4]);
+                __m512 _sum5 = _mm512_set1_ps(bias8[5]);
+                __m512 _sum6 = _mm512_set1_ps(bias8[6]);
+                __m512 _sum7 = _mm512_set1_ps(bias8[7]);
+
+                for (int k=0; k<K; k++)
+                {
+                    __m512 _b = _mm512_loadu_ps(btmp);
+
+                    _sum0 = _mm512_fmadd_ps(_mm512_set1_ps(k0[0]), _b, _sum0);
+                    _sum1 = _mm512_fmadd_ps(_mm512_set1_ps(k0[1]), _b, _sum1);
+                    _sum2 = _mm512_fmadd_ps(_mm512_set1_ps(k0[2]), _b, _sum2);
+                    _sum3 = _mm512_fmadd_ps(_mm512_set1_ps(k0[3]), _b, _sum3);
+                    _sum4 = _mm512_fmadd_ps(_mm512_set1_ps(k0[4]), _b, _sum4);
+                    _sum5 = _mm512_fmadd_ps(_mm512_set1_ps(k0[5]), _b, _sum5);
+                    _sum6 = _mm512_fmadd_ps(_mm512_set1_ps(k0[6]), _b, _sum6);
+                    _sum7 = _mm512_fmadd_ps(_mm512_set1_ps(k0[7]), _b, _sum7);
+
+                    btmp += 16;
+                    k0 += 8;
+                }
+
+                _mm512_storeu_ps(outptr[0] + j, _mm512_activation_ps(_sum0, activation_type, slope));
+                _mm512_storeu_ps(outptr[1] + j, _mm512_activation_ps(_sum1, activation_type, slope));
+                _mm512_storeu_ps(outptr[2] + j, _mm512_activation_ps(_sum2, activation_type, slope));
+                _mm512_storeu_ps(outptr[3] + j, _mm512_activation_ps(_sum3, activation_type, slope));
+                _mm512_storeu_ps(outptr[4] + j, _mm512_activation_ps(_sum4, activation_type, slope));
+                _mm512_storeu_ps(outptr[5] + j, _mm512_activation_ps(_sum5, activation_type, slope));
+                _mm512_storeu_ps(outptr[6] + j, _mm512_activation_ps(_sum6, activation_type, slope));
+                _mm512_storeu_ps(outptr[7] + j, _mm512_activation_ps(_sum7, activation_type, slope));
+#elif __AVX__
+                __m256 _sum0 = _mm256_set1_ps(bias8[0]);
+                __m256 _sum1 = _mm256_set1_ps(bias8[1]);
+                __m256 _sum2 = _mm256_set1_ps(bias8[2]);
+                __m256 _sum3 = _mm256_set1_ps(bias8[3]);
+                __m256 _sum4 = _mm256_set1_ps(bias8[4]);
+                __m256 _sum5 = _mm256_set1_ps(bias8[5]);
+                __m256 _sum6 = _mm256_set1_ps(bias8[6]);
+                __m256 _sum7 = _mm256_set1_ps(bias8[7]);
+
+                for (int k=0; k<K; k++)
+                {
+                    __m256 _b = _mm256_loadu_ps(btmp);
+
+                    _sum0 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0), _b, _sum0);
+                    _sum1 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 1), _b, _sum1);
+                    _sum2 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 2), _b, _sum2);
+                    _sum3 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 3), _b, _sum3);
+                    _sum4 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 4), _b, _sum4);
+                    _sum5 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 5), _b, _sum5);
+                    _sum6 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 6), _b, _sum6);
+                    _sum7 = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0 + 7), _b, _sum7);
+
+                    btmp += 8;
+                    k0 += 8;
+                }
+
+                _mm256_storeu_ps(outptr[0] + j, _mm256_activation_ps(_sum0, activation_type, slope));
+                _mm256_storeu_ps(outptr[1] + j, _mm256_activation_ps(_sum1, activation_type, slope));
+                _mm256_storeu_ps(outptr[2] + j, _mm256_activation_ps(_sum2, activation_type, slope));
+                _mm256_storeu_ps(outptr[3] + j, _mm256_activation_ps(_sum3, activation_type, slope));
+                _mm256_storeu_ps(outptr[4] + j, _mm256_activation_ps(_sum4, activation_type, slope));
+                _mm256_storeu_ps(outptr[5] + j, _mm256_activation_ps(_sum5, activation_type, slope));
+                _mm256_storeu_ps(outptr[6] + j, _mm256_activation_ps(_sum6, activation_type, slope));
+                _mm256_storeu_ps(outptr[7] + j, _mm256_activation_ps(_sum7, activation_type, slope));
+#elif __SSE2__
+                // two passes of 4 output channels keep the 8 accumulators in registers
+                for (int h=0; h<8; h+=4)
+                {
+                    const float* kh = k0 + h;
+                    const float* bh = btmp;
+
+                    __m128 _sum0l = _mm_set1_ps(bias8[h]);
+                    __m128 _sum0h = _sum0l;
+                    __m128 _sum1l = _mm_set1_ps(bias8[h + 1]);
+                    __m128 _sum1h = _sum1l;
+                    __m128 _sum2l = _mm_set1_ps(bias8[h + 2]);
+                    __m128 _sum2h = _sum2l;
+                    __m128 _sum3l = _mm_set1_ps(bias8[h + 3]);
+                    __m128 _sum3h = _sum3l;
+
+                    for (int k=0; k<K; k++)
+                    {
+                        __m128 _bl = _mm_loadu_ps(bh);
+                        __m128 _bh = _mm_loadu_ps(bh + 4);
+
+                        __m128 _k0 = _mm_load1_ps(kh);
+                        __m128 _k1 = _mm_load1_ps(kh + 1);
+                        __m128 _k2 = _mm_load1_ps(kh + 2);
+                        __m128 _k3 = _mm_load1_ps(kh + 3);
+
+                        _sum0l = _mm_comp_fmadd_ps(_k0, _bl, _sum0l);
+                        _sum0h = _mm_comp_fmadd_ps(_k0, _bh, _sum0h);
+                        _sum1l = _mm_comp_fmadd_ps(_k1, _bl, _sum1l);
+                        _sum1h = _mm_comp_fmadd_ps(_k1, _bh, _sum1h);
+                        _sum2l = _mm_comp_fmadd_ps(_k2, _bl, _sum2l);
+                        _sum2h = _mm_comp_fmadd_ps(_k2, _bh, _sum2h);
+                        _sum3l = _mm_comp_fmadd_ps(_k3, _bl, _sum3l);
+                        _sum3h = _mm_comp_fmadd_ps(_k3, _bh, _sum3h);
+
+                        bh += 8;
+                        kh += 8;
+                    }
+
+                    _mm_storeu_ps(outptr[h] + j, _mm_activation_ps(_sum0l, activation_type, slope));
+                    _mm_storeu_ps(outptr[h] + j + 4, _mm_activation_ps(_sum0h, activation_type, slope));
+                    _mm_storeu_ps(outptr[h + 1] + j, _mm_activation_ps(_sum1l, activation_type, slope));
+                    _mm_storeu_ps(outptr[h + 1] + j + 4, _mm_activation_ps(_sum1h, activation_type, slope));
+                    _mm_storeu_ps(outptr[h + 2] + j, _mm_activation_ps(_sum2l, activation_type, slope));
+                    _mm_storeu_ps(outptr[h + 2] + j + 4, _mm_activation_ps(_sum2h, activation_type, slope));
+                    _mm_storeu_ps(outptr[h + 3] + j, _mm_activation_ps(_sum3l, activation_type, slope));
+                    _mm_storeu_ps(outptr[h + 3] + j + 4, _mm_activation_ps(_sum3h, activation_type, slope));
+                }
+#else
+                float sum[8][8];
+                for (int i=0; i<8; i++)
+                {
+                    for (int n=0; n<8; n++)
+                    {
+                        sum[i][n] = bias8[i];
+                    }
+                }
+
+                for (int k=0; k<K; k++)
+                {
+                    for (int i=0; i<8; i++)
+                    {
+                        for (int n=0; n<8; n++)
+                        {
+                            sum[i][n] += k0[i] * btmp[n];
+                        }
+                    }
+
+                    btmp += 8;
+                    k0 += 8;
+                }
+
+                for (int i=0; i<8; i++)
+                {
+                    for (int n=0; n<8; n++)
+                    {
+                        outptr[i][j + n] = activation_ss(sum[i][n], activation_type, activation_params);
+                    }
+                }
+#endif // __AVX__
+            }
+            else
+            {
+                const int j = remain_col_start + b - nn_col;
+
+                // 8 output channels x 1 column
+#if __AVX__
+                __m256 _sum = _mm256_loadu_ps(bias8);
+
+                for (int k=0; k<K; k++)
+                {
+                    _sum = _mm256_comp_fmadd_ps(_mm256_loadu_ps(k0), _mm256_broadcast_ss(btmp), _sum);
+
+                    btmp += 1;
+                    k0 += 8;
+                }
+
+                float sum[8];
+                _mm256_storeu_ps(sum, _sum);
+#else
+                float sum[8];
+                for (int i=0; i<8; i++)
+                {
+                    sum[i] = bias8[i];
+                }
+
+                for (int k=0; k<K; k++)
+                {
+                    for (int i=0; i<8; i++)
+                    {
+                        sum[i] += k0[i] * btmp[0];
+                    }
+
+                    btmp += 1;
+                    k0 += 8;
+                }
+#endif // __AVX__
+
+                for (int i=0; i<8; i++)
+                {
+                    outptr[i][j] = activation_ss(sum[i], activation_type, activation_params);
+                }
+            }
+        }
+    }
+    else
+    {
+        const int p = remain_outch_start + a - nn_outch;
+
+        const float bias0 = bias ? bias[p] : 0.f;
+
+        float* outptr = top_blob.channel(p);
+
+        for (int b=bb * B_block; b<b_end; b++)
+        {
+            const float* btmp = bottom_tm.row(b);
+            const float* k0 = ktmp;
+
+            if (b < nn_col)
+            {
+                const int j = b * SGEMM_COLS;
+
+                // 1 output channel x SGEMM_COLS columns
+#if __AVX512F__
+                __m512 _sum = _mm512_set1_ps(bias0);
+
+                for (int k=0; k<K; k++)
+                {
+                    _sum = _mm512_fmadd_ps(_mm512_set1_ps(k0[0]), _mm512_loadu_ps(btmp), _sum);
+
+                    btmp += 16;
+                    k0 += 1;
+                }
+
+                _mm512_storeu_ps(outptr + j, _mm512_activation_ps(_sum, activation_type, slope));
+#elif __AVX__
+                __m256 _sum = _mm256_set1_ps(bias0);
+
+                for (int k=0; k<K; k++)
+                {
+                    _sum = _mm256_comp_fmadd_ps(_mm256_broadcast_ss(k0), _mm256_loadu_ps(btmp), _sum);
+
+                    btmp += 8;
+                    k0 += 1;
+                }
+
+                _mm256_storeu_ps(outptr + j, _mm256_activation_ps(_sum, activation_type, slope));
+#else
+                float sum[8];
+                for (int n=0; n<8; n++)
+                {
+                    sum[n] = bias0;
+                }
+
+                for (int k=0; k<K; k++)
+                {
+                    for (int n=0; n<8; n++)
+                    {
+                        sum[n] += k0[0] * btmp[n];
+                    }
+
+                    btmp += 8;
+                    k0 += 1;
+                }
+
+                for (int n=0; n<8; n++)
+                {
+                    outptr[j + n] = activation_ss(sum[n], activation_type, activation_params);
+                }
+#endif // __AVX__
+            }
+            else
+            {
+                const int j = remain_col_start + b - nn_col;
+
+                float sum = bias0;
+
+                for (int k=0; k<K; k++)
+                {
+                    sum += k0[k] * btmp[k];
+                }
+
+                outptr[j] = activation_ss(sum, activation_type, activation_params);
+            }
+        }
+    }
+}
+
+} // namespace
+
+// the packed columns conv_sgemm_sse reads, K rows for N output pixels
+static Mat conv_sgemm_scratch_shape(int K, int N)
+{
+    int nn_col = N / SGEMM_COLS;
+    int remain_col_start = nn_col * SGEMM_COLS;
+
+    return Mat(SGEMM_COLS*K, nn_col + N - remain_col_start, (void*)0);
+}
+
+static void conv_sgemm_sse(const Mat& bottom_tm, Mat& top_blob, const Mat& kernel_tm, const Mat& _bias, int K, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    const int N = top_blob.w * top_blob.h;
+    const int outch = top_blob.c;
+
+    const float* bias = _bias;
+
+    int nn_outch = outch >> 3;
+    int remain_outch_start = nn_outch << 3;
+
+    int nn_col = N / SGEMM_COLS;
+    int remain_col_start = nn_col * SGEMM_COLS;
+
+    const int nn_A = nn_outch + outch - remain_outch_start;
+    const int nn_B = nn_col + N - remain_col_start;
+
+    // blocks of B that stay in l2 while every A row passes over them
+    const int B_block = std::max(1, (int)(256 * 1024 / (K * SGEMM_COLS * sizeof(float))));
+    const int nn_B_block = (nn_B + B_block - 1) / B_block;
+
+    conv_sgemm_sse_task task(bottom_tm, top_blob, kernel_tm, bias, activation_params, activation_type, K, nn_outch, remain_outch_start, nn_col, remain_col_start, nn_A, nn_B, B_block);
+
+    // parallel over both output channels and columns, few output channels still keep every thread busy
+    parallel_for(task, nn_B_block * nn_A, opt);
+}
+
+namespace {
+
+// one row of B, SGEMM_COLS columns or one remaining column
+struct conv_im2col_sse_task : public ParallelTask
+{
+    conv_im2col_sse_task(const Mat& _bottom_blob, Mat& _bottom_tm, int _kernel_w, int _kernel_h, int _dilation_w, int _dilation_h, int _stride_w, int _stride_h, int _pad_left, int _pad_top, int _outw, int _maxk, int _kernel_extent_w, int _kernel_extent_h, int _nn_col, int _remain_col_start, const int* _space_ofs)
+        : bottom_blob(_bottom_blob), bottom_tm(_bottom_tm), kernel_w(_kernel_w), kernel_h(_kernel_h), dilation_w(_dilation_w), dilation_h(_dilation_h), stride_w(_stride_w), stride_h(_stride_h), pad_left(_pad_left), pad_top(_pad_top), outw(_outw), maxk(_maxk), kernel_extent_w(_kernel_extent_w), kernel_extent_h(_kernel_extent_h), nn_col(_nn_col), remain_col_start(_remain_col_start), space_ofs(_space_ofs)
+    {
+    }
+
+    virtual void execute(int b) const;
+
+    const Mat& bottom_blob;
+    Mat& bottom_tm;
+    int kernel_w;
+    int kernel_h;
+    int dilation_w;
+    int dilation_h;
+    int stride_w;
+    int stride_h;
+    int pad_left;
+    int pad_top;
+    int outw;
+    int maxk;
+    int kernel_extent_w;
+    int kernel_extent_h;
+    int nn_col;
+    int remain_col_start;
+    const int* space_ofs;
+};
+
+void conv_im2col_sse_task::execute(int b) const
+{
+    const int w = bottom_blob.w;
+    const int h = bottom_blob.h;
+    const int inch = bottom_blob.c;
+
+    if (b >= nn_col)
+    {
+        const int j = remain_col_start + b - nn_col;
+
+        const int x0 = j % outw * stride_w - pad_left;
+        const int y0 = j / outw * stride_h - pad_top;
+        const bool inside = x0 >= 0 && x0 + kernel_extent_w <= w && y0 >= 0 && y0 + kernel_extent_h <= h;
+
+        float* btmp = bottom_tm.row(b);
+
+        for (int q=0; q<inch; q++)
+        {
+            const float* img0 = bottom_blob.channel(q);
+
+            if (inside)
+            {
+                const float* sptr = img0 + y0 * w + x0;
+
+                for (int k=0; k<maxk; k++)
+                {
+                    btmp[k] = sptr[space_ofs[k]];
+                }
+            }
+            else
+            {
+                for (int k=0; k<maxk; k++)
+                {
+                    const int y = y0 + k / kernel_w * dilation_h;
+                    const int x = x0 + k % kernel_w * dilation_w;
+                    btmp[k] = (y >= 0 && y < h && x >= 0 && x < w) ? img0[y * w + x] : 0.f;
+                }
+            }
+
+            btmp += maxk;
+        }
+
+        return;
+    }
+
+    const int j = b * SGEMM_COLS;
+
+    // top left tap of every column
+    int x0[SGEMM_COLS];
+    int y0[SGEMM_COLS];
+    bool inside = true;
+    for (int n=0; n<SGEMM_COLS; n++)
+    {
+        x0[n] = (j + n) % outw * stride_w - pad_left;
+        y0[n] = (j + n) / outw * stride_h - pad_top;
+        inside = inside && x0[n] >= 0 && x0[n] + kernel_extent_w <= w && y0[n] >= 0 && y0[n] + kernel_extent_h <= h;
+    }
+
+    float* btmp = bottom_tm.row(b);
+
+    if (inside)
+    {
+        int ofs[SGEMM_COLS];
+        for (int n=0; n<SGEMM_COLS; n++)
+        {
+            ofs[n] = y0[n] * w + x0[n];
+        }
+
+        for (int q=0; q<inch; q++)
+        {
+            const float* img0 = bottom_blob.channel(q);
+
+            for (int k=0; k<maxk; k++)
+            {
+                const float* sptr = img0 + space_ofs[k];
+
+                for (int n=0; n<SGEMM_COLS; n++)
+                {
+                    btmp[n] = sptr[ofs[n]];
+                }
+
+                btmp += SGEMM_COLS;
+            }
+        }
+
+        return;
+    }
+
+    for (int q=0; q<inch; q++)
+    {
+        const float* img0 = bottom_blob.channel(q);
+
+        for (int ky=0; ky<kernel_h; ky++)
+        {
+            for (int kx=0; kx<kernel_w; kx++)
+            {
+                for (int n=0; n<SGEMM_COLS; n++)
+                {
+                    const int y = y0[n] + ky * dilation_h;
+                    const int x = x0[n] + kx * dilation_w;
+                    btmp[n] = (y >= 0 && y < h && x >= 0 && x < w) ? img0[y * w + x] : 0.f;
+                }
+
+                btmp += SGEMM_COLS;
+            }
+        }
+    }
+}
+
+} // namespace
+
+// taps falling into the pad_left pad_top border read zero, no padded copy of the input
+static void conv_im2col_sgemm_sse(const Mat& bottom_blob, Mat& top_blob, Mat& bottom_tm, const Mat& kernel_tm, const Mat& _bias, int kernel_w, int kernel_h, int dilation_w, int dilation_h, int stride_w, int stride_h, int pad_left, int pad_top, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    int w = bottom_blob.w;
+    int inch = bottom_blob.c;
+
+    int outw = top_blob.w;
+    int outh = top_blob.h;
+
+    const int maxk = kernel_w * kernel_h;
+    const int K = inch * maxk;
+    const int N = outw * outh;
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    // im2col straight into the packed B layout of bottom_tm, shaped by conv_sgemm_scratch_shape
+    int nn_col = N / SGEMM_COLS;
+    int remain_col_start = nn_col * SGEMM_COLS;
+
+    // offset of every kernel tap inside one input channel
+    std::vector<int> _space_ofs(maxk);
+    int* space_ofs = &_space_ofs[0];
+    {
+        int p1 = 0;
+        int p2 = 0;
+        int gap = w * dilation_h - kernel_w * dilation_w;
+        for (int i = 0; i < kernel_h; i++)
+        {
+            for (int j = 0; j < kernel_w; j++)
+            {
+                space_ofs[p1] = p2;
+                p1++;
+                p2 += dilation_w;
+            }
+            p2 += gap;
+        }
+    }
+
+    conv_im2col_sse_task task(bottom_blob, bottom_tm, kernel_w, kernel_h, dilation_w, dilation_h, stride_w, stride_h, pad_left, pad_top, outw, maxk, kernel_extent_w, kernel_extent_h, nn_col, remain_col_start, space_ofs);
+
+    parallel_for(task, nn_col + N - remain_col_start, opt);
+
+    conv_sgemm_sse(bottom_tm, top_blob, kernel_tm, _bias, K, activation_type, activation_params, opt);
+}
@@ -0,0 +1,513 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// K is taken in pairs, one int32 lane of madd sums the products of a pair
+// A = kernel_tm, int8, 8 output channels interleaved per row, zero padded to whole blocks
+//     pair : out0 k0 k1, out1 k0 k1, ... out7 k0 k1
+// B = bottom_tm, int16, 8 columns interleaved per row, remaining columns one per row
+//     pair : col0 k0 k1, col1 k0 k1, ... col7 k0 k1
+// C = top_blob_int32, column j of output channel p is top_blob_int32.channel(p)[j]
+
+#define SGEMM_INT8_COLS 8
+
+namespace {
+
+// 8 output channels interleaved in one row
+struct conv_sgemm_int8_transform_kernel_sse_task : public ParallelTask
+{
+    conv_sgemm_int8_transform_kernel_sse_task(Mat& _kernel_tm, const Mat& _kernel, int _outch, int _K, int _KK)
+        : kernel_tm(_kernel_tm), kernel(_kernel), outch(_outch), K(_K), KK(_KK)
+    {
+    }
+
+    virtual void execute(int pp) const;
+
+    Mat& kernel_tm;
+    const Mat& kernel;
+    int outch;
+    int K;
+    int KK;
+};
+
+void conv_sgemm_int8_transform_kernel_sse_task::execute(int pp) const
+{
+    signed char* ktmp = kernel_tm.row<signed char>(pp);
+
+    for (int kk=0; kk<KK; kk++)
+    {
+        for (int i=0; i<8; i++)
+        {
+            const int p = pp * 8 + i;
+
+            for (int l=0; l<2; l++)
+            {
+                const int k = kk * 2 + l;
+                ktmp[l] = p < outch && k < K ? ((const signed char*)kernel)[p * K + k] : 0;
+            }
+
+            ktmp += 2;
+        }
+    }
+}
+
+} // namespace
+
+static void conv_sgemm_int8_transform_kernel_sse(const Mat& kernel, Mat& kernel_tm, int inch, int outch, int maxk)
+{
+    const int K = inch * maxk;
+    const int KK = (K + 1) / 2;
+
+    const int nn_outch = (outch + 7) / 8;
+
+    kernel_tm.create(KK * 16, nn_outch, (size_t)1u);
+
+    conv_sgemm_int8_transform_kernel_sse_task task(kernel_tm, kernel, outch, K, KK);
+
+    parallel_for(task, nn_outch, get_default_option());
+}
+
+namespace {
+
+// one A row against one block of B rows
+struct conv_sgemm_int8_sse_task : public ParallelTask
+{
+    conv_sgemm_int8_sse_task(Mat& _top_blob_int32, const Mat& _kernel_tm, const Mat& _bottom_tm, int _outch, int _KK, int _nn_outch, int _nn_col, int _remain_col_start, int _nn_B, int _B_block)
+        : top_blob_int32(_top_blob_int32), kernel_tm(_kernel_tm), bottom_tm(_bottom_tm), outch(_outch), KK(_KK), nn_outch(_nn_outch), nn_col(_nn_col), remain_col_start(_remain_col_start), nn_B(_nn_B), B_block(_B_block)
+    {
+    }
+
+    virtual void execute(int index) const;
+
+    Mat& top_blob_int32;
+    const Mat& kernel_tm;
+    const Mat& bottom_tm;
+    int outch;
+    int KK;
+    int nn_outch;
+    int nn_col;
+    int remain_col_start;
+    int nn_B;
+    int B_block;
+};
+
+void conv_sgemm_int8_sse_task::execute(int index) const
+{
+    const int bb = index / nn_outch;
+    const int pp = index % nn_outch;
+
+    const int p = pp * 8;
+    const int np = std::min(8, outch - p);
+
+    int* outptr[8];
+    for (int i=0; i<np; i++)
+    {
+        outptr[i] = top_blob_int32.channel(p + i);
+    }
+
+    const int b_end = std::min(nn_B, (bb + 1) * B_block);
+
+    for (int b=bb * B_block; b<b_end; b++)
+    {
+        const signed char* k0 = kernel_tm.row<signed char>(pp);
+        const short* btmp = bottom_tm.row<short>(b);
+
+        if (b < nn_col)
+        {
+            const int j = b * SGEMM_INT8_COLS;
+
+            // 8 output channels x 8 columns, a sum per column with the output channels in the lanes
+#if __AVX2__
+            __m256i _sum[8];
+            for (int n=0; n<8; n++)
+                _sum[n] = _mm256_setzero_si256();
+
+            for (int kk=0; kk<KK; kk++)
+            {
+                __m256i _w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)k0));
+
+                for (int n=0; n<8; n++)
+                    _sum[n] = _mm256_add_epi32(_sum[n], _mm256_madd_epi16(_w, _mm256_set1_epi32(((const int*)btmp)[n])));
+
+                k0 += 16;
+                btmp += 16;
+            }
+
+            // one output channel per row
+            __m256 _out[8];
+            for (int n=0; n<8; n++)
+                _out[n] = _mm256_castsi256_ps(_sum[n]);
+
+            transpose8_ps(_out);
+
+            for (int i=0; i<np; i++)
+                _mm256_storeu_ps((float*)(outptr[i] + j), _out[i]);
+#elif __SSE2__
+            // 4 columns at a time keep the sums in registers
+            for (int n4=0; n4<8; n4+=4)
+            {
+                const signed char* k0n = k0;
+                const short* btmpn = btmp + n4 * 2;
+
+                __m128i _sum0[4];
+                __m128i _sum1[4];
+                for (int n=0; n<4; n++)
+                {
+                    _sum0[n] = _mm_setzero_si128();
+                    _sum1[n] = _mm_setzero_si128();
+                }
+
+                for (int kk=0; kk<KK; kk++)
+                {
+                    __m128i _w01 = _mm_loadu_si128((const __m128i*)k0n);
+                    __m128i _w0 = _mm_comp_cvtepi8_epi16(_w01);
+                    __m128i _w1 = _mm_comp_cvtepi8_epi16(_mm_unpackhi_epi64(_w01, _w01));
+
+                    for (int n=0; n<4; n++)
+                    {
+                        __m128i _b = _mm_set1_epi32(((const int*)btmpn)[n]);
+                        _sum0[n] = _mm_add_epi32(_sum0[n], _mm_madd_epi16(_w0, _b));
+                        _sum1[n] = _mm_add_epi32(_sum1[n], _mm_madd_epi16(_w1, _b));
+                    }
+
+                    k0n += 16;
+                    btmpn += 16;
+                }
+
+                __m128 _out0[4];
+                __m128 _out1[4];
+                for (int n=0; n<4; n++)
+                {
+                    _out0[n] = _mm_castsi128_ps(_sum0[n]);
+                    _out1[n] = _mm_castsi128_ps(_sum1[n]);
+                }
+
+                _MM_TRANSPOSE4_PS(_out0[0], _out0[1], _out0[2], _out0[3]);
+                _MM_TRANSPOSE4_PS(_out1[0], _out1[1], _out1[2], _out1[3]);
+
+                for (int i=0; i<np; i++)
+                    _mm_storeu_ps((float*)(outptr[i] + j + n4), i < 4 ? _out0[i] : _out1[i - 4]);
+            }
+#else
+            int sum[8][8] = {{0}};
+
+            for (int kk=0; kk<KK; kk++)
+            {
+                for (int n=0; n<8; n++)
+                {
+                    for (int i=0; i<8; i++)
+                        sum[i][n] += k0[i * 2] * btmp[n * 2] + k0[i * 2 + 1] * btmp[n * 2 + 1];
+                }
+
+                k0 += 16;
+                btmp += 16;
+            }
+
+            for (int i=0; i<np; i++)
+            {
+                for (int n=0; n<8; n++)
+                    outptr[i][j + n] = sum[i][n];
+            }
+#endif // __AVX2__
+        }
+        else
+        {
+            const int j = remain_col_start + b - nn_col;
+
+            // 8 output channels x 1 column
+            int sum[8];
+#if __AVX2__
+            __m256i _sum = _mm256_setzero_si256();
+
+            for (int kk=0; kk<KK; kk++)
+            {
+                __m256i _w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)k0));
+                _sum = _mm256_add_epi32(_sum, _mm256_madd_epi16(_w, _mm256_set1_epi32(((const int*)btmp)[0])));
+
+                k0 += 16;
+                btmp += 2;
+            }
+
+            _mm256_storeu_si256((__m256i*)sum, _sum);
+#elif __SSE2__
+            __m128i _sum0 = _mm_setzero_si128();
+            __m128i _sum1 = _mm_setzero_si128();
+
+            for (int kk=0; kk<KK; kk++)
+            {
+                __m128i _w01 = _mm_loadu_si128((const __m128i*)k0);
+                __m128i _b = _mm_set1_epi32(((const int*)btmp)[0]);
+                _sum0 = _mm_add_epi32(_sum0, _mm_madd_epi16(_mm_comp_cvtepi8_epi16(_w01), _b));
+                _sum1 = _mm_add_epi32(_sum1, _mm_madd_epi16(_mm_comp_cvtepi8_epi16(_mm_unpackhi_epi64(_w01, _w01)), _b));
+
+                k0 += 16;
+                btmp += 2;
+            }
+
+            _mm_storeu_si128((__m128i*)sum, _sum0);
+            _mm_storeu_si128((__m128i*)(sum + 4), _sum1);
+#else
+            for (int i=0; i<8; i++)
+                sum[i] = 0;
+
+            for (int kk=0; kk<KK; kk++)
+            {
+                for (int i=0; i<8; i++)
+                    sum[i] += k0[i * 2] * btmp[0] + k0[i * 2 + 1] * btmp[1];
+
+                k0 += 16;
+                btmp += 2;
+            }
+#endif // __AVX2__
+
+            for (int i=0; i<np; i++)
+                outptr[i][j] = sum[i];
+        }
+    }
+}
+
+} // namespace
+
+static void conv_sgemm_int8_sse(const Mat& bottom_tm, Mat& top_blob_int32, const Mat& kernel_tm, int K, const Option& opt)
+{
+    const int N = top_blob_int32.w * top_blob_int32.h;
+    const int outch = top_blob_int32.c;
+
+    const int KK = (K + 1) / 2;
+
+    const int nn_outch = (outch + 7) / 8;
+
+    int nn_col = N / SGEMM_INT8_COLS;
+    int remain_col_start = nn_col * SGEMM_INT8_COLS;
+
+    const int nn_B = nn_col + N - remain_col_start;
+
+    // blocks of B that stay in l2 while every A row passes over them
+    const int B_block = std::max(1, (int)(256 * 1024 / (KK * SGEMM_INT8_COLS * 2 * sizeof(short))));
+    const int nn_B_block = (nn_B + B_block - 1) / B_block;
+
+    conv_sgemm_int8_sse_task task(top_blob_int32, kernel_tm, bottom_tm, outch, KK, nn_outch, nn_col, remain_col_start, nn_B, B_block);
+
+    parallel_for(task, nn_B_block * nn_outch, opt);
+}
+
+namespace {
+
+// 8 columns of B
+struct conv_im2col_sgemm_int8_pack_sse_task : public ParallelTask
+{
+    conv_im2col_sgemm_int8_pack_sse_task(const Mat& _bottom_blob_int8, Mat& _bottom_tm, int _stride_w, int _pad_left, int _stride_h, int _pad_top, int _kernel_w, int _dilation_h, int _dilation_w, int _w, int _h, int _inch, int _outw, int _maxk, int _K, int _kernel_extent_w, int _kernel_extent_h, int* _space_ofs)
+        : bottom_blob_int8(_bottom_blob_int8), bottom_tm(_bottom_tm), stride_w(_stride_w), pad_left(_pad_left), stride_h(_stride_h), pad_top(_pad_top), kernel_w(_kernel_w), dilation_h(_dilation_h), dilation_w(_dilation_w), w(_w), h(_h), inch(_inch), outw(_outw), maxk(_maxk), K(_K), kernel_extent_w(_kernel_extent_w), kernel_extent_h(_kernel_extent_h), space_ofs(_space_ofs)
+    {
+    }
+
+    virtual void execute(int b) const;
+
+    const Mat& bottom_blob_int8;
+    Mat& bottom_tm;
+    int stride_w;
+    int pad_left;
+    int stride_h;
+    int pad_top;
+    int kernel_w;
+    int dilation_h;
+    int dilation_w;
+    int w;
+    int h;
+    int inch;
+    int outw;
+    int maxk;
+    int K;
+    int kernel_extent_w;
+    int kernel_extent_h;
+    int* space_ofs;
+};
+
+void conv_im2col_sgemm_int8_pack_sse_task::execute(int b) const
+{
+    const int j = b * SGEMM_INT8_COLS;
+
+    // top left tap of every column
+    int x0[SGEMM_INT8_COLS];
+    int y0[SGEMM_INT8_COLS];
+    bool inside = true;
+    for (int n=0; n<SGEMM_INT8_COLS; n++)
+    {
+        x0[n] = (j + n) % outw * stride_w - pad_left;
+        y0[n] = (j + n) / outw * stride_h - pad_top;
+        inside = inside && x0[n] >= 0 && x0[n] + kernel_extent_w <= w && y0[n] >= 0 && y0[n] + kernel_extent_h <= h;
+    }
+
+    short* btmp = bottom_tm.row<short>(b);
+
+    // k even goes to the first of the pair, k odd to the second
+    int k = 0;
+
+    for (int q=0; q<inch; q++)
+    {
+        const signed char* img0 = bottom_blob_int8.channel(q);
+
+        for (int t=0; t<maxk; t++)
+        {
+            if (inside)
+            {
+                const signed char* sptr = img0 + space_ofs[t];
+
+                for (int n=0; n<SGEMM_INT8_COLS; n++)
+                {
+                    btmp[n * 2] = sptr[y0[n] * w + x0[n]];
+                }
+            }
+            else
+            {
+                const int ky = t / kernel_w * dilation_h;
+                const int kx = t % kernel_w * dilation_w;
+
+                for (int n=0; n<SGEMM_INT8_COLS; n++)
+                {
+                    const int y = y0[n] + ky;
+                    const int x = x0[n] + kx;
+                    btmp[n * 2] = (y >= 0 && y < h && x >= 0 && x < w) ? img0[y * w + x] : 0;
+                }
+            }
+
+            k++;
+            btmp += k % 2 ? 1 : SGEMM_INT8_COLS * 2 - 1;
+        }
+    }
+
+    if (K % 2)
+    {
+        for (int n=0; n<SGEMM_INT8_COLS; n++)
+        {
+            btmp[n * 2] = 0;
+        }
+    }
+}
+
+// one remaining column of B
+struct conv_im2col_sgemm_int8_pack_remain_sse_task : public ParallelTask
+{
+    conv_im2col_sgemm_int8_pack_remain_sse_task(const Mat& _bottom_blob_int8, Mat& _bottom_tm, int _stride_w, int _pad_left, int _stride_h, int _pad_top, int _kernel_h, int _kernel_w, int _dilation_h, int _dilation_w, int _w, int _h, int _inch, int _outw, int _K, int _nn_col, int _remain_col_start)
+        : bottom_blob_int8(_bottom_blob_int8), bottom_tm(_bottom_tm), stride_w(_stride_w), pad_left(_pad_left), stride_h(_stride_h), pad_top(_pad_top), kernel_h(_kernel_h), kernel_w(_kernel_w), dilation_h(_dilation_h), dilation_w(_dilation_w), w(_w), h(_h), inch(_inch), outw(_outw), K(_K), nn_col(_nn_col), remain_col_start(_remain_col_start)
+    {
+    }
+
+    virtual void execute(int index) const;
+
+    const Mat& bottom_blob_int8;
+    Mat& bottom_tm;
+    int stride_w;
+    int pad_left;
+    int stride_h;
+    int pad_top;
+    int kernel_h;
+    int kernel_w;
+    int dilation_h;
+    int dilation_w;
+    int w;
+    int h;
+    int inch;
+    int outw;
+    int K;
+    int nn_col;
+    int remain_col_start;
+};
+
+void conv_im2col_sgemm_int8_pack_remain_sse_task::execute(int index) const
+{
+    const int j = remain_col_start + index;
+
+    const int x0 = j % outw * stride_w - pad_left;
+    const int y0 = j / outw * stride_h - pad_top;
+
+    short* btmp = bottom_tm.row<short>(nn_col + j - remain_col_start);
+
+    for (int q=0; q<inch; q++)
+    {
+        const signed char* img0 = bottom_blob_int8.channel(q);
+
+        for (int ky=0; ky<kernel_h; ky++)
+        {
+            for (int kx=0; kx<kernel_w; kx++)
+            {
+                const int y = y0 + ky * dilation_h;
+                const int x = x0 + kx * dilation_w;
+                *btmp++ = (y >= 0 && y < h && x >= 0 && x < w) ? img0[y * w + x] : 0;
+            }
+        }
+    }
+
+    if (K % 2)
+        *btmp = 0;
+}
+
+} // namespace
+
+static void conv_im2col_sgemm_int8_sse(const Mat& bottom_blob_int8, Mat& top_blob_int32, const Mat& kernel_tm, int kernel_w, int kernel_h, int dilation_w, int dilation_h, int stride_w, int stride_h, int pad_left, int pad_top, const Option& opt)
+{
+    int w = bottom_blob_int8.w;
+    int h = bottom_blob_int8.h;
+    int inch = bottom_blob_int8.c;
+
+    int outw = top_blob_int32.w;
+    int outh = top_blob_int32.h;
+
+    const int maxk = kernel_w * kernel_h;
+    const int K = inch * maxk;
+    const int KK = (K + 1) / 2;
+    const int N = outw * outh;
+
+    // im2col straight into the packed B layout, widened to int16 for madd
+    int nn_col = N / SGEMM_INT8_COLS;
+    int remain_col_start = nn_col * SGEMM_INT8_COLS;
+
+    Mat bottom_tm(SGEMM_INT8_COLS * KK * 2, nn_col + N - remain_col_start, 2u, opt.workspace_allocator);
+    if (bottom_tm.empty())
+    {
+        top_blob_int32.release();
+        return;
+    }
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    // offset of every kernel tap inside one input channel
+    std::vector<int> _space_ofs(maxk);
+    int* space_ofs = &_space_ofs[0];
+    {
+        int p1 = 0;
+        int p2 = 0;
+        int gap = w * dilation_h - kernel_w * dilation_w;
+        for (int i = 0; i < kernel_h; i++)
+        {
+            for (int j = 0; j < kernel_w; j++)
+            {
+                space_ofs[p1] = p2;
+                p1++;
+                p2 += dilation_w;
+            }
+            p2 += gap;
+        }
+    }
+
+    conv_im2col_sgemm_int8_pack_sse_task task(bottom_blob_int8, bottom_tm, stride_w, pad_left, stride_h, pad_top, kernel_w, dilation_h, dilation_w, w, h, inch, outw, maxk, K, kernel_extent_w, kernel_extent_h, space_ofs);
+
+    parallel_for(task, nn_col, opt);
+
+    conv_im2col_sgemm_int8_pack_remain_sse_task remain_task(bottom_blob_int8, bottom_tm, stride_w, pad_left, stride_h, pad_top, kernel_h, kernel_w, dilation_h, dilation_w, w, h, inch, outw, K, nn_col, remain_col_start);
+
+    parallel_for(remain_task, N - remain_col_start, opt);
+
+    conv_sgemm_int8_sse(bottom_tm, top_blob_int32, kernel_tm, K, opt);
+}
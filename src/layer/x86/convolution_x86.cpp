@@ -14,44 +14,74 @@
 
 #include "convolution_x86.h"
 
+#include <algorithm>
+#include <string.h>
+
+#include "fused_activation.h"
+#include "quantize_int8.h"
+#include "threadpool.h"
+#include "x86_usability.h"
+
 namespace ncnn {
 
+#include "convolution_sgemm.h"
+#include "convolution_sgemm_int8.h"
 #include "convolution_1x1.h"
 #include "convolution_3x3.h"
 #include "convolution_5x5.h"
 
 DEFINE_LAYER_CREATOR(Convolution_x86)
 
-int Convolution_x86::forward(const Mat& bottom_blob, Mat& top_blob) const
+Convolution_x86::Convolution_x86()
 {
-    // convolv with NxN kernel
-    // value = value + bias
+    conv = 0;
+    use_winograd3x3 = false;
 
-    if (kernel_w != kernel_h || stride_w != stride_h)
+    plan_kernel = Kernel_IM2COL_SGEMM;
+}
+
+int Convolution_x86::load_param(const ParamDict& pd)
+{
+    int ret = Convolution::load_param(pd);
+    if (ret != 0)
+        return ret;
+
+    conv = 0;
+    use_winograd3x3 = false;
+
+    {
+        int num_input = weight_data_size / kernel_w / kernel_h / num_output;
+        support_packing = kernel_w == 1 && kernel_h == 1 && stride_w == 1 && stride_h == 1 && pad_w <= 0 && pad_h <= 0
+                          && num_input % 4 == 0 && num_output % 4 == 0;
+    }
+
+    if (kernel_w == 3 && kernel_h == 3 && dilation_w == 1 && dilation_h == 1 && stride_w == 1 && stride_h == 1)
     {
-        return Convolution::forward(bottom_blob, top_blob);
+        int num_input = weight_data_size / 9 / num_output;
+        // winograd is slow on small channel count
+        if (num_input >= 16 && num_output >= 16)
+            use_winograd3x3 = true;
     }
 
+    if (kernel_w != kernel_h || stride_w != stride_h)
+        return 0;
+
     const int kernel_size = kernel_w;
     const int stride = stride_w;
 
     if (kernel_size > 5 || stride > 5 || dilation_w != 1 || dilation_h != 1)
-    {
-        return Convolution::forward(bottom_blob, top_blob);
-    }
-
-    typedef void (*conv_func)(const Mat&, Mat&, const Mat&, const Mat&);
+        return 0;
 
     // kernel_size x stride
     conv_func conv_func_table[5][5] =
     {
         {
-            conv1x1s1_sse,
-            conv1x1s2_sse,
+            0,
+            0,
             0,
             0,
             0
-        }, // kernel_size = 1
+        }, // kernel_size = 1, sgemm
         {
             0,
             0,
@@ -82,48 +112,467 @@ int Convolution_x86::forward(const Mat& bottom_blob, Mat& top_blob) const
         }  // kernel_size = 5
     };
 
-    conv_func conv = conv_func_table[kernel_size-1][stride-1];
+    conv = conv_func_table[kernel_size-1][stride-1];
+
+    return 0;
+}
+
+int Convolution_x86::create_pipeline()
+{
+    int ret = Convolution::create_pipeline();
+    if (ret != 0)
+        return ret;
+
+    if (use_int8_inference)
+    {
+        support_packing = false;
+
+        const int maxk = kernel_w * kernel_h;
+        int num_input = weight_data_size / maxk / num_output;
+        conv_sgemm_int8_transform_kernel_sse(weight_data_int8, weight_sgemm_int8_data, num_input, num_output, maxk);
+
+        return 0;
+    }
+
+    if (use_winograd3x3)
+    {
+        int num_input = weight_data_size / 9 / num_output;
+        conv3x3s1_winograd64_transform_kernel_sse(weight_data, weight_3x3_winograd64_data, num_input, num_output);
+    }
+
     if (!conv)
     {
-        return Convolution::forward(bottom_blob, top_blob);
+        const int maxk = kernel_w * kernel_h;
+        int num_input = weight_data_size / maxk / num_output;
+        conv_sgemm_transform_kernel_sse(weight_data, weight_sgemm_data, num_input, num_output, maxk);
+    }
+
+    if (support_packing)
+    {
+        int num_input = weight_data_size / num_output;
+        conv1x1s1_transform_kernel_pack4_sse(weight_data, weight_data_pack4, num_input, num_output);
     }
 
+    return 0;
+}
+
+int Convolution_x86::save_prepared(std::vector<Mat>& weights) const
+{
+    int ret = Convolution::save_prepared(weights);
+    if (ret != 0)
+        return ret;
+
+    weights.push_back(weight_3x3_winograd64_data);
+    weights.push_back(weight_sgemm_data);
+    weights.push_back(weight_sgemm_int8_data);
+    weights.push_back(weight_data_pack4);
+
+    return 0;
+}
+
+int Convolution_x86::load_prepared(const ModelBin& mb)
+{
+    int ret = Convolution::load_prepared(mb);
+    if (ret != 0)
+        return ret;
+
+    weight_3x3_winograd64_data = mb.load(0, 0);
+    weight_sgemm_data = mb.load(0, 0);
+    weight_sgemm_int8_data = mb.load(0, 0);
+    weight_data_pack4 = mb.load(0, 0);
+
+    if (use_int8_inference)
+        support_packing = false;
+
+    return 0;
+}
+
+int Convolution_x86::infer_shape(const std::vector<Mat>& bottom_shapes, std::vector<Mat>& top_shapes)
+{
+    int ret = Convolution::infer_shape(bottom_shapes, top_shapes);
+    if (ret != 0)
+        return ret;
+
+    // keep the kernel and its scratch of this size for forward
+    if (!use_int8_inference)
+        choose_kernel(plan_w, plan_h, bottom_shapes[0].c, plan_kernel, plan_scratch_shape, plan_scratch2_shape);
+
+    return 0;
+}
+
+int Convolution_x86::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    // convolv with NxN kernel
+    // value = value + bias
+
+    if (use_int8_inference)
+        return forward_int8_x86(bottom_blob, top_blob, opt);
+
     int w = bottom_blob.w;
     int h = bottom_blob.h;
 
-    Mat bottom_blob_bordered = bottom_blob;
-    if (pad_w > 0 || pad_h > 0)
+    if (bottom_blob.elempack == 4)
     {
-        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f);
-        if (bottom_blob_bordered.empty())
+        top_blob.create(w, h, num_output / 4, 16u, 4, opt.blob_allocator);
+        if (top_blob.empty())
             return -100;
 
-        w = bottom_blob_bordered.w;
-        h = bottom_blob_bordered.h;
+        conv1x1s1_pack4_sse(bottom_blob, top_blob, weight_data_pack4, bias_data, activation_type, activation_params, opt);
+
+        return 0;
     }
-    else if (pad_w == -233 && pad_h == -233)
+
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    get_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    int outw = (w + pad_left + pad_right - kernel_extent_w) / stride_w + 1;
+    int outh = (h + pad_top + pad_bottom - kernel_extent_h) / stride_h + 1;
+
+    top_blob.create(outw, outh, num_output, 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    int kernel;
+    Mat scratch_shape;
+    Mat scratch2_shape;
+    if (w == plan_w && h == plan_h)
     {
-        int wpad = kernel_size + (w - 1) / stride * stride - w;
-        int hpad = kernel_size + (h - 1) / stride * stride - h;
-        if (wpad > 0 || hpad > 0)
-        {
-            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f);
-            if (bottom_blob_bordered.empty())
-                return -100;
-        }
+        kernel = plan_kernel;
+        scratch_shape = plan_scratch_shape;
+        scratch2_shape = plan_scratch2_shape;
+    }
+    else
+    {
+        choose_kernel(w, h, bottom_blob.c, kernel, scratch_shape, scratch2_shape);
+    }
+
+    Mat scratch;
+    if (scratch_shape.dims == 2)
+        scratch.create(scratch_shape.w, scratch_shape.h, 4u, opt.workspace_allocator);
+    else if (scratch_shape.dims == 3)
+        scratch.create(scratch_shape.w, scratch_shape.h, scratch_shape.c, 4u, opt.workspace_allocator);
+    if (scratch_shape.dims != 0 && scratch.empty())
+        return -100;
 
-        w = bottom_blob_bordered.w;
-        h = bottom_blob_bordered.h;
+    Mat scratch2;
+    if (scratch2_shape.dims == 3)
+    {
+        scratch2.create(scratch2_shape.w, scratch2_shape.h, scratch2_shape.c, 4u, opt.workspace_allocator);
+        if (scratch2.empty())
+            return -100;
+    }
+
+    if (kernel == Kernel_WINOGRAD64)
+    {
+        conv3x3s1_winograd64_sse(bottom_blob, top_blob, scratch, scratch2, weight_3x3_winograd64_data, bias_data, pad_left, pad_top, activation_type, activation_params, opt);
+    }
+    else if (kernel == Kernel_DIRECT)
+    {
+        Mat bottom_blob_bordered;
+        int ret = make_padding(bottom_blob, bottom_blob_bordered, opt);
+        if (ret != 0)
+            return ret;
+
+        conv(bottom_blob_bordered, top_blob, weight_data, bias_data, opt);
+
+        // the direct kernels accumulate one input channel at a time into the output
+        activation_inplace(top_blob, activation_type, activation_params, opt);
+    }
+    else if (kernel == Kernel_1X1S1_SGEMM)
+    {
+        conv1x1s1_sgemm_sse(bottom_blob, top_blob, scratch, weight_sgemm_data, bias_data, activation_type, activation_params, opt);
+    }
+    else if (kernel == Kernel_1X1S2_SGEMM)
+    {
+        conv1x1s2_sgemm_sse(bottom_blob, top_blob, scratch, weight_sgemm_data, bias_data, activation_type, activation_params, opt);
+    }
+    else
+    {
+        conv_im2col_sgemm_sse(bottom_blob, top_blob, scratch, weight_sgemm_data, bias_data, kernel_w, kernel_h, dilation_w, dilation_h, stride_w, stride_h, pad_left, pad_top, activation_type, activation_params, opt);
     }
 
-    int outw = (w - kernel_size) / stride + 1;
-    int outh = (h - kernel_size) / stride + 1;
+    return 0;
+}
+
+namespace {
+
+// one input channel of every sample, side by side
+struct convolution_batch_gather_task : public ParallelTask
+{
+    convolution_batch_gather_task(const std::vector<Mat>& _bottom_blobs, Mat& _bottom_blob_batch, int _batch)
+        : bottom_blobs(_bottom_blobs), bottom_blob_batch(_bottom_blob_batch), batch(_batch)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const std::vector<Mat>& bottom_blobs;
+    Mat& bottom_blob_batch;
+    int batch;
+};
+
+void convolution_batch_gather_task::execute(int q) const
+{
+    float* outptr = bottom_blob_batch.channel(q);
 
-    top_blob.create(outw, outh, num_output);
+    for (int n=0; n<batch; n++)
+    {
+        const int size = bottom_blobs[n].w * bottom_blobs[n].h;
+
+        memcpy(outptr, bottom_blobs[n].channel(q), size * sizeof(float));
+
+        outptr += size;
+    }
+}
+
+// one output channel back to every sample
+struct convolution_batch_scatter_task : public ParallelTask
+{
+    convolution_batch_scatter_task(const Mat& _top_blob_batch, std::vector<Mat>& _top_blobs, int _batch)
+        : top_blob_batch(_top_blob_batch), top_blobs(_top_blobs), batch(_batch)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    const Mat& top_blob_batch;
+    std::vector<Mat>& top_blobs;
+    int batch;
+};
+
+void convolution_batch_scatter_task::execute(int p) const
+{
+    const float* ptr = top_blob_batch.channel(p);
+
+    for (int n=0; n<batch; n++)
+    {
+        const int size = top_blobs[n].w * top_blobs[n].h;
+
+        memcpy(top_blobs[n].channel(p), ptr, size * sizeof(float));
+
+        ptr += size;
+    }
+}
+
+} // namespace
+
+int Convolution_x86::forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    // 1x1 s1 is one gemm over the columns of every sample side by side
+    // the weights are packed and streamed once for the whole batch
+    if (use_int8_inference || kernel_w != 1 || kernel_h != 1 || stride_w != 1 || stride_h != 1)
+        return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+    const int batch = bottom_blobs.size();
+    if (batch < 2)
+        return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+    const int channels = bottom_blobs[0].c;
+
+    int size = 0;
+    for (int n=0; n<batch; n++)
+    {
+        const Mat& bottom_blob = bottom_blobs[n];
+        if (bottom_blob.elempack != 1 || bottom_blob.dims != 3 || bottom_blob.c != channels)
+            return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+        int pad_left;
+        int pad_right;
+        int pad_top;
+        int pad_bottom;
+        get_padding(bottom_blob.w, bottom_blob.h, pad_left, pad_right, pad_top, pad_bottom);
+
+        if (pad_left > 0 || pad_right > 0 || pad_top > 0 || pad_bottom > 0)
+            return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+        size += bottom_blob.w * bottom_blob.h;
+    }
+
+    Mat bottom_blob_batch(size, 1, channels, 4u, opt.workspace_allocator);
+    if (bottom_blob_batch.empty())
+        return -100;
+
+    {
+        convolution_batch_gather_task task(bottom_blobs, bottom_blob_batch, batch);
+
+        parallel_for(task, channels, opt);
+    }
+
+    Mat top_blob_batch(size, 1, num_output, 4u, opt.workspace_allocator);
+    if (top_blob_batch.empty())
+        return -100;
+
+    Mat scratch_shape = conv_sgemm_scratch_shape(channels, size);
+
+    Mat scratch(scratch_shape.w, scratch_shape.h, 4u, opt.workspace_allocator);
+    if (scratch.empty())
+        return -100;
+
+    conv1x1s1_sgemm_sse(bottom_blob_batch, top_blob_batch, scratch, weight_sgemm_data, bias_data, activation_type, activation_params, opt);
+
+    top_blobs.resize(batch);
+    for (int n=0; n<batch; n++)
+    {
+        top_blobs[n].create(bottom_blobs[n].w, bottom_blobs[n].h, num_output, 4u, opt.blob_allocator);
+        if (top_blobs[n].empty())
+            return -100;
+    }
+
+    {
+        convolution_batch_scatter_task task(top_blob_batch, top_blobs, batch);
+
+        parallel_for(task, num_output, opt);
+    }
+
+    return 0;
+}
+
+const char* Convolution_x86::kernel_name(const Mat& bottom_blob) const
+{
+    // same choice as forward
+    if (use_int8_inference)
+        return "im2col_sgemm_int8";
+
+    if (bottom_blob.elempack == 4)
+        return "conv1x1s1_pack4";
+
+    int kernel;
+    Mat scratch_shape;
+    Mat scratch2_shape;
+    choose_kernel(bottom_blob.w, bottom_blob.h, bottom_blob.c, kernel, scratch_shape, scratch2_shape);
+
+    static const char* const kernel_names[] = { "conv3x3s1_winograd64", "direct", "conv1x1s1_sgemm", "conv1x1s2_sgemm", "im2col_sgemm" };
+
+    return kernel_names[kernel];
+}
+
+void Convolution_x86::choose_kernel(int w, int h, int channels, int& kernel, Mat& scratch_shape, Mat& scratch2_shape) const
+{
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    get_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
+
+    int outw = (w + pad_left + pad_right - (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+    int outh = (h + pad_top + pad_bottom - (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+
+    const bool is_padded = pad_left > 0 || pad_right > 0 || pad_top > 0 || pad_bottom > 0;
+
+    scratch_shape = Mat();
+    scratch2_shape = Mat();
+
+    // winograd and im2col take the border inline, the direct kernels and 1x1 read a padded copy
+    // the tile padding costs too much on tiny feature maps
+    if (use_winograd3x3 && outw >= 4 && outh >= 4)
+    {
+        kernel = Kernel_WINOGRAD64;
+        conv3x3s1_winograd64_scratch_shape(channels, num_output, outw, outh, scratch_shape, scratch2_shape);
+    }
+    else if (conv)
+    {
+        kernel = Kernel_DIRECT;
+    }
+    else if (kernel_w == 1 && kernel_h == 1 && stride_w == 1 && stride_h == 1 && !is_padded)
+    {
+        kernel = Kernel_1X1S1_SGEMM;
+        scratch_shape = conv_sgemm_scratch_shape(channels, outw * outh);
+    }
+    else if (kernel_w == 1 && kernel_h == 1 && stride_w == 2 && stride_h == 2 && !is_padded)
+    {
+        kernel = Kernel_1X1S2_SGEMM;
+        scratch_shape = conv_sgemm_scratch_shape(channels, outw * outh);
+    }
+    else
+    {
+        // any other kernel size, stride, dilation and padded 1x1
+        kernel = Kernel_IM2COL_SGEMM;
+        scratch_shape = conv_sgemm_scratch_shape(channels * kernel_w * kernel_h, outw * outh);
+    }
+}
+
+namespace {
+
+// one output channel
+struct convolution_dequantize_int8_task : public ParallelTask
+{
+    convolution_dequantize_int8_task(Mat& _top_blob, Mat& _top_blob_int32, const Mat& _activation_params, const Mat& _bias_data, const Mat& _weight_data_int8_scales, int _outw, int _outh, int _bias_term, int _activation_type, float _bottom_blob_int8_scale, bool _use_int8_requantize, float _top_blob_int8_scale)
+        : top_blob(_top_blob), top_blob_int32(_top_blob_int32), activation_params(_activation_params), bias_data(_bias_data), weight_data_int8_scales(_weight_data_int8_scales), outw(_outw), outh(_outh), bias_term(_bias_term), activation_type(_activation_type), bottom_blob_int8_scale(_bottom_blob_int8_scale), use_int8_requantize(_use_int8_requantize), top_blob_int8_scale(_top_blob_int8_scale)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    Mat& top_blob;
+    Mat& top_blob_int32;
+    const Mat& activation_params;
+    const Mat& bias_data;
+    const Mat& weight_data_int8_scales;
+    int outw;
+    int outh;
+    int bias_term;
+    int activation_type;
+    float bottom_blob_int8_scale;
+    bool use_int8_requantize;
+    float top_blob_int8_scale;
+};
+
+void convolution_dequantize_int8_task::execute(int p) const
+{
+    const float dequant_scale = dequantize_scale(bottom_blob_int8_scale, weight_data_int8_scales[p]);
+    const float bias = bias_term ? bias_data[p] : 0.f;
+
+    if (use_int8_requantize)
+        requantize_int32(top_blob_int32.channel(p), top_blob.channel(p), outw * outh, dequant_scale, bias, activation_type, activation_params, top_blob_int8_scale);
+    else
+        dequantize_int32(top_blob_int32.channel(p), top_blob.channel(p), outw * outh, dequant_scale, bias, activation_type, activation_params);
+}
+
+} // namespace
+
+int Convolution_x86::forward_int8_x86(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+
+    Mat bottom_blob_int8;
+    int ret = quantize_int8(bottom_blob, bottom_blob_int8, bottom_blob_int8_scale, opt);
+    if (ret != 0)
+        return ret;
+
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    get_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    int outw = (w + pad_left + pad_right - kernel_extent_w) / stride_w + 1;
+    int outh = (h + pad_top + pad_bottom - kernel_extent_h) / stride_h + 1;
+
+    top_blob.create(outw, outh, num_output, use_int8_requantize ? 1u : 4u, opt.blob_allocator);
     if (top_blob.empty())
         return -100;
 
-    conv(bottom_blob_bordered, top_blob, weight_data, bias_data);
+    Mat top_blob_int32(outw, outh, num_output, 4u, opt.workspace_allocator);
+    if (top_blob_int32.empty())
+        return -100;
+
+    conv_im2col_sgemm_int8_sse(bottom_blob_int8, top_blob_int32, weight_sgemm_int8_data, kernel_w, kernel_h, dilation_w, dilation_h, stride_w, stride_h, pad_left, pad_top, opt);
+    if (top_blob_int32.empty())
+        return -100;
+
+    convolution_dequantize_int8_task task(top_blob, top_blob_int32, activation_params, bias_data, weight_data_int8_scales, outw, outh, bias_term, activation_type, bottom_blob_int8_scale, use_int8_requantize, top_blob_int8_scale);
+
+    parallel_for(task, num_output, opt);
 
     return 0;
 }
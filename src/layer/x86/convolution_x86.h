@@ -22,7 +22,54 @@ namespace ncnn {
 class Convolution_x86 : public Convolution
 {
 public:
-    virtual int forward(const Mat& bottom_blob, Mat& top_blob) const;
+    typedef void (*conv_func)(const Mat&, Mat&, const Mat&, const Mat&, const Option&);
+
+    Convolution_x86();
+
+    virtual int load_param(const ParamDict& pd);
+
+    virtual int create_pipeline();
+
+    virtual int save_prepared(std::vector<Mat>& weights) const;
+
+    virtual int load_prepared(const ModelBin& mb);
+
+    virtual int infer_shape(const std::vector<Mat>& bottom_shapes, std::vector<Mat>& top_shapes);
+
+    virtual int forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const;
+
+    virtual int forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const;
+
+    virtual const char* kernel_name(const Mat& bottom_blob) const;
+
+    enum { Kernel_WINOGRAD64 = 0, Kernel_DIRECT = 1, Kernel_1X1S1_SGEMM = 2, Kernel_1X1S2_SGEMM = 3, Kernel_IM2COL_SGEMM = 4 };
+
+protected:
+    int forward_int8_x86(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const;
+
+    // the fp32 kernel for one input size and the shapes of the scratch buffers it takes
+    void choose_kernel(int w, int h, int channels, int& kernel, Mat& scratch_shape, Mat& scratch2_shape) const;
+
+    // kernel and scratch shapes planned by infer_shape for plan_w x plan_h
+    int plan_kernel;
+    Mat plan_scratch_shape;
+    Mat plan_scratch2_shape;
+
+public:
+    // kernel picked for this kernel size and stride, 0 goes through im2col sgemm
+    conv_func conv;
+
+    bool use_winograd3x3;
+    Mat weight_3x3_winograd64_data;
+
+    // packed for im2col sgemm
+    Mat weight_sgemm_data;
+
+    // int8 packed for im2col sgemm
+    Mat weight_sgemm_int8_data;
+
+    // 1x1s1 on c/4-h-w-4 blobs
+    Mat weight_data_pack4;
 };
 
 } // namespace ncnn
@@ -0,0 +1,609 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// depthwise KxK stride S on the unpadded input, taps falling into the border read zero
+
+template<int K, int S>
+static inline float convdw_border_ss(const float* img, int w, int h, const float* k0, float bias0, int i, int j, int pad_left, int pad_top)
+{
+    float sum = bias0;
+
+    const int y0 = i * S - pad_top;
+    const int x0 = j * S - pad_left;
+
+    for (int ky=0; ky<K; ky++)
+    {
+        const int y = y0 + ky;
+        if (y < 0 || y >= h)
+            continue;
+
+        for (int kx=0; kx<K; kx++)
+        {
+            const int x = x0 + kx;
+            if (x < 0 || x >= w)
+                continue;
+
+            sum += img[y * w + x] * k0[ky * K + kx];
+        }
+    }
+
+    return sum;
+}
+
+// R output rows from row i, all their taps are inside the image vertically
+template<int K, int S, int R>
+static void convdw_rows_sse(const float* img, int w, int h, float* outptr, int outw, const float* k0, float bias0, int i, int j0, int j1, int pad_left, int pad_top, int activation_type, const Mat& activation_params)
+{
+    // input rows shared by the R output rows
+    const int KH = K + S * (R - 1);
+
+    for (int r=0; r<R; r++)
+    {
+        for (int j=0; j<j0; j++)
+        {
+            outptr[r * outw + j] = activation_ss(convdw_border_ss<K, S>(img, w, h, k0, bias0, i + r, j, pad_left, pad_top), activation_type, activation_params);
+        }
+    }
+
+    const float* img0 = img + (i * S - pad_top) * w;
+
+    int j = j0;
+
+#if __AVX__
+    {
+        __m256 _k[K * K];
+        for (int t=0; t<K*K; t++)
+        {
+            _k[t] = _mm256_set1_ps(k0[t]);
+        }
+
+        // the fused activation is applied to the sums before they are stored
+        const float slope = activation_type == 2 ? activation_params[0] : 0.f;
+
+        // stride 2 loads 16 floats per tap, keep them inside the row
+        for (; j+7<j1 && (S == 1 || 2 * j - pad_left + K + 14 < w); j+=8)
+        {
+            __m256 _sum[R];
+            for (int r=0; r<R; r++)
+            {
+                _sum[r] = _mm256_set1_ps(bias0);
+            }
+
+            for (int ky=0; ky<KH; ky++)
+            {
+                const float* sptr = img0 + ky * w + j * S - pad_left;
+
+                for (int kx=0; kx<K; kx++)
+                {
+                    __m256 _v;
+                    if (S == 1)
+                    {
+                        _v = _mm256_loadu_ps(sptr + kx);
+                    }
+                    else
+                    {
+                        // lanes hold outputs 0 1 4 5 2 3 6 7, fixed up at the store
+                        __m256 _a = _mm256_loadu_ps(sptr + kx);
+                        __m256 _b = _mm256_loadu_ps(sptr + kx + 8);
+                        _v = _mm256_shuffle_ps(_a, _b, _MM_SHUFFLE(2,0,2,0));
+                    }
+
+                    for (int r=0; r<R; r++)
+                    {
+                        const int kr = ky - r * S;
+                        if (kr >= 0 && kr < K)
+                            _sum[r] = _mm256_comp_fmadd_ps(_v, _k[kr * K + kx], _sum[r]);
+                    }
+                }
+            }
+
+            for (int r=0; r<R; r++)
+            {
+                float* ptr = outptr + r * outw + j;
+
+                __m256 _out = _mm256_activation_ps(_sum[r], activation_type, slope);
+
+                if (S == 1)
+                {
+                    _mm256_storeu_ps(ptr, _out);
+                }
+                else
+                {
+                    __m128 _lo = _mm256_castps256_ps128(_out);
+                    __m128 _hi = _mm256_extractf128_ps(_out, 1);
+                    _mm_storeu_ps(ptr, _mm_movelh_ps(_lo, _hi));
+                    _mm_storeu_ps(ptr + 4, _mm_movehl_ps(_hi, _lo));
+                }
+            }
+        }
+    }
+#endif // __AVX__
+
+#if __SSE2__
+    {
+        __m128 _k[K * K];
+        for (int t=0; t<K*K; t++)
+        {
+            _k[t] = _mm_set1_ps(k0[t]);
+        }
+
+        const float slope = activation_type == 2 ? activation_params[0] : 0.f;
+
+        // stride 2 loads 8 floats per tap, keep them inside the row
+        for (; j+3<j1 && (S == 1 || 2 * j - pad_left + K + 6 < w); j+=4)
+        {
+            __m128 _sum[R];
+            for (int r=0; r<R; r++)
+            {
+                _sum[r] = _mm_set1_ps(bias0);
+            }
+
+            for (int ky=0; ky<KH; ky++)
+            {
+                const float* sptr = img0 + ky * w + j * S - pad_left;
+
+                for (int kx=0; kx<K; kx++)
+                {
+                    __m128 _v;
+                    if (S == 1)
+                    {
+                        _v = _mm_loadu_ps(sptr + kx);
+                    }
+                    else
+                    {
+                        __m128 _a = _mm_loadu_ps(sptr + kx);
+                        __m128 _b = _mm_loadu_ps(sptr + kx + 4);
+                        _v = _mm_shuffle_ps(_a, _b, _MM_SHUFFLE(2,0,2,0));
+                    }
+
+                    for (int r=0; r<R; r++)
+                    {
+                        const int kr = ky - r * S;
+                        if (kr >= 0 && kr < K)
+                            _sum[r] = _mm_comp_fmadd_ps(_v, _k[kr * K + kx], _sum[r]);
+                    }
+                }
+            }
+
+            for (int r=0; r<R; r++)
+            {
+                _mm_storeu_ps(outptr + r * outw + j, _mm_activation_ps(_sum[r], activation_type, slope));
+            }
+        }
+    }
+#endif // __SSE2__
+
+    for (; j<j1; j++)
+    {
+        for (int r=0; r<R; r++)
+        {
+            float sum = bias0;
+
+            for (int ky=0; ky<K; ky++)
+            {
+                const float* sptr = img0 + (r * S + ky) * w + j * S - pad_left;
+
+                for (int kx=0; kx<K; kx++)
+                {
+                    sum += sptr[kx] * k0[ky * K + kx];
+                }
+            }
+
+            outptr[r * outw + j] = activation_ss(sum, activation_type, activation_params);
+        }
+    }
+
+    for (int r=0; r<R; r++)
+    {
+        for (j=j1; j<outw; j++)
+        {
+            outptr[r * outw + j] = activation_ss(convdw_border_ss<K, S>(img, w, h, k0, bias0, i + r, j, pad_left, pad_top), activation_type, activation_params);
+        }
+    }
+}
+
+namespace {
+
+// one channel
+template<int K, int S>
+struct convdw_sse_task : public ParallelTask
+{
+    convdw_sse_task(const Mat& _bottom_blob, Mat& _top_blob, const float* _kernel, const float* _bias, const Mat& _activation_params, int _activation_type, int _pad_left, int _pad_top, int _i0, int _i1, int _j0, int _j1)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), kernel(_kernel), bias(_bias), activation_params(_activation_params), activation_type(_activation_type), pad_left(_pad_left), pad_top(_pad_top), i0(_i0), i1(_i1), j0(_j0), j1(_j1)
+    {
+    }
+
+    virtual void execute(int g) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const float* kernel;
+    const float* bias;
+    const Mat& activation_params;
+    int activation_type;
+    int pad_left;
+    int pad_top;
+    int i0;
+    int i1;
+    int j0;
+    int j1;
+};
+
+template<int K, int S>
+void convdw_sse_task<K, S>::execute(int g) const
+{
+    const int w = bottom_blob.w;
+    const int h = bottom_blob.h;
+
+    const int outw = top_blob.w;
+    const int outh = top_blob.h;
+
+    const float* img = bottom_blob.channel(g);
+    float* outptr = top_blob.channel(g);
+
+    const float* k0 = kernel + g * K * K;
+    const float bias0 = bias ? bias[g] : 0.f;
+
+    for (int i=0; i<i0; i++)
+    {
+        for (int j=0; j<outw; j++)
+        {
+            outptr[i * outw + j] = activation_ss(convdw_border_ss<K, S>(img, w, h, k0, bias0, i, j, pad_left, pad_top), activation_type, activation_params);
+        }
+    }
+
+    // two output rows at once share the input rows in between
+    int i = i0;
+    for (; i+1<i1; i+=2)
+    {
+        convdw_rows_sse<K, S, 2>(img, w, h, outptr + i * outw, outw, k0, bias0, i, j0, j1, pad_left, pad_top, activation_type, activation_params);
+    }
+    for (; i<i1; i++)
+    {
+        convdw_rows_sse<K, S, 1>(img, w, h, outptr + i * outw, outw, k0, bias0, i, j0, j1, pad_left, pad_top, activation_type, activation_params);
+    }
+
+    for (i=i1; i<outh; i++)
+    {
+        for (int j=0; j<outw; j++)
+        {
+            outptr[i * outw + j] = activation_ss(convdw_border_ss<K, S>(img, w, h, k0, bias0, i, j, pad_left, pad_top), activation_type, activation_params);
+        }
+    }
+}
+
+} // namespace
+
+template<int K, int S>
+static void convdw_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& _kernel, const Mat& _bias, int pad_left, int pad_top, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+
+    int outw = top_blob.w;
+    int outh = top_blob.h;
+
+    const int group = bottom_blob.c;
+
+    const float* kernel = _kernel;
+    const float* bias = _bias;
+
+    // outputs in [j0, j1) x [i0, i1) need no border
+    const int j0 = std::min(outw, (pad_left + S - 1) / S);
+    const int j1 = std::max(j0, std::min(outw, w + pad_left >= K ? (w + pad_left - K) / S + 1 : 0));
+    const int i0 = std::min(outh, (pad_top + S - 1) / S);
+    const int i1 = std::max(i0, std::min(outh, h + pad_top >= K ? (h + pad_top - K) / S + 1 : 0));
+
+    convdw_sse_task<K, S> task(bottom_blob, top_blob, kernel, bias, activation_params, activation_type, pad_left, pad_top, i0, i1, j0, j1);
+
+    parallel_for(task, group, opt);
+}
+
+static void convdw3x3s1_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& kernel, const Mat& bias, int pad_left, int pad_top, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    convdw_sse<3, 1>(bottom_blob, top_blob, kernel, bias, pad_left, pad_top, activation_type, activation_params, opt);
+}
+
+static void convdw3x3s2_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& kernel, const Mat& bias, int pad_left, int pad_top, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    convdw_sse<3, 2>(bottom_blob, top_blob, kernel, bias, pad_left, pad_top, activation_type, activation_params, opt);
+}
+
+static void convdw5x5s1_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& kernel, const Mat& bias, int pad_left, int pad_top, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    convdw_sse<5, 1>(bottom_blob, top_blob, kernel, bias, pad_left, pad_top, activation_type, activation_params, opt);
+}
+
+static void convdw5x5s2_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& kernel, const Mat& bias, int pad_left, int pad_top, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    convdw_sse<5, 2>(bottom_blob, top_blob, kernel, bias, pad_left, pad_top, activation_type, activation_params, opt);
+}
+
+// c/4-h-w-4 weights, maxk taps of 4 channels per pack
+static void convdw_transform_kernel_pack4_sse(const Mat& kernel, Mat& kernel_pack4, int group, int maxk)
+{
+    kernel_pack4.create(maxk * group);
+
+    const float* k = kernel;
+    float* kptr = kernel_pack4;
+
+    for (int g=0; g+3<group; g+=4)
+    {
+        for (int k0=0; k0<maxk; k0++)
+        {
+            for (int l=0; l<4; l++)
+            {
+                kptr[l] = k[(g + l) * maxk + k0];
+            }
+
+            kptr += 4;
+        }
+    }
+}
+
+#if __SSE2__
+static inline __m128 convdw_border_pack4_sse(const float* img, int w, int h, const float* k0, __m128 _bias0, int kernel_w, int kernel_h, int dilation_w, int dilation_h, int y0, int x0)
+{
+    __m128 _sum = _bias0;
+
+    for (int ky=0; ky<kernel_h; ky++)
+    {
+        const int y = y0 + ky * dilation_h;
+        if (y < 0 || y >= h)
+            continue;
+
+        for (int kx=0; kx<kernel_w; kx++)
+        {
+            const int x = x0 + kx * dilation_w;
+            if (x < 0 || x >= w)
+                continue;
+
+            __m128 _v = _mm_loadu_ps(img + (y * w + x) * 4);
+            __m128 _k = _mm_loadu_ps(k0 + (ky * kernel_w + kx) * 4);
+            _sum = _mm_comp_fmadd_ps(_v, _k, _sum);
+        }
+    }
+
+    return _sum;
+}
+#endif // __SSE2__
+
+namespace {
+
+// one channel pack
+struct convdw_pack4_sse_task : public ParallelTask
+{
+    convdw_pack4_sse_task(const Mat& _bottom_blob, Mat& _top_blob, const Mat& _kernel_pack4, const float* _bias, const Mat& _activation_params, int _activation_type, int _kernel_w, int _kernel_h, int _dilation_w, int _dilation_h, int _stride_w, int _stride_h, int _pad_left, int _pad_top, int _maxk, int _i0, int _i1, int _j0, int _j1, const int* _space_ofs)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), kernel_pack4(_kernel_pack4), bias(_bias), activation_params(_activation_params), activation_type(_activation_type), kernel_w(_kernel_w), kernel_h(_kernel_h), dilation_w(_dilation_w), dilation_h(_dilation_h), stride_w(_stride_w), stride_h(_stride_h), pad_left(_pad_left), pad_top(_pad_top), maxk(_maxk), i0(_i0), i1(_i1), j0(_j0), j1(_j1), space_ofs(_space_ofs)
+    {
+    }
+
+    virtual void execute(int g) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Mat& kernel_pack4;
+    const float* bias;
+    const Mat& activation_params;
+    int activation_type;
+    int kernel_w;
+    int kernel_h;
+    int dilation_w;
+    int dilation_h;
+    int stride_w;
+    int stride_h;
+    int pad_left;
+    int pad_top;
+    int maxk;
+    int i0;
+    int i1;
+    int j0;
+    int j1;
+    const int* space_ofs;
+};
+
+void convdw_pack4_sse_task::execute(int g) const
+{
+    const int w = bottom_blob.w;
+    const int h = bottom_blob.h;
+
+    const int outw = top_blob.w;
+    const int outh = top_blob.h;
+
+    const float* img = bottom_blob.channel(g);
+    float* outptr = top_blob.channel(g);
+
+    const float* k0 = (const float*)kernel_pack4 + g * maxk * 4;
+
+#if __SSE2__
+    __m128 _bias0 = bias ? _mm_loadu_ps(bias + g * 4) : _mm_setzero_ps();
+
+    // the fused activation is applied to the sums before they are stored
+    const float slope = activation_type == 2 ? activation_params[0] : 0.f;
+
+    for (int i=0; i<outh; i++)
+    {
+        const int y0 = i * stride_h - pad_top;
+
+        if (i < i0 || i >= i1)
+        {
+            for (int j=0; j<outw; j++)
+            {
+                __m128 _sum = convdw_border_pack4_sse(img, w, h, k0, _bias0, kernel_w, kernel_h, dilation_w, dilation_h, y0, j * stride_w - pad_left);
+                _mm_storeu_ps(outptr + (i * outw + j) * 4, _mm_activation_ps(_sum, activation_type, slope));
+            }
+            continue;
+        }
+
+        for (int j=0; j<j0; j++)
+        {
+            __m128 _sum = convdw_border_pack4_sse(img, w, h, k0, _bias0, kernel_w, kernel_h, dilation_w, dilation_h, y0, j * stride_w - pad_left);
+            _mm_storeu_ps(outptr + (i * outw + j) * 4, _mm_activation_ps(_sum, activation_type, slope));
+        }
+
+        const float* r0 = img + (y0 * w + j0 * stride_w - pad_left) * 4;
+        float* ptr = outptr + (i * outw + j0) * 4;
+
+        int j = j0;
+#if __AVX__
+        // two pixels per register
+        {
+            __m256 _bias1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_bias0), _bias0, 1);
+
+            if (stride_w == 1)
+            {
+                // neighbouring pixels are contiguous
+                for (; j+3<j1; j+=4)
+                {
+                    __m256 _sum0 = _bias1;
+                    __m256 _sum1 = _bias1;
+
+                    for (int k=0; k<maxk; k++)
+                    {
+                        __m256 _k = _mm256_broadcast_ps((const __m128*)(k0 + k * 4));
+                        _sum0 = _mm256_comp_fmadd_ps(_mm256_loadu_ps(r0 + space_ofs[k]), _k, _sum0);
+                        _sum1 = _mm256_comp_fmadd_ps(_mm256_loadu_ps(r0 + space_ofs[k] + 8), _k, _sum1);
+                    }
+
+                    _mm256_storeu_ps(ptr, _mm256_activation_ps(_sum0, activation_type, slope));
+                    _mm256_storeu_ps(ptr + 8, _mm256_activation_ps(_sum1, activation_type, slope));
+
+                    r0 += 16;
+                    ptr += 16;
+                }
+            }
+
+            for (; j+1<j1; j+=2)
+            {
+                __m256 _sum = _bias1;
+
+                const float* r1 = r0 + stride_w * 4;
+
+                for (int k=0; k<maxk; k++)
+                {
+                    __m256 _v = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(r0 + space_ofs[k])), _mm_loadu_ps(r1 + space_ofs[k]), 1);
+                    __m256 _k = _mm256_broadcast_ps((const __m128*)(k0 + k * 4));
+                    _sum = _mm256_comp_fmadd_ps(_v, _k, _sum);
+                }
+
+                _mm256_storeu_ps(ptr, _mm256_activation_ps(_sum, activation_type, slope));
+
+                r0 += stride_w * 8;
+                ptr += 8;
+            }
+        }
+#endif // __AVX__
+        for (; j<j1; j++)
+        {
+            __m128 _sum = _bias0;
+
+            for (int k=0; k<maxk; k++)
+            {
+                __m128 _v = _mm_loadu_ps(r0 + space_ofs[k]);
+                __m128 _k = _mm_loadu_ps(k0 + k * 4);
+                _sum = _mm_comp_fmadd_ps(_v, _k, _sum);
+            }
+
+            _mm_storeu_ps(ptr, _mm_activation_ps(_sum, activation_type, slope));
+
+            r0 += stride_w * 4;
+            ptr += 4;
+        }
+
+        for (j=j1; j<outw; j++)
+        {
+            __m128 _sum = convdw_border_pack4_sse(img, w, h, k0, _bias0, kernel_w, kernel_h, dilation_w, dilation_h, y0, j * stride_w - pad_left);
+            _mm_storeu_ps(outptr + (i * outw + j) * 4, _mm_activation_ps(_sum, activation_type, slope));
+        }
+    }
+#else
+    for (int i=0; i<outh; i++)
+    {
+        for (int j=0; j<outw; j++)
+        {
+            for (int l=0; l<4; l++)
+            {
+                float sum = bias ? bias[g * 4 + l] : 0.f;
+
+                for (int ky=0; ky<kernel_h; ky++)
+                {
+                    const int y = i * stride_h - pad_top + ky * dilation_h;
+                    if (y < 0 || y >= h)
+                        continue;
+
+                    for (int kx=0; kx<kernel_w; kx++)
+                    {
+                        const int x = j * stride_w - pad_left + kx * dilation_w;
+                        if (x < 0 || x >= w)
+                            continue;
+
+                        sum += img[(y * w + x) * 4 + l] * k0[(ky * kernel_w + kx) * 4 + l];
+                    }
+                }
+
+                outptr[(i * outw + j) * 4 + l] = activation_ss(sum, activation_type, activation_params);
+            }
+        }
+    }
+#endif // __SSE2__
+}
+
+} // namespace
+
+// depthwise on c/4-h-w-4 blobs, any kernel size stride and dilation, taps in the border read zero
+static void convdw_pack4_sse(const Mat& bottom_blob, Mat& top_blob, const Mat& kernel_pack4, const Mat& _bias, int kernel_w, int kernel_h, int dilation_w, int dilation_h, int stride_w, int stride_h, int pad_left, int pad_top, int activation_type, const Mat& activation_params, const Option& opt)
+{
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+
+    int outw = top_blob.w;
+    int outh = top_blob.h;
+
+    const int channels = bottom_blob.c;
+
+    const int maxk = kernel_w * kernel_h;
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    const float* bias = _bias;
+
+    // outputs in [j0, j1) x [i0, i1) need no border
+    const int j0 = std::min(outw, (pad_left + stride_w - 1) / stride_w);
+    const int j1 = std::max(j0, std::min(outw, w + pad_left >= kernel_extent_w ? (w + pad_left - kernel_extent_w) / stride_w + 1 : 0));
+    const int i0 = std::min(outh, (pad_top + stride_h - 1) / stride_h);
+    const int i1 = std::max(i0, std::min(outh, h + pad_top >= kernel_extent_h ? (h + pad_top - kernel_extent_h) / stride_h + 1 : 0));
+
+    // tap offsets in floats
+    std::vector<int> _space_ofs(maxk);
+    int* space_ofs = &_space_ofs[0];
+    {
+        int p1 = 0;
+        int p2 = 0;
+        int gap = w * dilation_h - kernel_w * dilation_w;
+        for (int ky=0; ky<kernel_h; ky++)
+        {
+            for (int kx=0; kx<kernel_w; kx++)
+            {
+                space_ofs[p1] = p2 * 4;
+                p1++;
+                p2 += dilation_w;
+            }
+            p2 += gap;
+        }
+    }
+
+    convdw_pack4_sse_task task(bottom_blob, top_blob, kernel_pack4, bias, activation_params, activation_type, kernel_w, kernel_h, dilation_w, dilation_h, stride_w, stride_h, pad_left, pad_top, maxk, i0, i1, j0, j1, space_ofs);
+
+    parallel_for(task, channels, opt);
+}
@@ -14,147 +14,69 @@
 
 #include "convolutiondepthwise_x86.h"
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
+#include <algorithm>
 
+#include "fused_activation.h"
 #include "layer_type.h"
+#include "threadpool.h"
+#include "x86_usability.h"
 
 namespace ncnn {
 
-#include "convolutiondepthwise_3x3.h"
+#include "convolutiondepthwise_sse.h"
 
 DEFINE_LAYER_CREATOR(ConvolutionDepthWise_x86)
 
-int ConvolutionDepthWise_x86::forward(const Mat& bottom_blob, Mat& top_blob) const
+ConvolutionDepthWise_x86::ConvolutionDepthWise_x86()
 {
-    // convolv with NxN kernel
-    // value = value + bias
+}
 
-    int w = bottom_blob.w;
-    int h = bottom_blob.h;
-    int channels = bottom_blob.c;
+ConvolutionDepthWise_x86::~ConvolutionDepthWise_x86()
+{
+    for (int i=0; i<(int)group_ops.size(); i++)
+        delete group_ops[i];
 
-    if (channels % group != 0 || num_output % group != 0)
-    {
-        // reject invalid group
-        return -100;
-    }
+    group_ops.clear();
+}
 
-    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
-    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+int ConvolutionDepthWise_x86::create_pipeline()
+{
+    int ret = ConvolutionDepthWise::create_pipeline();
+    if (ret != 0)
+        return ret;
 
-    Mat bottom_blob_bordered = bottom_blob;
-    if (pad_w > 0 || pad_h > 0)
-    {
-        copy_make_border(bottom_blob, bottom_blob_bordered, pad_h, pad_h, pad_w, pad_w, BORDER_CONSTANT, 0.f);
-        if (bottom_blob_bordered.empty())
-            return -100;
+    for (int i=0; i<(int)group_ops.size(); i++)
+        delete group_ops[i];
 
-        w = bottom_blob_bordered.w;
-        h = bottom_blob_bordered.h;
-    }
-    else if (pad_w == -233 && pad_h == -233)
-    {
-        int wpad = kernel_extent_w + (w - 1) / stride_w * stride_w - w;
-        int hpad = kernel_extent_h + (h - 1) / stride_h * stride_h - h;
-        if (wpad > 0 || hpad > 0)
-        {
-            copy_make_border(bottom_blob, bottom_blob_bordered, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, BORDER_CONSTANT, 0.f);
-            if (bottom_blob_bordered.empty())
-                return -100;
-        }
+    group_ops.clear();
 
-        w = bottom_blob_bordered.w;
-        h = bottom_blob_bordered.h;
+    // the int8 path runs the generic kernel on the int8 weights
+    if (use_int8_inference)
+    {
+        support_packing = false;
+        return 0;
     }
 
-    int outw = (w - kernel_extent_w) / stride_w + 1;
-    int outh = (h - kernel_extent_h) / stride_h + 1;
-
-    top_blob.create(outw, outh, num_output);
-    if (top_blob.empty())
-        return -100;
-
     const int maxk = kernel_w * kernel_h;
+    const int channels = weight_data_size / maxk / num_output * group;
 
-    // depth-wise
-    if (channels == group && group == num_output)
-    {
-        if (kernel_w == 3 && kernel_h == 3 && dilation_w == 1 && dilation_h == 1)
-        {
-            if (stride_w == 1 && stride_h == 1)
-            {
-                convdw3x3s1_sse(bottom_blob_bordered, top_blob, weight_data, bias_data);
-                return 0;
-            }
-            else if (stride_w == 2 && stride_h == 2)
-            {
-                convdw3x3s2_sse(bottom_blob_bordered, top_blob, weight_data, bias_data);
-                return 0;
-            }
-        }
-
-#ifdef _OPENMP
-        int nested_current = omp_get_nested();
-        omp_set_nested(0);
-#endif
+    support_packing = channels == group && group == num_output && group % 4 == 0;
 
-        #pragma omp parallel for
-        for (int g=0; g<group; g++)
-        {
-            Mat bottom_blob_bordered_g = bottom_blob_bordered.channel(g);
-            Mat top_blob_g = top_blob.channel(g);
-            Mat weight_data_g(maxk, (void*)((const float*)weight_data + maxk * g));
-            Mat bias_data_g;
-            if (bias_term)
-                bias_data_g = Mat(1, (void*)((const float*)bias_data + g));
-
-            // call Convolution
-            ncnn::Layer* op = ncnn::create_layer(ncnn::LayerType::Convolution);
-
-            // set param
-            ncnn::ParamDict pd;
-            pd.set(0, 1);// num_output
-            pd.set(1, kernel_w);
-            pd.set(11, kernel_h);
-            pd.set(2, dilation_w);
-            pd.set(12, dilation_h);
-            pd.set(3, stride_w);
-            pd.set(13, stride_h);
-            pd.set(4, 0);// pad_w
-            pd.set(14, 0);// pad_h
-            pd.set(5, bias_term);
-            pd.set(6, maxk);// weight_data_size
-
-            op->load_param(pd);
-
-            // set weights
-            ncnn::Mat weights[2];
-            weights[0] = weight_data_g;
-            weights[1] = bias_data_g;
-
-            op->load_model(ModelBinFromMatArray(weights));
-
-            // forward
-            op->forward(bottom_blob_bordered_g, top_blob_g);
-
-            delete op;
-        }
+    if (support_packing)
+    {
+        convdw_transform_kernel_pack4_sse(weight_data, weight_data_pack4, group, maxk);
+    }
 
-#ifdef _OPENMP
-        omp_set_nested(nested_current);
-#endif
+    if (!need_group_ops())
         return 0;
-    }
 
     const int channels_g = channels / group;
     const int num_output_g = num_output / group;
 
+    group_ops.resize(group);
+
     for (int g=0; g<group; g++)
     {
-        Mat bottom_blob_bordered_g(w, h, channels_g, bottom_blob_bordered.channel(channels_g * g));
-        Mat top_blob_g(outw, outh, num_output_g, top_blob.channel(num_output_g * g));
         Mat weight_data_g(maxk * channels_g * num_output_g, (void*)((const float*)weight_data + maxk * channels_g * num_output_g * g));
         Mat bias_data_g;
         if (bias_term)
@@ -172,10 +94,12 @@ int ConvolutionDepthWise_x86::forward(const Mat& bottom_blob, Mat& top_blob) con
         pd.set(12, dilation_h);
         pd.set(3, stride_w);
         pd.set(13, stride_h);
-        pd.set(4, 0);// pad_w
-        pd.set(14, 0);// pad_h
+        pd.set(4, pad_w);// the group op pads its own input
+        pd.set(14, pad_h);
         pd.set(5, bias_term);
         pd.set(6, maxk * channels_g * num_output_g);// weight_data_size
+        pd.set(9, activation_type);
+        pd.set(10, activation_params);
 
         op->load_param(pd);
 
@@ -186,10 +110,254 @@ int ConvolutionDepthWise_x86::forward(const Mat& bottom_blob, Mat& top_blob) con
 
         op->load_model(ModelBinFromMatArray(weights));
 
-        // forward
-        op->forward(bottom_blob_bordered_g, top_blob_g);
+        op->create_pipeline();
+
+        group_ops[g] = op;
+    }
+
+    return 0;
+}
+
+int ConvolutionDepthWise_x86::save_prepared(std::vector<Mat>& weights) const
+{
+    // the group ops are rebuilt from the model weights
+    if (!group_ops.empty())
+        return -1;
+
+    int ret = ConvolutionDepthWise::save_prepared(weights);
+    if (ret != 0)
+        return ret;
+
+    weights.push_back(weight_data_pack4);
+
+    return 0;
+}
+
+int ConvolutionDepthWise_x86::load_prepared(const ModelBin& mb)
+{
+    int ret = ConvolutionDepthWise::load_prepared(mb);
+    if (ret != 0)
+        return ret;
+
+    weight_data_pack4 = mb.load(0, 0);
+
+    if (use_int8_inference)
+    {
+        support_packing = false;
+        return 0;
+    }
+
+    const int maxk = kernel_w * kernel_h;
+    const int channels = weight_data_size / maxk / num_output * group;
+
+    support_packing = channels == group && group == num_output && group % 4 == 0;
+
+    if (need_group_ops())
+        return -1;
+
+    return 0;
+}
+
+bool ConvolutionDepthWise_x86::need_group_ops() const
+{
+    const int maxk = kernel_w * kernel_h;
+    const int channels = weight_data_size / maxk / num_output * group;
+
+    // depth-wise
+    if (channels == group && group == num_output)
+    {
+        // the sse kernels need no sub op
+        if (kernel_w == kernel_h && (kernel_w == 3 || kernel_w == 5) && dilation_w == 1 && dilation_h == 1 && stride_w == stride_h && (stride_w == 1 || stride_w == 2))
+            return false;
+    }
+
+    return true;
+}
+
+const char* ConvolutionDepthWise_x86::kernel_name(const Mat& bottom_blob) const
+{
+    // same choice as forward
+    if (use_int8_inference)
+        return "int8";
+
+    if (bottom_blob.elempack == 4)
+        return "convdw_pack4";
+
+    const int channels = bottom_blob.c;
 
-        delete op;
+    if (channels == group && group == num_output && kernel_w == kernel_h && (kernel_w == 3 || kernel_w == 5)
+        && dilation_w == 1 && dilation_h == 1 && stride_w == stride_h && (stride_w == 1 || stride_w == 2))
+    {
+        if (kernel_w == 3 && stride_w == 1)
+            return "convdw3x3s1";
+        if (kernel_w == 3 && stride_w == 2)
+            return "convdw3x3s2";
+        if (kernel_w == 5 && stride_w == 1)
+            return "convdw5x5s1";
+        return "convdw5x5s2";
+    }
+
+    if ((int)group_ops.size() != group)
+        return 0;
+
+    return "group_ops";
+}
+
+namespace {
+
+// one group through its own op
+struct convdw_group_ops_task : public ParallelTask
+{
+    convdw_group_ops_task(const std::vector<Layer*>& _group_ops, const Mat& _bottom_blob, Mat& _top_blob, const Option& _opt, int _w, int _h, int _outw, int _outh)
+        : group_ops(_group_ops), bottom_blob(_bottom_blob), top_blob(_top_blob), opt(_opt), w(_w), h(_h), outw(_outw), outh(_outh)
+    {
+    }
+
+    virtual void execute(int g) const;
+
+    const std::vector<Layer*>& group_ops;
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    const Option& opt;
+    int w;
+    int h;
+    int outw;
+    int outh;
+};
+
+void convdw_group_ops_task::execute(int g) const
+{
+    // single channel 3d views, the op would reallocate a 2d top
+    Mat bottom_blob_g(w, h, 1, (void*)(const float*)bottom_blob.channel(g));
+    Mat top_blob_g(outw, outh, 1, top_blob.channel(g));
+
+    // forward
+    Option opt_g = opt;
+    opt_g.blob_allocator = top_blob_g.allocator;
+    group_ops[g]->forward(bottom_blob_g, top_blob_g, opt_g);
+}
+
+} // namespace
+
+int ConvolutionDepthWise_x86::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    if (use_int8_inference)
+        return ConvolutionDepthWise::forward_int8(bottom_blob, top_blob, opt);
+
+    // convolv with NxN kernel
+    // value = value + bias
+
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+
+    if (bottom_blob.elempack == 4)
+    {
+        int pad_left;
+        int pad_right;
+        int pad_top;
+        int pad_bottom;
+        get_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
+
+        int outw = (w + pad_left + pad_right - (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+        int outh = (h + pad_top + pad_bottom - (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+
+        top_blob.create(outw, outh, channels, 16u, 4, opt.blob_allocator);
+        if (top_blob.empty())
+            return -100;
+
+        convdw_pack4_sse(bottom_blob, top_blob, weight_data_pack4, bias_data, kernel_w, kernel_h, dilation_w, dilation_h, stride_w, stride_h, pad_left, pad_top, activation_type, activation_params, opt);
+
+        return 0;
+    }
+
+    if (channels % group != 0 || num_output % group != 0)
+    {
+        // reject invalid group
+        return -100;
+    }
+
+    const int kernel_extent_w = dilation_w * (kernel_w - 1) + 1;
+    const int kernel_extent_h = dilation_h * (kernel_h - 1) + 1;
+
+    // depth-wise 3x3 5x5 s1 s2 pad inside the kernel
+    if (channels == group && group == num_output && kernel_w == kernel_h && (kernel_w == 3 || kernel_w == 5)
+        && dilation_w == 1 && dilation_h == 1 && stride_w == stride_h && (stride_w == 1 || stride_w == 2))
+    {
+        int pad_left;
+        int pad_right;
+        int pad_top;
+        int pad_bottom;
+        get_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
+
+        int outw = (w + pad_left + pad_right - kernel_w) / stride_w + 1;
+        int outh = (h + pad_top + pad_bottom - kernel_h) / stride_h + 1;
+
+        top_blob.create(outw, outh, num_output, 4u, opt.blob_allocator);
+        if (top_blob.empty())
+            return -100;
+
+        if (kernel_w == 3 && stride_w == 1)
+            convdw3x3s1_sse(bottom_blob, top_blob, weight_data, bias_data, pad_left, pad_top, activation_type, activation_params, opt);
+        else if (kernel_w == 3 && stride_w == 2)
+            convdw3x3s2_sse(bottom_blob, top_blob, weight_data, bias_data, pad_left, pad_top, activation_type, activation_params, opt);
+        else if (kernel_w == 5 && stride_w == 1)
+            convdw5x5s1_sse(bottom_blob, top_blob, weight_data, bias_data, pad_left, pad_top, activation_type, activation_params, opt);
+        else
+            convdw5x5s2_sse(bottom_blob, top_blob, weight_data, bias_data, pad_left, pad_top, activation_type, activation_params, opt);
+
+        return 0;
+    }
+
+    int pad_left;
+    int pad_right;
+    int pad_top;
+    int pad_bottom;
+    get_padding(w, h, pad_left, pad_right, pad_top, pad_bottom);
+
+    int outw = (w + pad_left + pad_right - kernel_extent_w) / stride_w + 1;
+    int outh = (h + pad_top + pad_bottom - kernel_extent_h) / stride_h + 1;
+
+    top_blob.create(outw, outh, num_output, 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    // depth-wise
+    if (channels == group && group == num_output)
+    {
+        if ((int)group_ops.size() != group)
+        {
+            return ConvolutionDepthWise::forward(bottom_blob, top_blob, opt);
+        }
+
+        // the groups are split among the threads, each group op runs single threaded
+        Option opt_g = opt;
+        opt_g.num_threads = 1;
+
+        convdw_group_ops_task task(group_ops, bottom_blob, top_blob, opt_g, w, h, outw, outh);
+
+        parallel_for(task, group, opt);
+
+        return 0;
+    }
+
+    if ((int)group_ops.size() != group)
+    {
+        return ConvolutionDepthWise::forward(bottom_blob, top_blob, opt);
+    }
+
+    const int channels_g = channels / group;
+    const int num_output_g = num_output / group;
+
+    for (int g=0; g<group; g++)
+    {
+        Mat bottom_blob_g(w, h, channels_g, (void*)(const float*)bottom_blob.channel(channels_g * g));
+        Mat top_blob_g(outw, outh, num_output_g, top_blob.channel(num_output_g * g));
+
+        // forward
+        Option opt_g = opt;
+        opt_g.blob_allocator = top_blob_g.allocator;
+        group_ops[g]->forward(bottom_blob_g, top_blob_g, opt_g);
     }
 
     return 0;
@@ -22,7 +22,29 @@ namespace ncnn {
 class ConvolutionDepthWise_x86 : public ConvolutionDepthWise
 {
 public:
-    virtual int forward(const Mat& bottom_blob, Mat& top_blob) const;
+    ConvolutionDepthWise_x86();
+    virtual ~ConvolutionDepthWise_x86();
+
+    virtual int create_pipeline();
+
+    virtual int save_prepared(std::vector<Mat>& weights) const;
+
+    virtual int load_prepared(const ModelBin& mb);
+
+    virtual int forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const;
+
+    virtual const char* kernel_name(const Mat& bottom_blob) const;
+
+protected:
+    // whether forward goes through one Convolution per group
+    bool need_group_ops() const;
+
+public:
+    // one Convolution per group, built once with the weights
+    std::vector<ncnn::Layer*> group_ops;
+
+    // depth-wise on c/4-h-w-4 blobs
+    Mat weight_data_pack4;
 };
 
 } // namespace ncnn
@@ -0,0 +1,269 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "eltwise_x86.h"
+
+#include <algorithm>
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(Eltwise_x86)
+
+// internal linkage, every isa build has its own ops
+namespace {
+
+struct eltwise_op_prod
+{
+    float func(float x, float y) const { return x * y; }
+#if __SSE2__
+    __m128 func_pack4(__m128 x, __m128 y) const { return _mm_mul_ps(x, y); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x, __m256 y) const { return _mm256_mul_ps(x, y); }
+#endif // __AVX__
+};
+
+struct eltwise_op_sum
+{
+    float func(float x, float y) const { return x + y; }
+#if __SSE2__
+    __m128 func_pack4(__m128 x, __m128 y) const { return _mm_add_ps(x, y); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x, __m256 y) const { return _mm256_add_ps(x, y); }
+#endif // __AVX__
+};
+
+struct eltwise_op_max
+{
+    float func(float x, float y) const { return std::max(x, y); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x, __m128 y) const { return _mm_max_ps(x, y); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x, __m256 y) const { return _mm256_max_ps(x, y); }
+#endif // __AVX__
+};
+
+} // namespace
+
+// outptr may alias ptr
+template<typename Op>
+static void eltwise_sse(const float* ptr, const float* ptr1, float* outptr, int size)
+{
+    Op op;
+
+    int i = 0;
+#if __AVX__
+    for (; i+7<size; i+=8)
+    {
+        __m256 _p = _mm256_loadu_ps(ptr);
+        __m256 _p1 = _mm256_loadu_ps(ptr1);
+        _mm256_storeu_ps(outptr, op.func_pack8(_p, _p1));
+        ptr += 8;
+        ptr1 += 8;
+        outptr += 8;
+    }
+#endif // __AVX__
+#if __SSE2__
+    for (; i+3<size; i+=4)
+    {
+        __m128 _p = _mm_loadu_ps(ptr);
+        __m128 _p1 = _mm_loadu_ps(ptr1);
+        _mm_storeu_ps(outptr, op.func_pack4(_p, _p1));
+        ptr += 4;
+        ptr1 += 4;
+        outptr += 4;
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *outptr = op.func(*ptr, *ptr1);
+        ptr++;
+        ptr1++;
+        outptr++;
+    }
+}
+
+// outptr = ptr * coeff0 + ptr1 * coeff1, outptr may alias ptr
+static void eltwise_sum_coeff_sse(const float* ptr, float coeff0, const float* ptr1, float coeff1, float* outptr, int size)
+{
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _coeff0 = _mm256_set1_ps(coeff0);
+        __m256 _coeff1 = _mm256_set1_ps(coeff1);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_mul_ps(_mm256_loadu_ps(ptr), _coeff0);
+            __m256 _p1 = _mm256_loadu_ps(ptr1);
+            _mm256_storeu_ps(outptr, _mm256_comp_fmadd_ps(_p1, _coeff1, _p));
+            ptr += 8;
+            ptr1 += 8;
+            outptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _coeff0 = _mm_set1_ps(coeff0);
+        __m128 _coeff1 = _mm_set1_ps(coeff1);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_mul_ps(_mm_loadu_ps(ptr), _coeff0);
+            __m128 _p1 = _mm_loadu_ps(ptr1);
+            _mm_storeu_ps(outptr, _mm_comp_fmadd_ps(_p1, _coeff1, _p));
+            ptr += 4;
+            ptr1 += 4;
+            outptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *outptr = *ptr * coeff0 + *ptr1 * coeff1;
+        ptr++;
+        ptr1++;
+        outptr++;
+    }
+}
+
+namespace {
+
+// one channel of c = a op b
+template<typename Op>
+struct eltwise_sse_task : public ParallelTask
+{
+    eltwise_sse_task(const Mat& _a, const Mat& _b, Mat& _c, int _size)
+        : a(_a), b(_b), c(_c), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    int size;
+};
+
+template<typename Op>
+void eltwise_sse_task<Op>::execute(int q) const
+{
+    eltwise_sse<Op>(a.channel(q), b.channel(q), c.channel(q), size);
+}
+
+// one channel of c = a * coeff0 + b * coeff1
+struct eltwise_sum_coeff_sse_task : public ParallelTask
+{
+    eltwise_sum_coeff_sse_task(const Mat& _a, const Mat& _b, Mat& _c, float _coeff0, float _coeff1, int _size)
+        : a(_a), b(_b), c(_c), coeff0(_coeff0), coeff1(_coeff1), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& a;
+    const Mat& b;
+    Mat& c;
+    float coeff0;
+    float coeff1;
+    int size;
+};
+
+void eltwise_sum_coeff_sse_task::execute(int q) const
+{
+    eltwise_sum_coeff_sse(a.channel(q), coeff0, b.channel(q), coeff1, c.channel(q), size);
+}
+
+} // namespace
+
+template<typename Op>
+static void eltwise_blobs_sse(const std::vector<Mat>& bottom_blobs, Mat& top_blob, const Option& opt)
+{
+    int channels = top_blob.c;
+    int size = top_blob.w * top_blob.h * top_blob.elempack;
+
+    // first blob
+    {
+        eltwise_sse_task<Op> task(bottom_blobs[0], bottom_blobs[1], top_blob, size);
+
+        parallel_for(task, channels, opt);
+    }
+
+    for (size_t b=2; b<bottom_blobs.size(); b++)
+    {
+        eltwise_sse_task<Op> task(top_blob, bottom_blobs[b], top_blob, size);
+
+        parallel_for(task, channels, opt);
+    }
+}
+
+Eltwise_x86::Eltwise_x86()
+{
+    support_packing = true;
+}
+
+int Eltwise_x86::forward(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    const Mat& bottom_blob = bottom_blobs[0];
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+    int size = w * h * bottom_blob.elempack;
+
+    Mat& top_blob = top_blobs[0];
+    top_blob.create(w, h, channels, bottom_blob.elemsize, bottom_blob.elempack, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    if (op_type == Operation_PROD)
+    {
+        eltwise_blobs_sse<eltwise_op_prod>(bottom_blobs, top_blob, opt);
+    }
+    else if (op_type == Operation_SUM)
+    {
+        if (coeffs.w == 0)
+        {
+            eltwise_blobs_sse<eltwise_op_sum>(bottom_blobs, top_blob, opt);
+        }
+        else
+        {
+            // first blob
+            {
+                eltwise_sum_coeff_sse_task task(bottom_blob, bottom_blobs[1], top_blob, coeffs[0], coeffs[1], size);
+
+                parallel_for(task, channels, opt);
+            }
+
+            for (size_t b=2; b<bottom_blobs.size(); b++)
+            {
+                eltwise_sum_coeff_sse_task task(top_blob, bottom_blobs[b], top_blob, 1.f, coeffs[b], size);
+
+                parallel_for(task, channels, opt);
+            }
+        }
+    }
+    else if (op_type == Operation_MAX)
+    {
+        eltwise_blobs_sse<eltwise_op_max>(bottom_blobs, top_blob, opt);
+    }
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,112 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "elu_x86.h"
+
+#include <math.h>
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+#if __SSE2__
+#include "sse_mathfun.h"
+#endif // __SSE2__
+#if __AVX__
+#include "avx_mathfun.h"
+#endif // __AVX__
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(ELU_x86)
+
+namespace {
+
+// one channel
+struct elu_sse_task : public ParallelTask
+{
+    elu_sse_task(Mat& _bottom_top_blob, int _size, float _alpha)
+        : bottom_top_blob(_bottom_top_blob), size(_size), alpha(_alpha)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float alpha;
+};
+
+void elu_sse_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    // max(x, 0) + alpha * (exp(min(x, 0)) - 1)
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _zero = _mm256_setzero_ps();
+        __m256 _one = _mm256_set1_ps(1.f);
+        __m256 _alpha = _mm256_set1_ps(alpha);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            __m256 _pos = _mm256_max_ps(_p, _zero);
+            __m256 _neg = _mm256_sub_ps(exp256_ps(_mm256_min_ps(_p, _zero)), _one);
+            _p = _mm256_comp_fmadd_ps(_neg, _alpha, _pos);
+            _mm256_storeu_ps(ptr, _p);
+            ptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _zero = _mm_setzero_ps();
+        __m128 _one = _mm_set1_ps(1.f);
+        __m128 _alpha = _mm_set1_ps(alpha);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            __m128 _pos = _mm_max_ps(_p, _zero);
+            __m128 _neg = _mm_sub_ps(exp_ps(_mm_min_ps(_p, _zero)), _one);
+            _p = _mm_comp_fmadd_ps(_neg, _alpha, _pos);
+            _mm_storeu_ps(ptr, _p);
+            ptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        if (*ptr < 0.f)
+            *ptr = alpha * (exp(*ptr) - 1.f);
+        ptr++;
+    }
+}
+
+} // namespace
+
+int ELU_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    int w = bottom_top_blob.w;
+    int h = bottom_top_blob.h;
+    int channels = bottom_top_blob.c;
+    int size = w * h;
+
+    elu_sse_task task(bottom_top_blob, size, alpha);
+
+    parallel_for(task, channels, opt);
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,669 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "innerproduct_x86.h"
+
+#include <algorithm>
+
+#include "fused_activation.h"
+#include "quantize_int8.h"
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+// outputs per block, also the number of inputs read at once
+#if __AVX__
+#define INNERPRODUCT_PACK 8
+#else
+#define INNERPRODUCT_PACK 4
+#endif
+
+// block layout, inputs in groups of PACK then the K % PACK tail
+//   group : out0 k0..k7, out1 k0..k7, ... out7 k0..k7
+//   tail  : k out0..out7
+// either way input k starts at k * PACK
+
+// partial sums of one output block over inputs [k0, k1), k0 is a multiple of PACK
+static void innerproduct_pack_sse(const float* x, const float* kptr, int k0, int k1, int K, float* sum)
+{
+    const int kmain = std::min(k1, K / INNERPRODUCT_PACK * INNERPRODUCT_PACK);
+
+    kptr += k0 * INNERPRODUCT_PACK;
+
+    int k = k0;
+#if __AVX__
+    __m256 _sum[8];
+    for (int j=0; j<8; j++)
+        _sum[j] = _mm256_setzero_ps();
+
+    for (; k<kmain; k+=8)
+    {
+        __m256 _x = _mm256_loadu_ps(x + k);
+        for (int j=0; j<8; j++)
+            _sum[j] = _mm256_comp_fmadd_ps(_x, _mm256_loadu_ps(kptr + j * 8), _sum[j]);
+        kptr += 64;
+    }
+
+    // lane j of the sum of the transposed rows is the dot product of output j
+    transpose8_ps(_sum);
+    __m256 _out = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_sum[0], _sum[1]), _mm256_add_ps(_sum[2], _sum[3])),
+                                _mm256_add_ps(_mm256_add_ps(_sum[4], _sum[5]), _mm256_add_ps(_sum[6], _sum[7])));
+
+    for (; k<k1; k++)
+    {
+        _out = _mm256_comp_fmadd_ps(_mm256_set1_ps(x[k]), _mm256_loadu_ps(kptr), _out);
+        kptr += 8;
+    }
+
+    _mm256_storeu_ps(sum, _out);
+#elif __SSE2__
+    __m128 _sum0 = _mm_setzero_ps();
+    __m128 _sum1 = _mm_setzero_ps();
+    __m128 _sum2 = _mm_setzero_ps();
+    __m128 _sum3 = _mm_setzero_ps();
+
+    for (; k<kmain; k+=4)
+    {
+        __m128 _x = _mm_loadu_ps(x + k);
+        _sum0 = _mm_comp_fmadd_ps(_x, _mm_loadu_ps(kptr), _sum0);
+        _sum1 = _mm_comp_fmadd_ps(_x, _mm_loadu_ps(kptr + 4), _sum1);
+        _sum2 = _mm_comp_fmadd_ps(_x, _mm_loadu_ps(kptr + 8), _sum2);
+        _sum3 = _mm_comp_fmadd_ps(_x, _mm_loadu_ps(kptr + 12), _sum3);
+        kptr += 16;
+    }
+
+    _MM_TRANSPOSE4_PS(_sum0, _sum1, _sum2, _sum3);
+    __m128 _out = _mm_add_ps(_mm_add_ps(_sum0, _sum1), _mm_add_ps(_sum2, _sum3));
+
+    for (; k<k1; k++)
+    {
+        _out = _mm_comp_fmadd_ps(_mm_set1_ps(x[k]), _mm_loadu_ps(kptr), _out);
+        kptr += 4;
+    }
+
+    _mm_storeu_ps(sum, _out);
+#else
+    for (int j=0; j<INNERPRODUCT_PACK; j++)
+        sum[j] = 0.f;
+
+    for (; k<kmain; k+=INNERPRODUCT_PACK)
+    {
+        for (int j=0; j<INNERPRODUCT_PACK; j++)
+        {
+            for (int i=0; i<INNERPRODUCT_PACK; i++)
+                sum[j] += x[k + i] * kptr[i];
+            kptr += INNERPRODUCT_PACK;
+        }
+    }
+
+    for (; k<k1; k++)
+    {
+        for (int j=0; j<INNERPRODUCT_PACK; j++)
+            sum[j] += x[k] * kptr[j];
+        kptr += INNERPRODUCT_PACK;
+    }
+#endif
+}
+
+#if __F16C__
+// same with fp16 weights, half the bytes to stream
+static void innerproduct_pack_fp16_sse(const float* x, const unsigned short* kptr, int k0, int k1, int K, float* sum)
+{
+    const int kmain = std::min(k1, K / 8 * 8);
+
+    kptr += k0 * 8;
+
+    int k = k0;
+    __m256 _sum[8];
+    for (int j=0; j<8; j++)
+        _sum[j] = _mm256_setzero_ps();
+
+    for (; k<kmain; k+=8)
+    {
+        __m256 _x = _mm256_loadu_ps(x + k);
+        for (int j=0; j<8; j++)
+        {
+            __m256 _w = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(kptr + j * 8)));
+            _sum[j] = _mm256_comp_fmadd_ps(_x, _w, _sum[j]);
+        }
+        kptr += 64;
+    }
+
+    transpose8_ps(_sum);
+    __m256 _out = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_sum[0], _sum[1]), _mm256_add_ps(_sum[2], _sum[3])),
+                                _mm256_add_ps(_mm256_add_ps(_sum[4], _sum[5]), _mm256_add_ps(_sum[6], _sum[7])));
+
+    for (; k<k1; k++)
+    {
+        __m256 _w = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)kptr));
+        _out = _mm256_comp_fmadd_ps(_mm256_set1_ps(x[k]), _w, _out);
+        kptr += 8;
+    }
+
+    _mm256_storeu_ps(sum, _out);
+}
+#endif // __F16C__
+
+// int8 dot product, sign extended to int16 and summed pairwise into int32
+static int innerproduct_int8_sse(const signed char* x, const signed char* kptr, int K)
+{
+    int sum = 0;
+
+    int k = 0;
+#if __AVX2__
+    __m256i _sum0 = _mm256_setzero_si256();
+    __m256i _sum1 = _mm256_setzero_si256();
+    for (; k+31<K; k+=32)
+    {
+        __m256i _x0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x + k)));
+        __m256i _x1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(x + k + 16)));
+        __m256i _w0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(kptr + k)));
+        __m256i _w1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(kptr + k + 16)));
+        _sum0 = _mm256_add_epi32(_sum0, _mm256_madd_epi16(_x0, _w0));
+        _sum1 = _mm256_add_epi32(_sum1, _mm256_madd_epi16(_x1, _w1));
+    }
+    sum = _mm256_reduce_add_epi32(_mm256_add_epi32(_sum0, _sum1));
+#elif __SSE2__
+    __m128i _sum0 = _mm_setzero_si128();
+    __m128i _sum1 = _mm_setzero_si128();
+    for (; k+15<K; k+=16)
+    {
+        __m128i _x0 = _mm_comp_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)(x + k)));
+        __m128i _x1 = _mm_comp_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)(x + k + 8)));
+        __m128i _w0 = _mm_comp_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)(kptr + k)));
+        __m128i _w1 = _mm_comp_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)(kptr + k + 8)));
+        _sum0 = _mm_add_epi32(_sum0, _mm_madd_epi16(_x0, _w0));
+        _sum1 = _mm_add_epi32(_sum1, _mm_madd_epi16(_x1, _w1));
+    }
+    sum = _mm_reduce_add_epi32(_mm_add_epi32(_sum0, _sum1));
+#endif // __AVX2__
+    for (; k<K; k++)
+    {
+        sum += x[k] * kptr[k];
+    }
+
+    return sum;
+}
+
+// partial sums of output block b over inputs [k0, k1) from the packed weights
+static inline void innerproduct_pack_block_sse(const float* x, const Mat& weight_data_packed, bool use_fp16_weight, int b, int k0, int k1, int K, float* sum)
+{
+#if __F16C__
+    if (use_fp16_weight)
+    {
+        innerproduct_pack_fp16_sse(x, weight_data_packed.row<unsigned short>(b), k0, k1, K, sum);
+        return;
+    }
+#else
+    (void)use_fp16_weight;
+#endif // __F16C__
+
+    innerproduct_pack_sse(x, weight_data_packed.row(b), k0, k1, K, sum);
+}
+
+// inputs per weight chunk in the batched forward, a multiple of INNERPRODUCT_PACK
+// 256 x 8 floats of weights stay in l1 while every sample passes by
+#define INNERPRODUCT_BATCH_KCHUNK 256
+
+namespace {
+
+// one output block over one split of the inputs
+struct innerproduct_pack_sse_task : public ParallelTask
+{
+    innerproduct_pack_sse_task(const Mat& _weight_data_packed, Mat& _sums, const float* _x, int _K, int _ksplit, int _nn_outch, bool _use_fp16_weight)
+        : weight_data_packed(_weight_data_packed), sums(_sums), x(_x), K(_K), ksplit(_ksplit), nn_outch(_nn_outch), use_fp16_weight(_use_fp16_weight)
+    {
+    }
+
+    virtual void execute(int index) const;
+
+    const Mat& weight_data_packed;
+    Mat& sums;
+    const float* x;
+    int K;
+    int ksplit;
+    int nn_outch;
+    bool use_fp16_weight;
+};
+
+void innerproduct_pack_sse_task::execute(int index) const
+{
+    const int s = index / nn_outch;
+    const int b = index % nn_outch;
+
+    const int k0 = std::min(K, s * ksplit);
+    const int k1 = std::min(K, k0 + ksplit);
+
+    float* sum = sums.row(s) + b * INNERPRODUCT_PACK;
+
+    innerproduct_pack_block_sse(x, weight_data_packed, use_fp16_weight, b, k0, k1, K, sum);
+}
+
+// one output block for all samples, chunk by chunk of the inputs
+struct innerproduct_pack_batch_sse_task : public ParallelTask
+{
+    innerproduct_pack_batch_sse_task(const Mat& _weight_data_packed, const std::vector<Mat>& _bottom_blobs, Mat& _sums, int _K, bool _use_fp16_weight)
+        : weight_data_packed(_weight_data_packed), bottom_blobs(_bottom_blobs), sums(_sums), K(_K), use_fp16_weight(_use_fp16_weight)
+    {
+    }
+
+    virtual void execute(int b) const;
+
+    const Mat& weight_data_packed;
+    const std::vector<Mat>& bottom_blobs;
+    Mat& sums;
+    int K;
+    bool use_fp16_weight;
+};
+
+void innerproduct_pack_batch_sse_task::execute(int b) const
+{
+    const int batch = bottom_blobs.size();
+
+    for (int n=0; n<batch; n++)
+    {
+        float* outsum = sums.row(n) + b * INNERPRODUCT_PACK;
+        for (int j=0; j<INNERPRODUCT_PACK; j++)
+            outsum[j] = 0.f;
+    }
+
+    for (int k0=0; k0<K; k0+=INNERPRODUCT_BATCH_KCHUNK)
+    {
+        const int k1 = std::min(K, k0 + INNERPRODUCT_BATCH_KCHUNK);
+
+        for (int n=0; n<batch; n++)
+        {
+            float sum[INNERPRODUCT_PACK];
+            innerproduct_pack_block_sse(bottom_blobs[n], weight_data_packed, use_fp16_weight, b, k0, k1, K, sum);
+
+            float* outsum = sums.row(n) + b * INNERPRODUCT_PACK;
+            for (int j=0; j<INNERPRODUCT_PACK; j++)
+                outsum[j] += sum[j];
+        }
+    }
+}
+
+} // namespace
+
+DEFINE_LAYER_CREATOR(InnerProduct_x86)
+
+InnerProduct_x86::InnerProduct_x86()
+{
+    use_fp16_weight = false;
+}
+
+int InnerProduct_x86::create_pipeline()
+{
+    int ret = InnerProduct::create_pipeline();
+    if (ret != 0)
+        return ret;
+
+    // the int8 path keeps no float copy
+    if (use_int8_inference)
+        return 0;
+
+    const int K = weight_data_size / num_output;
+    const int kmain = K / INNERPRODUCT_PACK * INNERPRODUCT_PACK;
+    const int nn_outch = (num_output + INNERPRODUCT_PACK - 1) / INNERPRODUCT_PACK;
+
+    Mat weight_data_tm;
+    weight_data_tm.create(K * INNERPRODUCT_PACK, nn_outch);
+    if (weight_data_tm.empty())
+        return -100;
+
+    for (int b=0; b<nn_outch; b++)
+    {
+        float* kptr = weight_data_tm.row(b);
+
+        for (int k=0; k<K; )
+        {
+            const int kn = k < kmain ? INNERPRODUCT_PACK : 1;
+
+            for (int j=0; j<INNERPRODUCT_PACK; j++)
+            {
+                const int p = b * INNERPRODUCT_PACK + j;
+
+                for (int i=0; i<kn; i++)
+                {
+                    kptr[i] = p < num_output ? weight_data[K * p + k + i] : 0.f;
+                }
+
+                kptr += kn;
+            }
+
+            k += kn;
+        }
+    }
+
+    use_fp16_weight = false;
+    weight_data_packed = weight_data_tm;
+
+#if __F16C__
+    if (get_default_option().use_fp16_storage)
+    {
+        const int size = K * INNERPRODUCT_PACK * nn_outch;
+
+        Mat weight_data_fp16;
+        weight_data_fp16.create(K * INNERPRODUCT_PACK, nn_outch, (size_t)2u);
+        if (weight_data_fp16.empty())
+            return -100;
+
+        const float* ptr = weight_data_tm;
+        unsigned short* outptr = weight_data_fp16;
+
+        for (int i=0; i+7<size; i+=8)
+        {
+            __m128i _h = _mm256_cvtps_ph(_mm256_loadu_ps(ptr + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128((__m128i*)(outptr + i), _h);
+        }
+
+        use_fp16_weight = true;
+        weight_data_packed = weight_data_fp16;
+    }
+#endif // __F16C__
+
+    // the kernels only read the packed copy, destroy_pipeline unpacks it again
+    if (get_default_option().lightmode)
+        weight_data.release();
+
+    return 0;
+}
+
+int InnerProduct_x86::destroy_pipeline()
+{
+    if (use_int8_inference || weight_data_packed.empty())
+        return 0;
+
+    if (weight_data.empty())
+    {
+        const int K = weight_data_size / num_output;
+        const int kmain = K / INNERPRODUCT_PACK * INNERPRODUCT_PACK;
+        const int nn_outch = (num_output + INNERPRODUCT_PACK - 1) / INNERPRODUCT_PACK;
+
+        // the rounding of fp16 weights stays
+        Mat weight_data_tm = weight_data_packed;
+        if (use_fp16_weight)
+        {
+            weight_data_tm = Mat::from_float16(weight_data_packed, K * INNERPRODUCT_PACK * nn_outch);
+            if (weight_data_tm.empty())
+                return -100;
+        }
+
+        Mat weight_data_unpacked;
+        weight_data_unpacked.create(weight_data_size);
+        if (weight_data_unpacked.empty())
+            return -100;
+
+        for (int b=0; b<nn_outch; b++)
+        {
+            const float* kptr = (const float*)weight_data_tm + K * INNERPRODUCT_PACK * b;
+
+            for (int k=0; k<K; )
+            {
+                const int kn = k < kmain ? INNERPRODUCT_PACK : 1;
+
+                for (int j=0; j<INNERPRODUCT_PACK; j++)
+                {
+                    const int p = b * INNERPRODUCT_PACK + j;
+
+                    for (int i=0; i<kn; i++)
+                    {
+                        if (p < num_output)
+                            weight_data_unpacked[K * p + k + i] = kptr[i];
+                    }
+
+                    kptr += kn;
+                }
+
+                k += kn;
+            }
+        }
+
+        weight_data = weight_data_unpacked;
+    }
+
+    weight_data_packed.release();
+    use_fp16_weight = false;
+
+    return 0;
+}
+
+int InnerProduct_x86::save_prepared(std::vector<Mat>& weights) const
+{
+    int ret = InnerProduct::save_prepared(weights);
+    if (ret != 0)
+        return ret;
+
+    // the packed copy stands in for the float weights, weights[0] is weight_data
+    if (!use_int8_inference)
+        weights[0] = Mat();
+
+    weights.push_back(weight_data_packed);
+
+    return 0;
+}
+
+int InnerProduct_x86::load_prepared(const ModelBin& mb)
+{
+    int ret = InnerProduct::load_prepared(mb);
+    if (ret != 0)
+        return ret;
+
+    weight_data_packed = mb.load(0, 0);
+    use_fp16_weight = weight_data_packed.elemsize == 2u;
+
+    if (!use_int8_inference && weight_data_packed.empty())
+        return -1;
+
+    return 0;
+}
+
+const char* InnerProduct_x86::kernel_name(const Mat& bottom_blob) const
+{
+    // same choice as forward
+    if (bottom_blob.w * bottom_blob.h * bottom_blob.c != weight_data_size / num_output)
+        return 0;
+
+    if (use_int8_inference)
+        return "int8_sse";
+
+    return use_fp16_weight ? "pack_fp16" : "pack";
+}
+
+int InnerProduct_x86::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    const int K = weight_data_size / num_output;
+    const int nn_outch = (num_output + INNERPRODUCT_PACK - 1) / INNERPRODUCT_PACK;
+
+    // the weights are laid out for K inputs
+    if (bottom_blob.w * bottom_blob.h * bottom_blob.c != K)
+        return -1;
+
+    if (use_int8_inference)
+        return forward_int8_x86(bottom_blob, top_blob, opt);
+
+    // one contiguous input stream
+    Mat bottom_blob_flattened = bottom_blob;
+    if (bottom_blob.dims != 1)
+    {
+        bottom_blob_flattened = bottom_blob.reshape(K, opt.workspace_allocator);
+        if (bottom_blob_flattened.empty())
+            return -100;
+    }
+
+    top_blob.create(num_output, 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    const float* x = bottom_blob_flattened;
+
+    // too few output blocks to keep all threads busy, split the inputs instead
+    int nsplit = 1;
+    if (nn_outch < opt.num_threads && K >= opt.num_threads * 1024)
+        nsplit = opt.num_threads;
+
+    const int ksplit = ((K + nsplit - 1) / nsplit + INNERPRODUCT_PACK - 1) / INNERPRODUCT_PACK * INNERPRODUCT_PACK;
+
+    Mat sums;
+    sums.create(nn_outch * INNERPRODUCT_PACK, nsplit, 4u, opt.workspace_allocator);
+    if (sums.empty())
+        return -100;
+
+    innerproduct_pack_sse_task task(weight_data_packed, sums, x, K, ksplit, nn_outch, use_fp16_weight);
+
+    parallel_for(task, nsplit * nn_outch, opt);
+
+    for (int p=0; p<num_output; p++)
+    {
+        float sum = bias_term ? bias_data[p] : 0.f;
+
+        for (int s=0; s<nsplit; s++)
+        {
+            sum += sums.row(s)[p];
+        }
+
+        top_blob[p] = activation_ss(sum, activation_type, activation_params);
+    }
+
+    return 0;
+}
+
+int InnerProduct_x86::forward_batch(const std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
+{
+    const int K = weight_data_size / num_output;
+    const int nn_outch = (num_output + INNERPRODUCT_PACK - 1) / INNERPRODUCT_PACK;
+    const int batch = bottom_blobs.size();
+
+    if (use_int8_inference)
+        return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+
+    for (int n=0; n<batch; n++)
+    {
+        if (bottom_blobs[n].w * bottom_blobs[n].h * bottom_blobs[n].c != K)
+            return Layer::forward_batch(bottom_blobs, top_blobs, opt);
+    }
+
+    // one contiguous input stream per sample
+    std::vector<Mat> bottom_blobs_flattened(batch);
+    for (int n=0; n<batch; n++)
+    {
+        bottom_blobs_flattened[n] = bottom_blobs[n];
+        if (bottom_blobs[n].dims != 1)
+        {
+            bottom_blobs_flattened[n] = bottom_blobs[n].reshape(K, opt.workspace_allocator);
+            if (bottom_blobs_flattened[n].empty())
+                return -100;
+        }
+    }
+
+    top_blobs.resize(batch);
+    for (int n=0; n<batch; n++)
+    {
+        top_blobs[n].create(num_output, 4u, opt.blob_allocator);
+        if (top_blobs[n].empty())
+            return -100;
+    }
+
+    Mat sums;
+    sums.create(nn_outch * INNERPRODUCT_PACK, batch, 4u, opt.workspace_allocator);
+    if (sums.empty())
+        return -100;
+
+    // the weights are streamed once for the whole batch
+    innerproduct_pack_batch_sse_task task(weight_data_packed, bottom_blobs_flattened, sums, K, use_fp16_weight);
+
+    parallel_for(task, nn_outch, opt);
+
+    for (int n=0; n<batch; n++)
+    {
+        const float* sum = sums.row(n);
+        float* outptr = top_blobs[n];
+
+        for (int p=0; p<num_output; p++)
+        {
+            outptr[p] = activation_ss((bias_term ? bias_data[p] : 0.f) + sum[p], activation_type, activation_params);
+        }
+    }
+
+    return 0;
+}
+
+namespace {
+
+// one output
+struct innerproduct_int8_task : public ParallelTask
+{
+    innerproduct_int8_task(Mat& _top_blob, const Mat& _activation_params, const Mat& _bias_data, const Mat& _weight_data_int8_scales, const Mat& _weight_data_int8, int _K, const signed char* _x, int _bias_term, int _activation_type, float _bottom_blob_int8_scale)
+        : top_blob(_top_blob), activation_params(_activation_params), bias_data(_bias_data), weight_data_int8_scales(_weight_data_int8_scales), weight_data_int8(_weight_data_int8), K(_K), x(_x), bias_term(_bias_term), activation_type(_activation_type), bottom_blob_int8_scale(_bottom_blob_int8_scale)
+    {
+    }
+
+    virtual void execute(int p) const;
+
+    Mat& top_blob;
+    const Mat& activation_params;
+    const Mat& bias_data;
+    const Mat& weight_data_int8_scales;
+    const Mat& weight_data_int8;
+    int K;
+    const signed char* x;
+    int bias_term;
+    int activation_type;
+    float bottom_blob_int8_scale;
+};
+
+void innerproduct_int8_task::execute(int p) const
+{
+    int sum = innerproduct_int8_sse(x, (const signed char*)weight_data_int8 + K * p, K);
+
+    const float dequant_scale = dequantize_scale(bottom_blob_int8_scale, weight_data_int8_scales[p]);
+    const float bias = bias_term ? bias_data[p] : 0.f;
+
+    dequantize_int32(&sum, (float*)top_blob + p, 1, dequant_scale, bias, activation_type, activation_params);
+}
+
+} // namespace
+
+int InnerProduct_x86::forward_int8_x86(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    const int K = weight_data_size / num_output;
+
+    Mat bottom_blob_flattened = bottom_blob;
+    if (bottom_blob.dims != 1)
+    {
+        bottom_blob_flattened = bottom_blob.reshape(K, opt.workspace_allocator);
+        if (bottom_blob_flattened.empty())
+            return -100;
+    }
+
+    Mat bottom_blob_int8;
+    int ret = quantize_int8(bottom_blob_flattened, bottom_blob_int8, bottom_blob_int8_scale, opt);
+    if (ret != 0)
+        return ret;
+
+    top_blob.create(num_output, 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    const signed char* x = bottom_blob_int8;
+
+    innerproduct_int8_task task(top_blob, activation_params, bias_data, weight_data_int8_scales, weight_data_int8, K, x, bias_term, activation_type, bottom_blob_int8_scale);
+
+    parallel_for(task, num_output, opt);
+
+    return 0;
+}
+
+} // namespace ncnn
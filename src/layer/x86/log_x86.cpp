@@ -0,0 +1,112 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "log_x86.h"
+
+#include <math.h>
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+#if __SSE2__
+#include "sse_mathfun.h"
+#endif // __SSE2__
+#if __AVX__
+#include "avx_mathfun.h"
+#endif // __AVX__
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(Log_x86)
+
+namespace {
+
+// one channel
+struct log_sse_task : public ParallelTask
+{
+    log_sse_task(Mat& _bottom_top_blob, int _size, float _log_base_inv, float _scale, float _shift)
+        : bottom_top_blob(_bottom_top_blob), size(_size), log_base_inv(_log_base_inv), scale(_scale), shift(_shift)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float log_base_inv;
+    float scale;
+    float shift;
+};
+
+void log_sse_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _scale = _mm256_set1_ps(scale);
+        __m256 _shift = _mm256_set1_ps(shift);
+        __m256 _log_base_inv = _mm256_set1_ps(log_base_inv);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            _p = log256_ps(_mm256_comp_fmadd_ps(_p, _scale, _shift));
+            _p = _mm256_mul_ps(_p, _log_base_inv);
+            _mm256_storeu_ps(ptr, _p);
+            ptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _scale = _mm_set1_ps(scale);
+        __m128 _shift = _mm_set1_ps(shift);
+        __m128 _log_base_inv = _mm_set1_ps(log_base_inv);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            _p = log_ps(_mm_comp_fmadd_ps(_p, _scale, _shift));
+            _p = _mm_mul_ps(_p, _log_base_inv);
+            _mm_storeu_ps(ptr, _p);
+            ptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *ptr = log(shift + *ptr * scale) * log_base_inv;
+        ptr++;
+    }
+}
+
+} // namespace
+
+int Log_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    int w = bottom_top_blob.w;
+    int h = bottom_top_blob.h;
+    int channels = bottom_top_blob.c;
+    int size = w * h;
+
+    const float log_base_inv = base == -1.f ? 1.f : 1.f / log(base);
+
+    log_sse_task task(bottom_top_blob, size, log_base_inv, scale, shift);
+
+    parallel_for(task, channels, opt);
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,611 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+// KxK stride S pooling on the unpadded input
+// wb x hb is the input with the constant border, which reads zero
+// taps past it fall into the full padding tail, where max repeats the last bordered row and column and average reads zero
+
+template<bool MAX>
+static inline float pooling_op_ss(float a, float b)
+{
+    return MAX ? std::max(a, b) : a + b;
+}
+
+template<int K, int S, bool MAX>
+static inline float pooling_border_ss(const float* img, int w, int h, int wb, int hb, int i, int j, int pad_left, int pad_top)
+{
+    float v = MAX ? -FLT_MAX : 0.f;
+
+    for (int ky=0; ky<K; ky++)
+    {
+        int yb = i * S + ky;
+        if (yb >= hb)
+        {
+            if (!MAX)
+                continue;
+
+            yb = hb - 1;
+        }
+
+        const int y = yb - pad_top;
+
+        for (int kx=0; kx<K; kx++)
+        {
+            int xb = j * S + kx;
+            if (xb >= wb)
+            {
+                if (!MAX)
+                    continue;
+
+                xb = wb - 1;
+            }
+
+            const int x = xb - pad_left;
+
+            float val = (y >= 0 && y < h && x >= 0 && x < w) ? img[y * w + x] : 0.f;
+            v = pooling_op_ss<MAX>(v, val);
+        }
+    }
+
+    return MAX ? v : v / (K * K);
+}
+
+#if __AVX__
+template<bool MAX>
+static inline __m256 pooling_op_avx(__m256 a, __m256 b)
+{
+    return MAX ? _mm256_max_ps(a, b) : _mm256_add_ps(a, b);
+}
+
+// the K taps of one input row for 8 outputs
+template<int K, int S, bool MAX>
+static inline __m256 pooling_row_avx(const float* sptr)
+{
+    if (S == 1)
+    {
+        __m256 _v = _mm256_loadu_ps(sptr);
+        for (int kx=1; kx<K; kx++)
+        {
+            _v = pooling_op_avx<MAX>(_v, _mm256_loadu_ps(sptr + kx));
+        }
+
+        return _v;
+    }
+
+    // lanes hold outputs 0 1 4 5 2 3 6 7, fixed up at the store
+    __m256 _a = _mm256_loadu_ps(sptr);
+    __m256 _b = _mm256_loadu_ps(sptr + 8);
+    __m256 _v = pooling_op_avx<MAX>(_mm256_shuffle_ps(_a, _b, _MM_SHUFFLE(2,0,2,0)), _mm256_shuffle_ps(_a, _b, _MM_SHUFFLE(3,1,3,1)));
+    if (K == 3)
+    {
+        __m256 _c = _mm256_loadu_ps(sptr + 2);
+        __m256 _d = _mm256_loadu_ps(sptr + 10);
+        _v = pooling_op_avx<MAX>(_v, _mm256_shuffle_ps(_c, _d, _MM_SHUFFLE(2,0,2,0)));
+    }
+
+    return _v;
+}
+#endif // __AVX__
+
+#if __SSE2__
+template<bool MAX>
+static inline __m128 pooling_op_sse(__m128 a, __m128 b)
+{
+    return MAX ? _mm_max_ps(a, b) : _mm_add_ps(a, b);
+}
+
+// the K taps of one input row for 4 outputs
+template<int K, int S, bool MAX>
+static inline __m128 pooling_row_sse(const float* sptr)
+{
+    if (S == 1)
+    {
+        __m128 _v = _mm_loadu_ps(sptr);
+        for (int kx=1; kx<K; kx++)
+        {
+            _v = pooling_op_sse<MAX>(_v, _mm_loadu_ps(sptr + kx));
+        }
+
+        return _v;
+    }
+
+    __m128 _a = _mm_loadu_ps(sptr);
+    __m128 _b = _mm_loadu_ps(sptr + 4);
+    __m128 _v = pooling_op_sse<MAX>(_mm_shuffle_ps(_a, _b, _MM_SHUFFLE(2,0,2,0)), _mm_shuffle_ps(_a, _b, _MM_SHUFFLE(3,1,3,1)));
+    if (K == 3)
+    {
+        __m128 _c = _mm_loadu_ps(sptr + 2);
+        __m128 _d = _mm_loadu_ps(sptr + 6);
+        _v = pooling_op_sse<MAX>(_v, _mm_shuffle_ps(_c, _d, _MM_SHUFFLE(2,0,2,0)));
+    }
+
+    return _v;
+}
+#endif // __SSE2__
+
+// R output rows from row i, all their taps are inside the image vertically
+template<int K, int S, int R, bool MAX>
+static void pooling_rows_sse(const float* img, int w, int h, int wb, int hb, float* outptr, int outw, int i, int j0, int j1, int pad_left, int pad_top)
+{
+    // input rows shared by the R output rows
+    const int KH = K + S * (R - 1);
+
+    for (int r=0; r<R; r++)
+    {
+        for (int j=0; j<j0; j++)
+        {
+            outptr[r * outw + j] = pooling_border_ss<K, S, MAX>(img, w, h, wb, hb, i + r, j, pad_left, pad_top);
+        }
+    }
+
+    const float* img0 = img + (i * S - pad_top) * w;
+
+    int j = j0;
+
+#if __AVX__
+    {
+        __m256 _init = _mm256_set1_ps(MAX ? -FLT_MAX : 0.f);
+        __m256 _scale = _mm256_set1_ps(1.f / (K * K));
+
+        // stride 2 loads 16 floats per row, keep them inside the row
+        for (; j+7<j1 && (S == 1 || 2 * j - pad_left + K + 14 < w); j+=8)
+        {
+            __m256 _sum[R];
+            for (int r=0; r<R; r++)
+            {
+                _sum[r] = _init;
+            }
+
+            for (int ky=0; ky<KH; ky++)
+            {
+                __m256 _v = pooling_row_avx<K, S, MAX>(img0 + ky * w + j * S - pad_left);
+
+                for (int r=0; r<R; r++)
+                {
+                    const int kr = ky - r * S;
+                    if (kr >= 0 && kr < K)
+                        _sum[r] = pooling_op_avx<MAX>(_sum[r], _v);
+                }
+            }
+
+            for (int r=0; r<R; r++)
+            {
+                float* ptr = outptr + r * outw + j;
+
+                if (!MAX)
+                    _sum[r] = _mm256_mul_ps(_sum[r], _scale);
+
+                if (S == 1)
+                {
+                    _mm256_storeu_ps(ptr, _sum[r]);
+                }
+                else
+                {
+                    __m128 _lo = _mm256_castps256_ps128(_sum[r]);
+                    __m128 _hi = _mm256_extractf128_ps(_sum[r], 1);
+                    _mm_storeu_ps(ptr, _mm_movelh_ps(_lo, _hi));
+                    _mm_storeu_ps(ptr + 4, _mm_movehl_ps(_hi, _lo));
+                }
+            }
+        }
+    }
+#endif // __AVX__
+
+#if __SSE2__
+    {
+        __m128 _init = _mm_set1_ps(MAX ? -FLT_MAX : 0.f);
+        __m128 _scale = _mm_set1_ps(1.f / (K * K));
+
+        // stride 2 loads 8 floats per row, keep them inside the row
+        for (; j+3<j1 && (S == 1 || 2 * j - pad_left + K + 6 < w); j+=4)
+        {
+            __m128 _sum[R];
+            for (int r=0; r<R; r++)
+            {
+                _sum[r] = _init;
+            }
+
+            for (int ky=0; ky<KH; ky++)
+            {
+                __m128 _v = pooling_row_sse<K, S, MAX>(img0 + ky * w + j * S - pad_left);
+
+                for (int r=0; r<R; r++)
+                {
+                    const int kr = ky - r * S;
+                    if (kr >= 0 && kr < K)
+                        _sum[r] = pooling_op_sse<MAX>(_sum[r], _v);
+                }
+            }
+
+            for (int r=0; r<R; r++)
+            {
+                if (!MAX)
+                    _sum[r] = _mm_mul_ps(_sum[r], _scale);
+
+                _mm_storeu_ps(outptr + r * outw + j, _sum[r]);
+            }
+        }
+    }
+#endif // __SSE2__
+
+    for (; j<j1; j++)
+    {
+        for (int r=0; r<R; r++)
+        {
+            float v = MAX ? -FLT_MAX : 0.f;
+
+            for (int ky=0; ky<K; ky++)
+            {
+                const float* sptr = img0 + (r * S + ky) * w + j * S - pad_left;
+
+                for (int kx=0; kx<K; kx++)
+                {
+                    v = pooling_op_ss<MAX>(v, sptr[kx]);
+                }
+            }
+
+            outptr[r * outw + j] = MAX ? v : v / (K * K);
+        }
+    }
+
+    for (int r=0; r<R; r++)
+    {
+        for (j=j1; j<outw; j++)
+        {
+            outptr[r * outw + j] = pooling_border_ss<K, S, MAX>(img, w, h, wb, hb, i + r, j, pad_left, pad_top);
+        }
+    }
+}
+
+namespace {
+
+// one channel
+template<int K, int S, bool MAX>
+struct pooling_sse_task : public ParallelTask
+{
+    pooling_sse_task(const Mat& _bottom_blob, Mat& _top_blob, int _pad_left, int _pad_top, int _w, int _h, int _outw, int _outh, int _wb, int _hb, int _wtail, int _htail, int _j0, int _j1, int _i0, int _i1)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), pad_left(_pad_left), pad_top(_pad_top), w(_w), h(_h), outw(_outw), outh(_outh), wb(_wb), hb(_hb), wtail(_wtail), htail(_htail), j0(_j0), j1(_j1), i0(_i0), i1(_i1)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int pad_left;
+    int pad_top;
+    int w;
+    int h;
+    int outw;
+    int outh;
+    int wb;
+    int hb;
+    int wtail;
+    int htail;
+    int j0;
+    int j1;
+    int i0;
+    int i1;
+};
+
+template<int K, int S, bool MAX>
+void pooling_sse_task<K, S, MAX>::execute(int q) const
+{
+    const float* img = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<i0; i++)
+    {
+        for (int j=0; j<outw; j++)
+        {
+            outptr[i * outw + j] = pooling_border_ss<K, S, MAX>(img, w, h, wb, hb, i, j, pad_left, pad_top);
+        }
+    }
+
+    // two output rows at once share the input rows in between
+    int i = i0;
+    for (; i+1<i1; i+=2)
+    {
+        pooling_rows_sse<K, S, 2, MAX>(img, w, h, wb, hb, outptr + i * outw, outw, i, j0, j1, pad_left, pad_top);
+    }
+    for (; i<i1; i++)
+    {
+        pooling_rows_sse<K, S, 1, MAX>(img, w, h, wb, hb, outptr + i * outw, outw, i, j0, j1, pad_left, pad_top);
+    }
+
+    for (i=i1; i<outh; i++)
+    {
+        for (int j=0; j<outw; j++)
+        {
+            outptr[i * outw + j] = pooling_border_ss<K, S, MAX>(img, w, h, wb, hb, i, j, pad_left, pad_top);
+        }
+    }
+
+    // fix tail pad, same scale as Pooling::forward
+    if (!MAX && wtail != 0)
+    {
+        const float scale = (float)K / (K - wtail);
+
+        for (i=0; i<outh; i++)
+        {
+            outptr[i * outw + outw - 1] *= scale;
+        }
+    }
+    if (!MAX && htail != 0)
+    {
+        const float scale = (float)K / (K - htail);
+
+        for (int j=0; j<outw; j++)
+        {
+            outptr[(outh - 1) * outw + j] *= scale;
+        }
+    }
+}
+
+} // namespace
+
+template<int K, int S, bool MAX>
+static void pooling_sse(const Mat& bottom_blob, Mat& top_blob, int pad_left, int pad_right, int pad_top, int pad_bottom, const Option& opt)
+{
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+
+    int outw = top_blob.w;
+    int outh = top_blob.h;
+
+    const int wb = w + pad_left + pad_right;
+    const int hb = h + pad_top + pad_bottom;
+
+    // the last output column and row may come from the full padding tail
+    const int wtail = outw > (wb - K) / S + 1 ? (wb - K) % S : 0;
+    const int htail = outh > (hb - K) / S + 1 ? (hb - K) % S : 0;
+
+    // outputs in [j0, j1) x [i0, i1) need no border
+    const int j0 = std::min(outw, (pad_left + S - 1) / S);
+    const int j1 = std::max(j0, std::min(outw, w + pad_left >= K ? (w + pad_left - K) / S + 1 : 0));
+    const int i0 = std::min(outh, (pad_top + S - 1) / S);
+    const int i1 = std::max(i0, std::min(outh, h + pad_top >= K ? (h + pad_top - K) / S + 1 : 0));
+
+    pooling_sse_task<K, S, MAX> task(bottom_blob, top_blob, pad_left, pad_top, w, h, outw, outh, wb, hb, wtail, htail, j0, j1, i0, i1);
+
+    parallel_for(task, channels, opt);
+}
+
+static void pooling2x2s2_max_sse(const Mat& bottom_blob, Mat& top_blob, int pad_left, int pad_right, int pad_top, int pad_bottom, const Option& opt)
+{
+    pooling_sse<2, 2, true>(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+}
+
+static void pooling2x2s2_ave_sse(const Mat& bottom_blob, Mat& top_blob, int pad_left, int pad_right, int pad_top, int pad_bottom, const Option& opt)
+{
+    pooling_sse<2, 2, false>(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+}
+
+static void pooling3x3s1_max_sse(const Mat& bottom_blob, Mat& top_blob, int pad_left, int pad_right, int pad_top, int pad_bottom, const Option& opt)
+{
+    pooling_sse<3, 1, true>(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+}
+
+static void pooling3x3s1_ave_sse(const Mat& bottom_blob, Mat& top_blob, int pad_left, int pad_right, int pad_top, int pad_bottom, const Option& opt)
+{
+    pooling_sse<3, 1, false>(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+}
+
+static void pooling3x3s2_max_sse(const Mat& bottom_blob, Mat& top_blob, int pad_left, int pad_right, int pad_top, int pad_bottom, const Option& opt)
+{
+    pooling_sse<3, 2, true>(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+}
+
+static void pooling3x3s2_ave_sse(const Mat& bottom_blob, Mat& top_blob, int pad_left, int pad_right, int pad_top, int pad_bottom, const Option& opt)
+{
+    pooling_sse<3, 2, false>(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+}
+
+#if __SSE2__
+template<bool MAX>
+static inline __m128 pooling_border_pack4_sse(const float* img, int w, int h, int wb, int hb, int kernel_w, int kernel_h, int yb0, int xb0, int pad_left, int pad_top)
+{
+    __m128 _v = _mm_set1_ps(MAX ? -FLT_MAX : 0.f);
+
+    for (int ky=0; ky<kernel_h; ky++)
+    {
+        int yb = yb0 + ky;
+        if (yb >= hb)
+        {
+            if (!MAX)
+                continue;
+
+            yb = hb - 1;
+        }
+
+        const int y = yb - pad_top;
+
+        for (int kx=0; kx<kernel_w; kx++)
+        {
+            int xb = xb0 + kx;
+            if (xb >= wb)
+            {
+                if (!MAX)
+                    continue;
+
+                xb = wb - 1;
+            }
+
+            const int x = xb - pad_left;
+
+            __m128 _p = (y >= 0 && y < h && x >= 0 && x < w) ? _mm_loadu_ps(img + (y * w + x) * 4) : _mm_setzero_ps();
+            _v = pooling_op_sse<MAX>(_v, _p);
+        }
+    }
+
+    return _v;
+}
+
+namespace {
+
+// one channel
+template<bool MAX>
+struct pooling_pack4_sse_task : public ParallelTask
+{
+    pooling_pack4_sse_task(const Mat& _bottom_blob, Mat& _top_blob, int _stride_h, int _pad_top, int _stride_w, int _pad_left, int _kernel_w, int _kernel_h, int _w, int _h, int _outw, int _outh, int _wb, int _hb, int _maxk, int _wtail, int _htail, int _j0, int _j1, int _i0, int _i1, int* _space_ofs, __m128 __scale)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), stride_h(_stride_h), pad_top(_pad_top), stride_w(_stride_w), pad_left(_pad_left), kernel_w(_kernel_w), kernel_h(_kernel_h), w(_w), h(_h), outw(_outw), outh(_outh), wb(_wb), hb(_hb), maxk(_maxk), wtail(_wtail), htail(_htail), j0(_j0), j1(_j1), i0(_i0), i1(_i1), space_ofs(_space_ofs), _scale(__scale)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int stride_h;
+    int pad_top;
+    int stride_w;
+    int pad_left;
+    int kernel_w;
+    int kernel_h;
+    int w;
+    int h;
+    int outw;
+    int outh;
+    int wb;
+    int hb;
+    int maxk;
+    int wtail;
+    int htail;
+    int j0;
+    int j1;
+    int i0;
+    int i1;
+    int* space_ofs;
+    __m128 _scale;
+};
+
+template<bool MAX>
+void pooling_pack4_sse_task<MAX>::execute(int q) const
+{
+    const float* img = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    for (int i=0; i<outh; i++)
+    {
+        const bool row_inside = i >= i0 && i < i1;
+
+        for (int j=0; j<outw; j++)
+        {
+            __m128 _v;
+
+            if (row_inside && j >= j0 && j < j1)
+            {
+                const float* sptr = img + ((i * stride_h - pad_top) * w + j * stride_w - pad_left) * 4;
+
+                _v = _mm_loadu_ps(sptr);
+                for (int k=1; k<maxk; k++)
+                {
+                    _v = pooling_op_sse<MAX>(_v, _mm_loadu_ps(sptr + space_ofs[k]));
+                }
+            }
+            else
+            {
+                _v = pooling_border_pack4_sse<MAX>(img, w, h, wb, hb, kernel_w, kernel_h, i * stride_h, j * stride_w, pad_left, pad_top);
+            }
+
+            if (!MAX)
+                _v = _mm_mul_ps(_v, _scale);
+
+            _mm_storeu_ps(outptr + j * 4, _v);
+        }
+
+        outptr += outw * 4;
+    }
+
+    // fix tail pad, same scale as Pooling::forward
+    if (!MAX && wtail != 0)
+    {
+        const __m128 _tscale = _mm_set1_ps((float)kernel_w / (kernel_w - wtail));
+
+        outptr = top_blob.channel(q);
+        for (int i=0; i<outh; i++)
+        {
+            float* ptr = outptr + (i * outw + outw - 1) * 4;
+            _mm_storeu_ps(ptr, _mm_mul_ps(_mm_loadu_ps(ptr), _tscale));
+        }
+    }
+    if (!MAX && htail != 0)
+    {
+        const __m128 _tscale = _mm_set1_ps((float)kernel_h / (kernel_h - htail));
+
+        outptr = top_blob.channel(q);
+        for (int j=0; j<outw; j++)
+        {
+            float* ptr = outptr + ((outh - 1) * outw + j) * 4;
+            _mm_storeu_ps(ptr, _mm_mul_ps(_mm_loadu_ps(ptr), _tscale));
+        }
+    }
+}
+
+} // namespace
+
+// any kernel size and stride on c/4-h-w-4 blobs, same border rules as pooling_border_ss
+template<bool MAX>
+static void pooling_pack4_sse(const Mat& bottom_blob, Mat& top_blob, int kernel_w, int kernel_h, int stride_w, int stride_h, int pad_left, int pad_right, int pad_top, int pad_bottom, const Option& opt)
+{
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+
+    int outw = top_blob.w;
+    int outh = top_blob.h;
+
+    const int wb = w + pad_left + pad_right;
+    const int hb = h + pad_top + pad_bottom;
+
+    const int maxk = kernel_w * kernel_h;
+
+    // the last output column and row may come from the full padding tail
+    const int wtail = outw > (wb - kernel_w) / stride_w + 1 ? (wb - kernel_w) % stride_w : 0;
+    const int htail = outh > (hb - kernel_h) / stride_h + 1 ? (hb - kernel_h) % stride_h : 0;
+
+    // outputs in [j0, j1) x [i0, i1) need no border
+    const int j0 = std::min(outw, (pad_left + stride_w - 1) / stride_w);
+    const int j1 = std::max(j0, std::min(outw, w + pad_left >= kernel_w ? (w + pad_left - kernel_w) / stride_w + 1 : 0));
+    const int i0 = std::min(outh, (pad_top + stride_h - 1) / stride_h);
+    const int i1 = std::max(i0, std::min(outh, h + pad_top >= kernel_h ? (h + pad_top - kernel_h) / stride_h + 1 : 0));
+
+    // tap offsets in floats
+    std::vector<int> _space_ofs(maxk);
+    int* space_ofs = &_space_ofs[0];
+    {
+        int p1 = 0;
+        int p2 = 0;
+        int gap = w - kernel_w;
+        for (int ky=0; ky<kernel_h; ky++)
+        {
+            for (int kx=0; kx<kernel_w; kx++)
+            {
+                space_ofs[p1] = p2 * 4;
+                p1++;
+                p2++;
+            }
+            p2 += gap;
+        }
+    }
+
+    const __m128 _scale = _mm_set1_ps(1.f / maxk);
+
+    pooling_pack4_sse_task<MAX> task(bottom_blob, top_blob, stride_h, pad_top, stride_w, pad_left, kernel_w, kernel_h, w, h, outw, outh, wb, hb, maxk, wtail, htail, j0, j1, i0, i1, space_ofs, _scale);
+
+    parallel_for(task, channels, opt);
+}
+#endif // __SSE2__
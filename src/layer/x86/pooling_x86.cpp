@@ -0,0 +1,314 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+#include "pooling_x86.h"
+
+#include <float.h>
+#include <algorithm>
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+#include "pooling_sse.h"
+
+DEFINE_LAYER_CREATOR(Pooling_x86)
+
+int Pooling_x86::load_param(const ParamDict& pd)
+{
+    int ret = Pooling::load_param(pd);
+    if (ret != 0)
+        return ret;
+
+#if __SSE2__
+    support_packing = pooling_type == PoolMethod_MAX || pooling_type == PoolMethod_AVE;
+#endif // __SSE2__
+
+    return 0;
+}
+
+#if __SSE2__
+namespace {
+
+// one channel
+struct pooling_global_pack4_sse_task : public ParallelTask
+{
+    pooling_global_pack4_sse_task(const Mat& _bottom_blob, Mat& _top_blob, bool _is_max, int _size)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), is_max(_is_max), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    bool is_max;
+    int size;
+};
+
+void pooling_global_pack4_sse_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    __m128 _v = _mm_loadu_ps(ptr);
+    if (!is_max)
+        _v = _mm_setzero_ps();
+
+    for (int i=0; i<size; i++)
+    {
+        __m128 _p = _mm_loadu_ps(ptr);
+        _v = is_max ? _mm_max_ps(_v, _p) : _mm_add_ps(_v, _p);
+        ptr += 4;
+    }
+
+    if (!is_max)
+        _v = _mm_mul_ps(_v, _mm_set1_ps(1.f / size));
+
+    _mm_storeu_ps(outptr, _v);
+}
+
+} // namespace
+
+static void pooling_global_pack4_sse(const Mat& bottom_blob, Mat& top_blob, bool is_max, const Option& opt)
+{
+    const int size = bottom_blob.w * bottom_blob.h;
+    const int channels = bottom_blob.c;
+
+    pooling_global_pack4_sse_task task(bottom_blob, top_blob, is_max, size);
+
+    parallel_for(task, channels, opt);
+}
+#endif // __SSE2__
+
+namespace {
+
+// one channel
+struct pooling_global_sse_task : public ParallelTask
+{
+    pooling_global_sse_task(const Mat& _bottom_blob, Mat& _top_blob, int _size, bool _is_max)
+        : bottom_blob(_bottom_blob), top_blob(_top_blob), size(_size), is_max(_is_max)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& bottom_blob;
+    Mat& top_blob;
+    int size;
+    bool is_max;
+};
+
+void pooling_global_sse_task::execute(int q) const
+{
+    const float* ptr = bottom_blob.channel(q);
+    float* outptr = top_blob.channel(q);
+
+    float v = is_max ? ptr[0] : 0.f;
+
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _v = _mm256_set1_ps(v);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            _v = is_max ? _mm256_max_ps(_v, _p) : _mm256_add_ps(_v, _p);
+            ptr += 8;
+        }
+        v = is_max ? _mm256_reduce_max_ps(_v) : _mm256_reduce_add_ps(_v);
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _v = _mm_set1_ps(is_max ? v : 0.f);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            _v = is_max ? _mm_max_ps(_v, _p) : _mm_add_ps(_v, _p);
+            ptr += 4;
+        }
+        v = is_max ? std::max(v, _mm_reduce_max_ps(_v)) : v + _mm_reduce_add_ps(_v);
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        v = is_max ? std::max(v, *ptr) : v + *ptr;
+        ptr++;
+    }
+
+    outptr[0] = is_max ? v : v / size;
+}
+
+} // namespace
+
+int Pooling_x86::forward(const Mat& bottom_blob, Mat& top_blob, const Option& opt) const
+{
+    // max value in NxN window
+    // avg value in NxN window
+
+    if (pooling_type != PoolMethod_MAX && pooling_type != PoolMethod_AVE)
+    {
+        return Pooling::forward(bottom_blob, top_blob, opt);
+    }
+
+    int w = bottom_blob.w;
+    int h = bottom_blob.h;
+    int channels = bottom_blob.c;
+
+#if __SSE2__
+    if (bottom_blob.elempack == 4 && global_pooling)
+    {
+        top_blob.create(1, 1, channels, 16u, 4, opt.blob_allocator);
+        if (top_blob.empty())
+            return -100;
+
+        pooling_global_pack4_sse(bottom_blob, top_blob, pooling_type == PoolMethod_MAX, opt);
+
+        return 0;
+    }
+#endif // __SSE2__
+
+    if (global_pooling)
+    {
+        top_blob.create(1, 1, channels, 4u, opt.blob_allocator);
+        if (top_blob.empty())
+            return -100;
+
+        const int size = w * h;
+        const bool is_max = pooling_type == PoolMethod_MAX;
+
+        pooling_global_sse_task task(bottom_blob, top_blob, size, is_max);
+
+        parallel_for(task, channels, opt);
+
+        return 0;
+    }
+
+    // the border copy_make_border would add in Pooling::forward
+    int pad_left = 0;
+    int pad_right = 0;
+    int pad_top = 0;
+    int pad_bottom = 0;
+    if (pad_w > 0 || pad_h > 0)
+    {
+        pad_left = pad_w;
+        pad_right = pad_w;
+        pad_top = pad_h;
+        pad_bottom = pad_h;
+    }
+    else if (pad_mode == 2) // tensorflow padding=SAME
+    {
+        int wpad = kernel_w + (w - 1) / stride_w * stride_w - w;
+        int hpad = kernel_h + (h - 1) / stride_h * stride_h - h;
+        if (wpad > 0 || hpad > 0)
+        {
+            pad_left = wpad / 2;
+            pad_right = wpad - wpad / 2;
+            pad_top = hpad / 2;
+            pad_bottom = hpad - hpad / 2;
+        }
+    }
+
+    const int wb = w + pad_left + pad_right;
+    const int hb = h + pad_top + pad_bottom;
+
+#if __SSE2__
+    if (bottom_blob.elempack == 4)
+    {
+        if (wb < kernel_w || hb < kernel_h)
+            return -100;
+
+        int outw = (wb - kernel_w) / stride_w + 1;
+        int outh = (hb - kernel_h) / stride_h + 1;
+
+        if (pad_mode == 0) // full padding
+        {
+            if ((wb - kernel_w) % stride_w != 0)
+                outw += 1;
+            if ((hb - kernel_h) % stride_h != 0)
+                outh += 1;
+        }
+
+        top_blob.create(outw, outh, channels, 16u, 4, opt.blob_allocator);
+        if (top_blob.empty())
+            return -100;
+
+        if (pooling_type == PoolMethod_MAX)
+            pooling_pack4_sse<true>(bottom_blob, top_blob, kernel_w, kernel_h, stride_w, stride_h, pad_left, pad_right, pad_top, pad_bottom, opt);
+        else
+            pooling_pack4_sse<false>(bottom_blob, top_blob, kernel_w, kernel_h, stride_w, stride_h, pad_left, pad_right, pad_top, pad_bottom, opt);
+
+        return 0;
+    }
+#endif // __SSE2__
+
+    if (kernel_w != kernel_h || stride_w != stride_h)
+    {
+        return Pooling::forward(bottom_blob, top_blob, opt);
+    }
+
+    const int kernel_size = kernel_w;
+    const int stride = stride_w;
+
+    if (!(kernel_size == 2 && stride == 2) && !(kernel_size == 3 && (stride == 1 || stride == 2)))
+    {
+        return Pooling::forward(bottom_blob, top_blob, opt);
+    }
+
+    if (wb < kernel_size || hb < kernel_size)
+    {
+        return Pooling::forward(bottom_blob, top_blob, opt);
+    }
+
+    int outw = (wb - kernel_size) / stride + 1;
+    int outh = (hb - kernel_size) / stride + 1;
+
+    if (pad_mode == 0) // full padding
+    {
+        if ((wb - kernel_size) % stride != 0)
+            outw += 1;
+        if ((hb - kernel_size) % stride != 0)
+            outh += 1;
+    }
+
+    top_blob.create(outw, outh, channels, 4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+
+    if (pooling_type == PoolMethod_MAX)
+    {
+        if (kernel_size == 2)
+            pooling2x2s2_max_sse(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+        else if (stride == 1)
+            pooling3x3s1_max_sse(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+        else
+            pooling3x3s2_max_sse(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+    }
+    else
+    {
+        if (kernel_size == 2)
+            pooling2x2s2_ave_sse(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+        else if (stride == 1)
+            pooling3x3s1_ave_sse(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+        else
+            pooling3x3s2_ave_sse(bottom_blob, top_blob, pad_left, pad_right, pad_top, pad_bottom, opt);
+    }
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,137 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "power_x86.h"
+
+#include <math.h>
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(Power_x86)
+
+namespace {
+
+// one channel
+template<int P>
+struct power_affine_task : public ParallelTask
+{
+    power_affine_task(Mat& _bottom_top_blob, float _scale, float _shift, int _size)
+        : bottom_top_blob(_bottom_top_blob), scale(_scale), shift(_shift), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    float scale;
+    float shift;
+    int size;
+};
+
+template<int P>
+void power_affine_task<P>::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _scale = _mm256_set1_ps(scale);
+        __m256 _shift = _mm256_set1_ps(shift);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            _p = _mm256_comp_fmadd_ps(_p, _scale, _shift);
+            if (P == 2)
+                _p = _mm256_mul_ps(_p, _p);
+            if (P == 0)
+                _p = _mm256_sqrt_ps(_p);
+            _mm256_storeu_ps(ptr, _p);
+            ptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _scale = _mm_set1_ps(scale);
+        __m128 _shift = _mm_set1_ps(shift);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            _p = _mm_comp_fmadd_ps(_p, _scale, _shift);
+            if (P == 2)
+                _p = _mm_mul_ps(_p, _p);
+            if (P == 0)
+                _p = _mm_sqrt_ps(_p);
+            _mm_storeu_ps(ptr, _p);
+            ptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        float v = shift + *ptr * scale;
+        if (P == 2)
+            v = v * v;
+        if (P == 0)
+            v = sqrt(v);
+        *ptr = v;
+        ptr++;
+    }
+}
+
+} // namespace
+
+// P = 1 x, 2 x * x, 0 sqrt(x)
+template<int P>
+static void power_affine(Mat& bottom_top_blob, float scale, float shift, const Option& opt)
+{
+    int w = bottom_top_blob.w;
+    int h = bottom_top_blob.h;
+    int channels = bottom_top_blob.c;
+    int size = w * h;
+
+    power_affine_task<P> task(bottom_top_blob, scale, shift, size);
+
+    parallel_for(task, channels, opt);
+}
+
+int Power_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    if (power == 1.f)
+    {
+        power_affine<1>(bottom_top_blob, scale, shift, opt);
+        return 0;
+    }
+
+    if (power == 2.f)
+    {
+        power_affine<2>(bottom_top_blob, scale, shift, opt);
+        return 0;
+    }
+
+    if (power == 0.5f)
+    {
+        power_affine<0>(bottom_top_blob, scale, shift, opt);
+        return 0;
+    }
+
+    // pow of a negative value with an integral exponent rules out exp(p * log(v))
+    return Power::forward_inplace(bottom_top_blob, opt);
+}
+
+} // namespace ncnn
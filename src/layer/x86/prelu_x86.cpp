@@ -0,0 +1,189 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "prelu_x86.h"
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(PReLU_x86)
+
+// max(x, 0) + slope * min(x, 0)
+static void prelu_sse(float* ptr, int size, float slope)
+{
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _zero = _mm256_setzero_ps();
+        __m256 _slope = _mm256_set1_ps(slope);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            _p = _mm256_comp_fmadd_ps(_mm256_min_ps(_p, _zero), _slope, _mm256_max_ps(_p, _zero));
+            _mm256_storeu_ps(ptr, _p);
+            ptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _zero = _mm_setzero_ps();
+        __m128 _slope = _mm_set1_ps(slope);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            _p = _mm_comp_fmadd_ps(_mm_min_ps(_p, _zero), _slope, _mm_max_ps(_p, _zero));
+            _mm_storeu_ps(ptr, _p);
+            ptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        if (*ptr < 0)
+            *ptr *= slope;
+        ptr++;
+    }
+}
+
+namespace {
+
+// one row
+struct prelu_rows_sse_task : public ParallelTask
+{
+    prelu_rows_sse_task(Mat& _bottom_top_blob, const Mat& _slope_data, int _w, int _num_slope)
+        : bottom_top_blob(_bottom_top_blob), slope_data(_slope_data), w(_w), num_slope(_num_slope)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    Mat& bottom_top_blob;
+    const Mat& slope_data;
+    int w;
+    int num_slope;
+};
+
+void prelu_rows_sse_task::execute(int i) const
+{
+    float* ptr = bottom_top_blob.row(i);
+    float slope = num_slope > 1 ? slope_data[i] : slope_data[0];
+
+    prelu_sse(ptr, w, slope);
+}
+
+// one channel
+struct prelu_sse_task : public ParallelTask
+{
+    prelu_sse_task(Mat& _bottom_top_blob, const Mat& _slope_data, int _size, int _num_slope)
+        : bottom_top_blob(_bottom_top_blob), slope_data(_slope_data), size(_size), num_slope(_num_slope)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& slope_data;
+    int size;
+    int num_slope;
+};
+
+void prelu_sse_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+    float slope = num_slope > 1 ? slope_data[q] : slope_data[0];
+
+    prelu_sse(ptr, size, slope);
+}
+
+} // namespace
+
+int PReLU_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    int dims = bottom_top_blob.dims;
+
+    if (dims == 1)
+    {
+        int w = bottom_top_blob.w;
+
+        float* ptr = bottom_top_blob;
+
+        if (num_slope == 1)
+        {
+            prelu_sse(ptr, w, slope_data[0]);
+            return 0;
+        }
+
+        const float* slope = slope_data;
+
+        int i = 0;
+#if __AVX__
+        {
+            __m256 _zero = _mm256_setzero_ps();
+            for (; i+7<w; i+=8)
+            {
+                __m256 _p = _mm256_loadu_ps(ptr + i);
+                __m256 _slope = _mm256_loadu_ps(slope + i);
+                _p = _mm256_comp_fmadd_ps(_mm256_min_ps(_p, _zero), _slope, _mm256_max_ps(_p, _zero));
+                _mm256_storeu_ps(ptr + i, _p);
+            }
+        }
+#endif // __AVX__
+#if __SSE2__
+        {
+            __m128 _zero = _mm_setzero_ps();
+            for (; i+3<w; i+=4)
+            {
+                __m128 _p = _mm_loadu_ps(ptr + i);
+                __m128 _slope = _mm_loadu_ps(slope + i);
+                _p = _mm_comp_fmadd_ps(_mm_min_ps(_p, _zero), _slope, _mm_max_ps(_p, _zero));
+                _mm_storeu_ps(ptr + i, _p);
+            }
+        }
+#endif // __SSE2__
+        for (; i<w; i++)
+        {
+            if (ptr[i] < 0)
+                ptr[i] *= slope[i];
+        }
+    }
+
+    if (dims == 2)
+    {
+        int w = bottom_top_blob.w;
+        int h = bottom_top_blob.h;
+
+        prelu_rows_sse_task task(bottom_top_blob, slope_data, w, num_slope);
+
+        parallel_for(task, h, opt);
+    }
+
+    if (dims == 3)
+    {
+        int w = bottom_top_blob.w;
+        int h = bottom_top_blob.h;
+        int channels = bottom_top_blob.c;
+        int size = w * h;
+
+        prelu_sse_task task(bottom_top_blob, slope_data, size, num_slope);
+
+        parallel_for(task, channels, opt);
+    }
+
+    return 0;
+}
+
+} // namespace ncnn
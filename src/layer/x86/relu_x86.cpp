@@ -0,0 +1,110 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "relu_x86.h"
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(ReLU_x86)
+
+ReLU_x86::ReLU_x86()
+{
+    support_packing = true;
+}
+
+namespace {
+
+// one channel
+struct relu_sse_task : public ParallelTask
+{
+    relu_sse_task(Mat& _bottom_top_blob, int _size, float _slope)
+        : bottom_top_blob(_bottom_top_blob), size(_size), slope(_slope)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+    float slope;
+};
+
+void relu_sse_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    // max(x, 0) + slope * min(x, 0)
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _zero = _mm256_setzero_ps();
+        __m256 _slope = _mm256_set1_ps(slope);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            __m256 _pos = _mm256_max_ps(_p, _zero);
+            if (slope == 0.f)
+                _p = _pos;
+            else
+                _p = _mm256_comp_fmadd_ps(_mm256_min_ps(_p, _zero), _slope, _pos);
+            _mm256_storeu_ps(ptr, _p);
+            ptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _zero = _mm_setzero_ps();
+        __m128 _slope = _mm_set1_ps(slope);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            __m128 _pos = _mm_max_ps(_p, _zero);
+            if (slope == 0.f)
+                _p = _pos;
+            else
+                _p = _mm_comp_fmadd_ps(_mm_min_ps(_p, _zero), _slope, _pos);
+            _mm_storeu_ps(ptr, _p);
+            ptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        if (*ptr < 0)
+            *ptr *= slope;
+        ptr++;
+    }
+}
+
+} // namespace
+
+int ReLU_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    int w = bottom_top_blob.w;
+    int h = bottom_top_blob.h;
+    int channels = bottom_top_blob.c;
+    int size = w * h * bottom_top_blob.elempack;
+
+    relu_sse_task task(bottom_top_blob, size, slope);
+
+    parallel_for(task, channels, opt);
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,149 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "scale_x86.h"
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(Scale_x86)
+
+// x * s + bias, bias is skipped when bias_term is off
+template<bool BIAS>
+static void scale_sse(float* ptr, int size, float s, float bias)
+{
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _s = _mm256_set1_ps(s);
+        __m256 _bias = _mm256_set1_ps(bias);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            _p = BIAS ? _mm256_comp_fmadd_ps(_p, _s, _bias) : _mm256_mul_ps(_p, _s);
+            _mm256_storeu_ps(ptr, _p);
+            ptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _s = _mm_set1_ps(s);
+        __m128 _bias = _mm_set1_ps(bias);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            _p = BIAS ? _mm_comp_fmadd_ps(_p, _s, _bias) : _mm_mul_ps(_p, _s);
+            _mm_storeu_ps(ptr, _p);
+            ptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *ptr = BIAS ? *ptr * s + bias : *ptr * s;
+        ptr++;
+    }
+}
+
+namespace {
+
+// one channel
+struct scale_bias_channels_sse_task : public ParallelTask
+{
+    scale_bias_channels_sse_task(Mat& _bottom_top_blob, const Mat& _scale_blob, const Mat& _bias_data, int _size)
+        : bottom_top_blob(_bottom_top_blob), scale_blob(_scale_blob), bias_data(_bias_data), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& scale_blob;
+    const Mat& bias_data;
+    int size;
+};
+
+void scale_bias_channels_sse_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    scale_sse<true>(ptr, size, scale_blob[q], bias_data[q]);
+}
+
+// one channel
+struct scale_channels_sse_task : public ParallelTask
+{
+    scale_channels_sse_task(Mat& _bottom_top_blob, const Mat& _scale_blob, int _size)
+        : bottom_top_blob(_bottom_top_blob), scale_blob(_scale_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    const Mat& scale_blob;
+    int size;
+};
+
+void scale_channels_sse_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    scale_sse<false>(ptr, size, scale_blob[q], 0.f);
+}
+
+} // namespace
+
+static void scale_channels_sse(Mat& bottom_top_blob, const Mat& scale_blob, const Mat& bias_data, int bias_term, const Option& opt)
+{
+    int w = bottom_top_blob.w;
+    int h = bottom_top_blob.h;
+    int channels = bottom_top_blob.c;
+    int size = w * h;
+
+    if (bias_term)
+    {
+        scale_bias_channels_sse_task task(bottom_top_blob, scale_blob, bias_data, size);
+
+        parallel_for(task, channels, opt);
+    }
+    else
+    {
+        scale_channels_sse_task task(bottom_top_blob, scale_blob, size);
+
+        parallel_for(task, channels, opt);
+    }
+}
+
+int Scale_x86::forward_inplace(std::vector<Mat>& bottom_top_blobs, const Option& opt) const
+{
+    Mat& bottom_top_blob = bottom_top_blobs[0];
+    const Mat& scale_blob = bottom_top_blobs[1];
+
+    scale_channels_sse(bottom_top_blob, scale_blob, bias_data, bias_term, opt);
+
+    return 0;
+}
+
+int Scale_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    scale_channels_sse(bottom_top_blob, scale_data, bias_data, bias_term, opt);
+
+    return 0;
+}
+
+} // namespace ncnn
@@ -0,0 +1,106 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "tanh_x86.h"
+
+#include <math.h>
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+#if __SSE2__
+#include "sse_mathfun.h"
+#endif // __SSE2__
+#if __AVX__
+#include "avx_mathfun.h"
+#endif // __AVX__
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(TanH_x86)
+
+namespace {
+
+// one channel
+struct tanh_sse_task : public ParallelTask
+{
+    tanh_sse_task(Mat& _bottom_top_blob, int _size)
+        : bottom_top_blob(_bottom_top_blob), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& bottom_top_blob;
+    int size;
+};
+
+void tanh_sse_task::execute(int q) const
+{
+    float* ptr = bottom_top_blob.channel(q);
+
+    int i = 0;
+#if __AVX__
+    {
+        __m256 _one = _mm256_set1_ps(1.f);
+        __m256 _two = _mm256_set1_ps(2.f);
+        for (; i+7<size; i+=8)
+        {
+            __m256 _p = _mm256_loadu_ps(ptr);
+            _p = exp256_ps(_mm256_mul_ps(_p, _two));
+            _p = _mm256_sub_ps(_one, _mm256_div_ps(_two, _mm256_add_ps(_p, _one)));
+            _mm256_storeu_ps(ptr, _p);
+            ptr += 8;
+        }
+    }
+#endif // __AVX__
+#if __SSE2__
+    {
+        __m128 _one = _mm_set1_ps(1.f);
+        __m128 _two = _mm_set1_ps(2.f);
+        for (; i+3<size; i+=4)
+        {
+            __m128 _p = _mm_loadu_ps(ptr);
+            _p = exp_ps(_mm_mul_ps(_p, _two));
+            _p = _mm_sub_ps(_one, _mm_div_ps(_two, _mm_add_ps(_p, _one)));
+            _mm_storeu_ps(ptr, _p);
+            ptr += 4;
+        }
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *ptr = tanh(*ptr);
+        ptr++;
+    }
+}
+
+} // namespace
+
+// tanh(x) = 1 - 2 / (exp(2x) + 1), saturates to -1 and 1 through the exp clamp
+int TanH_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    int w = bottom_top_blob.w;
+    int h = bottom_top_blob.h;
+    int channels = bottom_top_blob.c;
+    int size = w * h;
+
+    tanh_sse_task task(bottom_top_blob, size);
+
+    parallel_for(task, channels, opt);
+
+    return 0;
+}
+
+} // namespace ncnn
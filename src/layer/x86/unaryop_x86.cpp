@@ -0,0 +1,291 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "unaryop_x86.h"
+
+#include <math.h>
+
+#include "threadpool.h"
+#include "x86_usability.h"
+
+#if __SSE2__
+#include "sse_mathfun.h"
+#endif // __SSE2__
+#if __AVX__
+#include "avx_mathfun.h"
+#endif // __AVX__
+
+namespace ncnn {
+
+DEFINE_LAYER_CREATOR(UnaryOp_x86)
+
+#if __SSE2__
+static inline __m128 floor_ps(__m128 x)
+{
+#if __SSE4_1__
+    return _mm_floor_ps(x);
+#else
+    // truncate, step down where that rounded up, keep the values that are integral already
+    __m128 _t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    _t = _mm_sub_ps(_t, _mm_and_ps(_mm_cmpgt_ps(_t, x), _mm_set1_ps(1.f)));
+    __m128 _big = _mm_cmpnlt_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), x), _mm_set1_ps(8388608.f));
+    return _mm_or_ps(_mm_and_ps(_big, x), _mm_andnot_ps(_big, _t));
+#endif
+}
+#endif // __SSE2__
+
+// internal linkage, every isa build has its own ops
+namespace {
+
+struct unary_op_abs
+{
+    float func(float x) const { return fabs(x); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return _mm_andnot_ps(_mm_set1_ps(-0.f), x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), x); }
+#endif // __AVX__
+};
+
+struct unary_op_neg
+{
+    float func(float x) const { return -x; }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return _mm_xor_ps(_mm_set1_ps(-0.f), x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return _mm256_xor_ps(_mm256_set1_ps(-0.f), x); }
+#endif // __AVX__
+};
+
+struct unary_op_floor
+{
+    float func(float x) const { return floor(x); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return floor_ps(x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return _mm256_floor_ps(x); }
+#endif // __AVX__
+};
+
+struct unary_op_ceil
+{
+    float func(float x) const { return ceil(x); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return _mm_xor_ps(_mm_set1_ps(-0.f), floor_ps(_mm_xor_ps(_mm_set1_ps(-0.f), x))); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return _mm256_ceil_ps(x); }
+#endif // __AVX__
+};
+
+struct unary_op_square
+{
+    float func(float x) const { return x * x; }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return _mm_mul_ps(x, x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return _mm256_mul_ps(x, x); }
+#endif // __AVX__
+};
+
+struct unary_op_sqrt
+{
+    float func(float x) const { return sqrt(x); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return _mm_sqrt_ps(x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return _mm256_sqrt_ps(x); }
+#endif // __AVX__
+};
+
+// full precision, rsqrt_ps only gives 12 bits
+struct unary_op_rsqrt
+{
+    float func(float x) const { return 1.f / sqrt(x); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(x)); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_sqrt_ps(x)); }
+#endif // __AVX__
+};
+
+struct unary_op_exp
+{
+    float func(float x) const { return exp(x); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return exp_ps(x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return exp256_ps(x); }
+#endif // __AVX__
+};
+
+struct unary_op_log
+{
+    float func(float x) const { return log(x); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return log_ps(x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return log256_ps(x); }
+#endif // __AVX__
+};
+
+struct unary_op_sin
+{
+    float func(float x) const { return sin(x); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return sin_ps(x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return sin256_ps(x); }
+#endif // __AVX__
+};
+
+struct unary_op_cos
+{
+    float func(float x) const { return cos(x); }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return cos_ps(x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return cos256_ps(x); }
+#endif // __AVX__
+};
+
+struct unary_op_reciprocal
+{
+    float func(float x) const { return 1.f / x; }
+#if __SSE2__
+    __m128 func_pack4(__m128 x) const { return _mm_div_ps(_mm_set1_ps(1.f), x); }
+#endif // __SSE2__
+#if __AVX__
+    __m256 func_pack8(__m256 x) const { return _mm256_div_ps(_mm256_set1_ps(1.f), x); }
+#endif // __AVX__
+};
+
+} // namespace
+
+namespace {
+
+// one channel
+template<typename Op>
+struct unary_op_inplace_task : public ParallelTask
+{
+    unary_op_inplace_task(Mat& _a, int _size)
+        : a(_a), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& a;
+    int size;
+};
+
+template<typename Op>
+void unary_op_inplace_task<Op>::execute(int q) const
+{
+    Op op;
+
+    float* ptr = a.channel(q);
+
+    int i = 0;
+#if __AVX__
+    for (; i+7<size; i+=8)
+    {
+        __m256 _p = _mm256_loadu_ps(ptr);
+        _mm256_storeu_ps(ptr, op.func_pack8(_p));
+        ptr += 8;
+    }
+#endif // __AVX__
+#if __SSE2__
+    for (; i+3<size; i+=4)
+    {
+        __m128 _p = _mm_loadu_ps(ptr);
+        _mm_storeu_ps(ptr, op.func_pack4(_p));
+        ptr += 4;
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        *ptr = op.func(*ptr);
+        ptr++;
+    }
+}
+
+} // namespace
+
+template<typename Op>
+static int unary_op_inplace(Mat& a, const Option& opt)
+{
+    int size = a.w * a.h;
+    int channels = a.c;
+
+    unary_op_inplace_task<Op> task(a, size);
+
+    parallel_for(task, channels, opt);
+
+    return 0;
+}
+
+int UnaryOp_x86::forward_inplace(Mat& bottom_top_blob, const Option& opt) const
+{
+    if (op_type == Operation_ABS)
+        return unary_op_inplace<unary_op_abs>(bottom_top_blob, opt);
+
+    if (op_type == Operation_NEG)
+        return unary_op_inplace<unary_op_neg>(bottom_top_blob, opt);
+
+    if (op_type == Operation_FLOOR)
+        return unary_op_inplace<unary_op_floor>(bottom_top_blob, opt);
+
+    if (op_type == Operation_CEIL)
+        return unary_op_inplace<unary_op_ceil>(bottom_top_blob, opt);
+
+    if (op_type == Operation_SQUARE)
+        return unary_op_inplace<unary_op_square>(bottom_top_blob, opt);
+
+    if (op_type == Operation_SQRT)
+        return unary_op_inplace<unary_op_sqrt>(bottom_top_blob, opt);
+
+    if (op_type == Operation_RSQRT)
+        return unary_op_inplace<unary_op_rsqrt>(bottom_top_blob, opt);
+
+    if (op_type == Operation_EXP)
+        return unary_op_inplace<unary_op_exp>(bottom_top_blob, opt);
+
+    if (op_type == Operation_LOG)
+        return unary_op_inplace<unary_op_log>(bottom_top_blob, opt);
+
+    if (op_type == Operation_SIN)
+        return unary_op_inplace<unary_op_sin>(bottom_top_blob, opt);
+
+    if (op_type == Operation_COS)
+        return unary_op_inplace<unary_op_cos>(bottom_top_blob, opt);
+
+    if (op_type == Operation_RECIPROCAL)
+        return unary_op_inplace<unary_op_reciprocal>(bottom_top_blob, opt);
+
+    // tan asin acos atan are left to the generic code
+    return UnaryOp::forward_inplace(bottom_top_blob, opt);
+}
+
+} // namespace ncnn
@@ -0,0 +1,170 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef X86_USABILITY_H
+#define X86_USABILITY_H
+
+#if __SSE2__
+#include <emmintrin.h>
+#if __SSE4_1__
+#include <smmintrin.h>
+#endif // __SSE4_1__
+#endif // __SSE2__
+#if __AVX__
+#include <immintrin.h>
+#endif // __AVX__
+
+// helpers shared by the x86 kernels, each isa build gets its own copy
+
+#if __SSE2__
+static inline __m128 _mm_comp_fmadd_ps(__m128 a, __m128 b, __m128 c)
+{
+#if __FMA__
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// sum of the 4 lanes
+static inline float _mm_reduce_add_ps(__m128 x)
+{
+    __m128 x64 = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    __m128 x32 = _mm_add_ss(x64, _mm_shuffle_ps(x64, x64, 0x55));
+    return _mm_cvtss_f32(x32);
+}
+
+// max of the 4 lanes
+static inline float _mm_reduce_max_ps(__m128 x)
+{
+    __m128 x64 = _mm_max_ps(x, _mm_movehl_ps(x, x));
+    __m128 x32 = _mm_max_ss(x64, _mm_shuffle_ps(x64, x64, 0x55));
+    return _mm_cvtss_f32(x32);
+}
+
+// sign extend the low 8 int8 lanes to int16
+static inline __m128i _mm_comp_cvtepi8_epi16(__m128i a)
+{
+#if __SSE4_1__
+    return _mm_cvtepi8_epi16(a);
+#else
+    return _mm_srai_epi16(_mm_unpacklo_epi8(a, a), 8);
+#endif
+}
+
+// sum of the 4 int32 lanes
+static inline int _mm_reduce_add_epi32(__m128i x)
+{
+    __m128i x64 = _mm_add_epi32(x, _mm_unpackhi_epi64(x, x));
+    __m128i x32 = _mm_add_epi32(x64, _mm_shuffle_epi32(x64, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtsi128_si32(x32);
+}
+
+// the fused activation of activation_ss, slope is the leakyrelu one
+static inline __m128 _mm_activation_ps(__m128 v, int activation_type, float slope)
+{
+    if (activation_type == 1)
+        return _mm_max_ps(v, _mm_setzero_ps());
+    if (activation_type == 2)
+        return _mm_add_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_mul_ps(_mm_set1_ps(slope), _mm_min_ps(v, _mm_setzero_ps())));
+    return v;
+}
+#endif // __SSE2__
+
+#if __AVX__
+static inline __m256 _mm256_comp_fmadd_ps(__m256 a, __m256 b, __m256 c)
+{
+#if __FMA__
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+static inline void transpose8_ps(__m256* r)
+{
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    __m256 tt0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0));
+    __m256 tt1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2));
+    __m256 tt2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0));
+    __m256 tt3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2));
+    __m256 tt4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1,0,1,0));
+    __m256 tt5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3,2,3,2));
+    __m256 tt6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1,0,1,0));
+    __m256 tt7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3,2,3,2));
+
+    r[0] = _mm256_permute2f128_ps(tt0, tt4, 0x20);
+    r[1] = _mm256_permute2f128_ps(tt1, tt5, 0x20);
+    r[2] = _mm256_permute2f128_ps(tt2, tt6, 0x20);
+    r[3] = _mm256_permute2f128_ps(tt3, tt7, 0x20);
+    r[4] = _mm256_permute2f128_ps(tt0, tt4, 0x31);
+    r[5] = _mm256_permute2f128_ps(tt1, tt5, 0x31);
+    r[6] = _mm256_permute2f128_ps(tt2, tt6, 0x31);
+    r[7] = _mm256_permute2f128_ps(tt3, tt7, 0x31);
+}
+
+// sum of the 8 lanes
+static inline float _mm256_reduce_add_ps(__m256 x)
+{
+    __m128 x128 = _mm_add_ps(_mm256_extractf128_ps(x, 1), _mm256_castps256_ps128(x));
+    __m128 x64 = _mm_add_ps(x128, _mm_movehl_ps(x128, x128));
+    __m128 x32 = _mm_add_ss(x64, _mm_shuffle_ps(x64, x64, 0x55));
+    return _mm_cvtss_f32(x32);
+}
+
+// max of the 8 lanes
+static inline float _mm256_reduce_max_ps(__m256 x)
+{
+    return _mm_reduce_max_ps(_mm_max_ps(_mm256_extractf128_ps(x, 1), _mm256_castps256_ps128(x)));
+}
+
+static inline __m256 _mm256_activation_ps(__m256 v, int activation_type, float slope)
+{
+    if (activation_type == 1)
+        return _mm256_max_ps(v, _mm256_setzero_ps());
+    if (activation_type == 2)
+        return _mm256_add_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_mul_ps(_mm256_set1_ps(slope), _mm256_min_ps(v, _mm256_setzero_ps())));
+    return v;
+}
+#endif // __AVX__
+
+#if __AVX2__
+// sum of the 8 int32 lanes
+static inline int _mm256_reduce_add_epi32(__m256i x)
+{
+    return _mm_reduce_add_epi32(_mm_add_epi32(_mm256_extracti128_si256(x, 1), _mm256_castsi256_si128(x)));
+}
+#endif // __AVX2__
+
+#if __AVX512F__
+static inline __m512 _mm512_activation_ps(__m512 v, int activation_type, float slope)
+{
+    // masked forms, the unmasked max and min trip -Wmaybe-uninitialized in gcc
+    if (activation_type == 1)
+        return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(v, _mm512_setzero_ps(), _CMP_GT_OQ), v);
+    if (activation_type == 2)
+        return _mm512_mask_mul_ps(v, _mm512_cmp_ps_mask(v, _mm512_setzero_ps(), _CMP_LT_OQ), v, _mm512_set1_ps(slope));
+    return v;
+}
+#endif // __AVX512F__
+
+#endif // X86_USABILITY_H
@@ -17,185 +17,251 @@
 #if __ARM_NEON
 #include <arm_neon.h>
 #endif // __ARM_NEON
+#if __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
 
 #include "cpu.h"
+#include "layer.h"
+#include "threadpool.h"
 
 namespace ncnn {
 
-void Mat::substract_mean_normalize(const float* mean_vals, const float* norm_vals)
-{
-    int size = w * h;
+namespace {
 
-    if (mean_vals && !norm_vals)
+// one channel
+struct substract_mean_task : public ParallelTask
+{
+    substract_mean_task(Mat& _m, const float* _mean_vals, int _size)
+        : m(_m), mean_vals(_mean_vals), size(_size)
     {
-        // substract mean only
-        #pragma omp parallel for
-        for (int q=0; q<c; q++)
-        {
-            float* ptr = channel(q);//data + cstep * q;
-            const float mean = mean_vals[q];
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& m;
+    const float* mean_vals;
+    int size;
+};
+
+void substract_mean_task::execute(int q) const
+{
+    float* ptr = m.channel(q);//data + cstep * q;
+    const float mean = mean_vals[q];
 
 #if __ARM_NEON
-            int nn = size >> 2;
-            int remain = size - (nn << 2);
+    int nn = size >> 2;
+    int remain = size - (nn << 2);
 #else
-            int remain = size;
+    int remain = size;
 #endif // __ARM_NEON
 
 #if __ARM_NEON
 #if __aarch64__
-            float32x4_t _mean = vdupq_n_f32(mean);
-            for (; nn>0; nn--)
-            {
-                float32x4_t _ptr = vld1q_f32(ptr);
-                _ptr = vsubq_f32(_ptr, _mean);
-                vst1q_f32(ptr, _ptr);
-                ptr += 4;
-            }
+    float32x4_t _mean = vdupq_n_f32(mean);
+    for (; nn>0; nn--)
+    {
+        float32x4_t _ptr = vld1q_f32(ptr);
+        _ptr = vsubq_f32(_ptr, _mean);
+        vst1q_f32(ptr, _ptr);
+        ptr += 4;
+    }
 #else
-            if (nn > 0)
-            {
-            asm volatile(
-                "vdup.f32   q1, %4              \n"
-                "0:                             \n"
-                "pld        [%1, #128]          \n"
-                "vld1.f32   {d0-d1}, [%1 :128]  \n"
-                "vsub.f32   q0, q0, q1          \n"
-                "subs       %0, #1              \n"
-                "vst1.f32   {d0-d1}, [%1 :128]! \n"
-                "bne        0b                  \n"
-                : "=r"(nn),     // %0
-                  "=r"(ptr)     // %1
-                : "0"(nn),
-                  "1"(ptr),
-                  "r"(mean)     // %4
-                : "cc", "memory", "q0", "q1"
-            );
-            }
+    if (nn > 0)
+    {
+    asm volatile(
+        "vdup.f32   q1, %4              \n"
+        "0:                             \n"
+        "pld        [%1, #128]          \n"
+        "vld1.f32   {d0-d1}, [%1 :128]  \n"
+        "vsub.f32   q0, q0, q1          \n"
+        "subs       %0, #1              \n"
+        "vst1.f32   {d0-d1}, [%1 :128]! \n"
+        "bne        0b                  \n"
+        : "=r"(nn),     // %0
+          "=r"(ptr)     // %1
+        : "0"(nn),
+          "1"(ptr),
+          "r"(mean)     // %4
+        : "cc", "memory", "q0", "q1"
+    );
+    }
 #endif // __aarch64__
 #endif // __ARM_NEON
-            for (; remain>0; remain--)
-            {
-                *ptr -= mean;
-                ptr++;
-            }
-        }
+    for (; remain>0; remain--)
+    {
+        *ptr -= mean;
+        ptr++;
     }
-    else if (!mean_vals && norm_vals)
+}
+
+// one channel
+struct normalize_task : public ParallelTask
+{
+    normalize_task(Mat& _m, const float* _norm_vals, int _size)
+        : m(_m), norm_vals(_norm_vals), size(_size)
     {
-        // normalize only
-        #pragma omp parallel for
-        for (int q=0; q<c; q++)
-        {
-            float* ptr = channel(q);//data + cstep * q;
-            const float norm = norm_vals[q];
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& m;
+    const float* norm_vals;
+    int size;
+};
+
+void normalize_task::execute(int q) const
+{
+    float* ptr = m.channel(q);//data + cstep * q;
+    const float norm = norm_vals[q];
 
 #if __ARM_NEON
-            int nn = size >> 2;
-            int remain = size - (nn << 2);
+    int nn = size >> 2;
+    int remain = size - (nn << 2);
 #else
-            int remain = size;
+    int remain = size;
 #endif // __ARM_NEON
 
 #if __ARM_NEON
 #if __aarch64__
-            float32x4_t _norm = vdupq_n_f32(norm);
-            for (; nn>0; nn--)
-            {
-                float32x4_t _ptr = vld1q_f32(ptr);
-                _ptr = vmulq_f32(_ptr, _norm);
-                vst1q_f32(ptr, _ptr);
-                ptr += 4;
-            }
+    float32x4_t _norm = vdupq_n_f32(norm);
+    for (; nn>0; nn--)
+    {
+        float32x4_t _ptr = vld1q_f32(ptr);
+        _ptr = vmulq_f32(_ptr, _norm);
+        vst1q_f32(ptr, _ptr);
+        ptr += 4;
+    }
 #else
-            if (nn > 0)
-            {
-            asm volatile(
-                "vdup.f32   q1, %4              \n"
-                "0:                             \n"
-                "pld        [%1, #128]          \n"
-                "vld1.f32   {d0-d1}, [%1 :128]  \n"
-                "vmul.f32   q0, q0, q1          \n"
-                "subs       %0, #1              \n"
-                "vst1.f32   {d0-d1}, [%1 :128]! \n"
-                "bne        0b                  \n"
-                : "=r"(nn),     // %0
-                  "=r"(ptr)     // %1
-                : "0"(nn),
-                  "1"(ptr),
-                  "r"(norm)     // %4
-                : "cc", "memory", "q0", "q1"
-            );
-            }
+    if (nn > 0)
+    {
+    asm volatile(
+        "vdup.f32   q1, %4              \n"
+        "0:                             \n"
+        "pld        [%1, #128]          \n"
+        "vld1.f32   {d0-d1}, [%1 :128]  \n"
+        "vmul.f32   q0, q0, q1          \n"
+        "subs       %0, #1              \n"
+        "vst1.f32   {d0-d1}, [%1 :128]! \n"
+        "bne        0b                  \n"
+        : "=r"(nn),     // %0
+          "=r"(ptr)     // %1
+        : "0"(nn),
+          "1"(ptr),
+          "r"(norm)     // %4
+        : "cc", "memory", "q0", "q1"
+    );
+    }
 #endif // __aarch64__
 #endif // __ARM_NEON
-            for (; remain>0; remain--)
-            {
-                *ptr *= norm;
-                ptr++;
-            }
-        }
+    for (; remain>0; remain--)
+    {
+        *ptr *= norm;
+        ptr++;
     }
-    else if (mean_vals && norm_vals)
+}
+
+// one channel
+struct substract_mean_normalize_task : public ParallelTask
+{
+    substract_mean_normalize_task(Mat& _m, const float* _mean_vals, const float* _norm_vals, int _size)
+        : m(_m), mean_vals(_mean_vals), norm_vals(_norm_vals), size(_size)
     {
-        // substract mean and normalize
-        #pragma omp parallel for
-        for (int q=0; q<c; q++)
-        {
-            float* ptr = channel(q);//data + cstep * q;
-            const float mean = mean_vals[q];
-            const float norm = norm_vals[q];
+    }
+
+    virtual void execute(int q) const;
+
+    Mat& m;
+    const float* mean_vals;
+    const float* norm_vals;
+    int size;
+};
+
+void substract_mean_normalize_task::execute(int q) const
+{
+    float* ptr = m.channel(q);//data + cstep * q;
+    const float mean = mean_vals[q];
+    const float norm = norm_vals[q];
 
 #if __ARM_NEON
-            int nn = size >> 2;
-            int remain = size - (nn << 2);
+    int nn = size >> 2;
+    int remain = size - (nn << 2);
 #else
-            int remain = size;
+    int remain = size;
 #endif // __ARM_NEON
 
 #if __ARM_NEON
 #if __aarch64__
-            float32x4_t _mean = vdupq_n_f32(mean);
-            float32x4_t _norm = vdupq_n_f32(norm);
-            for (; nn>0; nn--)
-            {
-                float32x4_t _ptr = vld1q_f32(ptr);
-                _ptr = vsubq_f32(_ptr, _mean);
-                _ptr = vmulq_f32(_ptr, _norm);
-                vst1q_f32(ptr, _ptr);
-                ptr += 4;
-            }
+    float32x4_t _mean = vdupq_n_f32(mean);
+    float32x4_t _norm = vdupq_n_f32(norm);
+    for (; nn>0; nn--)
+    {
+        float32x4_t _ptr = vld1q_f32(ptr);
+        _ptr = vsubq_f32(_ptr, _mean);
+        _ptr = vmulq_f32(_ptr, _norm);
+        vst1q_f32(ptr, _ptr);
+        ptr += 4;
+    }
 #else
-            if (nn > 0)
-            {
-            asm volatile(
-                "vdup.f32   q1, %4              \n"
-                "vdup.f32   q2, %5              \n"
-                "0:                             \n"
-                "pld        [%1, #128]          \n"
-                "vld1.f32   {d0-d1}, [%1 :128]  \n"
-                "vsub.f32   q0, q0, q1          \n"
-                "vmul.f32   q0, q0, q2          \n"
-                "subs       %0, #1              \n"
-                "vst1.f32   {d0-d1}, [%1 :128]! \n"
-                "bne        0b                  \n"
-                : "=r"(nn),     // %0
-                  "=r"(ptr)     // %1
-                : "0"(nn),
-                  "1"(ptr),
-                  "r"(mean),    // %4
-                  "r"(norm)     // %5
-                : "cc", "memory", "q0", "q1", "q2"
-            );
-            }
+    if (nn > 0)
+    {
+    asm volatile(
+        "vdup.f32   q1, %4              \n"
+        "vdup.f32   q2, %5              \n"
+        "0:                             \n"
+        "pld        [%1, #128]          \n"
+        "vld1.f32   {d0-d1}, [%1 :128]  \n"
+        "vsub.f32   q0, q0, q1          \n"
+        "vmul.f32   q0, q0, q2          \n"
+        "subs       %0, #1              \n"
+        "vst1.f32   {d0-d1}, [%1 :128]! \n"
+        "bne        0b                  \n"
+        : "=r"(nn),     // %0
+          "=r"(ptr)     // %1
+        : "0"(nn),
+          "1"(ptr),
+          "r"(mean),    // %4
+          "r"(norm)     // %5
+        : "cc", "memory", "q0", "q1", "q2"
+    );
+    }
 #endif // __aarch64__
 #endif // __ARM_NEON
-            for (; remain>0; remain--)
-            {
-                *ptr = (*ptr - mean) * norm;
-                ptr++;
-            }
-        }
+    for (; remain>0; remain--)
+    {
+        *ptr = (*ptr - mean) * norm;
+        ptr++;
+    }
+}
+
+} // namespace
+
+void Mat::substract_mean_normalize(const float* mean_vals, const float* norm_vals)
+{
+    Mat& m = *this;
+
+    int size = w * h;
+
+    if (mean_vals && !norm_vals)
+    {
+        // substract mean only
+        substract_mean_task task(m, mean_vals, size);
+
+        parallel_for(task, c, get_default_option());
+    }
+    else if (!mean_vals && norm_vals)
+    {
+        // normalize only
+        normalize_task task(m, norm_vals, size);
+
+        parallel_for(task, c, get_default_option());
+    }
+    else if (mean_vals && norm_vals)
+    {
+        // substract mean and normalize
+        substract_mean_normalize_task task(m, mean_vals, norm_vals, size);
+
+        parallel_for(task, c, get_default_option());
     }
 }
 
@@ -251,9 +317,9 @@ static float half2float(unsigned short value)
     return tmp.f;
 }
 
-Mat Mat::from_float16(const unsigned short* data, int size)
+Mat Mat::from_float16(const unsigned short* data, int size, Allocator* allocator)
 {
-    Mat m(size);
+    Mat m(size, 4u, allocator);
     if (m.empty())
         return m;
 
@@ -464,7 +530,37 @@ static void copy_make_border_image(const Mat& src, Mat& dst, int top, int left,
     }
 }
 
-void copy_make_border(const Mat& src, Mat& dst, int top, int bottom, int left, int right, int type, float v)
+namespace {
+
+// one channel
+struct copy_make_border_task : public ParallelTask
+{
+    copy_make_border_task(const Mat& _src, Mat& _dst, int _top, int _left, int _type, float _v)
+        : src(_src), dst(_dst), top(_top), left(_left), type(_type), v(_v)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& src;
+    Mat& dst;
+    int top;
+    int left;
+    int type;
+    float v;
+};
+
+void copy_make_border_task::execute(int q) const
+{
+    const Mat m = src.channel(q);
+    Mat borderm = dst.channel(q);
+
+    copy_make_border_image(m, borderm, top, left, type, v);
+}
+
+} // namespace
+
+void copy_make_border(const Mat& src, Mat& dst, int top, int bottom, int left, int right, int type, float v, Allocator* allocator)
 {
     int w = src.w + left + right;
     int h = src.h + top + bottom;
@@ -477,7 +573,7 @@ void copy_make_border(const Mat& src, Mat& dst, int top, int bottom, int left, i
 
     if (src.dims == 2)
     {
-        dst.create(w, h);
+        dst.create(w, h, 4u, allocator);
         if (dst.empty())
             return;
 
@@ -487,19 +583,14 @@ void copy_make_border(const Mat& src, Mat& dst, int top, int bottom, int left, i
     {
         int channels = src.c;
 
-        dst.create(w, h, channels);
+        dst.create(w, h, channels, 4u, allocator);
         if (dst.empty())
             return;
 
         // unroll image channel
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const Mat m = src.channel(q);
-            Mat borderm = dst.channel(q);
+        copy_make_border_task task(src, dst, top, left, type, v);
 
-            copy_make_border_image(m, borderm, top, left, type, v);
-        }
+        parallel_for(task, channels, get_default_option());
     }
 }
 
@@ -529,7 +620,35 @@ static void copy_cut_border_image(const Mat& src, Mat& dst, int top, int left)
     }
 }
 
-void copy_cut_border(const Mat& src, Mat& dst, int top, int bottom, int left, int right)
+namespace {
+
+// one channel
+struct copy_cut_border_task : public ParallelTask
+{
+    copy_cut_border_task(const Mat& _src, Mat& _dst, int _top, int _left)
+        : src(_src), dst(_dst), top(_top), left(_left)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& src;
+    Mat& dst;
+    int top;
+    int left;
+};
+
+void copy_cut_border_task::execute(int q) const
+{
+    const Mat m = src.channel(q);
+    Mat cutm = dst.channel(q);
+
+    copy_cut_border_image(m, cutm, top, left);
+}
+
+} // namespace
+
+void copy_cut_border(const Mat& src, Mat& dst, int top, int bottom, int left, int right, Allocator* allocator)
 {
     int w = src.w - left - right;
     int h = src.h - top - bottom;
@@ -542,7 +661,7 @@ void copy_cut_border(const Mat& src, Mat& dst, int top, int bottom, int left, in
 
     if (src.dims == 2)
     {
-        dst.create(w, h);
+        dst.create(w, h, 4u, allocator);
         if (dst.empty())
             return;
 
@@ -552,19 +671,170 @@ void copy_cut_border(const Mat& src, Mat& dst, int top, int bottom, int left, in
     {
         int channels = src.c;
 
-        dst.create(w, h, channels);
+        dst.create(w, h, channels, 4u, allocator);
         if (dst.empty())
             return;
 
         // unroll image channel
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const Mat m = src.channel(q);
-            Mat cutm = dst.channel(q);
+        copy_cut_border_task task(src, dst, top, left);
+
+        parallel_for(task, channels, get_default_option());
+    }
+}
+
+namespace {
+
+// one pack of four channels
+struct convert_packing_pack4_task : public ParallelTask
+{
+    convert_packing_pack4_task(const Mat& _src, Mat& _dst, int _size)
+        : src(_src), dst(_dst), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& src;
+    Mat& dst;
+    int size;
+};
+
+void convert_packing_pack4_task::execute(int q) const
+{
+    const float* r0 = src.channel(q * 4);
+    const float* r1 = src.channel(q * 4 + 1);
+    const float* r2 = src.channel(q * 4 + 2);
+    const float* r3 = src.channel(q * 4 + 3);
+
+    float* outptr = dst.channel(q);
+
+    int i = 0;
+#if __SSE2__
+    for (; i+3<size; i+=4)
+    {
+        __m128 _r0 = _mm_loadu_ps(r0 + i);
+        __m128 _r1 = _mm_loadu_ps(r1 + i);
+        __m128 _r2 = _mm_loadu_ps(r2 + i);
+        __m128 _r3 = _mm_loadu_ps(r3 + i);
+        _MM_TRANSPOSE4_PS(_r0, _r1, _r2, _r3);
+        _mm_storeu_ps(outptr, _r0);
+        _mm_storeu_ps(outptr + 4, _r1);
+        _mm_storeu_ps(outptr + 8, _r2);
+        _mm_storeu_ps(outptr + 12, _r3);
+        outptr += 16;
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        outptr[0] = r0[i];
+        outptr[1] = r1[i];
+        outptr[2] = r2[i];
+        outptr[3] = r3[i];
+        outptr += 4;
+    }
+}
 
-            copy_cut_border_image(m, cutm, top, left);
+// one pack of four channels
+struct convert_packing_unpack4_task : public ParallelTask
+{
+    convert_packing_unpack4_task(const Mat& _src, Mat& _dst, int _size)
+        : src(_src), dst(_dst), size(_size)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& src;
+    Mat& dst;
+    int size;
+};
+
+void convert_packing_unpack4_task::execute(int q) const
+{
+    const float* ptr = src.channel(q);
+
+    float* outptr0 = dst.channel(q * 4);
+    float* outptr1 = dst.channel(q * 4 + 1);
+    float* outptr2 = dst.channel(q * 4 + 2);
+    float* outptr3 = dst.channel(q * 4 + 3);
+
+    int i = 0;
+#if __SSE2__
+    for (; i+3<size; i+=4)
+    {
+        __m128 _r0 = _mm_loadu_ps(ptr);
+        __m128 _r1 = _mm_loadu_ps(ptr + 4);
+        __m128 _r2 = _mm_loadu_ps(ptr + 8);
+        __m128 _r3 = _mm_loadu_ps(ptr + 12);
+        _MM_TRANSPOSE4_PS(_r0, _r1, _r2, _r3);
+        _mm_storeu_ps(outptr0 + i, _r0);
+        _mm_storeu_ps(outptr1 + i, _r1);
+        _mm_storeu_ps(outptr2 + i, _r2);
+        _mm_storeu_ps(outptr3 + i, _r3);
+        ptr += 16;
+    }
+#endif // __SSE2__
+    for (; i<size; i++)
+    {
+        outptr0[i] = ptr[0];
+        outptr1[i] = ptr[1];
+        outptr2[i] = ptr[2];
+        outptr3[i] = ptr[3];
+        ptr += 4;
+    }
+}
+
+} // namespace
+
+void convert_packing(const Mat& src, Mat& dst, int _elempack, Allocator* allocator)
+{
+    int elempack = src.elempack;
+
+    if (elempack == _elempack || src.dims != 3)
+    {
+        dst = src;
+        return;
+    }
+
+    int w = src.w;
+    int h = src.h;
+    int channels = src.c;
+    int size = w * h;
+
+    if (elempack == 1 && _elempack == 4)
+    {
+        // left as is when the channels do not fill the packs
+        if (channels % 4 != 0)
+        {
+            dst = src;
+            return;
         }
+
+        int outc = channels / 4;
+
+        dst.create(w, h, outc, src.elemsize * 4, 4, allocator);
+        if (dst.empty())
+            return;
+
+        convert_packing_pack4_task task(src, dst, size);
+
+        parallel_for(task, outc, get_default_option());
+    }
+    else if (elempack == 4 && _elempack == 1)
+    {
+        int outc = channels * 4;
+
+        dst.create(w, h, outc, src.elemsize / 4, allocator);
+        if (dst.empty())
+            return;
+
+        convert_packing_unpack4_task task(src, dst, size);
+
+        parallel_for(task, channels, get_default_option());
+    }
+    else
+    {
+        dst = src;
     }
 }
 
@@ -787,7 +1057,35 @@ static void resize_bilinear_image(const Mat& src, Mat& dst, int w, int h)
     delete[] buf;
 }
 
-void resize_bilinear(const Mat& src, Mat& dst, int w, int h)
+namespace {
+
+// one channel
+struct resize_bilinear_task : public ParallelTask
+{
+    resize_bilinear_task(const Mat& _src, Mat& _dst, int _w, int _h)
+        : src(_src), dst(_dst), w(_w), h(_h)
+    {
+    }
+
+    virtual void execute(int q) const;
+
+    const Mat& src;
+    Mat& dst;
+    int w;
+    int h;
+};
+
+void resize_bilinear_task::execute(int q) const
+{
+    const Mat m = src.channel(q);
+    Mat resizem = dst.channel(q);
+
+    resize_bilinear_image(m, resizem, w, h);
+}
+
+} // namespace
+
+void resize_bilinear(const Mat& src, Mat& dst, int w, int h, Allocator* allocator)
 {
     if (w == src.w && h == src.h)
     {
@@ -797,7 +1095,7 @@ void resize_bilinear(const Mat& src, Mat& dst, int w, int h)
 
     if (src.dims == 2)
     {
-        dst.create(w, h);
+        dst.create(w, h, 4u, allocator);
         if (dst.empty())
             return;
 
@@ -807,19 +1105,14 @@ void resize_bilinear(const Mat& src, Mat& dst, int w, int h)
     {
         int channels = src.c;
 
-        dst.create(w, h, channels);
+        dst.create(w, h, channels, 4u, allocator);
         if (dst.empty())
             return;
 
         // unroll image channel
-        #pragma omp parallel for
-        for (int q=0; q<channels; q++)
-        {
-            const Mat m = src.channel(q);
-            Mat resizem = dst.channel(q);
+        resize_bilinear_task task(src, dst, w, h);
 
-            resize_bilinear_image(m, resizem, w, h);
-        }
+        parallel_for(task, channels, get_default_option());
     }
 }
 
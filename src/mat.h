@@ -20,6 +20,7 @@
 #if __ARM_NEON
 #include <arm_neon.h>
 #endif
+#include "allocator.h"
 
 namespace ncnn {
 
@@ -30,19 +31,23 @@ public:
     // empty
     Mat();
     // vec
-    Mat(int w, size_t elemsize = 4);
+    Mat(int w, size_t elemsize = 4, Allocator* allocator = 0);
     // image
-    Mat(int w, int h, size_t elemsize = 4);
+    Mat(int w, int h, size_t elemsize = 4, Allocator* allocator = 0);
     // dim
-    Mat(int w, int h, int c, size_t elemsize = 4);
+    Mat(int w, int h, int c, size_t elemsize = 4, Allocator* allocator = 0);
+    // packed dim
+    Mat(int w, int h, int c, size_t elemsize, int elempack, Allocator* allocator = 0);
     // copy
     Mat(const Mat& m);
     // external vec
-    Mat(int w, void* data, size_t elemsize = 4);
+    Mat(int w, void* data, size_t elemsize = 4, Allocator* allocator = 0);
     // external image
-    Mat(int w, int h, void* data, size_t elemsize = 4);
+    Mat(int w, int h, void* data, size_t elemsize = 4, Allocator* allocator = 0);
     // external dim
-    Mat(int w, int h, int c, void* data, size_t elemsize = 4);
+    Mat(int w, int h, int c, void* data, size_t elemsize = 4, Allocator* allocator = 0);
+    // external packed dim
+    Mat(int w, int h, int c, void* data, size_t elemsize, int elempack, Allocator* allocator = 0);
     // release
     ~Mat();
     // assign
@@ -51,19 +56,23 @@ public:
     void fill(float v);
     template <typename T> void fill(T v);
     // deep copy
-    Mat clone() const;
+    Mat clone(Allocator* allocator = 0) const;
     // reshape vec
-    Mat reshape(int w) const;
+    Mat reshape(int w, Allocator* allocator = 0) const;
     // reshape image
-    Mat reshape(int w, int h) const;
+    Mat reshape(int w, int h, Allocator* allocator = 0) const;
     // reshape dim
-    Mat reshape(int w, int h, int c) const;
+    Mat reshape(int w, int h, int c, Allocator* allocator = 0) const;
+    // dims w h c without data
+    Mat shape() const;
     // allocate vec
-    void create(int w, size_t elemsize = 4);
+    void create(int w, size_t elemsize = 4, Allocator* allocator = 0);
     // allocate image
-    void create(int w, int h, size_t elemsize = 4);
+    void create(int w, int h, size_t elemsize = 4, Allocator* allocator = 0);
     // allocate dim
-    void create(int w, int h, int c, size_t elemsize = 4);
+    void create(int w, int h, int c, size_t elemsize = 4, Allocator* allocator = 0);
+    // allocate packed dim
+    void create(int w, int h, int c, size_t elemsize, int elempack, Allocator* allocator = 0);
     // refcount++
     void addref();
     // refcount--
@@ -113,9 +122,9 @@ public:
         PIXEL_RGBA2GRAY = PIXEL_RGBA | (PIXEL_GRAY << PIXEL_CONVERT_SHIFT),
     };
     // convenient construct from pixel data
-    static Mat from_pixels(const unsigned char* pixels, int type, int w, int h);
+    static Mat from_pixels(const unsigned char* pixels, int type, int w, int h, Allocator* allocator = 0);
     // convenient construct from pixel data and resize to specific size
-    static Mat from_pixels_resize(const unsigned char* pixels, int type, int w, int h, int target_width, int target_height);
+    static Mat from_pixels_resize(const unsigned char* pixels, int type, int w, int h, int target_width, int target_height, Allocator* allocator = 0);
 
     // convenient export to pixel data
     void to_pixels(unsigned char* pixels, int type);
@@ -126,7 +135,7 @@ public:
     void substract_mean_normalize(const float* mean_vals, const float* norm_vals);
 
     // convenient construct from half precisoin floating point data
-    static Mat from_float16(const unsigned short* data, int size);
+    static Mat from_float16(const unsigned short* data, int size, Allocator* allocator = 0);
 
     // pointer to the data
     void* data;
@@ -142,6 +151,17 @@ public:
     // 0 = empty
     size_t elemsize;
 
+    // packed count inside element
+    // c/1-h-w-1  h/1-w-1  w/1-1  scalar
+    // c/4-h-w-4  h/4-w-4  w/4-4  sse/neon
+    // elemsize covers the whole pack, c counts packs
+    int elempack;
+
+    // the allocator
+    // the data is freed with allocator->fastFree on release
+    // NULL means the default fastMalloc/fastFree
+    Allocator* allocator;
+
     // the dimensionality
     int dims;
 
@@ -164,100 +184,43 @@ enum
     BORDER_CONSTANT = 0,
     BORDER_REPLICATE = 1,
 };
-void copy_make_border(const Mat& src, Mat& dst, int top, int bottom, int left, int right, int type, float v);
-void copy_cut_border(const Mat& src, Mat& dst, int top, int bottom, int left, int right);
-void resize_bilinear(const Mat& src, Mat& dst, int w, int h);
-
-// the alignment of all the allocated buffers
-#define MALLOC_ALIGN    16
-
-// Aligns a pointer to the specified number of bytes
-// ptr Aligned pointer
-// n Alignment size that must be a power of two
-template<typename _Tp> static inline _Tp* alignPtr(_Tp* ptr, int n=(int)sizeof(_Tp))
-{
-    return (_Tp*)(((size_t)ptr + n-1) & -n);
-}
+// repack the channels of a dim mat, c/1-h-w-1 <-> c/4-h-w-4
+void convert_packing(const Mat& src, Mat& dst, int elempack, Allocator* allocator = 0);
+void copy_make_border(const Mat& src, Mat& dst, int top, int bottom, int left, int right, int type, float v, Allocator* allocator = 0);
+void copy_cut_border(const Mat& src, Mat& dst, int top, int bottom, int left, int right, Allocator* allocator = 0);
+void resize_bilinear(const Mat& src, Mat& dst, int w, int h, Allocator* allocator = 0);
 
-// Aligns a buffer size to the specified number of bytes
-// The function returns the minimum number that is greater or equal to sz and is divisible by n
-// sz Buffer size to align
-// n Alignment size that must be a power of two
-static inline size_t alignSize(size_t sz, int n)
-{
-    return (sz + n-1) & -n;
-}
-
-static inline void* fastMalloc(size_t size)
-{
-    unsigned char* udata = (unsigned char*)malloc(size + sizeof(void*) + MALLOC_ALIGN);
-    if (!udata)
-        return 0;
-    unsigned char** adata = alignPtr((unsigned char**)udata + 1, MALLOC_ALIGN);
-    adata[-1] = udata;
-    return adata;
-}
-
-static inline void fastFree(void* ptr)
+inline Mat::Mat()
+    : data(0), refcount(0), elemsize(0), elempack(0), allocator(0), dims(0), w(0), h(0), c(0), cstep(0)
 {
-    if (ptr)
-    {
-        unsigned char* udata = ((unsigned char**)ptr)[-1];
-        free(udata);
-    }
 }
 
-// exchange-add operation for atomic operations on reference counters
-#if defined __INTEL_COMPILER && !(defined WIN32 || defined _WIN32)
-// atomic increment on the linux version of the Intel(tm) compiler
-#  define NCNN_XADD(addr, delta) (int)_InterlockedExchangeAdd(const_cast<void*>(reinterpret_cast<volatile void*>(addr)), delta)
-#elif defined __GNUC__
-#  if defined __clang__ && __clang_major__ >= 3 && !defined __ANDROID__ && !defined __EMSCRIPTEN__ && !defined(__CUDACC__)
-#    ifdef __ATOMIC_ACQ_REL
-#      define NCNN_XADD(addr, delta) __c11_atomic_fetch_add((_Atomic(int)*)(addr), delta, __ATOMIC_ACQ_REL)
-#    else
-#      define NCNN_XADD(addr, delta) __atomic_fetch_add((_Atomic(int)*)(addr), delta, 4)
-#    endif
-#  else
-#    if defined __ATOMIC_ACQ_REL && !defined __clang__
-// version for gcc >= 4.7
-#      define NCNN_XADD(addr, delta) (int)__atomic_fetch_add((unsigned*)(addr), (unsigned)(delta), __ATOMIC_ACQ_REL)
-#    else
-#      define NCNN_XADD(addr, delta) (int)__sync_fetch_and_add((unsigned*)(addr), (unsigned)(delta))
-#    endif
-#  endif
-#elif defined _MSC_VER && !defined RC_INVOKED
-#  include <intrin.h>
-#  define NCNN_XADD(addr, delta) (int)_InterlockedExchangeAdd((long volatile*)addr, delta)
-#else
-static inline void NCNN_XADD(int* addr, int delta) { int tmp = *addr; *addr += delta; return tmp; }
-#endif
-
-inline Mat::Mat()
-    : data(0), refcount(0), elemsize(0), dims(0), w(0), h(0), c(0), cstep(0)
+inline Mat::Mat(int _w, size_t _elemsize, Allocator* _allocator)
+    : data(0), refcount(0), dims(0)
 {
+    create(_w, _elemsize, _allocator);
 }
 
-inline Mat::Mat(int _w, size_t _elemsize)
+inline Mat::Mat(int _w, int _h, size_t _elemsize, Allocator* _allocator)
     : data(0), refcount(0), dims(0)
 {
-    create(_w, _elemsize);
+    create(_w, _h, _elemsize, _allocator);
 }
 
-inline Mat::Mat(int _w, int _h, size_t _elemsize)
+inline Mat::Mat(int _w, int _h, int _c, size_t _elemsize, Allocator* _allocator)
     : data(0), refcount(0), dims(0)
 {
-    create(_w, _h, _elemsize);
+    create(_w, _h, _c, _elemsize, _allocator);
 }
 
-inline Mat::Mat(int _w, int _h, int _c, size_t _elemsize)
+inline Mat::Mat(int _w, int _h, int _c, size_t _elemsize, int _elempack, Allocator* _allocator)
     : data(0), refcount(0), dims(0)
 {
-    create(_w, _h, _c, _elemsize);
+    create(_w, _h, _c, _elemsize, _elempack, _allocator);
 }
 
 inline Mat::Mat(const Mat& m)
-    : data(m.data), refcount(m.refcount), elemsize(m.elemsize), dims(m.dims)
+    : data(m.data), refcount(m.refcount), elemsize(m.elemsize), elempack(m.elempack), allocator(m.allocator), dims(m.dims)
 {
     if (refcount)
         NCNN_XADD(refcount, 1);
@@ -269,8 +232,8 @@ inline Mat::Mat(const Mat& m)
     cstep = m.cstep;
 }
 
-inline Mat::Mat(int _w, void* _data, size_t _elemsize)
-    : data(_data), refcount(0), elemsize(_elemsize), dims(1)
+inline Mat::Mat(int _w, void* _data, size_t _elemsize, Allocator* _allocator)
+    : data(_data), refcount(0), elemsize(_elemsize), elempack(1), allocator(_allocator), dims(1)
 {
     w = _w;
     h = 1;
@@ -279,8 +242,8 @@ inline Mat::Mat(int _w, void* _data, size_t _elemsize)
     cstep = w;
 }
 
-inline Mat::Mat(int _w, int _h, void* _data, size_t _elemsize)
-    : data(_data), refcount(0), elemsize(_elemsize), dims(2)
+inline Mat::Mat(int _w, int _h, void* _data, size_t _elemsize, Allocator* _allocator)
+    : data(_data), refcount(0), elemsize(_elemsize), elempack(1), allocator(_allocator), dims(2)
 {
     w = _w;
     h = _h;
@@ -289,8 +252,18 @@ inline Mat::Mat(int _w, int _h, void* _data, size_t _elemsize)
     cstep = w * h;
 }
 
-inline Mat::Mat(int _w, int _h, int _c, void* _data, size_t _elemsize)
-    : data(_data), refcount(0), elemsize(_elemsize), dims(3)
+inline Mat::Mat(int _w, int _h, int _c, void* _data, size_t _elemsize, Allocator* _allocator)
+    : data(_data), refcount(0), elemsize(_elemsize), elempack(1), allocator(_allocator), dims(3)
+{
+    w = _w;
+    h = _h;
+    c = _c;
+
+    cstep = alignSize(w * h * elemsize, 16) / elemsize;
+}
+
+inline Mat::Mat(int _w, int _h, int _c, void* _data, size_t _elemsize, int _elempack, Allocator* _allocator)
+    : data(_data), refcount(0), elemsize(_elemsize), elempack(_elempack), allocator(_allocator), dims(3)
 {
     w = _w;
     h = _h;
@@ -317,6 +290,8 @@ inline Mat& Mat::operator=(const Mat& m)
     data = m.data;
     refcount = m.refcount;
     elemsize = m.elemsize;
+    elempack = m.elempack;
+    allocator = m.allocator;
 
     dims = m.dims;
     w = m.w;
@@ -383,18 +358,20 @@ inline void Mat::fill(T _v)
     }
 }
 
-inline Mat Mat::clone() const
+inline Mat Mat::clone(Allocator* allocator) const
 {
     if (empty())
         return Mat();
 
     Mat m;
     if (dims == 1)
-        m.create(w, elemsize);
+        m.create(w, elemsize, allocator);
     else if (dims == 2)
-        m.create(w, h, elemsize);
+        m.create(w, h, elemsize, allocator);
     else if (dims == 3)
-        m.create(w, h, c, elemsize);
+        m.create(w, h, c, elemsize, elempack, allocator);
+
+    m.elempack = elempack;
 
     if (total() > 0)
     {
@@ -404,7 +381,7 @@ inline Mat Mat::clone() const
     return m;
 }
 
-inline Mat Mat::reshape(int _w) const
+inline Mat Mat::reshape(int _w, Allocator* allocator) const
 {
     if (w * h * c != _w)
         return Mat();
@@ -412,7 +389,7 @@ inline Mat Mat::reshape(int _w) const
     if (dims == 3 && cstep != (size_t)w * h)
     {
         Mat m;
-        m.create(_w, elemsize);
+        m.create(_w, elemsize, allocator);
 
         // flatten
         for (int i=0; i<c; i++)
@@ -437,7 +414,7 @@ inline Mat Mat::reshape(int _w) const
     return m;
 }
 
-inline Mat Mat::reshape(int _w, int _h) const
+inline Mat Mat::reshape(int _w, int _h, Allocator* allocator) const
 {
     if (w * h * c != _w * _h)
         return Mat();
@@ -445,7 +422,7 @@ inline Mat Mat::reshape(int _w, int _h) const
     if (dims == 3 && cstep != (size_t)w * h)
     {
         Mat m;
-        m.create(_w, _h, elemsize);
+        m.create(_w, _h, elemsize, allocator);
 
         // flatten
         for (int i=0; i<c; i++)
@@ -470,7 +447,7 @@ inline Mat Mat::reshape(int _w, int _h) const
     return m;
 }
 
-inline Mat Mat::reshape(int _w, int _h, int _c) const
+inline Mat Mat::reshape(int _w, int _h, int _c, Allocator* allocator) const
 {
     if (w * h * c != _w * _h * _c)
         return Mat();
@@ -480,7 +457,7 @@ inline Mat Mat::reshape(int _w, int _h, int _c) const
         if ((size_t)_w * _h != alignSize(_w * _h * elemsize, 16) / elemsize)
         {
             Mat m;
-            m.create(_w, _h, _c, elemsize);
+            m.create(_w, _h, _c, elemsize, allocator);
 
             // align channel
             for (int i=0; i<_c; i++)
@@ -496,8 +473,8 @@ inline Mat Mat::reshape(int _w, int _h, int _c) const
     else if (c != _c)
     {
         // flatten and then align
-        Mat tmp = reshape(_w * _h * _c);
-        return tmp.reshape(_w, _h, _c);
+        Mat tmp = reshape(_w * _h * _c, allocator);
+        return tmp.reshape(_w, _h, _c, allocator);
     }
 
     Mat m = *this;
@@ -512,14 +489,28 @@ inline Mat Mat::reshape(int _w, int _h, int _c) const
     return m;
 }
 
-inline void Mat::create(int _w, size_t _elemsize)
+inline Mat Mat::shape() const
+{
+    if (dims == 1)
+        return Mat(w, (void*)0, elemsize);
+    if (dims == 2)
+        return Mat(w, h, (void*)0, elemsize);
+    if (dims == 3)
+        return Mat(w, h, c, (void*)0, elemsize);
+
+    return Mat();
+}
+
+inline void Mat::create(int _w, size_t _elemsize, Allocator* _allocator)
 {
-    if (dims == 1 && w == _w && elemsize == _elemsize)
+    if (dims == 1 && w == _w && elemsize == _elemsize && elempack == 1 && allocator == _allocator)
         return;
 
     release();
 
     elemsize = _elemsize;
+    elempack = 1;
+    allocator = _allocator;
 
     dims = 1;
     w = _w;
@@ -531,20 +522,25 @@ inline void Mat::create(int _w, size_t _elemsize)
     if (total() > 0)
     {
         size_t totalsize = total() * elemsize;
-        data = fastMalloc(totalsize + (int)sizeof(*refcount));
+        if (allocator)
+            data = allocator->fastMalloc(totalsize + (int)sizeof(*refcount));
+        else
+            data = fastMalloc(totalsize + (int)sizeof(*refcount));
         refcount = (int*)(((unsigned char*)data) + totalsize);
         *refcount = 1;
     }
 }
 
-inline void Mat::create(int _w, int _h, size_t _elemsize)
+inline void Mat::create(int _w, int _h, size_t _elemsize, Allocator* _allocator)
 {
-    if (dims == 2 && w == _w && h == _h && elemsize == _elemsize)
+    if (dims == 2 && w == _w && h == _h && elemsize == _elemsize && elempack == 1 && allocator == _allocator)
         return;
 
     release();
 
     elemsize = _elemsize;
+    elempack = 1;
+    allocator = _allocator;
 
     dims = 2;
     w = _w;
@@ -556,20 +552,30 @@ inline void Mat::create(int _w, int _h, size_t _elemsize)
     if (total() > 0)
     {
         size_t totalsize = total() * elemsize;
-        data = fastMalloc(totalsize + (int)sizeof(*refcount));
+        if (allocator)
+            data = allocator->fastMalloc(totalsize + (int)sizeof(*refcount));
+        else
+            data = fastMalloc(totalsize + (int)sizeof(*refcount));
         refcount = (int*)(((unsigned char*)data) + totalsize);
         *refcount = 1;
     }
 }
 
-inline void Mat::create(int _w, int _h, int _c, size_t _elemsize)
+inline void Mat::create(int _w, int _h, int _c, size_t _elemsize, Allocator* _allocator)
+{
+    create(_w, _h, _c, _elemsize, 1, _allocator);
+}
+
+inline void Mat::create(int _w, int _h, int _c, size_t _elemsize, int _elempack, Allocator* _allocator)
 {
-    if (dims == 3 && w == _w && h == _h && c == _c && elemsize == _elemsize)
+    if (dims == 3 && w == _w && h == _h && c == _c && elemsize == _elemsize && elempack == _elempack && allocator == _allocator)
         return;
 
     release();
 
     elemsize = _elemsize;
+    elempack = _elempack;
+    allocator = _allocator;
 
     dims = 3;
     w = _w;
@@ -581,7 +587,10 @@ inline void Mat::create(int _w, int _h, int _c, size_t _elemsize)
     if (total() > 0)
     {
         size_t totalsize = total() * elemsize;
-        data = fastMalloc(totalsize + (int)sizeof(*refcount));
+        if (allocator)
+            data = allocator->fastMalloc(totalsize + (int)sizeof(*refcount));
+        else
+            data = fastMalloc(totalsize + (int)sizeof(*refcount));
         refcount = (int*)(((unsigned char*)data) + totalsize);
         *refcount = 1;
     }
@@ -596,11 +605,17 @@ inline void Mat::addref()
 inline void Mat::release()
 {
     if (refcount && NCNN_XADD(refcount, -1) == 1)
-        fastFree(data);
+    {
+        if (allocator)
+            allocator->fastFree(data);
+        else
+            fastFree(data);
+    }
 
     data = 0;
 
     elemsize = 0;
+    elempack = 0;
 
     dims = 0;
     w = 0;
@@ -624,34 +639,38 @@ inline size_t Mat::total() const
 
 inline Mat Mat::channel(int c)
 {
-    return Mat(w, h, (unsigned char*)data + cstep * c * elemsize, elemsize);
+    Mat m(w, h, (unsigned char*)data + cstep * c * elemsize, elemsize, allocator);
+    m.elempack = elempack;
+    return m;
 }
 
 inline const Mat Mat::channel(int c) const
 {
-    return Mat(w, h, (unsigned char*)data + cstep * c * elemsize, elemsize);
+    Mat m(w, h, (unsigned char*)data + cstep * c * elemsize, elemsize, allocator);
+    m.elempack = elempack;
+    return m;
 }
 
 inline float* Mat::row(int y)
 {
-    return (float*)data + w * y;
+    return (float*)data + w * y * elempack;
 }
 
 inline const float* Mat::row(int y) const
 {
-    return (const float*)data + w * y;
+    return (const float*)data + w * y * elempack;
 }
 
 template <typename T>
 inline T* Mat::row(int y)
 {
-    return (T*)data + w * y;
+    return (T*)data + w * y * elempack;
 }
 
 template <typename T>
 inline const T* Mat::row(int y) const
 {
-    return (const T*)data + w * y;
+    return (const T*)data + w * y * elempack;
 }
 
 template <typename T>
@@ -21,6 +21,17 @@
 
 namespace ncnn {
 
+// the int8 kernels expect weights in [-127, 127] like float2int8 produces
+// -128 would also survive a sign flip unchanged
+static void clamp_int8_weights(signed char* ptr, int size)
+{
+    for (int i=0; i<size; i++)
+    {
+        if (ptr[i] == -128)
+            ptr[i] = -127;
+    }
+}
+
 Mat ModelBin::load(int w, int h, int type) const
 {
     Mat m = load(w * h, type);
@@ -90,6 +101,29 @@ Mat ModelBinFromStdio::load(int w, int type) const
             return Mat::from_float16(float16_weights.data(), w);
         }
 
+        if (flag_struct.tag == 0x000D4B38)
+        {
+            // int8 data
+            Mat m(w, (size_t)1u);
+            if (m.empty())
+                return m;
+
+            int align_data_size = alignSize(w * sizeof(signed char), 4);
+            nread = fread(m, w * sizeof(signed char), 1, binfp);
+            if (nread != 1)
+            {
+                fprintf(stderr, "ModelBin read int8_weights failed %d\n", nread);
+                return Mat();
+            }
+
+            if (align_data_size != w)
+                fseek(binfp, align_data_size - w, SEEK_CUR);
+
+            clamp_int8_weights(m, w);
+
+            return m;
+        }
+
         Mat m(w);
         if (m.empty())
             return m;
@@ -160,8 +194,21 @@ Mat ModelBinFromStdio::load(int w, int type) const
 }
 #endif // NCNN_STDIO
 
-ModelBinFromMemory::ModelBinFromMemory(const unsigned char*& _mem) : mem(_mem)
+ModelBinFromMemory::ModelBinFromMemory(const unsigned char*& _mem) : mem(_mem), mem_end(0)
+{
+}
+
+ModelBinFromMemory::ModelBinFromMemory(const unsigned char*& _mem, const unsigned char* _mem_end) : mem(_mem), mem_end(_mem_end)
+{
+}
+
+bool ModelBinFromMemory::readable(size_t size) const
 {
+    if (!mem_end || (size_t)(mem_end - mem) >= size)
+        return true;
+
+    fprintf(stderr, "ModelBin read past the end of memory\n");
+    return false;
 }
 
 Mat ModelBinFromMemory::load(int w, int type) const
@@ -183,6 +230,9 @@ Mat ModelBinFromMemory::load(int w, int type) const
             unsigned int tag;
         } flag_struct;
 
+        if (!readable(sizeof(flag_struct)))
+            return Mat();
+
         memcpy(&flag_struct, mem, sizeof(flag_struct));
         mem += sizeof(flag_struct);
 
@@ -191,14 +241,47 @@ Mat ModelBinFromMemory::load(int w, int type) const
         if (flag_struct.tag == 0x01306B47)
         {
             // half-precision data
+            if (!readable(alignSize(w * sizeof(unsigned short), 4)))
+                return Mat();
+
             Mat m = Mat::from_float16((unsigned short*)mem, w);
             mem += alignSize(w * sizeof(unsigned short), 4);
             return m;
         }
 
+        if (flag_struct.tag == 0x000D4B38)
+        {
+            // int8 data
+            if (!readable(alignSize(w * sizeof(signed char), 4)))
+                return Mat();
+
+            const signed char* ptr = (const signed char*)mem;
+            Mat m = Mat(w, (void*)mem, (size_t)1u);
+            mem += alignSize(w * sizeof(signed char), 4);
+
+            // the external memory stays untouched, clamp a copy only when needed
+            for (int i=0; i<w; i++)
+            {
+                if (ptr[i] == -128)
+                {
+                    m = m.clone();
+                    if (m.empty())
+                        return m;
+
+                    clamp_int8_weights(m, w);
+                    break;
+                }
+            }
+
+            return m;
+        }
+
         if (flag != 0)
         {
             // quantized data
+            if (!readable(256 * sizeof(float) + alignSize(w * sizeof(unsigned char), 4)))
+                return Mat();
+
             const float* quantization_value = (const float*)mem;
             mem += 256 * sizeof(float);
 
@@ -220,6 +303,9 @@ Mat ModelBinFromMemory::load(int w, int type) const
         else if (flag_struct.f0 == 0)
         {
             // raw data
+            if (!readable(w * sizeof(float)))
+                return Mat();
+
             Mat m = Mat(w, (float*)mem);
             mem += w * sizeof(float);
             return m;
@@ -228,6 +314,9 @@ Mat ModelBinFromMemory::load(int w, int type) const
     else if (type == 1)
     {
         // raw data
+        if (!readable(w * sizeof(float)))
+            return Mat();
+
         Mat m = Mat(w, (float*)mem);
         mem += w * sizeof(float);
         return m;
@@ -30,6 +30,7 @@ public:
     // 1 = float32
     // 2 = float16
     // 3 = uint8
+    // auto may hand back int8 data with elemsize 1
     // load vec
     virtual Mat load(int w, int type) const = 0;
     // load image
@@ -57,11 +58,17 @@ class ModelBinFromMemory : public ModelBin
 public:
     // construct from external memory
     ModelBinFromMemory(const unsigned char*& mem);
+    // construct from external memory ending at mem_end, reading past it fails
+    ModelBinFromMemory(const unsigned char*& mem, const unsigned char* mem_end);
 
     virtual Mat load(int w, int type) const;
 
 protected:
+    // whether size more bytes can be read
+    bool readable(size_t size) const;
+
     const unsigned char*& mem;
+    const unsigned char* mem_end;
 };
 
 class ModelBinFromMatArray : public ModelBin
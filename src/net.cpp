@@ -16,22 +16,38 @@
 #include "layer_type.h"
 #include "modelbin.h"
 #include "paramdict.h"
+#include "threadpool.h"
 
+#include "layer/batchnorm.h"
+#include "layer/bias.h"
+#include "layer/convolution.h"
+#include "layer/convolutiondepthwise.h"
+#include "layer/innerproduct.h"
+#include "layer/relu.h"
+#include "layer/scale.h"
+
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif // _OPENMP
+#if NCNN_STDIO && !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // NCNN_STDIO && !defined(_WIN32)
 
-#if NCNN_BENCHMARK
 #include "benchmark.h"
-#endif // NCNN_BENCHMARK
+#include "profiler.h"
 
 namespace ncnn {
 
 Net::Net()
 {
+    model_mmap_data = 0;
+    model_mmap_size = 0;
+    param_hash = 0;
 }
 
 Net::~Net()
@@ -114,6 +130,8 @@ int Net::load_param(FILE* fp)
     layers.resize(layer_count);
     blobs.resize(blob_count);
 
+    param_hash = 2166136261u;
+
     ParamDict pd;
 
     int layer_index = 0;
@@ -144,6 +162,9 @@ int Net::load_param(FILE* fp)
             return -1;
         }
 
+        layer->typeindex = layer_to_index(layer_type);
+        if (layer->typeindex == -1)
+            layer->typeindex = custom_layer_to_index(layer_type) | LayerType::CustomBit;
         layer->type = std::string(layer_type);
         layer->name = std::string(layer_name);
 //         fprintf(stderr, "new layer %d %s\n", layer_index, layer_name);
@@ -208,6 +229,8 @@ int Net::load_param(FILE* fp)
             continue;
         }
 
+        hash_layer_param(layer, pd);
+
         int lr = layer->load_param(pd);
         if (lr != 0)
         {
@@ -220,7 +243,7 @@ int Net::load_param(FILE* fp)
         layer_index++;
     }
 
-    return 0;
+    return update_execution_plan();
 }
 
 int Net::load_param(const char* protopath)
@@ -259,6 +282,8 @@ int Net::load_param_bin(FILE* fp)
     layers.resize(layer_count);
     blobs.resize(blob_count);
 
+    param_hash = 2166136261u;
+
     ParamDict pd;
 
     for (int i=0; i<layer_count; i++)
@@ -285,6 +310,7 @@ int Net::load_param_bin(FILE* fp)
             return -1;
         }
 
+        layer->typeindex = typeindex;
 //         layer->type = std::string(layer_type);
 //         layer->name = std::string(layer_name);
 //         fprintf(stderr, "new layer %d\n", typeindex);
@@ -326,6 +352,8 @@ int Net::load_param_bin(FILE* fp)
             continue;
         }
 
+        hash_layer_param(layer, pd);
+
         int lr = layer->load_param(pd);
         if (lr != 0)
         {
@@ -336,7 +364,7 @@ int Net::load_param_bin(FILE* fp)
         layers[i] = layer;
     }
 
-    return 0;
+    return update_execution_plan();
 }
 
 int Net::load_param_bin(const char* protopath)
@@ -374,6 +402,12 @@ int Net::load_model(FILE* fp)
         }
     }
 
+    if (ret == 0)
+        ret = create_pipeline();
+
+    if (ret == 0)
+        update_int8_requantize();
+
     return ret;
 }
 
@@ -392,6 +426,440 @@ int Net::load_model(const char* modelpath)
 
     return ret;
 }
+
+int Net::load_model_mmap(const char* modelpath, bool prefault)
+{
+#if defined(_WIN32)
+    (void)prefault;
+    return load_model(modelpath);
+#else
+    // the layers may still reference the previous mapping
+    if (model_mmap_data)
+    {
+        fprintf(stderr, "model already mapped, clear() first\n");
+        return -1;
+    }
+
+    int fd = open(modelpath, O_RDONLY);
+    if (fd == -1)
+    {
+        fprintf(stderr, "open %s failed\n", modelpath);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        fprintf(stderr, "fstat %s failed\n", modelpath);
+        close(fd);
+        return -1;
+    }
+
+    size_t size = st.st_size;
+    void* data = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // the mapping holds its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "mmap %s failed\n", modelpath);
+        return -1;
+    }
+
+    if (prefault)
+    {
+        madvise(data, size, MADV_WILLNEED);
+
+        // touch every page so that the first inference does not fault
+        const long page_size = sysconf(_SC_PAGESIZE);
+        volatile unsigned char sum = 0;
+        for (size_t i=0; i<size; i+=page_size)
+        {
+            sum += ((const unsigned char*)data)[i];
+        }
+        (void)sum;
+    }
+
+    model_mmap_data = data;
+    model_mmap_size = size;
+
+    const unsigned char* mem = (const unsigned char*)data;
+    ModelBinFromMemory mb(mem, mem + size);
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        Layer* layer = layers[i];
+
+        int lret = layer->load_model(mb);
+        if (lret != 0)
+        {
+            fprintf(stderr, "layer load_model %d failed\n", (int)i);
+            return -1;
+        }
+    }
+
+    if (create_pipeline() != 0)
+        return -1;
+
+    update_int8_requantize();
+
+    return 0;
+#endif // defined(_WIN32)
+}
+
+#if !defined(_WIN32)
+// bump when a layer changes what save_prepared hands out
+static const unsigned int prepared_cache_version = 2;
+
+// words of the cache fingerprint
+static const int prepared_fingerprint_size = 11;
+
+// keeps the weights handed to a layer for the prepared model cache
+class ModelBinRecord : public ModelBin
+{
+public:
+    ModelBinRecord(const ModelBin& _mb) : mb(_mb) {}
+
+    virtual Mat load(int w, int type) const
+    {
+        Mat m = mb.load(w, type);
+        weights.push_back(m);
+        return m;
+    }
+
+    const ModelBin& mb;
+    mutable std::vector<Mat> weights;
+};
+#endif // !defined(_WIN32)
+
+int Net::load_model_prepared(const char* modelpath, const char* cachepath)
+{
+#if defined(_WIN32)
+    (void)cachepath;
+    return load_model(modelpath);
+#else
+    struct stat st;
+    if (stat(modelpath, &st) != 0)
+    {
+        fprintf(stderr, "stat %s failed\n", modelpath);
+        return -1;
+    }
+
+    const Option& opt = get_default_option();
+
+    // what the prepared weights depend on
+    unsigned int fingerprint[prepared_fingerprint_size];
+    fingerprint[0] = 0x7072706e;// nprp
+    fingerprint[1] = prepared_cache_version;
+    fingerprint[2] = layer_isa_level();
+    fingerprint[3] = sizeof(void*);
+#if __ARM_NEON
+    fingerprint[3] |= 1 << 8;
+#endif
+#if __aarch64__
+    fingerprint[3] |= 1 << 9;
+#endif
+    fingerprint[4] = opt.use_int8_inference | opt.use_fp16_storage << 1 | opt.use_packing_layout << 2;
+    fingerprint[5] = layers.size();
+    fingerprint[6] = param_hash;
+    fingerprint[7] = (unsigned long long)st.st_size;
+    fingerprint[8] = (unsigned long long)st.st_size >> 32;
+    fingerprint[9] = (unsigned long long)st.st_mtime;
+    fingerprint[10] = (unsigned long long)st.st_mtime >> 32;
+
+    if (load_prepared_cache(cachepath, fingerprint) == 0)
+        return 0;
+
+    FILE* fp = fopen(modelpath, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", modelpath);
+        return -1;
+    }
+
+    std::vector< std::vector<Mat> > model_weights(layers.size());
+
+    ModelBinFromStdio mb(fp);
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        Layer* layer = layers[i];
+
+        ModelBinRecord mbr(mb);
+        int lret = layer->load_model(mbr);
+        if (lret != 0)
+        {
+            fprintf(stderr, "layer load_model %d failed\n", (int)i);
+            fclose(fp);
+            return -1;
+        }
+
+        model_weights[i] = mbr.weights;
+    }
+
+    fclose(fp);
+
+    if (create_pipeline() != 0)
+        return -1;
+
+    update_int8_requantize();
+
+    // the model is loaded, a cache that can not be written only costs the next start
+    save_prepared_cache(cachepath, fingerprint, model_weights);
+
+    return 0;
+#endif // defined(_WIN32)
+}
+
+// cache layout
+// fingerprint           11 x uint32
+// for each layer
+//   typeindex prepared weight_count               3 x int32
+//   for each weight
+//     dims w h c elemsize elempack                6 x int32
+//     data padded to 64 bytes from the file start, total() * elemsize bytes
+int Net::load_prepared_cache(const char* cachepath, const unsigned int* fingerprint)
+{
+#if defined(_WIN32)
+    (void)cachepath;
+    (void)fingerprint;
+    return -1;
+#else
+    // the layers may still reference the previous mapping
+    if (model_mmap_data)
+        return -1;
+
+    int fd = open(cachepath, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)(prepared_fingerprint_size * sizeof(unsigned int)))
+    {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = st.st_size;
+    void* data = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "mmap %s failed\n", cachepath);
+        return -1;
+    }
+
+    const unsigned char* mem = (const unsigned char*)data;
+    const unsigned char* ptr = mem;
+
+    if (memcmp(ptr, fingerprint, prepared_fingerprint_size * sizeof(unsigned int)) != 0)
+    {
+        fprintf(stderr, "prepared model cache %s is stale, rebuilding\n", cachepath);
+        munmap(data, size);
+        return -1;
+    }
+
+    ptr += prepared_fingerprint_size * sizeof(unsigned int);
+
+    // check the whole cache before touching any layer
+    std::vector<int> prepared(layers.size());
+    std::vector< std::vector<Mat> > model_weights(layers.size());
+
+    bool corrupted = false;
+    for (size_t i=0; i<layers.size() && !corrupted; i++)
+    {
+        int layer_header[3];
+        if (mem + size - ptr < (long)sizeof(layer_header))
+        {
+            corrupted = true;
+            break;
+        }
+
+        memcpy(layer_header, ptr, sizeof(layer_header));
+        ptr += sizeof(layer_header);
+
+        if (layer_header[0] != layers[i]->typeindex || layer_header[2] < 0)
+        {
+            corrupted = true;
+            break;
+        }
+
+        prepared[i] = layer_header[1];
+
+        for (int j=0; j<layer_header[2]; j++)
+        {
+            int mat_header[6];
+            if (mem + size - ptr < (long)sizeof(mat_header))
+            {
+                corrupted = true;
+                break;
+            }
+
+            memcpy(mat_header, ptr, sizeof(mat_header));
+            ptr += sizeof(mat_header);
+
+            const int dims = mat_header[0];
+            const int w = mat_header[1];
+            const int h = mat_header[2];
+            const int c = mat_header[3];
+            const size_t elemsize = mat_header[4];
+            const int elempack = mat_header[5];
+
+            if (dims == 0)
+            {
+                model_weights[i].push_back(Mat());
+                continue;
+            }
+
+            if (dims < 0 || dims > 3 || w <= 0 || h <= 0 || c <= 0 || elemsize == 0 || elempack <= 0)
+            {
+                corrupted = true;
+                break;
+            }
+
+            ptr = mem + alignSize(ptr - mem, 64);
+
+            Mat m;
+            if (dims == 1)
+                m = Mat(w, (void*)ptr, elemsize);
+            else if (dims == 2)
+                m = Mat(w, h, (void*)ptr, elemsize);
+            else
+                m = Mat(w, h, c, (void*)ptr, elemsize, elempack);
+
+            m.elempack = elempack;
+
+            const size_t data_size = m.total() * elemsize;
+            if (ptr > mem + size || (size_t)(mem + size - ptr) < data_size)
+            {
+                corrupted = true;
+                break;
+            }
+
+            ptr += data_size;
+
+            model_weights[i].push_back(m);
+        }
+    }
+
+    if (corrupted)
+    {
+        fprintf(stderr, "prepared model cache %s is corrupted, rebuilding\n", cachepath);
+        munmap(data, size);
+        return -1;
+    }
+
+    // the layers reference the mapping from here on
+    model_mmap_data = data;
+    model_mmap_size = size;
+
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        Layer* layer = layers[i];
+
+        // ends the array for a layer asking for more
+        model_weights[i].push_back(Mat());
+
+        ModelBinFromMatArray mb(model_weights[i].data());
+        int lret = prepared[i] ? layer->load_prepared(mb) : layer->load_model(mb);
+        if (lret == 0 && !prepared[i])
+            lret = layer->create_pipeline();
+        if (lret != 0)
+        {
+            fprintf(stderr, "layer load_prepared %d failed, rebuilding\n", (int)i);
+            return -1;
+        }
+    }
+
+    update_int8_requantize();
+
+    return 0;
+#endif // defined(_WIN32)
+}
+
+int Net::save_prepared_cache(const char* cachepath, const unsigned int* fingerprint, const std::vector< std::vector<Mat> >& model_weights) const
+{
+#if defined(_WIN32)
+    (void)cachepath;
+    (void)fingerprint;
+    (void)model_weights;
+    return -1;
+#else
+    // written aside and renamed so that a concurrent load never sees a partial cache
+    char tmppath[1024];
+    snprintf(tmppath, sizeof(tmppath), "%s.%d.tmp", cachepath, (int)getpid());
+
+    FILE* fp = fopen(tmppath, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", tmppath);
+        return -1;
+    }
+
+    static const unsigned char zeros[64] = {0};
+
+    size_t offset = 0;
+    fwrite(fingerprint, sizeof(unsigned int), prepared_fingerprint_size, fp);
+    offset += prepared_fingerprint_size * sizeof(unsigned int);
+
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        const Layer* layer = layers[i];
+
+        std::vector<Mat> weights;
+        int prepared = layer->save_prepared(weights) == 0;
+        if (!prepared)
+            weights = model_weights[i];
+
+        int layer_header[3] = { layer->typeindex, prepared, (int)weights.size() };
+        fwrite(layer_header, sizeof(layer_header), 1, fp);
+        offset += sizeof(layer_header);
+
+        for (size_t j=0; j<weights.size(); j++)
+        {
+            const Mat& m = weights[j];
+
+            int mat_header[6] = { 0, 0, 0, 0, 0, 0 };
+            if (!m.empty())
+            {
+                mat_header[0] = m.dims;
+                mat_header[1] = m.w;
+                mat_header[2] = m.h;
+                mat_header[3] = m.c;
+                mat_header[4] = (int)m.elemsize;
+                mat_header[5] = m.elempack;
+            }
+
+            fwrite(mat_header, sizeof(mat_header), 1, fp);
+            offset += sizeof(mat_header);
+
+            if (m.empty())
+                continue;
+
+            size_t padding = alignSize(offset, 64) - offset;
+            fwrite(zeros, 1, padding, fp);
+            offset += padding;
+
+            size_t data_size = m.total() * m.elemsize;
+            fwrite(m.data, 1, data_size, fp);
+            offset += data_size;
+        }
+    }
+
+    bool failed = ferror(fp) != 0;
+    failed = fclose(fp) != 0 || failed;
+
+    if (failed || rename(tmppath, cachepath) != 0)
+    {
+        fprintf(stderr, "write prepared model cache %s failed\n", cachepath);
+        unlink(tmppath);
+        return -1;
+    }
+
+    return 0;
+#endif // defined(_WIN32)
+}
 #endif // NCNN_STDIO
 
 int Net::load_param(const unsigned char* _mem)
@@ -423,6 +891,8 @@ int Net::load_param(const unsigned char* _mem)
     layers.resize(layer_count);
     blobs.resize(blob_count);
 
+    param_hash = 2166136261u;
+
     ParamDict pd;
 
     for (int i=0; i<layer_count; i++)
@@ -449,6 +919,7 @@ int Net::load_param(const unsigned char* _mem)
             return 0;
         }
 
+        layer->typeindex = typeindex;
 //         layer->type = std::string(layer_type);
 //         layer->name = std::string(layer_name);
 //         fprintf(stderr, "new layer %d\n", typeindex);
@@ -490,6 +961,8 @@ int Net::load_param(const unsigned char* _mem)
             continue;
         }
 
+        hash_layer_param(layer, pd);
+
         int lr = layer->load_param(pd);
         if (lr != 0)
         {
@@ -500,6 +973,9 @@ int Net::load_param(const unsigned char* _mem)
         layers[i] = layer;
     }
 
+    if (update_execution_plan() != 0)
+        return 0;
+
     return mem - _mem;
 }
 
@@ -526,259 +1002,1527 @@ int Net::load_model(const unsigned char* _mem)
         }
     }
 
+    if (create_pipeline() != 0)
+        return -1;
+
+    update_int8_requantize();
+
     return mem - _mem;
 }
 
-void Net::clear()
+static inline unsigned int fnv1a(unsigned int hash, const void* data, size_t size)
 {
-    blobs.clear();
-    for (size_t i=0; i<layers.size(); i++)
+    const unsigned char* ptr = (const unsigned char*)data;
+    for (size_t i=0; i<size; i++)
     {
-        delete layers[i];
+        hash = (hash ^ ptr[i]) * 16777619u;
     }
-    layers.clear();
+
+    return hash;
 }
 
-Extractor Net::create_extractor() const
+void Net::hash_layer_param(const Layer* layer, const ParamDict& pd)
 {
-    return Extractor(this, blobs.size());
-}
+    unsigned int hash = param_hash;
 
+    hash = fnv1a(hash, &layer->typeindex, sizeof(int));
 #if NCNN_STRING
-int Net::find_blob_index_by_name(const char* name) const
-{
-    for (size_t i=0; i<blobs.size(); i++)
+    // the typeindex of a custom layer depends on the registration order
+    hash = fnv1a(hash, layer->type.data(), layer->type.size());
+#endif // NCNN_STRING
+    if (!layer->bottoms.empty())
+        hash = fnv1a(hash, &layer->bottoms[0], layer->bottoms.size() * sizeof(int));
+    if (!layer->tops.empty())
+        hash = fnv1a(hash, &layer->tops[0], layer->tops.size() * sizeof(int));
+
+    for (int i=0; i<NCNN_MAX_PARAM_COUNT; i++)
     {
-        const Blob& blob = blobs[i];
-        if (blob.name == name)
-        {
-            return i;
-        }
+        if (!pd.params[i].loaded)
+            continue;
+
+        hash = fnv1a(hash, &i, sizeof(int));
+
+        // the scalar is left over from a previous layer when an array is loaded
+        const Mat& v = pd.params[i].v;
+        if (!v.empty())
+            hash = fnv1a(hash, v.data, v.total() * v.elemsize);
+        else
+            hash = fnv1a(hash, &pd.params[i].i, sizeof(int));
     }
 
-    fprintf(stderr, "find_blob_index_by_name %s failed\n", name);
-    return -1;
+    param_hash = hash;
 }
 
-int Net::find_layer_index_by_name(const char* name) const
+void Net::clear()
 {
+    blobs.clear();
     for (size_t i=0; i<layers.size(); i++)
     {
-        const Layer* layer = layers[i];
+        delete layers[i];
+    }
+    layers.clear();
+
+    execution_plan.clear();
+    execution_position.clear();
+    blob_shapes.clear();
+
+#if NCNN_STDIO && !defined(_WIN32)
+    // the layers referencing the mapping are gone
+    if (model_mmap_data)
+    {
+        munmap(model_mmap_data, model_mmap_size);
+        model_mmap_data = 0;
+        model_mmap_size = 0;
+    }
+#endif // NCNN_STDIO && !defined(_WIN32)
+}
+
+#if NCNN_STRING
+int Net::infer_shape(const char* blob_name, const Mat& shape)
+{
+    int blob_index = find_blob_index_by_name(blob_name);
+    if (blob_index == -1)
+        return -1;
+
+    return infer_shape(std::vector<int>(1, blob_index), std::vector<Mat>(1, shape));
+}
+
+Mat Net::get_blob_shape(const char* blob_name) const
+{
+    int blob_index = find_blob_index_by_name(blob_name);
+    if (blob_index == -1)
+        return Mat();
+
+    return get_blob_shape(blob_index);
+}
+#endif // NCNN_STRING
+
+int Net::infer_shape(const std::vector<int>& blob_indexes, const std::vector<Mat>& shapes)
+{
+    if (blob_indexes.size() != shapes.size())
+        return -1;
+
+    blob_shapes.clear();
+    blob_shapes.resize(blobs.size());
+
+    for (size_t i=0; i<blob_indexes.size(); i++)
+    {
+        int blob_index = blob_indexes[i];
+        if (blob_index < 0 || blob_index >= (int)blobs.size())
+            return -1;
+
+        blob_shapes[blob_index] = shapes[i].shape();
+    }
+
+    for (size_t i=0; i<execution_plan.size(); i++)
+    {
+        Layer* layer = layers[execution_plan[i]];
+
+        layer->bottom_shapes.clear();
+        layer->top_shapes.clear();
+
+        std::vector<Mat> bottom_shapes(layer->bottoms.size());
+        bool known = true;
+        for (size_t j=0; j<layer->bottoms.size(); j++)
+        {
+            bottom_shapes[j] = blob_shapes[layer->bottoms[j]];
+            if (bottom_shapes[j].dims == 0)
+                known = false;
+        }
+
+        // shape stays unknown downstream
+        if (!known)
+            continue;
+
+        std::vector<Mat> top_shapes(layer->tops.size());
+
+        // input layer takes the fed shape
+        bool fed = layer->bottoms.empty();
+        for (size_t j=0; j<layer->tops.size() && fed; j++)
+        {
+            top_shapes[j] = blob_shapes[layer->tops[j]];
+            if (top_shapes[j].dims == 0)
+                fed = false;
+        }
+
+        if (!fed)
+        {
+            known = layer->infer_shape(bottom_shapes, top_shapes) == 0;
+        }
+
+        layer->bottom_shapes = bottom_shapes;
+
+        if (!known)
+            continue;
+
+        layer->top_shapes = top_shapes;
+
+        for (size_t j=0; j<layer->tops.size(); j++)
+        {
+            blob_shapes[layer->tops[j]] = top_shapes[j];
+        }
+    }
+
+    return 0;
+}
+
+Mat Net::get_blob_shape(int blob_index) const
+{
+    if (blob_index < 0 || blob_index >= (int)blob_shapes.size())
+        return Mat();
+
+    return blob_shapes[blob_index];
+}
+
+// fold y = b * x + a into the weight and bias of op, b and a may be null
+// return 0 if success, op is left untouched otherwise
+template<typename T>
+static int fold_affine(T* op, const float* b, const float* a)
+{
+    // the layer may have dropped its float weights for the kernels
+    int ret = op->destroy_pipeline();
+    if (ret != 0)
+        return ret;
+
+    const int num_output = op->num_output;
+    const int size = op->weight_data_size / num_output;
+
+    // the weights may come from external memory
+    Mat weight_data = op->use_int8_inference ? op->weight_data_int8.clone() : op->weight_data.clone();
+    Mat weight_data_int8_scales = op->weight_data_int8_scales.clone();
+    Mat bias_data(num_output);
+
+    for (int p=0; p<num_output; p++)
+    {
+        float bias = op->bias_term ? op->bias_data[p] : 0.f;
+
+        if (b && op->use_int8_inference)
+        {
+            // int8 weights fold into their scale, only the sign flips
+            signed char* ptr = (signed char*)weight_data + size * p;
+
+            for (int i=0; i<size; i++)
+            {
+                ptr[i] = b[p] == 0.f ? 0 : b[p] < 0.f ? -ptr[i] : ptr[i];
+            }
+
+            if (b[p] != 0.f)
+                weight_data_int8_scales[p] /= fabs(b[p]);
+
+            bias *= b[p];
+        }
+        else if (b)
+        {
+            float* ptr = (float*)weight_data + size * p;
+
+            for (int i=0; i<size; i++)
+            {
+                ptr[i] *= b[p];
+            }
+
+            // the calibrated weight range scales along
+            if (op->int8_scale_term && b[p] != 0.f)
+                weight_data_int8_scales[p] /= fabs(b[p]);
+
+            bias *= b[p];
+        }
+
+        if (a)
+            bias += a[p];
+
+        bias_data[p] = bias;
+    }
+
+    if (op->use_int8_inference)
+        op->weight_data_int8 = weight_data;
+    else
+        op->weight_data = weight_data;
+    op->weight_data_int8_scales = weight_data_int8_scales;
+    op->bias_data = bias_data;
+    op->bias_term = 1;
+
+    return 0;
+}
+
+// absorb the layer following op
+// return 0 if next has been folded into op
+template<typename T>
+static int fuse_layer(T* op, const Layer* next)
+{
+    // nothing folds through an activation
+    if (op->activation_type != 0)
+        return -1;
+
+    const int num_output = op->num_output;
+
+    if (next->typeindex == LayerType::BatchNorm)
+    {
+        const BatchNorm* batchnorm = (const BatchNorm*)next;
+        if (batchnorm->channels != num_output)
+            return -1;
+
+        return fold_affine(op, batchnorm->b_data, batchnorm->a_data);
+    }
+
+    if (next->typeindex == LayerType::Scale)
+    {
+        const Scale* scale = (const Scale*)next;
+        if (scale->scale_data_size != num_output)
+            return -1;
+
+        return fold_affine(op, scale->scale_data, scale->bias_term ? (const float*)scale->bias_data : 0);
+    }
+
+    if (next->typeindex == LayerType::Bias)
+    {
+        const Bias* bias = (const Bias*)next;
+        if (bias->bias_data_size != num_output)
+            return -1;
+
+        return fold_affine(op, 0, bias->bias_data);
+    }
+
+    if (next->typeindex == LayerType::ReLU)
+    {
+        const ReLU* relu = (const ReLU*)next;
+        if (relu->slope == 0.f)
+        {
+            op->activation_type = 1;
+        }
+        else
+        {
+            op->activation_type = 2;
+            op->activation_params = Mat(1);
+            op->activation_params[0] = relu->slope;
+        }
+        return 0;
+    }
+
+    return -1;
+}
+
+template<typename T>
+static int reload_weights(T* op)
+{
+    // a layer that only took over an activation still has its float weights dropped
+    int ret = op->destroy_pipeline();
+    if (ret != 0)
+        return ret;
+
+    // in the order load_model reads them, int8 layers take their int8 weights back
+    std::vector<Mat> weights;
+    weights.push_back(op->use_int8_inference ? op->weight_data_int8 : op->weight_data);
+    if (op->bias_term)
+        weights.push_back(op->bias_data);
+    if (op->int8_scale_term)
+    {
+        Mat bottom_blob_int8_scales(1);
+        bottom_blob_int8_scales[0] = op->bottom_blob_int8_scale;
+
+        weights.push_back(op->weight_data_int8_scales);
+        weights.push_back(bottom_blob_int8_scales);
+    }
+
+    ret = op->load_model(ModelBinFromMatArray(&weights[0]));
+    if (ret != 0)
+        return ret;
+
+    return op->create_pipeline();
+}
+
+namespace {
+
+// one layer
+struct create_pipeline_task : public ParallelTask
+{
+    create_pipeline_task(const std::vector<Layer*>& _layers, std::vector<int>& _rets)
+        : layers(_layers), rets(_rets)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    const std::vector<Layer*>& layers;
+    std::vector<int>& rets;
+};
+
+void create_pipeline_task::execute(int i) const
+{
+    rets[i] = layers[i]->create_pipeline();
+    if (rets[i] != 0)
+        fprintf(stderr, "layer create_pipeline %d failed\n", i);
+}
+
+} // namespace
+
+int Net::create_pipeline()
+{
+    const int layer_count = layers.size();
+    const Option& opt = get_default_option();
+
+    // the weight transforms dominate loading and the layers do not depend on each other
+    std::vector<int> rets(layer_count, 0);
+    create_pipeline_task task(layers, rets);
+
+    parallel_for(task, layer_count, opt);
+
+    for (int i=0; i<layer_count; i++)
+    {
+        if (rets[i] != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+int Net::update_int8_requantize()
+{
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        Layer* layer = layers[i];
+
+        if (layer->typeindex == LayerType::Convolution)
+            ((Convolution*)layer)->use_int8_requantize = false;
+        else if (layer->typeindex == LayerType::ConvolutionDepthWise)
+            ((ConvolutionDepthWise*)layer)->use_int8_requantize = false;
+    }
+
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        Layer* layer = layers[i];
+
+        bool* use_int8_requantize = 0;
+        float* top_blob_int8_scale = 0;
+        if (layer->typeindex == LayerType::Convolution && ((Convolution*)layer)->use_int8_inference)
+        {
+            use_int8_requantize = &((Convolution*)layer)->use_int8_requantize;
+            top_blob_int8_scale = &((Convolution*)layer)->top_blob_int8_scale;
+        }
+        else if (layer->typeindex == LayerType::ConvolutionDepthWise && ((ConvolutionDepthWise*)layer)->use_int8_inference)
+        {
+            use_int8_requantize = &((ConvolutionDepthWise*)layer)->use_int8_requantize;
+            top_blob_int8_scale = &((ConvolutionDepthWise*)layer)->top_blob_int8_scale;
+        }
+
+        if (!use_int8_requantize || layer->tops.size() != 1)
+            continue;
+
+        const Blob& blob = blobs[layer->tops[0]];
+        if (blob.consumers.size() != 1)
+            continue;
+
+        // the only consumer quantizes its input again, hand it int8 right away
+        const Layer* next = layers[blob.consumers[0]];
+        if (next->typeindex == LayerType::Convolution && ((const Convolution*)next)->use_int8_inference)
+        {
+            *use_int8_requantize = true;
+            *top_blob_int8_scale = ((const Convolution*)next)->bottom_blob_int8_scale;
+        }
+        else if (next->typeindex == LayerType::ConvolutionDepthWise && ((const ConvolutionDepthWise*)next)->use_int8_inference)
+        {
+            *use_int8_requantize = true;
+            *top_blob_int8_scale = ((const ConvolutionDepthWise*)next)->bottom_blob_int8_scale;
+        }
+    }
+
+    return 0;
+}
+
+int Net::convert_output_blob(int blob_index, Mat& feat, const Option& opt) const
+{
+    // int8 from a requantizing layer, scaled for its consumer
+    if (feat.elemsize == 1u && blobs[blob_index].producer != -1)
+    {
+        const Layer* layer = layers[blobs[blob_index].producer];
+
+        float top_blob_int8_scale = 0.f;
+        if (layer->typeindex == LayerType::Convolution && ((const Convolution*)layer)->use_int8_requantize)
+            top_blob_int8_scale = ((const Convolution*)layer)->top_blob_int8_scale;
+        else if (layer->typeindex == LayerType::ConvolutionDepthWise && ((const ConvolutionDepthWise*)layer)->use_int8_requantize)
+            top_blob_int8_scale = ((const ConvolutionDepthWise*)layer)->top_blob_int8_scale;
+        else
+            return 0;
+
+        const float scale = top_blob_int8_scale == 0.f ? 0.f : 1.f / top_blob_int8_scale;
+
+        Mat feat_fp32(feat.w, feat.h, feat.c, 4u, opt.blob_allocator);
+        if (feat_fp32.empty())
+            return -100;
+
+        const int size = feat.w * feat.h;
+        for (int q=0; q<feat.c; q++)
+        {
+            const signed char* ptr = feat.channel(q);
+            float* outptr = feat_fp32.channel(q);
+
+            for (int i=0; i<size; i++)
+            {
+                outptr[i] = ptr[i] * scale;
+            }
+        }
+
+        feat = feat_fp32;
+    }
+
+    // hand out the plain layout
+    if (feat.elempack != 1 && feat.dims == 3)
+    {
+        Mat feat_unpacked;
+        convert_packing(feat, feat_unpacked, 1, opt.blob_allocator);
+        if (feat_unpacked.empty())
+            return -100;
+
+        feat = feat_unpacked;
+    }
+
+    return 0;
+}
+
+int Net::fuse_network()
+{
+    int fused_count = 0;
+
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        Layer* layer = layers[i];
+        if (!layer)
+            continue;
+
+        const int typeindex = layer->typeindex;
+        if (typeindex != LayerType::Convolution && typeindex != LayerType::ConvolutionDepthWise && typeindex != LayerType::InnerProduct)
+            continue;
+
+        if (layer->tops.size() != 1)
+            continue;
+
+        bool fused = false;
+        for (;;)
+        {
+            int top_blob_index = layer->tops[0];
+            Blob& blob = blobs[top_blob_index];
+            if (blob.consumers.size() != 1)
+                break;
+
+            int next_index = blob.consumers[0];
+            Layer* next = layers[next_index];
+            if (!next || next->bottoms.size() != 1 || next->tops.size() != 1 || next->tops[0] == top_blob_index)
+                break;
+
+            int ret = -1;
+            if (typeindex == LayerType::Convolution)
+                ret = fuse_layer((Convolution*)layer, next);
+            else if (typeindex == LayerType::ConvolutionDepthWise)
+                ret = fuse_layer((ConvolutionDepthWise*)layer, next);
+            else if (typeindex == LayerType::InnerProduct)
+                ret = fuse_layer((InnerProduct*)layer, next);
+            if (ret != 0)
+                break;
+
+            // take over the output of the absorbed layer
+            int next_top_blob_index = next->tops[0];
+            layer->tops[0] = next_top_blob_index;
+            blobs[next_top_blob_index].producer = i;
+
+            blob.producer = -1;
+            blob.consumers.clear();
+
+            delete next;
+            layers[next_index] = 0;
+
+            fused = true;
+            fused_count++;
+        }
+
+        if (!fused)
+            continue;
+
+        // let the layer rebuild whatever it derives from the weights
+        int ret = 0;
+        if (typeindex == LayerType::Convolution)
+            ret = reload_weights((Convolution*)layer);
+        else if (typeindex == LayerType::ConvolutionDepthWise)
+            ret = reload_weights((ConvolutionDepthWise*)layer);
+        else if (typeindex == LayerType::InnerProduct)
+            ret = reload_weights((InnerProduct*)layer);
+        if (ret != 0)
+        {
+            fprintf(stderr, "layer %d reload weights failed\n", (int)i);
+            return -1;
+        }
+    }
+
+    if (fused_count == 0)
+        return 0;
+
+    // drop the absorbed layers and renumber the rest
+    std::vector<int> layer_index_map(layers.size(), -1);
+    int layer_count = 0;
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        if (!layers[i])
+            continue;
+
+        layer_index_map[i] = layer_count;
+        layers[layer_count] = layers[i];
+        layer_count++;
+    }
+    layers.resize(layer_count);
+
+    for (size_t i=0; i<blobs.size(); i++)
+    {
+        Blob& blob = blobs[i];
+        if (blob.producer != -1)
+            blob.producer = layer_index_map[blob.producer];
+
+        for (size_t j=0; j<blob.consumers.size(); j++)
+        {
+            blob.consumers[j] = layer_index_map[blob.consumers[j]];
+        }
+    }
+
+    blob_shapes.clear();
+
+    update_int8_requantize();
+
+    return update_execution_plan();
+}
+
+Extractor Net::create_extractor() const
+{
+    return Extractor(this, blobs.size());
+}
+
+BatchExtractor Net::create_batch_extractor(int batch_size) const
+{
+    return BatchExtractor(this, blobs.size(), batch_size);
+}
+
+#if NCNN_STRING
+int Net::find_blob_index_by_name(const char* name) const
+{
+    for (size_t i=0; i<blobs.size(); i++)
+    {
+        const Blob& blob = blobs[i];
+        if (blob.name == name)
+        {
+            return i;
+        }
+    }
+
+    fprintf(stderr, "find_blob_index_by_name %s failed\n", name);
+    return -1;
+}
+
+int Net::find_layer_index_by_name(const char* name) const
+{
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        const Layer* layer = layers[i];
         if (layer->name == name)
         {
-            return i;
+            return i;
+        }
+    }
+
+    fprintf(stderr, "find_layer_index_by_name %s failed\n", name);
+    return -1;
+}
+
+int Net::custom_layer_to_index(const char* type)
+{
+    const int custom_layer_registry_entry_count = custom_layer_registry.size();
+    for (int i=0; i<custom_layer_registry_entry_count; i++)
+    {
+        if (strcmp(type, custom_layer_registry[i].name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+Layer* Net::create_custom_layer(const char* type)
+{
+    int index = custom_layer_to_index(type);
+    if (index == -1)
+        return 0;
+
+    return create_custom_layer(index);
+}
+#endif // NCNN_STRING
+
+Layer* Net::create_custom_layer(int index)
+{
+    const int custom_layer_registry_entry_count = custom_layer_registry.size();
+    if (index < 0 || index >= custom_layer_registry_entry_count)
+        return 0;
+
+    layer_creator_func layer_creator = custom_layer_registry[index].creator;
+    if (!layer_creator)
+        return 0;
+
+    return layer_creator();
+}
+
+int Net::update_execution_plan()
+{
+    const int layer_count = layers.size();
+
+    execution_plan.clear();
+    execution_plan.reserve(layer_count);
+    execution_position.resize(layer_count);
+
+    // depth-first post order starting from the layers whose outputs nobody consumes
+    // this keeps the order in which the recursive forward used to run the layers
+    std::vector<int> roots;
+    for (int i=0; i<layer_count; i++)
+    {
+        const Layer* layer = layers[i];
+        if (!layer)
+            continue;
+
+        bool consumed = false;
+        for (size_t j=0; j<layer->tops.size(); j++)
+        {
+            if (!blobs[layer->tops[j]].consumers.empty())
+            {
+                consumed = true;
+                break;
+            }
+        }
+
+        if (!consumed)
+            roots.push_back(i);
+    }
+    for (int i=0; i<layer_count; i++)
+    {
+        roots.push_back(i);
+    }
+
+    // 0 = new  1 = visiting  2 = done
+    std::vector<int> state(layer_count, 0);
+    std::vector< std::pair<int, int> > stack;
+    for (size_t i=0; i<roots.size(); i++)
+    {
+        int root = roots[i];
+        if (!layers[root] || state[root] != 0)
+            continue;
+
+        state[root] = 1;
+        stack.push_back(std::make_pair(root, 0));
+
+        while (!stack.empty())
+        {
+            int layer_index = stack.back().first;
+            int bottom_index = stack.back().second;
+            const Layer* layer = layers[layer_index];
+
+            if (bottom_index < (int)layer->bottoms.size())
+            {
+                stack.back().second++;
+
+                int producer = blobs[layer->bottoms[bottom_index]].producer;
+                if (producer == -1 || !layers[producer])
+                    continue;
+
+                if (state[producer] == 1)
+                {
+                    fprintf(stderr, "layer %d depends on itself\n", producer);
+                    execution_plan.clear();
+                    execution_position.clear();
+                    return -1;
+                }
+
+                if (state[producer] == 0)
+                {
+                    state[producer] = 1;
+                    stack.push_back(std::make_pair(producer, 0));
+                }
+
+                continue;
+            }
+
+            stack.pop_back();
+
+            state[layer_index] = 2;
+            execution_position[layer_index] = execution_plan.size();
+            execution_plan.push_back(layer_index);
+        }
+    }
+
+    return 0;
+}
+
+int Net::mark_required_layers(int blob_index, const std::vector<Mat>& blob_mats, std::vector<unsigned char>& required, std::vector<int>& blob_uses, int& plan_begin, int& plan_end) const
+{
+    required.assign(layers.size(), 0);
+    blob_uses.assign(blobs.size(), 0);
+    plan_begin = execution_plan.size();
+    plan_end = 0;
+
+    std::vector<int> blob_stack;
+    blob_stack.push_back(blob_index);
+    while (!blob_stack.empty())
+    {
+        int b = blob_stack.back();
+        blob_stack.pop_back();
+
+        if (blob_mats[b].dims != 0)
+            continue;
+
+        int layer_index = blobs[b].producer;
+        if (layer_index == -1)
+        {
+            fprintf(stderr, "blob %d is neither produced nor fed as input\n", b);
+            return -1;
+        }
+
+        if (required[layer_index])
+            continue;
+
+        required[layer_index] = 1;
+
+        int position = execution_position[layer_index];
+        plan_begin = std::min(plan_begin, position);
+        plan_end = std::max(plan_end, position + 1);
+
+        const Layer* layer = layers[layer_index];
+        for (size_t i=0; i<layer->bottoms.size(); i++)
+        {
+            int bottom_blob_index = layer->bottoms[i];
+            blob_uses[bottom_blob_index]++;
+            blob_stack.push_back(bottom_blob_index);
+        }
+    }
+
+    return 0;
+}
+
+int Net::forward_blob(int blob_index, std::vector<Mat>& blob_mats, Option& opt) const
+{
+    std::vector<unsigned char> required;
+    std::vector<int> blob_uses;
+    int plan_begin;
+    int plan_end;
+    int ret = mark_required_layers(blob_index, blob_mats, required, blob_uses, plan_begin, plan_end);
+    if (ret != 0)
+        return ret;
+
+    if (opt.use_branch_parallel && opt.num_threads > 1)
+        return forward_branch_parallel(required, plan_begin, plan_end, blob_mats, blob_uses, opt);
+
+    // bottom and top lists reused by all multi-blob layers
+    std::vector<Mat> bottom_blobs;
+    std::vector<Mat> top_blobs;
+
+    for (int i=plan_begin; i<plan_end; i++)
+    {
+        int layer_index = execution_plan[i];
+        if (!required[layer_index])
+            continue;
+
+        ret = forward_layer(layer_index, blob_mats, blob_uses, bottom_blobs, top_blobs, opt);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+int Net::forward_layer(int layer_index, std::vector<Mat>& blob_mats, std::vector<int>& blob_uses, std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, Option& opt) const
+{
+    const Layer* layer = layers[layer_index];
+
+//     fprintf(stderr, "forward_layer %d %s\n", layer_index, layer->name.c_str());
+
+    if (layer->one_blob_only)
+    {
+        // load bottom blob
+        int bottom_blob_index = layer->bottoms[0];
+        int top_blob_index = layer->tops[0];
+
+        Mat bottom_blob = blob_mats[bottom_blob_index];
+
+        if (opt.lightmode)
+        {
+            // delete after taken by the last consumer in light mode
+            if (--blob_uses[bottom_blob_index] == 0)
+                blob_mats[bottom_blob_index].release();
+        }
+
+        if (convert_bottom_packing(layer, &bottom_blob, 1, opt) != 0)
+            return -100;
+
+        if (opt.lightmode)
+        {
+            // deep copy for inplace forward if data is shared
+            if (layer->support_inplace && *bottom_blob.refcount != 1)
+            {
+                bottom_blob = bottom_blob.clone(opt.blob_allocator);
+            }
+        }
+
+        // forward
+        if (opt.lightmode && layer->support_inplace)
+        {
+            Mat& bottom_top_blob = bottom_blob;
+            ProfilerSample sample;
+            if (opt.profiler)
+                opt.profiler->begin_layer(sample);
+#if NCNN_BENCHMARK
+            double start = get_current_time();
+            int ret = layer->forward_inplace(bottom_top_blob, opt);
+            double end = get_current_time();
+            benchmark(layer, bottom_top_blob, bottom_top_blob, start, end);
+#else
+            int ret = layer->forward_inplace(bottom_top_blob, opt);
+#endif // NCNN_BENCHMARK
+            if (opt.profiler && ret == 0)
+                opt.profiler->end_layer(sample, layer, &bottom_top_blob, 1, &bottom_top_blob, 1);
+            if (ret != 0)
+                return ret;
+
+            // store top blob
+            blob_mats[top_blob_index] = bottom_top_blob;
+        }
+        else
+        {
+            Mat top_blob;
+            ProfilerSample sample;
+            if (opt.profiler)
+                opt.profiler->begin_layer(sample);
+#if NCNN_BENCHMARK
+            double start = get_current_time();
+            int ret = layer->forward(bottom_blob, top_blob, opt);
+            double end = get_current_time();
+            benchmark(layer, bottom_blob, top_blob, start, end);
+#else
+            int ret = layer->forward(bottom_blob, top_blob, opt);
+#endif // NCNN_BENCHMARK
+            if (opt.profiler && ret == 0)
+                opt.profiler->end_layer(sample, layer, &bottom_blob, 1, &top_blob, 1);
+            if (ret != 0)
+                return ret;
+
+            // store top blob
+            blob_mats[top_blob_index] = top_blob;
+        }
+
+    }
+    else
+    {
+        // load bottom blobs
+        take_bottom_blobs(layer, blob_mats, blob_uses, bottom_blobs, opt);
+        if (prepare_bottom_blobs(layer, bottom_blobs, opt) != 0)
+        {
+            bottom_blobs.clear();
+            return -100;
+        }
+
+        // forward
+        if (opt.lightmode && layer->support_inplace)
+        {
+            std::vector<Mat>& bottom_top_blobs = bottom_blobs;
+            ProfilerSample sample;
+            if (opt.profiler)
+                opt.profiler->begin_layer(sample);
+#if NCNN_BENCHMARK
+            double start = get_current_time();
+            int ret = layer->forward_inplace(bottom_top_blobs, opt);
+            double end = get_current_time();
+            benchmark(layer, start, end);
+#else
+            int ret = layer->forward_inplace(bottom_top_blobs, opt);
+#endif // NCNN_BENCHMARK
+            if (opt.profiler && ret == 0)
+                opt.profiler->end_layer(sample, layer, bottom_top_blobs.data(), (int)bottom_top_blobs.size(), bottom_top_blobs.data(), (int)bottom_top_blobs.size());
+            if (ret != 0)
+            {
+                bottom_blobs.clear();
+                return ret;
+            }
+
+            // store top blobs
+            for (size_t i=0; i<layer->tops.size(); i++)
+            {
+                int top_blob_index = layer->tops[i];
+
+                blob_mats[top_blob_index] = bottom_top_blobs[i];
+            }
+        }
+        else
+        {
+            top_blobs.resize(layer->tops.size());
+            ProfilerSample sample;
+            if (opt.profiler)
+                opt.profiler->begin_layer(sample);
+#if NCNN_BENCHMARK
+            double start = get_current_time();
+            int ret = layer->forward(bottom_blobs, top_blobs, opt);
+            double end = get_current_time();
+            benchmark(layer, start, end);
+#else
+            int ret = layer->forward(bottom_blobs, top_blobs, opt);
+#endif // NCNN_BENCHMARK
+            if (opt.profiler && ret == 0)
+                opt.profiler->end_layer(sample, layer, bottom_blobs.data(), (int)bottom_blobs.size(), top_blobs.data(), (int)top_blobs.size());
+            if (ret != 0)
+            {
+                bottom_blobs.clear();
+                top_blobs.clear();
+                return ret;
+            }
+
+            // store top blobs
+            for (size_t i=0; i<layer->tops.size(); i++)
+            {
+                int top_blob_index = layer->tops[i];
+
+                blob_mats[top_blob_index] = top_blobs[i];
+            }
+        }
+
+        // drop references but keep the capacity for the next layer
+        bottom_blobs.clear();
+        top_blobs.clear();
+    }
+
+//     fprintf(stderr, "forward_layer %d %s done\n", layer_index, layer->name.c_str());
+//     const Mat& blob = blob_mats[layer->tops[0]];
+//     fprintf(stderr, "[%-2d %-16s %-16s]  %d    blobs count = %-3d   size = %-3d x %-3d\n", layer_index, layer->type.c_str(), layer->name.c_str(), layer->tops[0], blob.c, blob.h, blob.w);
+
+    return 0;
+}
+
+namespace {
+
+// shared by all the branches of one forward_branch_parallel call
+struct BranchState
+{
+    const std::vector<unsigned char>* required;
+    std::vector<Mat>* blob_mats;
+    std::vector<int>* blob_uses;
+    // bottoms still to be produced, per layer
+    std::vector<int> pending;
+    // layers ready or running
+    int active;
+    // the first error, the branches stop at it
+    int ret;
+    Option opt;
+    // guards all of the above except opt
+    Mutex lock;
+};
+
+} // namespace
+
+// one ready layer, followed by the layers it makes ready
+struct Net::BranchTask : public ParallelTask
+{
+    BranchTask(const Net* _net, BranchState& _state, const std::vector<int>& _layer_indexes)
+        : net(_net), state(_state), layer_indexes(_layer_indexes)
+    {
+    }
+
+    virtual void execute(int i) const;
+
+    const Net* net;
+    BranchState& state;
+    const std::vector<int>& layer_indexes;
+};
+
+void Net::BranchTask::execute(int i) const
+{
+    int layer_index = layer_indexes[i];
+
+    std::vector<Mat> bottom_blobs;
+    std::vector<Mat> top_blobs;
+    std::vector<int> ready;
+
+    for (;;)
+    {
+        const Layer* layer = net->layers[layer_index];
+
+        Option opt_branch = state.opt;
+
+        state.lock.lock();
+        if (state.ret != 0)
+        {
+            state.lock.unlock();
+            return;
+        }
+        net->take_bottom_blobs(layer, *state.blob_mats, *state.blob_uses, bottom_blobs, state.opt);
+        // the threads are split among the layers ready or running
+        opt_branch.num_threads = std::max(1, state.opt.num_threads / state.active);
+        state.lock.unlock();
+
+        int ret = net->prepare_bottom_blobs(layer, bottom_blobs, opt_branch);
+        if (ret == 0)
+            ret = net->forward_layer_blobs(layer, bottom_blobs, top_blobs, opt_branch);
+
+        ready.clear();
+
+        state.lock.lock();
+        state.active--;
+        if (ret != 0)
+        {
+            if (state.ret == 0)
+                state.ret = ret;
+        }
+        else
+        {
+            // store top blobs and dispatch the consumers whose bottoms are all ready
+            for (size_t j=0; j<layer->tops.size(); j++)
+            {
+                (*state.blob_mats)[layer->tops[j]] = top_blobs[j];
+
+                const Blob& blob = net->blobs[layer->tops[j]];
+                for (size_t k=0; k<blob.consumers.size(); k++)
+                {
+                    int consumer = blob.consumers[k];
+                    if ((*state.required)[consumer] && --state.pending[consumer] == 0)
+                        ready.push_back(consumer);
+                }
+            }
+            state.active += ready.size();
+        }
+        state.lock.unlock();
+
+        bottom_blobs.clear();
+        top_blobs.clear();
+
+        if (ready.empty())
+            return;
+
+        // a chain goes on in this thread
+        if (ready.size() == 1)
+        {
+            layer_index = ready[0];
+            continue;
+        }
+
+        // a fork runs its branches at the same time, an idle thread picks the next one
+        Option opt_fork = state.opt;
+        opt_fork.num_threads = std::min((int)ready.size(), state.opt.num_threads);
+
+        BranchTask task(net, state, ready);
+
+        parallel_for(task, ready.size(), opt_fork);
+        return;
+    }
+}
+
+int Net::forward_branch_parallel(const std::vector<unsigned char>& required, int plan_begin, int plan_end, std::vector<Mat>& blob_mats, std::vector<int>& blob_uses, Option& opt) const
+{
+    const int layer_count = layers.size();
+
+    BranchState state;
+    state.required = &required;
+    state.blob_mats = &blob_mats;
+    state.blob_uses = &blob_uses;
+    state.pending.resize(layer_count, 0);
+    state.ret = 0;
+    state.opt = opt;
+
+    // count bottoms still to be produced
+    std::vector<int> ready;
+    for (int i=plan_begin; i<plan_end; i++)
+    {
+        int layer_index = execution_plan[i];
+        if (!required[layer_index])
+            continue;
+
+        const Layer* layer = layers[layer_index];
+        for (size_t j=0; j<layer->bottoms.size(); j++)
+        {
+            if (blob_mats[layer->bottoms[j]].dims == 0)
+                state.pending[layer_index]++;
+        }
+
+        if (state.pending[layer_index] == 0)
+            ready.push_back(layer_index);
+    }
+
+    state.active = ready.size();
+
+    // every layer is dispatched by the one finishing its last producer
+    Option opt_fork = opt;
+    opt_fork.num_threads = std::min((int)ready.size(), opt.num_threads);
+
+    BranchTask task(this, state, ready);
+
+    parallel_for(task, ready.size(), opt_fork);
+
+    return state.ret;
+}
+
+void Net::take_bottom_blobs(const Layer* layer, std::vector<Mat>& blob_mats, std::vector<int>& blob_uses, std::vector<Mat>& bottom_blobs, const Option& opt) const
+{
+    bottom_blobs.resize(layer->bottoms.size());
+    for (size_t i=0; i<layer->bottoms.size(); i++)
+    {
+        int bottom_blob_index = layer->bottoms[i];
+
+        bottom_blobs[i] = blob_mats[bottom_blob_index];
+
+        if (opt.lightmode)
+        {
+            // delete after taken by the last consumer in light mode
+            if (--blob_uses[bottom_blob_index] == 0)
+                blob_mats[bottom_blob_index].release();
+        }
+    }
+}
+
+int Net::prepare_bottom_blobs(const Layer* layer, std::vector<Mat>& bottom_blobs, const Option& opt) const
+{
+    int ret = convert_bottom_packing(layer, &bottom_blobs[0], bottom_blobs.size(), opt);
+    if (ret != 0)
+        return ret;
+
+    if (opt.lightmode && layer->support_inplace)
+    {
+        for (size_t i=0; i<bottom_blobs.size(); i++)
+        {
+            // deep copy for inplace forward if data is shared
+            if (*bottom_blobs[i].refcount != 1)
+            {
+                bottom_blobs[i] = bottom_blobs[i].clone(opt.blob_allocator);
+            }
         }
     }
 
-    fprintf(stderr, "find_layer_index_by_name %s failed\n", name);
-    return -1;
+    return 0;
 }
 
-int Net::custom_layer_to_index(const char* type)
+int Net::convert_bottom_packing(const Layer* layer, Mat* bottom_blobs, int count, const Option& opt) const
 {
-    const int custom_layer_registry_entry_count = custom_layer_registry.size();
-    for (int i=0; i<custom_layer_registry_entry_count; i++)
+    // packed only when the layer takes it and every bottom fills the packs
+    int elempack = 1;
+    if (opt.use_packing_layout && layer->support_packing)
     {
-        if (strcmp(type, custom_layer_registry[i].name) == 0)
-            return i;
+        elempack = 4;
+        for (int i=0; i<count; i++)
+        {
+            const Mat& m = bottom_blobs[i];
+            if (m.dims != 3 || m.c * m.elempack % 4 != 0)
+                elempack = 1;
+        }
     }
 
-    return -1;
+    for (int i=0; i<count; i++)
+    {
+        if (bottom_blobs[i].elempack == elempack || bottom_blobs[i].dims != 3)
+            continue;
+
+        Mat bottom_blob_packed;
+        convert_packing(bottom_blobs[i], bottom_blob_packed, elempack, opt.blob_allocator);
+        if (bottom_blob_packed.empty())
+            return -100;
+
+        bottom_blobs[i] = bottom_blob_packed;
+    }
+
+    return 0;
 }
 
-Layer* Net::create_custom_layer(const char* type)
+int Net::forward_layer_blobs(const Layer* layer, std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const
 {
-    int index = custom_layer_to_index(type);
-    if (index == -1)
+    if (opt.lightmode && layer->support_inplace)
+    {
+        ProfilerSample sample;
+        if (opt.profiler)
+            opt.profiler->begin_layer(sample);
+#if NCNN_BENCHMARK
+        double start = get_current_time();
+#endif // NCNN_BENCHMARK
+        int ret = layer->one_blob_only ? layer->forward_inplace(bottom_blobs[0], opt) : layer->forward_inplace(bottom_blobs, opt);
+#if NCNN_BENCHMARK
+        double end = get_current_time();
+        benchmark(layer, start, end);
+#endif // NCNN_BENCHMARK
+        if (opt.profiler && ret == 0)
+            opt.profiler->end_layer(sample, layer, bottom_blobs.data(), (int)bottom_blobs.size(), bottom_blobs.data(), (int)bottom_blobs.size());
+        if (ret != 0)
+            return ret;
+
+        top_blobs = bottom_blobs;
         return 0;
+    }
 
-    return create_custom_layer(index);
+    top_blobs.resize(layer->tops.size());
+    ProfilerSample sample;
+    if (opt.profiler)
+        opt.profiler->begin_layer(sample);
+#if NCNN_BENCHMARK
+    double start = get_current_time();
+#endif // NCNN_BENCHMARK
+    int ret = layer->one_blob_only ? layer->forward(bottom_blobs[0], top_blobs[0], opt) : layer->forward(bottom_blobs, top_blobs, opt);
+#if NCNN_BENCHMARK
+    double end = get_current_time();
+    benchmark(layer, start, end);
+#endif // NCNN_BENCHMARK
+    if (opt.profiler && ret == 0)
+        opt.profiler->end_layer(sample, layer, bottom_blobs.data(), (int)bottom_blobs.size(), top_blobs.data(), (int)top_blobs.size());
+
+    return ret;
 }
-#endif // NCNN_STRING
 
-Layer* Net::create_custom_layer(int index)
+int Net::forward_blob_batch(int blob_index, std::vector< std::vector<Mat> >& batch_blob_mats, Option& opt) const
 {
-    const int custom_layer_registry_entry_count = custom_layer_registry.size();
-    if (index < 0 || index >= custom_layer_registry_entry_count)
-        return 0;
+    // all samples run the same layers, mark them on the first one
+    std::vector<unsigned char> required;
+    std::vector<int> blob_uses;
+    int plan_begin;
+    int plan_end;
+    int ret = mark_required_layers(blob_index, batch_blob_mats[0], required, blob_uses, plan_begin, plan_end);
+    if (ret != 0)
+        return ret;
+
+    for (int i=plan_begin; i<plan_end; i++)
+    {
+        int layer_index = execution_plan[i];
+        if (!required[layer_index])
+            continue;
 
-    layer_creator_func layer_creator = custom_layer_registry[index].creator;
-    if (!layer_creator)
-        return 0;
+        ret = forward_layer_batch(layer_index, batch_blob_mats, blob_uses, opt);
+        if (ret != 0)
+            return ret;
+    }
 
-    return layer_creator();
+    return 0;
 }
 
-int Net::forward_layer(int layer_index, std::vector<Mat>& blob_mats, bool lightmode) const
+int Net::forward_layer_batch(int layer_index, std::vector< std::vector<Mat> >& batch_blob_mats, std::vector<int>& blob_uses, Option& opt) const
 {
     const Layer* layer = layers[layer_index];
-
-//     fprintf(stderr, "forward_layer %d %s\n", layer_index, layer->name.c_str());
+    const int batch = batch_blob_mats.size();
 
     if (layer->one_blob_only)
     {
-        // load bottom blob
+        // load bottom blob of each sample
         int bottom_blob_index = layer->bottoms[0];
         int top_blob_index = layer->tops[0];
 
-        if (blob_mats[bottom_blob_index].dims == 0)
+        std::vector<Mat> bottom_blobs(batch);
+        for (int n=0; n<batch; n++)
         {
-            int ret = forward_layer(blobs[bottom_blob_index].producer, blob_mats, lightmode);
-            if (ret != 0)
-                return ret;
+            bottom_blobs[n] = batch_blob_mats[n][bottom_blob_index];
         }
 
-        Mat bottom_blob = blob_mats[bottom_blob_index];
+        if (opt.lightmode)
+        {
+            // delete after taken by the last consumer in light mode
+            if (--blob_uses[bottom_blob_index] == 0)
+            {
+                for (int n=0; n<batch; n++)
+                {
+                    batch_blob_mats[n][bottom_blob_index].release();
+                }
+            }
+        }
 
-        if (lightmode)
+        // the samples share their shape, all of them end up in the same layout
+        if (convert_bottom_packing(layer, &bottom_blobs[0], batch, opt) != 0)
+            return -100;
+
+        if (opt.lightmode)
         {
-            // delete after taken in light mode
-            blob_mats[bottom_blob_index].release();
             // deep copy for inplace forward if data is shared
-            if (layer->support_inplace && *bottom_blob.refcount != 1)
+            if (layer->support_inplace)
             {
-                bottom_blob = bottom_blob.clone();
+                for (int n=0; n<batch; n++)
+                {
+                    if (*bottom_blobs[n].refcount != 1)
+                        bottom_blobs[n] = bottom_blobs[n].clone(opt.blob_allocator);
+                }
             }
         }
 
-        // forward
-        if (lightmode && layer->support_inplace)
-        {
-            Mat& bottom_top_blob = bottom_blob;
+        ProfilerSample sample;
+        if (opt.profiler)
+            opt.profiler->begin_layer(sample);
 #if NCNN_BENCHMARK
-            double start = get_current_time();
-            int ret = layer->forward_inplace(bottom_top_blob);
-            double end = get_current_time();
-            benchmark(layer, bottom_top_blob, bottom_top_blob, start, end);
-#else
-            int ret = layer->forward_inplace(bottom_top_blob);
+        double start = get_current_time();
 #endif // NCNN_BENCHMARK
-            if (ret != 0)
-                return ret;
+        std::vector<Mat> top_blobs;
+        int ret = 0;
+        if (opt.lightmode && layer->support_inplace)
+        {
+            for (int n=0; n<batch && ret == 0; n++)
+            {
+                ret = layer->forward_inplace(bottom_blobs[n], opt);
+            }
 
-            // store top blob
-            blob_mats[top_blob_index] = bottom_top_blob;
+            top_blobs = bottom_blobs;
         }
         else
         {
-            Mat top_blob;
+            ret = layer->forward_batch(bottom_blobs, top_blobs, opt);
+        }
 #if NCNN_BENCHMARK
-            double start = get_current_time();
-            int ret = layer->forward(bottom_blob, top_blob);
-            double end = get_current_time();
-            benchmark(layer, bottom_blob, top_blob, start, end);
-#else
-            int ret = layer->forward(bottom_blob, top_blob);
+        double end = get_current_time();
+        benchmark(layer, start, end);
 #endif // NCNN_BENCHMARK
-            if (ret != 0)
-                return ret;
+        if (opt.profiler && ret == 0)
+            opt.profiler->end_layer(sample, layer, &bottom_blobs[0], 1, &top_blobs[0], 1, batch);
+        if (ret != 0)
+            return ret;
 
-            // store top blob
-            blob_mats[top_blob_index] = top_blob;
+        // store top blob of each sample
+        for (int n=0; n<batch; n++)
+        {
+            batch_blob_mats[n][top_blob_index] = top_blobs[n];
         }
-
     }
     else
     {
-        // load bottom blobs
-        std::vector<Mat> bottom_blobs;
-        bottom_blobs.resize(layer->bottoms.size());
-        for (size_t i=0; i<layer->bottoms.size(); i++)
+        // load bottom blobs of each sample
+        std::vector< std::vector<Mat> > bottom_blobs(batch);
+        for (int n=0; n<batch; n++)
         {
-            int bottom_blob_index = layer->bottoms[i];
-
-            if (blob_mats[bottom_blob_index].dims == 0)
+            bottom_blobs[n].resize(layer->bottoms.size());
+            for (size_t i=0; i<layer->bottoms.size(); i++)
             {
-                int ret = forward_layer(blobs[bottom_blob_index].producer, blob_mats, lightmode);
-                if (ret != 0)
-                    return ret;
+                bottom_blobs[n][i] = batch_blob_mats[n][layer->bottoms[i]];
             }
+        }
 
-            bottom_blobs[i] = blob_mats[bottom_blob_index];
+        const int bottom_count = layer->bottoms.size();
 
-            if (lightmode)
+        if (opt.lightmode)
+        {
+            for (int i=0; i<bottom_count; i++)
             {
-                // delete after taken in light mode
-                blob_mats[bottom_blob_index].release();
-                // deep copy for inplace forward if data is shared
-                if (layer->support_inplace && *bottom_blobs[i].refcount != 1)
+                int bottom_blob_index = layer->bottoms[i];
+
+                // delete after taken by the last consumer in light mode
+                if (--blob_uses[bottom_blob_index] == 0)
                 {
-                    bottom_blobs[i] = bottom_blobs[i].clone();
+                    for (int n=0; n<batch; n++)
+                    {
+                        batch_blob_mats[n][bottom_blob_index].release();
+                    }
                 }
             }
         }
 
-        // forward
-        if (lightmode && layer->support_inplace)
+        for (int n=0; n<batch; n++)
         {
-            std::vector<Mat>& bottom_top_blobs = bottom_blobs;
-#if NCNN_BENCHMARK
-            double start = get_current_time();
-            int ret = layer->forward_inplace(bottom_top_blobs);
-            double end = get_current_time();
-            benchmark(layer, start, end);
-#else
-            int ret = layer->forward_inplace(bottom_top_blobs);
-#endif // NCNN_BENCHMARK
-            if (ret != 0)
-                return ret;
+            if (convert_bottom_packing(layer, &bottom_blobs[n][0], bottom_count, opt) != 0)
+                return -100;
+        }
 
-            // store top blobs
-            for (size_t i=0; i<layer->tops.size(); i++)
+        if (opt.lightmode && layer->support_inplace)
+        {
+            // deep copy for inplace forward if data is shared
+            for (int n=0; n<batch; n++)
             {
-                int top_blob_index = layer->tops[i];
+                for (int i=0; i<bottom_count; i++)
+                {
+                    if (*bottom_blobs[n][i].refcount != 1)
+                        bottom_blobs[n][i] = bottom_blobs[n][i].clone(opt.blob_allocator);
+                }
+            }
+        }
 
-                blob_mats[top_blob_index] = bottom_top_blobs[i];
+        ProfilerSample sample;
+        if (opt.profiler)
+            opt.profiler->begin_layer(sample);
+#if NCNN_BENCHMARK
+        double start = get_current_time();
+#endif // NCNN_BENCHMARK
+        std::vector< std::vector<Mat> > top_blobs;
+        int ret = 0;
+        if (opt.lightmode && layer->support_inplace)
+        {
+            for (int n=0; n<batch && ret == 0; n++)
+            {
+                ret = layer->forward_inplace(bottom_blobs[n], opt);
             }
+
+            top_blobs = bottom_blobs;
         }
         else
         {
-            std::vector<Mat> top_blobs;
-            top_blobs.resize(layer->tops.size());
+            ret = layer->forward_batch(bottom_blobs, top_blobs, opt);
+        }
 #if NCNN_BENCHMARK
-            double start = get_current_time();
-            int ret = layer->forward(bottom_blobs, top_blobs);
-            double end = get_current_time();
-            benchmark(layer, start, end);
-#else
-            int ret = layer->forward(bottom_blobs, top_blobs);
+        double end = get_current_time();
+        benchmark(layer, start, end);
 #endif // NCNN_BENCHMARK
-            if (ret != 0)
-                return ret;
+        if (opt.profiler && ret == 0)
+        {
+            // the profiler takes the blobs of all samples one sample after another
+            const int top_count = layer->tops.size();
+            std::vector<Mat> bottom_blobs_flat;
+            std::vector<Mat> top_blobs_flat;
+            for (int n=0; n<batch; n++)
+            {
+                bottom_blobs_flat.insert(bottom_blobs_flat.end(), bottom_blobs[n].begin(), bottom_blobs[n].end());
+                top_blobs_flat.insert(top_blobs_flat.end(), top_blobs[n].begin(), top_blobs[n].end());
+            }
 
-            // store top blobs
+            opt.profiler->end_layer(sample, layer, bottom_blobs_flat.data(), bottom_count, top_blobs_flat.data(), top_count, batch);
+        }
+        if (ret != 0)
+            return ret;
+
+        // store top blobs of each sample
+        for (int n=0; n<batch; n++)
+        {
             for (size_t i=0; i<layer->tops.size(); i++)
             {
-                int top_blob_index = layer->tops[i];
-
-                blob_mats[top_blob_index] = top_blobs[i];
+                batch_blob_mats[n][layer->tops[i]] = top_blobs[n][i];
             }
         }
     }
 
-//     fprintf(stderr, "forward_layer %d %s done\n", layer_index, layer->name.c_str());
-//     const Mat& blob = blob_mats[layer->tops[0]];
-//     fprintf(stderr, "[%-2d %-16s %-16s]  %d    blobs count = %-3d   size = %-3d x %-3d\n", layer_index, layer->type.c_str(), layer->name.c_str(), layer->tops[0], blob.c, blob.h, blob.w);
-
     return 0;
 }
 
 Extractor::Extractor(const Net* _net, int blob_count) : net(_net)
 {
     blob_mats.resize(blob_count);
-    lightmode = true;
-    num_threads = 0;
+    opt = get_default_option();
 }
 
 void Extractor::set_light_mode(bool enable)
 {
-    lightmode = enable;
+    opt.lightmode = enable;
+}
+
+void Extractor::set_num_threads(int num_threads)
+{
+    opt.num_threads = num_threads;
+}
+
+void Extractor::set_blob_allocator(Allocator* allocator)
+{
+    opt.blob_allocator = allocator;
+}
+
+void Extractor::set_workspace_allocator(Allocator* allocator)
+{
+    opt.workspace_allocator = allocator;
+}
+
+void Extractor::set_thread_pool(ThreadPool* thread_pool)
+{
+    opt.thread_pool = thread_pool;
+}
+
+void Extractor::set_branch_parallel(bool enable)
+{
+    opt.use_branch_parallel = enable;
+}
+
+void Extractor::set_packing_layout(bool enable)
+{
+    opt.use_packing_layout = enable;
 }
 
-void Extractor::set_num_threads(int _num_threads)
+void Extractor::set_profiler(Profiler* profiler)
 {
-    num_threads = _num_threads;
+    opt.profiler = profiler;
 }
 
 int Extractor::input(int blob_index, const Mat& in)
@@ -800,33 +2544,19 @@ int Extractor::extract(int blob_index, Mat& feat)
 
     if (blob_mats[blob_index].dims == 0)
     {
-        int layer_index = net->blobs[blob_index].producer;
-
-#ifdef _OPENMP
-        int dynamic_current = 0;
-        int num_threads_current = 1;
-        if (num_threads)
-        {
-            dynamic_current = omp_get_dynamic();
-            num_threads_current = omp_get_num_threads();
-            omp_set_dynamic(0);
-            omp_set_num_threads(num_threads);
-        }
-#endif
+        double start = opt.profiler ? get_current_time() : 0.0;
 
-        ret = net->forward_layer(layer_index, blob_mats, lightmode);
+        ret = net->forward_blob(blob_index, blob_mats, opt);
 
-#ifdef _OPENMP
-        if (num_threads)
-        {
-            omp_set_dynamic(dynamic_current);
-            omp_set_num_threads(num_threads_current);
-        }
-#endif
+        if (opt.profiler)
+            opt.profiler->record_extract(start, get_current_time());
     }
 
     feat = blob_mats[blob_index];
 
+    if (ret == 0)
+        ret = net->convert_output_blob(blob_index, feat, opt);
+
     return ret;
 }
 
@@ -852,35 +2582,140 @@ int Extractor::extract(const char* blob_name, Mat& feat)
 
     if (blob_mats[blob_index].dims == 0)
     {
-        int layer_index = net->blobs[blob_index].producer;
-
-#ifdef _OPENMP
-        int dynamic_current = 0;
-        int num_threads_current = 1;
-        if (num_threads)
-        {
-            dynamic_current = omp_get_dynamic();
-            num_threads_current = omp_get_num_threads();
-            omp_set_dynamic(0);
-            omp_set_num_threads(num_threads);
-        }
-#endif
+        double start = opt.profiler ? get_current_time() : 0.0;
 
-        ret = net->forward_layer(layer_index, blob_mats, lightmode);
+        ret = net->forward_blob(blob_index, blob_mats, opt);
 
-#ifdef _OPENMP
-        if (num_threads)
-        {
-            omp_set_dynamic(dynamic_current);
-            omp_set_num_threads(num_threads_current);
-        }
-#endif
+        if (opt.profiler)
+            opt.profiler->record_extract(start, get_current_time());
     }
 
     feat = blob_mats[blob_index];
 
+    if (ret == 0)
+        ret = net->convert_output_blob(blob_index, feat, opt);
+
+    return ret;
+}
+#endif // NCNN_STRING
+
+BatchExtractor::BatchExtractor(const Net* _net, int blob_count, int batch_size) : net(_net)
+{
+    batch_blob_mats.resize(batch_size);
+    for (int n=0; n<batch_size; n++)
+    {
+        batch_blob_mats[n].resize(blob_count);
+    }
+    opt = get_default_option();
+}
+
+void BatchExtractor::set_light_mode(bool enable)
+{
+    opt.lightmode = enable;
+}
+
+void BatchExtractor::set_num_threads(int num_threads)
+{
+    opt.num_threads = num_threads;
+}
+
+void BatchExtractor::set_blob_allocator(Allocator* allocator)
+{
+    opt.blob_allocator = allocator;
+}
+
+void BatchExtractor::set_workspace_allocator(Allocator* allocator)
+{
+    opt.workspace_allocator = allocator;
+}
+
+void BatchExtractor::set_thread_pool(ThreadPool* thread_pool)
+{
+    opt.thread_pool = thread_pool;
+}
+
+void BatchExtractor::set_packing_layout(bool enable)
+{
+    opt.use_packing_layout = enable;
+}
+
+void BatchExtractor::set_profiler(Profiler* profiler)
+{
+    opt.profiler = profiler;
+}
+
+int BatchExtractor::input(int blob_index, const std::vector<Mat>& in)
+{
+    if (batch_blob_mats.empty())
+        return -1;
+
+    if (blob_index < 0 || blob_index >= (int)batch_blob_mats[0].size())
+        return -1;
+
+    if (in.size() != batch_blob_mats.size())
+    {
+        fprintf(stderr, "batch input size %d mismatch batch size %d\n", (int)in.size(), (int)batch_blob_mats.size());
+        return -1;
+    }
+
+    for (size_t n=0; n<batch_blob_mats.size(); n++)
+    {
+        batch_blob_mats[n][blob_index] = in[n];
+    }
+
+    return 0;
+}
+
+int BatchExtractor::extract(int blob_index, std::vector<Mat>& feats)
+{
+    if (batch_blob_mats.empty())
+        return -1;
+
+    if (blob_index < 0 || blob_index >= (int)batch_blob_mats[0].size())
+        return -1;
+
+    int ret = 0;
+
+    if (batch_blob_mats[0][blob_index].dims == 0)
+    {
+        double start = opt.profiler ? get_current_time() : 0.0;
+
+        ret = net->forward_blob_batch(blob_index, batch_blob_mats, opt);
+
+        if (opt.profiler)
+            opt.profiler->record_extract(start, get_current_time());
+    }
+
+    feats.resize(batch_blob_mats.size());
+    for (size_t n=0; n<batch_blob_mats.size(); n++)
+    {
+        feats[n] = batch_blob_mats[n][blob_index];
+
+        if (ret == 0)
+            ret = net->convert_output_blob(blob_index, feats[n], opt);
+    }
+
     return ret;
 }
+
+#if NCNN_STRING
+int BatchExtractor::input(const char* blob_name, const std::vector<Mat>& in)
+{
+    int blob_index = net->find_blob_index_by_name(blob_name);
+    if (blob_index == -1)
+        return -1;
+
+    return input(blob_index, in);
+}
+
+int BatchExtractor::extract(const char* blob_name, std::vector<Mat>& feats)
+{
+    int blob_index = net->find_blob_index_by_name(blob_name);
+    if (blob_index == -1)
+        return -1;
+
+    return extract(blob_index, feats);
+}
 #endif // NCNN_STRING
 
 } // namespace ncnn
@@ -25,6 +25,7 @@
 namespace ncnn {
 
 class Extractor;
+class BatchExtractor;
 class Net
 {
 public:
@@ -58,6 +59,23 @@ public:
     // return 0 if success
     int load_model(FILE* fp);
     int load_model(const char* modelpath);
+
+    // map the model file read-only and reference the weights in place
+    // raw float32 and int8 weights are not copied, processes loading the
+    // same model share the page cache, the mapping is kept until clear()
+    // weights are 32-bit aligned as with load_model from memory
+    // prefault reads the whole file in ahead of the first inference
+    // falls back to load_model on platforms without mmap
+    // return 0 if success
+    int load_model_mmap(const char* modelpath, bool prefault = false);
+
+    // load the weights transformed and packed for this cpu from the prepared model cache
+    // the cache is mapped like load_model_mmap and the layers skip preparing their weights
+    // when the cache is missing or was written for another model file, isa or option set,
+    // the model is loaded from modelpath and the cache is rewritten for the next time
+    // falls back to load_model on platforms without mmap
+    // return 0 if success
+    int load_model_prepared(const char* modelpath, const char* cachepath);
 #endif // NCNN_STDIO
 
     // load network structure from external memory
@@ -75,11 +93,44 @@ public:
     // unload network structure and weight data
     void clear();
 
+#if NCNN_STRING
+    // infer the shape of every blob from the input blob shape
+    // layers prepare their kernel plan for these shapes so that repeated
+    // inference on the same resolution skips the per-call setup
+    // call it after load_model and before creating extractors
+    // return 0 if success
+    int infer_shape(const char* blob_name, const Mat& shape);
+
+    // get blob shape from the last shape inference
+    // dims is 0 if the shape is unknown
+    Mat get_blob_shape(const char* blob_name) const;
+#endif // NCNN_STRING
+
+    // infer the shape of every blob from the shapes of all input blobs
+    // return 0 if success
+    int infer_shape(const std::vector<int>& blob_indexes, const std::vector<Mat>& shapes);
+
+    // get blob shape from the last shape inference
+    // dims is 0 if the shape is unknown
+    Mat get_blob_shape(int blob_index) const;
+
+    // fold BatchNorm Scale Bias and ReLU into the preceding
+    // Convolution ConvolutionDepthWise or InnerProduct
+    // and drop the absorbed layers from the graph
+    // blobs between the fused layers can not be extracted any more
+    // call it after load_model
+    // return 0 if success
+    int fuse_network();
+
     // construct an Extractor from network
     Extractor create_extractor() const;
 
+    // construct a BatchExtractor running batch_size samples together
+    BatchExtractor create_batch_extractor(int batch_size) const;
+
 protected:
     friend class Extractor;
+    friend class BatchExtractor;
 #if NCNN_STRING
     int find_blob_index_by_name(const char* name) const;
     int find_layer_index_by_name(const char* name) const;
@@ -87,13 +138,62 @@ protected:
     Layer* create_custom_layer(const char* type);
 #endif // NCNN_STRING
     Layer* create_custom_layer(int index);
-    int forward_layer(int layer_index, std::vector<Mat>& blob_mats, bool lightmode) const;
+    // order all layers so that every layer comes after the producers of its bottoms
+    int update_execution_plan();
+    // fold the type, the blobs and the params of a layer into param_hash
+    void hash_layer_param(const Layer* layer, const ParamDict& pd);
+    // mark the layers the blob depends on, stop at blobs already computed or fed as input
+    int mark_required_layers(int blob_index, const std::vector<Mat>& blob_mats, std::vector<unsigned char>& required, std::vector<int>& blob_uses, int& plan_begin, int& plan_end) const;
+    // run the part of the execution plan that the blob depends on
+    int forward_blob(int blob_index, std::vector<Mat>& blob_mats, Option& opt) const;
+    // same as forward_blob, batch_blob_mats[n] holds the blobs of the n-th sample
+    int forward_blob_batch(int blob_index, std::vector< std::vector<Mat> >& batch_blob_mats, Option& opt) const;
+    int forward_layer_batch(int layer_index, std::vector< std::vector<Mat> >& batch_blob_mats, std::vector<int>& blob_uses, Option& opt) const;
+    int forward_layer(int layer_index, std::vector<Mat>& blob_mats, std::vector<int>& blob_uses, std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, Option& opt) const;
+    // run every marked layer as soon as its producers are done, independent layers at the same time
+    int forward_branch_parallel(const std::vector<unsigned char>& required, int plan_begin, int plan_end, std::vector<Mat>& blob_mats, std::vector<int>& blob_uses, Option& opt) const;
+    struct BranchTask;
+    friend struct BranchTask;
+    // take the bottoms of the layer out of blob_mats, releasing the ones used up in light mode
+    void take_bottom_blobs(const Layer* layer, std::vector<Mat>& blob_mats, std::vector<int>& blob_uses, std::vector<Mat>& bottom_blobs, const Option& opt) const;
+    // repack the bottoms for the layer and copy the shared ones it runs inplace on
+    int prepare_bottom_blobs(const Layer* layer, std::vector<Mat>& bottom_blobs, const Option& opt) const;
+    // repack the bottoms into the layout the layer runs in, elempack 4 or 1
+    int convert_bottom_packing(const Layer* layer, Mat* bottom_blobs, int count, const Option& opt) const;
+    int forward_layer_blobs(const Layer* layer, std::vector<Mat>& bottom_blobs, std::vector<Mat>& top_blobs, const Option& opt) const;
+    // run create_pipeline of every layer once the model is read, several layers at a time
+    int create_pipeline();
+    // let an int8 layer whose only consumer is int8 too hand over int8 directly
+    int update_int8_requantize();
+    // hand out a blob as plain fp32, unpacking and dequantizing as needed
+    int convert_output_blob(int blob_index, Mat& feat, const Option& opt) const;
+#if NCNN_STDIO
+    // load the layers from the prepared model cache if it carries the fingerprint
+    int load_prepared_cache(const char* cachepath, const unsigned int* fingerprint);
+    // write the prepared model cache, model_weights are the weights each layer loaded
+    int save_prepared_cache(const char* cachepath, const unsigned int* fingerprint, const std::vector< std::vector<Mat> >& model_weights) const;
+#endif // NCNN_STDIO
 
 protected:
     std::vector<Blob> blobs;
     std::vector<Layer*> layers;
 
+    // layer indices in topological order
+    std::vector<int> execution_plan;
+    // position of each layer in execution_plan
+    std::vector<int> execution_position;
+
+    // blob shapes from the last shape inference
+    std::vector<Mat> blob_shapes;
+
     std::vector<layer_registry_entry> custom_layer_registry;
+
+    // model file mapped by load_model_mmap
+    void* model_mmap_data;
+    size_t model_mmap_size;
+
+    // hash of the loaded param, part of the prepared model cache fingerprint
+    unsigned int param_hash;
 };
 
 class Extractor
@@ -109,6 +209,31 @@ public:
     // default count is system depended
     void set_num_threads(int num_threads);
 
+    // set blob memory allocator
+    void set_blob_allocator(Allocator* allocator);
+
+    // set workspace memory allocator
+    void set_workspace_allocator(Allocator* allocator);
+
+    // run the layers on the worker threads of this pool
+    // extractors on different threads may share one, their loops split the idle workers
+    // default is the pool shared by the whole process
+    void set_thread_pool(ThreadPool* thread_pool);
+
+    // run independent branches at the same time with the thread count split among them
+    // blob and workspace allocator must be thread-safe when enabled
+    // disabled by default
+    void set_branch_parallel(bool enable);
+
+    // keep the blobs channel packed between the layers supporting it
+    // disabled by default
+    void set_packing_layout(bool enable);
+
+    // record the time, shapes, estimated work and kernel of every layer this extractor runs
+    // the profiler may be shared with other extractors, 0 turns profiling off again
+    // disabled by default
+    void set_profiler(Profiler* profiler);
+
 #if NCNN_STRING
     // set input by blob name
     // return 0 if success
@@ -134,8 +259,72 @@ protected:
 private:
     const Net* net;
     std::vector<Mat> blob_mats;
-    bool lightmode;
-    int num_threads;
+    Option opt;
+};
+
+class BatchExtractor
+{
+public:
+    // enable light mode
+    // intermediate blob will be recycled when enabled
+    // enabled by default
+    void set_light_mode(bool enable);
+
+    // set thread count for this extractor
+    // this will overwrite the global setting
+    // default count is system depended
+    void set_num_threads(int num_threads);
+
+    // set blob memory allocator
+    void set_blob_allocator(Allocator* allocator);
+
+    // set workspace memory allocator
+    void set_workspace_allocator(Allocator* allocator);
+
+    // run the layers on the worker threads of this pool
+    // default is the pool shared by the whole process
+    void set_thread_pool(ThreadPool* thread_pool);
+
+    // keep the blobs channel packed between the layers supporting it
+    // disabled by default
+    void set_packing_layout(bool enable);
+
+    // record every layer this extractor runs, the numbers cover the whole batch
+    // 0 turns profiling off again
+    // disabled by default
+    void set_profiler(Profiler* profiler);
+
+#if NCNN_STRING
+    // set input of all samples by blob name
+    // in.size() must be the batch size
+    // return 0 if success
+    int input(const char* blob_name, const std::vector<Mat>& in);
+
+    // get result of all samples by blob name
+    // feats[n] is the result of the n-th sample
+    // return 0 if success
+    int extract(const char* blob_name, std::vector<Mat>& feats);
+#endif // NCNN_STRING
+
+    // set input of all samples by blob index
+    // in.size() must be the batch size
+    // return 0 if success
+    int input(int blob_index, const std::vector<Mat>& in);
+
+    // get result of all samples by blob index
+    // feats[n] is the result of the n-th sample
+    // return 0 if success
+    int extract(int blob_index, std::vector<Mat>& feats);
+
+protected:
+    friend BatchExtractor Net::create_batch_extractor(int batch_size) const;
+    BatchExtractor(const Net* net, int blob_count, int batch_size);
+
+private:
+    const Net* net;
+    // blob mats of each sample
+    std::vector< std::vector<Mat> > batch_blob_mats;
+    Option opt;
 };
 
 } // namespace ncnn
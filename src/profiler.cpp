@@ -0,0 +1,615 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "profiler.h"
+#include "layer.h"
+#include "layer_type.h"
+#include "threadpool.h"
+
+#include "layer/convolution.h"
+#include "layer/convolutiondepthwise.h"
+#include "layer/deconvolution.h"
+#include "layer/deconvolutiondepthwise.h"
+#include "layer/innerproduct.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include "benchmark.h"
+
+namespace ncnn {
+
+Profiler::Profiler()
+{
+    for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+    {
+        counter_available[i] = false;
+    }
+}
+
+Profiler::~Profiler()
+{
+    disable_hardware_counters();
+}
+
+#if defined(__linux__)
+// count one hardware event of thread tid in user space, 0 for the calling thread
+static int open_counter(int counter, int tid)
+{
+    static const unsigned long long configs[PROFILER_COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[counter];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // scale the count when the pmu is shared and the event multiplexed
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+}
+#endif // __linux__
+
+int Profiler::enable_hardware_counters(int num_threads, ThreadPool* thread_pool)
+{
+    disable_hardware_counters();
+
+#if defined(__linux__)
+    std::vector<int> fds;
+
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(num_threads)
+#else
+    (void)num_threads;
+#endif
+    {
+        int thread_fds[PROFILER_COUNTER_COUNT];
+        for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+        {
+            thread_fds[i] = open_counter(i, 0);
+        }
+
+#ifdef _OPENMP
+        #pragma omp critical
+#endif
+        fds.insert(fds.end(), thread_fds, thread_fds + PROFILER_COUNTER_COUNT);
+    }
+
+#if NCNN_THREADPOOL
+    // the parallel loops of the layers run there
+    std::vector<int> tids;
+    ThreadPool* pool = thread_pool ? thread_pool : get_default_thread_pool();
+    pool->get_worker_tids(tids);
+    for (size_t j=0; j<tids.size(); j++)
+    {
+        for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+        {
+            fds.push_back(open_counter(i, tids[j]));
+        }
+    }
+#else
+    (void)thread_pool;
+#endif // NCNN_THREADPOOL
+
+    // a counter missing on any thread is left out everywhere
+    bool any_available = false;
+    for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+    {
+        counter_available[i] = true;
+        for (size_t j=i; j<fds.size(); j+=PROFILER_COUNTER_COUNT)
+        {
+            if (fds[j] == -1)
+                counter_available[i] = false;
+        }
+
+        if (counter_available[i])
+        {
+            any_available = true;
+            continue;
+        }
+
+        for (size_t j=i; j<fds.size(); j+=PROFILER_COUNTER_COUNT)
+        {
+            if (fds[j] != -1)
+                close(fds[j]);
+            fds[j] = -1;
+        }
+    }
+
+    if (!any_available)
+    {
+        fprintf(stderr, "perf_event_open failed, hardware counters are not available\n");
+        return -1;
+    }
+
+    MutexLockGuard guard(lock);
+    counter_fds = fds;
+
+    return 0;
+#else
+    (void)num_threads;
+    (void)thread_pool;
+    return -1;
+#endif // __linux__
+}
+
+void Profiler::disable_hardware_counters()
+{
+    MutexLockGuard guard(lock);
+
+#if defined(__linux__)
+    for (size_t i=0; i<counter_fds.size(); i++)
+    {
+        if (counter_fds[i] != -1)
+            close(counter_fds[i]);
+    }
+#endif // __linux__
+    counter_fds.clear();
+
+    for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+    {
+        counter_available[i] = false;
+    }
+}
+
+void Profiler::read_counters(long long* counters) const
+{
+    for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+    {
+        counters[i] = 0;
+    }
+
+#if defined(__linux__)
+    for (size_t j=0; j<counter_fds.size(); j++)
+    {
+        if (counter_fds[j] == -1)
+            continue;
+
+        // value, time enabled, time running
+        unsigned long long values[3];
+        if (read(counter_fds[j], values, sizeof(values)) != sizeof(values))
+            continue;
+
+        double value = (double)values[0];
+        if (values[2] != 0 && values[2] < values[1])
+            value = value * values[1] / values[2];
+
+        counters[j % PROFILER_COUNTER_COUNT] += (long long)value;
+    }
+#endif // __linux__
+}
+
+void Profiler::clear()
+{
+    MutexLockGuard guard(lock);
+
+    layer_stat_index.clear();
+    layer_stats.clear();
+    extract_times.clear();
+    events.clear();
+}
+
+int Profiler::extract_count() const
+{
+    MutexLockGuard guard(lock);
+
+    return (int)extract_times.size();
+}
+
+static size_t blob_bytes(const Mat& m)
+{
+    return (size_t)m.w * m.h * m.c * m.elemsize;
+}
+
+// multiply-accumulates of the layers doing most of the work, 0 for the others
+static double estimate_macs(const Layer* layer, const Mat& bottom_blob, const Mat& top_blob)
+{
+    switch (layer->typeindex)
+    {
+    case LayerType::Convolution:
+        // weights hold outch * inch / group * kernel_size, one pass per output pixel
+        return (double)((const Convolution*)layer)->weight_data_size * top_blob.w * top_blob.h;
+    case LayerType::ConvolutionDepthWise:
+        return (double)((const ConvolutionDepthWise*)layer)->weight_data_size * top_blob.w * top_blob.h;
+    case LayerType::Deconvolution:
+        // one pass per input pixel
+        return (double)((const Deconvolution*)layer)->weight_data_size * bottom_blob.w * bottom_blob.h;
+    case LayerType::DeconvolutionDepthWise:
+        return (double)((const DeconvolutionDepthWise*)layer)->weight_data_size * bottom_blob.w * bottom_blob.h;
+    case LayerType::InnerProduct:
+        return (double)((const InnerProduct*)layer)->weight_data_size;
+    default:
+        break;
+    }
+
+    return 0.0;
+}
+
+static double estimate_weight_bytes(const Layer* layer)
+{
+    switch (layer->typeindex)
+    {
+    case LayerType::Convolution:
+    {
+        const Convolution* op = (const Convolution*)layer;
+        return (double)op->weight_data_size * (op->use_int8_inference ? 1 : 4);
+    }
+    case LayerType::ConvolutionDepthWise:
+    {
+        const ConvolutionDepthWise* op = (const ConvolutionDepthWise*)layer;
+        return (double)op->weight_data_size * (op->use_int8_inference ? 1 : 4);
+    }
+    case LayerType::Deconvolution:
+        return (double)((const Deconvolution*)layer)->weight_data_size * 4;
+    case LayerType::DeconvolutionDepthWise:
+        return (double)((const DeconvolutionDepthWise*)layer)->weight_data_size * 4;
+    case LayerType::InnerProduct:
+    {
+        const InnerProduct* op = (const InnerProduct*)layer;
+        return (double)op->weight_data_size * (op->use_int8_inference ? 1 : 4);
+    }
+    default:
+        break;
+    }
+
+    return 0.0;
+}
+
+void Profiler::begin_layer(ProfilerSample& sample) const
+{
+    read_counters(sample.counters);
+    sample.time = get_current_time();
+}
+
+void Profiler::end_layer(const ProfilerSample& sample, const Layer* layer, const Mat* bottom_blobs, int bottom_count, const Mat* top_blobs, int top_count, int batch)
+{
+    double start = sample.time;
+    double end = get_current_time();
+
+    long long counters[PROFILER_COUNTER_COUNT];
+    read_counters(counters);
+    for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+    {
+        counters[i] -= sample.counters[i];
+    }
+
+    int tid = 0;
+#ifdef _OPENMP
+    tid = omp_get_thread_num();
+#endif
+
+    // work it out before taking the lock
+    const char* kernel = bottom_count > 0 ? layer->kernel_name(bottom_blobs[0]) : 0;
+
+    double macs = 0.0;
+    if (bottom_count > 0 && top_count > 0)
+    {
+        for (int n=0; n<batch; n++)
+        {
+            macs += estimate_macs(layer, bottom_blobs[n * bottom_count], top_blobs[n * top_count]);
+        }
+    }
+
+    // the weights are read once for the whole batch
+    double bytes = estimate_weight_bytes(layer);
+    for (int i=0; i<bottom_count * batch; i++)
+    {
+        bytes += blob_bytes(bottom_blobs[i]);
+    }
+    for (int i=0; i<top_count * batch; i++)
+    {
+        bytes += blob_bytes(top_blobs[i]);
+    }
+
+    MutexLockGuard guard(lock);
+
+    int stat_index;
+    std::map<const Layer*, int>::iterator it = layer_stat_index.find(layer);
+    if (it == layer_stat_index.end())
+    {
+        stat_index = (int)layer_stats.size();
+        layer_stat_index[layer] = stat_index;
+
+        LayerStat stat;
+        for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+        {
+            stat.counters[i] = 0;
+        }
+#if NCNN_STRING
+        stat.name = layer->name;
+        stat.type = layer->type;
+#else
+        char typeindex_str[16];
+        sprintf(typeindex_str, "%d", layer->typeindex);
+        stat.name = typeindex_str;
+        stat.type = typeindex_str;
+#endif // NCNN_STRING
+        layer_stats.push_back(stat);
+    }
+    else
+    {
+        stat_index = it->second;
+    }
+
+    LayerStat& stat = layer_stats[stat_index];
+    stat.kernel = kernel;
+    stat.macs = macs;
+    stat.bytes = bytes;
+    stat.times.push_back(end - start);
+    for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+    {
+        stat.counters[i] += counters[i];
+    }
+
+    stat.bottom_shapes.resize(bottom_count);
+    for (int i=0; i<bottom_count; i++)
+    {
+        const Mat& m = bottom_blobs[i];
+        BlobShape s = { m.dims, m.w, m.h, m.c, m.elempack, m.elemsize };
+        stat.bottom_shapes[i] = s;
+    }
+
+    stat.top_shapes.resize(top_count);
+    for (int i=0; i<top_count; i++)
+    {
+        const Mat& m = top_blobs[i];
+        BlobShape s = { m.dims, m.w, m.h, m.c, m.elempack, m.elemsize };
+        stat.top_shapes[i] = s;
+    }
+
+    Event e = { stat_index, tid, start, end };
+    events.push_back(e);
+}
+
+void Profiler::record_extract(double start, double end)
+{
+    MutexLockGuard guard(lock);
+
+    extract_times.push_back(end - start);
+
+    Event e = { -1, 0, start, end };
+    events.push_back(e);
+}
+
+#if NCNN_STDIO
+// write s as a json string
+static void write_json_string(FILE* fp, const char* s)
+{
+    fputc('"', fp);
+    for (; *s; s++)
+    {
+        unsigned char ch = *s;
+        if (ch == '"' || ch == '\\')
+            fprintf(fp, "\\%c", ch);
+        else if (ch < 0x20)
+            fprintf(fp, "\\u%04x", ch);
+        else
+            fputc(ch, fp);
+    }
+    fputc('"', fp);
+}
+
+// nearest rank on sorted times
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+
+    int index = (int)ceil(p / 100.0 * sorted.size()) - 1;
+    index = std::max(0, std::min(index, (int)sorted.size() - 1));
+    return sorted[index];
+}
+
+static void write_json_times(FILE* fp, std::vector<double> times)
+{
+    std::sort(times.begin(), times.end());
+
+    double sum = 0.0;
+    for (size_t i=0; i<times.size(); i++)
+    {
+        sum += times[i];
+    }
+
+    double mean = times.empty() ? 0.0 : sum / times.size();
+    double min = times.empty() ? 0.0 : times.front();
+    double max = times.empty() ? 0.0 : times.back();
+
+    fprintf(fp, "\"count\": %d, \"time_ms\": {\"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"total\": %.4f}",
+            (int)times.size(), mean, min, percentile(times, 50), percentile(times, 90), percentile(times, 99), max, sum);
+}
+
+template<typename T>
+static void write_json_shapes(FILE* fp, const char* key, const std::vector<T>& shapes)
+{
+    fprintf(fp, "\"%s\": [", key);
+    for (size_t i=0; i<shapes.size(); i++)
+    {
+        const T& s = shapes[i];
+        fprintf(fp, "%s{\"dims\": %d, \"w\": %d, \"h\": %d, \"c\": %d, \"elempack\": %d, \"elemsize\": %d}",
+                i == 0 ? "" : ", ", s.dims, s.w, s.h, s.c, s.elempack, (int)s.elemsize);
+    }
+    fprintf(fp, "]");
+}
+
+static const char* counter_names[PROFILER_COUNTER_COUNT] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+
+// per run averages of the available counters and the ratios derived from them
+static void write_json_counters(FILE* fp, const long long* counters, int runs, const bool* available)
+{
+    fprintf(fp, "\"counters\": {");
+    int n = 0;
+    for (int i=0; i<PROFILER_COUNTER_COUNT; i++)
+    {
+        if (!available[i])
+            continue;
+
+        fprintf(fp, "%s\"%s\": %.0f", n++ == 0 ? "" : ", ", counter_names[i], runs > 0 ? (double)counters[i] / runs : 0.0);
+    }
+
+    const double instructions = (double)counters[PROFILER_INSTRUCTIONS];
+    if (available[PROFILER_INSTRUCTIONS] && instructions > 0)
+    {
+        if (available[PROFILER_CYCLES] && counters[PROFILER_CYCLES] > 0)
+            fprintf(fp, ", \"ipc\": %.3f", instructions / counters[PROFILER_CYCLES]);
+        // misses per thousand instructions
+        if (available[PROFILER_CACHE_MISSES])
+            fprintf(fp, ", \"cache_mpki\": %.3f", counters[PROFILER_CACHE_MISSES] * 1000.0 / instructions);
+        if (available[PROFILER_BRANCH_MISSES])
+            fprintf(fp, ", \"branch_mpki\": %.3f", counters[PROFILER_BRANCH_MISSES] * 1000.0 / instructions);
+    }
+    fprintf(fp, "}");
+}
+
+int Profiler::save_json(const char* path) const
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", path);
+        return -1;
+    }
+
+    MutexLockGuard guard(lock);
+
+    static const char* isa_names[4] = { "baseline", "avx", "avx2", "avx512" };
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"isa\": \"%s\",\n", isa_names[layer_isa_level()]);
+    fprintf(fp, "  \"hardware_counters\": [");
+    for (int i=0, n=0; i<PROFILER_COUNTER_COUNT; i++)
+    {
+        if (counter_available[i] && !counter_fds.empty())
+            fprintf(fp, "%s\"%s\"", n++ == 0 ? "" : ", ", counter_names[i]);
+    }
+    fprintf(fp, "],\n");
+    fprintf(fp, "  \"extracts\": {");
+    write_json_times(fp, extract_times);
+    fprintf(fp, "},\n");
+
+    fprintf(fp, "  \"layers\": [");
+    for (size_t i=0; i<layer_stats.size(); i++)
+    {
+        const LayerStat& stat = layer_stats[i];
+
+        std::vector<double> times = stat.times;
+        std::sort(times.begin(), times.end());
+        double p50 = percentile(times, 50);
+
+        fprintf(fp, i == 0 ? "\n" : ",\n");
+        fprintf(fp, "    {\"name\": ");
+        write_json_string(fp, stat.name.c_str());
+        fprintf(fp, ", \"type\": ");
+        write_json_string(fp, stat.type.c_str());
+        fprintf(fp, ", \"kernel\": ");
+        write_json_string(fp, stat.kernel ? stat.kernel : "");
+        fprintf(fp, ",\n     ");
+        write_json_times(fp, times);
+        fprintf(fp, ",\n     ");
+        write_json_shapes(fp, "bottoms", stat.bottom_shapes);
+        fprintf(fp, ", ");
+        write_json_shapes(fp, "tops", stat.top_shapes);
+        fprintf(fp, ",\n     \"macs\": %.0f, \"bytes\": %.0f, \"gmacs_per_s\": %.3f, \"gbytes_per_s\": %.3f",
+                stat.macs, stat.bytes, p50 > 0 ? stat.macs / p50 / 1e6 : 0.0, p50 > 0 ? stat.bytes / p50 / 1e6 : 0.0);
+        if (!counter_fds.empty())
+        {
+            fprintf(fp, ",\n     ");
+            write_json_counters(fp, stat.counters, (int)stat.times.size(), counter_available);
+        }
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  ]\n");
+    fprintf(fp, "}\n");
+
+    fclose(fp);
+
+    return 0;
+}
+
+int Profiler::save_chrome_trace(const char* path) const
+{
+    FILE* fp = fopen(path, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", path);
+        return -1;
+    }
+
+    MutexLockGuard guard(lock);
+
+    // timestamps in us from the first event
+    double origin = 0.0;
+    for (size_t i=0; i<events.size(); i++)
+    {
+        if (i == 0 || events[i].start < origin)
+            origin = events[i].start;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (size_t i=0; i<events.size(); i++)
+    {
+        const Event& e = events[i];
+
+        fprintf(fp, i == 0 ? "\n" : ",\n");
+        if (e.stat == -1)
+        {
+            fprintf(fp, "{\"name\": \"extract\", \"cat\": \"extract\"");
+        }
+        else
+        {
+            const LayerStat& stat = layer_stats[e.stat];
+            fprintf(fp, "{\"name\": ");
+            write_json_string(fp, stat.name.c_str());
+            fprintf(fp, ", \"cat\": ");
+            write_json_string(fp, stat.type.c_str());
+        }
+        fprintf(fp, ", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                e.tid, (e.start - origin) * 1000.0, (e.end - e.start) * 1000.0);
+        if (e.stat != -1)
+        {
+            const LayerStat& stat = layer_stats[e.stat];
+            fprintf(fp, ", \"args\": {\"kernel\": ");
+            write_json_string(fp, stat.kernel ? stat.kernel : "");
+            fprintf(fp, ", \"macs\": %.0f, \"bytes\": %.0f}", stat.macs, stat.bytes);
+        }
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n]}\n");
+
+    fclose(fp);
+
+    return 0;
+}
+#endif // NCNN_STDIO
+
+} // namespace ncnn
@@ -0,0 +1,159 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef NCNN_PROFILER_H
+#define NCNN_PROFILER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "platform.h"
+#include "allocator.h"
+#include "mat.h"
+
+namespace ncnn {
+
+class Layer;
+class ThreadPool;
+
+// hardware counters read around each layer when enabled
+enum
+{
+    PROFILER_CYCLES = 0,
+    PROFILER_INSTRUCTIONS = 1,
+    PROFILER_CACHE_MISSES = 2,
+    PROFILER_BRANCH_MISSES = 3,
+    PROFILER_COUNTER_COUNT = 4
+};
+
+// readings taken when a layer starts
+struct ProfilerSample
+{
+    double time;
+    // summed over the counted threads
+    long long counters[PROFILER_COUNTER_COUNT];
+};
+
+// per layer timing of the extractors it is attached to
+// recording costs two clock reads and a locked append per layer run
+// one profiler may collect from several extractors and threads at the same time
+class Profiler
+{
+public:
+    // empty
+    Profiler();
+    // closes the hardware counters
+    ~Profiler();
+
+    // drop everything recorded so far
+    void clear();
+
+    // also count cycles, instructions, last level cache misses and branch misses
+    // of every layer run with perf_event_open, per layer ipc and misses per
+    // thousand instructions go to save_json
+    // counters are opened on the calling thread, the other threads of a
+    // num_threads wide openmp team and the workers of thread_pool, so enable it
+    // from the thread running extract with the thread count and pool given to the extractor
+    // thread_pool 0 is the default pool, it is skipped when built with NCNN_THREADPOOL off
+    // the counts cover all those threads, layers of concurrent branches see each other
+    // counters the kernel or container refuses are left out
+    // return 0 if success, -1 if no counter is available and only time is recorded
+    int enable_hardware_counters(int num_threads, ThreadPool* thread_pool = 0);
+
+    // close the hardware counters
+    void disable_hardware_counters();
+
+    // number of extract calls that ran layers
+    int extract_count() const;
+
+#if NCNN_STDIO
+    // write the statistics of every layer over all recorded runs as json
+    // time percentiles, shapes of the last run, estimated macs and bytes moved, kernel picked
+    // return 0 if success
+    int save_json(const char* path) const;
+
+    // write every recorded layer run and extract as chrome trace events
+    // open with chrome://tracing or ui.perfetto.dev
+    // return 0 if success
+    int save_chrome_trace(const char* path) const;
+#endif // NCNN_STDIO
+
+public:
+    // net calls them around each layer forward
+    // a batched forward passes the blobs of all samples one sample after another
+    void begin_layer(ProfilerSample& sample) const;
+    void end_layer(const ProfilerSample& sample, const Layer* layer, const Mat* bottom_blobs, int bottom_count, const Mat* top_blobs, int top_count, int batch = 1);
+
+    // extractor calls it around each extract that runs layers
+    void record_extract(double start, double end);
+
+protected:
+    // sum the hardware counters of all counted threads
+    void read_counters(long long* counters) const;
+
+    struct BlobShape
+    {
+        int dims;
+        int w;
+        int h;
+        int c;
+        int elempack;
+        size_t elemsize;
+    };
+
+    struct LayerStat
+    {
+        std::string name;
+        std::string type;
+        // kernel the layer picked on the last run, 0 if it has only one
+        const char* kernel;
+        std::vector<BlobShape> bottom_shapes;
+        std::vector<BlobShape> top_shapes;
+        // estimates of the last run
+        double macs;
+        double bytes;
+        // wall time of every run in ms
+        std::vector<double> times;
+        // hardware counters summed over all runs
+        long long counters[PROFILER_COUNTER_COUNT];
+    };
+
+    struct Event
+    {
+        // index into layer_stats, -1 for an extract
+        int stat;
+        int tid;
+        double start;
+        double end;
+    };
+
+    mutable Mutex lock;
+    std::map<const Layer*, int> layer_stat_index;
+    std::vector<LayerStat> layer_stats;
+    std::vector<double> extract_times;
+    std::vector<Event> events;
+
+    // perf event fds, PROFILER_COUNTER_COUNT per counted thread, -1 if unavailable
+    std::vector<int> counter_fds;
+    // whether each counter could be opened
+    bool counter_available[PROFILER_COUNTER_COUNT];
+private:
+    // owns the counter fds
+    Profiler(const Profiler&);
+    Profiler& operator=(const Profiler&);
+};
+
+} // namespace ncnn
+
+#endif // NCNN_PROFILER_H
@@ -0,0 +1,539 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "threadpool.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#if defined __linux__ || defined __ANDROID__
+#include <sys/syscall.h>
+#endif
+
+#include "cpu.h"
+#include "layer.h"
+
+namespace ncnn {
+
+#ifdef _WIN32
+static inline int atomic_add(volatile int* ptr, int value)
+{
+    return InterlockedExchangeAdd((volatile LONG*)ptr, value);
+}
+
+static inline bool atomic_cas(volatile int* ptr, int old_value, int new_value)
+{
+    return InterlockedCompareExchange((volatile LONG*)ptr, new_value, old_value) == old_value;
+}
+
+static inline void memory_barrier()
+{
+    MemoryBarrier();
+}
+
+static inline void cpu_relax()
+{
+    YieldProcessor();
+}
+
+static inline void thread_yield()
+{
+    SwitchToThread();
+}
+#else // _WIN32
+static inline int atomic_add(volatile int* ptr, int value)
+{
+    return __sync_fetch_and_add(ptr, value);
+}
+
+static inline bool atomic_cas(volatile int* ptr, int old_value, int new_value)
+{
+    return __sync_bool_compare_and_swap(ptr, old_value, new_value);
+}
+
+static inline void memory_barrier()
+{
+    __sync_synchronize();
+}
+
+static inline void cpu_relax()
+{
+#if defined __i386__ || defined __x86_64__
+    __builtin_ia32_pause();
+#elif defined __arm__ || defined __aarch64__
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static inline void thread_yield()
+{
+    sched_yield();
+}
+#endif // _WIN32
+
+ParallelTask::~ParallelTask()
+{
+}
+
+struct ThreadPool::Worker
+{
+    ThreadPool* pool;
+
+    // bumped by a caller to wake the worker for a new loop
+    volatile int sequence;
+    volatile int stop;
+    // set while the worker found no loop to join, cleared by the caller waking it
+    volatile int idle;
+    // set while waiting on cond
+    volatile int sleeping;
+    // kernel thread id for the affinity, 0 until the thread runs
+    volatile int tid;
+
+#ifdef _WIN32
+    HANDLE thread;
+    SRWLOCK lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+
+    void run();
+    void wake();
+
+#ifdef _WIN32
+    static DWORD WINAPI main(LPVOID args)
+    {
+        ((Worker*)args)->run();
+        return 0;
+    }
+#else
+    static void* main(void* args)
+    {
+        ((Worker*)args)->run();
+        return 0;
+    }
+#endif
+};
+
+// one parallel_for call, lives on the stack of its caller
+struct ThreadPool::Loop
+{
+    const ParallelTask* task;
+    int size;
+    volatile int next_index;
+    // workers allowed to join besides the caller
+    int max_helpers;
+    // workers joined so far, guarded by the list lock
+    int helpers;
+    // workers joined and not finished yet
+    volatile int pending;
+    Loop* next;
+};
+
+void ThreadPool::Worker::run()
+{
+#if defined __linux__ || defined __ANDROID__
+    tid = (int)syscall(__NR_gettid);
+#else
+    tid = -1;
+#endif
+
+    int seen = 0;
+    for (;;)
+    {
+        Loop* loop = pool->join_loop();
+        if (!loop)
+        {
+            // a caller opening a loop after this either sees idle or is seen here
+            idle = 1;
+            memory_barrier();
+
+            loop = pool->join_loop();
+            if (loop)
+                idle = 0;
+        }
+
+        if (loop)
+        {
+            pool->run_loop(*loop);
+
+            memory_barrier();
+            atomic_add(&loop->pending, -1);
+            continue;
+        }
+
+        for (int i=0; i<pool->spin_count; i++)
+        {
+            if (sequence != seen || stop)
+                break;
+
+            cpu_relax();
+        }
+
+        if (sequence == seen && !stop)
+        {
+#ifdef _WIN32
+            AcquireSRWLockExclusive(&lock);
+            sleeping = 1;
+            memory_barrier();
+            while (sequence == seen && !stop)
+                SleepConditionVariableSRW(&cond, &lock, INFINITE, 0);
+            sleeping = 0;
+            ReleaseSRWLockExclusive(&lock);
+#else
+            pthread_mutex_lock(&lock);
+            sleeping = 1;
+            memory_barrier();
+            while (sequence == seen && !stop)
+                pthread_cond_wait(&cond, &lock);
+            sleeping = 0;
+            pthread_mutex_unlock(&lock);
+#endif
+        }
+
+        if (stop)
+            break;
+
+        seen = sequence;
+        memory_barrier();
+    }
+}
+
+void ThreadPool::Worker::wake()
+{
+    // a worker going to sleep sets sleeping before checking sequence again under the lock
+    memory_barrier();
+    if (!sleeping)
+        return;
+
+#ifdef _WIN32
+    AcquireSRWLockExclusive(&lock);
+    WakeConditionVariable(&cond);
+    ReleaseSRWLockExclusive(&lock);
+#else
+    pthread_mutex_lock(&lock);
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+#endif
+}
+
+ThreadPool::ThreadPool(int _num_threads)
+{
+    num_threads = std::max(_num_threads, 1);
+    spin_count = 10000;
+
+    loops = 0;
+    list_lock = 0;
+}
+
+ThreadPool::~ThreadPool()
+{
+    for (size_t i=0; i<workers.size(); i++)
+    {
+        Worker* w = workers[i];
+
+        w->stop = 1;
+        memory_barrier();
+
+#ifdef _WIN32
+        AcquireSRWLockExclusive(&w->lock);
+        WakeConditionVariable(&w->cond);
+        ReleaseSRWLockExclusive(&w->lock);
+
+        WaitForSingleObject(w->thread, INFINITE);
+        CloseHandle(w->thread);
+#else
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+
+        pthread_join(w->thread, 0);
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+#endif
+
+        delete w;
+    }
+}
+
+int ThreadPool::get_num_threads() const
+{
+    return num_threads;
+}
+
+void ThreadPool::set_spin_count(int _spin_count)
+{
+    spin_count = _spin_count;
+}
+
+int ThreadPool::set_cpu_affinity(const std::vector<int>& cpuids)
+{
+#if defined __linux__ || defined __ANDROID__
+    if (cpuids.empty())
+        return -1;
+
+    std::vector<int> tids;
+    if (get_worker_tids(tids) != 0)
+        return -1;
+
+    int ret = 0;
+    for (size_t i=0; i<tids.size(); i++)
+    {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpuids[i % cpuids.size()], &mask);
+
+        int syscallret = syscall(__NR_sched_setaffinity, tids[i], sizeof(mask), &mask);
+        if (syscallret)
+        {
+            fprintf(stderr, "syscall error %d\n", syscallret);
+            ret = -1;
+        }
+    }
+
+    return ret;
+#else
+    (void)cpuids;
+    return -1;
+#endif
+}
+
+int ThreadPool::get_worker_tids(std::vector<int>& tids)
+{
+#if defined __linux__ || defined __ANDROID__
+    lock_list();
+
+    int ret = start_workers();
+
+    tids.clear();
+    for (size_t i=0; i<workers.size(); i++)
+    {
+        const Worker* w = workers[i];
+
+        while (w->tid == 0)
+            thread_yield();
+
+        tids.push_back((int)w->tid);
+    }
+
+    unlock_list();
+
+    return ret;
+#else
+    (void)tids;
+    return -1;
+#endif
+}
+
+int ThreadPool::start_workers()
+{
+    while ((int)workers.size() < num_threads - 1)
+    {
+        Worker* w = new Worker;
+        w->pool = this;
+        w->sequence = 0;
+        w->stop = 0;
+        w->idle = 0;
+        w->sleeping = 0;
+        w->tid = 0;
+
+#ifdef _WIN32
+        InitializeSRWLock(&w->lock);
+        InitializeConditionVariable(&w->cond);
+        w->thread = CreateThread(0, 0, Worker::main, w, 0, 0);
+        if (!w->thread)
+        {
+            delete w;
+            return -1;
+        }
+#else
+        pthread_mutex_init(&w->lock, 0);
+        pthread_cond_init(&w->cond, 0);
+        if (pthread_create(&w->thread, 0, Worker::main, w) != 0)
+        {
+            pthread_cond_destroy(&w->cond);
+            pthread_mutex_destroy(&w->lock);
+            delete w;
+            return -1;
+        }
+#endif
+
+        workers.push_back(w);
+    }
+
+    return 0;
+}
+
+void ThreadPool::lock_list()
+{
+    for (int i=0; !atomic_cas(&list_lock, 0, 1); i++)
+    {
+        if (i < 100)
+            cpu_relax();
+        else
+            thread_yield();
+    }
+}
+
+void ThreadPool::unlock_list()
+{
+    memory_barrier();
+    list_lock = 0;
+}
+
+ThreadPool::Loop* ThreadPool::join_loop()
+{
+    lock_list();
+
+    Loop* loop = loops;
+    while (loop && (loop->helpers >= loop->max_helpers || loop->next_index >= loop->size))
+        loop = loop->next;
+
+    if (loop)
+    {
+        loop->helpers++;
+        atomic_add(&loop->pending, 1);
+    }
+
+    unlock_list();
+
+    return loop;
+}
+
+void ThreadPool::run_loop(Loop& loop)
+{
+    for (;;)
+    {
+        int i = atomic_add(&loop.next_index, 1);
+        if (i >= loop.size)
+            break;
+
+        loop.task->execute(i);
+    }
+}
+
+void ThreadPool::parallel_for(const ParallelTask& task, int n, int _num_threads)
+{
+    const int loop_threads = std::min(std::min(_num_threads, num_threads), n);
+
+    if (loop_threads <= 1)
+    {
+        for (int i=0; i<n; i++)
+        {
+            task.execute(i);
+        }
+        return;
+    }
+
+    Loop loop;
+    loop.task = &task;
+    loop.size = n;
+    loop.next_index = 0;
+    loop.max_helpers = loop_threads - 1;
+    loop.helpers = 0;
+    loop.pending = 0;
+
+    lock_list();
+
+    // workers fewer than asked run the loop on the ones started
+    start_workers();
+
+    loop.next = loops;
+    loops = &loop;
+    memory_barrier();
+
+    // busy workers look for it once done with their own loop
+    int woken = 0;
+    for (size_t i=0; i<workers.size() && woken < loop.max_helpers; i++)
+    {
+        Worker* w = workers[i];
+        if (!w->idle)
+            continue;
+
+        w->idle = 0;
+        w->sequence = w->sequence + 1;
+        w->wake();
+        woken++;
+    }
+
+    unlock_list();
+
+    run_loop(loop);
+
+    // no worker may join once it is off the list
+    lock_list();
+    Loop* volatile* p = &loops;
+    while (*p != &loop)
+        p = &(*p)->next;
+    *p = loop.next;
+    unlock_list();
+
+    // the others are on their last index at most
+    // meanwhile help the loops they open, a branch may run long
+    for (int i=0; loop.pending != 0; i++)
+    {
+        Loop* other = loops ? join_loop() : 0;
+        if (other)
+        {
+            run_loop(*other);
+
+            memory_barrier();
+            atomic_add(&other->pending, -1);
+            i = 0;
+            continue;
+        }
+
+        if (i < spin_count)
+            cpu_relax();
+        else
+            thread_yield();
+    }
+
+    memory_barrier();
+}
+
+ThreadPool* get_default_thread_pool()
+{
+    // never deleted, joining threads in static destructors hangs on some platforms
+    static ThreadPool* default_thread_pool = new ThreadPool(get_cpu_count());
+    return default_thread_pool;
+}
+
+void parallel_for(const ParallelTask& task, int n, const Option& opt)
+{
+#if NCNN_THREADPOOL
+    ThreadPool* pool = opt.thread_pool ? opt.thread_pool : get_default_thread_pool();
+    pool->parallel_for(task, n, opt.num_threads);
+#else
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int i=0; i<n; i++)
+    {
+        task.execute(i);
+    }
+#endif // NCNN_THREADPOOL
+}
+
+} // namespace ncnn
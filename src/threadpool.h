@@ -0,0 +1,116 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef NCNN_THREADPOOL_H
+#define NCNN_THREADPOOL_H
+
+#include <vector>
+#include "platform.h"
+
+namespace ncnn {
+
+class Option;
+
+// the body of a parallel loop
+// execute is called once for every index, from several threads at the same time
+class ParallelTask
+{
+public:
+    virtual ~ParallelTask();
+    virtual void execute(int i) const = 0;
+};
+
+// persistent worker threads running parallel loops
+// the thread calling parallel_for takes part as the first thread of the loop
+// idle workers poll for the next loop for a while, then sleep until woken
+class ThreadPool
+{
+public:
+    // num_threads includes the calling thread, workers are started on first use
+    ThreadPool(int num_threads);
+    // stops and joins the workers
+    ~ThreadPool();
+
+    int get_num_threads() const;
+
+    // polls of an idle worker before it goes to sleep
+    // waking from sleep costs a syscall, polling burns the core between layers
+    // 0 sleeps at once
+    // default 10000
+    void set_spin_count(int spin_count);
+
+    // pin every worker to one cpu, worker i runs on cpuids[i % cpuids.size()]
+    // the calling thread is not touched, use set_cpu_powersave for it
+    // only implemented on linux and android at the moment
+    // return 0 if success
+    int set_cpu_affinity(const std::vector<int>& cpuids);
+
+    // kernel thread ids of the workers, starting them if not yet
+    // for tools following every thread of a loop like the profiler counters
+    // only implemented on linux and android at the moment
+    // return 0 if success
+    int get_worker_tids(std::vector<int>& tids);
+
+    // run task.execute(i) for every i in [0, n) on at most num_threads threads
+    // indexes are handed out one at a time to whichever thread is free
+    // returns when all of them are done
+    // loops called from several threads at once, or nested in a loop of this pool,
+    // share the idle workers, each caller always works on its own loop
+    // and helps the others while waiting for the last indexes of its own
+    void parallel_for(const ParallelTask& task, int n, int num_threads);
+
+protected:
+    // start the workers if not yet, with the list locked
+    // return 0 if success
+    int start_workers();
+
+    struct Worker;
+    friend struct Worker;
+    struct Loop;
+
+    void lock_list();
+    void unlock_list();
+
+    // take a seat in an open loop with indexes left, 0 if none
+    Loop* join_loop();
+
+    // run the indexes of the loop until none is left
+    void run_loop(Loop& loop);
+
+private:
+    // owns the worker threads
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    int num_threads;
+    int spin_count;
+    std::vector<Worker*> workers;
+
+    // loops open for the workers to join, newest first
+    Loop* volatile loops;
+    // spin lock over loops and workers
+    volatile int list_lock;
+};
+
+// the pool shared by the extractors without one of their own
+// sized by get_cpu_count()
+ThreadPool* get_default_thread_pool();
+
+// run task.execute(i) for every i in [0, n) on opt.num_threads threads
+// uses opt.thread_pool or the default pool, or openmp when built with NCNN_THREADPOOL off
+void parallel_for(const ParallelTask& task, int n, const Option& opt);
+
+} // namespace ncnn
+
+#endif // NCNN_THREADPOOL_H
@@ -0,0 +1,769 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+// post-training int8 calibration
+//
+// runs the float network over the calibration images and writes the scale table
+// that ncnnoptimize applies to produce an int8 model
+//
+// the table is plain text, one entry per line, lines starting with # are comments
+//   weight <layer name> <scale of output channel 0> <scale of output channel 1> ...
+//   blob <blob name> <scale>
+// a value v is quantized to round(v * scale) saturated to [-127, 127]
+// there is a weight entry for every Convolution ConvolutionDepthWise and InnerProduct
+// and a blob entry for the bottom blob of each of them
+
+#include <dirent.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "layer_type.h"
+#include "net.h"
+
+#include "layer/convolution.h"
+#include "layer/convolutiondepthwise.h"
+#include "layer/innerproduct.h"
+#include "layer/quantize_int8.h"
+
+// binary pgm and ppm with 8-bit samples
+static unsigned char* read_pnm(const char* path, int& w, int& h, int& c)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp)
+        return 0;
+
+    char magic[3] = {0};
+    int maxval = 0;
+    int nscan = fscanf(fp, "%2s", magic);
+
+    // skip comments between the header fields
+    int fields[3];
+    for (int i=0; nscan == 1 && i<3; i++)
+    {
+        int ch = fgetc(fp);
+        while (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '#')
+        {
+            if (ch == '#')
+            {
+                while (ch != '\n' && ch != EOF)
+                    ch = fgetc(fp);
+            }
+            ch = fgetc(fp);
+        }
+        ungetc(ch, fp);
+
+        nscan = fscanf(fp, "%d", &fields[i]);
+    }
+
+    if (nscan != 1 || (strcmp(magic, "P5") != 0 && strcmp(magic, "P6") != 0))
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    w = fields[0];
+    h = fields[1];
+    maxval = fields[2];
+    c = magic[1] == '6' ? 3 : 1;
+
+    // a single whitespace ends the header
+    fgetc(fp);
+
+    if (w <= 0 || h <= 0 || maxval <= 0 || maxval > 255)
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    unsigned char* pixels = (unsigned char*)malloc(w * h * c);
+    if (!pixels || fread(pixels, 1, w * h * c, fp) != (size_t)(w * h * c))
+    {
+        free(pixels);
+        fclose(fp);
+        return 0;
+    }
+
+    fclose(fp);
+
+    return pixels;
+}
+
+static int list_images(const char* imagedir, std::vector<std::string>& imagepaths)
+{
+    DIR* dir = opendir(imagedir);
+    if (!dir)
+    {
+        fprintf(stderr, "opendir %s failed\n", imagedir);
+        return -1;
+    }
+
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != 0)
+    {
+        const char* ext = strrchr(ent->d_name, '.');
+        if (!ext || (strcmp(ext, ".ppm") != 0 && strcmp(ext, ".pgm") != 0 && strcmp(ext, ".pnm") != 0))
+            continue;
+
+        imagepaths.push_back(std::string(imagedir) + "/" + ent->d_name);
+    }
+
+    closedir(dir);
+
+    std::sort(imagepaths.begin(), imagepaths.end());
+
+    return 0;
+}
+
+// comma separated floats, a single value is used for every channel
+static void parse_floats(const char* s, float* vals, int count)
+{
+    int n = 0;
+    while (n < count && *s)
+    {
+        vals[n++] = (float)atof(s);
+
+        s = strchr(s, ',');
+        if (!s)
+            break;
+        s++;
+    }
+
+    for (int i=n; n > 0 && i<count; i++)
+    {
+        vals[i] = vals[n - 1];
+    }
+}
+
+// thresholds from the histogram of absolute values, bin i covers [i, i+1) * bin_width
+
+// the threshold whose clipped and int8 merged distribution loses the least information
+// to the original one, measured as the kl divergence as TensorRT does
+static float threshold_kl(const std::vector<double>& hist, float bin_width)
+{
+    const int num_bins = hist.size();
+    const int target_bins = 128;
+
+    double total = 0;
+    for (int i=0; i<num_bins; i++)
+    {
+        total += hist[i];
+    }
+
+    if (total == 0)
+        return 0.f;
+
+    std::vector<double> p(num_bins);
+    std::vector<double> q(num_bins);
+
+    int best_i = num_bins;
+    double best_kl = DBL_MAX;
+
+    double outliers = 0;
+    for (int i=target_bins; i<num_bins; i++)
+    {
+        outliers += hist[i];
+    }
+
+    for (int i=target_bins; i<=num_bins; i++)
+    {
+        // the clipped distribution, outliers are folded into the last bin
+        for (int j=0; j<i; j++)
+        {
+            p[j] = hist[j];
+        }
+        p[i - 1] += outliers;
+
+        if (i < num_bins)
+            outliers -= hist[i];
+
+        // merge into the int8 levels and spread back over the non empty bins
+        const int num_merged = i / target_bins;
+        for (int k=0; k<target_bins; k++)
+        {
+            const int start = k * num_merged;
+            const int end = k == target_bins - 1 ? i : start + num_merged;
+
+            double sum = 0;
+            int nonzero = 0;
+            for (int j=start; j<end; j++)
+            {
+                sum += hist[j];
+                nonzero += hist[j] != 0;
+            }
+
+            for (int j=start; j<end; j++)
+            {
+                q[j] = hist[j] != 0 ? sum / nonzero : 0;
+            }
+        }
+
+        double psum = 0;
+        double qsum = 0;
+        for (int j=0; j<i; j++)
+        {
+            psum += p[j];
+            qsum += q[j];
+        }
+
+        if (qsum == 0)
+            continue;
+
+        // q keeps the scale of p, so the mass clipped away counts against the
+        // threshold, otherwise a range holding a single non empty bin matches exactly
+        double kl = 0;
+        for (int j=0; j<i; j++)
+        {
+            if (p[j] == 0)
+                continue;
+
+            const double pj = p[j] / psum;
+            const double qj = q[j] == 0 ? 1e-12 : q[j] / psum;
+            kl += pj * log(pj / qj);
+        }
+
+        if (kl < best_kl)
+        {
+            best_kl = kl;
+            best_i = i;
+        }
+    }
+
+    return (best_i + 0.5f) * bin_width;
+}
+
+// the smallest threshold keeping the given percentage of the values unclipped
+static float threshold_percentile(const std::vector<double>& hist, float bin_width, float percentile)
+{
+    const int num_bins = hist.size();
+
+    double total = 0;
+    for (int i=0; i<num_bins; i++)
+    {
+        total += hist[i];
+    }
+
+    if (total == 0)
+        return 0.f;
+
+    const double target = total * percentile / 100.0;
+
+    double sum = 0;
+    for (int i=0; i<num_bins; i++)
+    {
+        sum += hist[i];
+        if (sum >= target)
+            return (i + 1) * bin_width;
+    }
+
+    return num_bins * bin_width;
+}
+
+namespace ncnn {
+
+class NetCalibrate : public Net
+{
+public:
+    NetCalibrate();
+
+    // find the layers to quantize and their bottom blobs
+    int prepare();
+
+    // run one calibration image, pass 0 collects the absmax, pass 1 the histograms
+    // pass 2 measures the error of every int8 layer against the float one
+    int run(const Mat& in, int pass);
+
+    int compute_scales();
+
+    int save_table(const char* tablepath) const;
+
+    void print_report() const;
+
+public:
+    std::string input_name;
+    int method; // 0=kl 1=percentile
+    float percentile;
+
+protected:
+    int run_int8(const Layer* layer, const Mat& bottom_blob, const Mat& top_blob_ref, int index);
+
+    struct BlobStat
+    {
+        int blob_index;
+        float absmax;
+        std::vector<double> hist;
+        float threshold;
+        float scale;
+    };
+
+    struct LayerStat
+    {
+        int layer_index;
+        int stat_index;
+        Mat weight_scales;
+
+        // error accumulated over the calibration images
+        double sqerr;
+        double sqref;
+        double dot;
+        double sqint8;
+    };
+
+    std::vector<BlobStat> blob_stats;
+    std::vector<LayerStat> layer_stats;
+};
+
+static const int num_histogram_bins = 2048;
+
+NetCalibrate::NetCalibrate()
+{
+    method = 0;
+    percentile = 99.99f;
+}
+
+template<typename T>
+static Mat compute_weight_scales(const T* op)
+{
+    const int size = op->weight_data.w / op->num_output;
+
+    Mat scales(op->num_output);
+    for (int p=0; p<op->num_output; p++)
+    {
+        const float* kptr = (const float*)op->weight_data + size * p;
+
+        float absmax = 0.f;
+        for (int i=0; i<size; i++)
+        {
+            absmax = std::max(absmax, (float)fabs(kptr[i]));
+        }
+
+        scales[p] = absmax == 0.f ? 0.f : 127.f / absmax;
+    }
+
+    return scales;
+}
+
+int NetCalibrate::prepare()
+{
+    std::vector<int> blob_stat_index(blobs.size(), -1);
+
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        const Layer* layer = layers[i];
+
+        Mat weight_scales;
+        if (layer->typeindex == LayerType::Convolution)
+            weight_scales = compute_weight_scales((const Convolution*)layer);
+        else if (layer->typeindex == LayerType::ConvolutionDepthWise)
+            weight_scales = compute_weight_scales((const ConvolutionDepthWise*)layer);
+        else if (layer->typeindex == LayerType::InnerProduct)
+            weight_scales = compute_weight_scales((const InnerProduct*)layer);
+        else
+            continue;
+
+        const int blob_index = layer->bottoms[0];
+        if (blob_stat_index[blob_index] == -1)
+        {
+            BlobStat bs;
+            bs.blob_index = blob_index;
+            bs.absmax = 0.f;
+            bs.hist.resize(num_histogram_bins, 0);
+            bs.threshold = 0.f;
+            bs.scale = 0.f;
+
+            blob_stat_index[blob_index] = blob_stats.size();
+            blob_stats.push_back(bs);
+        }
+
+        LayerStat ls;
+        ls.layer_index = i;
+        ls.stat_index = blob_stat_index[blob_index];
+        ls.weight_scales = weight_scales;
+        ls.sqerr = 0;
+        ls.sqref = 0;
+        ls.dot = 0;
+        ls.sqint8 = 0;
+
+        layer_stats.push_back(ls);
+    }
+
+    if (layer_stats.empty())
+    {
+        fprintf(stderr, "no layer to quantize\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int NetCalibrate::run(const Mat& in, int pass)
+{
+    Extractor ex = create_extractor();
+    ex.set_light_mode(false);
+    ex.input(input_name.c_str(), in);
+
+    for (size_t i=0; i<blob_stats.size() && pass < 2; i++)
+    {
+        BlobStat& bs = blob_stats[i];
+
+        Mat blob;
+        int ret = ex.extract(bs.blob_index, blob);
+        if (ret != 0)
+        {
+            fprintf(stderr, "extract %s failed\n", blobs[bs.blob_index].name.c_str());
+            return -1;
+        }
+
+        const int size = blob.w * blob.h;
+        const float bin_width = bs.absmax / num_histogram_bins;
+
+        for (int q=0; q<blob.c; q++)
+        {
+            const float* ptr = blob.channel(q);
+
+            for (int j=0; j<size; j++)
+            {
+                float v = fabs(ptr[j]);
+
+                if (pass == 0)
+                {
+                    bs.absmax = std::max(bs.absmax, v);
+                    continue;
+                }
+
+                // zeros mostly come from relu and carry no range information
+                if (v == 0.f)
+                    continue;
+
+                int bin = std::min((int)(v / bin_width), num_histogram_bins - 1);
+                bs.hist[bin] += 1;
+            }
+        }
+    }
+
+    for (size_t i=0; i<layer_stats.size() && pass == 2; i++)
+    {
+        const Layer* layer = layers[layer_stats[i].layer_index];
+
+        Mat bottom_blob;
+        Mat top_blob;
+        int ret = ex.extract(layer->bottoms[0], bottom_blob);
+        if (ret == 0)
+            ret = ex.extract(layer->tops[0], top_blob);
+        if (ret != 0)
+        {
+            fprintf(stderr, "extract %s failed\n", layer->name.c_str());
+            return -1;
+        }
+
+        ret = run_int8(layer, bottom_blob, top_blob, i);
+        if (ret != 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+template<typename T>
+static int forward_int8_copy(const Layer* layer, const Mat& weight_scales, float bottom_scale, const Mat& bottom_blob, Mat& top_blob)
+{
+    // the generic layer with the calibrated scales, weights are shared with the float one
+    T op(*(const T*)layer);
+    op.int8_scale_term = 1;
+    op.weight_data_int8_scales = weight_scales;
+    op.bottom_blob_int8_scale = bottom_scale;
+    op.use_int8_inference = true;
+
+    int ret = prepare_int8_weights(op.weight_data, op.weight_data_int8, op.weight_data_int8_scales, op.num_output, true);
+    if (ret != 0)
+        return ret;
+
+    return op.forward(bottom_blob, top_blob, get_default_option());
+}
+
+int NetCalibrate::run_int8(const Layer* layer, const Mat& bottom_blob, const Mat& top_blob_ref, int index)
+{
+    LayerStat& ls = layer_stats[index];
+    const float bottom_scale = blob_stats[ls.stat_index].scale;
+
+    Mat top_blob;
+    int ret = 0;
+    if (layer->typeindex == LayerType::Convolution)
+        ret = forward_int8_copy<Convolution>(layer, ls.weight_scales, bottom_scale, bottom_blob, top_blob);
+    else if (layer->typeindex == LayerType::ConvolutionDepthWise)
+        ret = forward_int8_copy<ConvolutionDepthWise>(layer, ls.weight_scales, bottom_scale, bottom_blob, top_blob);
+    else
+        ret = forward_int8_copy<InnerProduct>(layer, ls.weight_scales, bottom_scale, bottom_blob, top_blob);
+
+    if (ret != 0)
+    {
+        fprintf(stderr, "layer %s int8 forward failed\n", layer->name.c_str());
+        return ret;
+    }
+
+    const int size = top_blob.w * top_blob.h;
+    for (int q=0; q<top_blob.c; q++)
+    {
+        const float* ptr = top_blob.channel(q);
+        const float* refptr = top_blob_ref.channel(q);
+
+        for (int j=0; j<size; j++)
+        {
+            double diff = ptr[j] - refptr[j];
+            ls.sqerr += diff * diff;
+            ls.sqref += (double)refptr[j] * refptr[j];
+            ls.dot += (double)ptr[j] * refptr[j];
+            ls.sqint8 += (double)ptr[j] * ptr[j];
+        }
+    }
+
+    return 0;
+}
+
+int NetCalibrate::compute_scales()
+{
+    for (size_t i=0; i<blob_stats.size(); i++)
+    {
+        BlobStat& bs = blob_stats[i];
+
+        const float bin_width = bs.absmax / num_histogram_bins;
+
+        if (method == 0)
+            bs.threshold = threshold_kl(bs.hist, bin_width);
+        else
+            bs.threshold = threshold_percentile(bs.hist, bin_width, percentile);
+
+        bs.scale = bs.threshold == 0.f ? 0.f : 127.f / bs.threshold;
+    }
+
+    return 0;
+}
+
+int NetCalibrate::save_table(const char* tablepath) const
+{
+    FILE* fp = fopen(tablepath, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", tablepath);
+        return -1;
+    }
+
+    fprintf(fp, "# ncnn int8 scale table\n");
+    fprintf(fp, "# weight <layer name> <scale of each output channel>\n");
+    fprintf(fp, "# blob <blob name> <scale>\n");
+
+    for (size_t i=0; i<layer_stats.size(); i++)
+    {
+        const LayerStat& ls = layer_stats[i];
+
+        fprintf(fp, "weight %s", layers[ls.layer_index]->name.c_str());
+        for (int p=0; p<ls.weight_scales.w; p++)
+        {
+            fprintf(fp, " %e", ls.weight_scales[p]);
+        }
+        fprintf(fp, "\n");
+    }
+
+    for (size_t i=0; i<blob_stats.size(); i++)
+    {
+        const BlobStat& bs = blob_stats[i];
+
+        fprintf(fp, "blob %s %e\n", blobs[bs.blob_index].name.c_str(), bs.scale);
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+void NetCalibrate::print_report() const
+{
+    fprintf(stdout, "%-24s %-20s %-24s %12s %12s %10s %10s\n", "layer", "type", "bottom", "absmax", "threshold", "relerr", "cosine");
+
+    for (size_t i=0; i<layer_stats.size(); i++)
+    {
+        const LayerStat& ls = layer_stats[i];
+        const BlobStat& bs = blob_stats[ls.stat_index];
+        const Layer* layer = layers[ls.layer_index];
+
+        // relative l2 error and cosine similarity of the int8 output against the float one
+        double relerr = ls.sqref == 0 ? sqrt(ls.sqerr) : sqrt(ls.sqerr / ls.sqref);
+        double cosine = ls.sqref == 0 || ls.sqint8 == 0 ? 0 : ls.dot / sqrt(ls.sqref * ls.sqint8);
+
+        fprintf(stdout, "%-24s %-20s %-24s %12.6f %12.6f %10.6f %10.6f\n", layer->name.c_str(), layer->type.c_str(), blobs[bs.blob_index].name.c_str(), bs.absmax, bs.threshold, relerr, cosine);
+    }
+}
+
+} // namespace ncnn
+
+static void print_usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [inparam] [inbin] [imagedir] [outtable] [key=value]...\n", argv0);
+    fprintf(stderr, "  input=data              input blob name\n");
+    fprintf(stderr, "  size=224,224            resize the images to width,height\n");
+    fprintf(stderr, "  pixel=RGB               feed the images as RGB, BGR or GRAY\n");
+    fprintf(stderr, "  mean=0,0,0              per channel mean subtracted\n");
+    fprintf(stderr, "  norm=1,1,1              per channel factor applied after the mean\n");
+    fprintf(stderr, "  method=kl               kl or percentile\n");
+    fprintf(stderr, "  percentile=99.99        kept percentage for method=percentile\n");
+    fprintf(stderr, "imagedir holds the calibration images as binary ppm or pgm\n");
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 5)
+    {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    const char* inparam = argv[1];
+    const char* inbin = argv[2];
+    const char* imagedir = argv[3];
+    const char* outtable = argv[4];
+
+    std::string input_name = "data";
+    int target_width = 224;
+    int target_height = 224;
+    int pixel_type = ncnn::Mat::PIXEL_RGB;
+    float mean_vals[3] = {0.f, 0.f, 0.f};
+    float norm_vals[3] = {1.f, 1.f, 1.f};
+    int method = 0;
+    float percentile = 99.99f;
+
+    for (int i=5; i<argc; i++)
+    {
+        const char* eq = strchr(argv[i], '=');
+        if (!eq)
+        {
+            print_usage(argv[0]);
+            return -1;
+        }
+
+        std::string key(argv[i], eq - argv[i]);
+        const char* value = eq + 1;
+
+        if (key == "input")
+        {
+            input_name = value;
+        }
+        else if (key == "size")
+        {
+            float size[2] = {224.f, 224.f};
+            parse_floats(value, size, 2);
+            target_width = (int)size[0];
+            target_height = (int)size[1];
+        }
+        else if (key == "pixel" && strcmp(value, "RGB") == 0)
+            pixel_type = ncnn::Mat::PIXEL_RGB;
+        else if (key == "pixel" && strcmp(value, "BGR") == 0)
+            pixel_type = ncnn::Mat::PIXEL_BGR;
+        else if (key == "pixel" && strcmp(value, "GRAY") == 0)
+            pixel_type = ncnn::Mat::PIXEL_GRAY;
+        else if (key == "mean")
+            parse_floats(value, mean_vals, 3);
+        else if (key == "norm")
+            parse_floats(value, norm_vals, 3);
+        else if (key == "method" && strcmp(value, "kl") == 0)
+            method = 0;
+        else if (key == "method" && strcmp(value, "percentile") == 0)
+            method = 1;
+        else if (key == "percentile")
+            percentile = (float)atof(value);
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return -1;
+        }
+    }
+
+    std::vector<std::string> imagepaths;
+    if (list_images(imagedir, imagepaths) != 0)
+        return -1;
+
+    if (imagepaths.empty())
+    {
+        fprintf(stderr, "no ppm or pgm image in %s\n", imagedir);
+        return -1;
+    }
+
+    // calibrate on the float network, also for models carrying int8 scales already
+    // the layers keep their float weights for the weight scales
+    ncnn::Option opt = ncnn::get_default_option();
+    opt.use_int8_inference = false;
+    opt.lightmode = false;
+    ncnn::set_default_option(opt);
+
+    ncnn::NetCalibrate net;
+    net.input_name = input_name;
+    net.method = method;
+    net.percentile = percentile;
+
+    if (net.load_param(inparam) != 0)
+        return -1;
+
+    if (net.load_model(inbin) != 0)
+        return -1;
+
+    if (net.prepare() != 0)
+        return -1;
+
+    for (int pass=0; pass<3; pass++)
+    {
+        if (pass == 2)
+            net.compute_scales();
+
+        for (size_t i=0; i<imagepaths.size(); i++)
+        {
+            int w;
+            int h;
+            int c;
+            unsigned char* pixels = read_pnm(imagepaths[i].c_str(), w, h, c);
+            if (!pixels)
+            {
+                fprintf(stderr, "read %s failed\n", imagepaths[i].c_str());
+                return -1;
+            }
+
+            // pgm is fed as gray, ppm as rgb converted to the requested order
+            int type = pixel_type;
+            if (c == 1)
+                type = ncnn::Mat::PIXEL_GRAY | (pixel_type == ncnn::Mat::PIXEL_GRAY ? 0 : pixel_type << ncnn::Mat::PIXEL_CONVERT_SHIFT);
+            else if (pixel_type != ncnn::Mat::PIXEL_RGB)
+                type = ncnn::Mat::PIXEL_RGB | (pixel_type << ncnn::Mat::PIXEL_CONVERT_SHIFT);
+
+            ncnn::Mat in = ncnn::Mat::from_pixels_resize(pixels, type, w, h, target_width, target_height);
+            free(pixels);
+
+            in.substract_mean_normalize(mean_vals, norm_vals);
+
+            if (net.run(in, pass) != 0)
+                return -1;
+        }
+
+        fprintf(stderr, "pass %d done, %d images\n", pass, (int)imagepaths.size());
+    }
+
+    if (net.save_table(outtable) != 0)
+        return -1;
+
+    net.print_report();
+
+    return 0;
+}
@@ -0,0 +1,527 @@
+// Tencent is pleased to support the open source community by making ncnn available.
+//
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "layer_type.h"
+#include "modelbin.h"
+#include "net.h"
+
+#include "layer/convolution.h"
+#include "layer/convolutiondepthwise.h"
+#include "layer/innerproduct.h"
+#include "layer/quantize_int8.h"
+
+// layer name -> key=value pairs as written in the param file
+static std::map< std::string, std::vector< std::pair<int, std::string> > > layer_params;
+
+static int read_layer_params(const char* parampath)
+{
+    FILE* fp = fopen(parampath, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", parampath);
+        return -1;
+    }
+
+    int magic = 0;
+    fscanf(fp, "%d", &magic);
+
+    int layer_count = 0;
+    int blob_count = 0;
+    fscanf(fp, "%d %d", &layer_count, &blob_count);
+
+    while (!feof(fp))
+    {
+        int nscan = 0;
+
+        char layer_type[256];
+        char layer_name[256];
+        int bottom_count = 0;
+        int top_count = 0;
+        nscan = fscanf(fp, "%256s %256s %d %d", layer_type, layer_name, &bottom_count, &top_count);
+        if (nscan != 4)
+        {
+            continue;
+        }
+
+        for (int i=0; i<bottom_count + top_count; i++)
+        {
+            char blob_name[256];
+            fscanf(fp, "%256s", blob_name);
+        }
+
+        std::vector< std::pair<int, std::string> >& params = layer_params[layer_name];
+
+        // arrays stay in one token like -23303=5,0.1,0.2,0.4,0.8,1.0
+        int id = 0;
+        while (fscanf(fp, "%d=", &id) == 1)
+        {
+            char vstr[4096];
+            fscanf(fp, "%4095s", vstr);
+
+            params.push_back(std::make_pair(id, std::string(vstr)));
+        }
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+static void set_layer_param(std::vector< std::pair<int, std::string> >& params, int id, const std::string& vstr)
+{
+    for (size_t i=0; i<params.size(); i++)
+    {
+        if (params[i].first == id)
+        {
+            params[i].second = vstr;
+            return;
+        }
+    }
+
+    params.push_back(std::make_pair(id, vstr));
+}
+
+namespace ncnn {
+
+// keeps every weight handed to the layers so that they can be written back
+class ModelBinFromStdioRecord : public ModelBinFromStdio
+{
+public:
+    ModelBinFromStdioRecord(FILE* binfp) : ModelBinFromStdio(binfp) {}
+
+    virtual Mat load(int w, int type) const
+    {
+        Mat m = ModelBinFromStdio::load(w, type);
+        records.push_back(std::make_pair(type, m));
+        return m;
+    }
+
+    mutable std::vector< std::pair<int, Mat> > records;
+};
+
+class NetOptimize : public Net
+{
+public:
+    int load_model_record(const char* modelpath);
+
+    int fuse();
+
+    // mark the layers covered by an ncnn2table scale table as int8
+    int quantize(const char* tablepath);
+
+    int save(const char* parampath, const char* modelpath);
+
+protected:
+    // weights of each layer in load order, type 0 is written with a flag
+    std::map< const Layer*, std::vector< std::pair<int, Mat> > > layer_weights;
+
+    // layers whose weights changed by fusing
+    std::set<const Layer*> fused_layers;
+};
+
+int NetOptimize::load_model_record(const char* modelpath)
+{
+    FILE* fp = fopen(modelpath, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", modelpath);
+        return -1;
+    }
+
+    ModelBinFromStdioRecord mb(fp);
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        Layer* layer = layers[i];
+
+        mb.records.clear();
+
+        int ret = layer->load_model(mb);
+        if (ret != 0)
+        {
+            fprintf(stderr, "layer load_model %d failed\n", (int)i);
+            fclose(fp);
+            return -1;
+        }
+
+        layer_weights[layer] = mb.records;
+    }
+
+    fclose(fp);
+
+    return create_pipeline();
+}
+
+template<typename T>
+static void update_layer_weights(const T* op, std::vector< std::pair<int, Mat> >& weights)
+{
+    weights.clear();
+    weights.push_back(std::make_pair(0, op->weight_data_int8.empty() ? op->weight_data : op->weight_data_int8));
+
+    if (op->bias_term)
+        weights.push_back(std::make_pair(1, op->bias_data));
+
+    if (op->int8_scale_term)
+    {
+        Mat bottom_blob_int8_scales(1);
+        bottom_blob_int8_scales[0] = op->bottom_blob_int8_scale;
+
+        weights.push_back(std::make_pair(1, op->weight_data_int8_scales));
+        weights.push_back(std::make_pair(1, bottom_blob_int8_scales));
+    }
+}
+
+template<typename T>
+static void update_fused_layer(T* op, int bias_term_id, std::vector< std::pair<int, Mat> >& weights)
+{
+    update_layer_weights(op, weights);
+
+    std::vector< std::pair<int, std::string> >& params = layer_params[op->name];
+
+    char vstr[256];
+    sprintf(vstr, "%d", op->bias_term);
+    set_layer_param(params, bias_term_id, vstr);
+
+    if (op->activation_type == 0)
+        return;
+
+    sprintf(vstr, "%d", op->activation_type);
+    set_layer_param(params, 9, vstr);
+
+    if (op->activation_params.w == 0)
+        return;
+
+    std::string array = "";
+    sprintf(vstr, "%d", op->activation_params.w);
+    array += vstr;
+    for (int i=0; i<op->activation_params.w; i++)
+    {
+        sprintf(vstr, ",%e", op->activation_params[i]);
+        array += vstr;
+    }
+    set_layer_param(params, -23300 - 10, array);
+}
+
+int NetOptimize::fuse()
+{
+    // the fused layers hand their output blob over
+    std::map<const Layer*, int> old_tops;
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        if (layers[i]->tops.size() == 1)
+            old_tops[layers[i]] = layers[i]->tops[0];
+    }
+
+    const int layer_count = layers.size();
+
+    int ret = fuse_network();
+    if (ret != 0)
+        return ret;
+
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        Layer* layer = layers[i];
+        if (layer->tops.size() != 1 || old_tops[layer] == layer->tops[0])
+            continue;
+
+        fused_layers.insert(layer);
+
+        if (layer->typeindex == LayerType::Convolution)
+            update_fused_layer((Convolution*)layer, 5, layer_weights[layer]);
+        else if (layer->typeindex == LayerType::ConvolutionDepthWise)
+            update_fused_layer((ConvolutionDepthWise*)layer, 5, layer_weights[layer]);
+        else if (layer->typeindex == LayerType::InnerProduct)
+            update_fused_layer((InnerProduct*)layer, 1, layer_weights[layer]);
+    }
+
+    fprintf(stderr, "fused %d layers, %d layers left\n", layer_count - (int)layers.size(), (int)layers.size());
+
+    return 0;
+}
+
+// ncnn2table output, weight <layer name> <scales> and blob <blob name> <scale> lines
+static int read_int8_table(const char* tablepath, std::map< std::string, std::vector<float> >& weight_scales, std::map<std::string, float>& blob_scales)
+{
+    FILE* fp = fopen(tablepath, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "fopen %s failed\n", tablepath);
+        return -1;
+    }
+
+    char line[65536];
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (line[0] == '#')
+            continue;
+
+        char kind[16];
+        char name[256];
+        int nconsumed = 0;
+        if (sscanf(line, "%15s %255s%n", kind, name, &nconsumed) != 2)
+            continue;
+
+        std::vector<float> scales;
+        const char* ptr = line + nconsumed;
+        float scale;
+        int n = 0;
+        while (sscanf(ptr, "%f%n", &scale, &n) == 1)
+        {
+            scales.push_back(scale);
+            ptr += n;
+        }
+
+        if (strcmp(kind, "weight") == 0)
+            weight_scales[name] = scales;
+        else if (strcmp(kind, "blob") == 0 && scales.size() == 1)
+            blob_scales[name] = scales[0];
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+template<typename T>
+static int quantize_layer(T* op, const std::vector<float>* weight_scales, float bottom_scale, bool fused)
+{
+    op->weight_data_int8_scales.create(op->num_output);
+    if (op->weight_data_int8_scales.empty())
+        return -100;
+
+    const int size = op->weight_data.w / op->num_output;
+    for (int p=0; p<op->num_output; p++)
+    {
+        // fusing changed the weights the table was calibrated on
+        if (weight_scales && !fused && (int)weight_scales->size() == op->num_output)
+        {
+            op->weight_data_int8_scales[p] = (*weight_scales)[p];
+            continue;
+        }
+
+        const float* kptr = (const float*)op->weight_data + size * p;
+
+        float absmax = 0.f;
+        for (int i=0; i<size; i++)
+        {
+            absmax = std::max(absmax, (float)fabs(kptr[i]));
+        }
+
+        op->weight_data_int8_scales[p] = absmax == 0.f ? 0.f : 127.f / absmax;
+    }
+
+    op->int8_scale_term = 1;
+    op->bottom_blob_int8_scale = bottom_scale;
+
+    // stored as int8
+    int ret = prepare_int8_weights(op->weight_data, op->weight_data_int8, op->weight_data_int8_scales, op->num_output, true);
+    if (ret != 0)
+        return ret;
+
+    set_layer_param(layer_params[op->name], 8, "1");
+
+    return 0;
+}
+
+int NetOptimize::quantize(const char* tablepath)
+{
+    std::map< std::string, std::vector<float> > weight_scales;
+    std::map<std::string, float> blob_scales;
+    if (read_int8_table(tablepath, weight_scales, blob_scales) != 0)
+        return -1;
+
+    int quantized = 0;
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        Layer* layer = layers[i];
+        if (layer->typeindex != LayerType::Convolution && layer->typeindex != LayerType::ConvolutionDepthWise && layer->typeindex != LayerType::InnerProduct)
+            continue;
+
+        std::map<std::string, float>::const_iterator it = blob_scales.find(blobs[layer->bottoms[0]].name);
+        if (it == blob_scales.end())
+        {
+            fprintf(stderr, "no scale for %s, left in float\n", blobs[layer->bottoms[0]].name.c_str());
+            continue;
+        }
+
+        std::map< std::string, std::vector<float> >::const_iterator wit = weight_scales.find(layer->name);
+        const std::vector<float>* ws = wit == weight_scales.end() ? 0 : &wit->second;
+        const bool fused = fused_layers.find(layer) != fused_layers.end();
+
+        int ret = 0;
+        if (layer->typeindex == LayerType::Convolution)
+        {
+            ret = quantize_layer((Convolution*)layer, ws, it->second, fused);
+            if (ret == 0)
+                update_layer_weights((Convolution*)layer, layer_weights[layer]);
+        }
+        else if (layer->typeindex == LayerType::ConvolutionDepthWise)
+        {
+            ret = quantize_layer((ConvolutionDepthWise*)layer, ws, it->second, fused);
+            if (ret == 0)
+                update_layer_weights((ConvolutionDepthWise*)layer, layer_weights[layer]);
+        }
+        else
+        {
+            ret = quantize_layer((InnerProduct*)layer, ws, it->second, fused);
+            if (ret == 0)
+                update_layer_weights((InnerProduct*)layer, layer_weights[layer]);
+        }
+
+        if (ret != 0)
+            return ret;
+
+        quantized++;
+    }
+
+    fprintf(stderr, "quantized %d layers to int8\n", quantized);
+
+    return 0;
+}
+
+int NetOptimize::save(const char* parampath, const char* modelpath)
+{
+    FILE* pp = fopen(parampath, "wb");
+    if (!pp)
+    {
+        fprintf(stderr, "fopen %s failed\n", parampath);
+        return -1;
+    }
+
+    FILE* mp = fopen(modelpath, "wb");
+    if (!mp)
+    {
+        fprintf(stderr, "fopen %s failed\n", modelpath);
+        fclose(pp);
+        return -1;
+    }
+
+    // blobs between fused layers have no producer any more
+    int blob_count = 0;
+    for (size_t i=0; i<blobs.size(); i++)
+    {
+        if (blobs[i].producer != -1)
+            blob_count++;
+    }
+
+    fprintf(pp, "7767517\n");
+    fprintf(pp, "%d %d\n", (int)layers.size(), blob_count);
+
+    for (size_t i=0; i<layers.size(); i++)
+    {
+        const Layer* layer = layers[i];
+
+        fprintf(pp, "%-16s %-16s %d %d", layer->type.c_str(), layer->name.c_str(), (int)layer->bottoms.size(), (int)layer->tops.size());
+
+        for (size_t j=0; j<layer->bottoms.size(); j++)
+        {
+            fprintf(pp, " %s", blobs[layer->bottoms[j]].name.c_str());
+        }
+        for (size_t j=0; j<layer->tops.size(); j++)
+        {
+            fprintf(pp, " %s", blobs[layer->tops[j]].name.c_str());
+        }
+
+        const std::vector< std::pair<int, std::string> >& params = layer_params[layer->name];
+        for (size_t j=0; j<params.size(); j++)
+        {
+            fprintf(pp, " %d=%s", params[j].first, params[j].second.c_str());
+        }
+
+        fprintf(pp, "\n");
+
+        const std::vector< std::pair<int, Mat> >& weights = layer_weights[layer];
+        for (size_t j=0; j<weights.size(); j++)
+        {
+            const Mat& m = weights[j].second;
+
+            if (weights[j].first == 0 && m.elemsize == 1u)
+            {
+                // int8 flag, padded to 4 bytes
+                unsigned int tag = 0x000D4B38;
+                fwrite(&tag, sizeof(unsigned int), 1, mp);
+
+                fwrite(m.data, 1, m.w, mp);
+
+                static const unsigned char zeros[4] = {0, 0, 0, 0};
+                fwrite(zeros, 1, alignSize(m.w, 4) - m.w, mp);
+                continue;
+            }
+
+            if (weights[j].first == 0)
+            {
+                // raw float32 flag
+                unsigned int tag = 0;
+                fwrite(&tag, sizeof(unsigned int), 1, mp);
+            }
+
+            fwrite(m.data, sizeof(float), m.total(), mp);
+        }
+    }
+
+    fclose(pp);
+    fclose(mp);
+
+    return 0;
+}
+
+} // namespace ncnn
+
+int main(int argc, char** argv)
+{
+    if (argc != 5 && argc != 6)
+    {
+        fprintf(stderr, "Usage: %s [inparam] [inbin] [outparam] [outbin] [int8scaletable]\n", argv[0]);
+        return -1;
+    }
+
+    const char* inparam = argv[1];
+    const char* inbin = argv[2];
+    const char* outparam = argv[3];
+    const char* outbin = argv[4];
+    const char* int8scaletable = argc == 6 ? argv[5] : 0;
+
+    if (read_layer_params(inparam) != 0)
+        return -1;
+
+    // fold into float weights, int8 scales are carried along
+    // the layers keep their float weights for writing them out
+    ncnn::Option opt = ncnn::get_default_option();
+    opt.use_int8_inference = false;
+    opt.lightmode = false;
+    ncnn::set_default_option(opt);
+
+    ncnn::NetOptimize net;
+
+    if (net.load_param(inparam) != 0)
+        return -1;
+
+    if (net.load_model_record(inbin) != 0)
+        return -1;
+
+    if (net.fuse() != 0)
+        return -1;
+
+    if (int8scaletable && net.quantize(int8scaletable) != 0)
+        return -1;
+
+    return net.save(outparam, outbin);
+}